@@ -48,6 +48,9 @@ config_flags += -D__OSCONFIG_FULLDEBUGCONSOLE # Use a full debug console on heig
 #config_flags += -D__OSCONFIG_EHCI_ALLOW_64BIT # Allow the EHCI driver to utilize 64 bit dma buffers
 #config_flags += -D__OSCONFIG_DISABLE_VIOARR # Disable auto starting the windowing system
 #config_flags += -D__OSCONFIG_TEST_KERNEL # Enable testing mode of the operating system
+#config_flags += -D__OSCONFIG_TEST_USB # Run the usb-manager self-tests when a usb controller driver loads
+#config_flags += -D__OSCONFIG_BENCHMARKS=0xF # In testing mode run benchmarks instead (1 yield, 2 pipe, 4 pagefault, 8 heap)
+#config_flags += -D__OSCONFIG_SPINLOCK_STATISTICS # Track contention and hold times for each spinlock
 
 # Include correct arch file
 include $(dir $(mkfile_path))/$(VALI_ARCH)/rules.mk
\ No newline at end of file
@@ -59,7 +59,8 @@
  * 0x0               =>             0x10000000 (Kernel Memory Space 256 mb)
  * 0x10000000        =>             0xB0000000 (Application Memory Space 2.5gb) 
  * 0xB0000000        =>             0xF0000000 (Driver Io Memory Space, 1gb)
- * 0xF0000000        =>             0xFF000000 (Empty)
+ * 0xF0000000        =>             0xF0001000 (Shared System Page, 4kb)
+ * 0xF0001000        =>             0xFF000000 (Empty)
  * 0xFF000000        =>             0xFFFFFFFF (Application Stack Space, 16mb) 
  */
 #define MEMORY_LOCATION_KERNEL              0x100000     /* Kernel Image Space: 1024 kB */
@@ -78,6 +79,7 @@
 #define MEMORY_LOCATION_RING3_HEAP_END      0xB0000000
 #define MEMORY_LOCATION_RING3_IOSPACE       0xB0000000    /* Base for ring3 io-space (1gb) */
 #define MEMORY_LOCATION_RING3_IOSPACE_END   0xF0000000
+#define MEMORY_LOCATION_RING3_SHARED        0xF0000000    /* Shared system page (read-only) */
 
 #define MEMORY_LOCATION_RING3_THREAD_START  0xFF000000
 #define MEMORY_LOCATION_RING3_STACK_START   0xFFFE0000
@@ -93,7 +95,8 @@
 /* Architecture Memory Layout
  * This gives you an idea how memory layout is on the x86-64 platform in MollenOS 
  * 0x0              =>          0x10000000  (Kernel Memory Space 256 mb)
- * 0x10000000       =>          0xFF000000  (Empty 3.5gb)
+ * 0x10000000       =>          0xF0000000  (Empty 3.5gb)
+ * 0xF0000000       =>          0xF0001000  (Shared System Page, 4kb)
  * 0xFF000000       =>          0xFFFFFFFF  (Application Stack Space, 16mb)
  * 0x100000000      =>          0x1FFFFFFFF (Driver Memory Space - 4.0gb)
  * 0x200000000      =>          0xFFFFFFFFFFFFFFFF (Application Memory Space - terabytes)
@@ -107,6 +110,7 @@
 #define MEMORY_LOCATION_RESERVED            0x5000000    /* Driver Space: 190~ mB */
 #define MEMORY_LOCATION_KERNEL_END          0x10000000
 
+#define MEMORY_LOCATION_RING3_SHARED        0xF0000000    /* Shared system page (read-only) */
 #define MEMORY_LOCATION_RING3_THREAD_START  0xFF000000
 #define MEMORY_LOCATION_RING3_STACK_START   0xFFFE0000
 #define MEMORY_LOCATION_RING3_STACK_END       0xFE0000
@@ -137,6 +141,10 @@
 #define INTERRUPT_PHYSICAL_BASE             0x90
 #define INTERRUPT_PHYSICAL_END              0xF0
 
+// Message signaled interrupt vectors (0xB0 - 0xF0), the lower
+// part of the hardware range is left for io-apic sources
+#define INTERRUPT_MSI_BASE                  0xB0
+
 // Software interrupt vectors (0x20 - 0x90)
 // Synchronization calls
 #define INTERRUPT_SYNCHRONIZE_PAGE          0x70
@@ -38,9 +38,11 @@
 #if defined(_MSC_VER) && !defined(__clang__)
 #include <intrin.h>
 #define __get_cpuid(Function, Registers) __cpuid(Registers, Function);
+#define __get_cpuid_sub(Function, SubFunction, Registers) __cpuidex(Registers, Function, SubFunction);
 #else
 #include <cpuid.h>
 #define __get_cpuid(Function, Registers) __cpuid(Function, Registers[0], Registers[1], Registers[2], Registers[3]);
+#define __get_cpuid_sub(Function, SubFunction, Registers) __cpuid_count(Function, SubFunction, Registers[0], Registers[1], Registers[2], Registers[3]);
 #endif
 #define isspace(c) ((c >= 0x09 && c <= 0x0D) || (c == 0x20))
 
@@ -53,11 +55,17 @@ __EXTERN volatile size_t GlbTimerTicks[64];
  * These utilities are located in boot.asm */
 __EXTERN void __wbinvd(void);
 __EXTERN void __hlt(void);
-__EXTERN void CpuEnableXSave(void);
-__EXTERN void CpuEnableAvx(void);
+__EXTERN void CpuEnableXSave(uint32_t Components);
 __EXTERN void CpuEnableSse(void);
 __EXTERN void CpuEnableGpe(void);
 __EXTERN void CpuEnableFpu(void);
+__EXTERN void _rdtsc(uint64_t *Value);
+
+/* Extended state
+ * Determined by the boot processor, application processors enable the same components. */
+static int      ExtendedStateMode = CPU_XSAVE_MODE_FXSAVE;
+static size_t   ExtendedStateSize = 512;
+static uint64_t ExtendedStateMask = CPU_XSTATE_X87 | CPU_XSTATE_SSE;
 
 /* TrimWhitespaces
  * Trims leading and trailing whitespaces in-place on the given string. This is neccessary
@@ -165,6 +173,53 @@ SetMachineUmaMode(void)
     for(;;);
 }
 
+/* CpuInitializeExtendedState
+ * Enables the extended state components that are supported by both the cpu and the
+ * kernel, and selects the most efficient instructions for saving them. */
+static void
+CpuInitializeExtendedState(void)
+{
+    // Variables
+    uint32_t CpuRegisters[4]    = { 0 };
+    uint32_t Components         = CPU_XSTATE_X87 | CPU_XSTATE_SSE;
+    uint32_t Supported;
+
+    __get_cpuid_sub(0xD, 0, CpuRegisters);
+    Supported = CpuRegisters[0];
+    if (CpuHasFeatures(CPUID_FEAT_ECX_AVX, 0) == OsSuccess && (Supported & CPU_XSTATE_AVX)) {
+        Components |= CPU_XSTATE_AVX;
+        if ((Supported & CPU_XSTATE_AVX512) == CPU_XSTATE_AVX512) {
+            Components |= CPU_XSTATE_AVX512;
+        }
+    }
+    CpuEnableXSave(Components);
+
+    // OSXSAVE is reported once CR4 has been updated
+    __get_cpuid(1, CpuRegisters);
+    GetMachine()->Processor.Data[CPU_DATA_FEATURES_ECX] = CpuRegisters[2];
+
+    // The size reported depends on the components enabled in XCR0, and the compacted
+    // format used by XSAVES only includes the enabled components
+    __get_cpuid_sub(0xD, 0, CpuRegisters);
+    ExtendedStateSize = CpuRegisters[1];
+    ExtendedStateMask = Components;
+    ExtendedStateMode = CPU_XSAVE_MODE_XSAVE;
+
+    __get_cpuid_sub(0xD, 1, CpuRegisters);
+    if (CpuRegisters[0] & CPUID_XSAVE_EAX_XSAVES) {
+        ExtendedStateMode = CPU_XSAVE_MODE_XSAVES;
+        ExtendedStateSize = CpuRegisters[1];
+    }
+    else if (CpuRegisters[0] & CPUID_XSAVE_EAX_XSAVEOPT) {
+        ExtendedStateMode = CPU_XSAVE_MODE_XSAVEOPT;
+    }
+    else if (CpuRegisters[0] & CPUID_XSAVE_EAX_XSAVEC) {
+        ExtendedStateMode = CPU_XSAVE_MODE_XSAVEC;
+    }
+    TRACE("Extended state components 0x%x, mode %i, size %u",
+        Components, ExtendedStateMode, ExtendedStateSize);
+}
+
 /* CpuInitializeFeatures
  * Initializes all onboard features on the running core. This can be extended features
  * as SSE, MMX, FPU, AVX etc */
@@ -188,14 +243,37 @@ CpuInitializeFeatures(void)
 	}
     
     // Can we enable xsave? (and maybe avx?)
-    if (CpuHasFeatures(CPUID_FEAT_ECX_XSAVE | CPUID_FEAT_ECX_OSXSAVE, 0) == OsSuccess) {
-        CpuEnableXSave();
-        if (CpuHasFeatures(CPUID_FEAT_ECX_AVX, 0) == OsSuccess) {
-            CpuEnableAvx();
-        }
+    if (CpuHasFeatures(CPUID_FEAT_ECX_XSAVE, 0) == OsSuccess
+        && GetMachine()->Processor.Data[CPU_DATA_MAXLEVEL] >= 0xD) {
+        CpuInitializeExtendedState();
     }
 }
 
+/* CpuGetExtendedStateMode
+ * Returns the CPU_XSAVE_MODE_* used to save and restore the extended state of threads. */
+int
+CpuGetExtendedStateMode(void)
+{
+    return ExtendedStateMode;
+}
+
+/* CpuGetExtendedStateSize
+ * Returns the size of the buffer needed to save the extended state of a thread, the
+ * buffer must be 64 byte aligned. */
+size_t
+CpuGetExtendedStateSize(void)
+{
+    return ExtendedStateSize;
+}
+
+/* CpuGetExtendedStateMask
+ * Returns the CPU_XSTATE_* components that are enabled and saved with threads. */
+uint64_t
+CpuGetExtendedStateMask(void)
+{
+    return ExtendedStateMask;
+}
+
 /* CpuHasFeatures
  * Determines if the cpu has the requested features */
 OsStatus_t
@@ -253,6 +331,32 @@ CpuGetTicks(void) {
     return GlbTimerTicks[CpuGetCurrentId()];
 }
 
+/* CpuReadTimestampCounter
+ * Reads the cpu timestamp counter. Fails if the counter does not tick at a constant
+ * rate regardless of the power state, or if it can't be read from usermode. */
+OsStatus_t
+CpuReadTimestampCounter(
+    _Out_ uint64_t* Value)
+{
+    // Variables
+    static int Invariant = -1;
+
+    if (Invariant == -1) {
+        uint32_t CpuRegisters[4] = { 0 };
+        Invariant = 0;
+        if ((GetMachine()->Processor.Data[CPU_DATA_FEATURES_EDX] & CPUID_FEAT_EDX_TSC)
+            && GetMachine()->Processor.Data[CPU_DATA_MAXEXTENDEDLEVEL] >= 0x80000007) {
+            __get_cpuid(0x80000007, CpuRegisters);
+            Invariant = (CpuRegisters[3] & CPUID_EXTFEAT_EDX_INVARIANT_TSC) ? 1 : 0;
+        }
+    }
+    if (!Invariant) {
+        return OsError;
+    }
+    _rdtsc(Value);
+    return OsSuccess;
+}
+
 /* CpuFlushInstructionCache
  * Flushes the instruction cache for the processor. */
 void
@@ -268,9 +372,6 @@ CpuFlushInstructionCache(
     __wbinvd();
 }
 
-/* Backup Timer, Should always be provided */
-extern void _rdtsc(uint64_t *Value);
-
 /* CpuStall
  * Stalls the cpu for the given milliseconds, blocking call. */
 void
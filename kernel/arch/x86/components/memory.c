@@ -132,6 +132,9 @@ InitializeSystemMemory(
     MemoryMap->ThreadArea.Start     = MEMORY_LOCATION_RING3_THREAD_START;
     MemoryMap->ThreadArea.Length    = MEMORY_LOCATION_RING3_THREAD_END - MEMORY_LOCATION_RING3_THREAD_START;
 
+    MemoryMap->SharedPage.Start     = MEMORY_LOCATION_RING3_SHARED;
+    MemoryMap->SharedPage.Length    = PAGE_SIZE;
+
     // Debug initial stats
     PrintPhysicalMemoryUsage();
     return OsSuccess;
@@ -50,8 +50,12 @@ __EXTERN size_t GlbTimerQuantum;
 __EXTERN void init_fpu(void);
 __EXTERN void load_fpu(uintptr_t *buffer);
 __EXTERN void load_fpu_extended(uintptr_t *buffer);
+__EXTERN void load_fpu_supervisor(uintptr_t *buffer);
 __EXTERN void save_fpu(uintptr_t *buffer);
 __EXTERN void save_fpu_extended(uintptr_t *buffer);
+__EXTERN void save_fpu_optimized(uintptr_t *buffer);
+__EXTERN void save_fpu_compact(uintptr_t *buffer);
+__EXTERN void save_fpu_supervisor(uintptr_t *buffer);
 __EXTERN void set_ts(void);
 __EXTERN void clear_ts(void);
 __EXTERN void _yield(void);
@@ -90,6 +94,38 @@ ThreadingYieldHandler(
     return InterruptHandled;
 }
 
+/* ThreadingSaveFpu
+ * Saves the extended cpu state of the thread with the instruction selected
+ * for the cpu, the optimized variants skip unmodified or initial components. */
+static void
+ThreadingSaveFpu(
+    _In_ MCoreThread_t *Thread)
+{
+    uintptr_t *Buffer = (uintptr_t*)Thread->Data[THREAD_DATA_MATHBUFFER];
+    switch (CpuGetExtendedStateMode()) {
+        case CPU_XSAVE_MODE_XSAVES:     save_fpu_supervisor(Buffer); break;
+        case CPU_XSAVE_MODE_XSAVEOPT:   save_fpu_optimized(Buffer); break;
+        case CPU_XSAVE_MODE_XSAVEC:     save_fpu_compact(Buffer); break;
+        case CPU_XSAVE_MODE_XSAVE:      save_fpu_extended(Buffer); break;
+        default:                        save_fpu(Buffer); break;
+    }
+}
+
+/* ThreadingLoadFpu
+ * Loads the extended cpu state of the thread, xrstor handles both the standard
+ * and the compacted format, only xsaves requires its own restore. */
+static void
+ThreadingLoadFpu(
+    _In_ MCoreThread_t *Thread)
+{
+    uintptr_t *Buffer = (uintptr_t*)Thread->Data[THREAD_DATA_MATHBUFFER];
+    switch (CpuGetExtendedStateMode()) {
+        case CPU_XSAVE_MODE_XSAVES:     load_fpu_supervisor(Buffer); break;
+        case CPU_XSAVE_MODE_FXSAVE:     load_fpu(Buffer); break;
+        default:                        load_fpu_extended(Buffer); break;
+    }
+}
+
 /* ThreadingRegister
  * Initializes a new arch-specific thread context
  * for the given threading flags, also initializes
@@ -98,10 +134,25 @@ OsStatus_t
 ThreadingRegister(
     _In_ MCoreThread_t *Thread)
 {
-    // Allocate a new thread context (x86) and zero it out
+    // Variables
+    size_t Size = CpuGetExtendedStateSize();
+    uint8_t *Buffer;
+
+    // Allocate a new thread context (x86) and zero it out, the header being zero
+    // means all components start out in their initial state
+    Buffer = (uint8_t*)kmalloc_a(Size);
+    memset(Buffer, 0, Size);
+
+    // The control words are loaded by fxrstor, so use the default values
+    *((uint16_t*)&Buffer[0])    = 0x37F;
+    *((uint32_t*)&Buffer[24])   = 0x1F80;
+    if (CpuGetExtendedStateMode() == CPU_XSAVE_MODE_XSAVES) {
+        // xrstors only accepts the compacted format
+        *((uint64_t*)&Buffer[520]) = 0x8000000000000000ULL | CpuGetExtendedStateMask();
+    }
+
     Thread->Data[THREAD_DATA_FLAGS]         = 0;
-    Thread->Data[THREAD_DATA_MATHBUFFER]    = (uintptr_t)kmalloc_a(0x1000);
-    memset((void*)Thread->Data[THREAD_DATA_MATHBUFFER], 0, 0x1000);
+    Thread->Data[THREAD_DATA_MATHBUFFER]    = (uintptr_t)Buffer;
     return OsSuccess;
 }
 
@@ -128,12 +179,7 @@ ThreadingFpuException(
     clear_ts();
 
     if (!(Thread->Data[THREAD_DATA_FLAGS] & X86_THREAD_USEDFPU)) {
-        if (CpuHasFeatures(CPUID_FEAT_ECX_XSAVE | CPUID_FEAT_ECX_OSXSAVE, 0) == OsSuccess) {
-            load_fpu_extended((uintptr_t*)Thread->Data[THREAD_DATA_MATHBUFFER]);
-        }
-        else {
-            load_fpu((uintptr_t*)Thread->Data[THREAD_DATA_MATHBUFFER]);
-        }
+        ThreadingLoadFpu(Thread);
         Thread->Data[THREAD_DATA_FLAGS] |= X86_THREAD_USEDFPU;
         return OsSuccess;
     }
@@ -219,6 +265,8 @@ _ThreadingSwitch(
     // Variables
     UUId_t Cpu              = CpuGetCurrentId();
     MCoreThread_t *Thread   = ThreadingGetCurrentThread(Cpu);
+    uintptr_t Flags;
+    uintptr_t Count;
 
     // Sanitize the status of threading - return default values
     if (Thread == NULL) {
@@ -228,28 +276,53 @@ _ThreadingSwitch(
     }
     assert(!(Thread->Flags & THREADING_IMPERSONATION));
     
-    // Save FPU/MMX/SSE information if it's
+    // Save FPU/MMX/SSE/AVX information if it's
     // been used, otherwise skip this and save time
-    if (Thread->Data[THREAD_DATA_FLAGS] & X86_THREAD_USEDFPU) {
-        if (CpuHasFeatures(CPUID_FEAT_ECX_XSAVE | CPUID_FEAT_ECX_OSXSAVE, 0) == OsSuccess) {
-            save_fpu_extended((uintptr_t*)Thread->Data[THREAD_DATA_MATHBUFFER]);
+    Flags = Thread->Data[THREAD_DATA_FLAGS];
+    Count = (Flags & X86_THREAD_FPUCOUNT_MASK) >> X86_THREAD_FPUCOUNT_SHIFT;
+    if (Flags & X86_THREAD_USEDFPU) {
+        ThreadingSaveFpu(Thread);
+    }
+
+    // Switch to eager loading when the fpu is used in consecutive switches, the use of
+    // eager threads can't be observed so they are sampled again once in a while
+    if (Flags & X86_THREAD_EAGERFPU) {
+        if (--Count == 0) {
+            Flags &= ~X86_THREAD_EAGERFPU;
         }
-        else {
-            save_fpu((uintptr_t*)Thread->Data[THREAD_DATA_MATHBUFFER]);
+    }
+    else if (Flags & X86_THREAD_USEDFPU) {
+        if (++Count >= X86_THREAD_FPU_EAGER) {
+            Flags |= X86_THREAD_EAGERFPU;
+            Count  = X86_THREAD_FPU_SAMPLE;
         }
     }
+    else {
+        Count = 0;
+    }
+    Flags &= ~(X86_THREAD_USEDFPU | X86_THREAD_FPUCOUNT_MASK);
+    Thread->Data[THREAD_DATA_FLAGS] = Flags | (Count << X86_THREAD_FPUCOUNT_SHIFT);
 
     // Get a new thread for us to enter
     Thread      = ThreadingSwitch(Thread, PreEmptive, &Context);
     *TimeSlice  = Thread->TimeSlice;
     *TaskQueue  = Thread->Queue;
-    Thread->Data[THREAD_DATA_FLAGS] &= ~X86_THREAD_USEDFPU; // Clear the FPU used flag
 
     // Load thread-specific resources
     SwitchSystemMemorySpace(Thread->MemorySpace);
     TssUpdateThreadStack(Cpu, (uintptr_t)Thread->Contexts[THREADING_CONTEXT_LEVEL0]);
     TssUpdateIo(Cpu, (uint8_t*)Thread->MemorySpace->Data[MEMORY_SPACE_IOMAP]);
-    set_ts(); // Set task switch bit so we get faults on fpu instructions
+
+    // Load the fpu state of eager threads now, otherwise set the task switch
+    // bit so we get faults on fpu instructions
+    if (Thread->Data[THREAD_DATA_FLAGS] & X86_THREAD_EAGERFPU) {
+        clear_ts();
+        ThreadingLoadFpu(Thread);
+        Thread->Data[THREAD_DATA_FLAGS] |= X86_THREAD_USEDFPU;
+    }
+    else {
+        set_ts();
+    }
 
     // Handle any signals pending for thread
     SignalHandle(Thread->Id);
@@ -57,6 +57,34 @@
 #define CPU_DATA_FEATURES_ECX       2
 #define CPU_DATA_FEATURES_EDX       3
 
+/* Extended cpu features (0x80000007) */
+#define CPUID_EXTFEAT_EDX_INVARIANT_TSC (1 << 8)
+
+/* Extended state features (0xD, sub-leaf 1) */
+#define CPUID_XSAVE_EAX_XSAVEOPT    (1 << 0)
+#define CPUID_XSAVE_EAX_XSAVEC      (1 << 1)
+#define CPUID_XSAVE_EAX_XSAVES      (1 << 3)
+
+/* Extended state components
+ * The components that are enabled in XCR0 and switched with threads. The
+ * AVX-512 components can only be enabled together. */
+#define CPU_XSTATE_X87              (1 << 0)
+#define CPU_XSTATE_SSE              (1 << 1)
+#define CPU_XSTATE_AVX              (1 << 2)
+#define CPU_XSTATE_OPMASK           (1 << 5)
+#define CPU_XSTATE_ZMM_HI256        (1 << 6)
+#define CPU_XSTATE_HI16_ZMM         (1 << 7)
+#define CPU_XSTATE_AVX512           (CPU_XSTATE_OPMASK | CPU_XSTATE_ZMM_HI256 | CPU_XSTATE_HI16_ZMM)
+
+/* Extended state save modes
+ * The instruction used to save the extended state of threads, the best one
+ * supported is selected when the features are initialized. */
+#define CPU_XSAVE_MODE_FXSAVE       0
+#define CPU_XSAVE_MODE_XSAVE        1
+#define CPU_XSAVE_MODE_XSAVEC       2
+#define CPU_XSAVE_MODE_XSAVEOPT     3
+#define CPU_XSAVE_MODE_XSAVES       4
+
 /* Cpu Features 
  * Tells us which kind of support there is available
  * on the cpu */
@@ -138,4 +166,20 @@ CpuSmpInitialize(void);
 KERNELAPI OsStatus_t KERNELABI
 CpuHasFeatures(Flags_t Ecx, Flags_t Edx);
 
+/* CpuGetExtendedStateMode
+ * Returns the CPU_XSAVE_MODE_* used to save and restore the extended state of threads. */
+KERNELAPI int KERNELABI
+CpuGetExtendedStateMode(void);
+
+/* CpuGetExtendedStateSize
+ * Returns the size of the buffer needed to save the extended state of a thread, the
+ * buffer must be 64 byte aligned. */
+KERNELAPI size_t KERNELABI
+CpuGetExtendedStateSize(void);
+
+/* CpuGetExtendedStateMask
+ * Returns the CPU_XSTATE_* components that are enabled and saved with threads. */
+KERNELAPI uint64_t KERNELABI
+CpuGetExtendedStateMask(void);
+
 #endif // !_x86_CPU_H_
@@ -22,6 +22,7 @@
 
 #include <system/utils.h>
 #include <threading.h>
+#include <profiler.h>
 #include <interrupts.h>
 #include <thread.h>
 #include <acpi.h>
@@ -53,6 +54,7 @@ ApicTimerHandler(
     // to this function due to how signals are working
     GlbTimerTicks[CurrCpu]++;
     ApicSendEoi(APIC_NO_GSI, INTERRUPT_LAPIC);
+    ProfilerSampleContext((Context_t*)Context);
     Regs = _ThreadingSwitch((Context_t*)Context, 1, &TimeSlice, &TaskPriority);
     
     // If we are idle task - disable timer untill we get woken up
@@ -201,24 +201,33 @@ InterruptResolve(
 {
     // 1 Resolve the physical interrupt line
     if (!(Flags & INTERRUPT_SOFT)) {
-        if (Flags & (INTERRUPT_VECTOR | INTERRUPT_MSI)) {
-            int Vectors[INTERRUPT_PHYSICAL_END - INTERRUPT_PHYSICAL_BASE];
+        if (Flags & INTERRUPT_MSI) {
+            // Message signaled interrupts need a vector of their own, they are
+            // allocated from the top so they stay clear of the io-apic sources
             int i;
-            if (Flags & INTERRUPT_MSI) {
-                for (i = 0; i < (INTERRUPT_PHYSICAL_END - INTERRUPT_PHYSICAL_BASE); i++) {
-                    Vectors[i] = (INTERRUPT_PHYSICAL_BASE + i);
+            Interrupt->Line = INTERRUPT_NONE;
+            for (i = INTERRUPT_PHYSICAL_END - 1; i >= INTERRUPT_MSI_BASE; i--) {
+                if (InterruptGetPenalty(i) == 0) {
+                    Interrupt->Line = i - INTERRUPT_PHYSICAL_BASE;
+                    break;
                 }
             }
-            else {
-                Vectors[INTERRUPT_MAXVECTORS] = INTERRUPT_NONE;
-                for (i = 0; i < INTERRUPT_MAXVECTORS; i++) {
-                    if (Interrupt->Vectors[i] == INTERRUPT_NONE
-                        || i == INTERRUPT_MAXVECTORS) {
-                        Vectors[i] = INTERRUPT_NONE;
-                        break;
-                    }
-                    Vectors[i] = (INTERRUPT_PHYSICAL_BASE + Interrupt->Vectors[i]);
+            if (Interrupt->Line == INTERRUPT_NONE) {
+                ERROR("No free vectors left for message signaled interrupts");
+                return OsError;
+            }
+        }
+        else if (Flags & INTERRUPT_VECTOR) {
+            int Vectors[INTERRUPT_PHYSICAL_END - INTERRUPT_PHYSICAL_BASE];
+            int i;
+            Vectors[INTERRUPT_MAXVECTORS] = INTERRUPT_NONE;
+            for (i = 0; i < INTERRUPT_MAXVECTORS; i++) {
+                if (Interrupt->Vectors[i] == INTERRUPT_NONE
+                    || i == INTERRUPT_MAXVECTORS) {
+                    Vectors[i] = INTERRUPT_NONE;
+                    break;
                 }
+                Vectors[i] = (INTERRUPT_PHYSICAL_BASE + Interrupt->Vectors[i]);
             }
             Interrupt->Line = InterruptGetLeastLoaded(Vectors, i);
 
@@ -229,8 +238,9 @@ InterruptResolve(
         }
     }
 
-    // Do we need to override the source?
-    if (Interrupt->Line != INTERRUPT_NONE) {
+    // Do we need to override the source? Not for message signaled
+    // interrupts, they never go through the io-apic
+    if (Interrupt->Line != INTERRUPT_NONE && !(Flags & INTERRUPT_MSI)) {
         // Now lookup in ACPI overrides if we should
         // change the global source
         for (int i = 0; i < GetMachine()->NumberOfOverrides; i++) {
@@ -245,25 +255,27 @@ InterruptResolve(
     if (Flags & INTERRUPT_MSI) {
         *TableIndex = (INTERRUPT_PHYSICAL_BASE + (UUId_t)Interrupt->Line);
 
+        // Target a single core, spread by load and limited by affinity
+        Interrupt->MsiCpu = InterruptGetLeastLoadedCpu(Interrupt->AffinityMask);
+
         // Fill in MSI data
         // MSI Message Address Register (0xFEE00000 LAPIC)
         // Bits 31-20: Must be 0xFEE
-        // Bits 19-11: Destination ID
+        // Bits 19-12: Destination ID
         // Bits 11-04: Reserved
-        // Bit      3: 0 = Destination is ONE CPU, 1 = Destination is Group
+        // Bit      3: Redirection Hint (0 = Deliver to destination only)
         // Bit      2: Destination Mode (1 Logical, 0 Physical)
         // Bits 00-01: X
-        Interrupt->MsiAddress = 0xFEE00000 | (0x0007F0000) 
-            | (0x8 | 0x4);
+        Interrupt->MsiAddress = 0xFEE00000 | ((Interrupt->MsiCpu & 0xFF) << 12);
 
         // Message Data Register Format
         // Bits 31-16: Reserved
         // Bit     15: Trigger Mode (1 Level, 0 Edge)
         // Bit     14: If edge, this is not used, if level, 1 = Assert, 0 = Deassert
         // Bits 13-11: Reserved
-        // Bits 10-08: Delivery Mode, standard
+        // Bits 10-08: Delivery Mode, 000 = Fixed
         // Bits 07-00: Vector
-        Interrupt->MsiValue = (0x100 | (*TableIndex & 0xFF));
+        Interrupt->MsiValue = (*TableIndex & 0xFF);
     }
     else {
         // Driver/kernel interrupt
@@ -305,8 +317,9 @@ InterruptConfigure(
     // Debug
     TRACE("InterruptConfigure(Id 0x%x, Enable %i)", Descriptor->Id, Enable);
 
-    // Is this a software interrupt? Don't install
-    if (Descriptor->Flags & INTERRUPT_SOFT
+    // Is this a software interrupt? Don't install. Message signaled
+    // interrupts are configured in the device by the driver
+    if (Descriptor->Flags & (INTERRUPT_SOFT | INTERRUPT_MSI)
         || Descriptor->Interrupt.Line == INTERRUPT_NONE) {
         return OsSuccess;
     }
@@ -27,8 +27,16 @@
 #include <arch.h>
 #include <os/osdefs.h>
 
-/* Definitions */
+/* Definitions 
+ * Threads that keep using the fpu get their state loaded eagerly on switches
+ * instead of faulting on first use, the count is the number of consecutive
+ * switches the fpu was used in, or the switches left before sampling again. */
 #define X86_THREAD_USEDFPU			0x1
+#define X86_THREAD_EAGERFPU			0x2
+#define X86_THREAD_FPUCOUNT_SHIFT	8
+#define X86_THREAD_FPUCOUNT_MASK	0xFF00
+#define X86_THREAD_FPU_EAGER        4
+#define X86_THREAD_FPU_SAMPLE       16
 
 /* Constants and magic values which set the correct
  * bits for x86-specific registers, especially eflags */
@@ -26,8 +26,12 @@ global _init_sse
 global _init_fpu
 global _save_fpu
 global _save_fpu_extended
+global _save_fpu_optimized
+global _save_fpu_compact
+global _save_fpu_supervisor
 global _load_fpu
 global _load_fpu_extended
+global _load_fpu_supervisor
 global _clear_ts
 global _set_ts
 global __rdtsc
@@ -57,6 +61,34 @@ _save_fpu_extended:
 	xsave [ecx]
 	ret
 
+; void save_fpu_optimized(uintptr_t *buffer)
+; Save extended registers, skips components not modified since they were loaded
+_save_fpu_optimized:
+    mov eax, 0xFFFFFFFF
+    mov edx, 0xFFFFFFFF
+	mov ecx, [esp + 4]
+	xsaveopt [ecx]
+	ret
+
+; void save_fpu_compact(uintptr_t *buffer)
+; Save extended registers in the compacted format, skips components in their initial state
+_save_fpu_compact:
+    mov eax, 0xFFFFFFFF
+    mov edx, 0xFFFFFFFF
+	mov ecx, [esp + 4]
+	xsavec [ecx]
+	ret
+
+; void save_fpu_supervisor(uintptr_t *buffer)
+; Save extended registers in the compacted format, skips components that are
+; unmodified or in their initial state
+_save_fpu_supervisor:
+    mov eax, 0xFFFFFFFF
+    mov edx, 0xFFFFFFFF
+	mov ecx, [esp + 4]
+	xsaves [ecx]
+	ret
+
 ; void load_fpu(uintptr_t *buffer)
 ; Load FPU, MMX and SSE registers
 _load_fpu:
@@ -73,6 +105,15 @@ _load_fpu_extended:
 	xrstor [ecx]
 	ret
 
+; void load_fpu_supervisor(uintptr_t *buffer)
+; Load extended registers saved by save_fpu_supervisor
+_load_fpu_supervisor:
+    mov eax, 0xFFFFFFFF
+    mov edx, 0xFFFFFFFF
+	mov ecx, [esp + 4]
+	xrstors [ecx]
+	ret
+
 ; void set_ts()
 ; Sets the Task-Switch register
 _set_ts:
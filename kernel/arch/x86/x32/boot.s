@@ -27,7 +27,6 @@ extern _InitializeMachine
 ; Publics in this file
 global _kentry
 global _CpuEnableXSave
-global _CpuEnableAvx
 global _CpuEnableSse
 global _CpuEnableFpu
 global _CpuEnableGpe
@@ -54,27 +53,20 @@ _kentry:
 		hlt
 		jmp .idle
 
-; Assembly routine to enable xsave support
+; void CpuEnableXSave(uint32_t Components)
+; Assembly routine to enable xsave support, and the given state components
 _CpuEnableXSave:
 	mov eax, cr4
 	bts eax, 18		; Set Operating System Support for XSave (Bit 18)
 	mov cr4, eax
 
-    ; Initialize control register
-    mov ecx, 0
-    xgetbv     ; Load into EDX:EAX
-    or  eax, 6 ; Enable avx
-    mov ecx, 0
+    ; Initialize control register, AVX is enabled through it
+    mov eax, [esp + 4]
+    xor edx, edx
+    xor ecx, ecx
     xsetbv
 	ret 
 
-; Assembly routine to enable avx support
-_CpuEnableAvx:
-	mov eax, cr4
-	bts eax, 14		; Set Operating System Support for Advanced Vector Extensions (Bit 14)
-	mov cr4, eax
-	ret 
-
 ; Assembly routine to enable sse support
 _CpuEnableSse:
 	mov eax, cr4
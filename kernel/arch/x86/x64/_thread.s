@@ -26,8 +26,12 @@ global init_sse
 global init_fpu
 global save_fpu
 global save_fpu_extended
+global save_fpu_optimized
+global save_fpu_compact
+global save_fpu_supervisor
 global load_fpu
 global load_fpu_extended
+global load_fpu_supervisor
 global clear_ts
 global set_ts
 global _rdtsc
@@ -86,6 +90,31 @@ save_fpu_extended:
 	xsave [rcx]
 	ret
 
+; void save_fpu_optimized(uintptr_t *buffer)
+; Save extended registers, skips components not modified since they were loaded
+save_fpu_optimized:
+    mov rax, 0xFFFFFFFFFFFFFFFF
+    mov rdx, 0xFFFFFFFFFFFFFFFF
+	xsaveopt [rcx]
+	ret
+
+; void save_fpu_compact(uintptr_t *buffer)
+; Save extended registers in the compacted format, skips components in their initial state
+save_fpu_compact:
+    mov rax, 0xFFFFFFFFFFFFFFFF
+    mov rdx, 0xFFFFFFFFFFFFFFFF
+	xsavec [rcx]
+	ret
+
+; void save_fpu_supervisor(uintptr_t *buffer)
+; Save extended registers in the compacted format, skips components that are
+; unmodified or in their initial state
+save_fpu_supervisor:
+    mov rax, 0xFFFFFFFFFFFFFFFF
+    mov rdx, 0xFFFFFFFFFFFFFFFF
+	xsaves [rcx]
+	ret
+
 ; void load_fpu(uintptr_t *buffer)
 ; Load FPU, MMX and SSE registers
 load_fpu:
@@ -100,6 +129,14 @@ load_fpu_extended:
 	xrstor [rcx]
 	ret
 
+; void load_fpu_supervisor(uintptr_t *buffer)
+; Load extended registers saved by save_fpu_supervisor
+load_fpu_supervisor:
+    mov rax, 0xFFFFFFFFFFFFFFFF
+    mov rdx, 0xFFFFFFFFFFFFFFFF
+	xrstors [rcx]
+	ret
+
 ; void set_ts()
 ; Sets the Task-Switch register
 set_ts:
@@ -27,7 +27,6 @@ extern InitializeMachine
 ; Publics in this file
 global kentry
 global CpuEnableXSave
-global CpuEnableAvx
 global CpuEnableSse
 global CpuEnableFpu
 global CpuEnableGpe
@@ -55,27 +54,20 @@ kentry:
 		hlt
 		jmp .idle
 
-; Assembly routine to enable xsave support
+; void CpuEnableXSave(uint32_t Components)
+; Assembly routine to enable xsave support, and the given state components
 CpuEnableXSave:
     mov rax, cr4
 	bts rax, 18		; Set Operating System Support for XSave (Bit 18)
 	mov cr4, rax
     
-    ; Set the control register
-    mov rcx, 0
-    xgetbv
-    or  eax, 6
-    mov rcx, 0
+    ; Set the control register, AVX is enabled through it
+    mov eax, ecx
+    xor edx, edx
+    xor ecx, ecx
     xsetbv
     ret
 
-; Assembly routine to enable avx support
-CpuEnableAvx:
-	mov rax, cr4
-	bts rax, 14		; Set Operating System Support for Advanced Vector Extensions (Bit 14)
-	mov cr4, rax
-	ret 
-
 ; Assembly routine to enable sse support
 CpuEnableSse:
 	mov rax, cr4
@@ -365,6 +365,11 @@ DebugPageFaultFileMappings(
         foreach(Node, Ash->FileMappings) {
             Mapping = (MCoreAshFileMapping_t*)Node->Data;
             if (ISINRANGE(Address, Mapping->BufferObject.Address, (Mapping->BufferObject.Address + Mapping->Length) - 1)) {
+                // Image pages are read by the faulting thread as it owns the file
+                if (Mapping->Flags & FILE_MAPPING_IMAGE) {
+                    return PeImagePageIn(Mapping, Address, 0);
+                }
+
                 // Oh, woah, file-mapping
                 Event = (MCoreAshFileMappingEvent_t*)kmalloc(sizeof(MCoreAshFileMappingEvent_t));
                 Event->Ash      = Ash;
@@ -391,17 +396,24 @@ DebugPageFaultProcessHeapMemory(
     _In_ uintptr_t  Address)
 {
     // Variables
-    MCoreAsh_t *Ash = PhoenixGetCurrentAsh();
+    MCoreAsh_t *Ash     = PhoenixGetCurrentAsh();
+    Flags_t Attributes  = 0;
 
     if (Ash != NULL) {
         if (DebugPageFaultFileMappings(Context, Address) == OsSuccess) {
             return OsSuccess;
         }
 
-        if (BlockBitmapValidateState(Ash->Heap, Address, 1) == OsSuccess) {
-            // Try to map it in and return the result
+        if (RangeTreeLookup(Ash->Heap, Address, NULL, NULL, &Attributes) == OsSuccess) {
+            // Reserved address space must be committed before use
+            if (!(Attributes & MEMORY_AREA_COMMITTED)) {
+                return OsError;
+            }
+
+            // Try to map it in with the protection of the area and return the result
             return CreateSystemMemorySpaceMapping(GetCurrentSystemMemorySpace(), NULL, &Address, 
-                GetSystemMemoryPageSize(), MAPPING_USERSPACE | MAPPING_FIXED, __MASK);
+                GetSystemMemoryPageSize(), (Attributes & MEMORY_AREA_MAPPING_MASK) 
+                | MAPPING_USERSPACE | MAPPING_FIXED, __MASK);
         }
     }
     return OsSuccess;
@@ -447,6 +459,11 @@ DebugInstallPageFaultHandlers(
     PageFaultHandlers[3].AreaStart      = MemoryMap->ThreadArea.Start;
     PageFaultHandlers[3].AreaEnd        = MemoryMap->ThreadArea.Start + MemoryMap->ThreadArea.Length;
     PageFaultHandlers[3].AreaHandler    = DebugPageFaultThreadMemory;
+
+    // Process image memory handler, sections are paged in from the file
+    PageFaultHandlers[4].AreaStart      = MemoryMap->UserCode.Start;
+    PageFaultHandlers[4].AreaEnd        = MemoryMap->UserCode.Start + MemoryMap->UserCode.Length;
+    PageFaultHandlers[4].AreaHandler    = DebugPageFaultFileMappings;
     return OsSuccess;
 }
 
@@ -0,0 +1,448 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS Event Port Interface
+ * - Implementation of event ports, which multiplexes the readiness of pipes, threads,
+ *   processes, timers and interrupts into a single waitable object. Sources embed
+ *   an EventSource_t and signal it, which is cheap when nothing is attached.
+ */
+#define __MODULE "EVPT"
+//#define __TRACE
+
+#include <atomicsection.h>
+#include <eventport.h>
+#include <scheduler.h>
+#include <handle.h>
+#include <debug.h>
+#include <heap.h>
+#include <assert.h>
+#include <string.h>
+
+// Sources are signalled from interrupt context, so a single irq-lock protects
+// all registration lists. The lock is only held for list manipulation.
+static AtomicSection_t EventPortSyncObject = ATOMICSECTION_INITIALIZE;
+
+// Events are dequeued into a kernel buffer of this size under the lock, and
+// copied to the caller afterwards as the caller buffer may fault
+#define EVENTPORT_WAIT_BATCH 8
+
+/* EventPortQueue
+ * Adds the events to the registration and queues it on the ready list of the port.
+ * Returns 1 if the port must be woken. Must be called with the lock held. */
+static int
+EventPortQueue(
+    _In_ EventPortRegistration_t*   Registration,
+    _In_ Flags_t                    Events)
+{
+    SystemEventPort_t *Port = Registration->Port;
+
+    Registration->Pending |= Events;
+    Registration->Count++;
+    if (Registration->Ready) {
+        return 0;
+    }
+
+    Registration->Ready     = 1;
+    Registration->ReadyLink = NULL;
+    if (Port->ReadyTail == NULL) {
+        Port->ReadyHead = Registration;
+    }
+    else {
+        Port->ReadyTail->ReadyLink = Registration;
+    }
+    Port->ReadyTail = Registration;
+    return 1;
+}
+
+/* EventPortUnlinkSource
+ * Removes the registration from the list of its source. Must be called with the lock held. */
+static void
+EventPortUnlinkSource(
+    _In_ EventPortRegistration_t*   Registration)
+{
+    EventPortRegistration_t **Link;
+
+    if (Registration->Source == NULL) {
+        return;
+    }
+
+    Link = &Registration->Source->Registrations;
+    while (*Link != NULL) {
+        if (*Link == Registration) {
+            *Link = Registration->SourceLink;
+            break;
+        }
+        Link = &(*Link)->SourceLink;
+    }
+    Registration->Source = NULL;
+}
+
+/* EventPortUnlinkReady
+ * Removes the registration from the ready list of its port. Must be called with the lock held. */
+static void
+EventPortUnlinkReady(
+    _In_ EventPortRegistration_t*   Registration)
+{
+    SystemEventPort_t *Port = Registration->Port;
+    EventPortRegistration_t *Previous = NULL;
+    EventPortRegistration_t *Current;
+
+    if (!Registration->Ready) {
+        return;
+    }
+
+    Current = Port->ReadyHead;
+    while (Current != NULL && Current != Registration) {
+        Previous    = Current;
+        Current     = Current->ReadyLink;
+    }
+    if (Current != NULL) {
+        if (Previous == NULL) {
+            Port->ReadyHead = Current->ReadyLink;
+        }
+        else {
+            Previous->ReadyLink = Current->ReadyLink;
+        }
+        if (Port->ReadyTail == Current) {
+            Port->ReadyTail = Previous;
+        }
+    }
+    Registration->Ready = 0;
+}
+
+/* EventPortUnlink
+ * Removes the registration from the list of its port. Must be called with the lock held. */
+static void
+EventPortUnlink(
+    _In_ EventPortRegistration_t*   Registration)
+{
+    EventPortRegistration_t **Link = &Registration->Port->Registrations;
+    while (*Link != NULL) {
+        if (*Link == Registration) {
+            *Link = Registration->PortLink;
+            break;
+        }
+        Link = &(*Link)->PortLink;
+    }
+}
+
+/* EventPortWake
+ * Wakes all threads waiting on the port. */
+static void
+EventPortWake(
+    _In_ SystemEventPort_t*         Port)
+{
+    atomic_fetch_add(&Port->Sequence, 1);
+    SchedulerHandleSignalAll((uintptr_t*)&Port->Sequence);
+}
+
+/* CreateSystemEventPort
+ * Creates a new event port and returns a handle to it. */
+OsStatus_t
+CreateSystemEventPort(
+    _Out_ UUId_t*           Handle)
+{
+    SystemEventPort_t *Port;
+
+    Port = (SystemEventPort_t*)kmalloc(sizeof(SystemEventPort_t));
+    if (Port == NULL) {
+        return OsError;
+    }
+    memset((void*)Port, 0, sizeof(SystemEventPort_t));
+    *Handle = CreateHandle(HandleTypeEventPort, Port);
+    return OsSuccess;
+}
+
+/* AttachSystemEventPort
+ * Attaches the source to the event port, a source can only be attached once per port. */
+OsStatus_t
+AttachSystemEventPort(
+    _In_ UUId_t             Handle,
+    _In_ EventSource_t*     Source,
+    _In_ int                Type,
+    _In_ UUId_t             SourceId,
+    _In_ Flags_t            Events,
+    _In_ void*              Context)
+{
+    EventPortRegistration_t *Registration;
+    EventPortRegistration_t *Existing;
+    SystemEventPort_t *Port;
+
+    // Keep the port alive while it's being modified
+    if (Source == NULL) {
+        return OsError;
+    }
+    Port = (SystemEventPort_t*)AcquireHandle(Handle);
+    if (Port == NULL) {
+        return OsError;
+    }
+    TRACE("AttachSystemEventPort(Type %i, Id %u, Events 0x%x)", Type, SourceId, Events);
+
+    Registration = (EventPortRegistration_t*)kmalloc(sizeof(EventPortRegistration_t));
+    if (Registration == NULL) {
+        DestroyHandle(Handle);
+        return OsError;
+    }
+    memset((void*)Registration, 0, sizeof(EventPortRegistration_t));
+    Registration->Port      = Port;
+    Registration->Source    = Source;
+    Registration->Type      = Type;
+    Registration->SourceId  = SourceId;
+    Registration->Events    = Events | EVENT_HANGUP;
+    Registration->Context   = Context;
+
+    AtomicSectionEnter(&EventPortSyncObject);
+    Existing = Port->Registrations;
+    while (Existing != NULL) {
+        if (Existing->Type == Type && Existing->SourceId == SourceId) {
+            break;
+        }
+        Existing = Existing->PortLink;
+    }
+    if (Existing == NULL) {
+        Registration->PortLink      = Port->Registrations;
+        Port->Registrations         = Registration;
+        Registration->SourceLink    = Source->Registrations;
+        Source->Registrations       = Registration;
+    }
+    AtomicSectionLeave(&EventPortSyncObject);
+    DestroyHandle(Handle);
+
+    if (Existing != NULL) {
+        WARNING("Source %i:%u is already attached to the event port", Type, SourceId);
+        kfree(Registration);
+        return OsError;
+    }
+    return OsSuccess;
+}
+
+/* DetachSystemEventPort
+ * Detaches the source identified by type and id from the event port. */
+OsStatus_t
+DetachSystemEventPort(
+    _In_ UUId_t             Handle,
+    _In_ int                Type,
+    _In_ UUId_t             SourceId)
+{
+    EventPortRegistration_t *Registration;
+    SystemEventPort_t *Port;
+
+    // Keep the port alive while it's being modified
+    Port = (SystemEventPort_t*)AcquireHandle(Handle);
+    if (Port == NULL) {
+        return OsError;
+    }
+
+    AtomicSectionEnter(&EventPortSyncObject);
+    Registration = Port->Registrations;
+    while (Registration != NULL) {
+        if (Registration->Type == Type && Registration->SourceId == SourceId) {
+            EventPortUnlinkSource(Registration);
+            EventPortUnlinkReady(Registration);
+            EventPortUnlink(Registration);
+            break;
+        }
+        Registration = Registration->PortLink;
+    }
+    AtomicSectionLeave(&EventPortSyncObject);
+    DestroyHandle(Handle);
+
+    if (Registration == NULL) {
+        return OsError;
+    }
+    kfree(Registration);
+    return OsSuccess;
+}
+
+/* WaitForSystemEventPort
+ * Waits for ready sources on the event port and dequeues up to <MaxEvents> of them. */
+OsStatus_t
+WaitForSystemEventPort(
+    _In_  UUId_t            Handle,
+    _In_  EventPortEvent_t* Events,
+    _In_  size_t            MaxEvents,
+    _In_  size_t            Timeout,
+    _Out_ size_t*           EventCount)
+{
+    EventPortEvent_t Batch[EVENTPORT_WAIT_BATCH];
+    EventPortRegistration_t *Released = NULL;
+    SystemEventPort_t *Port;
+    size_t BatchCount;
+    size_t Count = 0;
+    int Sequence;
+    int Status;
+
+    if (Events == NULL || MaxEvents == 0 || EventCount == NULL) {
+        return OsError;
+    }
+
+    // Keep a reference while waiting, so the port survives being destroyed
+    Port = (SystemEventPort_t*)AcquireHandle(Handle);
+    if (Port == NULL) {
+        return OsError;
+    }
+
+    while (1) {
+        Sequence = atomic_load(&Port->Sequence);
+
+        do {
+            BatchCount = 0;
+            AtomicSectionEnter(&EventPortSyncObject);
+            while (Port->ReadyHead != NULL && BatchCount < MIN(MaxEvents - Count, EVENTPORT_WAIT_BATCH)) {
+                EventPortRegistration_t *Registration = Port->ReadyHead;
+                Port->ReadyHead = Registration->ReadyLink;
+                if (Port->ReadyHead == NULL) {
+                    Port->ReadyTail = NULL;
+                }
+
+                Batch[BatchCount].Source    = Registration->Type;
+                Batch[BatchCount].SourceId  = Registration->SourceId;
+                Batch[BatchCount].Events    = Registration->Pending;
+                Batch[BatchCount].Count     = Registration->Count;
+                Batch[BatchCount].Context   = Registration->Context;
+                BatchCount++;
+
+                Registration->Ready     = 0;
+                Registration->Pending   = 0;
+                Registration->Count     = 0;
+
+                // Hung up sources are detached once reported, they are freed
+                // outside the lock
+                if (Registration->Source == NULL) {
+                    EventPortUnlink(Registration);
+                    Registration->ReadyLink = Released;
+                    Released                = Registration;
+                }
+            }
+            AtomicSectionLeave(&EventPortSyncObject);
+
+            memcpy(&Events[Count], &Batch[0], BatchCount * sizeof(EventPortEvent_t));
+            Count += BatchCount;
+        } while (BatchCount == EVENTPORT_WAIT_BATCH && Count < MaxEvents);
+
+        if (Count != 0) {
+            break;
+        }
+
+        Status = SchedulerAtomicThreadSleep(&Port->Sequence, &Sequence, Timeout);
+        if (Status == SCHEDULER_SLEEP_TIMEOUT || Status == SCHEDULER_SLEEP_INTERRUPTED) {
+            break;
+        }
+    }
+
+    while (Released != NULL) {
+        EventPortRegistration_t *Next = Released->ReadyLink;
+        kfree(Released);
+        Released = Next;
+    }
+
+    DestroyHandle(Handle);
+    *EventCount = Count;
+    return OsSuccess;
+}
+
+/* DestroySystemEventPort
+ * Cleans up the resources associated with the handle. This function is registered
+ * with the handle manager. */
+OsStatus_t
+DestroySystemEventPort(
+    _In_ void*              Resource)
+{
+    SystemEventPort_t *Port = (SystemEventPort_t*)Resource;
+    EventPortRegistration_t *Registration;
+
+    // Detach from all sources, after this no one can reach the port
+    AtomicSectionEnter(&EventPortSyncObject);
+    Registration = Port->Registrations;
+    while (Registration != NULL) {
+        EventPortUnlinkSource(Registration);
+        Registration = Registration->PortLink;
+    }
+    Registration            = Port->Registrations;
+    Port->Registrations     = NULL;
+    Port->ReadyHead         = NULL;
+    Port->ReadyTail         = NULL;
+    AtomicSectionLeave(&EventPortSyncObject);
+
+    while (Registration != NULL) {
+        EventPortRegistration_t *Next = Registration->PortLink;
+        kfree(Registration);
+        Registration = Next;
+    }
+    kfree(Port);
+    return OsSuccess;
+}
+
+/* EventSourceSignal
+ * Signals the events to all ports the source is attached to. Safe to call from
+ * interrupt context. Returns OsSuccess if any port was interested in the events. */
+OsStatus_t
+EventSourceSignal(
+    _In_ EventSource_t*     Source,
+    _In_ Flags_t            Events)
+{
+    EventPortRegistration_t *Registration;
+    OsStatus_t Status = OsError;
+
+    // Fast path, most sources are never attached
+    if (Source->Registrations == NULL) {
+        return OsError;
+    }
+
+    AtomicSectionEnter(&EventPortSyncObject);
+    Registration = Source->Registrations;
+    while (Registration != NULL) {
+        if (Registration->Events & Events) {
+            if (EventPortQueue(Registration, Registration->Events & Events)) {
+                EventPortWake(Registration->Port);
+            }
+            Status = OsSuccess;
+        }
+        Registration = Registration->SourceLink;
+    }
+    AtomicSectionLeave(&EventPortSyncObject);
+    return Status;
+}
+
+/* EventSourceDestroy
+ * Must be called before the object embedding the source is freed. All attached
+ * ports receive EVENT_HANGUP for the source. */
+void
+EventSourceDestroy(
+    _In_ EventSource_t*     Source)
+{
+    EventPortRegistration_t *Registration;
+
+    if (Source->Registrations == NULL) {
+        return;
+    }
+
+    AtomicSectionEnter(&EventPortSyncObject);
+    Registration = Source->Registrations;
+    while (Registration != NULL) {
+        EventPortRegistration_t *Next = Registration->SourceLink;
+        Registration->Source        = NULL;
+        Registration->SourceLink    = NULL;
+        if (EventPortQueue(Registration, EVENT_HANGUP)) {
+            EventPortWake(Registration->Port);
+        }
+        Registration = Next;
+    }
+    Source->Registrations = NULL;
+    AtomicSectionLeave(&EventPortSyncObject);
+}
@@ -28,11 +28,13 @@
 
 // Include all the systems that we have to cleanup
 #include <memorybuffer.h>
+#include <eventport.h>
 
 static Collection_t         Handles                             = COLLECTION_INIT(KeyInteger);
 static _Atomic(UUId_t)      IdGenerator                         = 1;
 static HandleDestructorFn   HandleDestructors[HandleTypeCount]  = {
-    DestroyMemoryBuffer
+    DestroyMemoryBuffer,
+    DestroySystemEventPort
 };
 
 /* CreateHandle
@@ -68,42 +70,50 @@ AcquireHandle(
     _In_ UUId_t             Handle)
 {
     SystemHandle_t *Instance;
+    void *Resource = NULL;
     DataKey_t Key;
-    int PreviousReferences;
+    int References;
 
-    // Lookup the handle
+    // Lookup the handle, the list is read without locks and handles are
+    // only released once no readers can see them
     Key.Value   = (int)Handle;
+    EpochEnter();
     Instance    = (SystemHandle_t*)CollectionGetNodeByKey(&Handles, Key, 0);
-    if (Instance == NULL) {
-        return NULL;
-    }
-
-    PreviousReferences = atomic_fetch_add(&Instance->References, 1);
-    if (PreviousReferences == 0) {
-        // Special case, to fix race-conditioning. If the reference
-        // count ever reach 0 this was called on cleanup.
-        return NULL;
+    if (Instance != NULL) {
+        // Handles that reached 0 references are being destroyed
+        References = atomic_load(&Instance->References);
+        while (References != 0) {
+            if (atomic_compare_exchange_weak(&Instance->References, &References, References + 1)) {
+                Resource = Instance->Resource;
+                break;
+            }
+        }
     }
-    return Instance->Resource;
+    EpochLeave();
+    return Resource;
 }
 
 /* LookupHandle
  * Retrieves the handle given for the calling process. This can fail if the handle
- * turns out to be invalid, otherwise the resource will be returned. */
+ * turns out to be invalid, otherwise the resource will be returned. The resource is
+ * only guaranteed to stay valid inside an epoch section, use AcquireHandle otherwise. */
 void*
 LookupHandle(
     _In_ UUId_t             Handle)
 {
     SystemHandle_t *Instance;
+    void *Resource = NULL;
     DataKey_t Key;
 
     // Lookup the handle
     Key.Value   = (int)Handle;
+    EpochEnter();
     Instance    = (SystemHandle_t*)CollectionGetNodeByKey(&Handles, Key, 0);
-    if (Instance == NULL) {
-        return NULL;
+    if (Instance != NULL) {
+        Resource = Instance->Resource;
     }
-    return Instance->Resource;
+    EpochLeave();
+    return Resource;
 }
 
 /* DestroyHandle
@@ -120,16 +130,21 @@ DestroyHandle(
 
     // Lookup the handle
     Key.Value   = (int)Handle;
+    EpochEnter();
     Instance    = (SystemHandle_t*)CollectionGetNodeByKey(&Handles, Key, 0);
     if (Instance == NULL) {
+        EpochLeave();
         return OsError;
     }
-
     References = atomic_fetch_sub(&Instance->References, 1) - 1;
+    EpochLeave();
+
+    // Unlink the handle but keep its links intact, readers that are walking
+    // the list might be standing on it
     if (References == 0) {
-        CollectionRemoveByNode(&Handles, &Instance->Header);
+        CollectionUnlinkNode(&Handles, &Instance->Header);
         Status = HandleDestructors[Instance->Type](Instance->Resource);
-        kfree(Instance);
+        EpochDefer(&Instance->Retire, kfree, Instance);
     }
     return Status;
 }
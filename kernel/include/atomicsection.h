@@ -28,10 +28,12 @@
 #include <system/interrupts.h>
 
 /* Atomic Section Definitions
- * Magic constants, bit definitions and types. */
+ * Magic constants, bit definitions and types. The section is a ticket lock
+ * so cpus are granted the section in the order they arrived. */
 #define ATOMICSECTION_INITIALIZE    { 0 }
 typedef struct _AtomicSection {
-    atomic_bool Status;
+    atomic_uint Next;
+    atomic_uint Serving;
     IntStatus_t State;
 } AtomicSection_t;
 
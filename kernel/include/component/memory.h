@@ -37,6 +37,7 @@ typedef struct _SystemMemoryMap {
     SystemMemoryRange_t     UserHeap;
     SystemMemoryRange_t     UserIoMemory;
     SystemMemoryRange_t     ThreadArea;
+    SystemMemoryRange_t     SharedPage;
 } SystemMemoryMap_t;
 
 typedef struct _SystemMemory {
@@ -0,0 +1,84 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS Synchronization
+ *  - Epoch based reclamation allows shared lists to be read without locks. Readers
+ *    mark the cpu they run on as active for the duration of the read, and writers
+ *    defer the release of unlinked nodes untill every active cpu has moved on.
+ */
+
+#ifndef _MCORE_EPOCH_
+#define _MCORE_EPOCH_
+
+#include <os/osdefs.h>
+
+/* Epoch Definitions
+ * Magic constants, bit definitions and types. An item must be embedded in the
+ * node that is deferred and stay valid untill the callback has been invoked. */
+#define EPOCH_MAX_CORES             256
+
+typedef void (*EpochCallback_t)(void*);
+typedef struct _EpochItem {
+    struct _EpochItem*  Link;
+    EpochCallback_t     Callback;
+    void*               Context;
+    unsigned int        Epoch;
+} EpochItem_t;
+
+/* EpochEnter
+ * Enters a read-side section on the current cpu, nodes that are reachable when
+ * entering the section stay valid untill EpochLeave. Sections can be nested and
+ * can be used from interrupt context, but the caller must not block in them. */
+KERNELAPI void KERNELABI
+EpochEnter(void);
+
+/* EpochLeave
+ * Leaves the read-side section, the current cpu is quiescent again once the
+ * outermost section has been left. */
+KERNELAPI void KERNELABI
+EpochLeave(void);
+
+/* EpochDefer
+ * Queues the callback to be invoked once all readers that could have seen the node
+ * have left their sections. The node must already be unlinked. Expired callbacks
+ * are invoked from this call, so it must be called from thread context. */
+KERNELAPI void KERNELABI
+EpochDefer(
+    _In_ EpochItem_t*       Item,
+    _In_ EpochCallback_t    Callback,
+    _In_ void*              Context);
+
+/* EpochReclaim
+ * Tries to advance the global epoch and invokes the callbacks that have expired. */
+KERNELAPI void KERNELABI
+EpochReclaim(void);
+
+/* EpochTick
+ * Tries to advance the global epoch without invoking any callbacks, so it can be
+ * called from interrupt context. Returns 1 if callbacks are waiting for EpochReclaim. */
+KERNELAPI int KERNELABI
+EpochTick(void);
+
+/* EpochSynchronize
+ * Waits for all readers that were active when called to leave their sections, and
+ * invokes the callbacks that were deferred before the call. Must not be called
+ * from a read-side section. */
+KERNELAPI void KERNELABI
+EpochSynchronize(void);
+
+#endif //!_MCORE_EPOCH_
@@ -0,0 +1,127 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS Event Port Interface
+ * - Implementation of event ports, which multiplexes the readiness of pipes, threads,
+ *   processes, timers and interrupts into a single waitable object. Sources embed
+ *   an EventSource_t and signal it, which is cheap when nothing is attached.
+ */
+
+#ifndef __EVENTPORT_INTERFACE__
+#define __EVENTPORT_INTERFACE__
+
+#include <os/osdefs.h>
+#include <os/eventport.h>
+
+struct _SystemEventPort;
+struct _EventPortRegistration;
+
+/* EventSource
+ * Embedded in every object that can be attached to an event port, must be zero
+ * initialized. Registrations are protected by the event port lock. */
+typedef struct _EventSource {
+    struct _EventPortRegistration*  Registrations;
+} EventSource_t;
+
+/* EventPortRegistration
+ * Links a source to a port, a registration is on the source list while the source
+ * is alive, on the port list until detached, and on the ready list while pending. */
+typedef struct _EventPortRegistration {
+    struct _SystemEventPort*        Port;
+    EventSource_t*                  Source;
+    int                             Type;
+    UUId_t                          SourceId;
+    Flags_t                         Events;
+    void*                           Context;
+
+    Flags_t                         Pending;
+    size_t                          Count;
+    int                             Ready;
+
+    struct _EventPortRegistration*  SourceLink;
+    struct _EventPortRegistration*  PortLink;
+    struct _EventPortRegistration*  ReadyLink;
+} EventPortRegistration_t;
+
+/* SystemEventPort
+ * The ready list is a fifo so sources are reported in the order they became ready. */
+typedef struct _SystemEventPort {
+    atomic_int                      Sequence;
+    EventPortRegistration_t*        Registrations;
+    EventPortRegistration_t*        ReadyHead;
+    EventPortRegistration_t*        ReadyTail;
+} SystemEventPort_t;
+
+/* CreateSystemEventPort
+ * Creates a new event port and returns a handle to it. */
+KERNELAPI OsStatus_t KERNELABI
+CreateSystemEventPort(
+    _Out_ UUId_t*           Handle);
+
+/* AttachSystemEventPort
+ * Attaches the source to the event port, a source can only be attached once per port. */
+KERNELAPI OsStatus_t KERNELABI
+AttachSystemEventPort(
+    _In_ UUId_t             Handle,
+    _In_ EventSource_t*     Source,
+    _In_ int                Type,
+    _In_ UUId_t             SourceId,
+    _In_ Flags_t            Events,
+    _In_ void*              Context);
+
+/* DetachSystemEventPort
+ * Detaches the source identified by type and id from the event port. */
+KERNELAPI OsStatus_t KERNELABI
+DetachSystemEventPort(
+    _In_ UUId_t             Handle,
+    _In_ int                Type,
+    _In_ UUId_t             SourceId);
+
+/* WaitForSystemEventPort
+ * Waits for ready sources on the event port and dequeues up to <MaxEvents> of them. */
+KERNELAPI OsStatus_t KERNELABI
+WaitForSystemEventPort(
+    _In_  UUId_t            Handle,
+    _In_  EventPortEvent_t* Events,
+    _In_  size_t            MaxEvents,
+    _In_  size_t            Timeout,
+    _Out_ size_t*           EventCount);
+
+/* DestroySystemEventPort
+ * Cleans up the resources associated with the handle. This function is registered
+ * with the handle manager. */
+KERNELAPI OsStatus_t KERNELABI
+DestroySystemEventPort(
+    _In_ void*              Resource);
+
+/* EventSourceSignal
+ * Signals the events to all ports the source is attached to. Safe to call from
+ * interrupt context. Returns OsSuccess if any port was interested in the events. */
+KERNELAPI OsStatus_t KERNELABI
+EventSourceSignal(
+    _In_ EventSource_t*     Source,
+    _In_ Flags_t            Events);
+
+/* EventSourceDestroy
+ * Must be called before the object embedding the source is freed. All attached
+ * ports receive EVENT_HANGUP for the source. */
+KERNELAPI void KERNELABI
+EventSourceDestroy(
+    _In_ EventSource_t*     Source);
+
+#endif //! __EVENTPORT_INTERFACE__
@@ -26,9 +26,11 @@
 
 #include <os/osdefs.h>
 #include <ds/collection.h>
+#include <epoch.h>
 
 typedef enum _SystemHandleType {
     HandleTypeMemoryBuffer = 0,
+    HandleTypeEventPort,
 
     HandleTypeCount
 } SystemHandleType_t;
@@ -40,6 +42,7 @@ typedef struct _SystemHandle {
     SystemHandleType_t  Type;
     atomic_int          References;
     void*               Resource;
+    EpochItem_t         Retire;
 } SystemHandle_t;
 
 /* CreateHandle
@@ -58,7 +61,8 @@ AcquireHandle(
 
 /* LookupHandle
  * Retrieves the handle given for the calling process. This can fail if the handle
- * turns out to be invalid, otherwise the resource will be returned. */
+ * turns out to be invalid, otherwise the resource will be returned. The resource is
+ * only guaranteed to stay valid inside an epoch section, use AcquireHandle otherwise. */
 KERNELAPI void* KERNELABI
 LookupHandle(
     _In_ UUId_t             Handle);
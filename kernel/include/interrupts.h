@@ -34,6 +34,8 @@
 #include <os/ipc/ipc.h>
 #include <os/osdefs.h>
 #include <os/context.h>
+#include <eventport.h>
+#include <epoch.h>
 
 /* Special flags that are available only
  * in kernel context for special interrupts */
@@ -50,6 +52,8 @@ typedef struct _MCoreInterruptDescriptor {
 	UUId_t								Thread;
 	Flags_t								Flags;
 	int									Source;
+	EventSource_t						Events;
+	EpochItem_t							Retire;
 	struct _MCoreInterruptDescriptor	*Link;
 } MCoreInterruptDescriptor_t;
 
@@ -69,11 +73,22 @@ InterruptUnregister(
     _In_ UUId_t             Source);
 
 /* InterruptGet
- * Retrieves the given interrupt source information as a MCoreInterruptDescriptor_t */
+ * Retrieves the given interrupt source information as a MCoreInterruptDescriptor_t. The
+ * descriptor is only guaranteed to stay valid inside an epoch section. */
 KERNELAPI MCoreInterruptDescriptor_t* KERNELABI
 InterruptGet(
    _In_ UUId_t              Source);
 
+/* InterruptAttachEventPort
+ * Attaches the userspace interrupt with the given id to the event port, the
+ * interrupt must be owned by the calling process. */
+KERNELAPI OsStatus_t KERNELABI
+InterruptAttachEventPort(
+    _In_ UUId_t             Source,
+    _In_ UUId_t             Handle,
+    _In_ Flags_t            Events,
+    _In_ void*              Context);
+
 /* InterruptGetIndex
  * Retrieves the given interrupt source information as a MCoreInterruptDescriptor_t */
 KERNELAPI MCoreInterruptDescriptor_t* KERNELABI
@@ -128,6 +143,13 @@ InterruptGetLeastLoaded(
 	_In_ int                Irqs[],
 	_In_ int                Count);
 
+/* InterruptGetLeastLoadedCpu
+ * Selects the running core that message signaled interrupts should be targeted at.
+ * The affinity mask limits the candidates, a mask of 0 allows all cores. */
+KERNELAPI UUId_t KERNELABI
+InterruptGetLeastLoadedCpu(
+    _In_ Flags_t            AffinityMask);
+
 /* AcpiGetPolarityMode
  * Returns whether or not the polarity is Active Low or Active High.
  * For Active Low = 1, Active High = 0 */
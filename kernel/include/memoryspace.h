@@ -63,6 +63,13 @@
 #define MAPPING_LEGACY                  0x80000000  // (Virtual) Mapping is for legacy memory devices
 #define MAPPING_VMODE_MASK              0xF0000000
 
+/* SystemMemorySpace (Areas) Definitions
+ * Attributes of the virtual memory areas of a process heap. The low bits are the
+ * mapping flags that pages of the area are created with when touched. */
+#define MEMORY_AREA_MAPPING_MASK        0x0000007F
+#define MEMORY_AREA_RESERVED            0x00100000  // Address space is reserved, accesses are invalid
+#define MEMORY_AREA_COMMITTED           0x00200000  // Area is usable, pages are mapped on first access
+
 /* SystemMemorySpace
  * Represents a virtual memory space that can be used with MMIO
  * functionality on the architecture. */
@@ -40,11 +40,16 @@
 
 /* The module definition, it currently just
  * consists of the a ramdisk entry header and
- * a name/path */
+ * a name/path. The data is loaded on first use, 
+ * and points to the stored data until then */
 typedef struct _MCoreModule {
 	MString_t                   *Name;
     MCoreRamDiskModuleHeader_t   Header;
     __CONST void                *Data;
+    __CONST void                *StoredData;
+    size_t                       StoredLength;
+    int                          Compression;
+    volatile int                 Loaded;
 } MCoreModule_t;
 
 /* ModulesInitialize
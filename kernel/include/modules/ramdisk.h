@@ -33,6 +33,7 @@
 /* This is to identify which version of the
  * ramdisk is in use, and how to load data */
 #define RAMDISK_VERSION_1           0x01
+#define RAMDISK_VERSION_2           0x02
 
 /* Supported architectures, must of course match
  * the architecture the kernel has been compiled with */
@@ -86,4 +87,68 @@ PACKED_TYPESTRUCT(MCoreRamDiskModuleHeader, {
     uint32_t    DeviceSubType;
 });
 
+/* Version 2 of the ramdisk
+ * The header is followed by an index header, an entry table and three
+ * hash indices. Entry names are stored in a string table and the data 
+ * of each entry can be compressed. Lookups hash the key, and probe the
+ * index linearly from (Hash & (Buckets - 1)) until an empty slot. */
+#define RAMDISK_INDEX_EMPTY         0xFFFFFFFF
+
+/* The supported compression methods of an entry
+ * LZSS - Groups of 8 items led by a flag byte, starting from bit 0. A set
+ *        bit is a literal byte, a clear bit is a 16 bit little endian match
+ *        with the distance - 1 in the upper 12 bits and the length - 3 in
+ *        the lower 4 bits. Matches reference the decompressed output. */
+#define RAMDISK_COMPRESSION_NONE    0x0
+#define RAMDISK_COMPRESSION_LZSS    0x1
+
+#define RAMDISK_LZSS_MIN_MATCH      3
+#define RAMDISK_LZSS_MAX_MATCH      18
+#define RAMDISK_LZSS_WINDOW         4096
+
+/* Hashing of the index keys, FNV-1a. Names are hashed case-insensitive
+ * and device keys are hashed as two little endian 32 bit values */
+#define RAMDISK_HASH_INITIAL        0x811C9DC5
+#define RAMDISK_HASH_PRIME          0x01000193
+
+/* MCoreRamDiskIndexHeader
+ * Follows the ramdisk header in version 2, all offsets are
+ * from the start of the ramdisk. Bucket counts are powers of two. */
+PACKED_TYPESTRUCT(MCoreRamDiskIndexHeader, {
+    uint32_t    EntryTableOffset;
+    uint32_t    PathBuckets;
+    uint32_t    PathIndexOffset;        // Names of all entries
+    uint32_t    DeviceBuckets;
+    uint32_t    DeviceIndexOffset;      // VendorId/DeviceId of modules
+    uint32_t    ClassBuckets;
+    uint32_t    ClassIndexOffset;       // DeviceType/DeviceSubType of modules
+});
+
+/* MCoreRamDiskIndexSlot
+ * A slot in one of the hash indices, the entry is the index
+ * into the entry table or RAMDISK_INDEX_EMPTY */
+PACKED_TYPESTRUCT(MCoreRamDiskIndexSlot, {
+    uint32_t    Hash;
+    uint32_t    Entry;
+});
+
+/* MCoreRamDiskEntryV2
+ * The version 2 entry, the name is a null-terminated 
+ * UTF-8 string at NameOffset */
+PACKED_TYPESTRUCT(MCoreRamDiskEntryV2, {
+    uint32_t    NameOffset;
+    uint32_t    NameLength;
+    uint32_t    Type;
+    uint32_t    DataHeaderOffset;
+});
+
+/* MCoreRamDiskModuleHeaderV2
+ * The version 2 module header, length and crc of the base header
+ * describe the decompressed data. The stored data follows this header. */
+PACKED_TYPESTRUCT(MCoreRamDiskModuleHeaderV2, {
+    MCoreRamDiskModuleHeader_t  Base;
+    uint32_t                    Compression;
+    uint32_t                    StoredLength;
+});
+
 #endif //!_RAMDISK_H_
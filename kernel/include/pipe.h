@@ -21,6 +21,8 @@
  *      - Bounded MPMC / MPSC / SPMC
  *      - Unbounded MPMC / MPSC / SPMC
  *      - Bounded SPSC
+ *  - Raw SPSC pipes use a dedicated ring fast-path, which supports both
+ *    bounded and unbounded (segment chaining) modes
  */
 
 #ifndef __SYSTEM_PIPE__
@@ -28,12 +30,14 @@
 
 #include <os/osdefs.h>
 #include <semaphore_slim.h>
+#include <eventport.h>
 
 #define PIPE_DEFAULT_ENTRYCOUNT     8 // Logarithmic base of 2 value of workers
+#define PIPE_CACHELINE_SIZE         64
 
 // Default configuration if passing 0 is
 // Single Producer, Single Consumer, Bounded, Raw
-// Unbounded can only be used when the queue is not configured as SPSC
+// Unbounded SPSC is only supported for raw pipes
 #define PIPE_MULTIPLE_PRODUCERS     (1 << 0)
 #define PIPE_MULTIPLE_CONSUMERS     (1 << 1)
 #define PIPE_UNBOUNDED              (1 << 2)
@@ -57,11 +61,15 @@ typedef struct _SystemPipeEntry {
 typedef struct _SystemPipeSegmentBuffer {
     uint8_t*                Pointer;
     size_t                  Size;           // Must be a power of 2.
+    uint8_t                 Padding0[PIPE_CACHELINE_SIZE - sizeof(uint8_t*) - sizeof(size_t)];
 
-    atomic_uint             ReadPointer;
-    atomic_uint             ReadCommitted;
+    // Producer and consumer indices live on separate cache lines
     atomic_uint             WritePointer;
     atomic_uint             WriteCommitted;
+    uint8_t                 Padding1[PIPE_CACHELINE_SIZE - (2 * sizeof(atomic_uint))];
+    atomic_uint             ReadPointer;
+    atomic_uint             ReadCommitted;
+    uint8_t                 Padding2[PIPE_CACHELINE_SIZE - (2 * sizeof(atomic_uint))];
 } SystemPipeSegmentBuffer_t;
 
 /* SystemPipeSegment
@@ -76,23 +84,36 @@ typedef struct _SystemPipeSegment {
 } SystemPipeSegment_t;
 
 /* SystemPipeProducer
- * A producer for a system pipe, describes the current producer state. */
+ * A producer for a system pipe, describes the current producer state. For raw
+ * SPSC pipes it also caches the last seen read index of the consumer, and
+ * Waiting is used as the sleep object when the producer waits for space. */
 typedef struct _SystemPipeProducer {
     _Atomic(SystemPipeSegment_t*)   Tail;
     atomic_uint                     Ticket;
+    unsigned int                    CachedIndex;
+    atomic_int                      Waiting;
+    uint8_t                         Padding[PIPE_CACHELINE_SIZE - sizeof(void*) - 
+        sizeof(atomic_uint) - sizeof(unsigned int) - sizeof(atomic_int)];
 } SystemPipeProducer_t;
 
 /* SystemPipeConsumer
- * A consumer for a system pipe, describes the current consumer state. */
+ * A consumer for a system pipe, describes the current consumer state. For raw
+ * SPSC pipes it also caches the last seen write index of the producer, and
+ * Waiting is used as the sleep object when the consumer waits for data. */
 typedef struct _SystemPipeConsumer {
     _Atomic(SystemPipeSegment_t*)   Head;
     atomic_uint                     Ticket;
+    unsigned int                    CachedIndex;
+    atomic_int                      Waiting;
+    uint8_t                         Padding[PIPE_CACHELINE_SIZE - sizeof(void*) - 
+        sizeof(atomic_uint) - sizeof(unsigned int) - sizeof(atomic_int)];
 } SystemPipeConsumer_t;
 
 /* SystemPipeUserState
  * State structure used when reading or writing for queues that support
  * more functionality than SPSC. */
 typedef struct _SystemPipeUserState {
+    struct _SystemPipe*             Pipe;
     SystemPipeSegment_t*            Segment;
     unsigned int                    Index;
     int                             Advance;
@@ -100,11 +121,15 @@ typedef struct _SystemPipeUserState {
 
 /* SystemPipe
  * A system pipe is the prefered way of communcation between processes.
- * It contains a number of segments, which in turn contains entries that can be used. */
+ * It contains a number of segments, which in turn contains entries that can be used.
+ * Event ports attached to the pipe are signalled with EVENT_READABLE on writes. */
 typedef struct _SystemPipe {
     Flags_t                 Configuration;
     size_t                  Stride;
     size_t                  SegmentLgSize;
+    EventSource_t           Events;
+    uint8_t                 Padding[PIPE_CACHELINE_SIZE - sizeof(Flags_t) - 
+        (2 * sizeof(size_t)) - sizeof(EventSource_t)];
 
     SystemPipeConsumer_t    ConsumerState;
     SystemPipeProducer_t    ProducerState;
@@ -132,7 +157,8 @@ DestroySystemPipe(
     _In_ SystemPipe_t*              Pipe);
 
 /* ReadSystemPipe
- * Performs raw reading that can only be used on pipes opened in SPSC mode. */
+ * Performs generic reading from a system pipe. Raw pipes return as soon as
+ * any data has been read, but drain as much as is available up to Length. */
 KERNELAPI size_t KERNELABI
 ReadSystemPipe(
     _In_ SystemPipe_t*              Pipe,
@@ -140,7 +166,8 @@ ReadSystemPipe(
     _In_ size_t                     Length);
 
 /* WriteSystemPipe
- * Performs raw writing that can only be used on pipes opened in SPSC mode. */
+ * Performs generic writing to a system pipe. Raw pipes block until all data
+ * has been written unless PIPE_NOBLOCK is set. */
 KERNELAPI size_t KERNELABI
 WriteSystemPipe(
     _In_ SystemPipe_t*              Pipe,
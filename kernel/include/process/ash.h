@@ -24,13 +24,15 @@
 #define _MCORE_ASH_H_
 
 #include <os/osdefs.h>
-#include <ds/blbitmap.h>
+#include <ds/rangetree.h>
 #include <ds/mstring.h>
 #include <ds/collection.h>
 
 #include <criticalsection.h>
+#include <epoch.h>
 #include <memorybuffer.h>
 #include <memoryspace.h>
+#include <eventport.h>
 #include <process/pe.h>
 #include <pipe.h>
 
@@ -45,7 +47,10 @@ typedef enum _MCoreAshType {
 } MCoreAshType_t;
 
 // File Mapping Support
-// Provides file-mapping support for processes.
+// Provides file-mapping support for processes. Image mappings back the sections
+// of loaded executables, they are paged in by the faulting thread and never flushed.
+#define FILE_MAPPING_IMAGE      0x80000000
+
 typedef struct _MCoreAshFileMapping {
     CollectionItem_t    Header;
     DmaBuffer_t         BufferObject;
@@ -54,6 +59,7 @@ typedef struct _MCoreAshFileMapping {
     uint64_t            BlockOffset;
     size_t              Length;
     Flags_t             Flags;
+    MCorePeFile_t*      Image;
 } MCoreAshFileMapping_t;
 
 /* The phoenix base structure, this contains
@@ -71,11 +77,13 @@ typedef struct _MCoreAsh {
     MString_t*              Path;
     Collection_t*           Pipes;
     Collection_t*           FileMappings;
+    EventSource_t           Events;
+    EpochItem_t             Retire;
 
     // Memory management and information,
     // Ashes run in their own space, and have their own bitmap allocators
     SystemMemorySpace_t*    MemorySpace;
-    BlockBitmap_t*          Heap;
+    RangeTree_t*            Heap;
     uintptr_t               SignalHandler;
 
     // Below is everything related to
@@ -184,11 +192,26 @@ PhoenixFileMappingEvent(
     _In_ MCoreAshFileMappingEvent_t* Event);
 
 /* PhoenixGetAsh
- * This function looks up a ash structure by the given id */
+ * This function looks up a ash structure by the given id. The ash is only
+ * guaranteed to stay valid inside an epoch section, or if it's the process of
+ * the calling thread. Use PhoenixAcquireAsh otherwise. */
 KERNELAPI MCoreAsh_t* KERNELABI
 PhoenixGetAsh(
     _In_ UUId_t AshId);
 
+/* PhoenixAcquireAsh
+ * Looks up the ash by the given id and takes a reference to it, the ash stays
+ * valid untill the reference is released with PhoenixReleaseAsh. */
+KERNELAPI MCoreAsh_t* KERNELABI
+PhoenixAcquireAsh(
+    _In_ UUId_t AshId);
+
+/* PhoenixReleaseAsh
+ * Releases a reference to the ash, the last reference hands it to the gc. */
+KERNELAPI void KERNELABI
+PhoenixReleaseAsh(
+    _In_ MCoreAsh_t* Ash);
+
 /* PhoenixGetCurrentAsh
  * Retrives the current ash for the running thread */
 KERNELAPI MCoreAsh_t* KERNELABI
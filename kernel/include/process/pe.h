@@ -31,6 +31,8 @@
 /* Includes
  * - System */
 #include <os/process.h>
+#include <os/buffer.h>
+#include <semaphore_slim.h>
 
 /* We define some helpers in order to determine 
  * some information about the current build, this
@@ -74,8 +76,16 @@ typedef struct _MCorePeFile {
     int                      NumberOfExportedFunctions;
     MCorePeExportFunction_t *ExportedFunctions;
     Collection_t            *LoadedLibraries;
+
+    // Images loaded from the filesystem keep the file open, sections
+    // are paged in from it on first touch through image file-mappings
+    UUId_t                   FileHandle;
+    DmaBuffer_t              FileTransfer;
+    SlimSemaphore_t          FileLock;
 } MCorePeFile_t;
 
+struct _MCoreAshFileMapping;
+
 /* PeValidate
  * Validates a file-buffer of the given length,
  * does initial header checks and performs a checksum
@@ -86,6 +96,15 @@ PeValidate(
     _In_ uint8_t *Buffer, 
     _In_ size_t Length);
 
+/* PeValidateHeaders
+ * Validates the headers and section table of the image, the buffer only
+ * needs to contain the leading part of the file. Returns either PE_INVALID or PE_VALID */
+__EXTERN 
+int
+PeValidateHeaders(
+    _In_ uint8_t *Buffer, 
+    _In_ size_t Length);
+
 /* PeResolveLibrary
  * Resolves a dependancy or a given module path, a load address must be provided
  * together with a pe-file header to fill out and the parent that wants to resolve
@@ -110,12 +129,15 @@ PeResolveFunction(
 /* PeLoadImage
  * Loads the given file-buffer as a pe image into the current address space 
  * at the given Base-Address, which is updated after load to reflect where
- * the next address is available for load */
+ * the next address is available for load. If a file handle is given the buffer
+ * only holds the headers and the sections are paged in from the file, the image
+ * takes ownership of the handle */
 __EXTERN
 MCorePeFile_t*
 PeLoadImage(
     _In_ MCorePeFile_t *Parent, 
     _In_ MString_t *Name, 
+    _In_ UUId_t FileHandle, 
     _In_ uint8_t *Buffer, 
     _In_ size_t Length, 
     _InOut_ uintptr_t *BaseAddress, 
@@ -137,6 +159,18 @@ OsStatus_t
 PeUnloadImage(
     _In_ MCorePeFile_t *Executable);
 
+/* PeImagePageIn
+ * Reads in the page of an image file-mapping that contains the address in the
+ * current memory space. Pages are mapped with the protection of their section
+ * unless <Writable> is set, which also makes an already present page writable. */
+KERNELAPI
+OsStatus_t
+KERNELABI
+PeImagePageIn(
+    _In_ struct _MCoreAshFileMapping *Mapping,
+    _In_ uintptr_t Address,
+    _In_ int Writable);
+
 /* PeGetModuleHandles
  * Retrieves a list of loaded module handles currently loaded for the process. */
 KERNELAPI
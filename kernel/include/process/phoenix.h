@@ -113,6 +113,15 @@ KERNELABI
 PhoenixUpdateAlias(
     _InOut_ UUId_t *AshId);
 
+/* PhoenixIsAshAliased
+ * Returns OsSuccess if the given ash has registered an alias,
+ * which is what marks a process as a system service. */
+KERNELAPI
+OsStatus_t
+KERNELABI
+PhoenixIsAshAliased(
+    _In_ MCoreAsh_t *Ash);
+
 /* PhoenixRegisterAsh
  * Registers a new ash by adding it to the process-list */
 KERNELAPI
@@ -64,7 +64,8 @@ PhoenixCleanupProcess(
     _In_ MCoreProcess_t *Process);
 
 /* PhoenixGetProcess
- * This function looks up a server structure by id */
+ * This function looks up a process structure by id, the process is returned with
+ * a reference that must be released with PhoenixReleaseAsh */
 KERNELAPI
 MCoreProcess_t*
 KERNELABI
@@ -82,7 +83,8 @@ PhoenixGetCurrentProcess(void);
 /* PhoenixGetWorkingDirectory
  * This function looks up the working directory for a process 
  * by id, if either PROCESS_CURRENT or PROCESS_NO_PROCESS 
- * is passed, it retrieves the current process's working directory */
+ * is passed, it retrieves the current process's working directory.
+ * The string is owned by the process and lives only as long as it does. */
 KERNELAPI
 MString_t*
 KERNELABI
@@ -92,7 +94,8 @@ PhoenixGetWorkingDirectory(
 /* PhoenixGetBaseDirectory
  * This function looks up the base directory for a process 
  * by id, if either PROCESS_CURRENT or PROCESS_NO_PROCESS 
- * is passed, it retrieves the current process's base directory */
+ * is passed, it retrieves the current process's base directory.
+ * The string is owned by the process and lives only as long as it does. */
 MString_t*
 PhoenixGetBaseDirectory(
     _In_ UUId_t ProcessId);
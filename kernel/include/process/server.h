@@ -66,7 +66,8 @@ PhoenixCleanupServer(
     _In_ MCoreServer_t *Server);
 
 /* PhoenixGetServer
- * This function looks up a server structure by id */
+ * This function looks up a server structure by id, the server is returned with
+ * a reference that must be released with PhoenixReleaseAsh */
 KERNELAPI
 MCoreServer_t*
 KERNELABI
@@ -83,7 +84,8 @@ PhoenixGetCurrentServer(void);
 
 /* GetServerByDriver
  * Retrieves a running server by driver-information
- * to avoid spawning multiple servers */
+ * to avoid spawning multiple servers. The server is returned with
+ * a reference that must be released with PhoenixReleaseAsh */
 KERNELAPI
 MCoreServer_t*
 KERNELABI
@@ -0,0 +1,82 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - Sampling Profiler Interface
+ * - Samples the instruction pointer and call stack of the running thread
+ *   from the scheduler timer and exports them as symbolized folded stacks
+ */
+
+#ifndef _MCORE_PROFILER_H_
+#define _MCORE_PROFILER_H_
+
+#include <os/osdefs.h>
+#include <os/context.h>
+
+/* Profiler Definitions
+ * Limits for the sample buffers, every core gets its own ring-buffer of
+ * samples so the timer interrupt never has to synchronize with other cores. */
+#define PROFILER_MAX_CORES              64
+#define PROFILER_MAX_FRAMES             16
+#define PROFILER_SAMPLES_PER_CORE       2048
+#define PROFILER_DEFAULT_INTERVAL       1
+
+/* ProfilerSample
+ * A single captured sample, Frames[0] is the interrupted instruction and the
+ * rest are return addresses, from the innermost to the outermost frame. */
+typedef struct _ProfilerSample {
+    UUId_t                  ThreadId;
+    UUId_t                  AshId;
+    size_t                  Depth;
+    uintptr_t               Frames[PROFILER_MAX_FRAMES];
+} ProfilerSample_t;
+
+/* ProfilerStart
+ * Allocates the sample buffers for all cores and enables sampling on every
+ * <Interval>'th timer tick. Existing samples are kept. */
+KERNELAPI OsStatus_t KERNELABI
+ProfilerStart(
+    _In_ size_t             Interval);
+
+/* ProfilerStop
+ * Disables sampling, the samples captured stay available for reading */
+KERNELAPI OsStatus_t KERNELABI
+ProfilerStop(void);
+
+/* ProfilerReset
+ * Discards all samples captured and resets the statistics */
+KERNELAPI OsStatus_t KERNELABI
+ProfilerReset(void);
+
+/* ProfilerSampleContext
+ * Captures a sample of the interrupted context on the current core. Must be called
+ * from the timer interrupt before the scheduler switches the context. */
+KERNELAPI void KERNELABI
+ProfilerSampleContext(
+    _In_ Context_t*         Context);
+
+/* ProfilerRead
+ * Drains captured samples into the buffer as symbolized folded stacks, one line
+ * per sample in the form 'process;outer;...;inner 1'. Only complete lines are
+ * written, <BytesRead> is 0 when there are no samples left. */
+KERNELAPI OsStatus_t KERNELABI
+ProfilerRead(
+    _In_  char*             Buffer,
+    _In_  size_t            Length,
+    _Out_ size_t*           BytesRead);
+
+#endif //!_MCORE_PROFILER_H_
@@ -25,6 +25,9 @@
  * On yields, keep priority.
  * On task-switchs, decrease priority.
  * A thread can only stay a maximum in each priority.
+ * Real-time threads run at a fixed level before any normal priority,
+ * they are never demoted or boosted.
+ * Waiters lend their priority to the thread they wait on.
  */
 
 #ifndef _MCORE_SCHEDULER_H_
@@ -40,6 +43,10 @@
 #define SCHEDULER_LEVEL_CRITICAL        60
 #define SCHEDULER_LEVEL_COUNT           61
 #define SCHEDULER_TIMESLICE_INITIAL     10
+#define SCHEDULER_TIMESLICE_REALTIME    5
+#define SCHEDULER_REALTIME_COUNT        8
+#define SCHEDULER_RANK_NONE             -1
+#define SCHEDULER_INHERIT_RPC           ((uintptr_t)1)  // Source of the rank lent by rpc callers
 #define SCHEDULER_BOOST                 3000
 
 #define SCHEDULER_CPU_SELECT            0xFF
@@ -50,7 +57,8 @@
 #define SCHEDULER_SLEEP_SYNC_FAILED     3
 
 /* MCoreSchedulerQueue
- * Represents a queue level in the scheduler. */
+ * Represents a queue level in the scheduler. A thread in a ready queue records the
+ * queue it is in, and the record is only changed with the queue lock held. */
 typedef struct _MCoreSchedulerQueue {
     MCoreThread_t*      Head;
     MCoreThread_t*      Tail;
@@ -59,8 +67,10 @@ typedef struct _MCoreSchedulerQueue {
 
 /* MCoreScheduler
  * The core scheduler, contains information needed
- * to keep track of active threads and priority queues. */
+ * to keep track of active threads and priority queues. The queues are ordered
+ * by rank, the real-time queues come first followed by the normal queues. */
 typedef struct _MCoreScheduler {
+    SchedulerQueue_t    RealtimeQueues[SCHEDULER_REALTIME_COUNT];
     SchedulerQueue_t    Queues[SCHEDULER_LEVEL_COUNT];
     size_t              BoostTimer;
     int                 ThreadCount;
@@ -93,6 +103,39 @@ KERNELAPI OsStatus_t KERNELABI
 SchedulerThreadDequeue(
     _In_ MCoreThread_t*     Thread);
 
+/* SchedulerThreadSetRealtime
+ * Moves the thread into the real-time class at the given fixed level, where level 0
+ * is the most urgent. A level of SCHEDULER_RANK_NONE returns the thread to the normal class. */
+KERNELAPI OsStatus_t KERNELABI
+SchedulerThreadSetRealtime(
+    _In_ MCoreThread_t*     Thread,
+    _In_ int                Level);
+
+/* SchedulerThreadGetRank
+ * Returns the rank the thread currently runs at, lower ranks are more urgent. The
+ * real-time levels rank before the normal queues. */
+KERNELAPI int KERNELABI
+SchedulerThreadGetRank(
+    _In_ MCoreThread_t*     Thread);
+
+/* SchedulerThreadInherit
+ * Lends <Rank> to <Thread> through <Source>, the object the donors wait on <Thread> for.
+ * Each source lends the most urgent rank given through it, and the thread runs at the
+ * most urgent of its own rank and the ranks of all its sources. */
+KERNELAPI void KERNELABI
+SchedulerThreadInherit(
+    _In_ MCoreThread_t*     Thread,
+    _In_ int                Rank,
+    _In_ uintptr_t          Source);
+
+/* SchedulerThreadDisinherit
+ * Drops the rank lent through <Source>, the thread continues at the most urgent
+ * rank still lent to it by other sources, or its own. */
+KERNELAPI void KERNELABI
+SchedulerThreadDisinherit(
+    _In_ MCoreThread_t*     Thread,
+    _In_ uintptr_t          Source);
+
 /* SchedulerThreadSleep
  * Enters the current thread into sleep-queue. Can return different
  * sleep-state results. SCHEDULER_SLEEP_OK or SCHEDULER_SLEEP_TIMEOUT. */
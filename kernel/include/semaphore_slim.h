@@ -30,10 +30,16 @@
 /* SlimSemaphore
  * Contains only the absolute minimum for a semaphore. This is to create
  * a semaphore structure where memory needs to be kept to a minmimum.
- * Integrated usage only. No destruction for this. */
+ * Integrated usage only. No destruction for this. A semaphore constructed with
+ * both values set to 1 is used as a lock, and tracks the thread that holds it
+ * so waiters can lend it their priority. Waiters also leave their rank behind
+ * for holders that have not published themselves as owner yet. */
 typedef struct _SlimSemaphore {
 	atomic_int          Value;
     int                 MaxValue;
+    int                 Exclusive;
+    _Atomic(UUId_t)     Owner;
+    atomic_int          WaiterRank;
 } SlimSemaphore_t;
 
 /* SlimSemaphoreConstruct
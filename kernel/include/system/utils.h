@@ -55,6 +55,13 @@ CpuHalt(void);
 KERNELAPI size_t KERNELABI
 CpuGetTicks(void);
 
+/* CpuReadTimestampCounter
+ * Reads the cpu timestamp counter. Fails if the counter does not tick at a constant
+ * rate regardless of the power state, or if it can't be read from usermode. */
+KERNELAPI OsStatus_t KERNELABI
+CpuReadTimestampCounter(
+    _Out_ uint64_t* Value);
+
 /* CpuGetTime
  * Retrieves the time for the system. */
 KERNELAPI OsStatus_t KERNELABI
@@ -28,6 +28,8 @@
 #include <os/context.h>
 #include <ds/collection.h>
 #include <memoryspace.h>
+#include <eventport.h>
+#include <epoch.h>
 #include <pipe.h>
 #include <signal.h>
 #include <time.h>
@@ -47,6 +49,7 @@ typedef void(*ThreadEntry_t)(void*);
 #define THREADING_CONTEXT_SIGNAL1       3   // Signal (Application)
 #define THREADING_NUMCONTEXTS           4
 #define THREADING_CONFIGDATA_COUNT      4
+#define THREADING_INHERIT_SOURCES       4
 
 /* MCoreThread::Flags Bit Definitions 
  * The first two bits denode the thread
@@ -99,13 +102,18 @@ typedef struct _MCoreSignal {
 
 /* The different possible threading priorities 
  * Normal is the default thread-priority, and Critical
- * should only be used by the system */
+ * should only be used by the system. Realtime threads run at
+ * a fixed level that is never changed by the scheduler */
 typedef enum _MCoreThreadPriority {
     PriorityLow,
     PriorityNormal,
-    PriorityCritical
+    PriorityCritical,
+    PriorityRealtime
 } MCoreThreadPriority_t;
 
+/* Forward declaration of the scheduler queue */
+struct _MCoreSchedulerQueue;
+
 /* MCoreThread
  * The representation of a thread in the system. Contains scheduling information,
  * thread information and data for contexts and signals. */
@@ -122,11 +130,15 @@ typedef struct _MCoreThread {
     uintptr_t               Data[THREADING_CONFIGDATA_COUNT];
 
     SystemPipe_t*           Pipe;
+    UUId_t                  RpcTarget;      // Process the thread awaits a rpc-response from
     SystemMemorySpace_t*    MemorySpace;
 
     ThreadEntry_t           Function;
     void*                   Arguments;
     int                     RetCode;
+    EventSource_t           Events;
+    EpochItem_t             Retire;
+    atomic_int              References;
 
     // Signal Support
     int                     SignalInformation[NUMSIGNALS];
@@ -138,12 +150,19 @@ typedef struct _MCoreThread {
     MCoreThreadPriority_t   Priority;
     size_t                  TimeSlice;
     int                     Queue;
+    int                     RealtimeLevel;
+    int                     InheritedRank;
+    struct {
+        uintptr_t           Source;
+        int                 Rank;
+    }                       Inherited[THREADING_INHERIT_SOURCES];
     struct {
         uintptr_t*          Handle;
         int                 Timeout;
         size_t              TimeLeft;
         clock_t             InterruptedAt;
     }                       Sleep;
+    struct _MCoreSchedulerQueue* ReadyQueue;
     struct _MCoreThread*    Link;
 } MCoreThread_t;
 
@@ -237,11 +256,26 @@ KERNELAPI UUId_t KERNELABI
 ThreadingGetCurrentThreadId(void);
 
 /* ThreadingGetThread
- * Lookup thread by the given thread-id, returns NULL if invalid */
+ * Lookup thread by the given thread-id, returns NULL if invalid. The thread is
+ * only guaranteed to stay valid inside an epoch section, use ThreadingAcquireThread
+ * when it's used outside of one. */
 KERNELAPI MCoreThread_t* KERNELABI
 ThreadingGetThread(
     _In_ UUId_t         ThreadId);
 
+/* ThreadingAcquireThread
+ * Lookup thread by the given thread-id and takes a reference to it, the thread stays
+ * valid untill the reference is released with ThreadingReleaseThread. */
+KERNELAPI MCoreThread_t* KERNELABI
+ThreadingAcquireThread(
+    _In_ UUId_t         ThreadId);
+
+/* ThreadingReleaseThread
+ * Releases a reference to the thread, the last reference queues its cleanup. */
+KERNELAPI void KERNELABI
+ThreadingReleaseThread(
+    _In_ MCoreThread_t* Thread);
+
 /* ThreadingWakeCpu
  * Wake's the target cpu from an idle thread by sending it an yield IPI */
 KERNELAPI void KERNELABI
@@ -27,8 +27,16 @@
 /* Includes
  * - System */
 #include <os/osdefs.h>
+#include <os/sharedpage.h>
+#include <memoryspace.h>
+#include <eventport.h>
 #include <time.h>
 
+/* Shared page synchronization
+ * How often (in system ticks) the slow sources are sampled for the shared page. */
+#define TIMERS_TIMESTAMP_SYNC_INTERVAL  1000
+#define TIMERS_WALLCLOCK_SYNC_INTERVAL  60000
+
 /* MCoreTimePerformanceOps
  * The two kinds of time-operations timers can
  * support for high performance timers. */
@@ -40,7 +48,8 @@ typedef struct _MCoreTimePerformanceOps {
 
 /* MCoreTimer
  * The timer structure, contains information about
- * the owner, the timeout and the type of timer. */
+ * the owner, the timeout and the type of timer. Timers that
+ * are attached to an event port do not send timeout events. */
 typedef struct _MCoreTimer {
     UUId_t              Id;
     UUId_t              AshId;
@@ -49,6 +58,7 @@ typedef struct _MCoreTimer {
     size_t              Interval;
     volatile size_t     Current;
     int                 Periodic;
+    EventSource_t       Events;
 } MCoreTimer_t;
 
 /* MCoreSystemTimer
@@ -61,6 +71,19 @@ typedef struct _MCoreSystemTimer {
     clock_t             (*SystemTick)(void);
 } MCoreSystemTimer_t;
 
+/* TimersInitialize
+ * Creates the shared system page, must be called before any processes are
+ * created and before timers are registered. */
+KERNELAPI OsStatus_t KERNELABI
+TimersInitialize(void);
+
+/* TimersMapSharedPage
+ * Maps the shared system page read-only into the given memory space at the location
+ * defined by the memory map. */
+KERNELAPI OsStatus_t KERNELABI
+TimersMapSharedPage(
+    _In_ SystemMemorySpace_t* MemorySpace);
+
 /* TimersRegisterSystemTimer 
  * Registrates a interrupt timer source with the
  * timer management, which keeps track of which interrupts
@@ -100,6 +123,16 @@ KERNELAPI OsStatus_t KERNELABI
 TimersStop(
     _In_ UUId_t TimerId);
 
+/* TimersAttachEventPort
+ * Attaches the timer with the given id to the event port, the timer must be owned
+ * by the requesting process. */
+KERNELAPI OsStatus_t KERNELABI
+TimersAttachEventPort(
+    _In_ UUId_t         TimerId,
+    _In_ UUId_t         Handle,
+    _In_ Flags_t        Events,
+    _In_ void*          Context);
+
 /* TimersInterrupt
  * Called by the interrupt-code to tell the timer-management system
  * a new interrupt has occured from the given source. This allows
@@ -25,11 +25,13 @@
 //#define __TRACE
 
 #include <component/cpu.h>
+#include <machine.h>
 #include <system/interrupts.h>
 #include <system/thread.h>
 #include <system/utils.h>
 #include <process/phoenix.h>
 #include <interrupts.h>
+#include <epoch.h>
 #include <threading.h>
 #include <timers.h>
 #include <assert.h>
@@ -148,6 +150,67 @@ InterruptGetLeastLoaded(
     return SelectedIrq;
 }
 
+/* InterruptGetCpuLoad
+ * Counts the message signaled interrupts that are targeted at the given cpu. */
+static int
+InterruptGetCpuLoad(
+    _In_ UUId_t CoreId)
+{
+    // Variables
+    MCoreInterruptDescriptor_t *Entry;
+    int Load = 0;
+    int i;
+
+    EpochEnter();
+    for (i = INTERRUPT_PHYSICAL_BASE; i < INTERRUPT_PHYSICAL_END; i++) {
+        Entry = InterruptTable[i].Descriptor;
+        while (Entry != NULL) {
+            if ((Entry->Flags & INTERRUPT_MSI) && Entry->Interrupt.MsiCpu == CoreId) {
+                Load++;
+            }
+            Entry = Entry->Link;
+        }
+    }
+    EpochLeave();
+    return Load;
+}
+
+/* InterruptGetLeastLoadedCpu
+ * Returns the running core, allowed by the affinity mask, that has the
+ * fewest message signaled interrupts targeted at it. */
+UUId_t
+InterruptGetLeastLoadedCpu(
+    _In_ Flags_t AffinityMask)
+{
+    // Variables
+    SystemCpu_t *Processor  = &GetMachine()->Processor;
+    UUId_t Selected         = CpuGetCurrentId();
+    int SelectedLoad        = -1;
+    int i;
+
+    while (Processor != NULL) {
+        for (i = 0; i < Processor->NumberOfCores; i++) {
+            SystemCpuCore_t *Core = (i == 0) ? &Processor->PrimaryCore : &Processor->ApplicationCores[i - 1];
+            int Load;
+            if (!(Core->State & CpuStateRunning)) {
+                continue;
+            }
+            if (AffinityMask != 0 && (Core->Id >= (sizeof(Flags_t) * 8) 
+                || !(AffinityMask & (1 << Core->Id)))) {
+                continue;
+            }
+
+            Load = InterruptGetCpuLoad(Core->Id);
+            if (SelectedLoad == -1 || Load < SelectedLoad) {
+                Selected        = Core->Id;
+                SelectedLoad    = Load;
+            }
+        }
+        Processor = Processor->Link;
+    }
+    return Selected;
+}
+
 /* InterruptRegister
  * Tries to allocate the given interrupt source
  * by the given descriptor and flags. On success
@@ -177,12 +240,19 @@ InterruptRegister(
     Entry->Thread   = ThreadingGetCurrentThreadId();
     Entry->Flags    = Flags;
     Entry->Link     = NULL;
+    Entry->Events.Registrations = NULL;
 
     // Clear out line if the interrupt is software
     if (Flags & INTERRUPT_SOFT) {
         Interrupt->Line = INTERRUPT_NONE;
     }
 
+    // Message signaled interrupts own their vector
+    if (Flags & INTERRUPT_MSI) {
+        Flags           |= INTERRUPT_NOTSHARABLE;
+        Entry->Flags    = Flags;
+    }
+
     // Get process id?
     if (!(Flags & INTERRUPT_KERNEL)) {
         Entry->Ash = ThreadingGetCurrentThread(CpuGetCurrentId())->AshId;
@@ -194,7 +264,7 @@ InterruptRegister(
         goto Error;
     }
     else {
-        Entry->Source = Interrupt->Line;
+        Entry->Source = (Flags & INTERRUPT_MSI) ? INTERRUPT_NONE : Interrupt->Line;
         Entry->Id |= TableIndex;
     }
 
@@ -278,7 +348,7 @@ InterruptUnregister(
         if (Entry->Id == Source) {
             if (!(Entry->Flags & INTERRUPT_KERNEL)) {
                 if (Entry->Ash != ThreadingGetCurrentThread(CpuGetCurrentId())->AshId) {
-                    continue;
+                    break;
                 }
             }
 
@@ -304,25 +374,27 @@ InterruptUnregister(
         return OsError;
     }
     
-    // Decrease penalty
-    if (Entry->Source != INTERRUPT_NONE) {
-        InterruptDecreasePenalty(Entry->Source);
-    }
+    // Decrease penalty, it's tracked per table index
+    InterruptDecreasePenalty(TableIndex);
 
     // Entry is now unlinked, clean it up 
     // mask the interrupt again if neccessary
-    if (Found == 1) {
-        if (InterruptTable[Entry->Source].Penalty == 0) {
-            InterruptConfigure(Entry, 0);
-        }
-        kfree(Entry);
+    if (InterruptTable[TableIndex].Penalty == 0) {
+        InterruptConfigure(Entry, 0);
     }
+    EventSourceDestroy(&Entry->Events);
+
+    // The chains are walked without the lock, so the entry is
+    // released once no interrupt can be standing on it
+    EpochDefer(&Entry->Retire, kfree, Entry);
+    Result = OsSuccess;
     return Result;
 }
 
 /* InterruptGet
  * Retrieves the given interrupt source information
- * as a MCoreInterruptDescriptor_t */
+ * as a MCoreInterruptDescriptor_t. The descriptor is only
+ * guaranteed to stay valid inside an epoch section. */
 MCoreInterruptDescriptor_t*
 InterruptGet(
     _In_ UUId_t Source)
@@ -331,16 +403,59 @@ InterruptGet(
     MCoreInterruptDescriptor_t *Iterator = NULL;
     uint16_t TableIndex = LOWORD(Source);
 
+    // Sanitize parameter
+    if (TableIndex >= MAX_SUPPORTED_INTERRUPTS) {
+        return NULL;
+    }
+
     // Iterate at the correct entry
+    EpochEnter();
     Iterator = InterruptTable[TableIndex].Descriptor;
     while (Iterator != NULL) {
         if (Iterator->Id == Source) {
-            return Iterator;
+            break;
         }
+        Iterator = Iterator->Link;
     }
+    EpochLeave();
+    return Iterator;
+}
 
-    // We didn't find it
-    return NULL;
+/* InterruptAttachEventPort
+ * Attaches the userspace interrupt with the given id to the event port, the
+ * interrupt must be owned by the calling process. The table lock is held across
+ * the attach so the interrupt can not be unregistered inbetween. */
+OsStatus_t
+InterruptAttachEventPort(
+    _In_ UUId_t             Source,
+    _In_ UUId_t             Handle,
+    _In_ Flags_t            Events,
+    _In_ void*              Context)
+{
+    // Variables
+    MCoreInterruptDescriptor_t *Entry   = NULL;
+    OsStatus_t Result                   = OsError;
+    uint16_t TableIndex                 = LOWORD(Source);
+
+    // Sanitize parameter
+    if (TableIndex >= MAX_SUPPORTED_INTERRUPTS) {
+        return OsError;
+    }
+
+    CriticalSectionEnter(&InterruptTableSyncObject);
+    Entry = InterruptTable[TableIndex].Descriptor;
+    while (Entry != NULL) {
+        if (Entry->Id == Source) {
+            if ((Entry->Flags & INTERRUPT_USERSPACE) && Entry->Ash == PhoenixGetCurrentAsh()->Id) {
+                Result = AttachSystemEventPort(Handle, &Entry->Events,
+                    EVENTPORT_SOURCE_INTERRUPT, Source, Events, Context);
+            }
+            break;
+        }
+        Entry = Entry->Link;
+    }
+    CriticalSectionLeave(&InterruptTableSyncObject);
+    return Result;
 }
 
 /* InterruptGetIndex
@@ -396,7 +511,8 @@ InterruptHandle(
     // Initiate values
     Start = Current = ThreadingGetCurrentThread(CpuGetCurrentId());
 
-    // Iterate handlers in that table index
+    // Iterate handlers in that table index, the chain is read without locks
+    EpochEnter();
     Entry = InterruptTable[TableIndex].Descriptor;
     if (Entry != NULL) {
         *Source = Entry->Source;
@@ -436,9 +552,12 @@ InterruptHandle(
                 TimersInterrupt(Entry->Id);
 
                 // Send a interrupt-event to this
-                // and mark as handled, so we don't spit out errors
+                // and mark as handled, so we don't spit out errors. Event ports
+                // waiting for the interrupt replaces the event
                 if (Entry->Flags & INTERRUPT_USERSPACE) {
-                    __KernelInterruptDriver(Entry->Ash, Entry->Id, Entry->Interrupt.Data);
+                    if (EventSourceSignal(&Entry->Events, EVENT_INTERRUPT) != OsSuccess) {
+                        __KernelInterruptDriver(Entry->Ash, Entry->Id, Entry->Interrupt.Data);
+                    }
                 }
 
                 // Update state to avoid a new impersionation
@@ -450,6 +569,7 @@ InterruptHandle(
         // Move on to next entry
         Entry = Entry->Link;
     }
+    EpochLeave();
 
     // We might have to restore context
     if (Start->MemorySpace != Current->MemorySpace) {
@@ -213,6 +213,12 @@ InitializeMachine(
         ERROR(" > no ramdisk provided, operating system will enter debug mode");
     }
 
+    // The shared system page must exist before timers and processes are created
+    Status = TimersInitialize();
+    if (Status != OsSuccess) {
+        ERROR("Failed to create the shared system page.");
+    }
+
     // Initialize interrupt systems
     TRACE("SYSTEM_FEATURE_INTERRUPTS");
     Status = SystemFeaturesInitialize(&Machine.BootInformation, SYSTEM_FEATURE_INTERRUPTS);
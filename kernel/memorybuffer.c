@@ -85,8 +85,8 @@ CreateMemoryBuffer(
         case MEMORY_BUFFER_FILEMAPPING: {
             MCoreAsh_t *CurrentProcess = PhoenixGetCurrentAsh();
             assert(CurrentProcess != NULL);
-            Virtual = AllocateBlocksInBlockmap(CurrentProcess->Heap, __MASK, Size);
-            if (Virtual == 0) {
+            if (RangeTreeAllocate(CurrentProcess->Heap, Size, 
+                MEMORY_AREA_COMMITTED | MAPPING_USERSPACE, &Virtual) != OsSuccess) {
                 ERROR("Failed to allocate heap memory");
                 return OsError;
             }
@@ -162,9 +162,9 @@ QueryMemoryBuffer(
 {
     SystemMemoryBuffer_t *SystemBuffer;
 
-    // We acquire the buffer by mapping it into our address space
-    // and adding a reference
-    SystemBuffer = LookupHandle(Handle);
+    // Hold a reference to the buffer while reading it, it is not
+    // mapped into our address space
+    SystemBuffer = AcquireHandle(Handle);
     if (SystemBuffer == NULL) {
         return OsError;
     }
@@ -172,6 +172,7 @@ QueryMemoryBuffer(
     // Update outs
     *Dma        = SystemBuffer->Physical;
     *Capacity   = SystemBuffer->Capacity;
+    DestroyHandle(Handle);
     return OsSuccess;
 }
 
@@ -213,10 +213,14 @@ ChangeSystemMemorySpaceProtection(
     // Calculate the number of pages of this allocation
     PageCount = DIVUP((Size + (VirtualAddress % GetSystemMemoryPageSize())), GetSystemMemoryPageSize());
 
-    // Update pages with new protection
+    // Update pages with new protection, pages that are not mapped yet get
+    // their protection from the memory area they belong to when touched
     for (i = 0; i < PageCount; i++) {
         uintptr_t Block = VirtualAddress + (i * GetSystemMemoryPageSize());
-        
+        if (IsSystemMemoryPresent(SystemMemorySpace, Block) != OsSuccess) {
+            continue;
+        }
+
         Status = SetVirtualPageAttributes(SystemMemorySpace, Block, Flags);
         if (Status != OsSuccess) {
             break;
@@ -296,8 +300,8 @@ CreateSystemMemorySpaceMapping(
         case MAPPING_PROCESS: {
             MCoreAsh_t *CurrentProcess = PhoenixGetCurrentAsh();
             assert(CurrentProcess != NULL);
-            VirtualBase = AllocateBlocksInBlockmap(CurrentProcess->Heap, __MASK, Size);
-            if (VirtualBase == 0) {
+            if (RangeTreeAllocate(CurrentProcess->Heap, Size, 
+                MEMORY_AREA_COMMITTED | (Flags & MEMORY_AREA_MAPPING_MASK), &VirtualBase) != OsSuccess) {
                 ERROR("Ran out of memory for allocation 0x%x (heap)", Size);
                 return OsError;
             }
@@ -25,6 +25,7 @@
 #include <system/interrupts.h>
 #include <process/phoenix.h>
 #include <modules/modules.h>
+#include <criticalsection.h>
 #include <interrupts.h>
 #include <debug.h>
 #include <crc32.h>
@@ -35,9 +36,282 @@
 #define LIST_SERVER             2
 
 /* Globals */
+static CriticalSection_t GlbModuleLock = CRITICALSECTION_INITIALIZE(CRITICALSECTION_PLAIN);
+static MCoreRamDiskIndexHeader_t *GlbRamdiskIndex = NULL;
+static MCoreModule_t **GlbModuleTable = NULL;
+static uintptr_t GlbRamdiskBase = 0;
+static int GlbModuleCount = 0;
 Collection_t *GlbModules = NULL;
 int GlbModulesInitialized = 0;
 
+/* RamdiskHashName
+ * Hashes an entry name for the path index, ascii is hashed lower-case
+ * to match the case-insensitive name comparison. */
+static uint32_t
+RamdiskHashName(
+    _In_ __CONST char*  Name)
+{
+    // Variables
+    uint32_t Hash = RAMDISK_HASH_INITIAL;
+    while (*Name) {
+        uint8_t Character = (uint8_t)*Name++;
+        if (Character >= 'A' && Character <= 'Z') {
+            Character += ('a' - 'A');
+        }
+        Hash = (Hash ^ Character) * RAMDISK_HASH_PRIME;
+    }
+    return Hash;
+}
+
+/* RamdiskHashKey
+ * Hashes a pair of device identifiers for the device and class indices. */
+static uint32_t
+RamdiskHashKey(
+    _In_ uint32_t       Key1,
+    _In_ uint32_t       Key2)
+{
+    // Variables
+    uint32_t Hash = RAMDISK_HASH_INITIAL;
+    int i;
+    for (i = 0; i < 4; i++) {
+        Hash = (Hash ^ ((Key1 >> (i * 8)) & 0xFF)) * RAMDISK_HASH_PRIME;
+    }
+    for (i = 0; i < 4; i++) {
+        Hash = (Hash ^ ((Key2 >> (i * 8)) & 0xFF)) * RAMDISK_HASH_PRIME;
+    }
+    return Hash;
+}
+
+/* RamdiskDecompress
+ * Decompresses lzss compressed entry data, returns the number of bytes
+ * produced or 0 if the data is corrupt. */
+static size_t
+RamdiskDecompress(
+    _In_ __CONST uint8_t*   Source,
+    _In_ size_t             SourceLength,
+    _In_ uint8_t*           Destination,
+    _In_ size_t             DestinationLength)
+{
+    // Variables
+    size_t In = 0, Out = 0;
+    unsigned Flags = 0;
+    int Bits = 0;
+
+    while (Out < DestinationLength) {
+        if (Bits == 0) {
+            if (In >= SourceLength) {
+                return 0;
+            }
+            Flags = Source[In++];
+            Bits = 8;
+        }
+
+        if (Flags & 1) {
+            if (In >= SourceLength) {
+                return 0;
+            }
+            Destination[Out++] = Source[In++];
+        }
+        else {
+            size_t Distance, Length;
+            if (In + 2 > SourceLength) {
+                return 0;
+            }
+            Distance    = ((size_t)(Source[In] | (Source[In + 1] << 8)) >> 4) + 1;
+            Length      = (Source[In] & 0xF) + RAMDISK_LZSS_MIN_MATCH;
+            In          += 2;
+            if (Distance > Out || Length > (DestinationLength - Out)) {
+                return 0;
+            }
+            while (Length--) {
+                Destination[Out] = Destination[Out - Distance];
+                Out++;
+            }
+        }
+        Flags >>= 1;
+        Bits--;
+    }
+    return Out;
+}
+
+/* ModulesProbeIndex
+ * Returns the next module in the given hash index whose slot matches the
+ * hash, the probe must start at 0. Returns NULL when the chain ends. */
+static MCoreModule_t*
+ModulesProbeIndex(
+    _In_    uint32_t    Buckets,
+    _In_    uint32_t    Offset,
+    _In_    uint32_t    Hash,
+    _InOut_ uint32_t*   Probe)
+{
+    // Variables
+    MCoreRamDiskIndexSlot_t *Slots = (MCoreRamDiskIndexSlot_t*)(GlbRamdiskBase + Offset);
+    
+    while (*Probe < Buckets) {
+        MCoreRamDiskIndexSlot_t *Slot = &Slots[(Hash + *Probe) & (Buckets - 1)];
+        (*Probe)++;
+        if (Slot->Entry == RAMDISK_INDEX_EMPTY) {
+            break;
+        }
+        if (Slot->Hash == Hash && Slot->Entry < (uint32_t)GlbModuleCount
+            && GlbModuleTable[Slot->Entry] != NULL) {
+            return GlbModuleTable[Slot->Entry];
+        }
+    }
+    return NULL;
+}
+
+/* ModulesLoadData
+ * Makes the data of a module available, compressed modules are 
+ * decompressed on first use and all modules are validated once. The
+ * decompression and validation run without the module lock held, which
+ * is only taken to publish the result. */
+static OsStatus_t
+ModulesLoadData(
+    _In_ MCoreModule_t* Module)
+{
+    // Variables
+    uint8_t *Buffer         = NULL;
+    __CONST void *Data      = NULL;
+    uint32_t CrcOfData      = 0;
+
+    if (Module->Loaded) {
+        return OsSuccess;
+    }
+
+    if (Module->Compression == RAMDISK_COMPRESSION_LZSS) {
+        Buffer = (uint8_t*)kmalloc(Module->Header.LengthOfData);
+        if (Buffer == NULL) {
+            ERROR("Decompression(%s): Out of memory", MStringRaw(Module->Name));
+            return OsError;
+        }
+        if (RamdiskDecompress((__CONST uint8_t*)Module->StoredData, Module->StoredLength,
+                Buffer, Module->Header.LengthOfData) != Module->Header.LengthOfData) {
+            ERROR("Decompression(%s): Failed", MStringRaw(Module->Name));
+            kfree(Buffer);
+            return OsError;
+        }
+        Data = (__CONST void*)Buffer;
+    }
+    else if (Module->Compression == RAMDISK_COMPRESSION_NONE) {
+        Data = Module->StoredData;
+    }
+    else {
+        ERROR("Decompression(%s): Unknown method %i", 
+            MStringRaw(Module->Name), Module->Compression);
+        return OsError;
+    }
+
+    // Perform CRC validation, corrupt modules are never handed out
+    CrcOfData = Crc32Generate(-1, (uint8_t*)Data, Module->Header.LengthOfData);
+    if (CrcOfData != Module->Header.Crc32OfData) {
+        ERROR("CRC-Validation(%s): Failed (Calculated 0x%x != Stored 0x%x)",
+            MStringRaw(Module->Name), CrcOfData, Module->Header.Crc32OfData);
+        if (Buffer != NULL) {
+            kfree(Buffer);
+        }
+        return OsError;
+    }
+
+    // Publish, unless another thread got there first
+    CriticalSectionEnter(&GlbModuleLock);
+    if (!Module->Loaded) {
+        Module->Data    = Data;
+        Module->Loaded  = 1;
+        Buffer          = NULL;
+    }
+    CriticalSectionLeave(&GlbModuleLock);
+    if (Buffer != NULL) {
+        kfree(Buffer);
+    }
+    return OsSuccess;
+}
+
+/* ModulesInitializeIndexed
+ * Parses a version 2 ramdisk, the data of the entries is left in place
+ * and the hash indices of the ramdisk are used for lookups. */
+static OsStatus_t
+ModulesInitializeIndexed(
+    _In_ Multiboot_t*           BootInformation,
+    _In_ MCoreRamDiskHeader_t*  Ramdisk)
+{
+    // Variables
+    MCoreRamDiskIndexHeader_t *Index = NULL;
+    MCoreRamDiskEntryV2_t *Entry = NULL;
+    uintptr_t Base = BootInformation->RamdiskAddress;
+    uint32_t Size = BootInformation->RamdiskSize;
+    int i;
+
+    // Validate the index, the bucket counts must be powers of two
+    // and all tables must be inside the ramdisk
+    Index = (MCoreRamDiskIndexHeader_t*)(Base + sizeof(MCoreRamDiskHeader_t));
+#define RAMDISK_TABLE_VALID(Offset, Count, Type) \
+    ((Offset) < Size && (uint64_t)(Count) * sizeof(Type) <= (uint64_t)(Size - (Offset)))
+#define RAMDISK_BUCKETS_VALID(Count) ((Count) != 0 && ((Count) & ((Count) - 1)) == 0)
+    if (Ramdisk->FileCount < 0
+        || !RAMDISK_TABLE_VALID(Index->EntryTableOffset, Ramdisk->FileCount, MCoreRamDiskEntryV2_t)
+        || !RAMDISK_BUCKETS_VALID(Index->PathBuckets)
+        || !RAMDISK_BUCKETS_VALID(Index->DeviceBuckets)
+        || !RAMDISK_BUCKETS_VALID(Index->ClassBuckets)
+        || !RAMDISK_TABLE_VALID(Index->PathIndexOffset, Index->PathBuckets, MCoreRamDiskIndexSlot_t)
+        || !RAMDISK_TABLE_VALID(Index->DeviceIndexOffset, Index->DeviceBuckets, MCoreRamDiskIndexSlot_t)
+        || !RAMDISK_TABLE_VALID(Index->ClassIndexOffset, Index->ClassBuckets, MCoreRamDiskIndexSlot_t)) {
+        ERROR("Invalid ramdisk index");
+        return OsError;
+    }
+
+    GlbModuleCount  = Ramdisk->FileCount;
+    GlbModuleTable  = (MCoreModule_t**)kmalloc(sizeof(MCoreModule_t*) * (GlbModuleCount + 1));
+    Entry           = (MCoreRamDiskEntryV2_t*)(Base + Index->EntryTableOffset);
+    TRACE("Parsing %i number of files in the ramdisk", GlbModuleCount);
+    for (i = 0; i < GlbModuleCount; i++, Entry++) {
+        MCoreRamDiskModuleHeaderV2_t *Header = NULL;
+        MCoreModule_t *Module = NULL;
+        DataKey_t Key;
+
+        GlbModuleTable[i] = NULL;
+        if (Entry->Type != RAMDISK_MODULE && Entry->Type != RAMDISK_FILE) {
+            WARNING("Unknown entry type: %u", Entry->Type);
+            continue;
+        }
+
+        Header = (MCoreRamDiskModuleHeaderV2_t*)(Base + Entry->DataHeaderOffset);
+        if (!RAMDISK_TABLE_VALID(Entry->NameOffset, Entry->NameLength + 1, uint8_t)
+            || !RAMDISK_TABLE_VALID(Entry->DataHeaderOffset, 1, MCoreRamDiskModuleHeaderV2_t)
+            || !RAMDISK_TABLE_VALID(Entry->DataHeaderOffset + sizeof(MCoreRamDiskModuleHeaderV2_t), 
+                Header->StoredLength, uint8_t)) {
+            ERROR("Invalid ramdisk entry %i", i);
+            continue;
+        }
+
+        // The data stays in the ramdisk until it's used
+        Module = (MCoreModule_t*)kmalloc(sizeof(MCoreModule_t));
+        memset(Module, 0, sizeof(MCoreModule_t));
+        Module->Name = MStringCreate((void*)(Base + Entry->NameOffset), StrUTF8);
+        memcpy(&Module->Header, &Header->Base, sizeof(MCoreRamDiskModuleHeader_t));
+        Module->StoredData      = (__CONST void*)(Header + 1);
+        Module->StoredLength    = Header->StoredLength;
+        Module->Compression     = (int)Header->Compression;
+        GlbModuleTable[i]       = Module;
+
+        // Update key based on the type of module
+        // either its a server or a driver
+        if (Header->Base.Flags & RAMDISK_MODULE_SERVER) {
+            Key.Value = LIST_SERVER;
+        }
+        else {
+            Key.Value = LIST_MODULE;
+        }
+        CollectionAppend(GlbModules, CollectionCreateNode(Key, Module));
+    }
+#undef RAMDISK_TABLE_VALID
+#undef RAMDISK_BUCKETS_VALID
+
+    GlbRamdiskBase  = Base;
+    GlbRamdiskIndex = Index;
+    return OsSuccess;
+}
+
 /* ModulesInitialize
  * Loads the ramdisk, iterates all headers and 
  * builds a list of both available servers and 
@@ -71,7 +345,7 @@ ModulesInitialize(
         ERROR("Invalid magic in ramdisk - 0x%x", Ramdisk->Magic);
         return OsError;
     }
-    if (Ramdisk->Version != RAMDISK_VERSION_1) {
+    if (Ramdisk->Version != RAMDISK_VERSION_1 && Ramdisk->Version != RAMDISK_VERSION_2) {
         ERROR("Invalid ramdisk version - 0x%x", Ramdisk->Version);
         return OsError;
     }
@@ -79,6 +353,12 @@ ModulesInitialize(
     // Initialize the list of modules 
     // and servers so we can add later :-)
     GlbModules = CollectionCreate(KeyInteger);
+    if (Ramdisk->Version == RAMDISK_VERSION_2) {
+        if (ModulesInitializeIndexed(BootInformation, Ramdisk) != OsSuccess) {
+            return OsError;
+        }
+        goto Done;
+    }
 
     // Store filecount so we can iterate
     Entry = (MCoreRamDiskEntry_t*)
@@ -107,10 +387,12 @@ ModulesInitialize(
 
             // Allocate a new module header and copy some values 
             Module = (MCoreModule_t*)kmalloc(sizeof(MCoreModule_t));
+            memset(Module, 0, sizeof(MCoreModule_t));
             Module->Name = MStringCreate(Entry->Name, StrUTF8);
             memcpy(&Module->Header, Header, sizeof(MCoreRamDiskModuleHeader_t));
             Module->Data = (__CONST void*)kmalloc(Header->LengthOfData);
             memcpy((void*)Module->Data, ModuleData, Header->LengthOfData);
+            Module->Loaded = 1;
 
             // Update key based on the type of module
             // either its a server or a driver
@@ -129,6 +411,7 @@ ModulesInitialize(
         Counter--;
     }
 
+Done:
     // Debug
     TRACE("Found %i Modules and Servers", CollectionLength(GlbModules));
 
@@ -191,8 +474,9 @@ ModulesQueryPath(
     _Out_ size_t *Length)
 {
     // Variables
-    MString_t *Token    = Path;
-    OsStatus_t Result   = OsError;
+    MCoreModule_t *Module   = NULL;
+    MString_t *Token        = Path;
+    OsStatus_t Result       = OsError;
     int Index           = -1;
 
     // Debug
@@ -210,16 +494,12 @@ ModulesQueryPath(
     }
     TRACE("TokenToSearchFor(%s)", MStringRaw(Token));
 
-    // Locate the module
-    foreach(sNode, GlbModules) {
-        MCoreModule_t *Mod = (MCoreModule_t*)sNode->Data;
-        TRACE("Comparing(%s)To(%s)", MStringRaw(Token), MStringRaw(Mod->Name));
-        if (MStringCompare(Token, Mod->Name, 1) != MSTRING_NO_MATCH) {
-            *Buffer = (void*)Mod->Data;
-            *Length = Mod->Header.LengthOfData;
-            Result = OsSuccess;
-            break;
-        }
+    // Locate the module, and make sure its data is available
+    Module = ModulesFindString(Token);
+    if (Module != NULL && ModulesLoadData(Module) == OsSuccess) {
+        *Buffer = (void*)Module->Data;
+        *Length = Module->Header.LengthOfData;
+        Result = OsSuccess;
     }
     
 Exit:
@@ -246,6 +526,21 @@ ModulesFindGeneric(
         return NULL;
     }
 
+    // Use the index if the ramdisk has one
+    if (GlbRamdiskIndex != NULL) {
+        uint32_t Hash   = RamdiskHashKey(DeviceType, DeviceSubType);
+        uint32_t Probe  = 0;
+        MCoreModule_t *Mod;
+        while ((Mod = ModulesProbeIndex(GlbRamdiskIndex->ClassBuckets, 
+                GlbRamdiskIndex->ClassIndexOffset, Hash, &Probe)) != NULL) {
+            if (Mod->Header.DeviceType == DeviceType
+                && Mod->Header.DeviceSubType == DeviceSubType) {
+                return Mod;
+            }
+        }
+        return NULL;
+    }
+
     // Locate the module
     foreach(sNode, GlbModules) {
         MCoreModule_t *Mod = (MCoreModule_t*)sNode->Data;
@@ -276,6 +571,21 @@ ModulesFindSpecific(
         return NULL;
     }
 
+    // Use the index if the ramdisk has one
+    if (GlbRamdiskIndex != NULL) {
+        uint32_t Hash   = RamdiskHashKey(VendorId, DeviceId);
+        uint32_t Probe  = 0;
+        MCoreModule_t *Mod;
+        while ((Mod = ModulesProbeIndex(GlbRamdiskIndex->DeviceBuckets, 
+                GlbRamdiskIndex->DeviceIndexOffset, Hash, &Probe)) != NULL) {
+            if (Mod->Header.VendorId == VendorId
+                && Mod->Header.DeviceId == DeviceId) {
+                return Mod;
+            }
+        }
+        return NULL;
+    }
+
     // Locate the module
     foreach(sNode, GlbModules) {
         MCoreModule_t *Mod = (MCoreModule_t*)sNode->Data;
@@ -299,6 +609,20 @@ ModulesFindString(
         return NULL;
     }
 
+    // Use the index if the ramdisk has one
+    if (GlbRamdiskIndex != NULL) {
+        uint32_t Hash   = RamdiskHashName(MStringRaw(Module));
+        uint32_t Probe  = 0;
+        MCoreModule_t *Mod;
+        while ((Mod = ModulesProbeIndex(GlbRamdiskIndex->PathBuckets, 
+                GlbRamdiskIndex->PathIndexOffset, Hash, &Probe)) != NULL) {
+            if (MStringCompare(Module, Mod->Name, 1) == MSTRING_FULL_MATCH) {
+                return Mod;
+            }
+        }
+        return NULL;
+    }
+
     // Locate the module
     foreach(sNode, GlbModules) {
         MCoreModule_t *Mod = (MCoreModule_t*)sNode->Data;
@@ -21,6 +21,7 @@
  *      - Bounded MPMC / MPSC / SPMC
  *      - Unbounded MPMC / MPSC / SPMC
  *      - Bounded SPSC
+ *      - Unbounded SPSC (Raw only)
  */
 #define __MODULE "PIPE"
 //#define __TRACE
@@ -40,6 +41,13 @@ static void CreateSegment(
     _In_ SystemPipe_t*          Pipe,
     _In_ SystemPipeSegment_t**  Segment,
     _In_ unsigned int           TicketBase);
+static void DestroySegment(
+    _In_ SystemPipeSegment_t*   Segment);
+static SystemPipeSegment_t* GetNextSegment(
+    _In_ SystemPipeSegment_t*   Segment);
+static _Bool SetNextSegment(
+    _In_ SystemPipeSegment_t*   Segment,
+    _In_ SystemPipeSegment_t*   Next);
 
 #define TICKETS_PER_SEGMENT(Pipe)   (1 << Pipe->SegmentLgSize)
 #define TICKET_INDEX(Pipe, Ticket)  ((Ticket * Pipe->Stride) & (TICKETS_PER_SEGMENT(Pipe) - 1))
@@ -94,8 +102,23 @@ void
 DestroySystemPipe(
     _In_ SystemPipe_t*              Pipe)
 {
+    // Variables
+    SystemPipeSegment_t *Segment;
+    SystemPipeSegment_t *Next;
+
     // @todo pipe synchronization with threads waiting
     // for data in pipe.
+    EventSourceDestroy(&Pipe->Events);
+
+    // Raw pipes own their entire chain of segments
+    if (!(Pipe->Configuration & PIPE_STRUCTURED_BUFFER)) {
+        Segment = atomic_load(&Pipe->ConsumerState.Head);
+        while (Segment != NULL) {
+            Next = GetNextSegment(Segment);
+            DestroySegment(Segment);
+            Segment = Next;
+        }
+    }
     kfree(Pipe);
 }
 
@@ -510,6 +533,195 @@ ReadRawSegmentBuffer(
     return BytesRead;
 }
 
+/////////////////////////////////////////////////////////////////////////
+// System Pipe Raw SPSC Code
+// With only a single producer and a single consumer, each side owns its own
+// index and only ever reads the opposite index when its cached copy runs out.
+// Data is copied in bulk and committed once per contiguous chunk.
+#define IS_RAW_SPSC_PIPE(Pipe) (((Pipe)->Configuration & \
+    (PIPE_MPMC | PIPE_STRUCTURED_BUFFER)) == 0)
+
+static void
+WaitForSystemPipePeer(
+    _In_ atomic_int*                Waiting,
+    _In_ SystemPipeSegment_t*       Segment,
+    _In_ atomic_uint*               Index,
+    _In_ unsigned int               Value)
+{
+    // Variables
+    int Expected = 1;
+
+    // Announce that we are going to sleep, and then re-check the index after
+    // the full barrier, the peer does the opposite when publishing
+    atomic_store(Waiting, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(Index, memory_order_acquire) == Value && 
+        GetNextSegment(Segment) == NULL) {
+        SchedulerAtomicThreadSleep(Waiting, &Expected, 0);
+    }
+    atomic_store_explicit(Waiting, 0, memory_order_relaxed);
+}
+
+static void
+WakeSystemPipePeer(
+    _In_ atomic_int*                Waiting)
+{
+    // Only enter the scheduler if the peer has announced it is sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(Waiting, memory_order_relaxed) != 0 &&
+        atomic_exchange(Waiting, 0) == 1) {
+        SchedulerHandleSignal((uintptr_t*)Waiting);
+    }
+}
+
+static size_t
+WriteRawSpscPipe(
+    _In_ SystemPipe_t*              Pipe,
+    _In_ const uint8_t*             Data,
+    _In_ size_t                     Length)
+{
+    // Variables
+    SystemPipeProducer_t *Producer  = &Pipe->ProducerState;
+    SystemPipeSegment_t *Segment    = GetSystemPipeTail(Pipe);
+    SystemPipeSegmentBuffer_t *Buffer = &Segment->Buffer;
+    unsigned int WriteIndex;
+    size_t BytesWritten             = 0;
+    size_t BytesAvailable;
+    size_t Offset;
+    size_t Chunk;
+
+    WriteIndex = atomic_load_explicit(&Buffer->WriteCommitted, memory_order_relaxed);
+    while (BytesWritten < Length) {
+        BytesAvailable = Buffer->Size - (WriteIndex - Producer->CachedIndex);
+        if (!BytesAvailable) {
+            Producer->CachedIndex = atomic_load_explicit(&Buffer->ReadCommitted, memory_order_acquire);
+            BytesAvailable = Buffer->Size - (WriteIndex - Producer->CachedIndex);
+        }
+
+        if (!BytesAvailable) {
+            if (Pipe->Configuration & PIPE_UNBOUNDED) {
+                // Seal the current segment by linking the next, the consumer
+                // destroys the old segment once it has been drained
+                SystemPipeSegment_t *Next;
+                CreateSegment(Pipe, &Next, Segment->TicketBase + 1);
+                SetNextSegment(Segment, Next);
+                SetSystemPipeTail(Pipe, Next);
+                WakeSystemPipePeer(&Pipe->ConsumerState.Waiting);
+
+                Segment                 = Next;
+                Buffer                  = &Segment->Buffer;
+                WriteIndex              = 0;
+                Producer->CachedIndex   = 0;
+                continue;
+            }
+            if (Pipe->Configuration & PIPE_NOBLOCK) {
+                break;
+            }
+            WaitForSystemPipePeer(&Producer->Waiting, Segment, 
+                &Buffer->ReadCommitted, Producer->CachedIndex);
+            continue;
+        }
+
+        // Copy the chunk in at most two parts to handle the wrap-around
+        Chunk   = MIN(BytesAvailable, Length - BytesWritten);
+        Offset  = WriteIndex & (Buffer->Size - 1);
+        if (Chunk > (Buffer->Size - Offset)) {
+            memcpy(&Buffer->Pointer[Offset], &Data[BytesWritten], Buffer->Size - Offset);
+            memcpy(&Buffer->Pointer[0], &Data[BytesWritten + (Buffer->Size - Offset)], 
+                Chunk - (Buffer->Size - Offset));
+        }
+        else {
+            memcpy(&Buffer->Pointer[Offset], &Data[BytesWritten], Chunk);
+        }
+        WriteIndex      += Chunk;
+        BytesWritten    += Chunk;
+
+        // Publish the entire chunk at once
+        atomic_store_explicit(&Buffer->WritePointer, WriteIndex, memory_order_relaxed);
+        atomic_store_explicit(&Buffer->WriteCommitted, WriteIndex, memory_order_release);
+        WakeSystemPipePeer(&Pipe->ConsumerState.Waiting);
+    }
+    return BytesWritten;
+}
+
+static size_t
+ReadRawSpscPipe(
+    _In_ SystemPipe_t*              Pipe,
+    _In_ uint8_t*                   Data,
+    _In_ size_t                     Length)
+{
+    // Variables
+    SystemPipeConsumer_t *Consumer  = &Pipe->ConsumerState;
+    SystemPipeSegment_t *Segment    = GetSystemPipeHead(Pipe);
+    SystemPipeSegmentBuffer_t *Buffer = &Segment->Buffer;
+    SystemPipeSegment_t *Next;
+    unsigned int ReadIndex;
+    size_t BytesRead                = 0;
+    size_t BytesAvailable;
+    size_t Offset;
+    size_t Chunk;
+
+    ReadIndex = atomic_load_explicit(&Buffer->ReadCommitted, memory_order_relaxed);
+    while (BytesRead < Length) {
+        BytesAvailable = Consumer->CachedIndex - ReadIndex;
+        if (!BytesAvailable) {
+            Consumer->CachedIndex = atomic_load_explicit(&Buffer->WriteCommitted, memory_order_acquire);
+            BytesAvailable = Consumer->CachedIndex - ReadIndex;
+        }
+
+        if (!BytesAvailable) {
+            // With raw bytes we allow the reader to read less, however never 0
+            if (BytesRead > 0) {
+                break;
+            }
+
+            // A linked segment is sealed, so once it has been drained we can
+            // move on to the next segment and free the current one
+            Next = GetNextSegment(Segment);
+            if (Next != NULL) {
+                Consumer->CachedIndex = atomic_load_explicit(&Buffer->WriteCommitted, memory_order_acquire);
+                if (Consumer->CachedIndex != ReadIndex) {
+                    continue;
+                }
+                SetSystemPipeHead(Pipe, Next);
+                DestroySegment(Segment);
+
+                Segment                 = Next;
+                Buffer                  = &Segment->Buffer;
+                ReadIndex               = 0;
+                Consumer->CachedIndex   = 0;
+                continue;
+            }
+            if (Pipe->Configuration & PIPE_NOBLOCK) {
+                break;
+            }
+            WaitForSystemPipePeer(&Consumer->Waiting, Segment, 
+                &Buffer->WriteCommitted, ReadIndex);
+            continue;
+        }
+
+        // Copy the chunk in at most two parts to handle the wrap-around
+        Chunk   = MIN(BytesAvailable, Length - BytesRead);
+        Offset  = ReadIndex & (Buffer->Size - 1);
+        if (Chunk > (Buffer->Size - Offset)) {
+            memcpy(&Data[BytesRead], &Buffer->Pointer[Offset], Buffer->Size - Offset);
+            memcpy(&Data[BytesRead + (Buffer->Size - Offset)], &Buffer->Pointer[0], 
+                Chunk - (Buffer->Size - Offset));
+        }
+        else {
+            memcpy(&Data[BytesRead], &Buffer->Pointer[Offset], Chunk);
+        }
+        ReadIndex   += Chunk;
+        BytesRead   += Chunk;
+
+        // Release the entire chunk at once
+        atomic_store_explicit(&Buffer->ReadPointer, ReadIndex, memory_order_relaxed);
+        atomic_store_explicit(&Buffer->ReadCommitted, ReadIndex, memory_order_release);
+        WakeSystemPipePeer(&Pipe->ProducerState.Waiting);
+    }
+    return BytesRead;
+}
+
 /////////////////////////////////////////////////////////////////////////
 // System Pipe Entry Code
 static void
@@ -712,7 +924,10 @@ ReadSystemPipe(
     Segment = GetSystemPipeHead(Pipe);
     
     // Handle raw/structured differently
-    if (!(Pipe->Configuration & PIPE_STRUCTURED_BUFFER)) {
+    if (IS_RAW_SPSC_PIPE(Pipe)) {
+        Length = ReadRawSpscPipe(Pipe, Data, Length);
+    }
+    else if (!(Pipe->Configuration & PIPE_STRUCTURED_BUFFER)) {
         Length = ReadRawSegmentBuffer(Pipe, &Segment->Buffer, Data, Length);
     }
     else {
@@ -743,12 +958,19 @@ WriteSystemPipe(
     Segment = GetSystemPipeTail(Pipe);
 
     // Handle raw/structured differently
-    if (!(Pipe->Configuration & PIPE_STRUCTURED_BUFFER)) {
+    if (IS_RAW_SPSC_PIPE(Pipe)) {
+        Length = WriteRawSpscPipe(Pipe, Data, Length);
+    }
+    else if (!(Pipe->Configuration & PIPE_STRUCTURED_BUFFER)) {
         Length = WriteRawSegmentBuffer(Pipe, &Segment->Buffer, Data, Length);
     }
     else {
         AcquireSystemPipeProduction(Pipe, Length, &State);
         WriteSystemPipeProduction(&State, Data, Length);
+        return Length;
+    }
+    if (Length != 0) {
+        EventSourceSignal(&Pipe->Events, EVENT_READABLE);
     }
     return Length;
 }
@@ -836,6 +1058,7 @@ AcquireSystemPipeProduction(
 
     // Update state
     if (State != NULL) {
+        State->Pipe     = Pipe;
         State->Advance  = 0;
         State->Index    = TICKET_INDEX(Pipe, Ticket);
         State->Segment  = Segment;
@@ -872,6 +1095,7 @@ WriteSystemPipeProduction(
             &Entry->SegmentBufferCurrentIndex);
         if (Entry->Length == (Entry->SegmentBufferCurrentIndex - Entry->SegmentBufferIndex)) {
             SetSegmentEntryReadable(Entry);
+            EventSourceSignal(&State->Pipe->Events, EVENT_READABLE);
         }
     }
     return BytesAvailable;
@@ -27,14 +27,16 @@
 #include <system/utils.h>
 #include <process/phoenix.h>
 #include <modules/modules.h>
+#include <os/file.h>
 #include <scheduler.h>
 #include <threading.h>
+#include <timers.h>
 #include <machine.h>
 #include <debug.h>
 #include <heap.h>
 
 // Prototypes
-OsStatus_t LoadFile(const char* Path, char** FullPath, void** Data, size_t* Length);
+OsStatus_t LoadFileHeaders(const char* Path, char** FullPath, UUId_t* Handle, void** Data, size_t* Length);
 
 /* This is the finalizor function for starting
  * up a new base Ash, it finishes setting up the environment
@@ -46,6 +48,7 @@ PhoenixFinishAsh(
     // Variables
     UUId_t CurrentCpu       = CpuGetCurrentId();
     MCoreThread_t *Thread   = ThreadingGetCurrentThread(CurrentCpu);
+    UUId_t FileHandle       = UUID_INVALID;
     uintptr_t BaseAddress   = 0;
     int LoadedFromInitRD    = 0;
 
@@ -69,10 +72,19 @@ PhoenixFinishAsh(
     // Setup base address for code data
     BaseAddress             = GetMachine()->MemoryMap.UserCode.Start;
 
+    // Open the executable again now that we run as the ash, the file
+    // handle must belong to us as the sections are paged in from it
+    if (!LoadedFromInitRD) {
+        if (OpenFile(MStringRaw(Ash->Path), __FILE_MUSTEXIST, 
+            __FILE_READ_ACCESS, &FileHandle) != FsOk) {
+            FATAL(FATAL_SCOPE_PROCESS, "Failed to reopen the executable %s", MStringRaw(Ash->Path));
+        }
+    }
+
     // Load Executable
     TRACE("Loading PE-image into memory (buffer 0x%x, size %u)", 
         Ash->FileBuffer, Ash->FileBufferLength);
-    Ash->Executable         = PeLoadImage(NULL, Ash->Name, Ash->FileBuffer, 
+    Ash->Executable         = PeLoadImage(NULL, Ash->Name, FileHandle, Ash->FileBuffer, 
         Ash->FileBufferLength, &BaseAddress, LoadedFromInitRD);
     Ash->NextLoadingAddress = BaseAddress;
 
@@ -82,10 +94,15 @@ PhoenixFinishAsh(
     }
     Ash->FileBuffer = NULL;
 
-    // Initialize the memory bitmaps
-    CreateBlockmap(0, GetMachine()->MemoryMap.UserHeap.Start, 
+    // Initialize the virtual memory areas of the heap
+    CreateRangeTree(GetMachine()->MemoryMap.UserHeap.Start, 
         GetMachine()->MemoryMap.UserHeap.Start + GetMachine()->MemoryMap.UserHeap.Length, 
         GetMachine()->MemoryGranularity, &Ash->Heap);
+
+    // Map the shared system page so clocks can be read without system calls
+    if (TimersMapSharedPage(Ash->MemorySpace) != OsSuccess) {
+        WARNING("Failed to map the shared system page");
+    }
 }
 
 /* PhoenixStartupEntry
@@ -141,8 +158,8 @@ PhoenixInitializeAsh(
         fPath       = (char*)MStringRaw(Path);
     }
     else {
-        TRACE("Loading from filesystem (%s)", MStringRaw(LibraryName));
-        Status      = LoadFile(MStringRaw(Path), &fPath, (void**)&fBuffer, &fSize);
+        TRACE("Loading from filesystem (%s)", MStringRaw(Path));
+        Status      = LoadFileHeaders(MStringRaw(Path), &fPath, NULL, (void**)&fBuffer, &fSize);
         ShouldFree  = 1;
     }
     
@@ -156,8 +173,10 @@ PhoenixInitializeAsh(
         kfree((void*)fPath);
     }
 
-    // Validate the pe-file buffer
-    if (!PeValidate(fBuffer, fSize)) {
+    // Validate the pe-file buffer, for files we only have the headers
+    // as the sections are paged in once the ash is running
+    if ((ShouldFree == 1 && !PeValidateHeaders(fBuffer, fSize)) ||
+        (ShouldFree == 0 && !PeValidate(fBuffer, fSize))) {
         ERROR("Failed to validate the file as a PE-file.");
         if (ShouldFree == 1) {
             kfree(fBuffer);
@@ -371,6 +390,7 @@ PhoenixCleanupAsh(
     // Strings first
     MStringDestroy(Ash->Name);
     MStringDestroy(Ash->Path);
+    EventSourceDestroy(&Ash->Events);
 
     // Cleanup pipes
     _foreach(Node, Ash->Pipes) {
@@ -383,9 +403,10 @@ PhoenixCleanupAsh(
         kfree(Node->Data);
     }
     CollectionDestroy(Ash->FileMappings);
+    Ash->FileMappings = NULL;
 
     // Cleanup memory
-    DestroyBlockmap(Ash->Heap);
+    DestroyRangeTree(Ash->Heap);
     PeUnloadImage(Ash->Executable);
     kfree(Ash);
 }
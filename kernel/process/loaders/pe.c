@@ -25,6 +25,8 @@
 #include <modules/modules.h>
 #include <process/ash.h>
 #include <process/pe.h>
+#include <os/file.h>
+#include <handle.h>
 #include <debug.h>
 #include <heap.h>
 
@@ -33,7 +35,8 @@
 #include <string.h>
 
 // Prototypes
-OsStatus_t LoadFile(const char* Path, char** FullPath, void** Data, size_t* Length);
+OsStatus_t LoadFileHeaders(const char* Path, char** FullPath, UUId_t* Handle, void** Data, size_t* Length);
+OsStatus_t LoadFileRange(UUId_t Handle, DmaBuffer_t* TransferBuffer, uint64_t Offset, void* Buffer, size_t Length);
 
 //#define __OSCONFIG_PROCESS_SINGLELOAD
 #ifdef __OSCONFIG_PROCESS_SINGLELOAD
@@ -75,12 +78,11 @@ PeCalculateChecksum(
     return (uint32_t)(CheckSum & UINT32_MAX);
 }
 
-/* PeValidate
- * Validates a file-buffer of the given length,
- * does initial header checks and performs a checksum
- * validation. Returns either PE_INVALID or PE_VALID */
+/* PeValidateHeaders
+ * Validates the headers and section table of the image, the buffer only
+ * needs to contain the leading part of the file. Returns either PE_INVALID or PE_VALID */
 int
-PeValidate(
+PeValidateHeaders(
     _In_ uint8_t*   Buffer, 
     _In_ size_t     Length)
 {
@@ -88,11 +90,14 @@ PeValidate(
     PeOptionalHeader_t *OptHeader   = NULL;
     PeHeader_t *BaseHeader          = NULL;
     MzHeader_t *DosHeader           = NULL;
-    size_t HeaderCheckSum           = 0, CalculatedCheckSum = 0;
-    size_t CheckSumAddress          = 0;
+    size_t HeadersLength            = 0;
 
     // Get pointer to DOS
     DosHeader = (MzHeader_t*)Buffer;
+    if (Length < sizeof(MzHeader_t)) {
+        ERROR("Image is too small to contain headers (%u bytes)", Length);
+        return PE_INVALID;
+    }
 
     // Check magic for DOS
     if (DosHeader->Signature != MZ_MAGIC) {
@@ -100,6 +105,13 @@ PeValidate(
         return PE_INVALID;
     }
 
+    // Make sure the headers we need are present in the buffer
+    HeadersLength = DosHeader->PeHeaderAddress + sizeof(PeHeader_t) + sizeof(PeOptionalHeader_t);
+    if (HeadersLength > Length) {
+        ERROR("PE headers are outside the image (0x%x)", DosHeader->PeHeaderAddress);
+        return PE_INVALID;
+    }
+
     // Get pointer to PE header
     BaseHeader = (PeHeader_t*)(Buffer + DosHeader->PeHeaderAddress);
 
@@ -129,6 +141,45 @@ PeValidate(
         return PE_INVALID;
     }
 
+    // The section table must be present as well
+    HeadersLength = DosHeader->PeHeaderAddress + sizeof(PeHeader_t)
+        + (BaseHeader->NumSections * sizeof(PeSectionHeader_t));
+    if (OptHeader->Architecture == PE_ARCHITECTURE_32) {
+        HeadersLength += sizeof(PeOptionalHeader32_t);
+    }
+    else {
+        HeadersLength += sizeof(PeOptionalHeader64_t);
+    }
+    if (HeadersLength > Length) {
+        ERROR("PE section table is outside the image (%u sections)", BaseHeader->NumSections);
+        return PE_INVALID;
+    }
+    return PE_VALID;
+}
+
+/* PeValidate
+ * Validates a file-buffer of the given length,
+ * does initial header checks and performs a checksum
+ * validation. Returns either PE_INVALID or PE_VALID */
+int
+PeValidate(
+    _In_ uint8_t*   Buffer, 
+    _In_ size_t     Length)
+{
+    // Variables
+    PeOptionalHeader_t *OptHeader   = NULL;
+    MzHeader_t *DosHeader           = NULL;
+    size_t HeaderCheckSum           = 0, CalculatedCheckSum = 0;
+    size_t CheckSumAddress          = 0;
+
+    if (!PeValidateHeaders(Buffer, Length)) {
+        return PE_INVALID;
+    }
+
+    // Initiate pointers to the validated headers
+    DosHeader = (MzHeader_t*)Buffer;
+    OptHeader = (PeOptionalHeader_t*)(Buffer + DosHeader->PeHeaderAddress + sizeof(PeHeader_t));
+
     // Ok, time to validate the contents of the file
     // by performing a checksum of the PE file
     // We need to re-cast based on architecture
@@ -160,9 +211,152 @@ PeValidate(
     return PE_VALID;
 }
 
+/* PeImagePageIn
+ * Reads in the page of an image file-mapping that contains the address in the
+ * current memory space. Pages are mapped with the protection of their section
+ * unless <Writable> is set, which also makes an already present page writable. */
+OsStatus_t
+PeImagePageIn(
+    _In_ MCoreAshFileMapping_t* Mapping,
+    _In_ uintptr_t              Address,
+    _In_ int                    Writable)
+{
+    // Variables
+    MCorePeFile_t *Image    = Mapping->Image;
+    uintptr_t Page          = Address - (Address % GetSystemMemoryPageSize());
+    Flags_t PageFlags       = MAPPING_USERSPACE;
+    OsStatus_t Status       = OsSuccess;
+    size_t BytesIndex       = 0;
+    size_t BytesRead        = 0;
+    LargeInteger_t Value;
+
+    // The file handle and transfer buffer is shared by all mappings of the image. The
+    // page is read before it's mapped so other threads never see it half-filled
+    SlimSemaphoreWait(&Image->FileLock, 0);
+    if (GetSystemMemoryMapping(GetCurrentSystemMemorySpace(), Page) != 0) {
+        // Already present, the loader may still need to write to it
+        if (Writable) {
+            Status = ChangeSystemMemorySpaceProtection(GetCurrentSystemMemorySpace(), 
+                Page, GetSystemMemoryPageSize(), PageFlags, &PageFlags);
+        }
+    }
+    else {
+        Value.QuadPart = Mapping->FileBlock + (Page - Mapping->BufferObject.Address);
+        if (SeekFile(Image->FileHandle, Value.u.LowPart, Value.u.HighPart) != FsOk ||
+            ReadFile(Image->FileHandle, Image->FileTransfer.Handle, 
+                GetSystemMemoryPageSize(), &BytesIndex, &BytesRead) != FsOk) {
+            ERROR("Failed to read image page at 0x%x from file", Page);
+            Status = OsError;
+        }
+        else if (BytesRead < GetSystemMemoryPageSize()) {
+            memset((void*)(Image->FileTransfer.Address + BytesRead), 0, 
+                GetSystemMemoryPageSize() - BytesRead);
+        }
+
+        if (Status == OsSuccess) {
+            Status = CreateSystemMemorySpaceMapping(GetCurrentSystemMemorySpace(), NULL, &Page, 
+                GetSystemMemoryPageSize(), MAPPING_USERSPACE | MAPPING_FIXED, __MASK);
+        }
+        if (Status == OsSuccess) {
+            memcpy((void*)Page, (const void*)Image->FileTransfer.Address, GetSystemMemoryPageSize());
+            if (!Writable) {
+                if (!(Mapping->Flags & FILE_MAPPING_WRITE)) {
+                    PageFlags |= MAPPING_READONLY;
+                }
+                if (Mapping->Flags & FILE_MAPPING_EXECUTE) {
+                    PageFlags |= MAPPING_EXECUTABLE;
+                }
+                Status = ChangeSystemMemorySpaceProtection(GetCurrentSystemMemorySpace(), 
+                    Page, GetSystemMemoryPageSize(), PageFlags, &PageFlags);
+            }
+        }
+    }
+    SlimSemaphoreSignal(&Image->FileLock, 1);
+    return Status;
+}
+
+/* PeCommitImagePages
+ * Pages in the image pages of the given range ahead of time, the loader uses this
+ * for pages it writes to like relocated pages and import tables. */
+static void
+PeCommitImagePages(
+    _In_ MCorePeFile_t* PeFile,
+    _In_ uintptr_t      Address,
+    _In_ size_t         Length)
+{
+    // Variables
+    MCoreAsh_t *Ash = PhoenixGetCurrentAsh();
+    uintptr_t Page  = Address - (Address % GetSystemMemoryPageSize());
+
+    if (PeFile->FileHandle == UUID_INVALID || Ash == NULL) {
+        return;
+    }
+
+    for (; Page < (Address + Length); Page += GetSystemMemoryPageSize()) {
+        foreach(Node, Ash->FileMappings) {
+            MCoreAshFileMapping_t *Mapping = (MCoreAshFileMapping_t*)Node->Data;
+            if (Mapping->Image == PeFile && ISINRANGE(Page, Mapping->BufferObject.Address, 
+                (Mapping->BufferObject.Address + Mapping->Length) - 1)) {
+                if (PeImagePageIn(Mapping, Page, 1) != OsSuccess) {
+                    ERROR("Failed to page in image page at 0x%x", Page);
+                }
+                break;
+            }
+        }
+    }
+}
+
+/* PeCreateImageMapping
+ * Creates an image file-mapping for the page-aligned part of a section, the pages are
+ * read from the file when they are first touched. Returns the number of bytes mapped. */
+static size_t
+PeCreateImageMapping(
+    _In_ MCorePeFile_t*     PeFile,
+    _In_ PeSectionHeader_t* Section,
+    _In_ uintptr_t          VirtualDestination)
+{
+    // Variables
+    MCoreAshFileMapping_t *Mapping;
+    MCoreAsh_t *Ash = PhoenixGetCurrentAsh();
+    size_t Length   = Section->RawSize - (Section->RawSize % GetSystemMemoryPageSize());
+
+    // Pages are read from any file offset, so the (usually 512 byte) file alignment
+    // does not matter. The last partial page is read eagerly so the tail is zeroed
+    if (PeFile->FileHandle == UUID_INVALID || Ash == NULL || Length == 0 ||
+        (VirtualDestination % GetSystemMemoryPageSize()) != 0 ||
+        (Section->Flags & PE_SECTION_BSS)) {
+        return 0;
+    }
+    Length = MIN(Length, Section->VirtualSize - (Section->VirtualSize % GetSystemMemoryPageSize()));
+    if (Length == 0) {
+        return 0;
+    }
+
+    Mapping = (MCoreAshFileMapping_t*)kmalloc(sizeof(MCoreAshFileMapping_t));
+    memset((void*)Mapping, 0, sizeof(MCoreAshFileMapping_t));
+    Mapping->Header.Data            = Mapping;
+    Mapping->BufferObject.Handle    = UUID_INVALID;
+    Mapping->BufferObject.Address   = VirtualDestination;
+    Mapping->BufferObject.Capacity  = Length;
+    Mapping->FileHandle             = PeFile->FileHandle;
+    Mapping->FileBlock              = Section->RawAddress;
+    Mapping->Length                 = Length;
+    Mapping->Flags                  = FILE_MAPPING_READ | FILE_MAPPING_IMAGE;
+    Mapping->Image                  = PeFile;
+    if (Section->Flags & PE_SECTION_WRITE) {
+        Mapping->Flags |= FILE_MAPPING_WRITE;
+    }
+    if (Section->Flags & (PE_SECTION_EXECUTE | PE_SECTION_CODE)) {
+        Mapping->Flags |= FILE_MAPPING_EXECUTE;
+    }
+    CollectionAppend(Ash->FileMappings, &Mapping->Header);
+    return Length;
+}
+
 /* PeHandleSections
  * Relocates and initializes all sections in the pe image
- * It also returns the last memory address of the relocations */
+ * It also returns the last memory address of the relocations. Images
+ * backed by a file only have the parts read in that can't be paged in */
 uintptr_t
 PeHandleSections(
     _In_ MCorePeFile_t* PeFile,
@@ -189,21 +383,31 @@ PeHandleSections(
         // points to data in file, and one that points to where
         // in memory we want to copy data to
         uintptr_t VirtualDestination = PeFile->VirtualAddress + Section->VirtualAddress;
-        uint8_t *FileBuffer     = (uint8_t*)(Data + Section->RawAddress);
         uint8_t *Destination    = (uint8_t*)VirtualDestination;
+        size_t SectionSize      = MAX(Section->RawSize, Section->VirtualSize);
+        size_t MappedSize       = 0;
 
         // Make a local copy of the name, just in case
         // we need to do some debug print
         memcpy(&SectionName[0], &Section->Name[0], 8);
         SectionName[8]          = 0;
 
+        // Whole pages of file data are paged in on first touch, the rest is
+        // mapped and initialized now
+        if (Section->RawSize != 0 && ((Section->Flags & PE_SECTION_CODE) || (Section->Flags & PE_SECTION_DATA))) {
+            MappedSize = PeCreateImageMapping(PeFile, Section, VirtualDestination);
+        }
+
         // Iterate pages and map them in our memory space
-        Flags_t PageFlags = (UserSpace == 1) ? MAPPING_USERSPACE : 0;
-        PageFlags |= MAPPING_FIXED;
-        Status = CreateSystemMemorySpaceMapping(GetCurrentSystemMemorySpace(), NULL, &VirtualDestination,
-            MAX(Section->RawSize, Section->VirtualSize), PageFlags, __MASK);
-        if (Status != OsSuccess) {
-            ERROR("Failed to map in PE section at 0x%x", Destination);
+        if (MappedSize < SectionSize) {
+            uintptr_t EagerDestination = VirtualDestination + MappedSize;
+            Flags_t PageFlags = (UserSpace == 1) ? MAPPING_USERSPACE : 0;
+            PageFlags |= MAPPING_FIXED;
+            Status = CreateSystemMemorySpaceMapping(GetCurrentSystemMemorySpace(), NULL, &EagerDestination,
+                SectionSize - MappedSize, PageFlags, __MASK);
+            if (Status != OsSuccess) {
+                ERROR("Failed to map in PE section at 0x%x", Destination);
+            }
         }
 
         // Store first code segment we encounter
@@ -222,7 +426,15 @@ PeHandleSections(
             memset(Destination, 0, Section->VirtualSize);
         }
         else if ((Section->Flags & PE_SECTION_CODE) || (Section->Flags & PE_SECTION_DATA)) {
-            memcpy(Destination, FileBuffer, Section->RawSize);
+            if (PeFile->FileHandle != UUID_INVALID) {
+                if (MappedSize < Section->RawSize) {
+                    LoadFileRange(PeFile->FileHandle, &PeFile->FileTransfer, Section->RawAddress + MappedSize,
+                        (Destination + MappedSize), Section->RawSize - MappedSize);
+                }
+            }
+            else {
+                memcpy(Destination, (Data + Section->RawAddress), Section->RawSize);
+            }
 
             // Sanitize this special case, if the virtual size
             // is large, this means there needs to be zeroed space
@@ -259,9 +471,11 @@ void PeHandleRelocations(MCorePeFile_t *PeFile,
     uint8_t *AdvancePtr = NULL;
     uint32_t Itr = 0;
 
-    /* Sanitize the directory */
+    /* Sanitize the directory, images loaded at their
+     * preferred base need no relocations */
     if (RelocDirectory->AddressRVA == 0
-        || RelocDirectory->Size == 0) {
+        || RelocDirectory->Size == 0
+        || PeFile->VirtualAddress == ImageBase) {
         return;
     }
     
@@ -297,8 +511,12 @@ void PeHandleRelocations(MCorePeFile_t *PeFile,
             break;
         }
 
-        /* Initialize the relocation pointer */
+        /* Initialize the relocation pointer, and make sure the
+         * pages of the block are present and writable, a relocation
+         * can cross into the next page */
         RelocationEntryPtr = (uint16_t*)RelocationPtr;
+        PeCommitImagePages(PeFile, PeFile->VirtualAddress + PageRVA, 
+            GetSystemMemoryPageSize() + sizeof(uintptr_t));
 
         /* Iterate relocation entries for this block */
         for (Itr = 0; Itr < NumRelocs; Itr++) {
@@ -491,6 +709,7 @@ PeHandleImports(
                 }
 
                 // Update import address and go to next
+                PeCommitImagePages(PeFile, (uintptr_t)Iat, sizeof(uint32_t));
                 *Iat = Function->Address;
                 Iat++;
             }
@@ -534,6 +753,7 @@ PeHandleImports(
                 }
 
                 // Update import address and go to next
+                PeCommitImagePages(PeFile, (uintptr_t)Iat, sizeof(uint64_t));
                 *Iat = (uint64_t)Function->Address;
                 Iat++;
             }
@@ -586,6 +806,7 @@ PeResolveLibrary(
     // Sanitize the exports, if its null we have to resolve the library
     if (Exports == NULL) {
         MCorePeFile_t *Library;
+        UUId_t fHandle = UUID_INVALID;
         uint8_t *fBuffer;
         size_t fSize;
 
@@ -598,7 +819,7 @@ PeResolveLibrary(
         }
         else {
             TRACE("Loading from filesystem (%s)", MStringRaw(LibraryName));
-            Status = LoadFile(MStringRaw(LibraryName), NULL, (void**)&fBuffer, &fSize);
+            Status = LoadFileHeaders(MStringRaw(LibraryName), NULL, &fHandle, (void**)&fBuffer, &fSize);
         }
 
         if (Status != OsSuccess) {
@@ -609,7 +830,7 @@ PeResolveLibrary(
         // After retrieving the data we can now
         // load the actual image
         TRACE("Parsing pe-image");
-        Library = PeLoadImage(ExportParent, LibraryName, fBuffer, fSize, LoadAddress, ExportParent->UsingInitRD);
+        Library = PeLoadImage(ExportParent, LibraryName, fHandle, fBuffer, fSize, LoadAddress, ExportParent->UsingInitRD);
         Exports = Library;
 
         // Cleanup buffer, we are done with it now
@@ -649,11 +870,14 @@ PeResolveFunction(
 /* PeLoadImage
  * Loads the given file-buffer as a pe image into the current address space 
  * at the given Base-Address, which is updated after load to reflect where
- * the next address is available for load */
+ * the next address is available for load. If a file handle is given the buffer
+ * only holds the headers and the sections are paged in from the file, the image
+ * takes ownership of the handle */
 MCorePeFile_t*
 PeLoadImage(
     _In_    MCorePeFile_t*  Parent,
     _In_    MString_t*      Name,
+    _In_    UUId_t          FileHandle,
     _In_    uint8_t*        Buffer,
     _In_    size_t          Length,
     _InOut_ uintptr_t*      BaseAddress,
@@ -685,8 +909,15 @@ PeLoadImage(
         *BaseAddress);
 
     // Start out by validating the file buffer
-    // so we don't load any garbage
-    if (!PeValidate(Buffer, Length)) {
+    // so we don't load any garbage, the checksum covers the entire
+    // file so it can only be verified for images loaded in full
+    if (FileHandle != UUID_INVALID) {
+        if (!PeValidateHeaders(Buffer, Length)) {
+            CloseFile(FileHandle);
+            return NULL;
+        }
+    }
+    else if (!PeValidate(Buffer, Length)) {
         return NULL;
     }
     
@@ -719,6 +950,9 @@ PeLoadImage(
     else {
         // Cleanup, return null
         ERROR("Unsupported architecture %u", OptHeader->Architecture);
+        if (FileHandle != UUID_INVALID) {
+            CloseFile(FileHandle);
+        }
         return NULL;
     }
 
@@ -733,6 +967,15 @@ PeLoadImage(
     PeInfo->LoadedLibraries = CollectionCreate(KeyInteger);
     PeInfo->References      = 1;
     PeInfo->UsingInitRD     = UsingInitRD;
+    PeInfo->FileHandle      = FileHandle;
+
+    // Images backed by the file share a single page for transfers
+    if (FileHandle != UUID_INVALID) {
+        SlimSemaphoreConstruct(&PeInfo->FileLock, 1, 1);
+        if (CreateMemoryBuffer(MEMORY_BUFFER_KERNEL, GetSystemMemoryPageSize(), &PeInfo->FileTransfer) != OsSuccess) {
+            FATAL(FATAL_SCOPE_KERNEL, "Failed to create the transfer buffer for %s", MStringRaw(Name));
+        }
+    }
 
     // Set the entry point if there is any
     if (OptHeader->EntryPoint != 0) {
@@ -748,7 +991,12 @@ PeLoadImage(
         // Whatthe
         FATAL(FATAL_SCOPE_KERNEL, "Failed to map pe's metadata, out of memory?");
     }
-    memcpy((void*)PeInfo->VirtualAddress, Buffer, SizeOfMetaData);
+    if (FileHandle != UUID_INVALID) {
+        LoadFileRange(FileHandle, &PeInfo->FileTransfer, 0, (void*)PeInfo->VirtualAddress, SizeOfMetaData);
+    }
+    else {
+        memcpy((void*)PeInfo->VirtualAddress, Buffer, SizeOfMetaData);
+    }
     
     // Now we want to handle all the directories
     // and sections in the image, start out by handling
@@ -816,6 +1064,7 @@ PeUnloadImage(
 {
     // Variables
     CollectionItem_t *Node = NULL;
+    MCoreAsh_t *Ash        = PhoenixGetCurrentAsh();
 
     // Sanitize parameter
     if (Executable == NULL) {
@@ -825,6 +1074,27 @@ PeUnloadImage(
     // Cleanup resources
     MStringDestroy(Executable->Name);
 
+    // Close the file the image was paged in from, its mappings
+    // are removed from the process if it's still alive
+    if (Executable->FileHandle != UUID_INVALID) {
+        if (Ash != NULL && Ash->FileMappings != NULL) {
+            _foreach_nolink(Node, Ash->FileMappings) {
+                MCoreAshFileMapping_t *Mapping = (MCoreAshFileMapping_t*)Node->Data;
+                if (Mapping->Image == Executable) {
+                    Node = CollectionUnlinkNode(Ash->FileMappings, Node);
+                    kfree(Mapping);
+                }
+                else {
+                    Node = CollectionNext(Node);
+                }
+            }
+        }
+        RemoveSystemMemoryMapping(GetCurrentSystemMemorySpace(), 
+            Executable->FileTransfer.Address, Executable->FileTransfer.Capacity);
+        DestroyHandle(Executable->FileTransfer.Handle);
+        CloseFile(Executable->FileHandle);
+    }
+
     // Cleanup exports
     if (Executable->ExportedFunctions != NULL) {
         kfree(Executable->ExportedFunctions);
@@ -28,23 +28,18 @@
 #include <debug.h>
 #include <heap.h>
 
-/* LoadFile
- * Helper for the kernel to interact with file services. Loads a file and returns
- * the size and a pre-allocated buffer. */
-OsStatus_t
-LoadFile(
+/* LoadFileOpen
+ * Opens the file as read-only and queries the size and optionally the full path of it. */
+static OsStatus_t
+LoadFileOpen(
     _In_  const char*   Path,
     _Out_ char**        FullPath,
-    _Out_ void**        Data,
+    _Out_ UUId_t*       Handle,
     _Out_ size_t*       Length)
 {
     FileSystemCode_t FsCode     = FsOk;
-    DmaBuffer_t TransferBuffer  = { 0 };
     LargeInteger_t QueriedSize  = { { 0 } };
     UUId_t fHandle              = UUID_INVALID;
-    void *fBuffer;
-    size_t fRead = 0, fIndex = 0;
-    size_t fSize = 0;
 
     // Open the file as read-only
     FsCode = OpenFile(Path, __FILE_MUSTEXIST, __FILE_READ_ACCESS, &fHandle);
@@ -70,7 +65,32 @@ LoadFile(
         }
     }
 
-    fSize = (size_t)QueriedSize.QuadPart;
+    *Handle = fHandle;
+    *Length = (size_t)QueriedSize.QuadPart;
+    return OsSuccess;
+}
+
+/* LoadFile
+ * Helper for the kernel to interact with file services. Loads a file and returns
+ * the size and a pre-allocated buffer. */
+OsStatus_t
+LoadFile(
+    _In_  const char*   Path,
+    _Out_ char**        FullPath,
+    _Out_ void**        Data,
+    _Out_ size_t*       Length)
+{
+    FileSystemCode_t FsCode     = FsOk;
+    DmaBuffer_t TransferBuffer  = { 0 };
+    UUId_t fHandle              = UUID_INVALID;
+    void *fBuffer;
+    size_t fRead = 0, fIndex = 0;
+    size_t fSize = 0;
+
+    if (LoadFileOpen(Path, FullPath, &fHandle, &fSize) != OsSuccess) {
+        return OsError;
+    }
+
     if (CreateMemoryBuffer(MEMORY_BUFFER_KERNEL, fSize, &TransferBuffer) != OsSuccess) {
         ERROR("Failed to create a memory buffer");
         CloseFile(fHandle);
@@ -104,3 +124,97 @@ LoadFile(
     CloseFile(fHandle);
     return OsSuccess;
 }
+
+/* LoadFileRange
+ * Reads <Length> bytes at the absolute <Offset> of an open file into <Buffer>, the
+ * transfer buffer is used in chunks of its capacity. Bytes beyond the end of file
+ * are zeroed. Calls on the same handle must be serialized by the caller. */
+OsStatus_t
+LoadFileRange(
+    _In_ UUId_t         Handle,
+    _In_ DmaBuffer_t*   TransferBuffer,
+    _In_ uint64_t       Offset,
+    _In_ void*          Buffer,
+    _In_ size_t         Length)
+{
+    LargeInteger_t Position;
+    size_t fRead, fIndex;
+    FileSystemCode_t FsCode;
+
+    Position.QuadPart = Offset;
+    if (SeekFile(Handle, Position.u.LowPart, Position.u.HighPart) != FsOk) {
+        ERROR("Failed to seek file to 0x%x", Position.u.LowPart);
+        return OsError;
+    }
+
+    while (Length > 0) {
+        size_t Chunk = MIN(Length, TransferBuffer->Capacity);
+        fRead = 0;
+        FsCode = ReadFile(Handle, TransferBuffer->Handle, Chunk, &fIndex, &fRead);
+        if (FsCode != FsOk) {
+            ERROR("Failed to read file, code %i", FsCode);
+            return OsError;
+        }
+        memcpy(Buffer, (const void*)TransferBuffer->Address, MIN(fRead, Chunk));
+
+        // End of file reached, the rest is zero
+        if (fRead < Chunk) {
+            memset((uint8_t*)Buffer + fRead, 0, Length - fRead);
+            break;
+        }
+        Buffer  = (void*)((uint8_t*)Buffer + Chunk);
+        Length -= Chunk;
+    }
+    return OsSuccess;
+}
+
+/* LoadFileHeaders
+ * Loads only the leading page of a file for images that are paged in on demand. If
+ * <Handle> is given the file is kept open for the calling process, and the file
+ * size is returned in <FileLength>. */
+OsStatus_t
+LoadFileHeaders(
+    _In_      const char*   Path,
+    _Out_Opt_ char**        FullPath,
+    _Out_Opt_ UUId_t*       Handle,
+    _Out_     void**        Data,
+    _Out_     size_t*       Length)
+{
+    DmaBuffer_t TransferBuffer  = { 0 };
+    UUId_t fHandle              = UUID_INVALID;
+    OsStatus_t Status;
+    void *fBuffer;
+    size_t fSize = 0;
+
+    if (LoadFileOpen(Path, FullPath, &fHandle, &fSize) != OsSuccess) {
+        return OsError;
+    }
+    fSize = MIN(fSize, GetSystemMemoryPageSize());
+
+    if (CreateMemoryBuffer(MEMORY_BUFFER_KERNEL, GetSystemMemoryPageSize(), &TransferBuffer) != OsSuccess) {
+        ERROR("Failed to create a memory buffer");
+        CloseFile(fHandle);
+        return OsError;
+    }
+
+    fBuffer = kmalloc(fSize);
+    Status  = LoadFileRange(fHandle, &TransferBuffer, 0, fBuffer, fSize);
+    RemoveSystemMemoryMapping(GetCurrentSystemMemorySpace(), TransferBuffer.Address, TransferBuffer.Capacity);
+    DestroyHandle(TransferBuffer.Handle);
+    if (Status != OsSuccess) {
+        kfree(fBuffer);
+        CloseFile(fHandle);
+        return OsError;
+    }
+
+    // Update outs
+    *Data   = fBuffer;
+    *Length = fSize;
+    if (Handle != NULL) {
+        *Handle = fHandle;
+    }
+    else {
+        CloseFile(fHandle);
+    }
+    return OsSuccess;
+}
@@ -27,6 +27,7 @@
 #include <process/process.h>
 #include <process/server.h>
 #include <garbagecollector.h>
+#include <epoch.h>
 #include <scheduler.h>
 #include <threading.h>
 #include <machine.h>
@@ -124,6 +125,27 @@ PhoenixRegisterAlias(
     return OsSuccess;
 }
 
+/* PhoenixIsAshAliased
+ * Returns OsSuccess if the given ash has registered an alias,
+ * which is what marks a process as a system service. */
+OsStatus_t
+PhoenixIsAshAliased(
+    _In_ MCoreAsh_t *Ash)
+{
+    // Variables
+    int i;
+
+    if (Ash == NULL) {
+        return OsError;
+    }
+    for (i = 0; i < PHOENIX_MAX_ASHES; i++) {
+        if (AliasMap[i] == Ash->Id) {
+            return OsSuccess;
+        }
+    }
+    return OsError;
+}
+
 /* PhoenixUpdateAlias
  * Checks if the given process-id has an registered alias.
  * If it has, the given process-id will be overwritten. */
@@ -177,7 +199,8 @@ PhoenixGetAsh(
     // Now we can sanitize the extra stuff, like alias
     PhoenixUpdateAlias(&AshId);
 
-    // Iterate the list for ash-id
+    // Iterate the list for ash-id, the list is read without locks
+    EpochEnter();
     _foreach(Node, Processes) {
         MCoreAsh_t *Ash = (MCoreAsh_t*)Node->Data;
         if (Ash->Id == AshId) {
@@ -185,14 +208,53 @@ PhoenixGetAsh(
             break;
         }
     }
+    EpochLeave();
 
     // We didn't find it
     return Result;
 }
 
+/* PhoenixAcquireAsh
+ * Looks up the ash by the given id and takes a reference to it, the ash stays
+ * valid untill the reference is released with PhoenixReleaseAsh. */
+MCoreAsh_t*
+PhoenixAcquireAsh(
+    _In_ UUId_t AshId)
+{
+    // Variables
+    MCoreAsh_t *Ash;
+    int References;
+
+    // Ashes that reached 0 references are being destroyed
+    EpochEnter();
+    Ash = PhoenixGetAsh(AshId);
+    if (Ash != NULL) {
+        References = atomic_load(&Ash->References);
+        while (References != 0 
+            && !atomic_compare_exchange_weak(&Ash->References, &References, References + 1));
+        if (References == 0) {
+            Ash = NULL;
+        }
+    }
+    EpochLeave();
+    return Ash;
+}
+
+/* PhoenixReleaseAsh
+ * Releases a reference to the ash, the last reference hands it to the gc. */
+void
+PhoenixReleaseAsh(
+    _In_ MCoreAsh_t* Ash)
+{
+    if (atomic_fetch_sub(&Ash->References, 1) == 1) {
+        GcSignal(GcHandlerId, Ash);
+    }
+}
+
 /* GetServerByDriver
  * Retrieves a running server by driver-information
- * to avoid spawning multiple servers */
+ * to avoid spawning multiple servers. The server is returned with
+ * a reference that must be released with PhoenixReleaseAsh */
 MCoreServer_t*
 PhoenixGetServerByDriver(
     _In_ DevInfo_t VendorId,
@@ -200,6 +262,10 @@ PhoenixGetServerByDriver(
     _In_ DevInfo_t DeviceClass,
     _In_ DevInfo_t DeviceSubClass)
 {
+    MCoreServer_t *Result = NULL;
+    int References;
+
+    EpochEnter();
     foreach(pNode, Processes) {
         MCoreAsh_t *Ash = (MCoreAsh_t*)pNode->Data;
         if (Ash->Type == AshServer) {
@@ -209,7 +275,8 @@ PhoenixGetServerByDriver(
             if (VendorId != 0 && DeviceId != 0) {
                 if (Server->VendorId == VendorId
                     && Server->DeviceId == DeviceId) {
-                    return Server;
+                    Result = Server;
+                    break;
                 }
             }
 
@@ -217,12 +284,24 @@ PhoenixGetServerByDriver(
             if (Server->VendorId != 0xFFEF) {
                 if (Server->DeviceClass == DeviceClass
                     && Server->DeviceSubClass == DeviceSubClass) {
-                    return Server;
+                    Result = Server;
+                    break;
                 }
             }
         }
     }
-    return NULL;
+
+    // Take a reference before leaving, the server might be terminating
+    if (Result != NULL) {
+        References = atomic_load(&Result->Base.References);
+        while (References != 0 
+            && !atomic_compare_exchange_weak(&Result->Base.References, &References, References + 1));
+        if (References == 0) {
+            Result = NULL;
+        }
+    }
+    EpochLeave();
+    return Result;
 }
 
 /* PhoenixRegisterAsh
@@ -237,6 +316,21 @@ PhoenixRegisterAsh(
     return CollectionAppend(Processes, CollectionCreateNode(Key, Ash));
 }
 
+/* PhoenixRetireAsh
+ * Invoked once no readers can see the process node anymore, the node is released
+ * and so is the reference of the process list. */
+static void
+PhoenixRetireAsh(
+    _In_ void*          Context)
+{
+    // Variables
+    CollectionItem_t *Node  = (CollectionItem_t*)Context;
+    MCoreAsh_t *Ash         = (MCoreAsh_t*)Node->Data;
+
+    CollectionDestroyNode(Processes, Node);
+    PhoenixReleaseAsh(Ash);
+}
+
 /* PhoenixTerminateAsh
  * This marks an ash for termination by taking it out
  * of rotation and adding it to the cleanup list */
@@ -248,6 +342,7 @@ PhoenixTerminateAsh(
     _In_ int            TerminateInstantly)
 {
     // Variables
+    CollectionItem_t *Node;
     int LeftoverThreads = 0;
     DataKey_t Key;
 
@@ -261,13 +356,23 @@ PhoenixTerminateAsh(
         return;
     }
 
-    // To modify list is locked operation
-    Key.Value = (int)Ash->Id;
-    CollectionRemoveByKey(Processes, Key);
+    // To modify list is locked operation, the node keeps its links as
+    // lookups might be walking the list
+    Key.Value   = (int)Ash->Id;
+    Node        = CollectionGetNodeByKey(Processes, Key, 0);
+    if (Node != NULL) {
+        CollectionUnlinkNode(Processes, Node);
+    }
 
-    // Alert GC
+    // Alert GC once lookups can no longer return the ash
     SchedulerHandleSignalAll((uintptr_t*)Ash);
-    GcSignal(GcHandlerId, Ash);
+    EventSourceSignal(&Ash->Events, EVENT_EXITED);
+    if (Node != NULL) {
+        EpochDefer(&Ash->Retire, PhoenixRetireAsh, Node);
+    }
+    else {
+        GcSignal(GcHandlerId, Ash);
+    }
 }
 
 /* PhoenixReapAsh
@@ -312,7 +417,8 @@ PhoenixFileHandler(
     // Iterate file-mappings
     foreach(Node, Event->Ash->FileMappings) {
         Mapping = (MCoreAshFileMapping_t*)Node->Data;
-        if (ISINRANGE(Event->Address, Mapping->BufferObject.Address, (Mapping->BufferObject.Address + Mapping->Length) - 1)) {
+        if (!(Mapping->Flags & FILE_MAPPING_IMAGE) && 
+            ISINRANGE(Event->Address, Mapping->BufferObject.Address, (Mapping->BufferObject.Address + Mapping->Length) - 1)) {
             Flags_t MappingFlags    = MAPPING_USERSPACE | MAPPING_FIXED | MAPPING_PROVIDED;
             size_t BytesIndex       = 0;
             size_t BytesRead        = 0;
@@ -399,9 +505,10 @@ PhoenixEventHandler(
         } break;
         
         case AshKill: {
-            MCoreAsh_t *Ash = PhoenixGetAsh(Request->AshId);
+            MCoreAsh_t *Ash = PhoenixAcquireAsh(Request->AshId);
             if (Ash != NULL) {
                 PhoenixTerminateAsh(Ash, 0, 1, 1);
+                PhoenixReleaseAsh(Ash);
             }
             else {
                 Request->Base.State = EventFailed;
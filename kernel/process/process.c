@@ -130,14 +130,16 @@ PhoenixCleanupProcess(
 }
 
 /* PhoenixGetProcess
- * This function looks up a server structure by id */
+ * This function looks up a process structure by id, the process is returned with
+ * a reference that must be released with PhoenixReleaseAsh */
 MCoreProcess_t*
 PhoenixGetProcess(
 	_In_ UUId_t ProcessId)
 {
 	// Use the default ash-lookup
-	MCoreAsh_t *Ash = PhoenixGetAsh(ProcessId);
+	MCoreAsh_t *Ash = PhoenixAcquireAsh(ProcessId);
 	if (Ash != NULL && Ash->Type != AshProcess) {
+		PhoenixReleaseAsh(Ash);
 		return NULL;
 	}
 	return (MCoreProcess_t*)Ash;
@@ -160,14 +162,18 @@ PhoenixGetCurrentProcess(void)
 /* PhoenixGetWorkingDirectory
  * This function looks up the working directory for a process 
  * by id, if either PROCESS_CURRENT or PROCESS_NO_PROCESS 
- * is passed, it retrieves the current process's working directory */
+ * is passed, it retrieves the current process's working directory.
+ * The string is owned by the process and lives only as long as it does. */
 MString_t*
 PhoenixGetWorkingDirectory(
     _In_ UUId_t ProcessId)
 {
 	MCoreProcess_t *Process = PhoenixGetProcess(ProcessId);
+	MString_t *Directory;
 	if (Process != NULL) {
-		return Process->WorkingDirectory;
+		Directory = Process->WorkingDirectory;
+		PhoenixReleaseAsh(&Process->Base);
+		return Directory;
 	}
 	else {
 		return NULL;
@@ -177,14 +183,18 @@ PhoenixGetWorkingDirectory(
 /* PhoenixGetBaseDirectory
  * This function looks up the base directory for a process 
  * by id, if either PROCESS_CURRENT or PROCESS_NO_PROCESS 
- * is passed, it retrieves the current process's base directory */
+ * is passed, it retrieves the current process's base directory.
+ * The string is owned by the process and lives only as long as it does. */
 MString_t*
 PhoenixGetBaseDirectory(
     _In_ UUId_t ProcessId)
 {
 	MCoreProcess_t *Process = PhoenixGetProcess(ProcessId);
+	MString_t *Directory;
 	if (Process != NULL) {
-		return Process->BaseDirectory;
+		Directory = Process->BaseDirectory;
+		PhoenixReleaseAsh(&Process->Base);
+		return Directory;
 	}
 	else {
 		return NULL;
@@ -81,16 +81,18 @@ PhoenixCleanupServer(
 }
 
 /* PhoenixGetServer
- * This function looks up a server structure by id */
+ * This function looks up a server structure by id, the server is returned with
+ * a reference that must be released with PhoenixReleaseAsh */
 MCoreServer_t*
 PhoenixGetServer(
 	_In_ UUId_t ServerId)
 {
 	// Use the default ash-lookup
-	MCoreAsh_t *Ash = PhoenixGetAsh(ServerId);
+	MCoreAsh_t *Ash = PhoenixAcquireAsh(ServerId);
 
 	// Do a null check and type-check
 	if (Ash != NULL && Ash->Type != AshServer) {
+		PhoenixReleaseAsh(Ash);
 		return NULL;
 	}
 	return (MCoreServer_t*)Ash;
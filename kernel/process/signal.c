@@ -88,7 +88,7 @@ SignalCreate(
     _In_ int        Signal)
 {
 	// Variables
-	MCoreThread_t *Target   = ThreadingGetThread(ThreadId);
+	MCoreThread_t *Target   = ThreadingAcquireThread(ThreadId);
 	MCoreSignal_t *Sig      = NULL;
 	DataKey_t sKey;
 
@@ -98,10 +98,14 @@ SignalCreate(
     // Sanitize input, and then sanitize if we have a handler
 	if (Target == NULL || Signal >= NUMSIGNALS) {
         ERROR("Signal %i was not in range");
+        if (Target != NULL) {
+            ThreadingReleaseThread(Target);
+        }
 		return OsError; // Invalid
 	}
     if (Target->SignalInformation[Signal] == 1) {
         ERROR("Signal %i was blocked");
+        ThreadingReleaseThread(Target);
         return OsError; // Ignored
     }
 
@@ -118,6 +122,7 @@ SignalCreate(
     if (THREADING_STATE(Target->Flags) != THREADING_ACTIVE) {
         SchedulerThreadSignal(Target);
     }
+    ThreadingReleaseThread(Target);
     return OsSuccess;
 }
 
@@ -142,7 +147,8 @@ SignalReturn(void)
 
 /* Handle Signal 
  * This checks if the process has any waiting signals
- * and if it has, it executes the first in list */
+ * and if it has, it executes the first in list. The thread must be
+ * the one running on the calling cpu, as signals are executed in place. */
 OsStatus_t
 SignalHandle(
 	_In_ UUId_t ThreadId)
@@ -151,11 +157,13 @@ SignalHandle(
 	MCoreThread_t *Thread;
 	MCoreSignal_t *Signal;
 	
-	// Lookup variables
-	Thread = ThreadingGetThread(ThreadId);
+	// Lookup variables, the reference is dropped right away as the
+	// thread is running on this cpu and can't be destroyed beneath us
+	Thread = ThreadingAcquireThread(ThreadId);
 	if (Thread == NULL) {
 		return OsError;
 	}
+	ThreadingReleaseThread(Thread);
 
 	// Even if there is a Ash, we might want not
 	// to Ash any signals ATM if there is already 
@@ -188,7 +196,7 @@ SignalExecute(
     TRACE("SignalExecute(Thread %u, Signal %i)", Thread->Id, Signal->Signal);
 
     // Instantiate the process
-    Process = PhoenixGetAsh(Thread->AshId);
+    Process = PhoenixAcquireAsh(Thread->AshId);
     if (Process == NULL) {
         kfree(Signal);
         return;
@@ -201,10 +209,15 @@ SignalExecute(
 		if (Action == 1 || Action == 2) {
 			PhoenixTerminateAsh(Process, Signal->Signal, 1, 1);
 		}
+        PhoenixReleaseAsh(Process);
         kfree(Signal);
 		return;
 	}
 
+    // Dispatching doesn't return, so let go of the process before that.
+    // The thread is running inside it, which keeps it alive.
+    PhoenixReleaseAsh(Process);
+
 	// Update active and dispatch
     memcpy(&Thread->ActiveSignal, Signal, sizeof(MCoreSignal_t));
     Thread->ActiveSignal.Context = Thread->ContextActive;
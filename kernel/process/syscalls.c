@@ -24,6 +24,7 @@
 #include <os/mollenos.h>
 #include <os/contracts/video.h>
 #include <os/buffer.h>
+#include <os/eventport.h>
 #include <process/phoenix.h>
 #include <time.h>
 
@@ -38,6 +39,9 @@ OsStatus_t  ScPerformanceFrequency(LargeInteger_t *Frequency);
 OsStatus_t  ScPerformanceTick(LargeInteger_t *Value);
 OsStatus_t  ScQueryDisplayInformation(VideoDescriptor_t *Descriptor);
 void*       ScCreateDisplayFramebuffer(void);
+void*       ScQuerySharedPage(void);
+OsStatus_t  ScProfilerControl(int Command, size_t Interval);
+OsStatus_t  ScProfilerRead(char* Buffer, size_t Length, size_t* BytesRead);
 
 // Process system calls 
 UUId_t      ScProcessSpawn(const char* Path, const ProcessStartupInformation_t* StartupInformation, int Asynchronous);
@@ -68,13 +72,19 @@ UUId_t      ScThreadGetCurrentId(void);
 OsStatus_t  ScThreadYield(void);
 OsStatus_t  ScThreadSetCurrentName(const char* ThreadName);
 OsStatus_t  ScThreadGetCurrentName(char* ThreadNameBuffer, size_t MaxLength);
+OsStatus_t  ScThreadSetRealtime(int Level);
 
 // Synchronization system calls
 OsStatus_t  ScConditionCreate(Handle_t* Handle);
 OsStatus_t  ScConditionDestroy(Handle_t Handle);
+OsStatus_t  ScConditionGetOwner(Handle_t Handle, UUId_t* Owner);
 OsStatus_t  ScSignalHandle(uintptr_t* Handle);
 OsStatus_t  ScSignalHandleAll(uintptr_t* Handle);
 OsStatus_t  ScWaitForObject(uintptr_t* Handle, size_t Timeout);
+OsStatus_t  ScEventPortCreate(UUId_t* Handle);
+OsStatus_t  ScEventPortAttach(UUId_t Handle, int Type, UUId_t SourceId, Flags_t Events, void* Context);
+OsStatus_t  ScEventPortDetach(UUId_t Handle, int Type, UUId_t SourceId);
+OsStatus_t  ScEventPortWait(UUId_t Handle, EventPortEvent_t* Events, size_t MaxEvents, size_t Timeout, size_t* EventCount);
 
 // Communication system calls
 OsStatus_t  ScPipeOpen(int Port, int Type);
@@ -82,6 +92,7 @@ OsStatus_t  ScPipeClose(int Port);
 OsStatus_t  ScPipeRead(int Port, uint8_t* Container, size_t Length);
 OsStatus_t  ScPipeWrite(UUId_t ProcessId, int Port, uint8_t* Message, size_t Length);
 OsStatus_t  ScPipeReceive(UUId_t ProcessId, int Port, uint8_t* Message, size_t Length);
+OsStatus_t  ScRpcInherit(MRemoteCallAddress_t* RemoteAddress);
 OsStatus_t  ScRpcResponse(MRemoteCall_t* RemoteCall);
 OsStatus_t  ScRpcExecute(MRemoteCall_t* RemoteCall, int Async);
 OsStatus_t  ScRpcListen(int Port, MRemoteCall_t* RemoteCall, uint8_t* ArgumentBuffer);
@@ -126,7 +137,7 @@ OsStatus_t  ScTimersStop(UUId_t TimerId);
 OsStatus_t  NoOperation(void) { return OsSuccess; }
 
 // The static system calls function table.
-uintptr_t   GlbSyscallTable[111] = {
+uintptr_t   GlbSyscallTable[113] = {
     DefineSyscall(ScSystemDebug),
 
     /* Process & Threading
@@ -155,7 +166,7 @@ uintptr_t   GlbSyscallTable[111] = {
     DefineSyscall(ScThreadGetCurrentId),
     DefineSyscall(ScThreadSetCurrentName),
     DefineSyscall(ScThreadGetCurrentName),
-    DefineSyscall(NoOperation),
+    DefineSyscall(ScThreadSetRealtime),
     DefineSyscall(NoOperation),
     DefineSyscall(NoOperation),
     DefineSyscall(NoOperation),
@@ -168,11 +179,11 @@ uintptr_t   GlbSyscallTable[111] = {
     DefineSyscall(ScWaitForObject),
     DefineSyscall(ScSignalHandle),
     DefineSyscall(ScSignalHandleAll),
-    DefineSyscall(NoOperation),
-    DefineSyscall(NoOperation),
-    DefineSyscall(NoOperation),
-    DefineSyscall(NoOperation),
-    DefineSyscall(NoOperation),
+    DefineSyscall(ScEventPortCreate),
+    DefineSyscall(ScEventPortAttach),
+    DefineSyscall(ScEventPortDetach),
+    DefineSyscall(ScEventPortWait),
+    DefineSyscall(ScConditionGetOwner),
 
     /* Memory Functions - 41 */
     DefineSyscall(ScMemoryAllocate),
@@ -204,7 +215,7 @@ uintptr_t   GlbSyscallTable[111] = {
     DefineSyscall(ScPipeRead),
     DefineSyscall(ScPipeWrite),
     DefineSyscall(ScPipeReceive),
-    DefineSyscall(NoOperation),
+    DefineSyscall(ScRpcInherit),
     DefineSyscall(ScRpcExecute),
     DefineSyscall(ScRpcResponse),
     DefineSyscall(ScRpcListen),
@@ -220,7 +231,7 @@ uintptr_t   GlbSyscallTable[111] = {
     DefineSyscall(ScSystemTime),
     DefineSyscall(ScQueryDisplayInformation),
     DefineSyscall(ScCreateDisplayFramebuffer),
-    DefineSyscall(NoOperation),
+    DefineSyscall(ScQuerySharedPage),
 
     /* Driver Functions - 81 
      * - ACPI Support */
@@ -262,5 +273,10 @@ uintptr_t   GlbSyscallTable[111] = {
     DefineSyscall(NoOperation),
     DefineSyscall(NoOperation),
     DefineSyscall(NoOperation),
-    DefineSyscall(NoOperation)
+    DefineSyscall(NoOperation),
+
+    /* System Functions - 111
+     * - Profiling Support */
+    DefineSyscall(ScProfilerControl),
+    DefineSyscall(ScProfilerRead)
 };
@@ -195,6 +195,7 @@ ScLoadDriver(
     MCoreModule_t *Module           = NULL;
     MString_t *Path                 = NULL;
     MRemoteCall_t RemoteCall        = { { 0 }, { 0 }, 0 };
+    OsStatus_t Status;
 
     // Trace
     TRACE("ScLoadDriver(Vid 0x%x, Pid 0x%x, Class 0x%x, Subclass 0x%x)",
@@ -257,9 +258,12 @@ ScLoadDriver(
     RPCInitialize(&RemoteCall, Server->Base.Id, 1, __DRIVER_REGISTERINSTANCE);
     RPCSetArgument(&RemoteCall, 0, Device, Length);
 
-    // Make sure the server has opened it's comm-pipe
+    // Make sure the server has opened it's comm-pipe, the reference
+    // from the lookup keeps it alive untill the request has been sent
     PhoenixWaitAshPipe(&Server->Base, PIPE_REMOTECALL);
-    return ScRpcExecute(&RemoteCall, 1);
+    Status = ScRpcExecute(&RemoteCall, 1);
+    PhoenixReleaseAsh(&Server->Base);
+    return Status;
 }
 
 /* ScRegisterInterrupt 
@@ -26,6 +26,7 @@
 #include <system/utils.h>
 #include <scheduler.h>
 #include <threading.h>
+#include <epoch.h>
 #include <debug.h>
 #include <pipe.h>
 
@@ -85,6 +86,7 @@ ScPipeWrite(
 {
     // Variables
     SystemPipe_t *Pipe      = NULL;
+    MCoreAsh_t *Ash         = NULL;
 
     // Sanitize parameters
     if (Message == NULL || Length == 0) {
@@ -107,13 +109,23 @@ ScPipeWrite(
             return OsError;
         }
     }
-    else { Pipe = PhoenixGetAshPipe(PhoenixGetAsh(ProcessId), Port); }
+    else {
+        // Keep the process alive while writing to its pipe
+        Ash     = PhoenixAcquireAsh(ProcessId);
+        Pipe    = PhoenixGetAshPipe(Ash, Port);
+    }
     if (Pipe == NULL) {
         ERROR("Invalid pipe %i", Port);
+        if (Ash != NULL) {
+            PhoenixReleaseAsh(Ash);
+        }
         return OsError;
     }
 
     WriteSystemPipe(Pipe, Message, Length);
+    if (Ash != NULL) {
+        PhoenixReleaseAsh(Ash);
+    }
     return OsSuccess;
 }
 
@@ -128,6 +140,7 @@ ScPipeReceive(
 {
     // Variables
     SystemPipe_t *Pipe      = NULL;
+    MCoreAsh_t *Ash         = NULL;
 
     // Sanitize parameters
     if (Message == NULL || Length == 0 || ProcessId == UUID_INVALID) {
@@ -135,13 +148,19 @@ ScPipeReceive(
         return OsError;
     }
 
-    Pipe = PhoenixGetAshPipe(PhoenixGetAsh(ProcessId), Port);
+    // Keep the process alive while reading from its pipe
+    Ash  = PhoenixAcquireAsh(ProcessId);
+    Pipe = PhoenixGetAshPipe(Ash, Port);
     if (Pipe == NULL) {
         ERROR("Invalid pipe %i", Port);
+        if (Ash != NULL) {
+            PhoenixReleaseAsh(Ash);
+        }
         return OsError;
     }
 
     ReadSystemPipe(Pipe, Message, Length);
+    PhoenixReleaseAsh(Ash);
     return OsSuccess;
 }
 
@@ -181,8 +200,9 @@ ScRpcExecute(
     size_t TotalLength  = sizeof(MRemoteCall_t);
     int i               = 0;
 
-    // Start out by resolving both the process and pipe
-    Ash     = PhoenixGetAsh(RemoteCall->To.Process);
+    // Start out by resolving both the process and pipe, the process is
+    // kept alive untill the request has been written
+    Ash     = PhoenixAcquireAsh(RemoteCall->To.Process);
     Pipe    = PhoenixGetAshPipe(Ash, RemoteCall->To.Port);
 
     // Sanitize the lookups
@@ -193,6 +213,7 @@ ScRpcExecute(
         else {
             ERROR("Port %u did not exist in target 0x%x",
                 RemoteCall->To.Port, RemoteCall->To.Process);
+            PhoenixReleaseAsh(Ash);
         }
         return OsError;
     }
@@ -214,6 +235,12 @@ ScRpcExecute(
         }
     }
 
+    // Synchronous callers can lend their priority to whichever thread
+    // in the target ends up handling the call, see ScRpcInherit
+    if (!Async) {
+        Thread->RpcTarget = RemoteCall->To.Process;
+    }
+
     // Setup producer access
     AcquireSystemPipeProduction(Pipe, TotalLength, &State);
     WriteSystemPipeProduction(&State, (const uint8_t*)RemoteCall, sizeof(MRemoteCall_t));
@@ -224,17 +251,21 @@ ScRpcExecute(
                 RemoteCall->Arguments[i].Length);
         }
     }
+    PhoenixReleaseAsh(Ash);
 
     // Async request? Because if yes, don't
     // wait for response
     if (Async) {
         return OsSuccess;
     }
-    return ScRpcResponse(RemoteCall);
+    ScRpcResponse(RemoteCall);
+    Thread->RpcTarget = UUID_INVALID;
+    return OsSuccess;
 }
 
 /* ScRpcListen
- * Listens for a new rpc-message on the default rpc-pipe. */
+ * Listens for a new rpc-message on the default rpc-pipe. The listening thread runs
+ * at the priority of the caller untill it responds or listens for the next message. */
 OsStatus_t
 ScRpcListen(
     _In_ int            Port,
@@ -244,6 +275,8 @@ ScRpcListen(
     // Variables
     SystemPipeUserState_t State;
     uint8_t *BufferPointer = ArgumentBuffer;
+    MCoreThread_t *Thread;
+    MCoreThread_t *Caller;
     SystemPipe_t *Pipe;
     MCoreAsh_t *Ash;
     size_t Length;
@@ -257,6 +290,10 @@ ScRpcListen(
     Ash     = PhoenixGetCurrentAsh();
     Pipe    = PhoenixGetAshPipe(Ash, Port);
 
+    // Don't wait for the next message at the priority of the previous caller
+    Thread = ThreadingGetCurrentThread(CpuGetCurrentId());
+    SchedulerThreadDisinherit(Thread, SCHEDULER_INHERIT_RPC);
+
     // Start consuming
     AcquireSystemPipeConsumption(Pipe, &Length, &State);
     ReadSystemPipeConsumption(&State, (uint8_t*)RemoteCall, sizeof(MRemoteCall_t));
@@ -268,12 +305,48 @@ ScRpcListen(
         }
     }
     FinalizeSystemPipeConsumption(Pipe, &State);
+
+    // Inherit the priority of the caller while handling the call
+    EpochEnter();
+    Caller = ThreadingGetThread(RemoteCall->From.Thread);
+    if (Caller != NULL) {
+        SchedulerThreadInherit(Thread, SchedulerThreadGetRank(Caller), SCHEDULER_INHERIT_RPC);
+    }
+    EpochLeave();
     return OsSuccess;
 }
 
+/* ScRpcInherit
+ * Lets the calling thread handle a call received by another thread of the same
+ * process at the priority of the caller. The caller must still be waiting for a
+ * response from this process. Passing NULL drops the inherited priority again. */
+OsStatus_t
+ScRpcInherit(
+    _In_ MRemoteCallAddress_t*  RemoteAddress)
+{
+    // Variables
+    MCoreThread_t *Thread   = ThreadingGetCurrentThread(CpuGetCurrentId());
+    MCoreThread_t *Caller;
+    OsStatus_t Status       = OsError;
+
+    SchedulerThreadDisinherit(Thread, SCHEDULER_INHERIT_RPC);
+    if (RemoteAddress == NULL) {
+        return OsSuccess;
+    }
+
+    EpochEnter();
+    Caller = ThreadingGetThread(RemoteAddress->Thread);
+    if (Caller != NULL && Caller->RpcTarget == Thread->AshId) {
+        SchedulerThreadInherit(Thread, SchedulerThreadGetRank(Caller), SCHEDULER_INHERIT_RPC);
+        Status = OsSuccess;
+    }
+    EpochLeave();
+    return Status;
+}
+
 /* ScRpcRespond
  * A wrapper for sending an RPC response to the calling thread. Each thread has each it's response
- * channel to avoid any concurrency issues. */
+ * channel to avoid any concurrency issues. The responder drops the priority lent by the caller. */
 OsStatus_t
 ScRpcRespond(
     _In_ MRemoteCallAddress_t*  RemoteAddress,
@@ -281,7 +354,7 @@ ScRpcRespond(
     _In_ size_t                 Length)
 {
     // Variables
-    MCoreThread_t *Thread   = ThreadingGetThread(RemoteAddress->Thread);
+    MCoreThread_t *Thread   = ThreadingAcquireThread(RemoteAddress->Thread);
     SystemPipe_t *Pipe      = NULL;
 
     // Sanitize thread still exists
@@ -290,8 +363,14 @@ ScRpcRespond(
     }
     if (Pipe == NULL) {
         ERROR("Thread %u did not exist", RemoteAddress->Thread);
+        if (Thread != NULL) {
+            ThreadingReleaseThread(Thread);
+        }
+        SchedulerThreadDisinherit(ThreadingGetCurrentThread(CpuGetCurrentId()), SCHEDULER_INHERIT_RPC);
         return OsError;
     }
     WriteSystemPipe(Pipe, Buffer, Length);
+    ThreadingReleaseThread(Thread);
+    SchedulerThreadDisinherit(ThreadingGetCurrentThread(CpuGetCurrentId()), SCHEDULER_INHERIT_RPC);
     return OsSuccess;
 }
@@ -41,6 +41,7 @@ ScMemoryAllocate(
 {
     // Variables
     uintptr_t AllocatedAddress;
+    Flags_t Attributes = MEMORY_AREA_COMMITTED | MAPPING_USERSPACE;
     MCoreAsh_t *Ash;
 
     // Locate the current running process
@@ -48,11 +49,22 @@ ScMemoryAllocate(
     if (Ash == NULL || Size == 0) {
         return OsError;
     }
-    
-    // Now do the allocation in the user-bitmap 
-    // since memory is managed in userspace for speed
-    AllocatedAddress = AllocateBlocksInBlockmap(Ash->Heap, __MASK, Size);
-    if (AllocatedAddress == 0) {
+
+    // Reservations only claim the address space, it must be committed
+    // with MemoryProtect before it can be used
+    if (Flags & MEMORY_RESERVE) {
+        if (RangeTreeAllocate(Ash->Heap, Size, MEMORY_AREA_RESERVED, &AllocatedAddress) != OsSuccess) {
+            return OsError;
+        }
+        *VirtualAddress     = AllocatedAddress;
+        *PhysicalAddress    = 0;
+        return OsSuccess;
+    }
+
+    if (Flags & MEMORY_UNCHACHEABLE) {
+        Attributes |= MAPPING_NOCACHE;
+    }
+    if (RangeTreeAllocate(Ash->Heap, Size, Attributes, &AllocatedAddress) != OsSuccess) {
         return OsError;
     }
 
@@ -81,7 +93,7 @@ ScMemoryAllocate(
         // Do the actual mapping
         if (CreateSystemMemorySpaceMapping(GetCurrentSystemMemorySpace(), 
             PhysicalAddress, &AllocatedAddress, Size, ExtendedFlags, __MASK) != OsSuccess) {
-            ReleaseBlockmapRegion(Ash->Heap, AllocatedAddress, Size);
+            RangeTreeRelease(Ash->Heap, AllocatedAddress, Size);
             *VirtualAddress = 0;
             return OsError;
         }
@@ -101,7 +113,8 @@ ScMemoryAllocate(
 }
 
 /* ScMemoryFree
- * Free's previous allocated memory, given an address and a size (though not needed for now!) */
+ * Free's previous allocated memory, given an address and a size. Parts of an allocation
+ * can be freed, the remaining parts stay valid. */
 OsStatus_t 
 ScMemoryFree(
     _In_ uintptr_t  Address, 
@@ -116,9 +129,8 @@ ScMemoryFree(
         return OsError;
     }
 
-    // Now do the deallocation in the user-bitmap 
-    // since memory is managed in userspace for speed
-    if (ReleaseBlockmapRegion(Ash->Heap, Address, Size) != OsSuccess) {
+    // Release the address space, the areas are split as neccessary
+    if (RangeTreeRelease(Ash->Heap, Address, Size) != OsSuccess) {
         ERROR("ScMemoryFree(Address 0x%x, Size 0x%x) was invalid", Address, Size);
         return OsError;
     }
@@ -141,7 +153,7 @@ ScMemoryQuery(
 
 /* MemoryProtect
  * Changes the protection flags of a previous memory allocation
- * made by MemoryAllocate */
+ * made by MemoryAllocate. Reserved memory is committed by this. */
 OsStatus_t
 ScMemoryProtect(
     _In_  void*     MemoryPointer,
@@ -150,15 +162,32 @@ ScMemoryProtect(
     _Out_ Flags_t*  PreviousFlags)
 {
     // Variables
-    uintptr_t AddressStart = (uintptr_t)MemoryPointer;
+    uintptr_t AddressStart  = (uintptr_t)MemoryPointer;
+    MCoreAsh_t *Ash         = PhoenixGetCurrentAsh();
+    Flags_t MappingFlags    = MAPPING_USERSPACE;
     if (MemoryPointer == NULL || Length == 0) {
         return OsSuccess;
     }
 
-    // We must force the application flag as it will remove
-    // the user-accessibility if we allow it to change
+    // Translate the memory flags to mapping flags, we must force the application 
+    // flag as it will remove the user-accessibility if we allow it to change
+    if (!(Flags & MEMORY_WRITE)) {
+        MappingFlags |= MAPPING_READONLY;
+    }
+    if (Flags & MEMORY_EXECUTABLE) {
+        MappingFlags |= MAPPING_EXECUTABLE;
+    }
+
+    // Heap areas remember the protection so pages touched later get it too,
+    // the range is split from the rest of the area if it's partial
+    if (Ash != NULL && RangeTreeLookup(Ash->Heap, AddressStart, NULL, NULL, NULL) == OsSuccess) {
+        if (RangeTreeSetAttributes(Ash->Heap, AddressStart, Length, MEMORY_AREA_COMMITTED 
+            | (MappingFlags & MEMORY_AREA_MAPPING_MASK), NULL) != OsSuccess) {
+            return OsError;
+        }
+    }
     return ChangeSystemMemorySpaceProtection(GetCurrentSystemMemorySpace(), 
-        AddressStart, Length, Flags | MAPPING_USERSPACE, PreviousFlags);
+        AddressStart, Length, MappingFlags, PreviousFlags);
 }
 
 /* ScCreateBuffer
@@ -52,11 +52,17 @@ ScGetWorkingDirectory(
 
     // Sanitize parameters
     if (Process == NULL || PathBuffer == NULL) {
+        if (Process != NULL && ProcessId != UUID_INVALID) {
+            PhoenixReleaseAsh(&Process->Base);
+        }
         return OsError;
     }
     
     BytesToCopy = MIN(strlen(MStringRaw(Process->WorkingDirectory)), MaxLength);
     memcpy(PathBuffer, MStringRaw(Process->WorkingDirectory), BytesToCopy);
+    if (ProcessId != UUID_INVALID) {
+        PhoenixReleaseAsh(&Process->Base);
+    }
     return OsSuccess;
 }
 
@@ -144,7 +150,8 @@ ScCreateFileMapping(
 
     // Create a new mapping
     // We only read in block-sizes of page-size, this means the
-    Mapping->Flags          = (Flags_t)Parameters->Flags;
+    Mapping->Header.Data    = Mapping;
+    Mapping->Flags          = (Flags_t)Parameters->Flags & ~(FILE_MAPPING_IMAGE);
     Mapping->FileHandle     = Parameters->FileHandle;
 
     // Calculate offsets
@@ -178,6 +185,9 @@ ScDestroyFileMapping(
     // Iterate and find the node first
     _foreach(Node, Ash->FileMappings) {
         Mapping = (MCoreAshFileMapping_t*)Node;
+        if (Mapping->Flags & FILE_MAPPING_IMAGE) {
+            continue; // Owned by the loaded images
+        }
         if (ISINRANGE((uintptr_t)MemoryPointer, Mapping->BufferObject.Address, (Mapping->BufferObject.Address + Mapping->Length) - 1)) {
             break; // Continue to unmap process
         }
@@ -212,7 +222,7 @@ ScDestroyFileMapping(
         }
 
         // Free the mapping from the heap
-        ReleaseBlockmapRegion(Ash->Heap, Mapping->BufferObject.Address, Mapping->Length);
+        RangeTreeRelease(Ash->Heap, Mapping->BufferObject.Address, Mapping->Length);
         DestroyHandle(Mapping->BufferObject.Handle);
         kfree(Mapping);
     }
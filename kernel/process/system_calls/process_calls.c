@@ -109,9 +109,11 @@ ScProcessJoin(
     _Out_ int*      ExitCode)
 {
     // Variables
-    MCoreAsh_t *Process = PhoenixGetAsh(ProcessId);
+    MCoreAsh_t *Process = PhoenixAcquireAsh(ProcessId);
+    OsStatus_t Status   = OsError;
     int SleepResult     = 0;
     
+    // The reference keeps the exit-code readable after the process has exitted
     if (Process == NULL) {
         return OsError;
     }
@@ -120,9 +122,10 @@ ScProcessJoin(
         if (ExitCode != NULL) {
             *ExitCode = Process->Code;
         }
-        return OsSuccess;
+        Status = OsSuccess;
     }
-    return OsError;
+    PhoenixReleaseAsh(Process);
+    return Status;
 }
 
 /* ScProcessKill
@@ -229,15 +232,18 @@ ScProcessRaise(
 {
     // Variables
     MCoreProcess_t *Process = NULL;
+    UUId_t MainThread;
 
     // Lookup process
     Process = PhoenixGetProcess(ProcessId);
     if (Process == NULL) {
         return OsError;
     }
+    MainThread = Process->Base.MainThread;
+    PhoenixReleaseAsh(&Process->Base);
 
     // Create the signal
-    return SignalCreate(Process->Base.MainThread, Signal);
+    return SignalCreate(MainThread, Signal);
 }
 
 /* ScProcessGetStartupInformation
@@ -22,8 +22,28 @@
 //#define __TRACE
 
 #include <os/osdefs.h>
+#include <process/phoenix.h>
+#include <system/utils.h>
+#include <interrupts.h>
+#include <threading.h>
 #include <scheduler.h>
+#include <eventport.h>
+#include <timers.h>
+#include <epoch.h>
+#include <debug.h>
 #include <heap.h>
+#include <string.h>
+
+/* SystemCondition
+ * The handle of a condition variable is the address of this record, it is kept
+ * in a list so handles passed in from userspace can be validated. */
+typedef struct _SystemCondition {
+    CollectionItem_t    Header;
+    UUId_t              Owner;
+    EpochItem_t         Retire;
+} SystemCondition_t;
+
+static Collection_t Conditions = COLLECTION_INIT(KeyPointer);
 
 /* ScConditionCreate
  * Create a new shared handle 
@@ -32,12 +52,20 @@ OsStatus_t
 ScConditionCreate(
     _Out_ Handle_t *Handle)
 {
+    // Variables
+    SystemCondition_t *Condition;
+
     // Sanitize input
     if (Handle == NULL) {
         return OsError;
     }
  
-    *Handle = (Handle_t)kmalloc(sizeof(Handle_t));
+    Condition = (SystemCondition_t*)kmalloc(sizeof(SystemCondition_t));
+    memset((void*)Condition, 0, sizeof(SystemCondition_t));
+    Condition->Header.Key.Pointer   = (void*)Condition;
+    Condition->Owner                = ThreadingGetCurrentThread(CpuGetCurrentId())->AshId;
+    CollectionAppend(&Conditions, &Condition->Header);
+    *Handle = (Handle_t)Condition;
     return OsSuccess;
 }
 
@@ -48,10 +76,50 @@ OsStatus_t
 ScConditionDestroy(
     _In_ Handle_t Handle)
 {
-    kfree(Handle);
+    // Variables
+    SystemCondition_t *Condition;
+    DataKey_t Key;
+
+    Key.Pointer = (void*)Handle;
+    EpochEnter();
+    Condition   = (SystemCondition_t*)CollectionGetNodeByKey(&Conditions, Key, 0);
+    EpochLeave();
+    if (Condition == NULL) {
+        return OsError;
+    }
+    CollectionUnlinkNode(&Conditions, &Condition->Header);
+    EpochDefer(&Condition->Retire, kfree, Condition);
     return OsSuccess;
 }
 
+/* ScConditionGetOwner
+ * Retrieves the process that created the given condition variable. Fails if
+ * the handle does not refer to a condition variable. */
+OsStatus_t
+ScConditionGetOwner(
+    _In_  Handle_t  Handle,
+    _Out_ UUId_t*   Owner)
+{
+    // Variables
+    SystemCondition_t *Condition;
+    OsStatus_t Status = OsError;
+    DataKey_t Key;
+
+    if (Owner == NULL) {
+        return OsError;
+    }
+
+    Key.Pointer = (void*)Handle;
+    EpochEnter();
+    Condition   = (SystemCondition_t*)CollectionGetNodeByKey(&Conditions, Key, 0);
+    if (Condition != NULL) {
+        *Owner  = Condition->Owner;
+        Status  = OsSuccess;
+    }
+    EpochLeave();
+    return Status;
+}
+
 /* ScSignalHandle
  * Signals a handle for wakeup 
  * This is primarily used for condition
@@ -91,3 +159,104 @@ ScWaitForObject(
         return OsError;
     }
 }
+
+/* ScEventPortCreate
+ * Creates a new event port for the calling process. */
+OsStatus_t
+ScEventPortCreate(
+    _Out_ UUId_t*   Handle)
+{
+    if (Handle == NULL) {
+        return OsError;
+    }
+    return CreateSystemEventPort(Handle);
+}
+
+/* ScEventPortAttach
+ * Resolves the source and attaches it to the event port. Pipes, timers
+ * and interrupts must belong to the calling process. */
+OsStatus_t
+ScEventPortAttach(
+    _In_ UUId_t     Handle,
+    _In_ int        Type,
+    _In_ UUId_t     SourceId,
+    _In_ Flags_t    Events,
+    _In_ void*      Context)
+{
+    // Variables
+    EventSource_t *Source = NULL;
+
+    switch (Type) {
+        case EVENTPORT_SOURCE_PIPE: {
+            SystemPipe_t *Pipe = PhoenixGetAshPipe(PhoenixGetCurrentAsh(), (int)SourceId);
+            if (Pipe != NULL) {
+                Source = &Pipe->Events;
+            }
+        } break;
+        case EVENTPORT_SOURCE_THREAD: {
+            MCoreThread_t *Thread = ThreadingAcquireThread(SourceId);
+            OsStatus_t Status;
+            if (Thread == NULL) {
+                return OsError;
+            }
+            Status = AttachSystemEventPort(Handle, &Thread->Events, Type, SourceId, Events, Context);
+            ThreadingReleaseThread(Thread);
+            return Status;
+        }
+        case EVENTPORT_SOURCE_PROCESS: {
+            MCoreAsh_t *Ash = PhoenixAcquireAsh(SourceId);
+            OsStatus_t Status;
+            if (Ash == NULL) {
+                return OsError;
+            }
+            Status = AttachSystemEventPort(Handle, &Ash->Events, Type, SourceId, Events, Context);
+            PhoenixReleaseAsh(Ash);
+            return Status;
+        }
+        case EVENTPORT_SOURCE_TIMER: {
+            // One-shot timers are freed when they expire, so the timer is
+            // attached while the timer lock is held
+            return TimersAttachEventPort(SourceId, Handle, Events, Context);
+        }
+        case EVENTPORT_SOURCE_INTERRUPT: {
+            // Interrupts can be unregistered at any time, so the interrupt is
+            // attached while the interrupt table lock is held
+            return InterruptAttachEventPort(SourceId, Handle, Events, Context);
+        }
+
+        default: {
+            ERROR("Invalid event port source type %i", Type);
+            return OsError;
+        }
+    }
+
+    if (Source == NULL) {
+        return OsError;
+    }
+    return AttachSystemEventPort(Handle, Source, Type, SourceId, Events, Context);
+}
+
+/* ScEventPortDetach
+ * Detaches a source from the event port. */
+OsStatus_t
+ScEventPortDetach(
+    _In_ UUId_t     Handle,
+    _In_ int        Type,
+    _In_ UUId_t     SourceId)
+{
+    return DetachSystemEventPort(Handle, Type, SourceId);
+}
+
+/* ScEventPortWait
+ * Waits for sources on the event port to become ready, returns the number
+ * of ready sources in <EventCount>. */
+OsStatus_t
+ScEventPortWait(
+    _In_  UUId_t            Handle,
+    _In_  EventPortEvent_t* Events,
+    _In_  size_t            MaxEvents,
+    _In_  size_t            Timeout,
+    _Out_ size_t*           EventCount)
+{
+    return WaitForSystemEventPort(Handle, Events, MaxEvents, Timeout, EventCount);
+}
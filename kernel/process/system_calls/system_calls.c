@@ -28,6 +28,8 @@
 #include <system/video.h>
 #include <system/utils.h>
 #include <memoryspace.h>
+#include <profiler.h>
+#include <machine.h>
 #include <timers.h>
 #include <video.h>
 #include <debug.h>
@@ -168,8 +170,8 @@ ScCreateDisplayFramebuffer(void) {
     }
 
     // Allocate the neccessary size
-    FbVirtual = AllocateBlocksInBlockmap(PhoenixGetCurrentAsh()->Heap, __MASK, FbSize);
-    if (FbVirtual == 0) {
+    if (RangeTreeAllocate(PhoenixGetCurrentAsh()->Heap, FbSize, 
+        MEMORY_AREA_COMMITTED | MAPPING_USERSPACE | MAPPING_NOCACHE, &FbVirtual) != OsSuccess) {
         return NULL;
     }
 
@@ -180,3 +182,55 @@ ScCreateDisplayFramebuffer(void) {
     }
     return (void*)FbVirtual;
 }
+
+/* ScQuerySharedPage
+ * Returns the address of the shared system page of the current process, the page
+ * is read-only and kept up to date by the kernel. Returns NULL if not mapped. */
+void*
+ScQuerySharedPage(void)
+{
+    if (PhoenixGetCurrentAsh() == NULL
+        || IsSystemMemoryPresent(GetCurrentSystemMemorySpace(), 
+            GetMachine()->MemoryMap.SharedPage.Start) != OsSuccess) {
+        return NULL;
+    }
+    return (void*)GetMachine()->MemoryMap.SharedPage.Start;
+}
+
+/* ScProfilerControl
+ * Starts, stops or resets the system wide sampling profiler. The interval is
+ * given in scheduler ticks and only used when starting. */
+OsStatus_t
+ScProfilerControl(
+    _In_ int            Command,
+    _In_ size_t         Interval)
+{
+    switch (Command) {
+        case PROFILER_START: {
+            return ProfilerStart(Interval);
+        }
+        case PROFILER_STOP: {
+            return ProfilerStop();
+        }
+        case PROFILER_RESET: {
+            return ProfilerReset();
+        }
+        default: {
+            return OsError;
+        }
+    }
+}
+
+/* ScProfilerRead
+ * Drains samples from the sampling profiler as symbolized folded stacks */
+OsStatus_t
+ScProfilerRead(
+    _In_  char*         Buffer,
+    _In_  size_t        Length,
+    _Out_ size_t*       BytesRead)
+{
+    if (Buffer == NULL || Length == 0 || BytesRead == NULL) {
+        return OsError;
+    }
+    return ProfilerRead(Buffer, Length, BytesRead);
+}
@@ -22,6 +22,7 @@
 //#define __TRACE
 
 #include <os/osdefs.h>
+#include <process/phoenix.h>
 #include <system/thread.h>
 #include <system/utils.h>
 #include <threading.h>
@@ -64,11 +65,18 @@ ScThreadJoin(
 {
     // Variables
     UUId_t PId      = ThreadingGetCurrentThread(CpuGetCurrentId())->AshId;
+    MCoreThread_t *Thread;
     int ResultCode  = 0;
+    UUId_t Owner;
 
     // Perform security checks
-    if (ThreadingGetThread(ThreadId) == NULL
-        || ThreadingGetThread(ThreadId)->AshId != PId) {
+    Thread = ThreadingAcquireThread(ThreadId);
+    if (Thread == NULL) {
+        return OsError;
+    }
+    Owner = Thread->AshId;
+    ThreadingReleaseThread(Thread);
+    if (Owner != PId) {
         return OsError;
     }
     ResultCode = ThreadingJoinThread(ThreadId);
@@ -97,10 +105,17 @@ ScThreadSignal(
 {
     // Variables
     UUId_t PId = ThreadingGetCurrentThread(CpuGetCurrentId())->AshId;
+    MCoreThread_t *Thread;
+    UUId_t Owner;
 
     // Perform security checks
-    if (ThreadingGetThread(ThreadId) == NULL
-        || ThreadingGetThread(ThreadId)->AshId != PId) {
+    Thread = ThreadingAcquireThread(ThreadId);
+    if (Thread == NULL) {
+        return OsError;
+    }
+    Owner = Thread->AshId;
+    ThreadingReleaseThread(Thread);
+    if (Owner != PId) {
         ERROR("Thread does not belong to same process");
         return OsError;
     }
@@ -181,3 +196,27 @@ ScThreadGetCurrentName(char *ThreadNameBuffer, size_t MaxLength)
     strncpy(ThreadNameBuffer, Thread->Name, MaxLength);
     return OsSuccess;
 }
+
+/* ScThreadSetRealtime
+ * Moves the current thread into the real-time class at the given level, or back to
+ * the normal class if the level is negative. Only servers, drivers and processes that
+ * registered as a service may run real-time. */
+OsStatus_t
+ScThreadSetRealtime(
+    _In_ int        Level)
+{
+    // Variables
+    MCoreThread_t *Thread       = ThreadingGetCurrentThread(CpuGetCurrentId());
+
+    if (Thread == NULL) {
+        return OsError;
+    }
+    if (Level < 0) {
+        return SchedulerThreadSetRealtime(Thread, SCHEDULER_RANK_NONE);
+    }
+    if (THREADING_RUNMODE(Thread->Flags) == THREADING_USERMODE
+        && PhoenixIsAshAliased(PhoenixGetCurrentAsh()) != OsSuccess) {
+        return OsError;
+    }
+    return SchedulerThreadSetRealtime(Thread, Level);
+}
@@ -0,0 +1,500 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - Sampling Profiler
+ * - Samples the instruction pointer and call stack of the running thread
+ *   from the scheduler timer and exports them as symbolized folded stacks
+ */
+#define __MODULE "PROF"
+//#define __TRACE
+
+#include <system/interrupts.h>
+#include <system/utils.h>
+#include <process/phoenix.h>
+#include <criticalsection.h>
+#include <memoryspace.h>
+#include <threading.h>
+#include <profiler.h>
+#include <machine.h>
+#include <debug.h>
+#include <heap.h>
+#include <arch.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <stdio.h>
+
+/* ProfilerCore
+ * The sample ring-buffer of a core. The timer interrupt of the core is the only
+ * producer, readers are serialized by the profiler lock. */
+typedef struct _ProfilerCore {
+    atomic_uint         Head;
+    atomic_uint         Tail;
+    size_t              Ticks;
+    size_t              Dropped;
+    ProfilerSample_t    Samples[PROFILER_SAMPLES_PER_CORE];
+} ProfilerCore_t;
+
+/* ProfilerRead
+ * The number of samples copied out of a core buffer at a time */
+#define PROFILER_READ_BATCH 16
+
+/* Globals
+ * State of the profiler, the sample buffers are allocated on first start */
+static CriticalSection_t ProfilerSyncObject             = CRITICALSECTION_INITIALIZE(CRITICALSECTION_PLAIN);
+static ProfilerCore_t *ProfilerCores[PROFILER_MAX_CORES] = { 0 };
+static volatile size_t ProfilerInterval                 = PROFILER_DEFAULT_INTERVAL;
+static volatile int ProfilerEnabled                     = 0;
+
+/* ProfilerIsFrameValid
+ * Validates that a frame-pointer can be followed without faulting. Kernel frames
+ * must be on a kernel stack (heap), user frames on a thread stack. */
+static int
+ProfilerIsFrameValid(
+    _In_ SystemMemorySpace_t*   MemorySpace,
+    _In_ uintptr_t              Frame,
+    _In_ int                    UserFrame)
+{
+    if (Frame & (sizeof(uintptr_t) - 1)) {
+        return 0;
+    }
+
+    if (UserFrame) {
+        if (Frame < MEMORY_LOCATION_RING3_THREAD_START
+            || Frame > (MEMORY_LOCATION_RING3_THREAD_END - (2 * sizeof(uintptr_t)))) {
+            return 0;
+        }
+    }
+    else if (Frame < MEMORY_LOCATION_HEAP || Frame > (MEMORY_LOCATION_HEAP_END - (2 * sizeof(uintptr_t)))) {
+        return 0;
+    }
+
+    // Never touch a page that is not mapped, we are in interrupt context
+    return IsSystemMemoryPresent(MemorySpace, Frame) == OsSuccess
+        && IsSystemMemoryPresent(MemorySpace, Frame + sizeof(uintptr_t)) == OsSuccess;
+}
+
+/* ProfilerCaptureStack
+ * Walks the frame-pointer chain starting at the given frame and stores the return
+ * addresses in the sample. Stops at the first frame that does not look sane. */
+static void
+ProfilerCaptureStack(
+    _In_ ProfilerSample_t*  Sample,
+    _In_ uintptr_t          Frame)
+{
+    // Variables
+    SystemMemorySpace_t *MemorySpace    = GetCurrentSystemMemorySpace();
+    int UserFrame                       = Sample->Frames[0] >= MEMORY_LOCATION_RING3_CODE
+        && Sample->Frames[0] < MEMORY_LOCATION_RING3_CODE_END;
+
+    while (Sample->Depth < PROFILER_MAX_FRAMES && ProfilerIsFrameValid(MemorySpace, Frame, UserFrame)) {
+        uintptr_t *FramePointer = (uintptr_t*)Frame;
+        uintptr_t ReturnAddress = FramePointer[1];
+        if (ReturnAddress == 0) {
+            break;
+        }
+        Sample->Frames[Sample->Depth++] = ReturnAddress;
+
+        // Stacks grow downwards, the caller frame must be above
+        if (FramePointer[0] <= Frame) {
+            break;
+        }
+        Frame = FramePointer[0];
+    }
+}
+
+/* ProfilerStart
+ * Allocates the sample buffers for all cores and enables sampling on every
+ * <Interval>'th timer tick. Existing samples are kept. */
+OsStatus_t
+ProfilerStart(
+    _In_ size_t             Interval)
+{
+    // Variables
+    ProfilerCore_t *Buffers[PROFILER_MAX_CORES] = { 0 };
+    SystemCpu_t *Processor                      = &GetMachine()->Processor;
+    int i;
+
+    // Allocate outside the lock, the heap might have to be grown
+    while (Processor != NULL) {
+        for (i = 0; i < Processor->NumberOfCores; i++) {
+            UUId_t CoreId = (i == 0) ? Processor->PrimaryCore.Id : Processor->ApplicationCores[i - 1].Id;
+            if (CoreId < PROFILER_MAX_CORES && ProfilerCores[CoreId] == NULL && Buffers[CoreId] == NULL) {
+                Buffers[CoreId] = (ProfilerCore_t*)kmalloc(sizeof(ProfilerCore_t));
+                if (Buffers[CoreId] == NULL) {
+                    ERROR("Failed to allocate sample buffer for core %u", CoreId);
+                    continue;
+                }
+                memset((void*)Buffers[CoreId], 0, sizeof(ProfilerCore_t));
+            }
+        }
+        Processor = Processor->Link;
+    }
+
+    CriticalSectionEnter(&ProfilerSyncObject);
+    for (i = 0; i < PROFILER_MAX_CORES; i++) {
+        if (Buffers[i] != NULL) {
+            ProfilerCores[i] = Buffers[i];
+        }
+    }
+    ProfilerInterval    = (Interval == 0) ? PROFILER_DEFAULT_INTERVAL : Interval;
+    ProfilerEnabled     = 1;
+    CriticalSectionLeave(&ProfilerSyncObject);
+    TRACE("Sampling enabled, interval %u ticks", ProfilerInterval);
+    return OsSuccess;
+}
+
+/* ProfilerStop
+ * Disables sampling, the samples captured stay available for reading */
+OsStatus_t
+ProfilerStop(void)
+{
+    ProfilerEnabled = 0;
+    return OsSuccess;
+}
+
+/* ProfilerReset
+ * Discards all samples captured and resets the statistics */
+OsStatus_t
+ProfilerReset(void)
+{
+    // Variables
+    int i;
+
+    CriticalSectionEnter(&ProfilerSyncObject);
+    for (i = 0; i < PROFILER_MAX_CORES; i++) {
+        if (ProfilerCores[i] != NULL) {
+            atomic_store(&ProfilerCores[i]->Tail, atomic_load(&ProfilerCores[i]->Head));
+            ProfilerCores[i]->Dropped = 0;
+        }
+    }
+    CriticalSectionLeave(&ProfilerSyncObject);
+    return OsSuccess;
+}
+
+/* ProfilerSampleContext
+ * Captures a sample of the interrupted context on the current core. Must be called
+ * from the timer interrupt before the scheduler switches the context. */
+void
+ProfilerSampleContext(
+    _In_ Context_t*         Context)
+{
+    // Variables
+    ProfilerSample_t *Sample    = NULL;
+    ProfilerCore_t *Core        = NULL;
+    MCoreThread_t *Thread       = NULL;
+    UUId_t CoreId               = CpuGetCurrentId();
+    unsigned int Head;
+
+    if (!ProfilerEnabled || CoreId >= PROFILER_MAX_CORES || ProfilerCores[CoreId] == NULL) {
+        return;
+    }
+    Core = ProfilerCores[CoreId];
+    if (++Core->Ticks < ProfilerInterval) {
+        return;
+    }
+    Core->Ticks = 0;
+
+    // Idle time is not interesting, it just dilutes the profile
+    Thread = ThreadingGetCurrentThread(CoreId);
+    if (Thread == NULL || ThreadingIsCurrentTaskIdle(CoreId)) {
+        return;
+    }
+
+    Head = atomic_load(&Core->Head);
+    if ((Head - atomic_load(&Core->Tail)) >= PROFILER_SAMPLES_PER_CORE) {
+        Core->Dropped++;
+        return;
+    }
+
+    Sample              = &Core->Samples[Head % PROFILER_SAMPLES_PER_CORE];
+    Sample->ThreadId    = Thread->Id;
+    Sample->AshId       = Thread->AshId;
+    Sample->Frames[0]   = CONTEXT_IP(Context);
+    Sample->Depth       = 1;
+    ProfilerCaptureStack(Sample, CONTEXT_BP(Context));
+
+    // Publish the sample
+    atomic_store(&Core->Head, Head + 1);
+}
+
+/* ProfilerGetModule
+ * Locates the loaded image (executable or library) that contains the address */
+static MCorePeFile_t*
+ProfilerGetModule(
+    _In_ MCoreAsh_t*        Ash,
+    _In_ uintptr_t          Address)
+{
+    if (Ash == NULL || Ash->Executable == NULL) {
+        return NULL;
+    }
+
+    if (Address >= Ash->Executable->CodeBase
+        && Address < (Ash->Executable->CodeBase + Ash->Executable->CodeSize)) {
+        return Ash->Executable;
+    }
+    if (Ash->Executable->LoadedLibraries != NULL) {
+        foreach(lNode, Ash->Executable->LoadedLibraries) {
+            MCorePeFile_t *Library = (MCorePeFile_t*)lNode->Data;
+            if (Address >= Library->CodeBase && Address < (Library->CodeBase + Library->CodeSize)) {
+                return Library;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* ProfilerCopySymbolName
+ * Copies an export name from the image, the names live in the address space of
+ * the process which must be active. Pages are checked as the name is copied. */
+static void
+ProfilerCopySymbolName(
+    _In_ MCoreAsh_t*        Ash,
+    _In_ const char*        Name,
+    _In_ char*              Buffer,
+    _In_ size_t             Length)
+{
+    // Variables
+    size_t PageMask = GetSystemMemoryPageSize() - 1;
+    size_t i;
+
+    for (i = 0; i < (Length - 1); i++) {
+        if ((i == 0 || (((uintptr_t)&Name[i]) & PageMask) == 0)
+            && IsSystemMemoryPresent(Ash->MemorySpace, (uintptr_t)&Name[i]) != OsSuccess) {
+            break;
+        }
+        if (Name[i] == '\0') {
+            break;
+        }
+        Buffer[i] = Name[i];
+    }
+    Buffer[i] = '\0';
+}
+
+/* ProfilerResolveFrame
+ * Resolves an address to 'kernel+offset' (to be looked up in the kernel map file),
+ * 'module!export+offset' using the export table of the image or 'module+offset'. */
+static size_t
+ProfilerResolveFrame(
+    _In_ MCoreAsh_t*        Ash,
+    _In_ uintptr_t          Address,
+    _In_ char*              Buffer,
+    _In_ size_t             Length)
+{
+    // Variables
+    MCorePeExportFunction_t *Symbol = NULL;
+    MCorePeFile_t *Module           = NULL;
+    char SymbolName[64];
+    int i;
+
+    if (Address < MEMORY_LOCATION_KERNEL_END) {
+        return snprintf(Buffer, Length, "kernel+0x%x", Address - MEMORY_LOCATION_KERNEL);
+    }
+
+    Module = ProfilerGetModule(Ash, Address);
+    if (Module == NULL) {
+        return snprintf(Buffer, Length, "0x%x", Address);
+    }
+
+    // Find the closest export below the address, forwarders have no code
+    for (i = 0; i < Module->NumberOfExportedFunctions; i++) {
+        MCorePeExportFunction_t *Function = &Module->ExportedFunctions[i];
+        if (Function->Name != NULL && Function->ForwardName == NULL && Function->Address <= Address
+            && (Symbol == NULL || Function->Address > Symbol->Address)) {
+            Symbol = Function;
+        }
+    }
+
+    if (Symbol != NULL) {
+        ProfilerCopySymbolName(Ash, Symbol->Name, &SymbolName[0], sizeof(SymbolName));
+        if (SymbolName[0] != '\0') {
+            return snprintf(Buffer, Length, "%s!%s+0x%x", MStringRaw(Module->Name),
+                &SymbolName[0], Address - Symbol->Address);
+        }
+    }
+    return snprintf(Buffer, Length, "%s+0x%x", MStringRaw(Module->Name), Address - Module->VirtualAddress);
+}
+
+/* ProfilerClampLength
+ * snprintf returns the length it would have written, clamps it to the number of
+ * characters actually stored in a buffer of <Length> bytes. */
+static size_t
+ProfilerClampLength(
+    _In_ int                Written,
+    _In_ size_t             Length)
+{
+    if (Written < 0 || Length == 0) {
+        return 0;
+    }
+    return ((size_t)Written >= Length) ? (Length - 1) : (size_t)Written;
+}
+
+/* ProfilerFormatSample
+ * Formats the sample as a folded stack line, outermost frame first. Symbols are
+ * resolved in the address space of the sampled process. */
+static size_t
+ProfilerFormatSample(
+    _In_ ProfilerSample_t*  Sample,
+    _In_ char*              Buffer,
+    _In_ size_t             Length)
+{
+    // Variables
+    SystemMemorySpace_t *Current    = GetCurrentSystemMemorySpace();
+    MCoreThread_t *Thread           = ThreadingAcquireThread(Sample->ThreadId);
+    MCoreAsh_t *Ash                 = NULL;
+    IntStatus_t IrqState;
+    size_t FrameLength              = Length - 4;
+    size_t Index                    = 0;
+    int i;
+
+    if (Sample->AshId != UUID_INVALID) {
+        Ash = PhoenixAcquireAsh(Sample->AshId);
+    }
+
+    if (Ash != NULL) {
+        Index = ProfilerClampLength(snprintf(Buffer, FrameLength, "%s", MStringRaw(Ash->Name)), FrameLength);
+    }
+    else if (Sample->AshId != UUID_INVALID) {
+        Index = ProfilerClampLength(snprintf(Buffer, FrameLength, "process%u", Sample->AshId), FrameLength);
+    }
+    else {
+        Index = ProfilerClampLength(snprintf(Buffer, FrameLength, "kernel:%s", 
+            (Thread != NULL) ? Thread->Name : "?"), FrameLength);
+    }
+
+    // Export names can only be read from inside the process, so borrow its
+    // address space. Interrupts stay off so we are never scheduled in between.
+    IrqState = InterruptDisable();
+    if (Ash != NULL && Ash->MemorySpace != Current) {
+        SwitchSystemMemorySpace(Ash->MemorySpace);
+    }
+    for (i = (int)Sample->Depth - 1; i >= 0 && (Index + 1) < FrameLength; i--) {
+        Buffer[Index++] = ';';
+        Index += ProfilerClampLength((int)ProfilerResolveFrame(Ash, Sample->Frames[i], 
+            &Buffer[Index], FrameLength - Index), FrameLength - Index);
+    }
+    if (Ash != NULL && Ash->MemorySpace != Current) {
+        SwitchSystemMemorySpace(Current);
+    }
+    InterruptRestoreState(IrqState);
+
+    // Truncated lines lose their innermost frames but stay well-formed
+    Index += ProfilerClampLength(snprintf(&Buffer[Index], Length - Index, " 1\n"), Length - Index);
+    if (Ash != NULL) {
+        PhoenixReleaseAsh(Ash);
+    }
+    if (Thread != NULL) {
+        ThreadingReleaseThread(Thread);
+    }
+    return Index;
+}
+
+/* ProfilerRead
+ * Drains captured samples into the buffer as symbolized folded stacks, one line
+ * per sample in the form 'process;outer;...;inner 1'. Only complete lines are
+ * written, <BytesRead> is 0 when there are no samples left. Samples are copied
+ * out in batches under the profiler lock and symbolized after releasing it, a
+ * batch is only consumed if no one else drained or reset the core meanwhile. */
+OsStatus_t
+ProfilerRead(
+    _In_  char*             Buffer,
+    _In_  size_t            Length,
+    _Out_ size_t*           BytesRead)
+{
+    // Variables
+    ProfilerSample_t *Samples   = NULL;
+    char *Line                  = NULL;
+    size_t LineSize             = PROFILER_MAX_FRAMES * 160;
+    size_t Written              = 0;
+    int Full                    = 0;
+    int i;
+
+    if (Buffer == NULL || BytesRead == NULL) {
+        return OsError;
+    }
+    *BytesRead = 0;
+
+    Samples = (ProfilerSample_t*)kmalloc((sizeof(ProfilerSample_t) * PROFILER_READ_BATCH) + LineSize);
+    if (Samples == NULL) {
+        return OsError;
+    }
+    Line = (char*)&Samples[PROFILER_READ_BATCH];
+
+    for (i = 0; i < PROFILER_MAX_CORES && !Full; i++) {
+        ProfilerCore_t *Core = NULL;
+
+        // Report lost samples so the user knows the profile is skewed
+        CriticalSectionEnter(&ProfilerSyncObject);
+        Core = ProfilerCores[i];
+        if (Core != NULL && Core->Dropped != 0) {
+            size_t Size = ProfilerClampLength(snprintf(Line, LineSize, 
+                "# core %i dropped %u samples\n", i, Core->Dropped), LineSize);
+            if ((Written + Size) > Length) {
+                Full = 1;
+            }
+            else {
+                memcpy(&Buffer[Written], Line, Size);
+                Written         += Size;
+                Core->Dropped   = 0;
+            }
+        }
+        CriticalSectionLeave(&ProfilerSyncObject);
+        if (Core == NULL || Full) {
+            continue;
+        }
+
+        while (!Full) {
+            size_t BatchStart = Written;
+            unsigned int Tail, Count, Consumed;
+
+            CriticalSectionEnter(&ProfilerSyncObject);
+            Tail    = atomic_load(&Core->Tail);
+            Count   = MIN(atomic_load(&Core->Head) - Tail, PROFILER_READ_BATCH);
+            for (Consumed = 0; Consumed < Count; Consumed++) {
+                memcpy(&Samples[Consumed], &Core->Samples[(Tail + Consumed) % PROFILER_SAMPLES_PER_CORE], 
+                    sizeof(ProfilerSample_t));
+            }
+            CriticalSectionLeave(&ProfilerSyncObject);
+            if (Count == 0) {
+                break;
+            }
+
+            for (Consumed = 0; Consumed < Count; Consumed++) {
+                size_t Size = ProfilerFormatSample(&Samples[Consumed], Line, LineSize);
+                if ((Written + Size) > Length) {
+                    Full = 1;
+                    break;
+                }
+                memcpy(&Buffer[Written], Line, Size);
+                Written += Size;
+            }
+
+            CriticalSectionEnter(&ProfilerSyncObject);
+            if (atomic_load(&Core->Tail) == Tail) {
+                atomic_store(&Core->Tail, Tail + Consumed);
+            }
+            else {
+                Written = BatchStart;
+            }
+            CriticalSectionLeave(&ProfilerSyncObject);
+        }
+    }
+
+    kfree(Samples);
+    *BytesRead = Written;
+    return OsSuccess;
+}
@@ -25,6 +25,9 @@
  * On yields, keep priority.
  * On task-switchs, decrease priority.
  * A thread can only stay a maximum in each priority.
+ * Real-time threads run at a fixed level before any normal priority,
+ * they are never demoted or boosted.
+ * Waiters lend their priority to the thread they wait on.
  */
 #define __MODULE "SCHE"
 //#define __TRACE
@@ -45,6 +48,7 @@
 /* Globals
  * - State keeping variables */
 static SchedulerQueue_t IoQueue             = { 0, 0, { 0 } };
+static AtomicSection_t PrioritySyncObject   = ATOMICSECTION_INITIALIZE;
 
 /* SchedulerInitialize
  * Initializes the scheduler instance to default settings and parameters. */
@@ -68,6 +72,11 @@ SchedulerQueueAppend(
 
     // Null end
     ThreadEnd->Link = NULL;
+
+    // Record the queue the threads are in, the caller holds its lock
+    for (AppendTo = ThreadStart; AppendTo != NULL; AppendTo = AppendTo->Link) {
+        AppendTo->ReadyQueue = Queue;
+    }
     
     // Get the tail pointer of the queue to append
     AppendTo = Queue->Tail;
@@ -76,29 +85,6 @@ SchedulerQueueAppend(
     Queue->Tail = ThreadEnd;
 }
 
-/* FindThreadInQueue
- * Returns OsSuccess if the function succesfully found the given thread in the queue. */
-OsStatus_t
-FindThreadInQueue(
-    _In_ SchedulerQueue_t*  Queue,
-    _In_ MCoreThread_t*     Thread)
-{
-    MCoreThread_t *i;
-    if (IoQueue.Head == NULL) {
-        return OsError;
-    }
-
-    // Iterate the queue
-    i = IoQueue.Head;
-    while (i) {
-        if (i == Thread) {
-            return OsSuccess;
-        }
-        i = i->Link;
-    }
-    return OsError;
-}
-
 /* IsThreadSleeping
  * Returns OsSuccess if the function succesfully found the given thread handle. This function skips threads
  * already marked for wakeup. */
@@ -210,19 +196,21 @@ GetThreadReadyForExecution(
     return NULL;
 }
 
-/* SchedulerQueueRemove
- * Removes a single thread from the given queue. */
-void
-SchedulerQueueRemove(
+/* SchedulerQueueUnlink
+ * Unlinks a single thread from the given queue, the caller must hold the queue
+ * lock. Returns OsSuccess if the thread was found in the queue. */
+static OsStatus_t
+SchedulerQueueUnlink(
     _In_ SchedulerQueue_t*  Queue,
     _In_ MCoreThread_t*     Thread)
 {
     // Variables
-    MCoreThread_t   *Current = Queue->Head,
+    MCoreThread_t   *Current,
                     *Previous = NULL;
+    OsStatus_t Status       = OsError;
 
     // Find the remove-target and unlink
-    AtomicSectionEnter(&Queue->SyncObject);
+    Current = Queue->Head;
     while (Current) {
         if (Current == Thread) {
             // Two cases, previous is NULL, or not
@@ -234,12 +222,80 @@ SchedulerQueueRemove(
                 if (Previous == NULL)   Queue->Tail = Current->Link;
                 else                    Queue->Tail = Previous;
             }
+            if (Thread->ReadyQueue == Queue) {
+                Thread->ReadyQueue = NULL;
+            }
+            Status = OsSuccess;
             break;
         }
         Previous    = Current;
         Current     = Current->Link;
     }
+    return Status;
+}
+
+/* SchedulerQueueRemove
+ * Removes a single thread from the given queue. Returns OsSuccess if the
+ * thread was found in the queue. */
+OsStatus_t
+SchedulerQueueRemove(
+    _In_ SchedulerQueue_t*  Queue,
+    _In_ MCoreThread_t*     Thread)
+{
+    OsStatus_t Status;
+
+    AtomicSectionEnter(&Queue->SyncObject);
+    Status = SchedulerQueueUnlink(Queue, Thread);
+    AtomicSectionLeave(&Queue->SyncObject);
+    return Status;
+}
+
+/* SchedulerQueuePop
+ * Removes and returns the first thread of the given queue. */
+static MCoreThread_t*
+SchedulerQueuePop(
+    _In_ SchedulerQueue_t*  Queue)
+{
+    MCoreThread_t *Thread;
+
+    AtomicSectionEnter(&Queue->SyncObject);
+    Thread = Queue->Head;
+    if (Thread != NULL) {
+        Queue->Head = Thread->Link;
+        if (Queue->Tail == Thread) {
+            Queue->Tail = NULL;
+        }
+        Thread->Link        = NULL;
+        Thread->ReadyQueue  = NULL;
+    }
     AtomicSectionLeave(&Queue->SyncObject);
+    return Thread;
+}
+
+/* SchedulerThreadUnready
+ * Removes the thread from the ready queue it was appended to. The recorded queue
+ * is used instead of the rank, as the rank can change while the thread is queued.
+ * Returns the queue the thread was removed from, or NULL if it was not queued. */
+static SchedulerQueue_t*
+SchedulerThreadUnready(
+    _In_ MCoreThread_t*     Thread)
+{
+    SchedulerQueue_t *Queue;
+
+    while (1) {
+        Queue = Thread->ReadyQueue;
+        if (Queue == NULL) {
+            return NULL;
+        }
+
+        // The thread might have been moved before we got the lock, then try again
+        AtomicSectionEnter(&Queue->SyncObject);
+        if (Thread->ReadyQueue == Queue && SchedulerQueueUnlink(Queue, Thread) == OsSuccess) {
+            AtomicSectionLeave(&Queue->SyncObject);
+            return Queue;
+        }
+        AtomicSectionLeave(&Queue->SyncObject);
+    }
 }
 
 /* SchedulerSynchronizeCore
@@ -276,24 +332,95 @@ SchedulerGetFromCore(
     return &GetProcessorCore(CoreId)->Scheduler;
 }
 
+/* SchedulerThreadGetRank
+ * Returns the rank the thread currently runs at. The real-time levels rank before
+ * the normal queues, and a thread runs at the most urgent of its own and inherited rank. */
+int
+SchedulerThreadGetRank(
+    _In_ MCoreThread_t*     Thread)
+{
+    int Rank = SCHEDULER_REALTIME_COUNT + Thread->Queue;
+    if (Thread->Priority == PriorityRealtime) {
+        Rank = Thread->RealtimeLevel;
+    }
+    if (Thread->InheritedRank != SCHEDULER_RANK_NONE && Thread->InheritedRank < Rank) {
+        Rank = Thread->InheritedRank;
+    }
+    return Rank;
+}
+
+/* SchedulerGetQueue
+ * Returns the queue of the thread in its scheduler, or NULL if the thread has not
+ * been assigned a core yet. */
+static SchedulerQueue_t*
+SchedulerGetQueue(
+    _In_ MCoreThread_t*     Thread)
+{
+    MCoreScheduler_t *Scheduler;
+    int Rank;
+
+    if (Thread->CoreId == SCHEDULER_CPU_SELECT) {
+        return NULL;
+    }
+
+    Scheduler   = SchedulerGetFromCore(Thread->CoreId);
+    Rank        = SchedulerThreadGetRank(Thread);
+    if (Rank < SCHEDULER_REALTIME_COUNT) {
+        return &Scheduler->RealtimeQueues[Rank];
+    }
+    return &Scheduler->Queues[Rank - SCHEDULER_REALTIME_COUNT];
+}
+
+/* SchedulerThreadReposition
+ * Moves a queued thread to the queue matching its rank after its rank was changed. Threads
+ * that are running or sleeping are placed correctly the next time they are queued. */
+static void
+SchedulerThreadReposition(
+    _In_ MCoreThread_t*     Thread)
+{
+    SchedulerQueue_t *Next = SchedulerGetQueue(Thread);
+
+    if (Next == NULL || Thread->ReadyQueue == Next) {
+        return;
+    }
+    if (SchedulerThreadUnready(Thread) != NULL) {
+        Next = SchedulerGetQueue(Thread);
+        AtomicSectionEnter(&Next->SyncObject);
+        SchedulerQueueAppend(Next, Thread, Thread);
+        AtomicSectionLeave(&Next->SyncObject);
+    }
+}
+
 /* SchedulerBoostThreads
  * Boosts all threads in the given scheduler to queue 0.
  * This is a method of avoiding intentional starvation by malicous
- * programs. */
+ * programs. The real-time queues are not touched. */
 void
 SchedulerBoostThreads(
     _In_ MCoreScheduler_t*  Scheduler)
 {
     // Variables
-    int i                   = 0;
+    MCoreThread_t *Head, *Tail, *i;
+    int j;
     
-    // Move all threads up into queue 0 but skip queue CRITICAL
-    for (i = 1; i < SCHEDULER_LEVEL_CRITICAL; i++) {
-        if (Scheduler->Queues[i].Head != NULL) {
-            SchedulerQueueAppend(&Scheduler->Queues[0], 
-                Scheduler->Queues[i].Head, Scheduler->Queues[i].Tail);
-            Scheduler->Queues[i].Head = NULL;
-            Scheduler->Queues[i].Tail = NULL;
+    // Move all threads up into queue 0 but skip queue CRITICAL. Both locks are
+    // held so the recorded queue of the threads is never stale
+    for (j = 1; j < SCHEDULER_LEVEL_CRITICAL; j++) {
+        if (Scheduler->Queues[j].Head != NULL) {
+            AtomicSectionEnter(&Scheduler->Queues[j].SyncObject);
+            Head = Scheduler->Queues[j].Head;
+            Tail = Scheduler->Queues[j].Tail;
+            if (Head != NULL) {
+                Scheduler->Queues[j].Head = NULL;
+                Scheduler->Queues[j].Tail = NULL;
+                for (i = Head; i != NULL; i = i->Link) {
+                    i->Queue = 0;
+                }
+                AtomicSectionEnter(&Scheduler->Queues[0].SyncObject);
+                SchedulerQueueAppend(&Scheduler->Queues[0], Head, Tail);
+                AtomicSectionLeave(&Scheduler->Queues[0].SyncObject);
+            }
+            AtomicSectionLeave(&Scheduler->Queues[j].SyncObject);
         }
     }
 }
@@ -307,7 +434,11 @@ SchedulerThreadInitialize(
     _In_ Flags_t            Flags)
 {
     // Initialize members
-    Thread->Link = NULL;
+    Thread->Link            = NULL;
+    Thread->RealtimeLevel   = 0;
+    Thread->InheritedRank   = SCHEDULER_RANK_NONE;
+    Thread->ReadyQueue      = NULL;
+    memset((void*)&Thread->Inherited[0], 0, sizeof(Thread->Inherited));
 
     // Flag-Special-CasE:
     // System thread?
@@ -350,6 +481,7 @@ SchedulerThreadQueue(
     SystemDomain_t *Domain      = GetCurrentDomain();
     SystemCpu_t *CoreGroup      = &GetMachine()->Processor;
     MCoreScheduler_t *Scheduler;
+    SchedulerQueue_t *Queue;
     UUId_t CoreId;
     int i;
 
@@ -383,10 +515,13 @@ SchedulerThreadQueue(
     }
 
     // Debug
-    TRACE("Appending thread %u (%s) to queue %i", Thread->Id, Thread->Name, Thread->Queue);
+    TRACE("Appending thread %u (%s) to rank %i", Thread->Id, Thread->Name, SchedulerThreadGetRank(Thread));
 
     // The modification of a queue is a locked operation
-    SchedulerQueueAppend(&Scheduler->Queues[Thread->Queue], Thread, Thread);
+    Queue = SchedulerGetQueue(Thread);
+    AtomicSectionEnter(&Queue->SyncObject);
+    SchedulerQueueAppend(Queue, Thread, Thread);
+    AtomicSectionLeave(&Queue->SyncObject);
     Scheduler->ThreadCount++;
     
     // Set thread active
@@ -412,13 +547,12 @@ SchedulerThreadDequeue(
     TRACE("SchedulerThreadDequeue(Cpu %u, Thread %u, Queue %u)",
         Thread->CoreId, Thread->Id, Thread->Queue);
 
-    Scheduler = SchedulerGetFromCore(Thread->CoreId);
-    if (FindThreadInQueue(&Scheduler->Queues[Thread->Queue], Thread) == OsSuccess) {
-        SchedulerQueueRemove(&Scheduler->Queues[Thread->Queue], Thread);
+    // Remove it from the queue it was appended to, its rank may have changed since
+    Scheduler   = SchedulerGetFromCore(Thread->CoreId);
+    if (SchedulerThreadUnready(Thread) != NULL) {
         Found = 1;
     }
-    if (FindThreadInQueue(&IoQueue, Thread) == OsSuccess) {
-        SchedulerQueueRemove(&IoQueue, Thread);
+    if (SchedulerQueueRemove(&IoQueue, Thread) == OsSuccess) {
         Found = 1;
     }
     if (Found) {
@@ -430,6 +564,131 @@ SchedulerThreadDequeue(
     return OsSuccess;
 }
 
+/* SchedulerThreadSetRealtime
+ * Moves the thread into the real-time class at the given fixed level, where level 0
+ * is the most urgent. A level of SCHEDULER_RANK_NONE returns the thread to the normal class. */
+OsStatus_t
+SchedulerThreadSetRealtime(
+    _In_ MCoreThread_t*     Thread,
+    _In_ int                Level)
+{
+    assert(Thread != NULL);
+
+    if (Level < SCHEDULER_RANK_NONE || Level >= SCHEDULER_REALTIME_COUNT) {
+        return OsError;
+    }
+    if (Thread->Flags & (THREADING_SYSTEMTHREAD | THREADING_IDLE)) {
+        return OsError;
+    }
+    TRACE("SchedulerThreadSetRealtime(Thread %u, Level %i)", Thread->Id, Level);
+
+    AtomicSectionEnter(&PrioritySyncObject);
+    if (Level == SCHEDULER_RANK_NONE) {
+        Thread->Priority        = PriorityNormal;
+        Thread->RealtimeLevel   = 0;
+    }
+    else {
+        Thread->Priority        = PriorityRealtime;
+        Thread->RealtimeLevel   = Level;
+    }
+    SchedulerThreadReposition(Thread);
+    AtomicSectionLeave(&PrioritySyncObject);
+    return OsSuccess;
+}
+
+/* SchedulerThreadUpdateInherited
+ * Recalculates the inherited rank as the most urgent rank lent by any source. */
+static void
+SchedulerThreadUpdateInherited(
+    _In_ MCoreThread_t*     Thread)
+{
+    int Rank = SCHEDULER_RANK_NONE;
+    int i;
+
+    for (i = 0; i < THREADING_INHERIT_SOURCES; i++) {
+        if (Thread->Inherited[i].Source != 0 
+            && (Rank == SCHEDULER_RANK_NONE || Thread->Inherited[i].Rank < Rank)) {
+            Rank = Thread->Inherited[i].Rank;
+        }
+    }
+    Thread->InheritedRank = Rank;
+}
+
+/* SchedulerThreadInherit
+ * Lends <Rank> to <Thread> through <Source>. When all slots are taken the least urgent
+ * source is replaced, as long as the new rank is more urgent than it. */
+void
+SchedulerThreadInherit(
+    _In_ MCoreThread_t*     Thread,
+    _In_ int                Rank,
+    _In_ uintptr_t          Source)
+{
+    int Slot        = -1;
+    int Weakest     = -1;
+    int i;
+    assert(Thread != NULL);
+    assert(Source != 0);
+
+    if (Rank == SCHEDULER_RANK_NONE || (Thread->Flags & THREADING_IDLE)) {
+        return;
+    }
+
+    AtomicSectionEnter(&PrioritySyncObject);
+    for (i = 0; i < THREADING_INHERIT_SOURCES; i++) {
+        if (Thread->Inherited[i].Source == Source) {
+            Slot = i;
+            break;
+        }
+        if (Thread->Inherited[i].Source == 0) {
+            if (Slot == -1) {
+                Slot = i;
+            }
+        }
+        else if (Weakest == -1 || Thread->Inherited[i].Rank > Thread->Inherited[Weakest].Rank) {
+            Weakest = i;
+        }
+    }
+    if (Slot == -1 && Thread->Inherited[Weakest].Rank > Rank) {
+        Slot = Weakest;
+    }
+
+    if (Slot != -1 && (Thread->Inherited[Slot].Source != Source || Rank < Thread->Inherited[Slot].Rank)) {
+        TRACE("Thread %u inherits rank %i from source 0x%x", Thread->Id, Rank, Source);
+        Thread->Inherited[Slot].Source  = Source;
+        Thread->Inherited[Slot].Rank    = Rank;
+        SchedulerThreadUpdateInherited(Thread);
+        SchedulerThreadReposition(Thread);
+    }
+    AtomicSectionLeave(&PrioritySyncObject);
+}
+
+/* SchedulerThreadDisinherit
+ * Drops the rank lent through <Source>, the thread continues at the most urgent
+ * rank still lent to it by other sources, or its own. */
+void
+SchedulerThreadDisinherit(
+    _In_ MCoreThread_t*     Thread,
+    _In_ uintptr_t          Source)
+{
+    int i;
+    assert(Thread != NULL);
+
+    if (Thread->InheritedRank == SCHEDULER_RANK_NONE) {
+        return;
+    }
+
+    AtomicSectionEnter(&PrioritySyncObject);
+    for (i = 0; i < THREADING_INHERIT_SOURCES; i++) {
+        if (Thread->Inherited[i].Source == Source) {
+            Thread->Inherited[i].Source = 0;
+            SchedulerThreadUpdateInherited(Thread);
+            SchedulerThreadReposition(Thread);
+            break;
+        }
+    }
+    AtomicSectionLeave(&PrioritySyncObject);
+}
+
 /* SchedulerThreadSleep
  * Enters the current thread into sleep-queue. Can return different
  * sleep-state results. SCHEDULER_SLEEP_OK or SCHEDULER_SLEEP_TIMEOUT. */
@@ -653,8 +912,8 @@ SchedulerThreadSchedule(
         if (!(Thread->Flags & THREADING_SKIP_REQUEUE)) {
             TimeSlice = Thread->TimeSlice;
 
-            // Did it yield itself?
-            if (Preemptive != 0) {
+            // Did it yield itself? Real-time threads keep their level
+            if (Preemptive != 0 && Thread->Priority != PriorityRealtime) {
                 if (Thread->Queue < (SCHEDULER_LEVEL_CRITICAL - 1)) {
                     Thread->Queue++;
                     Thread->TimeSlice = (Thread->Queue * 2) + SCHEDULER_TIMESLICE_INITIAL;
@@ -677,14 +936,25 @@ SchedulerThreadSchedule(
         Scheduler->BoostTimer = 0;
     }
     
-    // Get next thread
-    for (i = 0; i < SCHEDULER_LEVEL_COUNT; i++) {
+    // Get next thread, the real-time queues are served first
+    for (i = 0; i < SCHEDULER_REALTIME_COUNT && NextThread == NULL; i++) {
+        if (Scheduler->RealtimeQueues[i].Head != NULL) {
+            NextThread = SchedulerQueuePop(&Scheduler->RealtimeQueues[i]);
+            if (NextThread != NULL) {
+                NextThread->TimeSlice = SCHEDULER_TIMESLICE_REALTIME;
+            }
+        }
+    }
+    for (i = 0; i < SCHEDULER_LEVEL_COUNT && NextThread == NULL; i++) {
         if (Scheduler->Queues[i].Head != NULL) {
-            NextThread = Scheduler->Queues[i].Head;
-            NextThread->Queue = i;
-            NextThread->TimeSlice = (i * 2) + SCHEDULER_TIMESLICE_INITIAL;
-            SchedulerQueueRemove(&Scheduler->Queues[i], NextThread);
-            break;
+            NextThread = SchedulerQueuePop(&Scheduler->Queues[i]);
+            if (NextThread != NULL) {
+                // Don't let an inherited rank stick to the thread
+                if (NextThread->InheritedRank == SCHEDULER_RANK_NONE) {
+                    NextThread->Queue = i;
+                }
+                NextThread->TimeSlice = (i * 2) + SCHEDULER_TIMESLICE_INITIAL;
+            }
         }
     }
     return NextThread;
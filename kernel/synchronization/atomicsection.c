@@ -29,14 +29,12 @@ void
 AtomicSectionEnter(
     _In_ AtomicSection_t* Section)
 {
-    bool locked = true;
-    Section->State = InterruptDisable();
-    while (1) {
-        bool val = atomic_exchange(&Section->Status, locked);
-        if (val == false) {
-            break;
-        }
-    }
+    IntStatus_t State = InterruptDisable();
+    unsigned int Ticket = atomic_fetch_add(&Section->Next, 1);
+
+    // Waiters only read the section while spinning
+    while (atomic_load_explicit(&Section->Serving, memory_order_acquire) != Ticket);
+    Section->State = State;
 }
 
 /* AtomicSectionLeave
@@ -45,6 +43,7 @@ void
 AtomicSectionLeave(
     _In_ AtomicSection_t* Section)
 {
-    atomic_exchange(&Section->Status, false);
-    InterruptRestoreState(Section->State);
+    IntStatus_t State = Section->State;
+    atomic_fetch_add_explicit(&Section->Serving, 1, memory_order_release);
+    InterruptRestoreState(State);
 }
@@ -0,0 +1,208 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS Synchronization
+ *  - Epoch based reclamation allows shared lists to be read without locks. Readers
+ *    mark the cpu they run on as active for the duration of the read, and writers
+ *    defer the release of unlinked nodes untill every active cpu has moved on.
+ */
+#define __MODULE "EPOC"
+//#define __TRACE
+
+#include <system/interrupts.h>
+#include <system/thread.h>
+#include <system/utils.h>
+#include <atomicsection.h>
+#include <epoch.h>
+#include <debug.h>
+#include <assert.h>
+
+/* EpochCore
+ * The state of a cpu is the epoch it entered its section in shifted left by one,
+ * with the lowest bit set while inside a section. Interrupts are disabled while
+ * inside a section, so only the owning cpu ever modifies the nesting. */
+#define EPOCH_ACTIVE                0x1
+#define EPOCH_MASK                  (UINT32_MAX >> 1)
+
+typedef struct _EpochCore {
+    atomic_uint     State;
+    int             Nesting;
+    IntStatus_t     InterruptStatus;
+} EpochCore_t;
+
+static EpochCore_t      EpochCores[EPOCH_MAX_CORES]     = { { 0 } };
+static atomic_uint      EpochCoreCount                  = ATOMIC_VAR_INIT(0);
+static atomic_uint      GlobalEpoch                     = ATOMIC_VAR_INIT(0);
+static AtomicSection_t  RetiredSyncObject               = ATOMICSECTION_INITIALIZE;
+static EpochItem_t*     RetiredHead                     = NULL;
+static EpochItem_t*     RetiredTail                     = NULL;
+static atomic_uint      RetiredCount                    = ATOMIC_VAR_INIT(0);
+
+/* EpochEnter
+ * Enters a read-side section on the current cpu, nodes that are reachable when
+ * entering the section stay valid untill EpochLeave. */
+void
+EpochEnter(void)
+{
+    IntStatus_t InterruptStatus = InterruptDisable();
+    UUId_t CoreId               = CpuGetCurrentId();
+    EpochCore_t *Core;
+    unsigned int Count;
+
+    assert(CoreId < EPOCH_MAX_CORES);
+    Core = &EpochCores[CoreId];
+    if (Core->Nesting++ != 0) {
+        return;
+    }
+
+    // Make sure writers scan this cpu
+    Count = atomic_load_explicit(&EpochCoreCount, memory_order_relaxed);
+    while (Count <= CoreId && !atomic_compare_exchange_weak(&EpochCoreCount, &Count, CoreId + 1));
+
+    // The store must be visible before any shared node is read, so it's
+    // sequentially consistent which acts as a full barrier
+    Core->InterruptStatus = InterruptStatus;
+    atomic_store(&Core->State, ((atomic_load(&GlobalEpoch) & EPOCH_MASK) << 1) | EPOCH_ACTIVE);
+}
+
+/* EpochLeave
+ * Leaves the read-side section, the current cpu is quiescent again once the
+ * outermost section has been left. */
+void
+EpochLeave(void)
+{
+    EpochCore_t *Core = &EpochCores[CpuGetCurrentId()];
+    assert(Core->Nesting > 0);
+    if (--Core->Nesting == 0) {
+        atomic_store_explicit(&Core->State, 0, memory_order_release);
+        InterruptRestoreState(Core->InterruptStatus);
+    }
+}
+
+/* EpochTryAdvance
+ * Advances the global epoch if all active cpus have observed the current epoch.
+ * Returns the global epoch after the attempt. */
+static unsigned int
+EpochTryAdvance(void)
+{
+    unsigned int Epoch  = atomic_load(&GlobalEpoch);
+    unsigned int Count  = atomic_load(&EpochCoreCount);
+    unsigned int i;
+
+    for (i = 0; i < Count; i++) {
+        unsigned int State = atomic_load(&EpochCores[i].State);
+        if ((State & EPOCH_ACTIVE) && (State >> 1) != (Epoch & EPOCH_MASK)) {
+            return Epoch;
+        }
+    }
+
+    // On failure another cpu advanced it, and the current value is loaded
+    if (atomic_compare_exchange_strong(&GlobalEpoch, &Epoch, Epoch + 1)) {
+        return Epoch + 1;
+    }
+    return Epoch;
+}
+
+/* EpochDefer
+ * Queues the callback to be invoked once all readers that could have seen the node
+ * have left their sections. The node must already be unlinked. */
+void
+EpochDefer(
+    _In_ EpochItem_t*       Item,
+    _In_ EpochCallback_t    Callback,
+    _In_ void*              Context)
+{
+    assert(Item != NULL);
+    assert(Callback != NULL);
+
+    Item->Link      = NULL;
+    Item->Callback  = Callback;
+    Item->Context   = Context;
+
+    // Tag the item under the lock so the list stays ordered by epoch
+    AtomicSectionEnter(&RetiredSyncObject);
+    Item->Epoch = atomic_load(&GlobalEpoch);
+    if (RetiredTail != NULL) {
+        RetiredTail->Link = Item;
+    }
+    else {
+        RetiredHead = Item;
+    }
+    RetiredTail = Item;
+    atomic_fetch_add(&RetiredCount, 1);
+    AtomicSectionLeave(&RetiredSyncObject);
+    EpochReclaim();
+}
+
+/* EpochReclaim
+ * Tries to advance the global epoch and invokes the callbacks that have expired.
+ * An item expires when the global epoch is two ahead of the epoch it was deferred in. */
+void
+EpochReclaim(void)
+{
+    EpochItem_t *Expired    = NULL;
+    EpochItem_t **Last      = &Expired;
+    unsigned int Epoch      = EpochTryAdvance();
+
+    AtomicSectionEnter(&RetiredSyncObject);
+    while (RetiredHead != NULL && (Epoch - RetiredHead->Epoch) >= 2) {
+        *Last       = RetiredHead;
+        Last        = &RetiredHead->Link;
+        RetiredHead = RetiredHead->Link;
+        atomic_fetch_sub(&RetiredCount, 1);
+    }
+    *Last = NULL;
+    if (RetiredHead == NULL) {
+        RetiredTail = NULL;
+    }
+    AtomicSectionLeave(&RetiredSyncObject);
+
+    // Invoke the callbacks without holding the lock, they are allowed to free
+    while (Expired != NULL) {
+        EpochItem_t *Next = Expired->Link;
+        Expired->Callback(Expired->Context);
+        Expired = Next;
+    }
+}
+
+/* EpochTick
+ * Tries to advance the global epoch without invoking any callbacks, so it can be
+ * called from interrupt context. The retired list is not touched as the lock
+ * may be held by the code that was interrupted. */
+int
+EpochTick(void)
+{
+    if (atomic_load_explicit(&RetiredCount, memory_order_relaxed) == 0) {
+        return 0;
+    }
+    EpochTryAdvance();
+    return 1;
+}
+
+/* EpochSynchronize
+ * Waits for all readers that were active when called to leave their sections, and
+ * invokes the callbacks that were deferred before the call. */
+void
+EpochSynchronize(void)
+{
+    unsigned int Start = atomic_load(&GlobalEpoch);
+    while ((EpochTryAdvance() - Start) < 2) {
+        ThreadingYield();
+    }
+    EpochReclaim();
+}
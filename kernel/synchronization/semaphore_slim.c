@@ -31,7 +31,9 @@
 #include <system/thread.h>
 #include <system/utils.h>
 #include <semaphore_slim.h>
+#include <threading.h>
 #include <scheduler.h>
+#include <epoch.h>
 #include <debug.h>
 
 #include <stddef.h>
@@ -63,8 +65,93 @@ SlimSemaphoreConstruct(
     assert(MaximumValue >= InitialValue);
 
 	// Initiate members
-    Semaphore->MaxValue = MaximumValue;
-	Semaphore->Value    = ATOMIC_VAR_INIT(InitialValue);
+    Semaphore->MaxValue     = MaximumValue;
+    Semaphore->Exclusive    = (InitialValue == 1 && MaximumValue == 1);
+    Semaphore->Owner        = ATOMIC_VAR_INIT(UUID_INVALID);
+    Semaphore->WaiterRank   = ATOMIC_VAR_INIT(SCHEDULER_RANK_NONE);
+	Semaphore->Value        = ATOMIC_VAR_INIT(InitialValue);
+}
+
+/* SlimSemaphoreLendPriority
+ * Lends the priority of the current thread to the thread holding the semaphore. The
+ * owner is looked up by id as it may exit while holding the semaphore. The rank is
+ * recorded before the owner is read, so a holder that has taken the semaphore but
+ * not yet published itself picks it up when it does. */
+static void
+SlimSemaphoreLendPriority(
+    _In_ SlimSemaphore_t*   Semaphore)
+{
+    MCoreThread_t *Current  = ThreadingGetCurrentThread(CpuGetCurrentId());
+    MCoreThread_t *Owner;
+    UUId_t OwnerId;
+    int Waiting;
+    int Rank;
+
+    if (Current == NULL) {
+        return;
+    }
+
+    Rank    = SchedulerThreadGetRank(Current);
+    Waiting = atomic_load(&Semaphore->WaiterRank);
+    while ((Waiting == SCHEDULER_RANK_NONE || Rank < Waiting)
+        && !atomic_compare_exchange_weak(&Semaphore->WaiterRank, &Waiting, Rank));
+
+    OwnerId = atomic_load(&Semaphore->Owner);
+    if (OwnerId == UUID_INVALID) {
+        return;
+    }
+
+    EpochEnter();
+    Owner = ThreadingGetThread(OwnerId);
+    if (Owner != NULL) {
+        SchedulerThreadInherit(Owner, Rank, (uintptr_t)Semaphore);
+
+        // The owner might have released the semaphore while we were lending, then
+        // it has already dropped what was lent through the semaphore
+        if (atomic_load(&Semaphore->Owner) != OwnerId) {
+            SchedulerThreadDisinherit(Owner, (uintptr_t)Semaphore);
+        }
+    }
+    EpochLeave();
+}
+
+/* SlimSemaphoreSetOwner
+ * Updates the thread holding the semaphore. A new owner inherits the rank of waiters
+ * that queued up before it was published, and a previous owner stops running at the
+ * priority it was lent through the semaphore. Priority lent through other sources
+ * is kept. */
+static void
+SlimSemaphoreSetOwner(
+    _In_ SlimSemaphore_t*   Semaphore,
+    _In_ MCoreThread_t*     Owner)
+{
+    MCoreThread_t *Thread;
+    UUId_t Previous;
+    int Rank;
+
+    if (Owner != NULL) {
+        atomic_store(&Semaphore->Owner, Owner->Id);
+        Rank = atomic_load(&Semaphore->WaiterRank);
+        if (Rank != SCHEDULER_RANK_NONE) {
+            SchedulerThreadInherit(Owner, Rank, (uintptr_t)Semaphore);
+        }
+        return;
+    }
+
+    // Once nobody is waiting the recorded rank is stale, while there are waiters
+    // it stays so the next owner runs at least at their rank
+    Previous = atomic_exchange(&Semaphore->Owner, UUID_INVALID);
+    if (atomic_load(&Semaphore->Value) >= 0) {
+        atomic_store(&Semaphore->WaiterRank, SCHEDULER_RANK_NONE);
+    }
+    if (Previous != UUID_INVALID) {
+        EpochEnter();
+        Thread = ThreadingGetThread(Previous);
+        if (Thread != NULL) {
+            SchedulerThreadDisinherit(Thread, (uintptr_t)Semaphore);
+        }
+        EpochLeave();
+    }
 }
 
 /* SlimSemaphoreWait
@@ -87,11 +174,18 @@ SlimSemaphoreWait(
 
         // Go to sleep atomically, check return value, if there was sync
         // issues try again
+        if (Semaphore->Exclusive) {
+            SlimSemaphoreLendPriority(Semaphore);
+        }
         Status = SchedulerAtomicThreadSleep(&Semaphore->Value, &Value, Timeout);
         if (Status != SCHEDULER_SLEEP_SYNC_FAILED) {
             break;
         }
     }
+
+    if (Status == SCHEDULER_SLEEP_OK && Semaphore->Exclusive) {
+        SlimSemaphoreSetOwner(Semaphore, ThreadingGetCurrentThread(CpuGetCurrentId()));
+    }
     return Status;
 }
 
@@ -114,6 +208,9 @@ SlimSemaphoreSignal(
     CurrentValue = atomic_load(&Semaphore->Value);
     __STRICT_ASSERT((CurrentValue + Value) > Semaphore->MaxValue);
     if ((CurrentValue + Value) <= Semaphore->MaxValue) {
+        if (Semaphore->Exclusive) {
+            SlimSemaphoreSetOwner(Semaphore, NULL);
+        }
         for (i = 0; i < Value; i++) {
             while ((CurrentValue + 1) <= Semaphore->MaxValue) {
                 if (atomic_compare_exchange_weak(&Semaphore->Value, &CurrentValue, CurrentValue + 1)) {
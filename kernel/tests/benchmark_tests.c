@@ -0,0 +1,443 @@
+/* MollenOS
+ *
+ * Copyright 2011 - 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * OS Testing Suite
+ *  - Micro-benchmarks that measure latency of core kernel paths on all cores.
+ *    Results are emitted as single 'BENCH' lines on the log, one per worker and
+ *    one aggregate per benchmark:
+ *    BENCH <name> cpu=<id|all> n=<samples> min=<ns> p50=<ns> p90=<ns> p99=<ns> p999=<ns> max=<ns> mean=<ns>
+ */
+#define __MODULE "BNCH"
+#define __TRACE
+
+#include <system/thread.h>
+#include <system/utils.h>
+#include <memoryspace.h>
+#include <scheduler.h>
+#include <threading.h>
+#include <machine.h>
+#include <timers.h>
+#include <assert.h>
+#include <stdio.h>
+#include <debug.h>
+#include <pipe.h>
+#include <heap.h>
+
+// Selectable benchmarks
+#define BENCHMARK_YIELD             0x1     // Context switch by yielding between two threads on a core
+#define BENCHMARK_PIPE              0x2     // Pipe round-trip between two threads
+#define BENCHMARK_PAGEFAULT         0x4     // Page-fault on kernel heap memory
+#define BENCHMARK_HEAP              0x8     // Heap allocation and free
+#define BENCHMARK_ALL               0xF
+
+#define BENCHMARK_ITERATIONS        10000
+#define BENCHMARK_PAGES             256
+#define BENCHMARK_MAX_WORKERS       64
+
+/* Histogram layout
+ * Log-linear buckets, every power of two is split in 8 sub-buckets which
+ * gives a worst case error of 12.5%. Values below 8ns get a bucket each. */
+#define HISTOGRAM_SUBBITS           3
+#define HISTOGRAM_SUBCOUNT          (1 << HISTOGRAM_SUBBITS)
+#define HISTOGRAM_MAXBIT            40
+#define HISTOGRAM_BUCKETS           ((HISTOGRAM_MAXBIT - HISTOGRAM_SUBBITS + 2) * HISTOGRAM_SUBCOUNT)
+
+typedef struct _BenchmarkHistogram {
+    uint32_t            Buckets[HISTOGRAM_BUCKETS];
+    uint64_t            Count;
+    uint64_t            Sum;
+    uint64_t            Min;
+    uint64_t            Max;
+} BenchmarkHistogram_t;
+
+struct BenchmarkWorker;
+typedef void(*BenchmarkFunction_t)(struct BenchmarkWorker*);
+
+typedef struct BenchmarkWorker {
+    BenchmarkFunction_t     Function;
+    UUId_t                  Thread;
+    UUId_t                  CoreId;
+    SystemPipe_t*           Pipes[2];
+    int                     Measure;
+    BenchmarkHistogram_t    Histogram;
+} BenchmarkWorker_t;
+
+static LargeInteger_t   BenchmarkFrequency;
+static atomic_int       BenchmarkReady  = ATOMIC_VAR_INIT(0);
+static atomic_int       BenchmarkGo     = ATOMIC_VAR_INIT(0);
+
+/* BenchmarkTimestamp
+ * Reads the performance timer (hpet or tsc depending on the platform). */
+static inline uint64_t
+BenchmarkTimestamp(void)
+{
+    LargeInteger_t Value;
+    TimersQueryPerformanceTick(&Value);
+    return (uint64_t)Value.QuadPart;
+}
+
+/* BenchmarkToNanoseconds
+ * Converts a performance timer delta to nanoseconds. */
+static inline uint64_t
+BenchmarkToNanoseconds(
+    _In_ uint64_t Ticks)
+{
+    uint64_t Frequency = (uint64_t)BenchmarkFrequency.QuadPart;
+    return ((Ticks / Frequency) * 1000000000ULL)
+        + (((Ticks % Frequency) * 1000000000ULL) / Frequency);
+}
+
+/* HistogramIndex
+ * Calculates the bucket of a value. */
+static int
+HistogramIndex(
+    _In_ uint64_t Value)
+{
+    int Msb = 0;
+    if (Value < HISTOGRAM_SUBCOUNT) {
+        return (int)Value;
+    }
+    while ((Value >> (Msb + 1)) != 0) {
+        Msb++;
+    }
+    if (Msb > HISTOGRAM_MAXBIT) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    return ((Msb - HISTOGRAM_SUBBITS + 1) * HISTOGRAM_SUBCOUNT)
+        + (int)((Value >> (Msb - HISTOGRAM_SUBBITS)) & (HISTOGRAM_SUBCOUNT - 1));
+}
+
+/* HistogramLowerBound
+ * Calculates the lowest value that is counted in a bucket. */
+static uint64_t
+HistogramLowerBound(
+    _In_ int Index)
+{
+    int Shift;
+    if (Index < HISTOGRAM_SUBCOUNT) {
+        return (uint64_t)Index;
+    }
+    Shift = (Index / HISTOGRAM_SUBCOUNT) - 1;
+    return (uint64_t)(HISTOGRAM_SUBCOUNT + (Index % HISTOGRAM_SUBCOUNT)) << Shift;
+}
+
+/* HistogramRecord
+ * Records a single sample in nanoseconds. */
+static void
+HistogramRecord(
+    _In_ BenchmarkHistogram_t*  Histogram,
+    _In_ uint64_t               Value)
+{
+    Histogram->Buckets[HistogramIndex(Value)]++;
+    if (Histogram->Count == 0 || Value < Histogram->Min) {
+        Histogram->Min = Value;
+    }
+    if (Value > Histogram->Max) {
+        Histogram->Max = Value;
+    }
+    Histogram->Count++;
+    Histogram->Sum += Value;
+}
+
+/* HistogramMerge
+ * Adds all samples of the source histogram to the destination. */
+static void
+HistogramMerge(
+    _In_ BenchmarkHistogram_t*  Destination,
+    _In_ BenchmarkHistogram_t*  Source)
+{
+    int i;
+    if (Source->Count == 0) {
+        return;
+    }
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        Destination->Buckets[i] += Source->Buckets[i];
+    }
+    if (Destination->Count == 0 || Source->Min < Destination->Min) {
+        Destination->Min = Source->Min;
+    }
+    if (Source->Max > Destination->Max) {
+        Destination->Max = Source->Max;
+    }
+    Destination->Count  += Source->Count;
+    Destination->Sum    += Source->Sum;
+}
+
+/* HistogramPercentile
+ * Returns the upper bound of the bucket that contains the given percentile,
+ * the percentile is given in tenths of a percent (999 = 99.9%). */
+static uint64_t
+HistogramPercentile(
+    _In_ BenchmarkHistogram_t*  Histogram,
+    _In_ int                    Permille)
+{
+    uint64_t Target = ((Histogram->Count * (uint64_t)Permille) + 999) / 1000;
+    uint64_t Seen   = 0;
+    int i;
+
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        Seen += Histogram->Buckets[i];
+        if (Seen >= Target && Seen != 0) {
+            uint64_t Upper = (i == HISTOGRAM_BUCKETS - 1) ? Histogram->Max : (HistogramLowerBound(i + 1) - 1);
+            return (Upper > Histogram->Max) ? Histogram->Max : Upper;
+        }
+    }
+    return Histogram->Max;
+}
+
+/* HistogramReport
+ * Emits the machine readable result line. Values are clamped to 32 bits. */
+static void
+HistogramReport(
+    _In_ const char*            Name,
+    _In_ int                    CoreId,
+    _In_ BenchmarkHistogram_t*  Histogram)
+{
+    char Cpu[16];
+    if (CoreId < 0) {
+        sprintf(&Cpu[0], "all");
+    }
+    else {
+        sprintf(&Cpu[0], "%i", CoreId);
+    }
+
+#define CLAMP32(Value) (unsigned)((Value) > 0xFFFFFFFFULL ? 0xFFFFFFFFULL : (Value))
+    WRITELINE("BENCH %s cpu=%s n=%u min=%u p50=%u p90=%u p99=%u p999=%u max=%u mean=%u",
+        Name, &Cpu[0], CLAMP32(Histogram->Count), CLAMP32(Histogram->Min),
+        CLAMP32(HistogramPercentile(Histogram, 500)), CLAMP32(HistogramPercentile(Histogram, 900)),
+        CLAMP32(HistogramPercentile(Histogram, 990)), CLAMP32(HistogramPercentile(Histogram, 999)),
+        CLAMP32(Histogram->Max), CLAMP32(Histogram->Count == 0 ? 0 : Histogram->Sum / Histogram->Count));
+#undef CLAMP32
+}
+
+/* BenchmarkYield
+ * Measures a yield that switches to the other worker on the core and back. */
+static void
+BenchmarkYield(
+    _In_ BenchmarkWorker_t* Worker)
+{
+    uint64_t Start;
+    int i;
+
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        Start = BenchmarkTimestamp();
+        ThreadingYield();
+        HistogramRecord(&Worker->Histogram, BenchmarkToNanoseconds(BenchmarkTimestamp() - Start));
+    }
+}
+
+/* BenchmarkPipe
+ * The measuring side sends a message and waits for the echo, the other side
+ * echoes until it receives the stop message. */
+static void
+BenchmarkPipe(
+    _In_ BenchmarkWorker_t* Worker)
+{
+    uint32_t Message = 0;
+    uint64_t Start;
+    size_t Read;
+    int i;
+
+    if (Worker->Measure) {
+        for (i = 0; i <= BENCHMARK_ITERATIONS; i++) {
+            Message = (i == BENCHMARK_ITERATIONS) ? 0xFFFFFFFF : (uint32_t)i;
+            Start   = BenchmarkTimestamp();
+            WriteSystemPipe(Worker->Pipes[0], (const uint8_t*)&Message, sizeof(uint32_t));
+            if (Message == 0xFFFFFFFF) {
+                break;
+            }
+            for (Read = 0; Read < sizeof(uint32_t);) {
+                Read += ReadSystemPipe(Worker->Pipes[1], (uint8_t*)&Message + Read, sizeof(uint32_t) - Read);
+            }
+            HistogramRecord(&Worker->Histogram, BenchmarkToNanoseconds(BenchmarkTimestamp() - Start));
+        }
+    }
+    else {
+        while (1) {
+            for (Read = 0; Read < sizeof(uint32_t);) {
+                Read += ReadSystemPipe(Worker->Pipes[0], (uint8_t*)&Message + Read, sizeof(uint32_t) - Read);
+            }
+            if (Message == 0xFFFFFFFF) {
+                break;
+            }
+            WriteSystemPipe(Worker->Pipes[1], (const uint8_t*)&Message, sizeof(uint32_t));
+        }
+    }
+}
+
+/* BenchmarkPageFault
+ * Unmaps pages of a kernel heap allocation and measures the touch that
+ * faults them back in through the heap page-fault handler. */
+static void
+BenchmarkPageFault(
+    _In_ BenchmarkWorker_t* Worker)
+{
+    size_t PageSize = GetSystemMemoryPageSize();
+    uint8_t *Buffer = (uint8_t*)kmalloc_a(PageSize * BENCHMARK_PAGES);
+    uint64_t Start;
+    int Round, i;
+
+    assert(Buffer != NULL);
+    for (Round = 0; Round < (BENCHMARK_ITERATIONS / BENCHMARK_PAGES); Round++) {
+        for (i = 0; i < BENCHMARK_PAGES; i++) {
+            volatile uint8_t *Page = (volatile uint8_t*)(Buffer + (i * PageSize));
+            *Page = 0;
+            RemoveSystemMemoryMapping(GetCurrentSystemMemorySpace(), (VirtualAddress_t)Page, PageSize);
+
+            Start = BenchmarkTimestamp();
+            *Page = (uint8_t)i;
+            HistogramRecord(&Worker->Histogram, BenchmarkToNanoseconds(BenchmarkTimestamp() - Start));
+        }
+    }
+    kfree(Buffer);
+}
+
+/* BenchmarkHeap
+ * Measures an allocation and free pair with sizes cycling from 16 bytes to 4kb. */
+static void
+BenchmarkHeap(
+    _In_ BenchmarkWorker_t* Worker)
+{
+    uint64_t Start;
+    void *Allocation;
+    int i;
+
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        size_t Size = (size_t)16 << (i % 9);
+        Start       = BenchmarkTimestamp();
+        Allocation  = kmalloc(Size);
+        kfree(Allocation);
+        HistogramRecord(&Worker->Histogram, BenchmarkToNanoseconds(BenchmarkTimestamp() - Start));
+    }
+}
+
+/* BenchmarkWorkerEntry
+ * Waits for all workers to be ready, so they run in parallel, then runs the benchmark. */
+static void
+BenchmarkWorkerEntry(
+    _In_ void* Context)
+{
+    BenchmarkWorker_t *Worker = (BenchmarkWorker_t*)Context;
+    Worker->CoreId = CpuGetCurrentId();
+
+    atomic_fetch_add(&BenchmarkReady, 1);
+    while (!atomic_load(&BenchmarkGo)) {
+        ThreadingYield();
+    }
+    Worker->Function(Worker);
+}
+
+/* BenchmarkRun
+ * Spawns <Count> workers, new threads are placed on the least loaded core which
+ * spreads them evenly on an idle system. Reports each measuring worker and the total. */
+static void
+BenchmarkRun(
+    _In_ const char*            Name,
+    _In_ BenchmarkFunction_t    Function,
+    _In_ int                    Count,
+    _In_ int                    Paired)
+{
+    BenchmarkWorker_t *Workers;
+    BenchmarkHistogram_t *Total;
+    int i;
+
+    if (Count > BENCHMARK_MAX_WORKERS) {
+        Count = BENCHMARK_MAX_WORKERS;
+    }
+    TRACE(" > running benchmark %s with %i workers", Name, Count);
+
+    Workers = (BenchmarkWorker_t*)kmalloc(sizeof(BenchmarkWorker_t) * Count);
+    Total   = (BenchmarkHistogram_t*)kmalloc(sizeof(BenchmarkHistogram_t));
+    memset((void*)Workers, 0, sizeof(BenchmarkWorker_t) * Count);
+    memset((void*)Total, 0, sizeof(BenchmarkHistogram_t));
+    atomic_store(&BenchmarkReady, 0);
+    atomic_store(&BenchmarkGo, 0);
+
+    for (i = 0; i < Count; i++) {
+        Workers[i].Function = Function;
+        Workers[i].Measure  = Paired ? ((i & 1) == 0) : 1;
+        if (Paired && (i & 1) == 0) {
+            Workers[i].Pipes[0] = CreateSystemPipe(0, 6);
+            Workers[i].Pipes[1] = CreateSystemPipe(0, 6);
+        }
+        else if (Paired) {
+            Workers[i].Pipes[0] = Workers[i - 1].Pipes[0];
+            Workers[i].Pipes[1] = Workers[i - 1].Pipes[1];
+        }
+    }
+    for (i = 0; i < Count; i++) {
+        Workers[i].Thread = ThreadingCreateThread("Benchmark", BenchmarkWorkerEntry, &Workers[i], 0);
+        assert(Workers[i].Thread != UUID_INVALID);
+    }
+
+    while (atomic_load(&BenchmarkReady) != Count) {
+        ThreadingYield();
+    }
+    atomic_store(&BenchmarkGo, 1);
+    for (i = 0; i < Count; i++) {
+        ThreadingJoinThread(Workers[i].Thread);
+    }
+
+    for (i = 0; i < Count; i++) {
+        if (Workers[i].Measure) {
+            HistogramReport(Name, (int)Workers[i].CoreId, &Workers[i].Histogram);
+            HistogramMerge(Total, &Workers[i].Histogram);
+        }
+        if (Paired && (i & 1) == 0) {
+            DestroySystemPipe(Workers[i].Pipes[0]);
+            DestroySystemPipe(Workers[i].Pipes[1]);
+        }
+    }
+    HistogramReport(Name, -1, Total);
+    kfree(Total);
+    kfree(Workers);
+}
+
+/* TestBenchmarks
+ * Runs the selected benchmarks, the selection is a mask of BENCHMARK_* passed as context. */
+void
+TestBenchmarks(void *Context)
+{
+    // Variables
+    Flags_t Selection   = (Flags_t)(uintptr_t)Context;
+    int Cores           = (int)GetMachine()->NumberOfActiveCores;
+
+    TRACE("TestBenchmarks(Selection 0x%x, Cores %i)", Selection, Cores);
+    if (TimersQueryPerformanceFrequency(&BenchmarkFrequency) != OsSuccess
+        || BenchmarkFrequency.QuadPart == 0) {
+        ERROR("Benchmarks require a performance timer");
+        return;
+    }
+    if (Cores <= 0) {
+        Cores = 1;
+    }
+
+    if (Selection & BENCHMARK_YIELD) {
+        BenchmarkRun("yield", BenchmarkYield, Cores * 2, 0);
+    }
+    if (Selection & BENCHMARK_PIPE) {
+        BenchmarkRun("pipe_rtt", BenchmarkPipe, Cores * 2, 1);
+    }
+    if (Selection & BENCHMARK_PAGEFAULT) {
+        BenchmarkRun("pagefault", BenchmarkPageFault, Cores, 0);
+    }
+    if (Selection & BENCHMARK_HEAP) {
+        BenchmarkRun("heap", BenchmarkHeap, Cores, 0);
+    }
+    WRITELINE("BENCH done");
+}
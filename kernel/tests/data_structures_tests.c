@@ -23,7 +23,9 @@
 #define __TRACE
 
 #include <ds/blbitmap.h>
+#include <ds/rangetree.h>
 #include <debug.h>
+#include <assert.h>
 
 /* TestDataStructures
  * Performs tests with the data structures used in the OS to verify stability and
@@ -33,7 +35,10 @@ TestDataStructures(void *Unused)
 {
     // Variables
     BlockBitmap_t *Bitmap;
+    RangeTree_t *Tree;
     uintptr_t Allocation, Allocation1;
+    size_t Length       = 0;
+    Flags_t Attributes  = 0;
     _CRT_UNUSED(Unused);
 
     // Debug
@@ -57,4 +62,33 @@ TestDataStructures(void *Unused)
     ReleaseBlockmapRegion(Bitmap, Allocation, 3000);
     ReleaseBlockmapRegion(Bitmap, Allocation1, 120);
     DestroyBlockmap(Bitmap);
+
+    // Create the range tree
+    assert(CreateRangeTree(0x10000, 0x10000 + 0x100000, 0x1000, &Tree) == OsSuccess);
+    TRACE(" > Allocating 64kb, then allocating 16kb more");
+    assert(RangeTreeAllocate(Tree, 0x10000, 1, &Allocation) == OsSuccess);
+    assert(RangeTreeAllocate(Tree, 0x4000, 1, &Allocation1) == OsSuccess);
+    TRACE(" > Allocation (64kb) => 0x%x", Allocation);
+    TRACE(" > Allocation (16kb) => 0x%x", Allocation1);
+    assert(Allocation == 0x10000);
+    assert(Allocation1 == 0x20000);
+
+    TRACE(" > Changing the middle 8kb of the 64kb, then freeing the last 4kb of it");
+    assert(RangeTreeSetAttributes(Tree, Allocation + 0x4000, 0x2000, 2, &Attributes) == OsSuccess);
+    assert(Attributes == 1);
+    assert(RangeTreeRelease(Tree, Allocation + 0xF000, 0x1000) == OsSuccess);
+    assert(RangeTreeLookup(Tree, Allocation + 0x5000, &Allocation1, &Length, &Attributes) == OsSuccess);
+    TRACE(" > Lookup (0x%x) => 0x%x, length 0x%x, attributes %u", 
+        Allocation + 0x5000, Allocation1, Length, Attributes);
+    assert(Allocation1 == Allocation + 0x4000);
+    assert(Length == 0x2000);
+    assert(Attributes == 2);
+    assert(RangeTreeLookup(Tree, Allocation + 0xF000, NULL, NULL, NULL) != OsSuccess);
+
+    // The 64kb is now split in 16kb, 8kb, 36kb and a free 4kb, followed by the
+    // 16kb and the free remainder
+    TRACE(" > Ranges %u, bytes allocated 0x%x", Tree->NumberOfRanges, Tree->BytesAllocated);
+    assert(Tree->NumberOfRanges == 6);
+    assert(Tree->BytesAllocated == 0x13000);
+    DestroyRangeTree(Tree);
 }
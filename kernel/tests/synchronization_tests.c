@@ -22,8 +22,13 @@
 #define __MODULE "TEST"
 #define __TRACE
 
+#include <semaphore_slim.h>
+#include <system/utils.h>
 #include <scheduler.h>
 #include <threading.h>
+#include <eventport.h>
+#include <epoch.h>
+#include <handle.h>
 #include <assert.h>
 #include <debug.h>
 #include <pipe.h>
@@ -152,6 +157,221 @@ WaitForSynchronizationTest(
     memset((void*)Package, 0, sizeof(struct SynchTestPackage));
 }
 
+/* TestEventPort
+ * Verifies that pipe writes are coalesced per source and that destroying
+ * a source hangs up the port registration. */
+void
+TestEventPort(void)
+{
+    // Variables
+    EventPortEvent_t Events[4];
+    SystemPipe_t *Pipes[2];
+    uint32_t Message = 0;
+    size_t Count     = 0;
+    UUId_t Port;
+
+    TRACE(" > running configuration (EVENTPORT, RAW, SIMPLEX)");
+    Pipes[0] = CreateSystemPipe(0, 6);
+    Pipes[1] = CreateSystemPipe(0, 6);
+    assert(CreateSystemEventPort(&Port) == OsSuccess);
+    assert(AttachSystemEventPort(Port, &Pipes[0]->Events, EVENTPORT_SOURCE_PIPE, 0, EVENT_READABLE, (void*)Pipes[0]) == OsSuccess);
+    assert(AttachSystemEventPort(Port, &Pipes[1]->Events, EVENTPORT_SOURCE_PIPE, 1, EVENT_READABLE, (void*)Pipes[1]) == OsSuccess);
+    assert(AttachSystemEventPort(Port, &Pipes[1]->Events, EVENTPORT_SOURCE_PIPE, 1, EVENT_READABLE, NULL) != OsSuccess);
+
+    // Two writes to the first pipe must be reported as one event
+    WriteSystemPipe(Pipes[0], (const uint8_t*)&Message, sizeof(uint32_t));
+    WriteSystemPipe(Pipes[1], (const uint8_t*)&Message, sizeof(uint32_t));
+    WriteSystemPipe(Pipes[0], (const uint8_t*)&Message, sizeof(uint32_t));
+    assert(WaitForSystemEventPort(Port, &Events[0], 4, 1000, &Count) == OsSuccess);
+    TRACE(" > events %u, [0] count %u, [1] count %u", Count, Events[0].Count, Events[1].Count);
+    assert(Count == 2);
+    assert(Events[0].Context == (void*)Pipes[0] && Events[0].Count == 2);
+    assert(Events[1].Context == (void*)Pipes[1] && Events[1].Count == 1);
+
+    // Nothing is pending, so the wait must time out
+    assert(WaitForSystemEventPort(Port, &Events[0], 4, 10, &Count) == OsSuccess);
+    assert(Count == 0);
+
+    // Destroying a source reports a hangup and detaches it
+    DestroySystemPipe(Pipes[1]);
+    assert(WaitForSystemEventPort(Port, &Events[0], 4, 1000, &Count) == OsSuccess);
+    assert(Count == 1 && (Events[0].Events & EVENT_HANGUP) && Events[0].SourceId == 1);
+    assert(DetachSystemEventPort(Port, EVENTPORT_SOURCE_PIPE, 1) != OsSuccess);
+    assert(DetachSystemEventPort(Port, EVENTPORT_SOURCE_PIPE, 0) == OsSuccess);
+
+    assert(DestroyHandle(Port) == OsSuccess);
+    DestroySystemPipe(Pipes[0]);
+}
+
+/* SpinlockWorker
+ * Increments the shared counter under the test spinlock. */
+#define SPINLOCK_TEST_ITERATIONS    100000
+static Spinlock_t SpinlockTestLock      = SPINLOCK_INIT;
+static size_t SpinlockTestCounter       = 0;
+static atomic_int SpinlockTestsDone     = ATOMIC_VAR_INIT(0);
+void
+SpinlockWorker(void* Context)
+{
+    int i;
+    _CRT_UNUSED(Context);
+    for (i = 0; i < SPINLOCK_TEST_ITERATIONS; i++) {
+        SpinlockAcquire(&SpinlockTestLock);
+        SpinlockTestCounter++;
+        SpinlockRelease(&SpinlockTestLock);
+    }
+    atomic_fetch_add(&SpinlockTestsDone, 1);
+}
+
+/* TestSpinlock
+ * Verifies that the ticket spinlock provides mutual exclusion between threads
+ * and that a held lock can't be taken by a try-acquire from another thread. */
+void
+TestSpinlock(void)
+{
+    // Variables
+    SpinlockStatistics_t Statistics;
+    UUId_t Threads[2];
+    size_t TimeLeft = 60 * 1000;
+
+    TRACE(" > running configuration (SPINLOCK, TICKET)");
+    SpinlockReset(&SpinlockTestLock);
+    SpinlockTestCounter = 0;
+    atomic_store(&SpinlockTestsDone, 0);
+
+    // Reentrancy from the owner, and the lock is free again afterwards
+    assert(SpinlockAcquire(&SpinlockTestLock) == OsSuccess);
+    assert(SpinlockTryAcquire(&SpinlockTestLock) == OsSuccess);
+    SpinlockRelease(&SpinlockTestLock);
+    SpinlockRelease(&SpinlockTestLock);
+    assert((SpinlockTestLock.Value >> 16) == (SpinlockTestLock.Value & 0xFFFF));
+
+    Threads[0] = ThreadingCreateThread("Test_Spinlock", SpinlockWorker, NULL, 0);
+    Threads[1] = ThreadingCreateThread("Test_Spinlock", SpinlockWorker, NULL, 0);
+    assert(Threads[0] != UUID_INVALID);
+    assert(Threads[1] != UUID_INVALID);
+    while (atomic_load(&SpinlockTestsDone) != 2 && TimeLeft > 0) {
+        SchedulerThreadSleep(NULL, 100);
+        TimeLeft -= 100;
+    }
+    TRACE(" > counter %u/%u", SpinlockTestCounter, 2 * SPINLOCK_TEST_ITERATIONS);
+    assert(SpinlockTestCounter == 2 * SPINLOCK_TEST_ITERATIONS);
+
+    if (SpinlockGetStatistics(&SpinlockTestLock, &Statistics) == OsSuccess) {
+        TRACE(" > acquisitions %u, contended %u, polls %u, max hold %u", Statistics.Acquisitions,
+            Statistics.Contentions, Statistics.Polls, LODWORD(Statistics.HoldTimeMax));
+        assert(Statistics.Acquisitions >= 2 * SPINLOCK_TEST_ITERATIONS);
+    }
+}
+
+/* EpochTestCallback
+ * Counts the number of deferred items that have been reclaimed. */
+static atomic_int EpochTestReclaims     = ATOMIC_VAR_INIT(0);
+static void
+EpochTestCallback(void* Context)
+{
+    _CRT_UNUSED(Context);
+    atomic_fetch_add(&EpochTestReclaims, 1);
+}
+
+/* TestEpoch
+ * Verifies that deferred items are not reclaimed while a read-side section that
+ * could see them is active, also when sections are nested. */
+void
+TestEpoch(void)
+{
+    // Variables
+    EpochItem_t Items[2];
+
+    TRACE(" > running configuration (EPOCH, DEFER)");
+    atomic_store(&EpochTestReclaims, 0);
+
+    EpochEnter();
+    EpochDefer(&Items[0], EpochTestCallback, NULL);
+    EpochReclaim();
+    EpochReclaim();
+    assert(atomic_load(&EpochTestReclaims) == 0);
+    EpochLeave();
+    EpochSynchronize();
+    assert(atomic_load(&EpochTestReclaims) == 1);
+
+    // Leaving a nested section must not end the outer one
+    EpochEnter();
+    EpochEnter();
+    EpochLeave();
+    EpochDefer(&Items[1], EpochTestCallback, NULL);
+    EpochReclaim();
+    EpochReclaim();
+    assert(atomic_load(&EpochTestReclaims) == 1);
+    EpochLeave();
+    EpochSynchronize();
+    assert(atomic_load(&EpochTestReclaims) == 2);
+}
+
+/* InheritanceWorker
+ * Runs real-time and blocks on the test lock held by the test thread. */
+static SlimSemaphore_t InheritanceTestLock;
+static atomic_int InheritanceTestDone   = ATOMIC_VAR_INIT(0);
+void
+InheritanceWorker(void* Context)
+{
+    MCoreThread_t *Thread = ThreadingGetCurrentThread(CpuGetCurrentId());
+    _CRT_UNUSED(Context);
+
+    assert(SchedulerThreadSetRealtime(Thread, 0) == OsSuccess);
+    assert(SlimSemaphoreWait(&InheritanceTestLock, 0) == SCHEDULER_SLEEP_OK);
+    assert(InheritanceTestLock.Owner == Thread->Id);
+    SlimSemaphoreSignal(&InheritanceTestLock, 1);
+    atomic_store(&InheritanceTestDone, 1);
+}
+
+/* TestPriorityInheritance
+ * Verifies that a real-time thread waiting for a lock lends its level to the holder,
+ * that the holder drops it again when releasing the lock, and that ranks lent
+ * through several sources are dropped one source at a time. */
+void
+TestPriorityInheritance(void)
+{
+    // Variables
+    MCoreThread_t *Current  = ThreadingGetCurrentThread(CpuGetCurrentId());
+    size_t TimeLeft         = 10 * 1000;
+    UUId_t Thread;
+
+    TRACE(" > running configuration (INHERITANCE, REALTIME)");
+    atomic_store(&InheritanceTestDone, 0);
+    SlimSemaphoreConstruct(&InheritanceTestLock, 1, 1);
+    assert(SlimSemaphoreWait(&InheritanceTestLock, 0) == SCHEDULER_SLEEP_OK);
+    assert(Current->InheritedRank == SCHEDULER_RANK_NONE);
+
+    Thread = ThreadingCreateThread("Test_Inheritance", InheritanceWorker, NULL, 0);
+    assert(Thread != UUID_INVALID);
+    while (Current->InheritedRank != 0 && TimeLeft > 0) {
+        SchedulerThreadSleep(NULL, 100);
+        TimeLeft -= 100;
+    }
+    assert(Current->InheritedRank == 0);
+
+    SlimSemaphoreSignal(&InheritanceTestLock, 1);
+    assert(Current->InheritedRank == SCHEDULER_RANK_NONE);
+    TimeLeft = 10 * 1000;
+    while (atomic_load(&InheritanceTestDone) == 0 && TimeLeft > 0) {
+        SchedulerThreadSleep(NULL, 100);
+        TimeLeft -= 100;
+    }
+    assert(atomic_load(&InheritanceTestDone) == 1);
+    assert(InheritanceTestLock.Owner == UUID_INVALID);
+
+    // Ranks lent through different sources are tracked apart, dropping one
+    // source keeps the rank lent by the others
+    TRACE(" > running configuration (INHERITANCE, SOURCES)");
+    SchedulerThreadInherit(Current, 1, (uintptr_t)&InheritanceTestLock);
+    SchedulerThreadInherit(Current, 3, SCHEDULER_INHERIT_RPC);
+    assert(Current->InheritedRank == 1);
+    SchedulerThreadDisinherit(Current, (uintptr_t)&InheritanceTestLock);
+    assert(Current->InheritedRank == 3);
+    SchedulerThreadDisinherit(Current, SCHEDULER_INHERIT_RPC);
+    assert(Current->InheritedRank == SCHEDULER_RANK_NONE);
+}
+
 /* TestSynchronization
  * Performs all the synchronization tests in the system. */
 void
@@ -252,4 +472,48 @@ TestSynchronization(void *Unused)
     assert(Threads[0] != UUID_INVALID);
     assert(Threads[1] != UUID_INVALID);
     WaitForSynchronizationTest(Package, Threads, 2, 120 * 1000, 10 * 1000);
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // Test 5
+    // Test the raw pipe communication with a simplex connection, unbounded SPSC mode
+    /////////////////////////////////////////////////////////////////////////////////
+    TRACE(" > running configuration (RAW, SPSC, UNBOUNDED, SIMPLEX)");
+
+    // Setup package
+    Package->Configuration          = 0;
+    Package->Pipes[TEST_CONSUMER]   = CreateSystemPipe(PIPE_UNBOUNDED, 6);
+
+    // Check pipes
+    assert(Package->Pipes[TEST_CONSUMER] != NULL);
+
+    // Spawn threads
+    Threads[0] = ThreadingCreateThread("Test_Consumer", ConsumeWorker, Package, 0);
+    Threads[1] = ThreadingCreateThread("Test_Producer", ProduceWorker, Package, 0);
+    assert(Threads[0] != UUID_INVALID);
+    assert(Threads[1] != UUID_INVALID);
+    WaitForSynchronizationTest(Package, Threads, 2, 120 * 1000, 10 * 1000);
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // Test 6
+    // Test event port readiness and hangup of raw pipes
+    /////////////////////////////////////////////////////////////////////////////////
+    TestEventPort();
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // Test 7
+    // Test mutual exclusion of the ticket spinlock
+    /////////////////////////////////////////////////////////////////////////////////
+    TestSpinlock();
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // Test 8
+    // Test that epoch reclamation waits for active readers
+    /////////////////////////////////////////////////////////////////////////////////
+    TestEpoch();
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // Test 9
+    // Test priority inheritance from a real-time waiter to the lock holder
+    /////////////////////////////////////////////////////////////////////////////////
+    TestPriorityInheritance();
 }
@@ -28,6 +28,7 @@
 // Registered tests in the OS
 extern void TestDataStructures(void *Unused);
 extern void TestSynchronization(void *Unused);
+extern void TestBenchmarks(void *Context);
 
 /* StartTestingPhase
  * Performs tests with systems used in the OS to verify stability and
@@ -43,8 +44,16 @@ StartTestingPhase(void)
     //CurrentTest = ThreadingCreateThread("TestDataStructures", TestDataStructures, NULL, 0);
     //ThreadingJoinThread(CurrentTest);
 
+#ifdef __OSCONFIG_BENCHMARKS
+    // Run the selected benchmarks instead of the tests
+    TRACE(" > Running benchmarks");
+    CurrentTest = ThreadingCreateThread("TestBenchmarks", TestBenchmarks, 
+        (void*)(uintptr_t)(__OSCONFIG_BENCHMARKS), 0);
+    ThreadingJoinThread(CurrentTest);
+#else
     // Run synchronization tests
     TRACE(" > Running synchronization tests");
     CurrentTest = ThreadingCreateThread("TestSynchronization", TestSynchronization, NULL, 0);
     ThreadingJoinThread(CurrentTest);
+#endif
 }
@@ -47,13 +47,15 @@
 #include <stdio.h>
 
 /* Prototypes
- * The function handler for cleanup */
+ * The function handlers for cleanup */
 OsStatus_t ThreadingReap(void *Context);
+static OsStatus_t ThreadingCleanup(void *Context);
 
 /* Globals, we need a few variables to keep track of running threads, idle threads
  * and a thread resources lock */
 static Collection_t Threads         = COLLECTION_INIT(KeyInteger);
 static UUId_t GlbThreadGcId         = UUID_INVALID;
+static UUId_t GlbThreadCleanupGcId  = UUID_INVALID;
 static _Atomic(UUId_t) GlbThreadId  = ATOMIC_VAR_INIT(1);
 
 /* ThreadingInitialize
@@ -62,6 +64,7 @@ OsStatus_t
 ThreadingInitialize(void)
 {
     GlbThreadGcId           = GcRegister(ThreadingReap);
+    GlbThreadCleanupGcId    = GcRegister(ThreadingCleanup);
     return OsSuccess;
 }
 
@@ -85,6 +88,7 @@ ThreadingEnable(void)
     Thread->Flags       = THREADING_KERNELMODE | THREADING_IDLE | THREADING_CPUBOUND;
     SchedulerThreadInitialize(Thread, Thread->Flags);
     Thread->Pipe        = CreateSystemPipe(0, 6); // 64 entries, 4kb
+    Thread->RpcTarget   = UUID_INVALID;
     Thread->SignalQueue = CollectionCreate(KeyInteger);
     Key.Value           = (int)Thread->Id;
     COLLECTION_NODE_INIT(&Thread->CollectionHeader, Key);
@@ -96,8 +100,9 @@ ThreadingEnable(void)
         CpuHalt();
     }
 
-    // Update active thread to new idle
+    // Update active thread to new idle, the thread list owns the first reference
     GetCurrentProcessorCore()->CurrentThread = Thread;
+    atomic_store(&Thread->References, 1);
     return CollectionAppend(&Threads, &Thread->CollectionHeader);
 }
 
@@ -189,6 +194,7 @@ ThreadingCreateThread(
 
     // Create communication members
     Thread->Pipe        = CreateSystemPipe(0, 6); // 64 entries, 4kb
+    Thread->RpcTarget   = UUID_INVALID;
     Thread->SignalQueue = CollectionCreate(KeyInteger);
     Thread->ActiveSignal.Signal = -1;
 
@@ -230,8 +236,9 @@ ThreadingCreateThread(
         // @todo
     }
 
-    // Append it to list & scheduler
+    // Append it to list & scheduler, the thread list owns the first reference
     Key.Value = (int)Thread->Id;
+    atomic_store(&Thread->References, 1);
     CollectionAppend(&Threads, &Thread->CollectionHeader);
     SchedulerThreadQueue(Thread, 0);
     return Thread->Id;
@@ -245,17 +252,19 @@ ThreadingDetachThread(
     _In_  UUId_t        ThreadId)
 {
     MCoreThread_t *Thread   = ThreadingGetCurrentThread(CpuGetCurrentId());
-    MCoreThread_t *Target   = ThreadingGetThread(ThreadId);
+    MCoreThread_t *Target;
+    OsStatus_t Status       = OsError;
     UUId_t PId              = Thread->AshId;
 
-    // Perform security checks
-    if (Target == NULL || Target->AshId != PId) {
-        return OsError;
+    // Perform security checks, then the detach
+    EpochEnter();
+    Target = ThreadingGetThread(ThreadId);
+    if (Target != NULL && Target->AshId == PId) {
+        Target->ParentId    = UUID_INVALID;
+        Status              = OsSuccess;
     }
-    
-    // Perform the detach
-    Target->ParentId = UUID_INVALID;
-    return OsSuccess;
+    EpochLeave();
+    return Status;
 }
 
 /* ThreadingCleanupThread
@@ -277,6 +286,7 @@ ThreadingCleanupThread(
     SchedulerHandleSignalAll((uintptr_t*)Thread);
     SchedulerThreadDequeue(Thread);
     ThreadingUnregister(Thread);
+    EventSourceDestroy(&Thread->Events);
 
     _foreach(fNode, Thread->SignalQueue) {
         kfree(fNode->Data);
@@ -332,6 +342,7 @@ ThreadingExitThread(
 
     // Wake people waiting for us
     SchedulerHandleSignalAll((uintptr_t*)Thread);
+    EventSourceSignal(&Thread->Events, EVENT_EXITED);
     ThreadingYield();
 }
 
@@ -345,10 +356,14 @@ ThreadingKillThread(
     _In_ int            TerminateInstantly)
 {
     // Variables
-    MCoreThread_t *Target = ThreadingGetThread(ThreadId);
+    MCoreThread_t *Target = ThreadingAcquireThread(ThreadId);
 
     // Security check
-    if (Target == NULL || (Target->Flags & THREADING_IDLE)) {
+    if (Target == NULL) {
+        return OsError;
+    }
+    if (Target->Flags & THREADING_IDLE) {
+        ThreadingReleaseThread(Target);
         return OsError;
     }
 
@@ -358,11 +373,14 @@ ThreadingKillThread(
 
     // Wake-up threads waiting with ThreadJoin
     SchedulerHandleSignalAll((uintptr_t*)Target);
+    EventSourceSignal(&Target->Events, EVENT_EXITED);
 
     // Should we instagib?
     if (TerminateInstantly) {
         if (ThreadId == ThreadingGetCurrentThreadId()) {
+            ThreadingReleaseThread(Target);
             ThreadingYield();
+            return OsSuccess;
         }
         else {
             // Wake-up the thread if it's sleeping, this will cause a 
@@ -374,6 +392,7 @@ ThreadingKillThread(
             }
         }
     }
+    ThreadingReleaseThread(Target);
     return OsSuccess;
 }
 
@@ -384,12 +403,16 @@ int
 ThreadingJoinThread(
     _In_ UUId_t         ThreadId)
 {
-    MCoreThread_t *Target = ThreadingGetThread(ThreadId);
+    MCoreThread_t *Target = ThreadingAcquireThread(ThreadId);
+    int ReturnCode;
+
     if (Target == NULL) {
         return -1;
     }
     SchedulerThreadSleep((uintptr_t*)Target, 0);
-    return Target->RetCode;
+    ReturnCode = Target->RetCode;
+    ThreadingReleaseThread(Target);
+    return ReturnCode;
 }
 
 /* ThreadingSwitchLevel
@@ -477,14 +500,55 @@ MCoreThread_t*
 ThreadingGetThread(
     _In_ UUId_t         ThreadId)
 {
-    // Iterate thread nodes and find the correct
+    MCoreThread_t *Result = NULL;
+
+    // Iterate thread nodes and find the correct, the list is read without locks
+    EpochEnter();
     foreach(tNode, &Threads) {
         MCoreThread_t *Thread = (MCoreThread_t*)tNode;
         if (Thread->Id == ThreadId) {
-            return Thread;
+            Result = Thread;
+            break;
         }
     }
-    return NULL;
+    EpochLeave();
+    return Result;
+}
+
+/* ThreadingAcquireThread
+ * Lookup thread by the given thread-id and takes a reference to it, the thread stays
+ * valid untill the reference is released with ThreadingReleaseThread. */
+MCoreThread_t*
+ThreadingAcquireThread(
+    _In_ UUId_t         ThreadId)
+{
+    MCoreThread_t *Thread;
+    int References;
+
+    // Threads that reached 0 references are being cleaned up
+    EpochEnter();
+    Thread = ThreadingGetThread(ThreadId);
+    if (Thread != NULL) {
+        References = atomic_load(&Thread->References);
+        while (References != 0 
+            && !atomic_compare_exchange_weak(&Thread->References, &References, References + 1));
+        if (References == 0) {
+            Thread = NULL;
+        }
+    }
+    EpochLeave();
+    return Thread;
+}
+
+/* ThreadingReleaseThread
+ * Releases a reference to the thread, the last reference queues its cleanup. */
+void
+ThreadingReleaseThread(
+    _In_ MCoreThread_t* Thread)
+{
+    if (atomic_fetch_sub(&Thread->References, 1) == 1) {
+        GcSignal(GlbThreadCleanupGcId, Thread);
+    }
 }
 
 /* ThreadingIsCurrentTaskIdle
@@ -509,6 +573,29 @@ ThreadingGetCurrentMode(void)
     return ThreadingGetCurrentThread(CpuGetCurrentId())->Flags & THREADING_MODEMASK;
 }
 
+/* ThreadingRetire
+ * Invoked once no lookups can see the thread anymore, releases the reference
+ * of the thread list. */
+static void
+ThreadingRetire(
+    _In_ void*          Context)
+{
+    ThreadingReleaseThread((MCoreThread_t*)Context);
+}
+
+/* ThreadingCleanup
+ * Garbage-Collector function, cleans up threads that have no references left */
+static OsStatus_t
+ThreadingCleanup(
+    _In_ void*          Context)
+{
+    if (Context == NULL) {
+        return OsError;
+    }
+    ThreadingCleanupThread((MCoreThread_t*)Context);
+    return OsSuccess;
+}
+
 /* ThreadingReapZombies
  * Garbage-Collector function, it reaps and cleans up all threads */
 OsStatus_t
@@ -519,10 +606,11 @@ ThreadingReap(
     if (Thread == NULL) {
         return OsError;
     }
-    CollectionRemoveByNode(&Threads, &Thread->CollectionHeader);
 
-    // Cleanup the thread
-    ThreadingCleanupThread(Thread);
+    // The thread keeps its links as lookups might be walking the list,
+    // it's cleaned up once they are done
+    CollectionUnlinkNode(&Threads, &Thread->CollectionHeader);
+    EpochDefer(&Thread->Retire, ThreadingRetire, Thread);
     return OsSuccess;
 }
 
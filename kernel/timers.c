@@ -25,10 +25,14 @@
 
 /* Includes 
  * - System */
+#include <system/utils.h>
 #include <process/ash.h>
+#include <garbagecollector.h>
 #include <interrupts.h>
 #include <scheduler.h>
+#include <machine.h>
 #include <timers.h>
+#include <epoch.h>
 #include <debug.h>
 #include <heap.h>
 
@@ -37,14 +41,218 @@
 #include <ds/collection.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 
 /* Globals */
 static MCoreTimePerformanceOps_t PerformanceTimer   = { 0 };
 static CriticalSection_t TimersSyncObject           = CRITICALSECTION_INITIALIZE(CRITICALSECTION_PLAIN);
+static CriticalSection_t SharedPageSyncObject       = CRITICALSECTION_INITIALIZE(CRITICALSECTION_PLAIN);
 static MCoreSystemTimer_t *ActiveSystemTimer        = NULL;
 static Collection_t SystemTimers                    = COLLECTION_INIT(KeyInteger);
 static Collection_t Timers                          = COLLECTION_INIT(KeyInteger);
 static _Atomic(UUId_t) TimerIdGenerator             = ATOMIC_VAR_INIT(0);
+static SystemSharedPage_t *SharedPage               = NULL;
+static uintptr_t SharedPagePhysical                 = 0;
+static clock_t LastTimestampSync                    = 0;
+static clock_t LastWallClockSync                    = 0;
+static uint64_t LastTimestamp                       = 0;
+static uint64_t LastPerformance                     = 0;
+static UUId_t WallClockGcId                         = UUID_INVALID;
+static atomic_int WallClockSyncQueued               = ATOMIC_VAR_INIT(0);
+static UUId_t EpochGcId                             = UUID_INVALID;
+static atomic_int EpochReclaimQueued                = ATOMIC_VAR_INIT(0);
+
+static OsStatus_t TimersSyncWallClock(void* Unused);
+static OsStatus_t TimersReclaimEpoch(void* Unused);
+
+/* TimersInitialize
+ * Creates the shared system page, must be called before any processes are
+ * created and before timers are registered. */
+OsStatus_t
+TimersInitialize(void)
+{
+    SharedPage = (SystemSharedPage_t*)kmalloc_ap(GetSystemMemoryPageSize(), &SharedPagePhysical);
+    if (SharedPage == NULL) {
+        ERROR("Failed to allocate the shared system page");
+        return OsError;
+    }
+    memset((void*)SharedPage, 0, GetSystemMemoryPageSize());
+    SharedPage->Version         = SHAREDPAGE_VERSION;
+    SharedPage->NumberOfCores   = 1;
+    WallClockGcId               = GcRegister(TimersSyncWallClock);
+    EpochGcId                   = GcRegister(TimersReclaimEpoch);
+    return OsSuccess;
+}
+
+/* TimersMapSharedPage
+ * Maps the shared system page read-only into the given memory space at the location
+ * defined by the memory map. */
+OsStatus_t
+TimersMapSharedPage(
+    _In_ SystemMemorySpace_t* MemorySpace)
+{
+    // Variables
+    PhysicalAddress_t Physical  = SharedPagePhysical;
+    VirtualAddress_t Virtual    = GetMachine()->MemoryMap.SharedPage.Start;
+
+    if (SharedPage == NULL) {
+        return OsError;
+    }
+    return CreateSystemMemorySpaceMapping(MemorySpace, &Physical, &Virtual, 
+        GetSystemMemoryPageSize(), MAPPING_USERSPACE | MAPPING_READONLY | MAPPING_PERSISTENT 
+        | MAPPING_PROVIDED | MAPPING_FIXED, __MASK);
+}
+
+/* TimersConvertTime
+ * Converts a broken-down UTC time to seconds since epoch. The kernel has no mktime
+ * and the clock is kept in UTC. */
+static int64_t
+TimersConvertTime(
+    _In_ struct tm* Time)
+{
+    // Variables
+    int64_t Year    = (int64_t)Time->tm_year + 1900;
+    int64_t Month   = (int64_t)Time->tm_mon + 1;
+    int64_t Era, YearOfEra, DayOfYear, DayOfEra;
+
+    // Days from the civil calendar, counted in 400 year eras starting in march
+    Year        -= (Month <= 2) ? 1 : 0;
+    Era         = ((Year >= 0) ? Year : Year - 399) / 400;
+    YearOfEra   = Year - (Era * 400);
+    DayOfYear   = ((153 * (Month + ((Month > 2) ? -3 : 9)) + 2) / 5) + Time->tm_mday - 1;
+    DayOfEra    = (YearOfEra * 365) + (YearOfEra / 4) - (YearOfEra / 100) + DayOfYear;
+    return ((((Era * 146097) + DayOfEra - 719468) * 86400)
+        + (Time->tm_hour * 3600) + (Time->tm_min * 60) + Time->tm_sec);
+}
+
+/* TimersSyncWallClock
+ * Samples the clock source and publishes it as the new wall clock base. Reading
+ * the clock waits for the seconds to change, so this runs from the gc-worker and
+ * never from the timer interrupt. */
+static OsStatus_t
+TimersSyncWallClock(
+    _In_ void*          Unused)
+{
+    // Variables
+    clock_t SystemTick  = 0;
+    int64_t WallClock   = 0;
+    struct tm Time;
+    _CRT_UNUSED(Unused);
+
+    memset((void*)&Time, 0, sizeof(struct tm));
+    if (SharedPage != NULL && TimersGetSystemTime(&Time) == OsSuccess 
+        && TimersGetSystemTick(&SystemTick) == OsSuccess) {
+        WallClock = TimersConvertTime(&Time);
+
+        CriticalSectionEnter(&SharedPageSyncObject);
+        atomic_store_explicit(&SharedPage->Sequence, 
+            atomic_load_explicit(&SharedPage->Sequence, memory_order_relaxed) + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        SharedPage->WallClock       = WallClock;
+        SharedPage->WallClockTick   = (uint64_t)SystemTick;
+        SharedPage->Flags          |= SHAREDPAGE_WALLCLOCK;
+        atomic_store_explicit(&SharedPage->Sequence, 
+            atomic_load_explicit(&SharedPage->Sequence, memory_order_relaxed) + 1, memory_order_release);
+        CriticalSectionLeave(&SharedPageSyncObject);
+    }
+    atomic_store(&WallClockSyncQueued, 0);
+    return OsSuccess;
+}
+
+/* TimersReclaimEpoch
+ * Invokes the deferred callbacks that expired since the last tick. Callbacks may
+ * free memory, so they are run from the gc-worker and never from the timer interrupt. */
+static OsStatus_t
+TimersReclaimEpoch(
+    _In_ void*          Unused)
+{
+    _CRT_UNUSED(Unused);
+    atomic_store(&EpochReclaimQueued, 0);
+    EpochReclaim();
+    return OsSuccess;
+}
+
+/* TimersUpdateSharedPage
+ * Publishes the current time to the shared page. The slow sources are sampled
+ * before the page is locked, so readers only spin for the duration of the stores.
+ * The wall clock is advanced by readers from the system tick, resampling it is
+ * deferred to the gc-worker as the clock source can not be read from interrupts. */
+static void
+TimersUpdateSharedPage(void)
+{
+    // Variables
+    LargeInteger_t Performance      = { { 0 } };
+    LargeInteger_t Frequency        = { { 0 } };
+    uint64_t Timestamp              = 0;
+    uint64_t PerformanceBase        = 0;
+    uint64_t TimestampScale         = 0;
+    clock_t SystemTick              = 0;
+    int SyncTimestamp               = 0;
+
+    if (SharedPage == NULL || ActiveSystemTimer->SystemTick == NULL) {
+        return;
+    }
+    SystemTick = ActiveSystemTimer->SystemTick();
+
+    // Derive the performance counter from the timestamp counter, the scale is
+    // measured against the performance timer over the last interval
+    if (LastTimestampSync == 0 || (SystemTick - LastTimestampSync) >= TIMERS_TIMESTAMP_SYNC_INTERVAL) {
+        LastTimestampSync = SystemTick;
+        if (PerformanceTimer.ReadTimer != NULL && PerformanceTimer.ReadFrequency != NULL
+            && CpuReadTimestampCounter(&Timestamp) == OsSuccess) {
+            PerformanceTimer.ReadTimer(&Performance);
+            PerformanceTimer.ReadFrequency(&Frequency);
+            if (LastTimestamp != 0 && Timestamp > LastTimestamp 
+                && (uint64_t)Performance.QuadPart > LastPerformance
+                && ((uint64_t)Performance.QuadPart - LastPerformance) < (Timestamp - LastTimestamp)
+                && ((uint64_t)Performance.QuadPart - LastPerformance) <= 0xFFFFFFFF) {
+                TimestampScale  = (((uint64_t)Performance.QuadPart - LastPerformance) << 32) 
+                    / (Timestamp - LastTimestamp);
+                PerformanceBase = (uint64_t)Performance.QuadPart;
+
+                // Never let the counter step backwards when the base is moved
+                if (SharedPage->Flags & SHAREDPAGE_TIMESTAMP) {
+                    uint64_t Delta      = Timestamp - SharedPage->TimestampBase;
+                    uint64_t Estimate   = SharedPage->PerformanceBase 
+                        + ((Delta >> 32) * SharedPage->TimestampScale)
+                        + (((Delta & 0xFFFFFFFF) * SharedPage->TimestampScale) >> 32);
+                    PerformanceBase     = MAX(PerformanceBase, Estimate);
+                }
+                SyncTimestamp = 1;
+            }
+            LastTimestamp   = Timestamp;
+            LastPerformance = (uint64_t)Performance.QuadPart;
+        }
+    }
+
+    // The clock is only read from the source once in a while, inbetween the
+    // system tick is used to advance it
+    if (LastWallClockSync == 0 || (SystemTick - LastWallClockSync) >= TIMERS_WALLCLOCK_SYNC_INTERVAL) {
+        LastWallClockSync = SystemTick;
+        if (!atomic_exchange(&WallClockSyncQueued, 1) && GcSignal(WallClockGcId, NULL) != OsSuccess) {
+            atomic_store(&WallClockSyncQueued, 0);
+        }
+    }
+
+    // Publish the changes
+    CriticalSectionEnter(&SharedPageSyncObject);
+    atomic_store_explicit(&SharedPage->Sequence, 
+        atomic_load_explicit(&SharedPage->Sequence, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    SharedPage->SystemTick      = (uint64_t)SystemTick;
+    SharedPage->NumberOfCores   = (unsigned int)GetMachine()->NumberOfActiveCores;
+    SharedPage->Flags          |= SHAREDPAGE_SYSTEMTICK;
+    if (SyncTimestamp) {
+        SharedPage->PerformanceFrequency    = (uint64_t)Frequency.QuadPart;
+        SharedPage->PerformanceBase         = PerformanceBase;
+        SharedPage->TimestampBase           = Timestamp;
+        SharedPage->TimestampScale          = TimestampScale;
+        SharedPage->Flags                  |= SHAREDPAGE_PERFORMANCE | SHAREDPAGE_TIMESTAMP;
+    }
+    atomic_store_explicit(&SharedPage->Sequence, 
+        atomic_load_explicit(&SharedPage->Sequence, memory_order_relaxed) + 1, memory_order_release);
+    CriticalSectionLeave(&SharedPageSyncObject);
+}
 
 /* TimersStart 
  * Creates a new standard timer for the requesting process. */
@@ -65,6 +273,7 @@ TimersStart(
 
     // Allocate a new instance and initialize
     Timer = (MCoreTimer_t*)kmalloc(sizeof(MCoreTimer_t));
+    memset((void*)Timer, 0, sizeof(MCoreTimer_t));
     Timer->Id       = atomic_fetch_add(&TimerIdGenerator, 1);
     Timer->AshId    = PhoenixGetCurrentAsh()->Id;
     Timer->Data     = Data;
@@ -97,6 +306,7 @@ TimersStop(
         // Does it match the id? + Owner must match
         if (Timer->Id == TimerId && Timer->AshId == PhoenixGetCurrentAsh()->Id) {
             CollectionRemoveByNode(&Timers, tNode);
+            EventSourceDestroy(&Timer->Events);
             kfree(Timer);
             kfree(tNode);
             Result = OsSuccess;
@@ -107,6 +317,33 @@ TimersStop(
     return Result;
 }
 
+/* TimersAttachEventPort
+ * Attaches the timer with the given id to the event port, the timer must be owned
+ * by the requesting process. The timer lock is held across the attach so a one-shot
+ * timer can not expire and be freed inbetween. */
+OsStatus_t
+TimersAttachEventPort(
+    _In_ UUId_t         TimerId,
+    _In_ UUId_t         Handle,
+    _In_ Flags_t        Events,
+    _In_ void*          Context)
+{
+    // Variables
+    OsStatus_t Result = OsError;
+
+    CriticalSectionEnter(&TimersSyncObject);
+    foreach(tNode, &Timers) {
+        MCoreTimer_t *Timer = (MCoreTimer_t*)tNode->Data;
+        if (Timer->Id == TimerId && Timer->AshId == PhoenixGetCurrentAsh()->Id) {
+            Result = AttachSystemEventPort(Handle, &Timer->Events, 
+                EVENTPORT_SOURCE_TIMER, TimerId, Events, Context);
+            break;
+        }
+    }
+    CriticalSectionLeave(&TimersSyncObject);
+    return Result;
+}
+
 /* TimersTick
  * This method actually applies the new tick-delta to all
  * active timers registered, and decreases the total */
@@ -115,33 +352,50 @@ TimersTick(
     _In_ size_t Tick)
 {
     // Variables
-    CollectionItem_t *i = NULL;
-    size_t MilliTicks   = 0;
+    CollectionItem_t *i     = NULL;
+    CollectionItem_t *Next  = NULL;
+    size_t MilliTicks       = 0;
 
     // Calculate how many milliseconds
     MilliTicks = DIVUP(Tick, NSEC_PER_MSEC);
 
     // Update scheduler with the milliticks
     SchedulerTick(MilliTicks);
+    TimersUpdateSharedPage();
+
+    // Keep the epoch moving so deferred nodes are released even when nothing
+    // else is being retired, the callbacks are invoked by the gc-worker
+    if (EpochTick() && EpochGcId != UUID_INVALID && !atomic_exchange(&EpochReclaimQueued, 1)
+        && GcSignal(EpochGcId, NULL) != OsSuccess) {
+        atomic_store(&EpochReclaimQueued, 0);
+    }
 
     // Now loop through timers registered
-    _foreach(i, &Timers) {
+    _foreach_nolink(i, &Timers) {
         // Initiate pointer
         MCoreTimer_t *Timer = (MCoreTimer_t*)i->Data;
+        Next                = CollectionNext(i);
         
         // Reduce
         Timer->Current -= MIN(Timer->Current, Tick);
         if (Timer->Current == 0) {
-            __KernelTimeoutDriver(Timer->AshId, Timer->Id, (void*)Timer->Data);
+            if (EventSourceSignal(&Timer->Events, EVENT_TIMEOUT) != OsSuccess) {
+                __KernelTimeoutDriver(Timer->AshId, Timer->Id, (void*)Timer->Data);
+            }
             if (Timer->Periodic) {
                 Timer->Current = Timer->Interval;
             }
             else {
+                // Serialize with lookups that attach to the timer
+                CriticalSectionEnter(&TimersSyncObject);
                 CollectionRemoveByNode(&Timers, i);
+                EventSourceDestroy(&Timer->Events);
+                CriticalSectionLeave(&TimersSyncObject);
                 kfree(Timer);
                 kfree(i);
             }
         }
+        i = Next;
     }
 }
 
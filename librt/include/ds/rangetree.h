@@ -0,0 +1,135 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - Generic Range Tree Implementation
+ * - Balanced tree of address ranges that together cover the managed space. Each
+ *   range carries attributes (0 means free), neighbours with equal attributes
+ *   are always merged. Lookups, allocations and updates are O(log n).
+ */
+
+#ifndef __RANGE_TREE__
+#define __RANGE_TREE__
+
+#include <os/osdefs.h>
+#include <ds/ds.h>
+
+#define RANGE_FREE                      0
+
+/* RangeTreeNode_t
+ * A range of the tree, <LargestFree> is the largest free range of the subtree
+ * rooted at this node, which makes first-fit allocation logarithmic. */
+typedef struct _RangeTreeNode {
+    uintptr_t               Start;
+    size_t                  Length;
+    Flags_t                 Attributes;
+    size_t                  LargestFree;
+    int                     Height;
+    struct _RangeTreeNode*  Left;
+    struct _RangeTreeNode*  Right;
+} RangeTreeNode_t;
+
+/* RangeTree_t
+ * A range tree covering [RangeStart, RangeEnd) in units of <Granularity> */
+typedef struct _RangeTree {
+    RangeTreeNode_t*        Root;
+    SafeMemoryLock_t        SyncObject;
+    uintptr_t               RangeStart;
+    uintptr_t               RangeEnd;
+    size_t                  Granularity;
+
+    // Statistics
+    size_t                  NumberOfRanges;
+    size_t                  BytesAllocated;
+} RangeTree_t;
+
+/* CreateRangeTree
+ * Creates a new range tree that covers the given space. The entire space is free
+ * initially, all ranges are rounded to the granularity. */
+CRTDECL(
+OsStatus_t,
+CreateRangeTree(
+    _In_  uintptr_t         RangeStart,
+    _In_  uintptr_t         RangeEnd,
+    _In_  size_t            Granularity,
+    _Out_ RangeTree_t**     Tree));
+
+/* DestroyRangeTree
+ * Destroys the range tree and releases all resources associated */
+CRTDECL(
+OsStatus_t,
+DestroyRangeTree(
+    _In_ RangeTree_t*       Tree));
+
+/* RangeTreeAllocate
+ * Allocates the first free range large enough and assigns it the given
+ * (non-zero) attributes. Returns the start of the range in <Address>. */
+CRTDECL(
+OsStatus_t,
+RangeTreeAllocate(
+    _In_  RangeTree_t*      Tree,
+    _In_  size_t            Length,
+    _In_  Flags_t           Attributes,
+    _Out_ uintptr_t*        Address));
+
+/* RangeTreeReserve
+ * Assigns the given (non-zero) attributes to a fixed range, the entire range
+ * must be free. */
+CRTDECL(
+OsStatus_t,
+RangeTreeReserve(
+    _In_ RangeTree_t*       Tree,
+    _In_ uintptr_t          Address,
+    _In_ size_t             Length,
+    _In_ Flags_t            Attributes));
+
+/* RangeTreeSetAttributes
+ * Changes the attributes of a part of the allocated space, the range is split
+ * from its neighbours if needed. The entire range must be allocated. The
+ * previous attributes of the first part of the range are returned. */
+CRTDECL(
+OsStatus_t,
+RangeTreeSetAttributes(
+    _In_      RangeTree_t*  Tree,
+    _In_      uintptr_t     Address,
+    _In_      size_t        Length,
+    _In_      Flags_t       Attributes,
+    _Out_Opt_ Flags_t*      PreviousAttributes));
+
+/* RangeTreeRelease
+ * Frees a part of the allocated space, partial releases are allowed. The
+ * entire range must be allocated. */
+CRTDECL(
+OsStatus_t,
+RangeTreeRelease(
+    _In_ RangeTree_t*       Tree,
+    _In_ uintptr_t          Address,
+    _In_ size_t             Length));
+
+/* RangeTreeLookup
+ * Looks up the allocated range that contains the address. Returns OsError if the
+ * address is outside the tree or not allocated. */
+CRTDECL(
+OsStatus_t,
+RangeTreeLookup(
+    _In_      RangeTree_t*  Tree,
+    _In_      uintptr_t     Address,
+    _Out_Opt_ uintptr_t*    Start,
+    _Out_Opt_ size_t*       Length,
+    _Out_Opt_ Flags_t*      Attributes));
+
+#endif //!__RANGE_TREE__
@@ -70,6 +70,9 @@
 struct DIR {
     UUId_t d_handle;
     int    d_index;
+    void*  d_buffer;
+    size_t d_offset;
+    size_t d_length;
 };
 struct DIRENT {
     Flags_t d_type;
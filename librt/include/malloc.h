@@ -71,6 +71,20 @@ struct mallinfo {
   thus be inaccurate.
 */
 CRTDECL(struct mallinfo, mallinfo(void));
+
+/* memalign
+ * Allocates a block of at least <size> bytes aligned to <alignment>, which
+ * must be a power of two. The block is released with free. */
+CRTDECL(void*, memalign(size_t alignment, size_t size));
+
+/* malloc_usable_size
+ * Returns the number of bytes that can be used in a block returned by malloc. */
+CRTDECL(size_t, malloc_usable_size(void* ptr));
+
+/* malloc_trim
+ * Releases cached and unused heap memory back to the system, keeping <pad>
+ * bytes of free space at the top of each arena. Returns 1 if memory was released. */
+CRTDECL(int, malloc_trim(size_t pad));
 _CODE_END
 
 #endif
@@ -60,6 +60,7 @@ PACKED_TYPESTRUCT(Context, {
 });
 #define CONTEXT_IP(Context)     Context->Eip
 #define CONTEXT_SP(Context)     Context->Esp
+#define CONTEXT_BP(Context)     Context->Ebp
 #define CONTEXT_USERSP(Context) Context->UserEsp
 #elif defined(__amd64__) || defined(amd64)
 PACKED_TYPESTRUCT(Context, {
@@ -99,6 +100,7 @@ PACKED_TYPESTRUCT(Context, {
 });
 #define CONTEXT_IP(Context)     Context->Rip
 #define CONTEXT_SP(Context)     Context->Rsp
+#define CONTEXT_BP(Context)     Context->Rbp
 #define CONTEXT_USERSP(Context) Context->UserRsp
 #else
 #error "os/context.h: Invalid architecture"
@@ -49,6 +49,10 @@
  * the given filesystem */
 #define __FILESYSTEM_BOOT           0x00000001
 
+/* FileSystem query functions
+ * Used with FsQueryFile to select the kind of information */
+#define __FILESYSTEM_QUERY_STATS    0x00000000  // vFileDescriptor_t
+
 /* FileSystem Disk structure
  * Keeps information about the disk target and the
  * general information about the disk (geometry, string data) */
@@ -162,6 +166,19 @@ __FSDECL(FsReadFile)(
     _Out_ size_t*                   BytesAt,
     _Out_ size_t*                   BytesRead);
 
+/* FsReadDirectory 
+ * Reads as many directory entries as fits into <Length> bytes of the buffer,
+ * starting at the handle position. Entries are packed as DirectoryEntry_t and
+ * the handle position is advanced past the entries read */
+__FSAPI
+FileSystemCode_t
+__FSDECL(FsReadDirectory)(
+    _In_  FileSystemDescriptor_t*   Descriptor,
+    _In_  FileSystemFileHandle_t*   Handle,
+    _In_  DmaBuffer_t*              BufferObject,
+    _In_  size_t                    Length,
+    _Out_ size_t*                   BytesRead);
+
 /* FsWriteFile 
  * Writes the requested number of bytes to the given
  * file handle and outputs the number of bytes actually written */
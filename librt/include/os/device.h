@@ -68,6 +68,22 @@
 #define __DEVICEMANAGER_IOCTL_EXT_WRITE			0x00000000
 #define __DEVICEMANAGER_IOCTL_EXT_READ			0x80000000
 
+/* MCoreDevice Message Signaled Interrupts
+ * The bus fills in the msi capabilities of the device, MSI-X is preferred.
+ * Plain MSI is limited to a single vector as multiple vectors must be contiguous. */
+#define __DEVICEMANAGER_MSI_NONE                0
+#define __DEVICEMANAGER_MSI                     1
+#define __DEVICEMANAGER_MSIX                    2
+
+PACKED_TYPESTRUCT(MCoreDeviceMsi, {
+    int                         Type;
+    int                         Capability;     // Offset of the capability in configuration space
+    int                         Vectors;        // Number of vectors supported
+    int                         Is64Bit;        // MSI - Address is 64 bit
+    int                         TableBar;       // MSI-X - Io-space of the vector table
+    size_t                      TableOffset;    // MSI-X - Offset of the vector table in the io-space
+});
+
 /* These are the different IPC functions supported
  * by the devicemanager, note that some of them might
  * be changed in the different versions, and/or new
@@ -110,6 +126,9 @@ PACKED_TYPESTRUCT(MCoreDevice, {
 	DevInfo_t					Bus;
 	DevInfo_t					Slot;
 	DevInfo_t					Function;
+
+	// Message signaled interrupt support
+	MCoreDeviceMsi_t			Msi;
 });
 
 /* RegisterDevice
@@ -164,4 +183,27 @@ InstallDriver(
 	_In_ MCoreDevice_t *Device,
 	_In_ size_t Length));
 
+/* RegisterMsiInterrupts
+ * Allocates up to <Count> message signaled interrupts for the device and enables
+ * MSI-X (or MSI) delivery. The interrupts must have their handlers, data and affinity 
+ * set up. The MSI-X table io-space is acquired if the driver has not already done so.
+ * Returns the number of vectors allocated, 0 means the legacy line must be used. */
+CRTDECL(
+int,
+RegisterMsiInterrupts(
+	_In_  MCoreDevice_t*    Device,
+	_In_  MCoreInterrupt_t* Interrupts,
+	_In_  int               Count,
+	_In_  Flags_t           Flags,
+	_Out_ UUId_t*           Ids));
+
+/* UnregisterMsiInterrupts
+ * Disables message signaled interrupts for the device and releases the vectors */
+CRTDECL(
+OsStatus_t,
+UnregisterMsiInterrupts(
+	_In_ MCoreDevice_t*     Device,
+	_In_ UUId_t*            Ids,
+	_In_ int                Count));
+
 #endif //!_DEVICE_INTERFACE_H_
@@ -0,0 +1,108 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS Event Port Interface
+ * - Event ports allow a single thread to wait for many event sources at once.
+ *   Pipes, threads, processes, timers and interrupts can be attached to a port,
+ *   and a wait returns a batch of the sources that became ready.
+ */
+
+#ifndef _EVENTPORT_INTERFACE_H_
+#define _EVENTPORT_INTERFACE_H_
+
+#include <os/osdefs.h>
+
+/* Event Port Sources
+ * The type of object that is attached, the source id is interpreted based on the type. */
+#define EVENTPORT_SOURCE_PIPE           0   // Pipe port of the calling process
+#define EVENTPORT_SOURCE_THREAD         1   // Thread id
+#define EVENTPORT_SOURCE_PROCESS        2   // Process id
+#define EVENTPORT_SOURCE_TIMER          3   // Timer id, owned by the calling process
+#define EVENTPORT_SOURCE_INTERRUPT      4   // Interrupt id, owned by the calling process
+#define EVENTPORT_SOURCE_COUNT          5
+
+/* Event Port Events
+ * Events are edge-triggered and coalesced, a source is reported once per wait
+ * with the number of times it was signalled. Timer and interrupt events that are
+ * delivered to a port are no longer sent as rpc events to the process. */
+#define EVENT_READABLE                  0x00000001  // Pipe has new data
+#define EVENT_EXITED                    0x00000002  // Thread or process has exited
+#define EVENT_TIMEOUT                   0x00000004  // Timer has elapsed
+#define EVENT_INTERRUPT                 0x00000008  // Interrupt has fired
+#define EVENT_HANGUP                    0x00000010  // Source was destroyed, always reported
+
+/* EventPortEvent
+ * A ready source returned by WaitForEventPort. After EVENT_HANGUP the source is
+ * automatically detached from the port. */
+typedef struct _EventPortEvent {
+    int                 Source;
+    UUId_t              SourceId;
+    Flags_t             Events;
+    size_t              Count;
+    void*               Context;
+} EventPortEvent_t;
+
+/* CreateEventPort
+ * Creates a new event port that no sources are attached to. */
+CRTDECL(
+OsStatus_t,
+CreateEventPort(
+    _Out_ UUId_t*           Port));
+
+/* DestroyEventPort
+ * Destroys the event port, threads waiting on the port keep it alive until their wait returns. */
+CRTDECL(
+OsStatus_t,
+DestroyEventPort(
+    _In_ UUId_t             Port));
+
+/* AttachEventPort
+ * Attaches a source to the event port. <Events> selects which events of the source
+ * wakes the port, <Context> is returned with each event of the source. */
+CRTDECL(
+OsStatus_t,
+AttachEventPort(
+    _In_ UUId_t             Port,
+    _In_ int                Source,
+    _In_ UUId_t             SourceId,
+    _In_ Flags_t            Events,
+    _In_ void*              Context));
+
+/* DetachEventPort
+ * Detaches a source from the event port, pending events of the source are discarded. */
+CRTDECL(
+OsStatus_t,
+DetachEventPort(
+    _In_ UUId_t             Port,
+    _In_ int                Source,
+    _In_ UUId_t             SourceId));
+
+/* WaitForEventPort
+ * Waits for any attached source to become ready and returns up to <MaxEvents> ready
+ * sources. A <Timeout> of 0 waits indefinitely, if no sources became ready in time
+ * <EventCount> is set to 0. */
+CRTDECL(
+OsStatus_t,
+WaitForEventPort(
+    _In_  UUId_t            Port,
+    _In_  EventPortEvent_t* Events,
+    _In_  size_t            MaxEvents,
+    _In_  size_t            Timeout,
+    _Out_ size_t*           EventCount));
+
+#endif //!_EVENTPORT_INTERFACE_H_
@@ -57,10 +57,9 @@ PACKED_TYPESTRUCT(QueryFileOptionsPackage, {
     Flags_t                    Options;
     Flags_t                    Access;
 });
-PACKED_TYPESTRUCT(ReadDirectoryPackage, {
+PACKED_TYPESTRUCT(QueryFileStatsPackage, {
     FileSystemCode_t        Code;
-    char                    FileName[256];
-    vFileDescriptor_t       FileInformation;
+    vFileDescriptor_t       Information;
 });
 
 /* These definitions are in-place to allow a custom
@@ -264,32 +263,42 @@ CloseDirectory(
 }
 
 /* ReadDirectory
- * Reads a directory entry at the current index and increases the current index
- * for the directory handle. */
+ * Reads as many directory entries as fits into the given buffer from the current
+ * position of the directory handle, and advances the position past them. Entries are
+ * packed back to back as DirectoryEntry_t, and <BytesRead> is 0 at end of directory. */
 SERVICEAPI FileSystemCode_t SERVICEABI
 ReadDirectory(
-    _In_  UUId_t                    Handle,
-    _Out_ ReadDirectoryPackage_t*   DirectoryEntry)
+    _In_      UUId_t            Handle,
+    _In_      UUId_t            BufferHandle,
+    _In_      size_t            Length,
+    _Out_Opt_ size_t*           BytesRead)
 {
     // Variables
+    RWFilePackage_t Package;
     MRemoteCall_t Request;
 
     // Initialize the request
     RPCInitialize(&Request, __FILEMANAGER_TARGET, 
         __FILEMANAGER_INTERFACE_VERSION, __FILEMANAGER_READDIRECTORY);
-    RPCSetArgument(&Request, 0, (const void*)&Handle, sizeof(UUId_t));
-    RPCSetResult(&Request, (const void*)DirectoryEntry, sizeof(ReadDirectoryPackage_t));
+    RPCSetArgument(&Request, 0, (const void*)&Handle,       sizeof(UUId_t));
+    RPCSetArgument(&Request, 1, (const void*)&BufferHandle, sizeof(UUId_t));
+    RPCSetArgument(&Request, 2, (const void*)&Length,       sizeof(size_t));
+    RPCSetResult(&Request,      (const void*)&Package,      sizeof(RWFilePackage_t));
 
     // Execute the request 
     if (RPCExecute(&Request) != OsSuccess) {
-        return FsInvalidParameters;
+        Package.ActualSize  = 0;
+        Package.Code        = FsInvalidParameters;
     }
-    return DirectoryEntry->Code;
+    if (BytesRead != NULL) {
+        *BytesRead = Package.ActualSize;
+    }
+    return Package.Code;
 }
 
 /* SeekDirectory
- * Sets the index for the given directory handle. The index will then indicate
- * the next read directory index. */
+ * Sets the position for the given directory handle. The position must be 0 to
+ * restart the enumeration, or the position of a previously read entry. */
 SERVICEAPI FileSystemCode_t SERVICEABI
 SeekDirectory(
     _In_ UUId_t     Handle, 
@@ -725,14 +734,22 @@ GetFileStatsByPath(
     _Out_ vFileDescriptor_t*    FileDescriptor)
 {
     // Variables
+    QueryFileStatsPackage_t Package;
     MRemoteCall_t Request;
 
     // Initialize the request
     RPCInitialize(&Request, __FILEMANAGER_TARGET, 
         __FILEMANAGER_INTERFACE_VERSION, __FILEMANAGER_GETSTATSBYPATH);
     RPCSetArgument(&Request, 0, (const void*)Path, strlen(Path) + 1);
-    RPCSetResult(&Request, (const void*)&FileDescriptor, sizeof(vFileDescriptor_t));
-    return RPCExecute(&Request);
+    RPCSetResult(&Request, (const void*)&Package, sizeof(QueryFileStatsPackage_t));
+
+    // Execute the request
+    if (RPCExecute(&Request) != OsSuccess || Package.Code != FsOk) {
+        memset((void*)FileDescriptor, 0, sizeof(vFileDescriptor_t));
+        return OsError;
+    }
+    memcpy((void*)FileDescriptor, (const void*)&Package.Information, sizeof(vFileDescriptor_t));
+    return OsSuccess;
 }
 
 /* GetFileStatsByHandle 
@@ -744,14 +761,22 @@ GetFileStatsByHandle(
     _Out_ vFileDescriptor_t*    FileDescriptor)
 {
     // Variables
+    QueryFileStatsPackage_t Package;
     MRemoteCall_t Request;
 
     // Initialize the request
     RPCInitialize(&Request, __FILEMANAGER_TARGET, 
         __FILEMANAGER_INTERFACE_VERSION, __FILEMANAGER_GETSTATSBYHANDLE);
     RPCSetArgument(&Request, 0, (const void*)&Handle, sizeof(UUId_t));
-    RPCSetResult(&Request, (const void*)&FileDescriptor, sizeof(vFileDescriptor_t));
-    return RPCExecute(&Request);
+    RPCSetResult(&Request, (const void*)&Package, sizeof(QueryFileStatsPackage_t));
+
+    // Execute the request
+    if (RPCExecute(&Request) != OsSuccess || Package.Code != FsOk) {
+        memset((void*)FileDescriptor, 0, sizeof(vFileDescriptor_t));
+        return OsError;
+    }
+    memcpy((void*)FileDescriptor, (const void*)&Package.Information, sizeof(vFileDescriptor_t));
+    return OsSuccess;
 }
 
 #endif //!_FILE_INTERFACE_H_
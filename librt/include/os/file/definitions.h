@@ -24,6 +24,8 @@
 #ifndef _FILE_DEFINITIONS_H_
 #define _FILE_DEFINITIONS_H_
 
+#include <os/mollenos.h>
+
 /* Error Codes 
  * Used in standard VFS operations as return codes */
 typedef enum _FileSystemCode {
@@ -63,4 +65,16 @@ typedef enum _EnvironmentPath {
 	PathEnvironmentCount
 } EnvironmentPath_t;
 
+/* Directory Entry
+ * The layout of the entries returned by a directory read. Entries are packed back to
+ * back and each entry is <Length> bytes including the zero terminated name. <Position>
+ * can be given to SeekDirectory to continue the enumeration after the entry. */
+PACKED_TYPESTRUCT(DirectoryEntry, {
+	size_t					 Length;
+	int						 Position;
+	vFileDescriptor_t		 Information;
+	char					 Name[1];
+});
+#define DIRECTORY_ENTRY_LENGTH(NameLength)	((sizeof(DirectoryEntry_t) + (NameLength) + 7) & ~7)
+
 #endif //!_FILE_DEFINITIONS_H_
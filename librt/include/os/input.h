@@ -61,6 +61,41 @@ typedef struct _MInput {
 #define INPUT_BUTTON_CLICKED		0x1
 #define INPUT_KEYS_PACKED			0x2
 
+/* Batched input structure, contains all
+ * the input events generated by a single device
+ * report, so they can be delivered in one message */
+#define INPUT_BATCH_MAX_EVENTS		16
+typedef struct _MInputBatch {
+	size_t				Count;
+	MInput_t			Events[INPUT_BATCH_MAX_EVENTS];
+} MInputBatch_t;
+
+/* Window channel structure, shared between the window
+ * manager and the owner of a window. Input for the window is
+ * produced into the ring by the window manager, and it reports
+ * the sequence of the last present it has finished reading. If the
+ * owner is Waiting for a release, the release signal that was passed
+ * when creating the window is signalled */
+#define INPUT_RING_SIZE				64	/* Must be a power of two */
+typedef struct _MWindowChannel {
+	volatile unsigned	Released;
+	volatile unsigned	Waiting;
+	volatile size_t		Head;		/* Written by the window manager */
+	volatile size_t		Tail;		/* Written by the window owner */
+	volatile size_t		Dropped;
+	MInput_t			Events[INPUT_RING_SIZE];
+} MWindowChannel_t;
+
+_CODE_BEGIN
+/* UiReadInput
+ * Reads the next input event for the window from the shared event ring. This never
+ * blocks, OsError is returned if there are no pending events. */
+CRTDECL(
+OsStatus_t,
+UiReadInput(
+    _Out_ MInput_t*                 Input));
+_CODE_END
+
 /* CreateInput 
  * Creates a new input event with the given
  * type and flags. The event is either handled
@@ -78,4 +113,21 @@ CreateInput(MInput_t *Input)
 	return RPCEvent(&Request);
 }
 
+/* CreateInputBatch 
+ * Delivers a batch of input events in a single
+ * message, only the used events are transferred. */
+SERVICEAPI OsStatus_t SERVICEABI
+CreateInputBatch(MInputBatch_t *Batch)
+{
+	// Variables
+	MRemoteCall_t Request;
+	size_t Length = sizeof(MInputBatch_t) 
+		- ((INPUT_BATCH_MAX_EVENTS - Batch->Count) * sizeof(MInput_t));
+	
+	// Initialize rpc request
+	RPCInitialize(&Request, __WINDOWMANAGER_TARGET, __WINDOWMANAGER_INTERFACE_VERSION, __WINDOWMANAGER_NEWINPUTBATCH);
+	RPCSetArgument(&Request, 0, (const void*)Batch, Length);
+	return RPCEvent(&Request);
+}
+
 #endif //!_MOLLENOS_INPUT_H_
@@ -71,11 +71,32 @@ typedef struct _MCoreInterrupt {
     InterruptHandler_t		 FastHandler;
 	void					*Data;
 
+	// INTERRUPT_MSI - Message signaled interrupts are delivered to a single
+	// cpu, bit n allows the cpu with id n. 0 allows all cpus.
+	Flags_t					 AffinityMask;
+
 	// Read-Only
 	uintptr_t				 MsiAddress;	// INTERRUPT_MSI - The address of MSI
 	uintptr_t				 MsiValue;		// INTERRUPT_MSI - The value of MSI
+	UUId_t					 MsiCpu;		// INTERRUPT_MSI - The cpu that receives the interrupt
 } MCoreInterrupt_t;
 
+/* InterruptCoalescing
+ * Interrupt moderation policy for drivers. Completions are gathered until
+ * <Count> completions are pending or the oldest has waited <TimeoutUs>. When a
+ * single interrupt yields <PollThreshold> completions or more the driver keeps 
+ * polling, for at most <PollRounds> rounds, before waiting for interrupts again. 
+ * Zero disables the respective mechanism. */
+typedef struct _InterruptCoalescing {
+	size_t					 Count;
+	size_t					 TimeoutUs;
+	size_t					 PollThreshold;
+	size_t					 PollRounds;
+} InterruptCoalescing_t;
+
+#define INTERRUPT_COALESCING_INIT(Count, TimeoutUs, PollThreshold, PollRounds) \
+	{ Count, TimeoutUs, PollThreshold, PollRounds }
+
 /* RegisterInterruptSource 
  * Allocates the given interrupt source for use by
  * the requesting driver, an id for the interrupt source
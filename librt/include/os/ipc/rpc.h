@@ -216,6 +216,14 @@ OsStatus_t,
 RPCEvent(
     _In_ MRemoteCall_t *RemoteCall));
 
+/* RPCInherit
+ * Runs the calling thread at the priority of the sender of a message that
+ * was received by another thread. Pass NULL once the message is handled. */
+CRTDECL(
+OsStatus_t,
+RPCInherit(
+    _In_ MRemoteCallAddress_t*  RemoteAddress));
+
 /* RPCRespond
  * This is a wrapper to return a respond message/buffer to the
  * sender of the message, it's good practice to always wait for
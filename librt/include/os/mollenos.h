@@ -37,6 +37,7 @@
 #define MEMORY_READ                     0x00000020
 #define MEMORY_WRITE                    0x00000040
 #define MEMORY_EXECUTABLE               0x00000080
+#define MEMORY_RESERVE                  0x00000100  // Only reserve address space, commit with MemoryProtect
 
 /* Memory Descriptor
  * Describes the current memory state and setup
@@ -52,6 +53,12 @@ PACKED_TYPESTRUCT(MemoryDescriptor, {
  * Flags that can be used when requesting a flush of one of the hardware caches */
 #define CACHE_INSTRUCTION               1
 
+/* Profiler Control Definitions
+ * Commands that can be given to the system wide sampling profiler */
+#define PROFILER_STOP                   0
+#define PROFILER_START                  1
+#define PROFILER_RESET                  2
+
 _CODE_BEGIN
 /* MemoryAllocate
  * Allocates a chunk of memory, controlled by the
@@ -77,7 +84,7 @@ MemoryFree(
 
 /* MemoryProtect
  * Changes the protection flags of a previous memory allocation
- * made by MemoryAllocate */
+ * made by MemoryAllocate. Memory allocated with MEMORY_RESERVE is committed. */
 CRTDECL(
 OsStatus_t,
 MemoryProtect(
@@ -136,12 +143,42 @@ FlushHardwareCache(
     _In_Opt_ void*  Start, 
     _In_Opt_ size_t Length));
 
+/* ProfilerControl
+ * Starts, stops or resets the system wide sampling profiler. When starting, a sample
+ * is taken every <Interval> scheduler ticks on each core. */
+CRTDECL(
+OsStatus_t,
+ProfilerControl(
+    _In_ int        Command,
+    _In_ size_t     Interval));
+
+/* ProfilerRead
+ * Reads captured samples as symbolized folded stacks, one sample per line in the
+ * form 'process;outer;...;inner 1'. <BytesRead> is 0 when no samples are left. */
+CRTDECL(
+OsStatus_t,
+ProfilerRead(
+    _In_  char*     Buffer,
+    _In_  size_t    Length,
+    _Out_ size_t*   BytesRead));
+
 /*******************************************************************************
  * Threading Extensions
  *******************************************************************************/
 CRTDECL(OsStatus_t, SetCurrentThreadName(const char *ThreadName));
 CRTDECL(OsStatus_t, GetCurrentThreadName(char *ThreadNameBuffer, size_t MaxLength));
 
+/* SetCurrentThreadRealtime
+ * Moves the current thread into the fixed-priority real-time class, level 0 is the most
+ * urgent of the 8 levels. A negative level returns the thread to normal scheduling.
+ * Only servers, drivers and registered services are allowed to run real-time. */
+CRTDECL(OsStatus_t, SetCurrentThreadRealtime(int Level));
+
+/* GetConditionOwner
+ * Retrieves the process that created the given condition variable. Fails if the
+ * value is not a condition variable, so it can be used to validate shared handles. */
+CRTDECL(OsStatus_t, GetConditionOwner(uintptr_t Condition, UUId_t* ProcessId));
+
 /*******************************************************************************
  * Path Extensions
  *******************************************************************************/
@@ -88,7 +88,8 @@ typedef void*                       Handle_t;
  * from certain os-operations */
 typedef enum {
     OsSuccess,
-    OsError
+    OsError,
+    OsOutOfMemory
 } OsStatus_t;
 
 typedef enum {
@@ -0,0 +1,89 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS Shared System Page Definitions
+ * - The kernel maintains a single page of system information that is mapped
+ *   read-only into every process, so the clocks can be read without system calls.
+ */
+
+#ifndef _SHAREDPAGE_INTERFACE_H_
+#define _SHAREDPAGE_INTERFACE_H_
+
+#include <os/osdefs.h>
+
+#define SHAREDPAGE_VERSION              1
+
+/* Shared Page Flags
+ * Tells which parts of the shared page are valid, parts that are not valid must
+ * be retrieved through their system calls. */
+#define SHAREDPAGE_SYSTEMTICK           0x00000001  // SystemTick is valid
+#define SHAREDPAGE_WALLCLOCK            0x00000002  // WallClock and WallClockTick is valid
+#define SHAREDPAGE_PERFORMANCE          0x00000004  // PerformanceFrequency is valid
+#define SHAREDPAGE_TIMESTAMP            0x00000008  // Performance counter can be derived from the cpu timestamp
+
+/* SystemSharedPage
+ * The page is updated by the system timer under the sequence lock, <Sequence> is odd
+ * while an update is in progress. Readers must use the read helpers below. The
+ * performance counter is <PerformanceBase> + (timestamp - <TimestampBase>) * <TimestampScale>,
+ * where the scale is 32.32 fixed point performance ticks per timestamp tick. */
+typedef struct _SystemSharedPage {
+    atomic_uint             Sequence;
+    unsigned int            Version;
+    unsigned int            Flags;
+    unsigned int            NumberOfCores;
+
+    uint64_t                SystemTick;             // In CLOCKS_PER_SEC units since boot
+    int64_t                 WallClock;              // Seconds since epoch at <WallClockTick>
+    uint64_t                WallClockTick;
+
+    uint64_t                PerformanceFrequency;
+    uint64_t                PerformanceBase;
+    uint64_t                TimestampBase;
+    uint64_t                TimestampScale;
+} SystemSharedPage_t;
+
+/* GetSystemSharedPage
+ * Retrieves the shared system page of the process, returns NULL if the kernel
+ * did not provide one. */
+CRTDECL(
+SystemSharedPage_t*,
+GetSystemSharedPage(void));
+
+/* SharedPageReadBegin
+ * Starts reading the shared page, returns the sequence to validate the read with. */
+static inline unsigned int
+SharedPageReadBegin(
+    _In_ SystemSharedPage_t* Page)
+{
+    unsigned int Sequence;
+    while ((Sequence = atomic_load_explicit(&Page->Sequence, memory_order_acquire)) & 1) { }
+    return Sequence;
+}
+
+/* SharedPageReadRetry
+ * Returns non-zero if the page was updated while being read and the read must be redone. */
+static inline int
+SharedPageReadRetry(
+    _In_ SystemSharedPage_t* Page,
+    _In_ unsigned int        Sequence)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&Page->Sequence, memory_order_relaxed) != Sequence;
+}
+
+#endif //!_SHAREDPAGE_INTERFACE_H_
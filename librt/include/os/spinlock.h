@@ -29,14 +29,30 @@
 #include <os/osdefs.h>
 #include <threads.h>
 
+/* Spinlock Statistics
+ * Enable __OSCONFIG_SPINLOCK_STATISTICS to track contention and hold times
+ * of each spinlock. Hold times are in cpu timestamp ticks. */
+typedef struct _SpinlockStatistics {
+    size_t              Acquisitions;
+    size_t              Contentions;        // Acquisitions that had to wait
+    size_t              Polls;              // Times the lock was polled while waiting
+    uint64_t            HoldTimeTotal;
+    uint64_t            HoldTimeMax;
+} SpinlockStatistics_t;
+
 /* Spinlock Definitions
- * The definition of a spinlock handle used for primitive lock access */
+ * The definition of a spinlock handle used for primitive lock access. The lock
+ * is a ticket lock, so waiters acquire it in the order they arrived. */
 typedef struct _Spinlock {
-    int                 Value;
+    unsigned int        Value;              // Next ticket << 16 | Serving ticket
     UUId_t              Owner;
     int                 References;
+#ifdef __OSCONFIG_SPINLOCK_STATISTICS
+    uint64_t            AcquiredAt;
+    SpinlockStatistics_t Statistics;
+#endif
 } Spinlock_t;
-#define SPINLOCK_INIT   { 0 }
+#define SPINLOCK_INIT   { 0, UUID_INVALID, 0 }
 
 _CODE_BEGIN
 /* SpinlockReset
@@ -66,6 +82,15 @@ CRTDECL(
 OsStatus_t,
 SpinlockRelease(
 	_In_ Spinlock_t *Lock));
+
+/* SpinlockGetStatistics
+ * Retrieves a snapshot of the lock statistics, the snapshot is not taken under
+ * the lock. Fails if the statistics are not compiled in. */
+CRTDECL( 
+OsStatus_t,
+SpinlockGetStatistics(
+	_In_  Spinlock_t*           Lock,
+	_Out_ SpinlockStatistics_t* Statistics));
 _CODE_END
 
 #endif //!_SPINLOCK_INTERFACE_H_
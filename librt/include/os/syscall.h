@@ -77,6 +77,7 @@ _CODE_END
 #define Syscall_ThreadId() (UUId_t)syscall0(22)
 #define Syscall_ThreadSetCurrentName(Name) (UUId_t)syscall1(23, SCPARAM(Name))
 #define Syscall_ThreadGetCurrentName(NameBuffer, MaxLength) (UUId_t)syscall2(24, SCPARAM(NameBuffer), SCPARAM(MaxLength))
+#define Syscall_ThreadSetRealtime(Level) (OsStatus_t)syscall1(25, SCPARAM(Level))
 
 /* Condition system calls
  * - Condition related system call definitions */
@@ -85,6 +86,11 @@ _CODE_END
 #define Syscall_WaitForObject(Handle, Timeout) (OsStatus_t)syscall2(33, SCPARAM(Handle), SCPARAM(Timeout))
 #define Syscall_SignalHandle(Handle) (OsStatus_t)syscall1(34, SCPARAM(Handle))
 #define Syscall_BroadcastHandle(Handle) (OsStatus_t)syscall1(35, SCPARAM(Handle))
+#define Syscall_EventPortCreate(Handle) (OsStatus_t)syscall1(36, SCPARAM(Handle))
+#define Syscall_EventPortAttach(Handle, Source, SourceId, Events, Context) (OsStatus_t)syscall5(37, SCPARAM(Handle), SCPARAM(Source), SCPARAM(SourceId), SCPARAM(Events), SCPARAM(Context))
+#define Syscall_EventPortDetach(Handle, Source, SourceId) (OsStatus_t)syscall3(38, SCPARAM(Handle), SCPARAM(Source), SCPARAM(SourceId))
+#define Syscall_EventPortWait(Handle, Events, MaxEvents, Timeout, EventCount) (OsStatus_t)syscall5(39, SCPARAM(Handle), SCPARAM(Events), SCPARAM(MaxEvents), SCPARAM(Timeout), SCPARAM(EventCount))
+#define Syscall_ConditionGetOwner(Handle, Owner) (OsStatus_t)syscall2(40, SCPARAM(Handle), SCPARAM(Owner))
 
 /* Memory system calls
  * - Memory related system call definitions */
@@ -112,6 +118,7 @@ _CODE_END
 #define Syscall_PipeRead(Port, Buffer, Length) (OsStatus_t)syscall3(63, SCPARAM(Port), SCPARAM(Buffer), SCPARAM(Length))
 #define Syscall_PipeSend(ProcessId, Port, Buffer, Length) (OsStatus_t)syscall4(64, SCPARAM(ProcessId), SCPARAM(Port), SCPARAM(Buffer), SCPARAM(Length))
 #define Syscall_PipeReceive(ProcessId, Port, Buffer, Length) (OsStatus_t)syscall4(65, SCPARAM(ProcessId), SCPARAM(Port), SCPARAM(Buffer), SCPARAM(Length))
+#define Syscall_RemoteCallInherit(RemoteAddress) (OsStatus_t)syscall1(66, SCPARAM(RemoteAddress))
 #define Syscall_RemoteCall(RemoteCall, Asynchronous) (OsStatus_t)syscall2(67, SCPARAM(RemoteCall), SCPARAM(Asynchronous))
 #define Syscall_RpcGetResponse(RemoteCall) (OsStatus_t)syscall1(68, SCPARAM(RemoteCall))
 #define Syscall_RemoteCallWait(Port, RemoteCall, ArgumentBuffer) (OsStatus_t)syscall3(69, SCPARAM(Port), SCPARAM(RemoteCall), SCPARAM(ArgumentBuffer))
@@ -129,6 +136,7 @@ _CODE_END
 #define Syscall_SystemTime(Time) (OsStatus_t)syscall1(77, SCPARAM(Time))
 #define Syscall_DisplayInformation(Descriptor) (OsStatus_t)syscall1(78, SCPARAM(Descriptor))
 #define Syscall_CreateDisplayFramebuffer() (void*)syscall0(79)
+#define Syscall_SharedPage() (void*)syscall0(80)
 
 /* Driver system calls
  * - ACPI related system call definitions */
@@ -156,4 +164,9 @@ _CODE_END
 #define Syscall_TimerCreate(Interval, Periodic, Context) (UUId_t)syscall3(105, SCPARAM(Interval), SCPARAM(Periodic), SCPARAM(Context))
 #define Syscall_TimerStop(TimerId) (OsStatus_t)syscall1(106, SCPARAM(TimerId))
 
+/* System calls
+ * - Profiling related system call definitions */
+#define Syscall_ProfilerControl(Command, Interval) (OsStatus_t)syscall2(111, SCPARAM(Command), SCPARAM(Interval))
+#define Syscall_ProfilerRead(Buffer, Length, BytesRead) (OsStatus_t)syscall3(112, SCPARAM(Buffer), SCPARAM(Length), SCPARAM(BytesRead))
+
 #endif //!_SYSCALL_INTEFACE_H_
@@ -35,6 +35,28 @@
 typedef struct _ThreadPool ThreadPool_t;
 #define THREADPOOL_DEFAULT_WORKERS			-1 // Call this to initialize with default number of workers
 
+/* ThreadPoolFuture
+ * Completion handle for a single job. The structure is owned by the caller,
+ * and must stay valid until the job has completed. Initialize it with
+ * ThreadPoolFutureInitialize before handing it to the pool. */
+#define THREADPOOL_FUTURE_PENDING           0
+#define THREADPOOL_FUTURE_WAITING           1
+#define THREADPOOL_FUTURE_COMPLETE          2
+#define THREADPOOL_FUTURE_CANCELLED         3
+typedef struct _ThreadPoolFuture {
+    ThreadPool_t*       Pool;
+    _Atomic(int)        State;
+    int                 Result;
+} ThreadPoolFuture_t;
+
+/* ThreadPoolWorkItem
+ * Describes a single job for batched submission. Future is optional. */
+typedef struct _ThreadPoolWorkItem {
+    thrd_start_t        Function;
+    void*               Argument;
+    ThreadPoolFuture_t* Future;
+} ThreadPoolWorkItem_t;
+
 _CODE_BEGIN
 /* ThreadPoolInitialize 
  * Initializes a new thread-pool with the given number of threads */
@@ -55,6 +77,53 @@ ThreadPoolAddWork(
 	_In_ thrd_start_t Function,
 	_In_ void *Argument));
 
+/* ThreadPoolAddWorkEx
+ * Same as ThreadPoolAddWork, but the return value of the job is stored in the
+ * given future, which can be waited on with ThreadPoolFutureWait. */
+CRTDECL(
+OsStatus_t,
+ThreadPoolAddWorkEx(
+	_In_ ThreadPool_t *ThreadPool,
+	_In_ thrd_start_t Function,
+	_In_ void *Argument,
+	_In_ ThreadPoolFuture_t *Future));
+
+/* ThreadPoolAddWorkBatch
+ * Queues a number of jobs at once. This only wakes up the workers once
+ * for the entire batch instead of once per job. */
+CRTDECL(
+OsStatus_t,
+ThreadPoolAddWorkBatch(
+	_In_ ThreadPool_t *ThreadPool,
+	_In_ ThreadPoolWorkItem_t *Items,
+	_In_ size_t Count));
+
+/* ThreadPoolFutureInitialize
+ * Resets the future to the pending state, must be called before the future is
+ * passed to the threadpool. Futures can be reused once they have completed. */
+CRTDECL(
+void,
+ThreadPoolFutureInitialize(
+	_In_ ThreadPoolFuture_t *Future));
+
+/* ThreadPoolFutureIsComplete
+ * Returns 1 if the job attached to the future has finished executing (or was
+ * cancelled by ThreadPoolDestroy), otherwise 0. Never blocks. */
+CRTDECL(
+int,
+ThreadPoolFutureIsComplete(
+	_In_ ThreadPoolFuture_t *Future));
+
+/* ThreadPoolFutureWait
+ * Blocks until the job attached to the future has finished executing. The
+ * return value of the job is stored in Result if it is not NULL. Returns
+ * OsError if the job was cancelled before it could run. */
+CRTDECL(
+OsStatus_t,
+ThreadPoolFutureWait(
+	_In_  ThreadPoolFuture_t *Future,
+	_Out_ int *Result));
+
 /* ThreadPoolWait
  * Will wait for all jobs - both queued and currently running to finish.
  * Once the queue is empty and all work has completed, the calling thread
@@ -26,6 +26,12 @@
 #include <os/osdefs.h>
 #include <os/buffer.h>
 
+/* Window buffer and present limits
+ * A window buffer holds up to UI_MAX_BUFFERS surfaces back to back, and a
+ * single present can carry up to UI_MAX_DAMAGE_RECTS damaged regions. */
+#define UI_MAX_BUFFERS          3
+#define UI_MAX_DAMAGE_RECTS     16
+
 /* UISurfaceFormat 
  * Describes the types of pixel formats that are available
  * for surfaces */
@@ -47,8 +53,20 @@ typedef struct _UiSurfaceDescriptor {
 typedef struct _UiWindowParameters {
     UISurfaceDescriptor_t   Surface;
     unsigned                Flags;
+    int                     BufferCount;    // Surfaces in the window buffer
 } UIWindowParameters_t;
 
+/* UISwapParameters
+ * Describes a single present of one of the window surfaces. Only the damaged
+ * regions are read by the window manager, no regions means the entire surface.
+ * The sequence is reported back once the surface may be drawn to again. */
+typedef struct _UiSwapParameters {
+    int                     BufferIndex;
+    unsigned                Sequence;
+    size_t                  RectCount;
+    Rect_t                  Rects[UI_MAX_DAMAGE_RECTS];
+} UISwapParameters_t;
+
 _CODE_BEGIN
 /* UiParametersSetDefault
  * Set(s) default window parameters for the given window param structure. */
@@ -73,11 +91,30 @@ CRTDECL(
 OsStatus_t,
 UiUnregisterWindow(void));
 
+/* UiGetBackbuffer
+ * Retrieves the surface that should be drawn to next. This blocks until the window
+ * manager has released the surface from its last present. The age is the number of
+ * presents since the surface was last presented, or 0 if its contents are undefined. */
+CRTDECL(
+OsStatus_t,
+UiGetBackbuffer(
+    _Out_     void**                Surface,
+    _Out_Opt_ int*                  Age));
+
 /* UiSwapBackbuffer
  * Presents the current backbuffer and rendering all changes made to the window. */
 CRTDECL(
 OsStatus_t,
 UiSwapBackbuffer(void));
+
+/* UiSwapBackbufferRegions
+ * Presents the current backbuffer, but only the given regions are updated on screen.
+ * If there are more regions than UI_MAX_DAMAGE_RECTS the entire surface is presented. */
+CRTDECL(
+OsStatus_t,
+UiSwapBackbufferRegions(
+    _In_ const Rect_t*              Regions,
+    _In_ size_t                     RegionCount));
 _CODE_END
 
 #endif // !__USER_INTERFACE__
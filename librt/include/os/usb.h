@@ -84,13 +84,18 @@ PACKED_TYPESTRUCT(UsbHcEndpointDescriptor, {
 	size_t                              MaxPacketSize;
 	size_t                              Bandwidth;
 	size_t                              Interval;
+	size_t                              MaxBurst;       // SuperSpeed only
+	size_t                              MaxStreams;     // SuperSpeed bulk only
+	size_t                              Pipe;           // UAS pipe usage, 0 if none
 });
 
 /* UsbHcInterfaceVersion 
- * Describes a version of an interface and it's endpoint count. */
+ * Describes a version of an interface and it's endpoint count. Alternate
+ * settings may use a different protocol than the default setting. */
 PACKED_TYPESTRUCT(UsbHcInterfaceVersion, {
 	int                                 Id;
 	int                                 EndpointCount;
+	size_t                              Protocol;
 });
 
 /* UsbHcInterface 
@@ -193,7 +198,8 @@ typedef enum _UsbTransferStatus {
 	TransferInvalidToggles,
     TransferBufferError,
 	TransferNAK,
-	TransferBabble
+	TransferBabble,
+    TransferCancelled
 } UsbTransferStatus_t;
 
 /* UsbTransaction
@@ -221,6 +227,8 @@ PACKED_TYPESTRUCT(UsbTransfer, {
     UsbHcAddress_t                      Address;
     UsbTransaction_t                    Transactions[USB_TRANSACTIONCOUNT];
     int                                 TransactionCount;
+    uint8_t                             SetupPacket[8];     // Copy of the setup stage
+    uint16_t                            StreamId;           // Bulk streams, 0 if none
 
 	// Endpoint Information
 	UsbHcEndpointDescriptor_t           Endpoint;
@@ -277,11 +285,13 @@ UsbTransferInitialize(
 
 /* UsbTransferSetup 
  * Initializes a transfer for a control setup-transaction. 
- * If there is no data-stage then set Data members to 0. */
+ * If there is no data-stage then set Data members to 0. The setup packet
+ * is also copied into the transfer for controllers that need it inline. */
 __EXTERN
 OsStatus_t
 UsbTransferSetup(
     _In_ UsbTransfer_t*             Transfer,
+    _In_ const void*                SetupPacket,
     _In_ uintptr_t                  SetupAddress,
     _In_ uintptr_t                  DataAddress,
     _In_ size_t                     DataLength,
@@ -333,6 +343,17 @@ UsbTransferQueue(
 	_In_  UsbTransfer_t*            Transfer,
 	_Out_ UsbTransferResult_t*      Result);
 
+/* UsbTransferDequeue 
+ * Cancels a control or bulk transfer that is blocked in UsbTransferQueue, the
+ * transfer is matched by its address, stream and buffer. The blocked call then
+ * returns with TransferCancelled. Returns TransferFinished on success. */
+__EXTERN
+UsbTransferStatus_t
+UsbTransferDequeue(
+	_In_ UUId_t                     Driver,
+	_In_ UUId_t                     Device,
+	_In_ UsbTransfer_t*             Transfer);
+
 /* UsbTransferQueuePeriodic 
  * Queues a new Interrupt or Isochronous transfer. This transfer is 
  * persistant untill device is disconnected or Dequeue is called. 
@@ -144,6 +144,7 @@ PACKED_TYPESTRUCT(UsbPacket, {
 #define USB_DESCRIPTOR_DEV_CAPS         0x10
 #define USB_DESCRIPTOR_SS_EP_CPN        0x30
 #define USB_DESCRIPTOR_SS_ISO_EP_CPN    0x31
+#define USB_DESCRIPTOR_PIPE_USAGE       0x24    //UAS Pipe Usage (Class)
 
 /* UsbPacket Definitions
  * Contains the common feature code numbers */
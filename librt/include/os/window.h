@@ -43,15 +43,21 @@
 #define __WINDOWMANAGER_SWAPBUFFER          IPC_DECL_FUNCTION(2)
 #define __WINDOWMANAGER_QUERY               IPC_DECL_FUNCTION(3)
 #define __WINDOWMANAGER_NEWINPUT            IPC_DECL_FUNCTION(4)
+#define __WINDOWMANAGER_NEWINPUTBATCH       IPC_DECL_FUNCTION(5)
 
 /* CreateWindow 
  * Creates a window of the given dimensions and flags. The returned
  * value is the id of the newly created window. The handle is NULL on failure
- * or set to previous handle if a handle for this process already exists. */
+ * or set to previous handle if a handle for this process already exists. 
+ * The channel buffer is shared with the window manager for input and presents,
+ * and the release signal is a condition created by the caller that is signalled
+ * when a present has been released. */
 SERVICEAPI OsStatus_t SERVICEABI
 CreateWindow(
     _In_  UIWindowParameters_t* Params,
     _In_  UUId_t                BufferHandle,
+    _In_  UUId_t                ChannelHandle,
+    _In_  uintptr_t             ReleaseSignal,
     _Out_ Handle_t*             Handle)
 {
     // Variables
@@ -62,8 +68,10 @@ CreateWindow(
         __WINDOWMANAGER_INTERFACE_VERSION, __WINDOWMANAGER_CREATE);
 
     // Setup rpc arguments
-    RPCSetArgument(&Request, 0, (const void*)Params,        sizeof(UIWindowParameters_t));
-    RPCSetArgument(&Request, 1, (const void*)&BufferHandle, sizeof(UUId_t));
+    RPCSetArgument(&Request, 0, (const void*)Params,            sizeof(UIWindowParameters_t));
+    RPCSetArgument(&Request, 1, (const void*)&BufferHandle,     sizeof(UUId_t));
+    RPCSetArgument(&Request, 2, (const void*)&ChannelHandle,    sizeof(UUId_t));
+    RPCSetArgument(&Request, 3, (const void*)&ReleaseSignal,    sizeof(uintptr_t));
     RPCSetResult(&Request, (const void*)Handle, sizeof(Handle_t));
     return RPCExecute(&Request);
 }
@@ -106,21 +114,25 @@ QueryWindow(
 }
 
 /* SwapWindowBackbuffer
- * Invalidates the window and swaps the backbuffer with screen buffer
- * to render the changes made. */
+ * Invalidates the damaged regions of the window and presents the given
+ * surface to render the changes made. Only the used regions are transferred. */
 SERVICEAPI OsStatus_t SERVICEABI
 SwapWindowBackbuffer(
-    _In_ Handle_t Handle)
+    _In_ Handle_t                   Handle,
+    _In_ const UISwapParameters_t*  Parameters)
 {
     // Variables
     MRemoteCall_t Request;
+    size_t Length = sizeof(UISwapParameters_t) 
+        - ((UI_MAX_DAMAGE_RECTS - Parameters->RectCount) * sizeof(Rect_t));
 
     // Initialize rpc request
     RPCInitialize(&Request, __WINDOWMANAGER_TARGET, 
         __WINDOWMANAGER_INTERFACE_VERSION, __WINDOWMANAGER_SWAPBUFFER);
     
     // Setup rpc arguments
-    RPCSetArgument(&Request, 0, (const void*)&Handle, sizeof(Handle_t));
+    RPCSetArgument(&Request, 0, (const void*)&Handle,   sizeof(Handle_t));
+    RPCSetArgument(&Request, 1, (const void*)Parameters, Length);
     return RPCEvent(&Request);
 }
 
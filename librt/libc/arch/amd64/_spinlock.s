@@ -17,6 +17,9 @@
 ;
 ;
 ; MollenOS x86-64 Spinlock Code
+; The spinlock is a ticket lock, the low word of the lock value is the
+; ticket being served, and the high word is the next ticket to hand out.
+; Waiters are served in order and only read the lock while spinning.
 ;
 bits 64
 segment .text
@@ -25,66 +28,77 @@ segment .text
 global _spinlock_acquire
 global _spinlock_test
 global _spinlock_release
+global _spinlock_timestamp
 
 ; int spinlock_acquire(spinlock_t *spinlock)
-; We wait for the spinlock to become free
-; then set value to 1 to mark it in use.
+; We take the next ticket and wait for it to be served,
+; returns the number of times the lock was polled.
 _spinlock_acquire:
 	; Sanity
+	mov r8, 1
 	test rcx, rcx
 	je .gotlock
 
-	; We use this to test
-	mov rax, 1
-
-	; Try to get lock
-	.trylock:
-	xchg qword [rcx], rax
-	test rax, rax
-	je .gotlock
+	; Take a ticket, edx is our ticket and ax the one served
+	mov eax, 0x10000
+	lock xadd dword [rcx], eax
+	mov edx, eax
+	shr edx, 16
 
 	; Busy-wait loop
 	.lockloop:
+	cmp ax, dx
+	je .gotlock
 	pause
-	cmp qword [rcx], 0
-	jne .lockloop
-	jmp .trylock
+	inc r8
+	movzx eax, word [rcx]
+	jmp .lockloop
 
 	.gotlock:
-	mov rax, 1
+	mov rax, r8
 	ret
 
 ; int spinlock_test(spinlock_t *spinlock)
-; This tests whether or not spinlock is
-; set or not
+; This takes a ticket only if it would be
+; served immediately
 _spinlock_test:
 	; Get address of lock
-    mov rax, 0
 	test rcx, rcx
-	je .end
+	je .nolock
 
-	; We use this to test
-	mov rax, 1
+	; Is the next ticket the one being served?
+	mov eax, dword [rcx]
+	mov edx, eax
+	shr edx, 16
+	cmp ax, dx
+	jne .nolock
 
-	; Try to get lock
-	xchg qword [rcx], rax
-	test rax, rax
-	je .gotlock
+	; Try to take it
+	lea edx, [rax + 0x10000]
+	lock cmpxchg dword [rcx], edx
+	jne .nolock
+	mov rax, 1
+	ret
 
 	; nah, no lock for us
+	.nolock:
 	mov rax, 0
-	jmp .end
-	.gotlock:
-	mov rax, 1
-	.end:
 	ret
 
 
 ; void spinlock_release(spinlock_t *spinlock)
-; We set the spinlock to value 0
+; We serve the next ticket
 _spinlock_release:
 	test rcx, rcx
 	je .done
-	mov qword [rcx], 0
+	lock inc word [rcx]
 	.done:
-	ret
\ No newline at end of file
+	ret
+
+; uint64_t spinlock_timestamp(void)
+; Reads the timestamp counter for the lock statistics
+_spinlock_timestamp:
+	rdtsc
+	shl rdx, 32
+	or rax, rdx
+	ret
@@ -17,6 +17,9 @@
 ;
 ;
 ; MollenOS x86-32 Spinlock Code
+; The spinlock is a ticket lock, the low word of the lock value is the
+; ticket being served, and the high word is the next ticket to hand out.
+; Waiters are served in order and only read the lock while spinning.
 ;
 bits 32
 segment .text
@@ -25,10 +28,11 @@ segment .text
 global __spinlock_acquire
 global __spinlock_test
 global __spinlock_release
+global __spinlock_timestamp
 
 ; int spinlock_acquire(spinlock_t *spinlock)
-; We wait for the spinlock to become free
-; then set value to 1 to mark it in use.
+; We take the next ticket and wait for it to be served,
+; returns the number of times the lock was polled.
 __spinlock_acquire:
 	; Stack Frame
 	push ebp
@@ -39,37 +43,37 @@ __spinlock_acquire:
 
 	; Get address of lock
 	mov ebx, dword [ebp + 8]
+	mov ecx, 1
 
 	; Sanity
 	test ebx, ebx
 	je .gotlock
 
-	; We use this to test
-	mov eax, 1
-
-	; Try to get lock
-	.trylock:
-	xchg dword [ebx], eax
-	test eax, eax
-	je .gotlock
+	; Take a ticket, edx is our ticket and ax the one served
+	mov eax, 0x10000
+	lock xadd dword [ebx], eax
+	mov edx, eax
+	shr edx, 16
 
 	; Busy-wait loop
 	.lockloop:
+	cmp ax, dx
+	je .gotlock
 	pause
-	cmp dword [ebx], 0
-	jne .lockloop
-	jmp .trylock
+	inc ecx
+	movzx eax, word [ebx]
+	jmp .lockloop
 
 	.gotlock:
 	; Release stack frame
-	mov eax, 1
+	mov eax, ecx
 	pop ebx
 	pop ebp
 	ret
 
 ; int spinlock_test(spinlock_t *spinlock)
-; This tests whether or not spinlock is
-; set or not
+; This takes a ticket only if it would be
+; served immediately
 __spinlock_test:
 	; Stack Frame
 	push ebp
@@ -79,28 +83,29 @@ __spinlock_test:
 	push ebx
 
 	; Get address of lock
-    mov eax, 0
 	mov ebx, dword [ebp + 8]
 
 	; Sanity
 	test ebx, ebx
-	je .end
-
-	; We use this to test
+	je .nolock
+
+	; Is the next ticket the one being served?
+	mov eax, dword [ebx]
+	mov edx, eax
+	shr edx, 16
+	cmp ax, dx
+	jne .nolock
+
+	; Try to take it
+	lea edx, [eax + 0x10000]
+	lock cmpxchg dword [ebx], edx
+	jne .nolock
 	mov eax, 1
-
-	; Try to get lock
-	xchg dword [ebx], eax
-	test eax, eax
-	je .gotlock
+	jmp .end
 
 	; nah, no lock for us
+	.nolock:
 	mov eax, 0
-	jmp .end
-
-	.gotlock:
-	; Release stack frame
-	mov eax, 1
 
 	.end:
 	pop ebx
@@ -109,7 +114,7 @@ __spinlock_test:
 
 
 ; void spinlock_release(spinlock_t *spinlock)
-; We set the spinlock to value 0
+; We serve the next ticket
 __spinlock_release:
 	; Stack Frame
 	push ebp
@@ -125,11 +130,17 @@ __spinlock_release:
 	test ebx, ebx
 	je .done
 
-	; Ok, we assume valid pointer, set it to 0
-	mov dword [ebx], 0
+	; Only the served word is touched, the ticket word keeps counting
+	lock inc word [ebx]
 
 	; Release stack frame
 	.done:
 	pop ebx
 	pop ebp
-	ret
\ No newline at end of file
+	ret
+
+; uint64_t spinlock_timestamp(void)
+; Reads the timestamp counter for the lock statistics
+__spinlock_timestamp:
+	rdtsc
+	ret
@@ -0,0 +1,229 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - Message Signaled Interrupt Support
+ * - Allocates message signaled interrupts for a device and programs
+ *   the MSI or MSI-X capability of the device
+ */
+
+/* Includes
+ * - System */
+#include <os/driver.h>
+#include <os/device.h>
+#include <os/io.h>
+
+/* MSI Capability Layout
+ * The control register is shared, the location of the data
+ * register depends on whether or not the address is 64 bit */
+#define MSI_REGISTER_CONTROL            0x02
+#define MSI_REGISTER_ADDRESS_LOW        0x04
+#define MSI_REGISTER_ADDRESS_HIGH       0x08
+#define MSI_REGISTER_DATA_32            0x08
+#define MSI_REGISTER_DATA_64            0x0C
+
+#define MSI_CONTROL_ENABLE              0x0001
+#define MSI_CONTROL_MME_MASK            0x0070
+
+/* MSI-X Capability Layout
+ * The vector table lives in one of the memory io-spaces of the device */
+#define MSIX_CONTROL_MASKALL            0x4000
+#define MSIX_CONTROL_ENABLE             0x8000
+
+#define MSIX_ENTRY_SIZE                 16
+#define MSIX_ENTRY_ADDRESS_LOW          0x00
+#define MSIX_ENTRY_ADDRESS_HIGH         0x04
+#define MSIX_ENTRY_DATA                 0x08
+#define MSIX_ENTRY_CONTROL              0x0C
+#define MSIX_ENTRY_MASKED               0x00000001
+
+/* MsiReadConfig
+ * Reads a register from the configuration space of the device */
+static Flags_t
+MsiReadConfig(
+    _In_ MCoreDevice_t*     Device,
+    _In_ Flags_t            Register,
+    _In_ size_t             Width)
+{
+    // Variables
+    Flags_t Value = 0;
+    IoctlDeviceEx(Device->Id, 0, Register, &Value, Width);
+    return Value;
+}
+
+/* MsiWriteConfig
+ * Writes a register in the configuration space of the device */
+static void
+MsiWriteConfig(
+    _In_ MCoreDevice_t*     Device,
+    _In_ Flags_t            Register,
+    _In_ Flags_t            Value,
+    _In_ size_t             Width)
+{
+    IoctlDeviceEx(Device->Id, 1, Register, &Value, Width);
+}
+
+/* MsiGetTable
+ * Retrieves the io-space that contains the MSI-X vector table, and makes sure
+ * it's mapped. Returns NULL if the table is not accessible. */
+static DeviceIoSpace_t*
+MsiGetTable(
+    _In_ MCoreDevice_t*     Device)
+{
+    // Variables
+    DeviceIoSpace_t *IoSpace = NULL;
+
+    if (Device->Msi.TableBar < 0 || Device->Msi.TableBar >= __DEVICEMANAGER_MAX_IOSPACES) {
+        return NULL;
+    }
+    IoSpace = &Device->IoSpaces[Device->Msi.TableBar];
+    if (IoSpace->Type != IO_SPACE_MMIO
+        || (Device->Msi.TableOffset + (Device->Msi.Vectors * MSIX_ENTRY_SIZE)) > IoSpace->Size) {
+        return NULL;
+    }
+
+    // The table usually shares the io-space with the registers that the
+    // driver has already mapped, otherwise it stays mapped with the driver
+    if (IoSpace->VirtualBase == 0) {
+        if (CreateIoSpace(IoSpace) != OsSuccess || AcquireIoSpace(IoSpace) != OsSuccess) {
+            return NULL;
+        }
+    }
+    return IoSpace;
+}
+
+/* RegisterMsiInterrupts
+ * Allocates up to <Count> message signaled interrupts for the device and enables
+ * MSI-X (or MSI) delivery. The interrupts must have their handlers, data and affinity
+ * set up. The MSI-X table io-space is acquired if the driver has not already done so.
+ * Returns the number of vectors allocated, 0 means the legacy line must be used. */
+int
+RegisterMsiInterrupts(
+    _In_  MCoreDevice_t*    Device,
+    _In_  MCoreInterrupt_t* Interrupts,
+    _In_  int               Count,
+    _In_  Flags_t           Flags,
+    _Out_ UUId_t*           Ids)
+{
+    // Variables
+    DeviceIoSpace_t *Table  = NULL;
+    Flags_t Control         = 0;
+    int Allocated           = 0;
+    int i;
+
+    // Sanitize the device support
+    if (Device == NULL || Interrupts == NULL || Ids == NULL || Count <= 0
+        || Device->Msi.Type == __DEVICEMANAGER_MSI_NONE) {
+        return 0;
+    }
+
+    if (Device->Msi.Type == __DEVICEMANAGER_MSIX) {
+        Table = MsiGetTable(Device);
+        if (Table == NULL) {
+            return 0;
+        }
+    }
+    else {
+        Count = 1;
+    }
+    if (Count > Device->Msi.Vectors) {
+        Count = Device->Msi.Vectors;
+    }
+
+    // Allocate the vectors, they are never shared
+    for (i = 0; i < Count; i++) {
+        Ids[i] = RegisterInterruptSource(&Interrupts[i], Flags | INTERRUPT_MSI | INTERRUPT_NOTSHARABLE);
+        if (Ids[i] == UUID_INVALID) {
+            break;
+        }
+        Allocated++;
+    }
+    if (Allocated == 0) {
+        return 0;
+    }
+
+    Control = MsiReadConfig(Device, Device->Msi.Capability + MSI_REGISTER_CONTROL, 2);
+    if (Device->Msi.Type == __DEVICEMANAGER_MSIX) {
+        uintptr_t Base = Table->VirtualBase + Device->Msi.TableOffset;
+
+        // Keep the function masked while the table is updated
+        MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_CONTROL,
+            Control | MSIX_CONTROL_ENABLE | MSIX_CONTROL_MASKALL, 2);
+        for (i = 0; i < Device->Msi.Vectors; i++) {
+            volatile uint32_t *Entry = (volatile uint32_t*)(Base + (i * MSIX_ENTRY_SIZE));
+            Entry[MSIX_ENTRY_CONTROL / 4] |= MSIX_ENTRY_MASKED;
+            if (i < Allocated) {
+                Entry[MSIX_ENTRY_ADDRESS_LOW / 4]   = LODWORD(Interrupts[i].MsiAddress);
+                Entry[MSIX_ENTRY_ADDRESS_HIGH / 4]  = 0;
+                Entry[MSIX_ENTRY_DATA / 4]          = LODWORD(Interrupts[i].MsiValue);
+                Entry[MSIX_ENTRY_CONTROL / 4]       &= ~(MSIX_ENTRY_MASKED);
+            }
+        }
+        MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_CONTROL,
+            (Control | MSIX_CONTROL_ENABLE) & ~(MSIX_CONTROL_MASKALL), 2);
+    }
+    else {
+        MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_ADDRESS_LOW,
+            LODWORD(Interrupts[0].MsiAddress), 4);
+        if (Device->Msi.Is64Bit) {
+            MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_ADDRESS_HIGH, 0, 4);
+            MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_DATA_64,
+                LOWORD(Interrupts[0].MsiValue), 2);
+        }
+        else {
+            MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_DATA_32,
+                LOWORD(Interrupts[0].MsiValue), 2);
+        }
+        MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_CONTROL,
+            (Control & ~(MSI_CONTROL_MME_MASK)) | MSI_CONTROL_ENABLE, 2);
+    }
+    return Allocated;
+}
+
+/* UnregisterMsiInterrupts
+ * Disables message signaled interrupts for the device and releases the vectors */
+OsStatus_t
+UnregisterMsiInterrupts(
+    _In_ MCoreDevice_t*     Device,
+    _In_ UUId_t*            Ids,
+    _In_ int                Count)
+{
+    // Variables
+    Flags_t Control;
+    int i;
+
+    if (Device == NULL || Device->Msi.Type == __DEVICEMANAGER_MSI_NONE) {
+        return OsError;
+    }
+
+    // Stop the device from signaling before the vectors are released
+    Control = MsiReadConfig(Device, Device->Msi.Capability + MSI_REGISTER_CONTROL, 2);
+    if (Device->Msi.Type == __DEVICEMANAGER_MSIX) {
+        Control &= ~(MSIX_CONTROL_ENABLE);
+    }
+    else {
+        Control &= ~(MSI_CONTROL_ENABLE);
+    }
+    MsiWriteConfig(Device, Device->Msi.Capability + MSI_REGISTER_CONTROL, Control, 2);
+
+    for (i = 0; i < Count; i++) {
+        if (Ids[i] != UUID_INVALID) {
+            UnregisterInterruptSource(Ids[i]);
+        }
+    }
+    return OsSuccess;
+}
@@ -0,0 +1,91 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS Event Port Interface
+ * - Event ports allow a single thread to wait for many event sources at once.
+ */
+
+#include <os/eventport.h>
+#include <os/syscall.h>
+
+/* CreateEventPort
+ * Creates a new event port that no sources are attached to. */
+OsStatus_t
+CreateEventPort(
+    _Out_ UUId_t*           Port)
+{
+    if (Port == NULL) {
+        return OsError;
+    }
+    return Syscall_EventPortCreate(Port);
+}
+
+/* DestroyEventPort
+ * Destroys the event port, threads waiting on the port keep it alive until their wait returns. */
+OsStatus_t
+DestroyEventPort(
+    _In_ UUId_t             Port)
+{
+    return Syscall_DestroyHandle(Port);
+}
+
+/* AttachEventPort
+ * Attaches a source to the event port. <Events> selects which events of the source
+ * wakes the port, <Context> is returned with each event of the source. */
+OsStatus_t
+AttachEventPort(
+    _In_ UUId_t             Port,
+    _In_ int                Source,
+    _In_ UUId_t             SourceId,
+    _In_ Flags_t            Events,
+    _In_ void*              Context)
+{
+    if (Source < 0 || Source >= EVENTPORT_SOURCE_COUNT || Events == 0) {
+        return OsError;
+    }
+    return Syscall_EventPortAttach(Port, Source, SourceId, Events, Context);
+}
+
+/* DetachEventPort
+ * Detaches a source from the event port, pending events of the source are discarded. */
+OsStatus_t
+DetachEventPort(
+    _In_ UUId_t             Port,
+    _In_ int                Source,
+    _In_ UUId_t             SourceId)
+{
+    return Syscall_EventPortDetach(Port, Source, SourceId);
+}
+
+/* WaitForEventPort
+ * Waits for any attached source to become ready and returns up to <MaxEvents> ready
+ * sources. A <Timeout> of 0 waits indefinitely, if no sources became ready in time
+ * <EventCount> is set to 0. */
+OsStatus_t
+WaitForEventPort(
+    _In_  UUId_t            Port,
+    _In_  EventPortEvent_t* Events,
+    _In_  size_t            MaxEvents,
+    _In_  size_t            Timeout,
+    _Out_ size_t*           EventCount)
+{
+    if (Events == NULL || MaxEvents == 0 || EventCount == NULL) {
+        return OsError;
+    }
+    return Syscall_EventPortWait(Port, Events, MaxEvents, Timeout, EventCount);
+}
@@ -78,7 +78,7 @@ MemoryFree(
 
 /* MemoryProtect
  * Changes the protection flags of a previous memory allocation
- * made by MemoryAllocate */
+ * made by MemoryAllocate. Memory allocated with MEMORY_RESERVE is committed. */
 OsStatus_t
 MemoryProtect(
     _In_  void*     MemoryPointer,
@@ -85,6 +85,16 @@ RPCListen(
     return Syscall_RemoteCallWait(PIPE_REMOTECALL, Message, ArgumentBuffer);
 }
 
+/* RPCInherit
+ * Runs the calling thread at the priority of the sender of a message that
+ * was received by another thread. Pass NULL once the message is handled. */
+OsStatus_t
+RPCInherit(
+    _In_ MRemoteCallAddress_t*  RemoteAddress)
+{
+    return Syscall_RemoteCallInherit(RemoteAddress);
+}
+
 /* RPCRespond
  * This is a wrapper to return a respond message/buffer to the
  * sender of the message, it's good practice to always wait for
@@ -30,12 +30,52 @@
  * - Library */
 #include <assert.h>
 #include <stddef.h>
+#include <string.h>
 
 /* Externs
  * Access to platform specifics */
 __EXTERN int _spinlock_acquire(Spinlock_t *Spinlock);
 __EXTERN int _spinlock_test(Spinlock_t *Spinlock);
 __EXTERN void _spinlock_release(Spinlock_t *Spinlock);
+__EXTERN uint64_t _spinlock_timestamp(void);
+
+/* SpinlockAcquired
+ * Updates the statistics when the lock has been taken, <Polls> is the
+ * number of times the lock was polled before it was acquired. */
+static inline void
+SpinlockAcquired(
+    _In_ Spinlock_t*    Lock,
+    _In_ int            Polls)
+{
+#ifdef __OSCONFIG_SPINLOCK_STATISTICS
+    Lock->Statistics.Acquisitions++;
+    if (Polls > 1) {
+        Lock->Statistics.Contentions++;
+        Lock->Statistics.Polls += (size_t)(Polls - 1);
+    }
+    Lock->AcquiredAt = _spinlock_timestamp();
+#else
+    _CRT_UNUSED(Lock);
+    _CRT_UNUSED(Polls);
+#endif
+}
+
+/* SpinlockReleasing
+ * Updates the hold time statistics before the lock is released */
+static inline void
+SpinlockReleasing(
+    _In_ Spinlock_t*    Lock)
+{
+#ifdef __OSCONFIG_SPINLOCK_STATISTICS
+    uint64_t HoldTime = _spinlock_timestamp() - Lock->AcquiredAt;
+    Lock->Statistics.HoldTimeTotal += HoldTime;
+    if (HoldTime > Lock->Statistics.HoldTimeMax) {
+        Lock->Statistics.HoldTimeMax = HoldTime;
+    }
+#else
+    _CRT_UNUSED(Lock);
+#endif
+}
 
 /* SpinlockReset
  * This initializes a spinlock handle and sets it to default value (unlocked) */
@@ -47,6 +87,10 @@ SpinlockReset(
 	Lock->Value         = 0;
     Lock->References    = 0;
     Lock->Owner         = UUID_INVALID;
+#ifdef __OSCONFIG_SPINLOCK_STATISTICS
+    Lock->AcquiredAt    = 0;
+    memset(&Lock->Statistics, 0, sizeof(SpinlockStatistics_t));
+#endif
 	return OsSuccess;
 }
 
@@ -56,6 +100,8 @@ OsStatus_t
 SpinlockAcquire(
 	_In_ Spinlock_t *Lock)
 {
+    // Variables
+    int Polls;
     assert(Lock != NULL);
 
     // Reentrancy
@@ -65,9 +111,11 @@ SpinlockAcquire(
     }
 
     // Value is updated by _acquire
-	if (!_spinlock_acquire(Lock)) {
+    Polls = _spinlock_acquire(Lock);
+	if (!Polls) {
         return OsError;
     }
+    SpinlockAcquired(Lock, Polls);
     Lock->Owner         = thrd_current();
     Lock->References    = 1;
     return OsSuccess;
@@ -91,6 +139,7 @@ SpinlockTryAcquire(
 	if (!_spinlock_test(Lock)) {
         return OsError;
     }
+    SpinlockAcquired(Lock, 1);
     Lock->Owner         = thrd_current();
     Lock->References    = 1;
     return OsSuccess;
@@ -108,7 +157,27 @@ SpinlockRelease(
     Lock->References--;
     if (Lock->References == 0) {
         Lock->Owner = UUID_INVALID;
+        SpinlockReleasing(Lock);
         _spinlock_release(Lock);
     }
 	return OsSuccess;
 }
+
+/* SpinlockGetStatistics
+ * Retrieves a snapshot of the lock statistics, the snapshot is not taken under
+ * the lock. Fails if the statistics are not compiled in. */
+OsStatus_t
+SpinlockGetStatistics(
+	_In_  Spinlock_t*           Lock,
+	_Out_ SpinlockStatistics_t* Statistics)
+{
+    assert(Lock != NULL);
+    assert(Statistics != NULL);
+#ifdef __OSCONFIG_SPINLOCK_STATISTICS
+    memcpy(Statistics, &Lock->Statistics, sizeof(SpinlockStatistics_t));
+    return OsSuccess;
+#else
+    memset(Statistics, 0, sizeof(SpinlockStatistics_t));
+    return OsError;
+#endif
+}
@@ -22,6 +22,7 @@
 /* Includes 
  * - System */
 #include <os/contracts/video.h>
+#include <os/sharedpage.h>
 #include <os/mollenos.h>
 #include <os/syscall.h>
 #include <os/utils.h>
@@ -35,6 +36,26 @@
 /* Const Message */
 const char *__SysTypeMessage = "LIBC";
 
+/* Shared system page, queried on first use */
+static SystemSharedPage_t *SharedPage   = NULL;
+static atomic_int SharedPageQueried     = ATOMIC_VAR_INIT(0);
+
+/* GetSystemSharedPage
+ * Retrieves the shared system page of the process, returns NULL if the kernel
+ * did not provide one. */
+SystemSharedPage_t*
+GetSystemSharedPage(void)
+{
+    if (!atomic_load_explicit(&SharedPageQueried, memory_order_acquire)) {
+        SharedPage = (SystemSharedPage_t*)Syscall_SharedPage();
+        if (SharedPage != NULL && SharedPage->Version != SHAREDPAGE_VERSION) {
+            SharedPage = NULL;
+        }
+        atomic_store_explicit(&SharedPageQueried, 1, memory_order_release);
+    }
+    return SharedPage;
+}
+
 /* SystemDebug 
  * Debug/trace printing for userspace application and drivers */
 void
@@ -90,7 +111,19 @@ SystemTime(
  * if a system timer has been initialized. */
 OsStatus_t
 SystemTick(
-	_Out_ clock_t *clock) {
+	_Out_ clock_t *clock)
+{
+    // Variables
+    SystemSharedPage_t *Page = GetSystemSharedPage();
+    unsigned int Sequence;
+
+    if (Page != NULL && (Page->Flags & SHAREDPAGE_SYSTEMTICK)) {
+        do {
+            Sequence    = SharedPageReadBegin(Page);
+            *clock      = (clock_t)Page->SystemTick;
+        } while (SharedPageReadRetry(Page, Sequence));
+        return OsSuccess;
+    }
     return Syscall_SystemTick(clock);
 }
 
@@ -99,7 +132,19 @@ SystemTick(
  * second, the value will never be 0 */
 OsStatus_t
 QueryPerformanceFrequency(
-	_Out_ LargeInteger_t *Frequency) {
+	_Out_ LargeInteger_t *Frequency)
+{
+    // Variables
+    SystemSharedPage_t *Page = GetSystemSharedPage();
+    unsigned int Sequence;
+
+    if (Page != NULL && (Page->Flags & SHAREDPAGE_PERFORMANCE)) {
+        do {
+            Sequence            = SharedPageReadBegin(Page);
+            Frequency->QuadPart = (int64_t)Page->PerformanceFrequency;
+        } while (SharedPageReadRetry(Page, Sequence));
+        return OsSuccess;
+    }
     return Syscall_SystemPerformanceFrequency(Frequency);
 }
 
@@ -108,7 +153,31 @@ QueryPerformanceFrequency(
  * information in the given structure */
 OsStatus_t
 QueryPerformanceTimer(
-	_Out_ LargeInteger_t *Value) {
+	_Out_ LargeInteger_t *Value)
+{
+#if defined(i386) || defined(__i386__) || defined(amd64) || defined(__amd64__)
+    // Variables
+    SystemSharedPage_t *Page = GetSystemSharedPage();
+    uint64_t Base, Timestamp, Scale, Delta;
+    unsigned int Sequence;
+
+    // The counter is derived from the cpu timestamp, the scale is 32.32 fixed point
+    if (Page != NULL && (Page->Flags & SHAREDPAGE_TIMESTAMP)) {
+        do {
+            Sequence    = SharedPageReadBegin(Page);
+            Base        = Page->PerformanceBase;
+            Timestamp   = Page->TimestampBase;
+            Scale       = Page->TimestampScale;
+            Delta       = __builtin_ia32_rdtsc();
+        } while (SharedPageReadRetry(Page, Sequence));
+
+        // Cores can be slightly behind the core that updated the page
+        Delta           = (Delta > Timestamp) ? (Delta - Timestamp) : 0;
+        Value->QuadPart = (int64_t)(Base + ((Delta >> 32) * Scale) 
+            + (((Delta & 0xFFFFFFFF) * Scale) >> 32));
+        return OsSuccess;
+    }
+#endif
     return Syscall_SystemPerformanceTime(Value);
 }
 
@@ -122,3 +191,24 @@ FlushHardwareCache(
     _In_Opt_ size_t Length) {
     return Syscall_FlushHardwareCache(Cache, Start, Length);
 }
+
+/* ProfilerControl
+ * Starts, stops or resets the system wide sampling profiler. When starting, a sample
+ * is taken every <Interval> scheduler ticks on each core. */
+OsStatus_t
+ProfilerControl(
+    _In_ int        Command,
+    _In_ size_t     Interval) {
+    return Syscall_ProfilerControl(Command, Interval);
+}
+
+/* ProfilerRead
+ * Reads captured samples as symbolized folded stacks, one sample per line in the
+ * form 'process;outer;...;inner 1'. <BytesRead> is 0 when no samples are left. */
+OsStatus_t
+ProfilerRead(
+    _In_  char*     Buffer,
+    _In_  size_t    Length,
+    _Out_ size_t*   BytesRead) {
+    return Syscall_ProfilerRead(Buffer, Length, BytesRead);
+}
@@ -19,198 +19,434 @@
  * MollenOS MCore - Threading Pool Support Definitions & Structures
  * - This header describes the base threadingpool-structures, prototypes
  *   and functionality, refer to the individual things for descriptions
+ * - Each worker owns a Chase-Lev deque, jobs queued from a worker go to its
+ *   own deque, jobs queued from outside go through a bounded lock-free
+ *   injection queue. Idle workers steal from each other before parking.
  */
 
-#include <os/binarysemaphore.h>
 #include <os/threadpool.h>
 #include <os/utils.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 
+/* ThreadPool Tuning
+ * Sizes must be powers of two. Jobs that do not fit in a deque or in the
+ * injection queue spill over into a locked list, so these are not hard limits. */
+#define THREADPOOL_DEQUE_SIZE           256
+#define THREADPOOL_INJECT_SIZE          1024
+#define THREADPOOL_JOB_POOLSIZE         1024
+#define THREADPOOL_JOB_CACHESIZE        32
+#define THREADPOOL_SPIN_COUNT           32
+
 /* ThreadPoolJob (Private)
- * Describes a linked list of jobs for threads to execute */
+ * Describes a single job for threads to execute. Jobs are allocated from a
+ * per-pool array, and only from the heap if that array is exhausted. */
 typedef struct _ThreadPoolJob {
-    struct _ThreadPoolJob*  Previous;
+    struct _ThreadPoolJob*  Link;
+    _Atomic(unsigned)       NextFree;
+    int                     Pooled;
     thrd_start_t            Function;
     void*                   Argument;
+    ThreadPoolFuture_t*     Future;
 } ThreadPoolJob_t;
 
-/* ThreadPoolJobQueue (Private)
- * Contains a list of job entries (ThreadPoolJob), and keeps
- * the synchronization between retrieving and adding */
-typedef struct _ThreadPoolJobQueue {
-    mtx_t               Lock;
-    ThreadPoolJob_t*    Head;
-    ThreadPoolJob_t*    Tail;
-    BinarySemaphore_t*  HasJobs;
-    int                 Length;
-} ThreadPoolJobQueue_t;
-
-/* ThreadPoolThread (Private) 
+/* ThreadPoolDeque (Private)
+ * Fixed size Chase-Lev work-stealing deque. The owner pushes and pops at the
+ * bottom, thieves take from the top. Indices are free running and compared
+ * by their signed distance so they can wrap safely. */
+typedef struct _ThreadPoolDeque {
+    _Atomic(unsigned)           Top;
+    _Atomic(unsigned)           Bottom;
+    _Atomic(ThreadPoolJob_t*)   Jobs[THREADPOOL_DEQUE_SIZE];
+} ThreadPoolDeque_t;
+
+/* ThreadPoolInjectQueue (Private)
+ * Bounded multi-producer/multi-consumer queue for jobs that are submitted
+ * by threads outside the pool. Each cell carries a sequence number that
+ * tells producers and consumers whether it's their turn. */
+typedef struct _ThreadPoolInjectCell {
+    _Atomic(unsigned)       Sequence;
+    ThreadPoolJob_t*        Job;
+} ThreadPoolInjectCell_t;
+
+typedef struct _ThreadPoolInjectQueue {
+    _Atomic(unsigned)       EnqueuePosition;
+    _Atomic(unsigned)       DequeuePosition;
+    ThreadPoolInjectCell_t  Cells[THREADPOOL_INJECT_SIZE];
+
+    // Overflow list when the ring is full
+    mtx_t                   OverflowLock;
+    _Atomic(int)            OverflowCount;
+    ThreadPoolJob_t*        OverflowHead;
+    ThreadPoolJob_t*        OverflowTail;
+} ThreadPoolInjectQueue_t;
+
+/* ThreadPoolThread (Private)
  * Contains the thread information and some extra information */
 typedef struct _ThreadPoolThread {
     int                 Id;
     thrd_t              Thread;
     ThreadPool_t*       Pool;
+    unsigned            Seed;
+    ThreadPoolDeque_t   Deque;
+
+    // Job nodes released by this worker
+    ThreadPoolJob_t*    Cache[THREADPOOL_JOB_CACHESIZE];
+    int                 CacheCount;
 } ThreadPoolThread_t;
 
-/* ThreadPool (Private) 
+/* ThreadPool (Private)
  * Contains all the neccessary information about the threadpool
  * and it's locks/threads/jobs */
 typedef struct _ThreadPool {
-    volatile int            ThreadsAlive;
-    volatile int            ThreadsWorking;
-    volatile int            ThreadsKeepAlive;
+    _Atomic(int)            ThreadsAlive;
+    _Atomic(int)            ThreadsWorking;
+    _Atomic(int)            ThreadsKeepAlive;
     volatile sig_atomic_t   ThreadsOnHold;
+    int                     ThreadCount;
 
-    // Resources
+    // Jobs that are either queued or running
+    _Atomic(size_t)         JobsPending;
     mtx_t                   ThreadLock;
     cnd_t                   ThreadsIdle;
+
+    // Parking, workers only sleep on SleepSignal while Epoch is unchanged
+    _Atomic(unsigned)       Epoch;
+    _Atomic(int)            Sleepers;
+    mtx_t                   SleepLock;
+    cnd_t                   SleepSignal;
+
+    // Futures with sleeping waiters are woken through this
+    mtx_t                   FutureLock;
+    cnd_t                   FutureSignal;
+
+    // Job nodes, free-list head is (tag << 32 | index + 1)
+    ThreadPoolJob_t*        JobNodes;
+    _Atomic(uint64_t)       JobFreeList;
+
+    // Resources
     ThreadPoolThread_t**    Threads;
-    ThreadPoolJobQueue_t    JobQueue;
+    ThreadPoolInjectQueue_t Inject;
 } ThreadPool_t;
 
 /* Globals
  * Keeps volatile/static information related to state */
 static tss_t __GlbThreadPoolKey = TSS_KEY_INVALID;
 
-/* JobQueueInitialize
- * Allocates resources and initializes the job-queue */
-OsStatus_t
-JobQueueInitialize(
-    _In_ ThreadPoolJobQueue_t *JobQueue)
+/* JobAllocate
+ * Retrieves a free job node, the calling worker's own cache is tried first,
+ * then the pool's shared free-list and finally the heap. */
+static ThreadPoolJob_t*
+JobAllocate(
+    _In_ ThreadPool_t*          Pool,
+    _In_ ThreadPoolThread_t*    Worker)
 {
-    // Sanitize
-    if (JobQueue == NULL) {
-        return OsError;
+    // Variables
+    ThreadPoolJob_t *Job;
+    uint64_t Head, Update;
+
+    if (Worker != NULL && Worker->CacheCount != 0) {
+        return Worker->Cache[--Worker->CacheCount];
     }
 
-    // Reset members
-    JobQueue->Length = 0;
-    JobQueue->Head = NULL;
-    JobQueue->Tail = NULL;
+    Head = atomic_load_explicit(&Pool->JobFreeList, memory_order_acquire);
+    while ((uint32_t)Head != 0) {
+        Job     = &Pool->JobNodes[(uint32_t)Head - 1];
+        Update  = (((Head >> 32) + 1) << 32)
+            | atomic_load_explicit(&Job->NextFree, memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&Pool->JobFreeList, &Head, Update,
+            memory_order_acquire, memory_order_acquire)) {
+            return Job;
+        }
+    }
 
-    // Allocate a new lock
-    JobQueue->HasJobs = (BinarySemaphore_t*)malloc(sizeof(BinarySemaphore_t));
-    mtx_init(&JobQueue->Lock, mtx_plain);
-    BinarySemaphoreConstruct(JobQueue->HasJobs, 0);
-    return OsSuccess;
+    // Pool is exhausted
+    Job = (ThreadPoolJob_t*)malloc(sizeof(ThreadPoolJob_t));
+    if (Job != NULL) {
+        Job->Pooled = 0;
+    }
+    return Job;
 }
 
-/* JobQueuePush
- * Adds a new job to the end of the queue, the job will be executed
- * as fast as possible. */
-OsStatus_t
-JobQueuePush(
-    _In_ ThreadPoolJobQueue_t*  JobQueue,
+/* JobRelease
+ * Returns a job node to where it came from */
+static void
+JobRelease(
+    _In_ ThreadPool_t*          Pool,
+    _In_ ThreadPoolThread_t*    Worker,
     _In_ ThreadPoolJob_t*       Job)
 {
-    // Sanitize
-    if (JobQueue == NULL) {
-        return OsError;
-    }
-
-    // Acquire lock and reset previous
-    mtx_lock(&JobQueue->Lock);
-    Job->Previous = NULL;
+    // Variables
+    uint64_t Head, Update;
+    unsigned Index;
 
-    // Either add to start or end
-    if (JobQueue->Length == 0) {
-        JobQueue->Head = Job;
-        JobQueue->Tail = Job;
+    if (!Job->Pooled) {
+        free(Job);
+        return;
     }
-    else {
-        JobQueue->Tail->Previous = Job;
-        JobQueue->Tail = Job;
+
+    if (Worker != NULL && Worker->CacheCount < THREADPOOL_JOB_CACHESIZE) {
+        Worker->Cache[Worker->CacheCount++] = Job;
+        return;
     }
 
-    // Increase length
-    JobQueue->Length++;
+    Index   = (unsigned)(Job - Pool->JobNodes) + 1;
+    Head    = atomic_load_explicit(&Pool->JobFreeList, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&Job->NextFree, (uint32_t)Head, memory_order_relaxed);
+        Update = (((Head >> 32) + 1) << 32) | Index;
+    } while (!atomic_compare_exchange_weak_explicit(&Pool->JobFreeList, &Head, Update,
+        memory_order_release, memory_order_relaxed));
+}
 
-    // Notify threads
-    BinarySemaphorePost(JobQueue->HasJobs);
-    return mtx_unlock(&JobQueue->Lock);
+/* DequePush
+ * Pushes a job at the bottom of the deque, only the owner may call this.
+ * Returns OsError if the deque is full. */
+static OsStatus_t
+DequePush(
+    _In_ ThreadPoolDeque_t* Deque,
+    _In_ ThreadPoolJob_t*   Job)
+{
+    // Variables
+    unsigned Bottom = atomic_load_explicit(&Deque->Bottom, memory_order_relaxed);
+    unsigned Top    = atomic_load_explicit(&Deque->Top, memory_order_acquire);
+
+    if ((int)(Bottom - Top) >= THREADPOOL_DEQUE_SIZE) {
+        return OsError;
+    }
+    atomic_store_explicit(&Deque->Jobs[Bottom & (THREADPOOL_DEQUE_SIZE - 1)],
+        Job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&Deque->Bottom, Bottom + 1, memory_order_relaxed);
+    return OsSuccess;
 }
 
-/* JobQueuePull
- * Get first job from queue and removes it from the job-queue
- * The caller must hold a mutex */
-ThreadPoolJob_t*
-JobQueuePull(
-    _In_ ThreadPoolJobQueue_t *JobQueue)
+/* DequePop
+ * Pops a job from the bottom of the deque, only the owner may call this. */
+static ThreadPoolJob_t*
+DequePop(
+    _In_ ThreadPoolDeque_t* Deque)
 {
     // Variables
     ThreadPoolJob_t *Job = NULL;
+    unsigned Bottom, Top;
+
+    Bottom = atomic_load_explicit(&Deque->Bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&Deque->Bottom, Bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    Top = atomic_load_explicit(&Deque->Top, memory_order_relaxed);
+
+    if ((int)(Bottom - Top) >= 0) {
+        Job = atomic_load_explicit(&Deque->Jobs[Bottom & (THREADPOOL_DEQUE_SIZE - 1)],
+            memory_order_relaxed);
+        if (Bottom == Top) {
+            // Last job, race against thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&Deque->Top, &Top, Top + 1,
+                memory_order_seq_cst, memory_order_relaxed)) {
+                Job = NULL;
+            }
+            atomic_store_explicit(&Deque->Bottom, Bottom + 1, memory_order_relaxed);
+        }
+    }
+    else {
+        atomic_store_explicit(&Deque->Bottom, Bottom + 1, memory_order_relaxed);
+    }
+    return Job;
+}
 
-    // Sanitize
-    if (JobQueue == NULL) {
-        return NULL;
+/* DequeSteal
+ * Takes a job from the top of the deque, may be called by any thread.
+ * Returns NULL if the deque is empty or if the race for the job was lost. */
+static ThreadPoolJob_t*
+DequeSteal(
+    _In_ ThreadPoolDeque_t* Deque)
+{
+    // Variables
+    ThreadPoolJob_t *Job = NULL;
+    unsigned Bottom, Top;
+
+    Top = atomic_load_explicit(&Deque->Top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    Bottom = atomic_load_explicit(&Deque->Bottom, memory_order_acquire);
+
+    if ((int)(Bottom - Top) > 0) {
+        Job = atomic_load_explicit(&Deque->Jobs[Top & (THREADPOOL_DEQUE_SIZE - 1)],
+            memory_order_relaxed);
+        if (!atomic_compare_exchange_strong_explicit(&Deque->Top, &Top, Top + 1,
+            memory_order_seq_cst, memory_order_relaxed)) {
+            return NULL;
+        }
     }
+    return Job;
+}
 
-    // Acquire lock and reset previous
-    mtx_lock(&JobQueue->Lock);
-    Job = JobQueue->Head;
+/* InjectInitialize
+ * Resets the injection queue, all cells start out free */
+static void
+InjectInitialize(
+    _In_ ThreadPoolInjectQueue_t* Queue)
+{
+    // Variables
+    unsigned i;
 
-    // On pull we have three different cases
-    // Either it's empty, return null
-    // If there is one job, clear head/tail
-    // If more, get head and notify
-    if (JobQueue->Length == 0) {
-        // Do nothing
-    }
-    else if (JobQueue->Length == 1) {
-        JobQueue->Head = NULL;
-        JobQueue->Tail = NULL;
-        JobQueue->Length--;
+    for (i = 0; i < THREADPOOL_INJECT_SIZE; i++) {
+        atomic_store_explicit(&Queue->Cells[i].Sequence, i, memory_order_relaxed);
     }
-    else {
-        JobQueue->Head = Job->Previous;
-        JobQueue->Length--;
+    atomic_store(&Queue->EnqueuePosition, 0);
+    atomic_store(&Queue->DequeuePosition, 0);
+    atomic_store(&Queue->OverflowCount, 0);
+    Queue->OverflowHead = NULL;
+    Queue->OverflowTail = NULL;
+    mtx_init(&Queue->OverflowLock, mtx_plain);
+}
 
-        // Update that we still have jobs
-        BinarySemaphorePost(JobQueue->HasJobs);
+/* InjectPush
+ * Adds a job to the injection queue, may be called by any thread */
+static void
+InjectPush(
+    _In_ ThreadPoolInjectQueue_t*   Queue,
+    _In_ ThreadPoolJob_t*           Job)
+{
+    // Variables
+    ThreadPoolInjectCell_t *Cell;
+    unsigned Position, Sequence;
+    int Difference;
+
+    Position = atomic_load_explicit(&Queue->EnqueuePosition, memory_order_relaxed);
+    for (;;) {
+        Cell        = &Queue->Cells[Position & (THREADPOOL_INJECT_SIZE - 1)];
+        Sequence    = atomic_load_explicit(&Cell->Sequence, memory_order_acquire);
+        Difference  = (int)(Sequence - Position);
+        if (Difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&Queue->EnqueuePosition,
+                &Position, Position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (Difference < 0) {
+            // Ring is full, spill into the overflow list
+            Job->Link = NULL;
+            mtx_lock(&Queue->OverflowLock);
+            if (Queue->OverflowTail != NULL) {
+                Queue->OverflowTail->Link = Job;
+            }
+            else {
+                Queue->OverflowHead = Job;
+            }
+            Queue->OverflowTail = Job;
+            atomic_fetch_add(&Queue->OverflowCount, 1);
+            mtx_unlock(&Queue->OverflowLock);
+            return;
+        }
+        else {
+            Position = atomic_load_explicit(&Queue->EnqueuePosition, memory_order_relaxed);
+        }
     }
+    Cell->Job = Job;
+    atomic_store_explicit(&Cell->Sequence, Position + 1, memory_order_release);
+}
 
-    // Unlock and return the job
-    mtx_unlock(&JobQueue->Lock);
+/* InjectPop
+ * Retrieves the next job from the injection queue, may be called by any thread */
+static ThreadPoolJob_t*
+InjectPop(
+    _In_ ThreadPoolInjectQueue_t* Queue)
+{
+    // Variables
+    ThreadPoolInjectCell_t *Cell;
+    ThreadPoolJob_t *Job = NULL;
+    unsigned Position, Sequence;
+    int Difference;
+
+    Position = atomic_load_explicit(&Queue->DequeuePosition, memory_order_relaxed);
+    for (;;) {
+        Cell        = &Queue->Cells[Position & (THREADPOOL_INJECT_SIZE - 1)];
+        Sequence    = atomic_load_explicit(&Cell->Sequence, memory_order_acquire);
+        Difference  = (int)(Sequence - (Position + 1));
+        if (Difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&Queue->DequeuePosition,
+                &Position, Position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (Difference < 0) {
+            // Ring is empty, check the overflow list
+            if (atomic_load(&Queue->OverflowCount) != 0) {
+                mtx_lock(&Queue->OverflowLock);
+                Job = Queue->OverflowHead;
+                if (Job != NULL) {
+                    Queue->OverflowHead = Job->Link;
+                    if (Queue->OverflowHead == NULL) {
+                        Queue->OverflowTail = NULL;
+                    }
+                    atomic_fetch_sub(&Queue->OverflowCount, 1);
+                }
+                mtx_unlock(&Queue->OverflowLock);
+            }
+            return Job;
+        }
+        else {
+            Position = atomic_load_explicit(&Queue->DequeuePosition, memory_order_relaxed);
+        }
+    }
+    Job = Cell->Job;
+    atomic_store_explicit(&Cell->Sequence, Position + THREADPOOL_INJECT_SIZE,
+        memory_order_release);
     return Job;
 }
 
-/* JobQueueClear
- * Clears the job-queue and resets it's members. Also frees
- * any resources associated with the jobs */
-OsStatus_t
-JobQueueClear(
-    _In_ ThreadPoolJobQueue_t *JobQueue)
+/* ThreadPoolNotify
+ * Publishes new work to parked workers. This is only a single atomic increment
+ * unless workers are actually sleeping. */
+static void
+ThreadPoolNotify(
+    _In_ ThreadPool_t*  Pool,
+    _In_ size_t         Count)
 {
-    // Sanitize
-    if (JobQueue == NULL) {
-        return OsError;
+    atomic_fetch_add(&Pool->Epoch, 1);
+    if (atomic_load(&Pool->Sleepers) != 0) {
+        mtx_lock(&Pool->SleepLock);
+        if (Count > 1) {
+            cnd_broadcast(&Pool->SleepSignal);
+        }
+        else {
+            cnd_signal(&Pool->SleepSignal);
+        }
+        mtx_unlock(&Pool->SleepLock);
     }
+}
 
-    // Iterate and free jobs
-    while (JobQueue->Length) {
-        free(JobQueuePull(JobQueue));
+/* ThreadPoolFutureComplete
+ * Stores the result in the future and wakes anyone that sleeps on it */
+static void
+ThreadPoolFutureComplete(
+    _In_ ThreadPool_t*          Pool,
+    _In_ ThreadPoolFuture_t*    Future,
+    _In_ int                    Result,
+    _In_ int                    State)
+{
+    Future->Result = Result;
+    if (atomic_exchange(&Future->State, State) == THREADPOOL_FUTURE_WAITING) {
+        mtx_lock(&Pool->FutureLock);
+        cnd_broadcast(&Pool->FutureSignal);
+        mtx_unlock(&Pool->FutureLock);
     }
-
-    // Reset members
-    JobQueue->Head = NULL;
-    JobQueue->Tail = NULL;
-    BinarySemaphoreReset(JobQueue->HasJobs);
-    JobQueue->Length = 0;
-    return OsSuccess;
 }
 
-/* JobQueueDestroy
- * Free all queue resources back to the system and clears the queue */
-void
-JobQueueDestroy(
-    _In_ ThreadPoolJobQueue_t *JobQueue)
+/* ThreadPoolJobDone
+ * Must be called once for every job that leaves the pool, executed or not */
+static void
+ThreadPoolJobDone(
+    _In_ ThreadPool_t*  Pool,
+    _In_ size_t         Count)
 {
-    // Clear queue, then cleanup
-    JobQueueClear(JobQueue);
-    free(JobQueue->HasJobs);
+    if (atomic_fetch_sub(&Pool->JobsPending, Count) == Count) {
+        mtx_lock(&Pool->ThreadLock);
+        cnd_broadcast(&Pool->ThreadsIdle);
+        mtx_unlock(&Pool->ThreadLock);
+    }
 }
 
 /* ThreadPoolThreadHold
@@ -219,77 +455,143 @@ void
 ThreadPoolThreadHold(
     _In_ int                    SignalCode)
 {
-    // Variables 
-    ThreadPool_t *Tp = NULL;
+    // Variables
+    ThreadPoolThread_t *Worker = NULL;
     _CRT_UNUSED(SignalCode);
 
-    // Extract pool from tls
-    Tp = (ThreadPool_t*)tss_get(__GlbThreadPoolKey);
-    if (Tp != NULL) {
-        Tp->ThreadsOnHold = 1;
-        while (Tp->ThreadsOnHold) {
+    // Extract worker from tls
+    Worker = (ThreadPoolThread_t*)tss_get(__GlbThreadPoolKey);
+    if (Worker != NULL) {
+        Worker->Pool->ThreadsOnHold = 1;
+        while (Worker->Pool->ThreadsOnHold) {
             thrd_sleepex(1);
         }
     }
 }
 
+/* ThreadPoolFindJob
+ * Looks for work in the order own deque, injection queue and then the
+ * deques of the other workers starting at a random victim. */
+static ThreadPoolJob_t*
+ThreadPoolFindJob(
+    _In_ ThreadPoolThread_t*    Worker)
+{
+    // Variables
+    ThreadPool_t *Pool = Worker->Pool;
+    ThreadPoolJob_t *Job;
+    int Victim, i;
+
+    Job = DequePop(&Worker->Deque);
+    if (Job == NULL) {
+        Job = InjectPop(&Pool->Inject);
+    }
+    if (Job == NULL && Pool->ThreadCount > 1) {
+        Worker->Seed ^= Worker->Seed << 13;
+        Worker->Seed ^= Worker->Seed >> 17;
+        Worker->Seed ^= Worker->Seed << 5;
+        Victim = (int)(Worker->Seed % (unsigned)Pool->ThreadCount);
+        for (i = 0; i < Pool->ThreadCount && Job == NULL; i++) {
+            if (Pool->Threads[Victim] != Worker) {
+                Job = DequeSteal(&Pool->Threads[Victim]->Deque);
+            }
+            if (++Victim == Pool->ThreadCount) {
+                Victim = 0;
+            }
+        }
+    }
+    return Job;
+}
+
+/* ThreadPoolPark
+ * Puts the worker to sleep until new work is published. Work is checked
+ * once more after registering as a sleeper so no wakeup is lost. */
+static ThreadPoolJob_t*
+ThreadPoolPark(
+    _In_ ThreadPoolThread_t*    Worker)
+{
+    // Variables
+    ThreadPool_t *Pool = Worker->Pool;
+    ThreadPoolJob_t *Job;
+    unsigned Key;
+
+    Key = atomic_load(&Pool->Epoch);
+    atomic_fetch_add(&Pool->Sleepers, 1);
+    Job = ThreadPoolFindJob(Worker);
+    if (Job == NULL) {
+        mtx_lock(&Pool->SleepLock);
+        while (atomic_load(&Pool->Epoch) == Key && atomic_load(&Pool->ThreadsKeepAlive)) {
+            cnd_wait(&Pool->SleepSignal, &Pool->SleepLock);
+        }
+        mtx_unlock(&Pool->SleepLock);
+    }
+    atomic_fetch_sub(&Pool->Sleepers, 1);
+    return Job;
+}
+
 /* ThreadPoolThreadLoop
  * The primary loop of each thread */
 int
 ThreadPoolThreadLoop(
     _In_ void*                  Argument)
 {
-    ThreadPoolThread_t* Thread;
+    // Variables
+    ThreadPoolThread_t *Worker;
+    ThreadPoolFuture_t *Future;
     ThreadPoolJob_t *Job;
+    thrd_start_t Function;
     ThreadPool_t *Pool;
+    void *JobArgument;
+    int Result, i;
 
     // Instantiate the pointers
-    Thread  = (ThreadPoolThread_t*)Argument;
-    Pool    = Thread->Pool;
+    Worker  = (ThreadPoolThread_t*)Argument;
+    Pool    = Worker->Pool;
 
-    // Update tls and store the pool
-    tss_set(__GlbThreadPoolKey, Pool);
+    // Update tls and store the worker
+    tss_set(__GlbThreadPoolKey, Worker);
 
     // Update signal handler for this thread
     signal(SIGUSR1, ThreadPoolThreadHold);
 
     // Enter job-queue loop
-    Pool->ThreadsAlive++;
-    while (Pool->ThreadsKeepAlive) {
-        BinarySemaphoreWait(Pool->JobQueue.HasJobs);
-
-        // Make sure we check it again after wake-up
-        if (Pool->ThreadsKeepAlive) {
-            // Increase thread-working count
-            Pool->ThreadsWorking++;
-
-            // Get next job and execute
-            Job = JobQueuePull(&Pool->JobQueue);
-            if (Job != NULL) {
-                Job->Function(Job->Argument);
-                free(Job);
+    atomic_fetch_add(&Pool->ThreadsAlive, 1);
+    while (atomic_load(&Pool->ThreadsKeepAlive)) {
+        Job = ThreadPoolFindJob(Worker);
+        for (i = 0; i < THREADPOOL_SPIN_COUNT && Job == NULL; i++) {
+            thrd_yield();
+            Job = ThreadPoolFindJob(Worker);
+        }
+        if (Job == NULL) {
+            Job = ThreadPoolPark(Worker);
+            if (Job == NULL) {
+                continue;
             }
+        }
 
-            // Decrease thread-working count
-            mtx_lock(&Pool->ThreadLock);
-            Pool->ThreadsWorking--;
-
-            // If none are working anymore, signal all idle
-            if (!Pool->ThreadsWorking) {
-                cnd_signal(&Pool->ThreadsIdle);
-            }
-            mtx_unlock(&Pool->ThreadLock);
+        // Release the node before running, so it can be reused by
+        // jobs that are queued while this one executes
+        Function    = Job->Function;
+        JobArgument = Job->Argument;
+        Future      = Job->Future;
+        JobRelease(Pool, Worker, Job);
+
+        atomic_fetch_add(&Pool->ThreadsWorking, 1);
+        Result = Function(JobArgument);
+        if (Future != NULL) {
+            ThreadPoolFutureComplete(Pool, Future, Result, THREADPOOL_FUTURE_COMPLETE);
         }
+        atomic_fetch_sub(&Pool->ThreadsWorking, 1);
+        ThreadPoolJobDone(Pool, 1);
     }
 
     // Decrease thread-live count
-    Pool->ThreadsAlive--;
+    atomic_fetch_sub(&Pool->ThreadsAlive, 1);
     return 0;
 }
 
 /* ThreadPoolInitializeThread
- * Initialize a thread in the thread pool */
-int 
+ * Allocates and resets a worker of the thread pool, it is started later */
+int
 ThreadPoolInitializeThread(
     _In_ ThreadPool_t*          ThreadPool,
     _In_ ThreadPoolThread_t**   Thread,
@@ -297,9 +599,14 @@ ThreadPoolInitializeThread(
 {
     // Allocate a new instance of a thread
     *Thread = (ThreadPoolThread_t*)malloc(sizeof(ThreadPoolThread_t));
+    if (*Thread == NULL) {
+        return thrd_nomem;
+    }
+    memset(*Thread, 0, sizeof(ThreadPoolThread_t));
     (*Thread)->Id   = Id;
     (*Thread)->Pool = ThreadPool;
-    return thrd_create(&(*Thread)->Thread, ThreadPoolThreadLoop, *Thread);
+    (*Thread)->Seed = 0x9E3779B9U * (unsigned)(Id + 1);
+    return thrd_success;
 }
 
 /* ThreadPoolThreadDestroy
@@ -312,19 +619,59 @@ ThreadPoolThreadDestroy(
     free(Thread);
 }
 
-/* ThreadPoolInitialize 
+/* ThreadPoolInitializeUnwind
+ * Tears down a partially initialized thread-pool. The first Started workers
+ * are running and are stopped, the first Allocated workers are freed. */
+static void
+ThreadPoolInitializeUnwind(
+    _In_ ThreadPool_t*          Instance,
+    _In_ int                    Allocated,
+    _In_ int                    Started)
+{
+    // Variables
+    int i;
+
+    // Stop the workers that did start, no jobs have been queued yet
+    if (Started != 0) {
+        atomic_store(&Instance->ThreadsKeepAlive, 0);
+        mtx_lock(&Instance->SleepLock);
+        atomic_fetch_add(&Instance->Epoch, 1);
+        cnd_broadcast(&Instance->SleepSignal);
+        mtx_unlock(&Instance->SleepLock);
+        for (i = 0; i < Started; i++) {
+            thrd_join(Instance->Threads[i]->Thread, NULL);
+        }
+    }
+    for (i = 0; i < Allocated; i++) {
+        ThreadPoolThreadDestroy(Instance->Threads[i]);
+    }
+
+    mtx_destroy(&Instance->Inject.OverflowLock);
+    mtx_destroy(&Instance->ThreadLock);
+    cnd_destroy(&Instance->ThreadsIdle);
+    mtx_destroy(&Instance->SleepLock);
+    cnd_destroy(&Instance->SleepSignal);
+    mtx_destroy(&Instance->FutureLock);
+    cnd_destroy(&Instance->FutureSignal);
+    free(Instance->Threads);
+    free(Instance->JobNodes);
+    free(Instance);
+}
+
+/* ThreadPoolInitialize
  * Initializes a new thread-pool with the given number of threads */
 OsStatus_t
 ThreadPoolInitialize(
     _In_  int                   NumThreads,
     _Out_ ThreadPool_t**        ThreadPool)
 {
+    // Variables
     ThreadPool_t *Instance;
     int i;
 
     // Trace
     TRACE("ThreadPoolInitialize(%i)", NumThreads);
-    
+
     // Handle thread count
     if (NumThreads == THREADPOOL_DEFAULT_WORKERS) {
         NumThreads = 2;
@@ -332,7 +679,7 @@ ThreadPoolInitialize(
     }
 
     // Sanitize parameters
-    if (ThreadPool == NULL || NumThreads < 0) {
+    if (ThreadPool == NULL || NumThreads <= 0) {
         ERROR("Invalid parameters");
         return OsError;
     }
@@ -344,35 +691,141 @@ ThreadPoolInitialize(
 
     // Allocate a new instance of threadpool
     Instance = (ThreadPool_t*)malloc(sizeof(ThreadPool_t));
+    if (Instance == NULL) {
+        return OsError;
+    }
     memset((void*)Instance, 0, sizeof(ThreadPool_t));
-    Instance->ThreadsKeepAlive = 1;
+    atomic_store(&Instance->ThreadsKeepAlive, 1);
+    Instance->ThreadCount = NumThreads;
 
-    // Initialize job queue
-    if (JobQueueInitialize(&Instance->JobQueue) != OsSuccess) {
+    // Initialize the job nodes, chain them all in the free-list
+    Instance->JobNodes = (ThreadPoolJob_t*)malloc(
+        THREADPOOL_JOB_POOLSIZE * sizeof(ThreadPoolJob_t));
+    if (Instance->JobNodes == NULL) {
         free(Instance);
         return OsError;
     }
-
-    // Initialize the list of threads
-    Instance->Threads = (ThreadPoolThread_t**)malloc(NumThreads * sizeof(ThreadPoolThread_t*));
+    for (i = 0; i < THREADPOOL_JOB_POOLSIZE; i++) {
+        Instance->JobNodes[i].Pooled = 1;
+        atomic_store_explicit(&Instance->JobNodes[i].NextFree,
+            (i + 1 < THREADPOOL_JOB_POOLSIZE) ? (unsigned)(i + 2) : 0, memory_order_relaxed);
+    }
+    atomic_store(&Instance->JobFreeList, 1);
+    InjectInitialize(&Instance->Inject);
 
     // Initialize locks
     cnd_init(&Instance->ThreadsIdle);
     mtx_init(&Instance->ThreadLock, mtx_plain);
+    cnd_init(&Instance->SleepSignal);
+    mtx_init(&Instance->SleepLock, mtx_plain);
+    cnd_init(&Instance->FutureSignal);
+    mtx_init(&Instance->FutureLock, mtx_plain);
+
+    // Initialize the list of threads, all workers must exist before
+    // any of them starts as they steal from each other
+    Instance->Threads = (ThreadPoolThread_t**)malloc(NumThreads * sizeof(ThreadPoolThread_t*));
+    if (Instance->Threads == NULL) {
+        ThreadPoolInitializeUnwind(Instance, 0, 0);
+        return OsError;
+    }
+    for (i = 0; i < NumThreads; i++) {
+        if (ThreadPoolInitializeThread(Instance, &Instance->Threads[i], i) != thrd_success) {
+            ERROR("Failed to allocate worker %i", i);
+            ThreadPoolInitializeUnwind(Instance, i, 0);
+            return OsError;
+        }
+    }
 
     // Spawn threads
     for (i = 0; i < NumThreads; i++) {
-        ThreadPoolInitializeThread(Instance, &Instance->Threads[i], i);
+        if (thrd_create(&Instance->Threads[i]->Thread, ThreadPoolThreadLoop,
+                Instance->Threads[i]) != thrd_success) {
+            ERROR("Failed to spawn worker %i", i);
+            ThreadPoolInitializeUnwind(Instance, NumThreads, i);
+            return OsError;
+        }
     }
 
     // Wait for all threads to spin-up
-    while (Instance->ThreadsAlive != NumThreads);
+    while (atomic_load(&Instance->ThreadsAlive) != NumThreads) {
+        thrd_yield();
+    }
     *ThreadPool = Instance;
     return OsSuccess;
 }
 
+/* ThreadPoolAddWorkBatch
+ * Queues a number of jobs at once. This only wakes up the workers once
+ * for the entire batch instead of once per job. */
+OsStatus_t
+ThreadPoolAddWorkBatch(
+    _In_ ThreadPool_t*          ThreadPool,
+    _In_ ThreadPoolWorkItem_t*  Items,
+    _In_ size_t                 Count)
+{
+    // Variables
+    ThreadPoolThread_t *Worker;
+    ThreadPoolJob_t *Job;
+    size_t i;
+
+    // Sanitize parameters
+    if (ThreadPool == NULL || Items == NULL || Count == 0) {
+        return OsError;
+    }
+
+    // Jobs queued from our own workers go to their deque
+    Worker = (ThreadPoolThread_t*)tss_get(__GlbThreadPoolKey);
+    if (Worker != NULL && Worker->Pool != ThreadPool) {
+        Worker = NULL;
+    }
+
+    // Account for the jobs before they become visible, so
+    // ThreadPoolWait can't observe a false idle pool
+    atomic_fetch_add(&ThreadPool->JobsPending, Count);
+    for (i = 0; i < Count; i++) {
+        Job = JobAllocate(ThreadPool, Worker);
+        if (Job == NULL) {
+            ThreadPoolJobDone(ThreadPool, Count - i);
+            if (i != 0) {
+                ThreadPoolNotify(ThreadPool, i);
+            }
+            return OsError;
+        }
+        Job->Function   = Items[i].Function;
+        Job->Argument   = Items[i].Argument;
+        Job->Future     = Items[i].Future;
+        if (Job->Future != NULL) {
+            Job->Future->Pool = ThreadPool;
+        }
+        if (Worker == NULL || DequePush(&Worker->Deque, Job) != OsSuccess) {
+            InjectPush(&ThreadPool->Inject, Job);
+        }
+    }
+    ThreadPoolNotify(ThreadPool, Count);
+    return OsSuccess;
+}
+
+/* ThreadPoolAddWorkEx
+ * Same as ThreadPoolAddWork, but the return value of the job is stored in the
+ * given future, which can be waited on with ThreadPoolFutureWait. */
+OsStatus_t
+ThreadPoolAddWorkEx(
+    _In_ ThreadPool_t*          ThreadPool,
+    _In_ thrd_start_t           Function,
+    _In_ void*                  Argument,
+    _In_ ThreadPoolFuture_t*    Future)
+{
+    // Variables
+    ThreadPoolWorkItem_t Item;
+
+    Item.Function   = Function;
+    Item.Argument   = Argument;
+    Item.Future     = Future;
+    return ThreadPoolAddWorkBatch(ThreadPool, &Item, 1);
+}
+
 /* ThreadPoolAddWork
- * Takes an action and its argument and adds it to the threadpool's job queue. 
+ * Takes an action and its argument and adds it to the threadpool's job queue.
  * If you want to add to work a function with more than one arguments then
  * a way to implement this is by passing a pointer to a structure. */
 OsStatus_t
@@ -380,20 +833,70 @@ ThreadPoolAddWork(
     _In_ ThreadPool_t*          ThreadPool,
     _In_ thrd_start_t           Function,
     _In_ void*                  Argument)
+{
+    return ThreadPoolAddWorkEx(ThreadPool, Function, Argument, NULL);
+}
+
+/* ThreadPoolFutureInitialize
+ * Resets the future to the pending state, must be called before the future is
+ * passed to the threadpool. Futures can be reused once they have completed. */
+void
+ThreadPoolFutureInitialize(
+    _In_ ThreadPoolFuture_t*    Future)
+{
+    Future->Pool    = NULL;
+    Future->Result  = 0;
+    atomic_store(&Future->State, THREADPOOL_FUTURE_PENDING);
+}
+
+/* ThreadPoolFutureIsComplete
+ * Returns 1 if the job attached to the future has finished executing (or was
+ * cancelled by ThreadPoolDestroy), otherwise 0. Never blocks. */
+int
+ThreadPoolFutureIsComplete(
+    _In_ ThreadPoolFuture_t*    Future)
+{
+    return atomic_load(&Future->State) >= THREADPOOL_FUTURE_COMPLETE;
+}
+
+/* ThreadPoolFutureWait
+ * Blocks until the job attached to the future has finished executing. The
+ * return value of the job is stored in Result if it is not NULL. Returns
+ * OsError if the job was cancelled before it could run. */
+OsStatus_t
+ThreadPoolFutureWait(
+    _In_  ThreadPoolFuture_t*   Future,
+    _Out_ int*                  Result)
 {
     // Variables
-    ThreadPoolJob_t *Job = NULL;
+    ThreadPool_t *Pool;
+    int State;
 
-    // Sanitize parameters
-    if (ThreadPool == NULL) {
+    if (Future == NULL) {
         return OsError;
     }
 
-    // Allocate a new instance of the thread job
-    Job = (ThreadPoolJob_t*)malloc(sizeof(ThreadPoolJob_t));
-    Job->Function = Function;
-    Job->Argument = Argument;
-    return JobQueuePush(&ThreadPool->JobQueue, Job);
+    State = atomic_load(&Future->State);
+    if (State < THREADPOOL_FUTURE_COMPLETE) {
+        Pool = Future->Pool;
+        if (Pool == NULL) {
+            return OsError;
+        }
+
+        // Announce that we sleep, the completer then takes the lock
+        mtx_lock(&Pool->FutureLock);
+        State = THREADPOOL_FUTURE_PENDING;
+        atomic_compare_exchange_strong(&Future->State, &State, THREADPOOL_FUTURE_WAITING);
+        while ((State = atomic_load(&Future->State)) < THREADPOOL_FUTURE_COMPLETE) {
+            cnd_wait(&Pool->FutureSignal, &Pool->FutureLock);
+        }
+        mtx_unlock(&Pool->FutureLock);
+    }
+
+    if (Result != NULL) {
+        *Result = Future->Result;
+    }
+    return (State == THREADPOOL_FUTURE_COMPLETE) ? OsSuccess : OsError;
 }
 
 /* ThreadPoolWait
@@ -412,7 +915,7 @@ ThreadPoolWait(
     mtx_lock(&ThreadPool->ThreadLock);
 
     // Now wait for all threads
-    while (ThreadPool->JobQueue.Length || ThreadPool->ThreadsWorking) {
+    while (atomic_load(&ThreadPool->JobsPending) != 0) {
         cnd_wait(&ThreadPool->ThreadsIdle, &ThreadPool->ThreadLock);
     }
 
@@ -437,7 +940,7 @@ ThreadPoolPause(
     }
 
     // Iterate and pause threads
-    for (i = 0; i < ThreadPool->ThreadsAlive; i++) {
+    for (i = 0; i < ThreadPool->ThreadCount; i++) {
         thrd_signal(ThreadPool->Threads[i]->Thread, SIGUSR1);
     }
     return OsSuccess;
@@ -457,6 +960,20 @@ ThreadPoolResume(
     return OsSuccess;
 }
 
+/* ThreadPoolCancelJob
+ * Drops a job that never got to run, its future is marked cancelled */
+static void
+ThreadPoolCancelJob(
+    _In_ ThreadPool_t*          ThreadPool,
+    _In_ ThreadPoolJob_t*       Job)
+{
+    if (Job->Future != NULL) {
+        ThreadPoolFutureComplete(ThreadPool, Job->Future, -1, THREADPOOL_FUTURE_CANCELLED);
+    }
+    JobRelease(ThreadPool, NULL, Job);
+    ThreadPoolJobDone(ThreadPool, 1);
+}
+
 /* ThreadPoolDestroy
  * This will wait for the currently active threads to finish and then 'kill'
  * the whole threadpool to free up memory. */
@@ -465,10 +982,7 @@ ThreadPoolDestroy(
     _In_ ThreadPool_t*          ThreadPool)
 {
     // Variables
-    volatile int ThreadsTotal;
-    double TimeOut      = 1.0;
-    double TimePassed   = 0.0;
-    time_t Start, End;
+    ThreadPoolJob_t *Job;
     int i;
 
     // Sanitize the parameters
@@ -476,31 +990,39 @@ ThreadPoolDestroy(
         return OsError;
     }
 
-    // Store information and end infinite loop
-    ThreadsTotal                    = ThreadPool->ThreadsAlive;
-    ThreadPool->ThreadsKeepAlive    = 0;
-
-    // Give it a second to shut-down threads
-    time(&Start);
-    while (TimePassed < TimeOut && ThreadPool->ThreadsAlive) {
-        BinarySemaphorePostAll(ThreadPool->JobQueue.HasJobs);
-        time(&End);
-        TimePassed = difftime(End, Start);
-    }
-
-    // Wait for remaining threads to shut-down
-    while (ThreadPool->ThreadsAlive) {
-        BinarySemaphorePostAll(ThreadPool->JobQueue.HasJobs);
-        thrd_sleepex(1);
+    // End the infinite loop and wake up everyone
+    atomic_store(&ThreadPool->ThreadsKeepAlive, 0);
+    ThreadPool->ThreadsOnHold = 0;
+    mtx_lock(&ThreadPool->SleepLock);
+    atomic_fetch_add(&ThreadPool->Epoch, 1);
+    cnd_broadcast(&ThreadPool->SleepSignal);
+    mtx_unlock(&ThreadPool->SleepLock);
+
+    // Wait for threads to shut-down
+    for (i = 0; i < ThreadPool->ThreadCount; i++) {
+        thrd_join(ThreadPool->Threads[i]->Thread, NULL);
     }
 
-    // Cleanup job-queue
-    JobQueueDestroy(&ThreadPool->JobQueue);
-    for (i = 0; i < ThreadsTotal; i++) {
+    // Cancel anything that is left in the queues
+    for (i = 0; i < ThreadPool->ThreadCount; i++) {
+        while ((Job = DequePop(&ThreadPool->Threads[i]->Deque)) != NULL) {
+            ThreadPoolCancelJob(ThreadPool, Job);
+        }
         ThreadPoolThreadDestroy(ThreadPool->Threads[i]);
     }
+    while ((Job = InjectPop(&ThreadPool->Inject)) != NULL) {
+        ThreadPoolCancelJob(ThreadPool, Job);
+    }
 
     // Cleanup
+    mtx_destroy(&ThreadPool->Inject.OverflowLock);
+    mtx_destroy(&ThreadPool->ThreadLock);
+    cnd_destroy(&ThreadPool->ThreadsIdle);
+    mtx_destroy(&ThreadPool->SleepLock);
+    cnd_destroy(&ThreadPool->SleepSignal);
+    mtx_destroy(&ThreadPool->FutureLock);
+    cnd_destroy(&ThreadPool->FutureSignal);
+    free(ThreadPool->JobNodes);
     free(ThreadPool->Threads);
     free(ThreadPool);
     return OsSuccess;
@@ -515,5 +1037,5 @@ ThreadPoolGetWorkingCount(
     if (ThreadPool == NULL) {
         return 0;
     }
-    return ThreadPool->ThreadsWorking;
+    return (size_t)atomic_load(&ThreadPool->ThreadsWorking);
 }
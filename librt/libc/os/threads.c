@@ -42,3 +42,25 @@ GetCurrentThreadName(
     _In_ size_t MaxLength) {
     return Syscall_ThreadGetCurrentName(ThreadNameBuffer, MaxLength);
 }
+
+/* SetCurrentThreadRealtime
+ * Moves the current thread into the fixed-priority real-time class, or back to normal
+ * scheduling if the level is negative. */
+OsStatus_t
+SetCurrentThreadRealtime(
+    _In_ int    Level) {
+    return Syscall_ThreadSetRealtime(Level);
+}
+
+/* GetConditionOwner
+ * Retrieves the process that created the given condition variable. Fails if the
+ * value is not a condition variable, so it can be used to validate shared handles. */
+OsStatus_t
+GetConditionOwner(
+    _In_  uintptr_t Condition,
+    _Out_ UUId_t*   ProcessId) {
+    if (ProcessId == NULL) {
+        return OsError;
+    }
+    return Syscall_ConditionGetOwner(Condition, ProcessId);
+}
@@ -20,12 +20,28 @@
  *  - Provides functionality to create and manage windows used by the program
  */
 #include <os/window.h>
+#include <os/input.h>
+#include <threads.h>
 #include <assert.h>
+#include <string.h>
+
+/* Upper bound for a single wait on the release signal in milliseconds, this
+ * only matters when the release lands between our last check and going to sleep */
+#define UI_RELEASE_TIMEOUT  16
 
 // Globals
 // State keeping for a single window
-static DmaBuffer_t *ProgramWindowBuffer = NULL;
-static Handle_t ProgramWindowHandle     = NULL;
+static DmaBuffer_t *ProgramWindowBuffer     = NULL;
+static DmaBuffer_t *ProgramChannelBuffer    = NULL;
+static MWindowChannel_t *ProgramChannel     = NULL;
+static cnd_t ProgramReleaseSignal           = 0;
+static mtx_t ProgramReleaseLock             = UUID_INVALID;
+static Handle_t ProgramWindowHandle         = NULL;
+static size_t ProgramSurfaceSize            = 0;
+static int ProgramBufferCount               = 0;
+static int ProgramBufferIndex               = 0;
+static unsigned ProgramSequence             = 0;
+static unsigned ProgramBufferSequences[UI_MAX_BUFFERS] = { 0 };
 
 /* UiParametersSetDefault
  * Set(s) default window parameters for the given window param structure. */
@@ -36,6 +52,7 @@ UiParametersSetDefault(
     // Sanitize parameters
     assert(Descriptor != NULL);
     Descriptor->Flags           = 0;
+    Descriptor->BufferCount     = 2;
     Descriptor->Surface.Format  = SurfaceRGBA;
     
     Descriptor->Surface.Dimensions.x    = -1;
@@ -62,17 +79,41 @@ UiRegisterWindow(
     // Calculate how many bytes are needed by checking sizes requested.
     if (Descriptor->Surface.Dimensions.w <= 100)    { Descriptor->Surface.Dimensions.w = 450; }
     if (Descriptor->Surface.Dimensions.h <= 100)    { Descriptor->Surface.Dimensions.h = 300; }
-    BytesNeccessary = Descriptor->Surface.Dimensions.w * Descriptor->Surface.Dimensions.h * 4;
+    if (Descriptor->BufferCount < 1)                { Descriptor->BufferCount = 1; }
+    if (Descriptor->BufferCount > UI_MAX_BUFFERS)   { Descriptor->BufferCount = UI_MAX_BUFFERS; }
+    ProgramSurfaceSize  = Descriptor->Surface.Dimensions.w * Descriptor->Surface.Dimensions.h * 4;
+    BytesNeccessary     = ProgramSurfaceSize * Descriptor->BufferCount;
 
-    // Create the buffer object
+    // Create the buffer objects, the surfaces are laid out back to back
     *WindowBuffer = CreateBuffer(UUID_INVALID, BytesNeccessary);
     if (*WindowBuffer == NULL) {
         return OsError;
     }
-    ProgramWindowBuffer = *WindowBuffer;
+    ProgramChannelBuffer = CreateBuffer(UUID_INVALID, sizeof(MWindowChannel_t));
+    if (ProgramChannelBuffer == NULL) {
+        DestroyBuffer(*WindowBuffer);
+        *WindowBuffer = NULL;
+        return OsError;
+    }
+    if ((ProgramReleaseSignal == 0 && cnd_init(&ProgramReleaseSignal) != thrd_success)
+        || (ProgramReleaseLock == UUID_INVALID && mtx_init(&ProgramReleaseLock, mtx_plain) != thrd_success)) {
+        DestroyBuffer(ProgramChannelBuffer);
+        DestroyBuffer(*WindowBuffer);
+        ProgramChannelBuffer = NULL;
+        *WindowBuffer = NULL;
+        return OsError;
+    }
+    ZeroBuffer(ProgramChannelBuffer);
+    ProgramWindowBuffer     = *WindowBuffer;
+    ProgramChannel          = (MWindowChannel_t*)GetBufferDataPointer(ProgramChannelBuffer);
+    ProgramBufferCount      = Descriptor->BufferCount;
+    ProgramBufferIndex      = 0;
+    ProgramSequence         = 0;
+    memset(&ProgramBufferSequences[0], 0, sizeof(ProgramBufferSequences));
 
     // Create the window
-    return CreateWindow(Descriptor, GetBufferHandle(ProgramWindowBuffer), &ProgramWindowHandle);
+    return CreateWindow(Descriptor, GetBufferHandle(ProgramWindowBuffer), 
+        GetBufferHandle(ProgramChannelBuffer), (uintptr_t)ProgramReleaseSignal, &ProgramWindowHandle);
 }
 
 /* UiUnregisterWindow
@@ -87,13 +128,116 @@ UiUnregisterWindow(void)
     return DestroyWindow(ProgramWindowHandle);
 }
 
+/* UiGetBackbuffer
+ * Retrieves the surface that should be drawn to next. This blocks until the window
+ * manager has released the surface from its last present. The age is the number of
+ * presents since the surface was last presented, or 0 if its contents are undefined. */
+OsStatus_t
+UiGetBackbuffer(
+    _Out_     void**                Surface,
+    _Out_Opt_ int*                  Age)
+{
+    // Variables
+    struct timespec Deadline;
+    unsigned Sequence;
+
+    if (ProgramWindowHandle == NULL || Surface == NULL) {
+        return OsError;
+    }
+
+    // Released is the generation of the last present the window manager has
+    // finished reading. Generations wrap, so compare the distance and not the
+    // values. The wait is announced before the predicate is checked, the window
+    // manager only signals when it sees a waiter after it has updated Released
+    Sequence = ProgramBufferSequences[ProgramBufferIndex];
+    mtx_lock(&ProgramReleaseLock);
+    while ((int)(ProgramChannel->Released - Sequence) < 0) {
+        ProgramChannel->Waiting = 1;
+        MemoryBarrier();
+        if ((int)(ProgramChannel->Released - Sequence) >= 0) {
+            break;
+        }
+
+        timespec_get(&Deadline, TIME_UTC);
+        Deadline.tv_nsec += UI_RELEASE_TIMEOUT * (NSEC_PER_SEC / MSEC_PER_SEC);
+        if (Deadline.tv_nsec >= NSEC_PER_SEC) {
+            Deadline.tv_nsec -= NSEC_PER_SEC;
+            Deadline.tv_sec++;
+        }
+        cnd_timedwait(&ProgramReleaseSignal, &ProgramReleaseLock, &Deadline);
+    }
+    ProgramChannel->Waiting = 0;
+    mtx_unlock(&ProgramReleaseLock);
+
+    *Surface = (void*)(GetBufferDataPointer(ProgramWindowBuffer) 
+        + (ProgramBufferIndex * ProgramSurfaceSize));
+    if (Age != NULL) {
+        *Age = (Sequence == 0) ? 0 : (int)(ProgramSequence - Sequence) + 1;
+    }
+    return OsSuccess;
+}
+
+/* UiSwapBackbufferRegions
+ * Presents the current backbuffer, but only the given regions are updated on screen.
+ * If there are more regions than UI_MAX_DAMAGE_RECTS the entire surface is presented. */
+OsStatus_t
+UiSwapBackbufferRegions(
+    _In_ const Rect_t*              Regions,
+    _In_ size_t                     RegionCount)
+{
+    // Variables
+    UISwapParameters_t Parameters;
+    OsStatus_t Status;
+
+    if (ProgramWindowHandle == NULL) {
+        return OsError;
+    }
+
+    Parameters.BufferIndex  = ProgramBufferIndex;
+    Parameters.Sequence     = ++ProgramSequence;
+    Parameters.RectCount    = 0;
+    if (Regions != NULL && RegionCount <= UI_MAX_DAMAGE_RECTS) {
+        memcpy(&Parameters.Rects[0], Regions, RegionCount * sizeof(Rect_t));
+        Parameters.RectCount = RegionCount;
+    }
+
+    Status = SwapWindowBackbuffer(ProgramWindowHandle, &Parameters);
+    if (Status == OsSuccess) {
+        ProgramBufferSequences[ProgramBufferIndex] = Parameters.Sequence;
+        ProgramBufferIndex = (ProgramBufferIndex + 1) % ProgramBufferCount;
+    }
+    return Status;
+}
+
 /* UiSwapBackbuffer
  * Presents the current backbuffer and rendering all changes made to the window. */
 OsStatus_t
 UiSwapBackbuffer(void)
 {
-    if (ProgramWindowHandle == NULL) {
+    return UiSwapBackbufferRegions(NULL, 0);
+}
+
+/* UiReadInput
+ * Reads the next input event for the window from the shared event ring. This never
+ * blocks, OsError is returned if there are no pending events. */
+OsStatus_t
+UiReadInput(
+    _Out_ MInput_t*                 Input)
+{
+    // Variables
+    size_t Tail;
+
+    if (ProgramChannel == NULL || Input == NULL) {
+        return OsError;
+    }
+
+    Tail = ProgramChannel->Tail;
+    if (Tail == ProgramChannel->Head) {
         return OsError;
     }
-    return SwapWindowBackbuffer(ProgramWindowHandle);
+    MemoryBarrier();
+    memcpy(Input, &ProgramChannel->Events[Tail & (INPUT_RING_SIZE - 1)], sizeof(MInput_t));
+    MemoryBarrier();
+    ProgramChannel->Tail = Tail + 1;
+    return OsSuccess;
 }
@@ -327,6 +327,8 @@ StdioFdAllocate(
         io->lookahead[2] = '\n';
         io->exflag = 0;
         io->file = NULL;
+        io->buffer = NULL;
+        io->transfer = NULL;
         SpinlockReset(&io->lock);
     
         // Add to list
@@ -350,6 +352,12 @@ StdioFdFree(
     Key.Value = fd;
     fNode = CollectionGetNodeByKey(&IoObjects, Key, 0);
     if (fNode != NULL) {
+        if (((StdioObject_t*)fNode->Data)->buffer != NULL) {
+            DestroyBuffer(((StdioObject_t*)fNode->Data)->buffer);
+        }
+        if (((StdioObject_t*)fNode->Data)->transfer != NULL) {
+            DestroyBuffer(((StdioObject_t*)fNode->Data)->transfer);
+        }
         free(fNode->Data);
         CollectionRemoveByNode(&IoObjects, fNode);
         CollectionDestroyNode(&IoObjects, fNode);
@@ -420,69 +428,151 @@ StdioFdInitialize(
     }
 }
 
+/* StdioAcquireTransferBuffer
+ * Retrieves a transfer buffer that fits as much of <Length> as possible.
+ * Small requests use the thread's transfer buffer, larger ones take the
+ * io-object's cached buffer, which is grown on demand. The cached buffer is
+ * detached from the io-object while in use, so the io-object lock is only
+ * held to take it and no lock is held across the file requests. */
+static DmaBuffer_t*
+StdioAcquireTransferBuffer(
+    _In_ StdioObject_t* Object,
+    _In_ size_t         Length)
+{
+    // Variables
+    DmaBuffer_t *Cached;
+    DmaBuffer_t *Buffer;
+    size_t Capacity;
+
+    if (Length <= GetBufferSize(tls_current()->transfer_buffer)) {
+        return tls_current()->transfer_buffer;
+    }
+
+    SpinlockAcquire(&Object->lock);
+    Cached              = Object->transfer;
+    Object->transfer    = NULL;
+    SpinlockRelease(&Object->lock);
+    if (Cached != NULL && GetBufferSize(Cached) >= MIN(Length, STDIO_TRANSFER_MAXSIZE)) {
+        return Cached;
+    }
+
+    // Grow in powers of two to avoid regrowing on every request
+    Capacity = INTERNAL_BUFSIZ;
+    while (Capacity < Length && Capacity < STDIO_TRANSFER_MAXSIZE) {
+        Capacity <<= 1;
+    }
+    Buffer = CreateBuffer(UUID_INVALID, Capacity);
+    if (Buffer == NULL) {
+        return (Cached != NULL) ? Cached : tls_current()->transfer_buffer;
+    }
+    if (Cached != NULL) {
+        DestroyBuffer(Cached);
+    }
+    return Buffer;
+}
+
+/* StdioReleaseTransferBuffer
+ * Returns a buffer retrieved by StdioAcquireTransferBuffer. If another thread
+ * has cached a buffer on the io-object meanwhile, the larger one is kept. */
+static void
+StdioReleaseTransferBuffer(
+    _In_ StdioObject_t* Object,
+    _In_ DmaBuffer_t*   Buffer)
+{
+    // Variables
+    DmaBuffer_t *Cached;
+
+    if (Buffer == tls_current()->transfer_buffer) {
+        return;
+    }
+
+    SpinlockAcquire(&Object->lock);
+    Cached = Object->transfer;
+    if (Cached == NULL || GetBufferSize(Cached) < GetBufferSize(Buffer)) {
+        Object->transfer    = Buffer;
+        Buffer              = Cached;
+    }
+    SpinlockRelease(&Object->lock);
+    if (Buffer != NULL) {
+        DestroyBuffer(Buffer);
+    }
+}
+
+/* StdioIsStreamBuffer
+ * Returns 1 if the given range is the start of the stream buffer of the
+ * io-object, which means the file-manager can access it directly */
+static int
+StdioIsStreamBuffer(
+    _In_ StdioObject_t* Object,
+    _In_ const char*    Buffer,
+    _In_ size_t         Length)
+{
+    return Object->buffer != NULL 
+        && Buffer == (const char*)GetBufferDataPointer(Object->buffer)
+        && Length <= GetBufferSize(Object->buffer);
+}
+
 /* StdioHandleReadFile
  * Reads the requested number of bytes from a file handle */
 OsStatus_t
 StdioHandleReadFile(
-    _In_  StdioHandle_t* Handle, 
+    _In_  StdioObject_t* Object, 
     _In_  char*          Buffer, 
     _In_  size_t         Length,
     _Out_ size_t*        BytesRead)
 {
+    // Variables
+    UUId_t FileHandle       = Object->handle.InheritationData.FileHandle;
 	uint8_t *Pointer        = (uint8_t*)Buffer;
-	size_t BytesReadTotal   = 0, BytesLeft = (size_t)Length;
-	size_t OriginalSize     = GetBufferSize(tls_current()->transfer_buffer);
-
-    // There is a time when reading more than a couple of times is considerably slower
-    // than just reading the entire thing at once. When? Who knows, but in our case anything
-    // more than 5 transfers is useless
-    if (Length >= (OriginalSize * 5)) {
-        DmaBuffer_t *TransferBuffer     = CreateBuffer(UUID_INVALID, Length);
-		size_t BytesReadFs              = 0, BytesIndex = 0;
-        FileSystemCode_t FsCode;
-
-        FsCode = ReadFile(Handle->InheritationData.FileHandle, GetBufferHandle(TransferBuffer), Length, &BytesIndex, &BytesReadFs);
-        if (_fval(FsCode) || BytesReadFs == 0) {
-            DestroyBuffer(TransferBuffer);
-            if (BytesReadFs == 0) {
-                *BytesRead = 0;
-                return OsSuccess;
-            }
+	size_t BytesReadTotal   = 0, BytesLeft = Length;
+    DmaBuffer_t *TransferBuffer;
+    FileSystemCode_t FsCode;
+
+    // Stream buffers are dma buffers themselves, read straight into them
+    if (StdioIsStreamBuffer(Object, Buffer, Length)) {
+        size_t BytesReadFs = 0, BytesIndex = 0;
+        FsCode = ReadFile(FileHandle, GetBufferHandle(Object->buffer), 
+            Length, &BytesIndex, &BytesReadFs);
+        if (_fval(FsCode)) {
             return OsError;
         }
-
-		SeekBuffer(TransferBuffer, BytesIndex);
-        ReadBuffer(TransferBuffer, (const void*)Buffer, BytesReadFs, NULL);
-        DestroyBuffer(TransferBuffer);
+        if (BytesIndex != 0 && BytesReadFs != 0) {
+            memmove(Buffer, Buffer + BytesIndex, BytesReadFs);
+        }
         *BytesRead = BytesReadFs;
         return OsSuccess;
     }
-    
-    // Keep reading chunks untill we've read all requested
+
+    // Everything else is bounced through a transfer buffer that is
+    // sized for the request, so this normally is a single request
+    TransferBuffer = StdioAcquireTransferBuffer(Object, Length);
 	while (BytesLeft > 0) {
-        FileSystemCode_t FsCode = FsOk;
-		size_t ChunkSize        = MIN(OriginalSize, BytesLeft);
+		size_t ChunkSize        = MIN(GetBufferSize(TransferBuffer), BytesLeft);
 		size_t BytesReadFs      = 0, BytesIndex = 0;
 
-        // Perform the read
-        FsCode = ReadFile(Handle->InheritationData.FileHandle, GetBufferHandle(tls_current()->transfer_buffer), 
+        FsCode = ReadFile(FileHandle, GetBufferHandle(TransferBuffer), 
             ChunkSize, &BytesIndex, &BytesReadFs);
         if (_fval(FsCode) || BytesReadFs == 0) {
 			break;
 		}
         
         // Seek to the valid buffer index, then read the byte count
-		SeekBuffer(tls_current()->transfer_buffer, BytesIndex);
-        ReadBuffer(tls_current()->transfer_buffer, (const void*)Pointer, BytesReadFs, NULL);
-		SeekBuffer(tls_current()->transfer_buffer, 0);
+		SeekBuffer(TransferBuffer, BytesIndex);
+        ReadBuffer(TransferBuffer, (const void*)Pointer, BytesReadFs, NULL);
+		SeekBuffer(TransferBuffer, 0);
 
         // Update indices
 		BytesLeft       -= BytesReadFs;
 		BytesReadTotal  += BytesReadFs;
 		Pointer         += BytesReadFs;
+
+        // Short read means end of file
+        if (BytesReadFs < ChunkSize) {
+            break;
+        }
 	}
+    StdioReleaseTransferBuffer(Object, TransferBuffer);
 
-    // Restore transfer buffer
     *BytesRead = BytesReadTotal;
 	return OsSuccess;
 }
@@ -500,7 +590,7 @@ StdioReadInternal(
     StdioHandle_t *Handle   = StdioFdToHandle(fd);
 
     if (Handle->InheritationType == STDIO_HANDLE_FILE) {
-        return StdioHandleReadFile(Handle, Buffer, Length, BytesRead);
+        return StdioHandleReadFile(get_ioinfo(fd), Buffer, Length, BytesRead);
     }
     else if (Handle->InheritationType == STDIO_HANDLE_PIPE) {
         if (ReceivePipe(Handle->InheritationData.Pipe.ProcessId, 
@@ -521,23 +611,36 @@ StdioReadInternal(
  * Writes the requested number of bytes to a file handle */
 OsStatus_t
 StdioHandleWriteFile(
-    _In_  StdioHandle_t* Handle, 
+    _In_  StdioObject_t* Object, 
     _In_  char*          Buffer, 
     _In_  size_t         Length,
     _Out_ size_t*        BytesWritten)
 {
-	size_t BytesWrittenTotal = 0, BytesLeft = (size_t)Length;
-	size_t OriginalSize = GetBufferSize(tls_current()->transfer_buffer);
-    uint8_t *Pointer = (uint8_t*)Buffer;
+    // Variables
+    UUId_t FileHandle           = Object->handle.InheritationData.FileHandle;
+	size_t BytesWrittenTotal    = 0, BytesLeft = Length;
+    uint8_t *Pointer            = (uint8_t*)Buffer;
+    DmaBuffer_t *TransferBuffer;
+
+    // Stream buffers are dma buffers themselves, write straight from them
+    if (StdioIsStreamBuffer(Object, Buffer, Length)) {
+        if (WriteFile(FileHandle, GetBufferHandle(Object->buffer), 
+            Length, BytesWritten) != FsOk) {
+            return OsError;
+        }
+        return OsSuccess;
+    }
 
-    // Keep writing chunks untill we've read all requested
+    // Keep writing chunks untill we've written all requested, the
+    // transfer buffer is sized for the request so this is normally one
+    TransferBuffer = StdioAcquireTransferBuffer(Object, Length);
 	while (BytesLeft > 0) {
-		size_t ChunkSize = MIN(OriginalSize, BytesLeft);
+		size_t ChunkSize = MIN(GetBufferSize(TransferBuffer), BytesLeft);
 		size_t BytesWrittenLocal = 0;
         
-        SeekBuffer(tls_current()->transfer_buffer, 0); // Rewind buffer
-        WriteBuffer(tls_current()->transfer_buffer, (const void *)Pointer, ChunkSize, &BytesWrittenLocal);
-		if (WriteFile(Handle->InheritationData.FileHandle, GetBufferHandle(tls_current()->transfer_buffer), 
+        SeekBuffer(TransferBuffer, 0); // Rewind buffer
+        WriteBuffer(TransferBuffer, (const void *)Pointer, ChunkSize, &BytesWrittenLocal);
+		if (WriteFile(FileHandle, GetBufferHandle(TransferBuffer), 
             ChunkSize, &BytesWrittenLocal) != FsOk) {
 			break;
 		}
@@ -548,8 +651,8 @@ StdioHandleWriteFile(
 		BytesLeft -= BytesWrittenLocal;
 		Pointer += BytesWrittenLocal;
 	}
+    StdioReleaseTransferBuffer(Object, TransferBuffer);
 
-	// Restore our transfer buffer and return
     *BytesWritten = BytesWrittenTotal;
 	return OsSuccess;
 }
@@ -567,7 +670,7 @@ StdioWriteInternal(
     StdioHandle_t *Handle   = StdioFdToHandle(fd);
 
     if (Handle->InheritationType == STDIO_HANDLE_FILE) {
-        return StdioHandleWriteFile(Handle, Buffer, Length, BytesWritten);
+        return StdioHandleWriteFile(get_ioinfo(fd), Buffer, Length, BytesWritten);
     }
     else if (Handle->InheritationType == STDIO_HANDLE_PIPE) {
         if (SendPipe(Handle->InheritationData.Pipe.ProcessId, 
@@ -773,21 +876,40 @@ int _flushall(void) {
     return os_flush_all_buffers(_IOWRT | _IOREAD);
 }
 
-/* os_alloc_buffer
- * Allocates a transfer buffer for a stdio file stream */
+/* os_alloc_buffer_sized
+ * Allocates a stream buffer of the given size for a stdio file stream. Buffers
+ * of file-backed streams are dma buffers, so the file-manager can fill and
+ * flush them without going through a transfer buffer */
 OsStatus_t
-os_alloc_buffer(
-    _In_ FILE *file)
+os_alloc_buffer_sized(
+    _In_ FILE *file,
+    _In_ size_t size)
 {
-    // Sanitize that it's not an std tty stream
-    if ((file->_fd == STDOUT_FILENO || file->_fd == STDERR_FILENO) && isatty(file->_fd)) {
-        return OsError;
+    // Variables
+    StdioObject_t *Object   = get_ioinfo(file->_fd);
+    StdioHandle_t *Handle   = StdioFdToHandle(file->_fd);
+
+    if (size < 2) {
+        size = INTERNAL_BUFSIZ;
+    }
+
+    if (Object != NULL && Handle != NULL 
+        && Handle->InheritationType == STDIO_HANDLE_FILE
+        && Object->buffer == NULL) {
+        Object->buffer = CreateBuffer(UUID_INVALID, size);
+        if (Object->buffer != NULL) {
+            file->_base = (char*)GetBufferDataPointer(Object->buffer);
+        }
+        else {
+            file->_base = calloc(1, size);
+        }
+    }
+    else {
+        file->_base = calloc(1, size);
     }
 
-    // Allocate a transfer buffer
-    file->_base = calloc(1, INTERNAL_BUFSIZ);
     if (file->_base) {
-        file->_bufsiz = INTERNAL_BUFSIZ;
+        file->_bufsiz = size;
         file->_flag |= _IOMYBUF;
     }
     else {
@@ -802,6 +924,44 @@ os_alloc_buffer(
     return OsSuccess;
 }
 
+/* os_alloc_buffer
+ * Allocates a transfer buffer for a stdio file stream */
+OsStatus_t
+os_alloc_buffer(
+    _In_ FILE *file)
+{
+    // Sanitize that it's not an std tty stream
+    if ((file->_fd == STDOUT_FILENO || file->_fd == STDERR_FILENO) && isatty(file->_fd)) {
+        return OsError;
+    }
+    return os_alloc_buffer_sized(file, INTERNAL_BUFSIZ);
+}
+
+/* os_free_buffer
+ * Frees a stream buffer allocated by os_alloc_buffer */
+void
+os_free_buffer(
+    _In_ FILE *file)
+{
+    // Variables
+    StdioObject_t *Object = get_ioinfo(file->_fd);
+
+    if (!(file->_flag & _IOMYBUF)) {
+        return;
+    }
+
+    if (Object != NULL && Object->buffer != NULL
+        && file->_base == (char*)GetBufferDataPointer(Object->buffer)) {
+        DestroyBuffer(Object->buffer);
+        Object->buffer = NULL;
+    }
+    else {
+        free(file->_base);
+    }
+    file->_base = file->_ptr = NULL;
+    file->_flag &= ~_IOMYBUF;
+}
+
 /* add_std_buffer
  * Allocate temporary buffer for stdout and stderr */
 OsStatus_t
@@ -25,6 +25,10 @@
 #include <errno.h>
 #include <io.h>
 
+/* Directory entries are read in batches, so listing a directory costs
+ * one request per buffer instead of one request per entry */
+#define DIRECTORY_BUFFER_SIZE   0x1000
+
 /* mkdir
  * Creates a new directory for the entire path. */
 int
@@ -95,6 +99,16 @@ opendir(
     *handle = (struct DIR*)malloc(sizeof(struct DIR));
     (*handle)->d_handle = FileHandle;
     (*handle)->d_index  = -1;
+    (*handle)->d_buffer = CreateBuffer(UUID_INVALID, DIRECTORY_BUFFER_SIZE);
+    (*handle)->d_offset = 0;
+    (*handle)->d_length = 0;
+    if ((*handle)->d_buffer == NULL) {
+        CloseDirectory(FileHandle);
+        free(*handle);
+        *handle = NULL;
+        _set_errno(ENOMEM);
+        return -1;
+    }
     return 0;
 }
 
@@ -118,20 +132,22 @@ closedir(
     if (_fval(Code) == -1) {
         return -1;
     }
+    DestroyBuffer((DmaBuffer_t*)handle->d_buffer);
     free(handle);
     return 0;
 }
 
 /* readdir
  * Reads a directory entry at the current index and increases the current index
- * for the directory handle. */
+ * for the directory handle. Returns -1 without setting errno at end of directory. */
 int
 readdir(
     _In_ struct DIR*    handle, 
     _In_ struct DIRENT* entry)
 {
     // Variables
-    ReadDirectoryPackage_t DirEntry;
+    DmaBuffer_t *Buffer     = NULL;
+    DirectoryEntry_t *Entry = NULL;
     FileSystemCode_t Code   = FsOk;
 
     // Validate the input
@@ -140,16 +156,24 @@ readdir(
         return -1;
     }
 
-    // Invoke service
-    Code = ReadDirectory(handle->d_handle, &DirEntry);
-    if (_fval(Code) == -1) {
-        return -1;
+    // Refill the entry buffer once all buffered entries are consumed
+    Buffer = (DmaBuffer_t*)handle->d_buffer;
+    if (handle->d_offset >= handle->d_length) {
+        handle->d_offset = 0;
+        handle->d_length = 0;
+        Code = ReadDirectory(handle->d_handle, GetBufferHandle(Buffer), 
+            GetBufferSize(Buffer), &handle->d_length);
+        if (_fval(Code) == -1 || handle->d_length == 0) {
+            return -1;
+        }
     }
 
     // Convert to c structure
-    handle->d_index++;
+    Entry = (DirectoryEntry_t*)((uint8_t*)GetBufferDataPointer(Buffer) + handle->d_offset);
+    handle->d_offset += Entry->Length;
+    handle->d_index   = Entry->Position;
     memset(entry, 0, sizeof(struct DIRENT));
-    entry->d_type = DirEntry.FileInformation.Flags;
-    memcpy(entry->d_name, &DirEntry.FileName[0], strlen(&DirEntry.FileName[0]));
+    entry->d_type = Entry->Information.Flags;
+    strncpy(entry->d_name, &Entry->Name[0], sizeof(entry->d_name) - 1);
     return 0;
 }
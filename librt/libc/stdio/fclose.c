@@ -89,9 +89,7 @@ int fclose(FILE *stream)
 	if (stream->_tmpfname != NULL) {
 		free(stream->_tmpfname);
 	}
-	if (stream->_flag & _IOMYBUF) {
-		free(stream->_base);
-	}
+	os_free_buffer(stream);
 
 	// Call underlying close and never
     // unlock the file as underlying stream is closed
@@ -477,7 +477,7 @@ size_t fread(
 	// Keep reading untill all requested bytes are read, or EOF
 	while (rcnt > 0) {
 		int i;
-		if (!stream->_cnt && rcnt < BUFSIZ 
+		if (!stream->_cnt && rcnt < stream->_bufsiz 
 			&& (stream->_flag & (_IOMYBUF | _USERBUF))) {
 			stream->_cnt = read(stream->_fd, stream->_base, stream->_bufsiz);
 			stream->_ptr = stream->_base;
@@ -499,11 +499,9 @@ size_t fread(
 		else if (rcnt > INT_MAX) {
 			i = read(stream->_fd, vptr, INT_MAX);
 		}
-		else if (rcnt < BUFSIZ) {
-			i = read(stream->_fd, vptr, rcnt);
-		}
 		else {
-			i = read(stream->_fd, vptr, rcnt - BUFSIZ / 2);
+			// Requests larger than the stream buffer bypass it
+			i = read(stream->_fd, vptr, rcnt);
 		}
 
 		// Update iterators
@@ -27,6 +27,7 @@
  * - Library */
 #include <os/osdefs.h>
 #include <os/spinlock.h>
+#include <os/buffer.h>
 
 #ifndef _IOCOMMIT
 #define _IOCOMMIT 0x4000
@@ -53,6 +54,10 @@
 #define INTERNAL_BUFSIZ     4096
 #define INTERNAL_MAXFILES   1024
 
+/* Transfer buffers are grown to fit the largest request on the fd,
+ * up to this size, so large reads/writes only need a single request */
+#define STDIO_TRANSFER_MAXSIZE  (1024 * 1024)
+
 #define STDIO_HANDLE_INVALID    0
 #define STDIO_HANDLE_PIPE       1
 #define STDIO_HANDLE_FILE       2
@@ -79,10 +84,14 @@ typedef struct {
     int                 exflag;
     void*               file;
     Spinlock_t          lock;
+    DmaBuffer_t*        buffer;     // Stream buffer, when allocated by os_alloc_buffer
+    DmaBuffer_t*        transfer;   // Cached transfer buffer for large requests
 } StdioObject_t;
 
 __EXTERN StdioObject_t* get_ioinfo(int fd);
 __EXTERN OsStatus_t os_alloc_buffer(FILE *file);
+__EXTERN OsStatus_t os_alloc_buffer_sized(FILE *file, size_t size);
+__EXTERN void os_free_buffer(FILE *file);
 __EXTERN OsStatus_t os_flush_buffer(FILE *file);
 __EXTERN int os_flush_all_buffers(int mask);
 __EXTERN OsStatus_t add_std_buffer(FILE *file);
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include "local.h"
 
 int setvbuf(
     _In_ FILE* file, 
@@ -19,12 +20,11 @@ int setvbuf(
     // Sanitize parameters and state
     if(file == NULL) return -1;
     if(mode != _IONBF && mode != _IOFBF && mode != _IOLBF) return -1;
-    if(mode == _IONBF && (size >= 2 && size <= INT_MAX)) return -1;
+    if(mode != _IONBF && size > INT_MAX) return -1;
     _lock_file(file);
 
     fflush(file);
-    if(file->_flag & _IOMYBUF)
-        free(file->_base);
+    os_free_buffer(file);
     file->_flag &= ~(_IONBF | _IOMYBUF | _USERBUF);
     file->_cnt = 0;
 
@@ -32,20 +32,17 @@ int setvbuf(
         file->_flag |= _IONBF;
         file->_base = file->_ptr = (char*)&file->_charbuf;
         file->_bufsiz = 2;
-    }else if(buf) {
+    }else if(buf && size >= 2) {
         file->_base = file->_ptr = buf;
         file->_flag |= _USERBUF;
         file->_bufsiz = size;
     }else {
-        file->_base = file->_ptr = malloc(size);
-        if(!file->_base) {
-            file->_bufsiz = 0;
+        // Size is a hint, zero selects the default size
+        os_alloc_buffer_sized(file, size);
+        if(file->_flag & _IONBF) {
             _unlock_file(file);
             return -1;
         }
-
-        file->_flag |= _IOMYBUF;
-        file->_bufsiz = size;
     }
     _unlock_file(file);
     return 0;
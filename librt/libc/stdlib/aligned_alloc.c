@@ -20,17 +20,20 @@
  * - Definitions, prototypes and information needed.
  */
 #include <stdlib.h>
+#include <malloc.h>
 #include <errno.h>
 
+/* aligned_alloc
+ * The block must be released with free, so the alignment is done by the
+ * allocator instead of offsetting a larger block. */
 void* aligned_alloc(
     _In_ size_t alignment,
     _In_ size_t size)
 {
-    size_t total_size = alignment + size;
-    void *ptr = malloc(total_size);
+    void *ptr = memalign(alignment, size);
     if (ptr == NULL) {
         _set_errno(ENOMEM);
         return NULL;
     }
-    return (void*)ALIGN((uintptr_t)ptr, alignment, 1);
+    return ptr;
 }
@@ -542,7 +542,8 @@ void __MallocLibCEmpty(void)
 #define HAVE_MORECORE           0
 #define HAVE_MREMAP             0
 #define INSECURE                0
-// #define MSPACES 1
+#define ONLY_MSPACES            1
+#define FOOTERS                 1
 #define ABORT_ON_ASSERT_FAILURE 1
 #define PROCEED_ON_ERROR        0
 
@@ -1684,23 +1685,89 @@ unsigned char _BitScanReverse(unsigned long *index, unsigned long mask);
 #ifndef WIN32
 #ifdef MOLLENOS
 #include <os/mollenos.h>
-/* MollenOS MMAP via Syscall */
-static FORCEINLINE void* mosmmap(size_t Size) {
+#include <os/spinlock.h>
+
+/* MollenOS MMAP via Syscall
+ * Heap segments are carved from large reserved regions and committed as they are
+ * handed out, the pages are only backed by physical memory when touched. Segments
+ * that are carved back to back are merged by sys_alloc. */
+#define MOS_REGION_SIZE             (16 * 1024 * 1024)
+
+static Spinlock_t mosregion_lock    = SPINLOCK_INIT;
+static char*      mosregion_next    = NULL;
+static char*      mosregion_end     = NULL;
+
+/* Reserves and commits a range of its own */
+static FORCEINLINE void* mosdirect_mmap(size_t Size) {
 	void* ptr = NULL;
-	if (MemoryAllocate(NULL, Size, MEMORY_READ | MEMORY_WRITE, &ptr, NULL) != OsSuccess) {
+	if (MemoryAllocate(NULL, Size, MEMORY_RESERVE, &ptr, NULL) != OsSuccess) {
 		return MFAIL;
 	}
-	else {
-		return ptr;
+	if (MemoryProtect(ptr, Size, MEMORY_READ | MEMORY_WRITE, NULL) != OsSuccess) {
+		MemoryFree(ptr, Size);
+		return MFAIL;
 	}
+	return ptr;
 }
 
-/* Same same but different */
-static FORCEINLINE void* mosdirect_mmap(size_t Size) {
-	return mosmmap(Size);
+/* Carves the segment from the current region, requests that are too big
+ * to fit comfortably in a region get their own reservation. The lock is only
+ * held to carve or publish a region, the system calls are made without it */
+static void* mosmmap(size_t Size) {
+	char* ptr = NULL;
+	if (Size > (MOS_REGION_SIZE / 4)) {
+		return mosdirect_mmap(Size);
+	}
+
+	while (ptr == NULL) {
+		void*  region        = NULL;
+		char*  leftover      = NULL;
+		size_t leftover_size = 0;
+
+		SpinlockAcquire(&mosregion_lock);
+		if (mosregion_next != NULL && (size_t)(mosregion_end - mosregion_next) >= Size) {
+			ptr = mosregion_next;
+			mosregion_next += Size;
+		}
+		SpinlockRelease(&mosregion_lock);
+		if (ptr != NULL) {
+			break;
+		}
+
+		// Reserve a new region, another thread may be doing the same in which
+		// case the region that is published first is used
+		if (MemoryAllocate(NULL, MOS_REGION_SIZE, MEMORY_RESERVE, &region, NULL) != OsSuccess) {
+			return MFAIL;
+		}
+		SpinlockAcquire(&mosregion_lock);
+		if (mosregion_next == NULL || (size_t)(mosregion_end - mosregion_next) < Size) {
+			leftover       = mosregion_next;
+			leftover_size  = (size_t)(mosregion_end - mosregion_next);
+			ptr            = (char*)region;
+			mosregion_next = (char*)region + Size;
+			mosregion_end  = (char*)region + MOS_REGION_SIZE;
+			region         = NULL;
+		}
+		SpinlockRelease(&mosregion_lock);
+
+		if (leftover != NULL && leftover_size != 0) {
+			MemoryFree(leftover, leftover_size);
+		}
+		if (region != NULL) {
+			MemoryFree(region, MOS_REGION_SIZE);
+		}
+	}
+
+	// The segment is ours now, commit it
+	if (MemoryProtect(ptr, Size, MEMORY_READ | MEMORY_WRITE, NULL) != OsSuccess) {
+		MemoryFree(ptr, Size);
+		return MFAIL;
+	}
+	return ptr;
 }
 
-/* This function supports releasing coalesed segments */
+/* This function supports releasing coalesed segments, parts of
+ * a region can be released on their own */
 static FORCEINLINE int mosmunmap(void* Ptr, size_t Size) {
 	return MemoryFree(Ptr, Size) == OsSuccess ? 0 : -1;
 }
@@ -6045,6 +6112,364 @@ int mspace_mallopt(int param_number, int value) {
 
 #endif /* MSPACES */
 
+/* ------------------- MollenOS multi-arena front-end -------------------- */
+
+#if defined(MOLLENOS) && ONLY_MSPACES
+/*
+  Threads are bound round-robin to one of a fixed number of arenas, each
+  arena being an unlocked mspace guarded by its own lock. Small blocks are
+  kept in a per-thread cache on free and handed out again without taking
+  the arena lock. Blocks freed by a thread that does not own the arena are
+  freed directly if the arena lock is free, otherwise they are pushed onto
+  the arena's remote list and released by the owner the next time it holds
+  the lock. The arena a block belongs to is found through its footer.
+*/
+#include "../threads/tls.h"
+
+#define MOS_ARENA_COUNT           8
+#define MOS_CACHE_GRANULARITY     16
+#define MOS_CACHE_CLASSES         16
+#define MOS_CACHE_DEPTH           32
+#define MOS_CACHE_MAX_REQUEST     (MOS_CACHE_CLASSES * MOS_CACHE_GRANULARITY)
+
+typedef struct mos_block {
+  struct mos_block* next;
+} mos_block_t;
+
+typedef struct mos_arena {
+  MLOCK_T               lock;
+  mspace                space;
+  _Atomic(mos_block_t*) remote;
+} mos_arena_t;
+
+typedef struct mos_thread_cache {
+  mos_arena_t*  arena;
+  mos_block_t*  bins[MOS_CACHE_CLASSES];
+  unsigned int  counts[MOS_CACHE_CLASSES];
+} mos_thread_cache_t;
+
+static mos_arena_t  mos_arenas[MOS_ARENA_COUNT];
+static MLOCK_T      mos_arenas_lock = 0;
+static atomic_uint  mos_arena_next  = ATOMIC_VAR_INIT(0);
+
+/* Creates the arena on first use, arenas live as long as the process */
+static mos_arena_t* mos_arena_get(unsigned int index) {
+  mos_arena_t* arena = &mos_arenas[index % MOS_ARENA_COUNT];
+  if (arena->space == NULL) {
+    ACQUIRE_LOCK(&mos_arenas_lock);
+    if (arena->space == NULL) {
+      mspace space = create_mspace(0, 0);
+      if (space != NULL) {
+        ((mstate)space)->extp = arena;
+        INITIAL_LOCK(&arena->lock);
+        atomic_store(&arena->remote, NULL);
+        arena->space = space;
+      }
+    }
+    RELEASE_LOCK(&mos_arenas_lock);
+  }
+  return (arena->space != NULL) ? arena : NULL;
+}
+
+/* Releases blocks other threads have freed, caller must hold the arena lock */
+static void mos_arena_drain(mos_arena_t* arena) {
+  mos_block_t* block = atomic_exchange(&arena->remote, NULL);
+  while (block != NULL) {
+    mos_block_t* next = block->next;
+    mspace_free(arena->space, block);
+    block = next;
+  }
+}
+
+/* Returns the arena the block was allocated from */
+static mos_arena_t* mos_arena_of(void* mem) {
+  mstate fm = get_mstate_for(mem2chunk(mem));
+  if (!ok_magic(fm)) {
+    USAGE_ERROR_ACTION(fm, mem2chunk(mem));
+    return NULL;
+  }
+  return (mos_arena_t*)fm->extp;
+}
+
+/* Returns the cache of the calling thread, the cache is created on first use
+ * and binds the thread to an arena. NULL is returned for threads without
+ * thread storage, those allocate from the first arena. */
+static mos_thread_cache_t* mos_cache_get(void) {
+  thread_storage_t*   tls = tls_current();
+  mos_thread_cache_t* cache;
+  mos_arena_t*        arena;
+
+  if (tls == NULL) {
+    return NULL;
+  }
+  if (tls->heap_cache != NULL) {
+    return (mos_thread_cache_t*)tls->heap_cache;
+  }
+
+  arena = mos_arena_get(atomic_fetch_add(&mos_arena_next, 1));
+  if (arena == NULL) {
+    return NULL;
+  }
+  ACQUIRE_LOCK(&arena->lock);
+  cache = (mos_thread_cache_t*)mspace_calloc(arena->space, 1, sizeof(mos_thread_cache_t));
+  RELEASE_LOCK(&arena->lock);
+  if (cache != NULL) {
+    cache->arena    = arena;
+    tls->heap_cache = cache;
+  }
+  return cache;
+}
+
+static mos_arena_t* mos_arena_for(mos_thread_cache_t* cache) {
+  return (cache != NULL) ? cache->arena : mos_arena_get(0);
+}
+
+/* Frees the block to the arena it belongs to, blocks of other arenas are
+ * queued on the remote list if the arena is busy */
+static void mos_arena_free(mos_arena_t* local, void* mem) {
+  mos_arena_t* arena = mos_arena_of(mem);
+  if (arena == NULL) {
+    return;
+  }
+
+  if (arena == local) {
+    ACQUIRE_LOCK(&arena->lock);
+  }
+  else if (!TRY_LOCK(&arena->lock)) {
+    mos_block_t* block = (mos_block_t*)mem;
+    block->next = atomic_load(&arena->remote);
+    while (!atomic_compare_exchange_weak(&arena->remote, &block->next, block));
+    return;
+  }
+  mos_arena_drain(arena);
+  mspace_free(arena->space, mem);
+  RELEASE_LOCK(&arena->lock);
+}
+
+/* Returns all cached blocks to the arena */
+static void mos_cache_flush(mos_thread_cache_t* cache) {
+  mos_arena_t* arena = cache->arena;
+  int i;
+
+  ACQUIRE_LOCK(&arena->lock);
+  for (i = 0; i < MOS_CACHE_CLASSES; i++) {
+    mos_block_t* block = cache->bins[i];
+    while (block != NULL) {
+      mos_block_t* next = block->next;
+      mspace_free(arena->space, block);
+      block = next;
+    }
+    cache->bins[i]   = NULL;
+    cache->counts[i] = 0;
+  }
+  mos_arena_drain(arena);
+  RELEASE_LOCK(&arena->lock);
+}
+
+/* Called by tls_destroy, returns the cache of the thread to its arena */
+void __malloc_thread_cleanup(thread_storage_t* tls) {
+  mos_thread_cache_t* cache = (mos_thread_cache_t*)tls->heap_cache;
+  if (cache != NULL) {
+    tls->heap_cache = NULL;
+    mos_cache_flush(cache);
+    mos_arena_free(cache->arena, cache);
+  }
+}
+
+void* malloc(size_t bytes) {
+  mos_thread_cache_t* cache = mos_cache_get();
+  mos_arena_t*        arena = mos_arena_for(cache);
+  void*               mem;
+
+  // Small requests are served from the thread cache, misses allocate the
+  // full class size so the block can be cached when freed
+  if (cache != NULL && bytes <= MOS_CACHE_MAX_REQUEST) {
+    size_t index = (bytes != 0) ? ((bytes - 1) / MOS_CACHE_GRANULARITY) : 0;
+    mos_block_t* block = cache->bins[index];
+    if (block != NULL) {
+      cache->bins[index] = block->next;
+      cache->counts[index]--;
+      return block;
+    }
+    bytes = (index + 1) * MOS_CACHE_GRANULARITY;
+  }
+
+  if (arena == NULL) {
+    MALLOC_FAILURE_ACTION;
+    return NULL;
+  }
+  ACQUIRE_LOCK(&arena->lock);
+  mos_arena_drain(arena);
+  mem = mspace_malloc(arena->space, bytes);
+  RELEASE_LOCK(&arena->lock);
+  return mem;
+}
+
+void free(void* mem) {
+  mos_thread_cache_t* cache;
+  if (mem == NULL) {
+    return;
+  }
+
+  // Only blocks of the cached classes are kept, the usable size of a class
+  // allocation exceeds the class size by less than the granularity. Larger
+  // blocks would otherwise be pinned in the cache for small requests
+  cache = mos_cache_get();
+  if (cache != NULL && is_inuse(mem2chunk(mem)) && !is_mmapped(mem2chunk(mem))) {
+    size_t usable = chunksize(mem2chunk(mem)) - overhead_for(mem2chunk(mem));
+    size_t index  = usable / MOS_CACHE_GRANULARITY;
+    if (index != 0 && usable < (MOS_CACHE_MAX_REQUEST + MOS_CACHE_GRANULARITY)
+        && cache->counts[index - 1] < MOS_CACHE_DEPTH
+        && mos_arena_of(mem) == cache->arena) {
+      mos_block_t* block = (mos_block_t*)mem;
+      block->next = cache->bins[index - 1];
+      cache->bins[index - 1] = block;
+      cache->counts[index - 1]++;
+      return;
+    }
+  }
+  mos_arena_free(mos_arena_for(cache), mem);
+}
+
+void* calloc(size_t n_elements, size_t elem_size) {
+  void* mem;
+  size_t req = 0;
+  if (n_elements != 0) {
+    req = n_elements * elem_size;
+    if (((n_elements | elem_size) & ~(size_t)0xffff) &&
+        (req / n_elements != elem_size)) {
+      MALLOC_FAILURE_ACTION;
+      return NULL;
+    }
+  }
+  mem = malloc(req);
+  if (mem != NULL) {
+    memset(mem, 0, req);
+  }
+  return mem;
+}
+
+void* realloc(void* oldmem, size_t bytes) {
+  mos_arena_t* arena;
+  void* mem;
+  if (oldmem == NULL) {
+    return malloc(bytes);
+  }
+#ifdef REALLOC_ZERO_BYTES_FREES
+  if (bytes == 0) {
+    free(oldmem);
+    return NULL;
+  }
+#endif /* REALLOC_ZERO_BYTES_FREES */
+
+  // The block is resized within the arena it belongs to
+  arena = mos_arena_of(oldmem);
+  if (arena == NULL) {
+    return NULL;
+  }
+  ACQUIRE_LOCK(&arena->lock);
+  mos_arena_drain(arena);
+  mem = mspace_realloc(arena->space, oldmem, bytes);
+  RELEASE_LOCK(&arena->lock);
+  return mem;
+}
+
+void* memalign(size_t alignment, size_t bytes) {
+  mos_arena_t* arena = mos_arena_for(mos_cache_get());
+  void* mem;
+  if (arena == NULL) {
+    MALLOC_FAILURE_ACTION;
+    return NULL;
+  }
+  ACQUIRE_LOCK(&arena->lock);
+  mos_arena_drain(arena);
+  mem = mspace_memalign(arena->space, alignment, bytes);
+  RELEASE_LOCK(&arena->lock);
+  return mem;
+}
+
+int posix_memalign(void** pp, size_t alignment, size_t bytes) {
+  void* mem;
+  if (alignment == MALLOC_ALIGNMENT) {
+    mem = malloc(bytes);
+  }
+  else {
+    size_t d = alignment / sizeof(void*);
+    size_t r = alignment % sizeof(void*);
+    if (r != 0 || d == 0 || (d & (d-SIZE_T_ONE)) != 0) {
+      return EINVAL;
+    }
+    mem = memalign(alignment, bytes);
+  }
+  if (mem == NULL) {
+    return ENOMEM;
+  }
+  *pp = mem;
+  return 0;
+}
+
+void* valloc(size_t bytes) {
+  ensure_initialization();
+  return memalign(mparams.page_size, bytes);
+}
+
+size_t malloc_usable_size(void* mem) {
+  return mspace_usable_size(mem);
+}
+
+int malloc_trim(size_t pad) {
+  mos_thread_cache_t* cache = mos_cache_get();
+  int result = 0;
+  int i;
+
+  if (cache != NULL) {
+    mos_cache_flush(cache);
+  }
+  for (i = 0; i < MOS_ARENA_COUNT; i++) {
+    mos_arena_t* arena = &mos_arenas[i];
+    if (arena->space != NULL) {
+      ACQUIRE_LOCK(&arena->lock);
+      mos_arena_drain(arena);
+      result |= mspace_trim(arena->space, pad);
+      RELEASE_LOCK(&arena->lock);
+    }
+  }
+  return result;
+}
+
+int mallopt(int param_number, int value) {
+  return change_mparam(param_number, value);
+}
+
+/* Statistics are summed over all arenas, blocks held by thread caches
+ * are counted as in use */
+struct mallinfo mallinfo(void) {
+  struct mallinfo total = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  int i;
+
+  for (i = 0; i < MOS_ARENA_COUNT; i++) {
+    mos_arena_t* arena = &mos_arenas[i];
+    if (arena->space != NULL) {
+      struct mallinfo info;
+      ACQUIRE_LOCK(&arena->lock);
+      info = mspace_mallinfo(arena->space);
+      RELEASE_LOCK(&arena->lock);
+      total.arena    += info.arena;
+      total.ordblks  += info.ordblks;
+      total.smblks   += info.smblks;
+      total.hblks    += info.hblks;
+      total.hblkhd   += info.hblkhd;
+      total.usmblks  += info.usmblks;
+      total.fsmblks  += info.fsmblks;
+      total.uordblks += info.uordblks;
+      total.fordblks += info.fordblks;
+      total.keepcost += info.keepcost;
+    }
+  }
+  return total;
+}
+#endif /* MOLLENOS && ONLY_MSPACES */
+
 #ifdef _MSC_VER
 #pragma warning(default:4127)
 #endif
@@ -142,21 +142,28 @@ cnd_timedwait(
 		return thrd_error;
 	}
 
+	// Calculate the time left, a wait of 0 would never time out
+	timespec_get(&now, TIME_UTC);
+    timespec_diff(&now, time_point, &result);
+    if (result.tv_sec >= 0) {
+        msec = result.tv_sec * MSEC_PER_SEC;
+        if (result.tv_nsec != 0) {
+            msec += ((result.tv_nsec - 1) / (NSEC_PER_SEC / MSEC_PER_SEC)) + 1;
+        }
+    }
+    if (msec == 0) {
+        return thrd_timedout;
+    }
+
 	// Prepare to sleep-wait
     if (mtx_unlock(mutex) != thrd_success) {
         return thrd_error;
-    }
-	timespec_get(&now, TIME_UTC);
-    timespec_diff(time_point, &now, &result);
-    msec = result.tv_sec * MSEC_PER_SEC;
-    if (result.tv_nsec != 0) {
-        msec += ((result.tv_nsec - 1) / NSEC_PER_MSEC) + 1;
     }
 	osresult = Syscall_WaitForObject(*cond, msec);
-	if (osresult != OsSuccess) {
-		return thrd_timedout;
-	}
 	
 	// Last step is to acquire mutex again
-	return mtx_lock(mutex);
+	if (mtx_lock(mutex) != thrd_success) {
+        return thrd_error;
+    }
+	return (osresult == OsSuccess) ? thrd_success : thrd_timedout;
 }
@@ -250,6 +250,9 @@ tls_destroy(
     if (Tls->transfer_buffer != NULL) {
         DestroyBuffer(Tls->transfer_buffer);
     }
+
+    // Return the cached heap blocks of the thread
+    __malloc_thread_cleanup(Tls);
     return OsSuccess;
 }
 
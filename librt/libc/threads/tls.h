@@ -48,6 +48,7 @@ PACKED_TYPESTRUCT(thread_storage, {
     struct tm       tm_buffer;
     char            asc_buffer[26];
     DmaBuffer_t*    transfer_buffer;
+    void*           heap_cache;
     uintptr_t       tls_array[TLS_NUMBER_ENTRIES];
 
     // Exception & RTTI Support for msc++
@@ -86,6 +87,11 @@ CRTDECL(OsStatus_t,        tls_destroy(thread_storage_t *Tls));
  * Destroys the TLS for the specific thread
  * by freeing resources and calling c11 destructors. */
 CRTDECL(OsStatus_t,        tls_cleanup(thrd_t thr));
+
+/* __malloc_thread_cleanup
+ * Returns the heap blocks cached by the thread to its arena. 
+ * Called by tls_destroy, implemented by the allocator. */
+CRTDECL(void,              __malloc_thread_cleanup(thread_storage_t *Tls));
 _CODE_END
 
 #endif //!__STDC_TLS__
@@ -21,6 +21,7 @@
 
 /* Includes 
  * - Library */
+#include <os/sharedpage.h>
 #include <os/mollenos.h>
 #include <time.h>
 #include <stddef.h>
@@ -33,16 +34,28 @@ time_t
 time(time_t *timer)
 {
 	// Variables
+	SystemSharedPage_t *Page = GetSystemSharedPage();
 	struct tm TimeStruct;
 	time_t Converted = 0;
+	unsigned int Sequence;
 
-	// Check if a system clock is available
-	if (SystemTime(&TimeStruct) != OsSuccess) {
-		return 0;
+	// Advance the clock of the shared page by the ticks passed since it was read
+	if (Page != NULL && (Page->Flags & SHAREDPAGE_WALLCLOCK)) {
+		do {
+			Sequence	= SharedPageReadBegin(Page);
+			Converted	= (time_t)(Page->WallClock 
+				+ (int64_t)((Page->SystemTick - Page->WallClockTick) / CLOCKS_PER_SEC));
+		} while (SharedPageReadRetry(Page, Sequence));
 	}
+	else {
+		// Check if a system clock is available
+		if (SystemTime(&TimeStruct) != OsSuccess) {
+			return 0;
+		}
 
-	// Now convert the sys-time to time_t
-	Converted = mktime(&TimeStruct);
+		// Now convert the sys-time to time_t
+		Converted = mktime(&TimeStruct);
+	}
 	if (timer != NULL) {
 		*timer = Converted;
 	}
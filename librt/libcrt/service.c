@@ -33,31 +33,79 @@ __CrtInitialize(
     _In_  int               StartupInfoEnabled,
     _Out_ int*              ArgumentCount);
 
+#ifdef __SERVER_MULTITHREADED
+/* Server message slots
+ * Messages are received directly into a slot and handed to the threadpool
+ * from there, the slot is reused once its future has completed. */
+#define __SERVER_SLOTCOUNT 16
+typedef struct _CrtServiceSlot {
+    MRemoteCall_t       Message;
+    ThreadPoolFuture_t  Future;
+    int                 InUse;
+    char                Arguments[IPC_MAX_MESSAGELENGTH];
+} CrtServiceSlot_t;
+
 /* Server event entry point
- * Used in multi-threading environment as means to cleanup
- * all allocated resources properly */
+ * Used in multi-threading environment, the result of the
+ * event handler is returned through the slot's future. The worker
+ * handles the event at the priority of the sender. */
 int __CrtHandleEvent(void *Argument)
 {
-    // Initiate the message pointer
-    MRemoteCall_t *Message = (MRemoteCall_t*)Argument;
-    OsStatus_t Result = OnEvent(Message);
-    
-    // Cleanup and return result
-    free(Message);
-    return Result == OsSuccess ? 0 : -1;
+    // Variables
+    CrtServiceSlot_t *Slot = (CrtServiceSlot_t*)Argument;
+    OsStatus_t Status;
+
+    RPCInherit(&Slot->Message.From);
+    Status = OnEvent(&Slot->Message);
+    RPCInherit(NULL);
+    return Status == OsSuccess ? 0 : -1;
 }
 
+/* __CrtGetServiceSlot
+ * Returns the first slot that is unused or whose request has completed, so
+ * a slow request never holds up the ones received after it. Only when all
+ * slots are busy we block, and then on the oldest outstanding request. */
+static CrtServiceSlot_t*
+__CrtGetServiceSlot(
+    _In_ CrtServiceSlot_t*  Slots,
+    _In_ int*               Oldest)
+{
+    // Variables
+    CrtServiceSlot_t *Slot;
+    int i;
+
+    for (i = 0; i < __SERVER_SLOTCOUNT; i++) {
+        Slot = &Slots[i];
+        if (!Slot->InUse || ThreadPoolFutureIsComplete(&Slot->Future)) {
+            Slot->InUse = 0;
+            return Slot;
+        }
+    }
+
+    // Every slot is busy, wait for the oldest one to be handled
+    Slot    = &Slots[*Oldest];
+    *Oldest = (*Oldest + 1) % __SERVER_SLOTCOUNT;
+    ThreadPoolFutureWait(&Slot->Future, NULL);
+    Slot->InUse = 0;
+    return Slot;
+}
+#endif
+
 /* __CrtServiceEntry
  * Use this entry point for services. */
 void __CrtServiceEntry(void)
 {
     // Variables
     thread_storage_t            Tls;
-    MRemoteCall_t               Message;
 #ifdef __SERVER_MULTITHREADED
     ThreadPool_t *ThreadPool    = NULL;
-#endif
+    CrtServiceSlot_t *Slots     = NULL;
+    CrtServiceSlot_t *Slot;
+    int OldestSlot              = 0;
+#else
+    MRemoteCall_t               Message;
     char *ArgumentBuffer        = NULL;
+#endif
     int IsRunning               = 1;
 
     // Initialize environment
@@ -77,23 +125,30 @@ void __CrtServiceEntry(void)
         goto Cleanup;
     }
 
+    Slots = (CrtServiceSlot_t*)calloc(__SERVER_SLOTCOUNT, sizeof(CrtServiceSlot_t));
+    if (Slots == NULL) {
+        ThreadPoolDestroy(ThreadPool);
+        OnUnload();
+        goto Cleanup;
+    }
+
     // Initialize the server event loop
     while (IsRunning) {
-        if (RPCListen(&Message) == OsSuccess) {
-            MRemoteCall_t *RpcCopy = (MRemoteCall_t*)malloc(sizeof(MRemoteCall_t));
-            memcpy(RpcCopy, &Message, sizeof(MRemoteCall_t));
-            ThreadPoolAddWork(ThreadPool, __CrtHandleEvent, RpcCopy);
+        Slot = __CrtGetServiceSlot(Slots, &OldestSlot);
+        if (RPCListen(&Slot->Message, &Slot->Arguments[0]) == OsSuccess) {
+            ThreadPoolFutureInitialize(&Slot->Future);
+            if (ThreadPoolAddWorkEx(ThreadPool, __CrtHandleEvent, Slot, &Slot->Future) == OsSuccess) {
+                Slot->InUse = 1;
+            }
         }
-        else {}
     }
 
     // Wait for threads to finish
-    if (ThreadPoolGetWorkingCount(ThreadPool) != 0) {
-        ThreadPoolWait(ThreadPool);
-    }
+    ThreadPoolWait(ThreadPool);
 
     // Destroy thread-pool
     ThreadPoolDestroy(ThreadPool);
+    free(Slots);
 
 #else
     // Initialize the server event loop
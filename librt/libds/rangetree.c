@@ -0,0 +1,665 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - Generic Range Tree Implementation
+ * - Balanced tree of address ranges that together cover the managed space. Each
+ *   range carries attributes (0 means free), neighbours with equal attributes
+ *   are always merged. Lookups, allocations and updates are O(log n).
+ */
+
+#include <ds/rangetree.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+/* An update of a range can at most split two existing ranges, the nodes are
+ * allocated before the lock is taken and released nodes are freed after. */
+#define RANGE_TREE_MAX_SPLITS           2
+
+typedef struct _RangeTreeContext {
+    RangeTreeNode_t*    Spare[RANGE_TREE_MAX_SPLITS];
+    RangeTreeNode_t*    Released;
+} RangeTreeContext_t;
+
+/* RangeTreeHeight
+ * Helpers for reading the balance information of optional nodes */
+static int
+RangeTreeHeight(
+    _In_ RangeTreeNode_t*   Node)
+{
+    return (Node != NULL) ? Node->Height : 0;
+}
+
+static size_t
+RangeTreeLargestFree(
+    _In_ RangeTreeNode_t*   Node)
+{
+    return (Node != NULL) ? Node->LargestFree : 0;
+}
+
+/* RangeTreeUpdateNode
+ * Recalculates the height and the largest free range of the node from its children */
+static void
+RangeTreeUpdateNode(
+    _In_ RangeTreeNode_t*   Node)
+{
+    size_t Largest = (Node->Attributes == RANGE_FREE) ? Node->Length : 0;
+    Largest             = MAX(Largest, RangeTreeLargestFree(Node->Left));
+    Node->LargestFree   = MAX(Largest, RangeTreeLargestFree(Node->Right));
+    Node->Height        = 1 + MAX(RangeTreeHeight(Node->Left), RangeTreeHeight(Node->Right));
+}
+
+/* RangeTreeRotateLeft
+ * Rotates the right child up to take the place of the node */
+static RangeTreeNode_t*
+RangeTreeRotateLeft(
+    _In_ RangeTreeNode_t*   Node)
+{
+    RangeTreeNode_t *Pivot  = Node->Right;
+    Node->Right             = Pivot->Left;
+    Pivot->Left             = Node;
+    RangeTreeUpdateNode(Node);
+    RangeTreeUpdateNode(Pivot);
+    return Pivot;
+}
+
+/* RangeTreeRotateRight
+ * Rotates the left child up to take the place of the node */
+static RangeTreeNode_t*
+RangeTreeRotateRight(
+    _In_ RangeTreeNode_t*   Node)
+{
+    RangeTreeNode_t *Pivot  = Node->Left;
+    Node->Left              = Pivot->Right;
+    Pivot->Right            = Node;
+    RangeTreeUpdateNode(Node);
+    RangeTreeUpdateNode(Pivot);
+    return Pivot;
+}
+
+/* RangeTreeBalance
+ * Restores the avl property of the subtree and returns the new subtree root */
+static RangeTreeNode_t*
+RangeTreeBalance(
+    _In_ RangeTreeNode_t*   Node)
+{
+    int Balance;
+
+    RangeTreeUpdateNode(Node);
+    Balance = RangeTreeHeight(Node->Left) - RangeTreeHeight(Node->Right);
+    if (Balance > 1) {
+        if (RangeTreeHeight(Node->Left->Left) < RangeTreeHeight(Node->Left->Right)) {
+            Node->Left = RangeTreeRotateLeft(Node->Left);
+        }
+        return RangeTreeRotateRight(Node);
+    }
+    else if (Balance < -1) {
+        if (RangeTreeHeight(Node->Right->Right) < RangeTreeHeight(Node->Right->Left)) {
+            Node->Right = RangeTreeRotateRight(Node->Right);
+        }
+        return RangeTreeRotateLeft(Node);
+    }
+    return Node;
+}
+
+/* RangeTreeInsertNode
+ * Inserts the node into the subtree ordered by start address */
+static RangeTreeNode_t*
+RangeTreeInsertNode(
+    _In_ RangeTreeNode_t*   Root,
+    _In_ RangeTreeNode_t*   Node)
+{
+    if (Root == NULL) {
+        Node->Left  = NULL;
+        Node->Right = NULL;
+        RangeTreeUpdateNode(Node);
+        return Node;
+    }
+
+    if (Node->Start < Root->Start) {
+        Root->Left  = RangeTreeInsertNode(Root->Left, Node);
+    }
+    else {
+        Root->Right = RangeTreeInsertNode(Root->Right, Node);
+    }
+    return RangeTreeBalance(Root);
+}
+
+/* RangeTreeRemoveMinimum
+ * Unlinks the node with the lowest start address from the subtree */
+static RangeTreeNode_t*
+RangeTreeRemoveMinimum(
+    _In_  RangeTreeNode_t*  Root,
+    _Out_ RangeTreeNode_t** Minimum)
+{
+    if (Root->Left == NULL) {
+        *Minimum = Root;
+        return Root->Right;
+    }
+    Root->Left = RangeTreeRemoveMinimum(Root->Left, Minimum);
+    return RangeTreeBalance(Root);
+}
+
+/* RangeTreeRemoveNode
+ * Unlinks the node that starts at the given address from the subtree */
+static RangeTreeNode_t*
+RangeTreeRemoveNode(
+    _In_  RangeTreeNode_t*  Root,
+    _In_  uintptr_t         Start,
+    _Out_ RangeTreeNode_t** Removed)
+{
+    RangeTreeNode_t *Minimum = NULL;
+    RangeTreeNode_t *Right;
+
+    if (Root == NULL) {
+        return NULL;
+    }
+
+    if (Start < Root->Start) {
+        Root->Left  = RangeTreeRemoveNode(Root->Left, Start, Removed);
+    }
+    else if (Start > Root->Start) {
+        Root->Right = RangeTreeRemoveNode(Root->Right, Start, Removed);
+    }
+    else {
+        *Removed = Root;
+        if (Root->Right == NULL) {
+            return Root->Left;
+        }
+
+        // Replace the node with its successor
+        Right           = RangeTreeRemoveMinimum(Root->Right, &Minimum);
+        Minimum->Left   = Root->Left;
+        Minimum->Right  = Right;
+        return RangeTreeBalance(Minimum);
+    }
+    return RangeTreeBalance(Root);
+}
+
+/* RangeTreeRefresh
+ * Recalculates the free information on the path to a node that was modified in place */
+static void
+RangeTreeRefresh(
+    _In_ RangeTreeNode_t*   Root,
+    _In_ uintptr_t          Start)
+{
+    if (Root == NULL) {
+        return;
+    }
+
+    if (Start < Root->Start) {
+        RangeTreeRefresh(Root->Left, Start);
+    }
+    else if (Start > Root->Start) {
+        RangeTreeRefresh(Root->Right, Start);
+    }
+    RangeTreeUpdateNode(Root);
+}
+
+/* RangeTreeFind
+ * Locates the range that contains the address */
+static RangeTreeNode_t*
+RangeTreeFind(
+    _In_ RangeTreeNode_t*   Root,
+    _In_ uintptr_t          Address)
+{
+    while (Root != NULL) {
+        if (Address < Root->Start) {
+            Root = Root->Left;
+        }
+        else if (Address >= (Root->Start + Root->Length)) {
+            Root = Root->Right;
+        }
+        else {
+            break;
+        }
+    }
+    return Root;
+}
+
+/* RangeTreeFindFree
+ * Locates the free range with the lowest address that can hold <Length> bytes */
+static RangeTreeNode_t*
+RangeTreeFindFree(
+    _In_ RangeTreeNode_t*   Root,
+    _In_ size_t             Length)
+{
+    while (Root != NULL) {
+        if (RangeTreeLargestFree(Root->Left) >= Length) {
+            Root = Root->Left;
+        }
+        else if (Root->Attributes == RANGE_FREE && Root->Length >= Length) {
+            break;
+        }
+        else if (RangeTreeLargestFree(Root->Right) >= Length) {
+            Root = Root->Right;
+        }
+        else {
+            return NULL;
+        }
+    }
+    return Root;
+}
+
+/* RangeTreeCreateContext
+ * Allocates the nodes an update might need, must be done without the lock held */
+static OsStatus_t
+RangeTreeCreateContext(
+    _In_ RangeTreeContext_t*    Context)
+{
+    int i;
+
+    memset(Context, 0, sizeof(RangeTreeContext_t));
+    for (i = 0; i < RANGE_TREE_MAX_SPLITS; i++) {
+        Context->Spare[i] = (RangeTreeNode_t*)dsalloc(sizeof(RangeTreeNode_t));
+        if (Context->Spare[i] == NULL) {
+            return OsError;
+        }
+    }
+    return OsSuccess;
+}
+
+/* RangeTreeDestroyContext
+ * Frees the nodes that were not needed or have been released by the update */
+static void
+RangeTreeDestroyContext(
+    _In_ RangeTreeContext_t*    Context)
+{
+    int i;
+
+    for (i = 0; i < RANGE_TREE_MAX_SPLITS; i++) {
+        if (Context->Spare[i] != NULL) {
+            dsfree(Context->Spare[i]);
+        }
+    }
+    while (Context->Released != NULL) {
+        RangeTreeNode_t *Node   = Context->Released;
+        Context->Released       = Node->Left;
+        dsfree(Node);
+    }
+}
+
+/* RangeTreeUnlink
+ * Removes the node that starts at the address and queues it for release */
+static RangeTreeNode_t*
+RangeTreeUnlink(
+    _In_ RangeTree_t*           Tree,
+    _In_ RangeTreeContext_t*    Context,
+    _In_ uintptr_t              Start)
+{
+    RangeTreeNode_t *Removed = NULL;
+
+    Tree->Root = RangeTreeRemoveNode(Tree->Root, Start, &Removed);
+    assert(Removed != NULL);
+    Removed->Left       = Context->Released;
+    Context->Released   = Removed;
+    Tree->NumberOfRanges--;
+    return Removed;
+}
+
+/* RangeTreeSplit
+ * Makes sure that a range starts at the given address */
+static void
+RangeTreeSplit(
+    _In_ RangeTree_t*           Tree,
+    _In_ RangeTreeContext_t*    Context,
+    _In_ uintptr_t              Address)
+{
+    RangeTreeNode_t *Node   = RangeTreeFind(Tree->Root, Address);
+    RangeTreeNode_t *Split  = NULL;
+    int i;
+
+    assert(Node != NULL);
+    if (Node->Start == Address) {
+        return;
+    }
+
+    for (i = 0; i < RANGE_TREE_MAX_SPLITS && Split == NULL; i++) {
+        Split               = Context->Spare[i];
+        Context->Spare[i]   = NULL;
+    }
+    assert(Split != NULL);
+
+    Split->Start        = Address;
+    Split->Length       = (Node->Start + Node->Length) - Address;
+    Split->Attributes   = Node->Attributes;
+    Node->Length        = Address - Node->Start;
+    RangeTreeRefresh(Tree->Root, Node->Start);
+    Tree->Root = RangeTreeInsertNode(Tree->Root, Split);
+    Tree->NumberOfRanges++;
+}
+
+/* RangeTreeValidate
+ * Normalizes the range to the granularity and verifies that every part of it is
+ * either free or allocated. Returns the number of bytes allocated in the range. */
+static OsStatus_t
+RangeTreeValidate(
+    _In_    RangeTree_t*    Tree,
+    _InOut_ uintptr_t*      Address,
+    _InOut_ size_t*         Length,
+    _In_    int             Free,
+    _Out_   size_t*         Allocated)
+{
+    uintptr_t Start, End, Cursor;
+
+    if (*Length == 0 || *Address < Tree->RangeStart || *Address >= Tree->RangeEnd
+        || *Length > (Tree->RangeEnd - *Address)) {
+        return OsError;
+    }
+    Start   = *Address - ((*Address - Tree->RangeStart) % Tree->Granularity);
+    End     = *Address + *Length;
+    if ((End - Tree->RangeStart) % Tree->Granularity) {
+        End += Tree->Granularity - ((End - Tree->RangeStart) % Tree->Granularity);
+    }
+
+    *Allocated = 0;
+    for (Cursor = Start; Cursor < End; ) {
+        RangeTreeNode_t *Node   = RangeTreeFind(Tree->Root, Cursor);
+        uintptr_t NodeEnd;
+        if (Node == NULL || (Node->Attributes == RANGE_FREE) != (Free != 0)) {
+            return OsError;
+        }
+        NodeEnd = Node->Start + Node->Length;
+        if (Node->Attributes != RANGE_FREE) {
+            *Allocated += MIN(End, NodeEnd) - Cursor;
+        }
+        Cursor = NodeEnd;
+    }
+
+    *Address    = Start;
+    *Length     = End - Start;
+    return OsSuccess;
+}
+
+/* RangeTreeApply
+ * Assigns the attributes to an exact range, splitting the ranges at the edges and
+ * merging everything inside and the neighbours with equal attributes */
+static void
+RangeTreeApply(
+    _In_ RangeTree_t*           Tree,
+    _In_ RangeTreeContext_t*    Context,
+    _In_ uintptr_t              Address,
+    _In_ size_t                 Length,
+    _In_ Flags_t                Attributes)
+{
+    RangeTreeNode_t *Range  = NULL;
+    RangeTreeNode_t *Node   = NULL;
+    uintptr_t End           = Address + Length;
+
+    RangeTreeSplit(Tree, Context, Address);
+    if (End < Tree->RangeEnd) {
+        RangeTreeSplit(Tree, Context, End);
+    }
+
+    // Absorb everything covered by the range into the first node
+    Range = RangeTreeFind(Tree->Root, Address);
+    while ((Range->Start + Range->Length) < End) {
+        Node = RangeTreeUnlink(Tree, Context, Range->Start + Range->Length);
+        Range->Length += Node->Length;
+    }
+    Range->Attributes = Attributes;
+    RangeTreeRefresh(Tree->Root, Range->Start);
+
+    // Merge with the neighbours
+    if (Range->Start > Tree->RangeStart) {
+        Node = RangeTreeFind(Tree->Root, Range->Start - 1);
+        if (Node->Attributes == Attributes) {
+            RangeTreeUnlink(Tree, Context, Range->Start);
+            Node->Length += Range->Length;
+            RangeTreeRefresh(Tree->Root, Node->Start);
+            Range = Node;
+        }
+    }
+    if ((Range->Start + Range->Length) < Tree->RangeEnd) {
+        Node = RangeTreeFind(Tree->Root, Range->Start + Range->Length);
+        if (Node->Attributes == Attributes) {
+            RangeTreeUnlink(Tree, Context, Node->Start);
+            Range->Length += Node->Length;
+            RangeTreeRefresh(Tree->Root, Range->Start);
+        }
+    }
+}
+
+/* RangeTreeUpdate
+ * Shared implementation of reserve, protect and release */
+static OsStatus_t
+RangeTreeUpdate(
+    _In_      RangeTree_t*  Tree,
+    _In_      uintptr_t     Address,
+    _In_      size_t        Length,
+    _In_      Flags_t       Attributes,
+    _In_      int           Free,
+    _Out_Opt_ Flags_t*      PreviousAttributes)
+{
+    RangeTreeContext_t Context;
+    OsStatus_t Status;
+    size_t Allocated;
+
+    assert(Tree != NULL);
+    if (RangeTreeCreateContext(&Context) != OsSuccess) {
+        RangeTreeDestroyContext(&Context);
+        return OsError;
+    }
+
+    dslock(&Tree->SyncObject);
+    Status = RangeTreeValidate(Tree, &Address, &Length, Free, &Allocated);
+    if (Status == OsSuccess) {
+        if (PreviousAttributes != NULL) {
+            *PreviousAttributes = RangeTreeFind(Tree->Root, Address)->Attributes;
+        }
+        RangeTreeApply(Tree, &Context, Address, Length, Attributes);
+        Tree->BytesAllocated -= Allocated;
+        if (Attributes != RANGE_FREE) {
+            Tree->BytesAllocated += Length;
+        }
+    }
+    dsunlock(&Tree->SyncObject);
+    RangeTreeDestroyContext(&Context);
+    return Status;
+}
+
+/* CreateRangeTree
+ * Creates a new range tree that covers the given space. The entire space is free
+ * initially, all ranges are rounded to the granularity. */
+OsStatus_t
+CreateRangeTree(
+    _In_  uintptr_t         RangeStart,
+    _In_  uintptr_t         RangeEnd,
+    _In_  size_t            Granularity,
+    _Out_ RangeTree_t**     Tree)
+{
+    // Variables
+    RangeTree_t *Pointer    = NULL;
+    RangeTreeNode_t *Node   = NULL;
+
+    assert(Tree != NULL);
+    assert(Granularity != 0);
+    RangeEnd -= (RangeEnd - RangeStart) % Granularity;
+    if (RangeEnd <= RangeStart) {
+        return OsError;
+    }
+
+    Pointer = (RangeTree_t*)dsalloc(sizeof(RangeTree_t));
+    Node    = (RangeTreeNode_t*)dsalloc(sizeof(RangeTreeNode_t));
+    if (Pointer == NULL || Node == NULL) {
+        if (Pointer != NULL) {
+            dsfree(Pointer);
+        }
+        if (Node != NULL) {
+            dsfree(Node);
+        }
+        return OsError;
+    }
+
+    // The space starts out as one free range
+    memset(Pointer, 0, sizeof(RangeTree_t));
+    memset(Node, 0, sizeof(RangeTreeNode_t));
+    Node->Start             = RangeStart;
+    Node->Length            = RangeEnd - RangeStart;
+    Node->Attributes        = RANGE_FREE;
+    RangeTreeUpdateNode(Node);
+
+    Pointer->Root           = Node;
+    Pointer->RangeStart     = RangeStart;
+    Pointer->RangeEnd       = RangeEnd;
+    Pointer->Granularity    = Granularity;
+    Pointer->NumberOfRanges = 1;
+    *Tree = Pointer;
+    return OsSuccess;
+}
+
+/* DestroyRangeTree
+ * Destroys the range tree and releases all resources associated */
+OsStatus_t
+DestroyRangeTree(
+    _In_ RangeTree_t*       Tree)
+{
+    assert(Tree != NULL);
+
+    // Flatten the tree by rotating left children up, then free the chain
+    while (Tree->Root != NULL) {
+        RangeTreeNode_t *Node = Tree->Root;
+        if (Node->Left != NULL) {
+            Tree->Root  = Node->Left;
+            Node->Left  = Tree->Root->Right;
+            Tree->Root->Right = Node;
+        }
+        else {
+            Tree->Root  = Node->Right;
+            dsfree(Node);
+        }
+    }
+    dsfree(Tree);
+    return OsSuccess;
+}
+
+/* RangeTreeAllocate
+ * Allocates the first free range large enough and assigns it the given
+ * (non-zero) attributes. Returns the start of the range in <Address>. */
+OsStatus_t
+RangeTreeAllocate(
+    _In_  RangeTree_t*      Tree,
+    _In_  size_t            Length,
+    _In_  Flags_t           Attributes,
+    _Out_ uintptr_t*        Address)
+{
+    RangeTreeContext_t Context;
+    RangeTreeNode_t *Node;
+
+    assert(Tree != NULL);
+    assert(Address != NULL);
+    if (Length == 0 || Attributes == RANGE_FREE) {
+        return OsError;
+    }
+    Length = DIVUP(Length, Tree->Granularity) * Tree->Granularity;
+
+    if (RangeTreeCreateContext(&Context) != OsSuccess) {
+        RangeTreeDestroyContext(&Context);
+        return OsError;
+    }
+
+    dslock(&Tree->SyncObject);
+    Node = RangeTreeFindFree(Tree->Root, Length);
+    if (Node != NULL) {
+        *Address = Node->Start;
+        RangeTreeApply(Tree, &Context, Node->Start, Length, Attributes);
+        Tree->BytesAllocated += Length;
+    }
+    dsunlock(&Tree->SyncObject);
+    RangeTreeDestroyContext(&Context);
+    return (Node != NULL) ? OsSuccess : OsError;
+}
+
+/* RangeTreeReserve
+ * Assigns the given (non-zero) attributes to a fixed range, the entire range
+ * must be free. */
+OsStatus_t
+RangeTreeReserve(
+    _In_ RangeTree_t*       Tree,
+    _In_ uintptr_t          Address,
+    _In_ size_t             Length,
+    _In_ Flags_t            Attributes)
+{
+    if (Attributes == RANGE_FREE) {
+        return OsError;
+    }
+    return RangeTreeUpdate(Tree, Address, Length, Attributes, 1, NULL);
+}
+
+/* RangeTreeSetAttributes
+ * Changes the attributes of a part of the allocated space, the range is split
+ * from its neighbours if needed. The entire range must be allocated. The
+ * previous attributes of the first part of the range are returned. */
+OsStatus_t
+RangeTreeSetAttributes(
+    _In_      RangeTree_t*  Tree,
+    _In_      uintptr_t     Address,
+    _In_      size_t        Length,
+    _In_      Flags_t       Attributes,
+    _Out_Opt_ Flags_t*      PreviousAttributes)
+{
+    if (Attributes == RANGE_FREE) {
+        return OsError;
+    }
+    return RangeTreeUpdate(Tree, Address, Length, Attributes, 0, PreviousAttributes);
+}
+
+/* RangeTreeRelease
+ * Frees a part of the allocated space, partial releases are allowed. The
+ * entire range must be allocated. */
+OsStatus_t
+RangeTreeRelease(
+    _In_ RangeTree_t*       Tree,
+    _In_ uintptr_t          Address,
+    _In_ size_t             Length)
+{
+    return RangeTreeUpdate(Tree, Address, Length, RANGE_FREE, 0, NULL);
+}
+
+/* RangeTreeLookup
+ * Looks up the allocated range that contains the address. Returns OsError if the
+ * address is outside the tree or not allocated. */
+OsStatus_t
+RangeTreeLookup(
+    _In_      RangeTree_t*  Tree,
+    _In_      uintptr_t     Address,
+    _Out_Opt_ uintptr_t*    Start,
+    _Out_Opt_ size_t*       Length,
+    _Out_Opt_ Flags_t*      Attributes)
+{
+    RangeTreeNode_t *Node;
+    OsStatus_t Status = OsError;
+
+    assert(Tree != NULL);
+    dslock(&Tree->SyncObject);
+    Node = RangeTreeFind(Tree->Root, Address);
+    if (Node != NULL && Node->Attributes != RANGE_FREE) {
+        if (Start != NULL) {
+            *Start = Node->Start;
+        }
+        if (Length != NULL) {
+            *Length = Node->Length;
+        }
+        if (Attributes != NULL) {
+            *Attributes = Node->Attributes;
+        }
+        Status = OsSuccess;
+    }
+    dsunlock(&Tree->SyncObject);
+    return Status;
+}
@@ -98,6 +98,7 @@ UsbTransferInitialize(
 OsStatus_t
 UsbTransferSetup(
     _In_ UsbTransfer_t*             Transfer,
+    _In_ const void*                SetupPacket,
     _In_ uintptr_t                  SetupAddress,
     _In_ uintptr_t                  DataAddress,
     _In_ size_t                     DataLength,
@@ -114,6 +115,7 @@ UsbTransferSetup(
     Transfer->Transactions[0].Type          = SetupTransaction;
     Transfer->Transactions[0].BufferAddress = SetupAddress;
     Transfer->Transactions[0].Length        = sizeof(UsbPacket_t);
+    memcpy(&Transfer->SetupPacket[0], SetupPacket, sizeof(UsbPacket_t));
 
     // Is there a data-stage?
     if (DataAddress != 0) {
@@ -251,6 +253,32 @@ UsbTransferQueue(
         NULL, 0, Result, sizeof(UsbTransferResult_t));
 }
 
+/* UsbTransferDequeue 
+ * Cancels a control or bulk transfer that is blocked in UsbTransferQueue, the
+ * transfer is matched by its address, stream and buffer. The blocked call then
+ * returns with TransferCancelled. Returns TransferFinished on success. */
+UsbTransferStatus_t
+UsbTransferDequeue(
+	_In_ UUId_t                     Driver,
+	_In_ UUId_t                     Device,
+	_In_ UsbTransfer_t*             Transfer)
+{
+    // Variables
+    UsbTransferStatus_t Result = TransferNotProcessed;
+    MContract_t Contract;
+
+    // Setup contract stuff for request
+    Contract.DriverId   = Driver;
+    Contract.Type       = ContractController;
+    Contract.Version    = __USBMANAGER_INTERFACE_VERSION;
+    if (QueryDriver(&Contract, __USBHOST_DEQUEUETRANSFER,
+        &Device, sizeof(UUId_t), Transfer, sizeof(UsbTransfer_t), 
+        NULL, 0, &Result, sizeof(UsbTransferStatus_t)) != OsSuccess) {
+        return TransferInvalid;
+    }
+    return Result;
+}
+
 /* UsbTransferQueuePeriodic 
  * Queues a new Interrupt or Isochronous transfer. This transfer is 
  * persistant untill device is disconnected or Dequeue is called. 
@@ -441,7 +469,7 @@ UsbSetAddress(
     UsbTransferInitialize(&Transfer, UsbDevice, Endpoint, ControlTransfer, 0);
 
     // SetAddress does not have a data-stage
-    UsbTransferSetup(&Transfer, PacketPhysical, 0, 0, InTransaction);
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, 0, 0, InTransaction);
     
     // Execute the transaction and cleanup the buffer
     if (UsbTransferQueue(Driver, Device, &Transfer, &Result) != OsSuccess) {
@@ -508,7 +536,7 @@ UsbGetDeviceDescriptor(
     // Setup, In (Data) and Out (ACK)
     UsbTransferInitialize(&Transfer, UsbDevice, 
         Endpoint, ControlTransfer, 0);
-    UsbTransferSetup(&Transfer, PacketPhysical, 
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, 
         DescriptorPhysical, DESCRIPTOR_SIZE, InTransaction);
 
     // Execute the transaction and cleanup the buffer
@@ -585,7 +613,7 @@ UsbGetInitialConfigDescriptor(
     // Setup, In (Data) and Out (ACK)
     UsbTransferInitialize(&Transfer, UsbDevice, 
         Endpoint, ControlTransfer, 0);
-    UsbTransferSetup(&Transfer, PacketPhysical, DescriptorPhysical, 
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, DescriptorPhysical, 
         sizeof(UsbConfigDescriptor_t), InTransaction);
 
     // Execute the transaction and cleanup the buffer
@@ -669,7 +697,7 @@ UsbGetConfigDescriptor(
     // Setup, In (Data) and Out (ACK)
     UsbTransferInitialize(&Transfer, UsbDevice, 
         Endpoint, ControlTransfer, 0);
-    UsbTransferSetup(&Transfer, PacketPhysical, DescriptorPhysical, 
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, DescriptorPhysical, 
         ConfigDescriptorBufferLength, InTransaction);
 
     // Execute the transaction and cleanup the buffer
@@ -728,7 +756,7 @@ UsbSetConfiguration(
     UsbTransferInitialize(&Transfer, UsbDevice, Endpoint, ControlTransfer, 0);
 
     // SetConfiguration does not have a data-stage
-    UsbTransferSetup(&Transfer, PacketPhysical, 0, 0, InTransaction);
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, 0, 0, InTransaction);
     
     // Execute the transaction and cleanup the buffer
     if (UsbTransferQueue(Driver, Device, &Transfer, &Result) != OsSuccess) {
@@ -794,7 +822,7 @@ UsbGetStringLanguages(
     // Setup, In (Data) and Out (ACK)
     UsbTransferInitialize(&Transfer, UsbDevice, 
         Endpoint, ControlTransfer, 0);
-    UsbTransferSetup(&Transfer, PacketPhysical, DescriptorPhysical, 
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, DescriptorPhysical, 
         sizeof(UsbStringDescriptor_t), InTransaction);
 
     // Execute the transaction and cleanup the buffer
@@ -870,7 +898,7 @@ UsbGetStringDescriptor(
     // Setup, In (Data) and Out (ACK)
     UsbTransferInitialize(&Transfer, UsbDevice, 
         Endpoint, ControlTransfer, 0);
-    UsbTransferSetup(&Transfer, PacketPhysical, DescriptorPhysical, 
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, DescriptorPhysical, 
         64, InTransaction);
 
     // Execute the transaction and cleanup the buffer
@@ -933,7 +961,7 @@ UsbClearFeature(
     UsbTransferInitialize(&Transfer, UsbDevice, Endpoint, ControlTransfer, 0);
 
     // ClearFeature does not have a data-stage
-    UsbTransferSetup(&Transfer, PacketPhysical, 0, 0, InTransaction);
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, 0, 0, InTransaction);
     
     // Execute the transaction and cleanup the buffer
     if (UsbTransferQueue(Driver, Device, &Transfer, &Result) != OsSuccess) {
@@ -985,7 +1013,7 @@ UsbSetFeature(
     UsbTransferInitialize(&Transfer, UsbDevice, Endpoint, ControlTransfer, 0);
 
     // SetFeature does not have a data-stage
-    UsbTransferSetup(&Transfer, PacketPhysical, 0, 0, InTransaction);
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, 0, 0, InTransaction);
     
     // Execute the transaction and cleanup the buffer
     if (UsbTransferQueue(Driver, Device, &Transfer, &Result) != OsSuccess) {
@@ -1062,7 +1090,7 @@ UsbExecutePacket(
 
     // Initialize setup transfer
     UsbTransferInitialize(&Transfer, UsbDevice, Endpoint, ControlTransfer, 0);
-    UsbTransferSetup(&Transfer, PacketPhysical, DescriptorPhysical, Length, DataStageType);
+    UsbTransferSetup(&Transfer, Packet, PacketPhysical, DescriptorPhysical, Length, DataStageType);
 
     // Execute the transaction and cleanup the buffer
     if (UsbTransferQueue(Driver, Device, &Transfer, &Result) != OsSuccess) {
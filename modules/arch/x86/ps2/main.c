@@ -273,6 +273,10 @@ OnLoad(void)
         return OsError;
     }
 
+    // Interrupts are handled on this thread, so keep the
+    // keyboard and mouse ahead of normal work
+    SetCurrentThreadRealtime(1);
+
     // Initialize the ps2-contract
     InitializeContract(&GlbController->Controller, UUID_INVALID, 1,
         ContractController, "PS2 Controller Interface");
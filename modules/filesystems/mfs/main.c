@@ -48,11 +48,23 @@ FsOpenFile(
     // Instantiate the pointers
     Mfs = (MfsInstance_t*)Descriptor->ExtensionData;
 
-    // Try to locate the given file-record
-    Result = MfsLocateRecord(Descriptor, Mfs->MasterRecord.RootIndex, 
-        Path, &fInformation);
-    if (Result != FsOk) {
-        return Result;
+    // The root directory has no record, describe it from the master-record
+    if (MStringLength(Path) == 0) {
+        fInformation                    = (MfsFile_t*)malloc(sizeof(MfsFile_t));
+        memset((void*)fInformation, 0, sizeof(MfsFile_t));
+        fInformation->Name              = MStringCreate((void*)"/", StrUTF8);
+        fInformation->Flags             = MFS_FILERECORD_DIRECTORY | MFS_FILERECORD_INUSE;
+        fInformation->StartBucket       = Mfs->MasterRecord.RootIndex;
+        fInformation->StartLength       = MFS_ROOTSIZE;
+        fInformation->DirectoryBucket   = MFS_ENDOFCHAIN;
+    }
+    else {
+        // Try to locate the given file-record
+        Result = MfsLocateRecord(Descriptor, Mfs->MasterRecord.RootIndex, 
+            Path, &fInformation);
+        if (Result != FsOk) {
+            return Result;
+        }
     }
 
     // Fill out information in _out_
@@ -84,8 +96,8 @@ FsCreateFile(
     Mfs = (MfsInstance_t*)Descriptor->ExtensionData;
 
     // Create the record
-    Result = MfsCreateRecord(Descriptor, Mfs->MasterRecord.RootIndex,
-        Path, Options, &fInformation);
+    Result = MfsCreateRecord(Descriptor, Mfs->MasterRecord.RootIndex, Path, 
+        (Options & FILE_FLAG_DIRECTORY) ? MFS_FILERECORD_DIRECTORY : MFS_FILERECORD_FILE, &fInformation);
     if (Result != FsOk) {
         return Result;
     }
@@ -312,6 +324,103 @@ FsReadFile(
     return Result;
 }
 
+/* FsReadDirectory 
+ * Reads as many directory entries as fits into <Length> bytes of the buffer,
+ * starting at the handle position. The handle position is the index of the next
+ * record in the directory chain, so unused records are skipped only once */
+FileSystemCode_t
+FsReadDirectory(
+    _In_  FileSystemDescriptor_t*   Descriptor,
+    _In_  FileSystemFileHandle_t*   Handle,
+    _In_  DmaBuffer_t*              BufferObject,
+    _In_  size_t                    Length,
+    _Out_ size_t*                   BytesRead)
+{
+    // Variables
+    MfsFile_t *fInformation         = NULL;
+    MfsInstance_t *Mfs              = NULL;
+    uint8_t *Output                 = NULL;
+    uint32_t CurrentBucket          = 0;
+    uint64_t RecordBase             = 0;
+
+    // Trace
+    TRACE("FsReadDirectory(Id 0x%x, Position %u, Length %u)",
+        Handle->Id, LODWORD(Handle->Position), Length);
+
+    // Instantiate the pointers
+    Mfs             = (MfsInstance_t*)Descriptor->ExtensionData;
+    fInformation    = (MfsFile_t*)Handle->File->ExtensionData;
+    Output          = (uint8_t*)GetBufferDataPointer(BufferObject);
+    Length          = MIN(Length, GetBufferSize(BufferObject));
+    CurrentBucket   = fInformation->StartBucket;
+    *BytesRead      = 0;
+
+    if (MFS_FILERECORD_TYPE(fInformation->Flags) != MFS_FILERECORD_DIRECTORY) {
+        return FsPathIsNotDirectory;
+    }
+
+    // Walk the directory chain, links that were consumed by earlier
+    // reads are skipped by their length without touching the disk
+    while (CurrentBucket != MFS_ENDOFCHAIN) {
+        FileRecord_t *Record = NULL;
+        size_t RecordCount;
+        MapRecord_t Link;
+        size_t i;
+
+        if (MfsGetBucketLink(Descriptor, CurrentBucket, &Link) != OsSuccess) {
+            ERROR("Failed to get length of bucket %u", CurrentBucket);
+            return FsDiskError;
+        }
+
+        // A record spans two sectors
+        RecordCount = (Mfs->SectorsPerBucket * Link.Length) / 2;
+        if (Handle->Position >= RecordBase + RecordCount) {
+            RecordBase      += RecordCount;
+            CurrentBucket    = Link.Link;
+            continue;
+        }
+
+        if (MfsReadSectors(Descriptor, Mfs->TransferBuffer, MFS_GETSECTOR(Mfs, CurrentBucket), 
+            Mfs->SectorsPerBucket * Link.Length) != OsSuccess) {
+            ERROR("Failed to read directory-bucket %u", CurrentBucket);
+            return FsDiskError;
+        }
+
+        Record = (FileRecord_t*)GetBufferDataPointer(Mfs->TransferBuffer);
+        for (i = (size_t)(Handle->Position - RecordBase); i < RecordCount; i++) {
+            DirectoryEntry_t *Entry;
+            size_t NameLength;
+            size_t EntryLength;
+
+            if (!(Record[i].Flags & MFS_FILERECORD_INUSE)) {
+                Handle->Position++;
+                continue;
+            }
+
+            // Stop when the entry does not fit, it is returned by the next read. Only
+            // fail if not even a single entry fits the buffer
+            NameLength  = strnlen((const char*)&Record[i].Name[0], sizeof(Record[i].Name) - 1);
+            EntryLength = DIRECTORY_ENTRY_LENGTH(NameLength);
+            if ((*BytesRead + EntryLength) > Length) {
+                return (*BytesRead == 0) ? FsInvalidParameters : FsOk;
+            }
+
+            Entry = (DirectoryEntry_t*)(Output + *BytesRead);
+            memset((void*)Entry, 0, EntryLength);
+            MfsRecordToDescriptor(Descriptor, &Record[i], &Entry->Information);
+            memcpy(&Entry->Name[0], &Record[i].Name[0], NameLength);
+            Entry->Length   = EntryLength;
+            Entry->Position = (int)(Handle->Position + 1);
+            *BytesRead     += EntryLength;
+            Handle->Position++;
+        }
+        RecordBase      += RecordCount;
+        CurrentBucket    = Link.Link;
+    }
+    TRACE(" > bytes read %u/%u", *BytesRead, Length);
+    return FsOk;
+}
+
 /* FsWriteFile 
  * Writes the requested number of bytes to the given
  * file handle and outputs the number of bytes actually written */
@@ -739,23 +848,38 @@ FsQueryFile(
     _In_  size_t                    MaxLength)
 {
     // Variables
-    MfsFileInstance_t *fInstance    = NULL;
     MfsFile_t *fInformation         = NULL;
+    FileRecord_t *Record            = NULL;
+    MfsInstance_t *Mfs              = NULL;
 
     // Trace
     TRACE("FsQueryFile(Id 0x%x, Function %i, Length %u)",
         Handle->Id, Function, MaxLength);
 
     // Instantiate the pointers
-    fInstance       = (MfsFileInstance_t*)Handle->ExtensionData;
+    Mfs             = (MfsInstance_t*)Descriptor->ExtensionData;
     fInformation    = (MfsFile_t*)Handle->File->ExtensionData;
-    
-    // @todo
-    _CRT_UNUSED(Function);
-    _CRT_UNUSED(Buffer);
-    _CRT_UNUSED(MaxLength);
 
-    // Not implemented atm
+    if (Function != __FILESYSTEM_QUERY_STATS || MaxLength < sizeof(vFileDescriptor_t)) {
+        return FsInvalidParameters;
+    }
+
+    // The root directory has no record to read
+    if (fInformation->DirectoryBucket == MFS_ENDOFCHAIN) {
+        FileRecord_t Root = { 0 };
+        Root.Flags = fInformation->Flags | MFS_FILERECORD_SYSTEM;
+        MfsRecordToDescriptor(Descriptor, &Root, (vFileDescriptor_t*)Buffer);
+        return FsOk;
+    }
+
+    // Read the directory bucket the record lives in, to get the full record
+    if (MfsReadSectors(Descriptor, Mfs->TransferBuffer, MFS_GETSECTOR(Mfs, fInformation->DirectoryBucket), 
+        Mfs->SectorsPerBucket * fInformation->DirectoryLength) != OsSuccess) {
+        ERROR("Failed to read bucket %u", fInformation->DirectoryBucket);
+        return FsDiskError;
+    }
+    Record = (FileRecord_t*)GetBufferDataPointer(Mfs->TransferBuffer);
+    MfsRecordToDescriptor(Descriptor, &Record[fInformation->DirectoryIndex], (vFileDescriptor_t*)Buffer);
     return FsOk;
 }
 
@@ -361,4 +361,13 @@ MfsCreateRecord(
     _In_  Flags_t                   Flags, 
     _Out_ MfsFile_t**               File);
 
+/* MfsRecordToDescriptor
+ * Fills out the generic file descriptor from the on-disk record */
+__EXTERN
+void
+MfsRecordToDescriptor(
+    _In_  FileSystemDescriptor_t*   Descriptor,
+    _In_  FileRecord_t*             Record,
+    _Out_ vFileDescriptor_t*        Information);
+
 #endif //!_MFS_H_
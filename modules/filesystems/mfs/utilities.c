@@ -24,6 +24,7 @@
 #include "mfs.h"
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* MfsReadSectors 
  * A wrapper for reading sectors from the disk associated
@@ -511,3 +512,53 @@ MfsUpdateRecord(
 Cleanup:
     return Result;
 }
+
+/* MfsConvertDateTime
+ * Converts an on-disk timestamp to a timespec, records that have
+ * never been stamped are reported as zero */
+static void
+MfsConvertDateTime(
+    _In_  DateTimeRecord_t*         DateTime,
+    _Out_ struct timespec*          Time)
+{
+    // Variables
+    struct tm Converted = { 0 };
+
+    Time->tv_sec    = 0;
+    Time->tv_nsec   = 0;
+    if (DateTime->Year == 0) {
+        return;
+    }
+
+    Converted.tm_year   = DateTime->Year - 1900;
+    Converted.tm_mon    = DateTime->Month - 1;
+    Converted.tm_mday   = DateTime->Day;
+    Converted.tm_hour   = DateTime->Hour;
+    Converted.tm_min    = DateTime->Minute;
+    Converted.tm_sec    = DateTime->Second;
+    Time->tv_sec        = mktime(&Converted);
+    Time->tv_nsec       = (long)DateTime->MilliSeconds * 4 * 1000000L;
+}
+
+/* MfsRecordToDescriptor
+ * Fills out the generic file descriptor from the on-disk record */
+void
+MfsRecordToDescriptor(
+    _In_  FileSystemDescriptor_t*   Descriptor,
+    _In_  FileRecord_t*             Record,
+    _Out_ vFileDescriptor_t*        Information)
+{
+    memset((void*)Information, 0, sizeof(vFileDescriptor_t));
+    Information->StorageId      = (long)Descriptor->Disk.Device;
+    Information->Size.QuadPart  = Record->Size;
+    Information->Permissions    = FILE_PERMISSION_READ | FILE_PERMISSION_EXECUTE;
+    if (MFS_FILERECORD_TYPE(Record->Flags) == MFS_FILERECORD_DIRECTORY) {
+        Information->Flags |= FILE_FLAG_DIRECTORY;
+    }
+    if (!(Record->Flags & (MFS_FILERECORD_SYSTEM | MFS_FILERECORD_LOCKED))) {
+        Information->Permissions |= FILE_PERMISSION_WRITE;
+    }
+    MfsConvertDateTime(&Record->CreatedAt, &Information->CreatedAt);
+    MfsConvertDateTime(&Record->ModifiedAt, &Information->ModifiedAt);
+    MfsConvertDateTime(&Record->AccessedAt, &Information->AccessedAt);
+}
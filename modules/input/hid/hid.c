@@ -155,12 +155,8 @@ HidInterrupt(
         return InterruptHandled;
     }
 
-    // Perform the report parse
-    if (!HidParseReport(Device, Device->Collection, DataIndex)) {
-        return InterruptHandled;
-    }
-
-    // Store previous index
-    Device->PreviousDataIndex = DataIndex;
+    // Perform the report parse, the compiled report tables
+    // keep track of the previous report themselves
+    HidParseReport(Device, DataIndex);
     return InterruptHandled;
 }
@@ -231,6 +231,35 @@ typedef struct _UsbHidReportCollection {
     UsbHidReportCollectionItem_t    *Childs;
 } UsbHidReportCollection_t;
 
+/* UsbHidReportField
+ * A pre-compiled extraction entry for a single value in a report. The
+ * report descriptor is compiled into these once, so parsing a report is
+ * a flat walk of the fields of its report-id. Array fields hold an index,
+ * and their usage is the usage of the first index of the range. */
+typedef struct _UsbHidReportField {
+    uint16_t                        BitOffset;
+    uint8_t                         BitLength;
+    uint8_t                         Flags;
+    uint16_t                        UsagePage;
+    uint16_t                        Usage;
+    int32_t                         LogicalMin;
+    int32_t                         LogicalMax;
+    MInputType_t                    InputType;
+    uint64_t                        WordMask;
+} UsbHidReportField_t;
+
+/* UsbHidReport
+ * Contains the compiled fields of a single report-id together with
+ * a copy of the last received report, used for delta detection. */
+typedef struct _UsbHidReport {
+    UUId_t                          ReportId;
+    size_t                          BitLength;
+    size_t                          FieldCount;
+    size_t                          FieldCapacity;
+    UsbHidReportField_t            *Fields;
+    uint32_t                       *Previous;
+} UsbHidReport_t;
+
 /* HidDevice
  * Represents a human input device. */
 typedef struct _HidDevice {
@@ -241,9 +270,10 @@ typedef struct _HidDevice {
 
     // Buffers
     UsbHidReportCollection_t    *Collection;
+    UsbHidReport_t              *Reports;
+    size_t                       ReportCount;
     uintptr_t                   *Buffer;
     uintptr_t                    BufferAddress;
-    size_t                       PreviousDataIndex;
     size_t                       ReportLength;
     
     // Endpoint Information
@@ -304,14 +334,41 @@ HidParseReportDescriptor(
     _In_ uint8_t *Descriptor,
     _In_ size_t DescriptorLength);
 
+/* HidReportCompileInput
+ * Compiles an input main-item into extraction fields of the report
+ * given by the current global state. Called by the descriptor parser. */
+__EXTERN
+OsStatus_t
+HidReportCompileInput(
+    _In_ HidDevice_t *Device,
+    _In_ UsbHidReportGlobalStats_t *GlobalState,
+    _In_ UsbHidReportItemStats_t *ItemState,
+    _In_ Flags_t InputFlags,
+    _In_ MInputType_t InputType);
+
+/* HidReportFinalize
+ * Allocates the delta-buffers for the compiled reports. Must be called
+ * once the entire report descriptor has been compiled. */
+__EXTERN
+OsStatus_t
+HidReportFinalize(
+    _In_ HidDevice_t *Device);
+
+/* HidReportCleanup
+ * Cleans up the compiled report tables. */
+__EXTERN
+void
+HidReportCleanup(
+    _In_ HidDevice_t *Device);
+
 /* HidParseReport
- * Recursive report-parser that applies the given report-data
- * to the parsed report collection. */
+ * Applies the given report-data to the compiled report tables and
+ * delivers all changes as a single input batch. Returns OsError if
+ * the report did not match any compiled report. */
 __EXTERN
 OsStatus_t
 HidParseReport(
     _In_ HidDevice_t *Device,
-    _In_ UsbHidReportCollection_t *Collection,
     _In_ size_t DataIndex);
 
 /* HidCollectionCleanup
@@ -78,6 +78,10 @@ OnLoad(void)
 {
 	// Initialize state for this driver
     GlbHidDevices = CollectionCreate(KeyInteger);
+
+    // Reports are handled on this thread, so keep
+    // input ahead of normal work
+    SetCurrentThreadRealtime(1);
     return UsbInitialize();
 }
 
@@ -0,0 +1,544 @@
+/* MollenOS
+ *
+ * Copyright 2011 - 2017, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - Human Input Device Driver (Generic)
+ * - Compiled report tables. The report descriptor is compiled once into a
+ *   flat list of extraction fields per report-id, and incoming reports are
+ *   delta-checked word-wise against the previous report of the same id.
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/utils.h>
+#include <os/usb.h>
+#include "hid.h"
+
+/* Includes
+ * - Library */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Delta detection is done in 32 bit words, and each word has
+ * a bit in a 64 bit change-mask, which limits reports to 256 bytes. */
+#define HID_WORD_BITS               32
+#define HID_WORD_MASK_BITS          64
+#define HID_FIELD_BITS_MAX          32
+
+/* Array fields that belong to the same main item are handled as one set
+ * of pressed usages, keyboards report up to 6 keys this way. Usages below
+ * the first key usage are reserved or report error states. */
+#define HID_ARRAY_MAX               32
+#define HID_KEYBOARD_ERROR_ROLLOVER 0x1
+#define HID_KEYBOARD_FIRST_KEY      0x4
+
+/* HidExtractValue
+ * Retrieves a value from a buffer by the given bit-offset and the for a certain
+ * number of bits, the extracted value will be treated unsigned. Bytes past the
+ * given buffer length are read as zero. */
+static uint32_t
+HidExtractValue(
+    _In_ const uint8_t *Buffer,
+    _In_ size_t Length,
+    _In_ uint32_t BitOffset,
+    _In_ uint32_t NumBits)
+{
+    // Variables
+    size_t Byte = BitOffset / 8;
+    size_t Count = ((BitOffset % 8) + NumBits + 7) / 8;
+    uint64_t Value = 0;
+    size_t i;
+
+    // Gather the (at most 5) bytes the value spans
+    for (i = 0; i < Count && (Byte + i) < Length; i++) {
+        Value |= (uint64_t)Buffer[Byte + i] << (i * 8);
+    }
+    Value >>= (BitOffset % 8);
+    return (uint32_t)(Value & ((1ULL << NumBits) - 1));
+}
+
+/* HidWordMask
+ * Calculates the change-mask bits covered by the given bit-range. */
+static uint64_t
+HidWordMask(
+    _In_ size_t BitOffset,
+    _In_ size_t BitLength)
+{
+    // Variables
+    size_t First = BitOffset / HID_WORD_BITS;
+    size_t Last = (BitOffset + BitLength - 1) / HID_WORD_BITS;
+    uint64_t Mask = 0;
+
+    // Clamp to the size of the change-mask
+    if (First >= HID_WORD_MASK_BITS) {
+        First = HID_WORD_MASK_BITS - 1;
+    }
+    if (Last >= HID_WORD_MASK_BITS) {
+        Last = HID_WORD_MASK_BITS - 1;
+    }
+    for (; First <= Last; First++) {
+        Mask |= (1ULL << First);
+    }
+    return Mask;
+}
+
+/* HidReportLookup
+ * Retrieves the compiled report for the given id, if it does not
+ * exist and Create is set, a new report is added. */
+static UsbHidReport_t*
+HidReportLookup(
+    _In_ HidDevice_t *Device,
+    _In_ UUId_t ReportId,
+    _In_ int Create)
+{
+    // Variables
+    UsbHidReport_t *Reports;
+    size_t i;
+
+    for (i = 0; i < Device->ReportCount; i++) {
+        if (Device->Reports[i].ReportId == ReportId) {
+            return &Device->Reports[i];
+        }
+    }
+    if (!Create) {
+        return NULL;
+    }
+
+    // Add a new report, the report-id occupies the first byte
+    Reports = (UsbHidReport_t*)realloc(Device->Reports,
+        (Device->ReportCount + 1) * sizeof(UsbHidReport_t));
+    if (Reports == NULL) {
+        return NULL;
+    }
+    Device->Reports = Reports;
+    memset(&Reports[Device->ReportCount], 0, sizeof(UsbHidReport_t));
+    Reports[Device->ReportCount].ReportId = ReportId;
+    Reports[Device->ReportCount].BitLength = (ReportId != UUID_INVALID) ? 8 : 0;
+    return &Reports[Device->ReportCount++];
+}
+
+/* HidReportCompileInput
+ * Compiles an input main-item into extraction fields of the report
+ * given by the current global state. Called by the descriptor parser. */
+OsStatus_t
+HidReportCompileInput(
+    _In_ HidDevice_t *Device,
+    _In_ UsbHidReportGlobalStats_t *GlobalState,
+    _In_ UsbHidReportItemStats_t *ItemState,
+    _In_ Flags_t InputFlags,
+    _In_ MInputType_t InputType)
+{
+    // Variables
+    UsbHidReport_t *Report = HidReportLookup(Device, GlobalState->ReportId, 1);
+    uint32_t Usage = 0;
+    size_t i;
+
+    // Sanitize the report
+    if (Report == NULL) {
+        return OsError;
+    }
+
+    // Constant items are padding, they only occupy space
+    if (InputFlags == REPORT_INPUT_TYPE_CONSTANT
+        || GlobalState->ReportSize == 0
+        || GlobalState->ReportSize > HID_FIELD_BITS_MAX) {
+        Report->BitLength += GlobalState->ReportCount * GlobalState->ReportSize;
+        return OsSuccess;
+    }
+
+    // Make room for the fields
+    if (Report->FieldCount + GlobalState->ReportCount > Report->FieldCapacity) {
+        size_t Capacity = Report->FieldCount + GlobalState->ReportCount;
+        UsbHidReportField_t *Fields = (UsbHidReportField_t*)realloc(
+            Report->Fields, Capacity * sizeof(UsbHidReportField_t));
+        if (Fields == NULL) {
+            return OsError;
+        }
+        Report->Fields = Fields;
+        Report->FieldCapacity = Capacity;
+    }
+
+    // Create a field for each value in the item. Usages are either listed
+    // explicitly, or given by a usage range
+    for (i = 0; i < GlobalState->ReportCount; i++) {
+        UsbHidReportField_t *Field = &Report->Fields[Report->FieldCount++];
+
+        if (InputFlags == REPORT_INPUT_TYPE_ARRAY) {
+            Usage = (ItemState->UsageMax > ItemState->UsageMin) 
+                ? ItemState->UsageMin : (uint32_t)ItemState->Usages[0];
+        }
+        else if (i < 16 && ItemState->Usages[i] != 0) {
+            Usage = ItemState->Usages[i];
+        }
+        else if (ItemState->UsageMax > ItemState->UsageMin) {
+            Usage = ItemState->UsageMin + i;
+            if (Usage > ItemState->UsageMax) {
+                Usage = ItemState->UsageMax;
+            }
+        }
+
+        Field->BitOffset = (uint16_t)Report->BitLength;
+        Field->BitLength = (uint8_t)GlobalState->ReportSize;
+        Field->Flags = (uint8_t)InputFlags;
+        Field->UsagePage = (uint16_t)GlobalState->UsagePage;
+        Field->Usage = (uint16_t)Usage;
+        Field->LogicalMin = GlobalState->LogicalMin;
+        Field->LogicalMax = GlobalState->LogicalMax;
+        Field->InputType = InputType;
+        Field->WordMask = HidWordMask(Report->BitLength, GlobalState->ReportSize);
+        Report->BitLength += GlobalState->ReportSize;
+
+        TRACE("Report %u: field usage 0x%x:0x%x at bit %u (%u bits)",
+            (uint32_t)Report->ReportId, Field->UsagePage, Field->Usage,
+            Field->BitOffset, Field->BitLength);
+    }
+    return OsSuccess;
+}
+
+/* HidReportFinalize
+ * Allocates the delta-buffers for the compiled reports. Must be called
+ * once the entire report descriptor has been compiled. */
+OsStatus_t
+HidReportFinalize(
+    _In_ HidDevice_t *Device)
+{
+    // Variables
+    size_t i;
+
+    for (i = 0; i < Device->ReportCount; i++) {
+        UsbHidReport_t *Report = &Device->Reports[i];
+        size_t Words = DIVUP(Report->BitLength, HID_WORD_BITS);
+        Report->Previous = (uint32_t*)malloc(Words * sizeof(uint32_t));
+        if (Report->Previous == NULL) {
+            return OsError;
+        }
+        memset(Report->Previous, 0, Words * sizeof(uint32_t));
+    }
+    return OsSuccess;
+}
+
+/* HidReportCleanup
+ * Cleans up the compiled report tables. */
+void
+HidReportCleanup(
+    _In_ HidDevice_t *Device)
+{
+    // Variables
+    size_t i;
+
+    for (i = 0; i < Device->ReportCount; i++) {
+        if (Device->Reports[i].Fields != NULL) {
+            free(Device->Reports[i].Fields);
+        }
+        if (Device->Reports[i].Previous != NULL) {
+            free(Device->Reports[i].Previous);
+        }
+    }
+    if (Device->Reports != NULL) {
+        free(Device->Reports);
+    }
+    Device->Reports = NULL;
+    Device->ReportCount = 0;
+}
+
+/* HidReportDelta
+ * Compares the report with the previous report word-by-word, and stores
+ * the new report as previous. Returns a mask of the changed words. */
+static uint64_t
+HidReportDelta(
+    _In_ UsbHidReport_t *Report,
+    _In_ const uint8_t *Data,
+    _In_ size_t Length,
+    _In_ uint32_t *Previous)
+{
+    // Variables
+    size_t Words = DIVUP(Length, sizeof(uint32_t));
+    uint64_t Changes = 0;
+    size_t i;
+
+    for (i = 0; i < Words; i++) {
+        uint32_t Word = 0;
+        size_t Bytes = sizeof(uint32_t);
+        if ((i + 1) * sizeof(uint32_t) > Length) {
+            Bytes = Length - (i * sizeof(uint32_t));
+        }
+        memcpy(&Word, &Data[i * sizeof(uint32_t)], Bytes);
+
+        // Move the current previous word to the caller's copy
+        // so old values can still be extracted
+        Previous[i] = Report->Previous[i];
+        if (Word ^ Report->Previous[i]) {
+            Changes |= 1ULL << i;
+            Report->Previous[i] = Word;
+        }
+    }
+    return Changes;
+}
+
+/* HidReportNextEvent
+ * Returns the next free event of the batch. A full batch is delivered and
+ * a new one is started, which also ends the motion event of the old batch. */
+static MInput_t*
+HidReportNextEvent(
+    _In_ MInputBatch_t *Batch,
+    _In_ MInput_t **Motion)
+{
+    // Variables
+    MInput_t *Input;
+
+    if (Batch->Count == INPUT_BATCH_MAX_EVENTS) {
+        CreateInputBatch(Batch);
+        Batch->Count = 0;
+        *Motion = NULL;
+    }
+    Input = &Batch->Events[Batch->Count++];
+    memset(Input, 0, sizeof(MInput_t));
+    return Input;
+}
+
+/* HidReportAddEvent
+ * Appends a button-style event to the batch. */
+static void
+HidReportAddEvent(
+    _In_ MInputBatch_t *Batch,
+    _In_ MInput_t **Motion,
+    _In_ MInputType_t Type,
+    _In_ unsigned Scancode,
+    _In_ unsigned Flags)
+{
+    MInput_t *Input = HidReportNextEvent(Batch, Motion);
+    Input->Type = Type;
+    Input->Scancode = Scancode;
+    Input->Flags = Flags;
+}
+
+/* HidArrayUsage
+ * Converts the index of an array field to a usage, returns 0 if the
+ * index is out of the logical range and does not refer to any usage. */
+static unsigned
+HidArrayUsage(
+    _In_ UsbHidReportField_t *Field,
+    _In_ uint32_t Value)
+{
+    if ((int64_t)Value < Field->LogicalMin || (int64_t)Value > Field->LogicalMax) {
+        return 0;
+    }
+    return Field->Usage + (unsigned)((int64_t)Value - Field->LogicalMin);
+}
+
+/* HidReportParseArray
+ * Compares the usages reported by a group of array fields with the usages of
+ * the previous report, usages that disappeared are released and new usages
+ * are pressed. Reports in an error state (rollover) are ignored. */
+static void
+HidReportParseArray(
+    _In_ UsbHidReportField_t *Fields,
+    _In_ size_t Count,
+    _In_ const uint8_t *Data,
+    _In_ const uint8_t *Previous,
+    _In_ size_t Length,
+    _In_ MInputBatch_t *Batch,
+    _In_ MInput_t **Motion)
+{
+    // Variables
+    unsigned Current[HID_ARRAY_MAX];
+    unsigned Old[HID_ARRAY_MAX];
+    size_t i, j;
+
+    for (i = 0; i < Count; i++) {
+        Current[i] = HidArrayUsage(&Fields[i], 
+            HidExtractValue(Data, Length, Fields[i].BitOffset, Fields[i].BitLength));
+        Old[i] = HidArrayUsage(&Fields[i],
+            HidExtractValue(Previous, Length, Fields[i].BitOffset, Fields[i].BitLength));
+        if (Fields[i].UsagePage == HID_REPORT_USAGE_PAGE_KEYBOARD
+            && Current[i] == HID_KEYBOARD_ERROR_ROLLOVER) {
+            return;
+        }
+    }
+
+    for (i = 0; i < Count; i++) {
+        if (Fields[i].UsagePage == HID_REPORT_USAGE_PAGE_KEYBOARD
+            && Old[i] < HID_KEYBOARD_FIRST_KEY) {
+            continue;
+        }
+        for (j = 0; j < Count && Current[j] != Old[i]; j++);
+        if (Old[i] != 0 && j == Count) {
+            TRACE("Key 0x%x released", Old[i]);
+            HidReportAddEvent(Batch, Motion, Fields[i].InputType, Old[i], INPUT_BUTTON_RELEASED);
+        }
+    }
+    for (i = 0; i < Count; i++) {
+        if (Fields[i].UsagePage == HID_REPORT_USAGE_PAGE_KEYBOARD
+            && Current[i] < HID_KEYBOARD_FIRST_KEY) {
+            continue;
+        }
+        for (j = 0; j < Count && Old[j] != Current[i]; j++);
+        if (Current[i] != 0 && j == Count) {
+            TRACE("Key 0x%x pressed", Current[i]);
+            HidReportAddEvent(Batch, Motion, Fields[i].InputType, Current[i], INPUT_BUTTON_CLICKED);
+        }
+    }
+}
+
+/* HidParseReport
+ * Applies the given report-data to the compiled report tables and
+ * delivers all changes in input batches. Returns OsError if
+ * the report did not match any compiled report. */
+OsStatus_t
+HidParseReport(
+    _In_ HidDevice_t *Device,
+    _In_ size_t DataIndex)
+{
+    // Variables
+    uint8_t *Data = &((uint8_t*)Device->Buffer)[DataIndex];
+    UsbHidReport_t *Report = NULL;
+    uint32_t Previous[HID_WORD_MASK_BITS];
+    MInput_t *Motion = NULL;
+    MInputBatch_t Batch;
+    uint64_t Changes;
+    size_t Length;
+    size_t i;
+
+    // If report-ids are active, the first byte of the data-report is the id
+    if (Device->ReportCount == 0) {
+        return OsError;
+    }
+    if (Device->Reports[0].ReportId != UUID_INVALID) {
+        Report = HidReportLookup(Device, Data[0], 0);
+    }
+    else {
+        Report = &Device->Reports[0];
+    }
+    if (Report == NULL || Report->Previous == NULL) {
+        return OsError;
+    }
+
+    // Detect which words of the report changed, only the part of the
+    // report covered by the change-mask is processed
+    Length = DIVUP(Report->BitLength, 8);
+    if (Length > (HID_WORD_MASK_BITS * sizeof(uint32_t))) {
+        Length = HID_WORD_MASK_BITS * sizeof(uint32_t);
+    }
+    Changes = HidReportDelta(Report, Data, Length, &Previous[0]);
+    Batch.Count = 0;
+
+    // Iterate the compiled fields, absolute values and buttons are only
+    // looked at if their words changed, relative values whenever they are non-zero
+    for (i = 0; i < Report->FieldCount; i++) {
+        UsbHidReportField_t *Field = &Report->Fields[i];
+        uint32_t Value, OldValue;
+
+        // Array fields of the same item are handled together as they
+        // form one set of usages, key indices can move between them
+        if (Field->Flags == REPORT_INPUT_TYPE_ARRAY) {
+            uint64_t WordMask = Field->WordMask;
+            size_t Count = 1;
+            while ((i + Count) < Report->FieldCount && Count < HID_ARRAY_MAX
+                && Field[Count].Flags == REPORT_INPUT_TYPE_ARRAY
+                && Field[Count].UsagePage == Field->UsagePage
+                && Field[Count].Usage == Field->Usage) {
+                WordMask |= Field[Count++].WordMask;
+            }
+            if ((Changes & WordMask) 
+                && (Field->UsagePage == HID_REPORT_USAGE_PAGE_KEYBOARD
+                    || Field->UsagePage == HID_REPORT_USAGE_PAGE_BUTTON)) {
+                HidReportParseArray(Field, Count, Data, (const uint8_t*)&Previous[0], 
+                    Length, &Batch, &Motion);
+            }
+            i += Count - 1;
+            continue;
+        }
+
+        if (Field->Flags != REPORT_INPUT_TYPE_RELATIVE && !(Changes & Field->WordMask)) {
+            continue;
+        }
+        Value = HidExtractValue(Data, Length, Field->BitOffset, Field->BitLength);
+        if (Field->Flags == REPORT_INPUT_TYPE_RELATIVE && Value == 0) {
+            continue;
+        }
+        OldValue = HidExtractValue((const uint8_t*)&Previous[0], Length,
+            Field->BitOffset, Field->BitLength);
+
+        // Take action based on the type of input
+        switch (Field->UsagePage) {
+            case HID_USAGE_PAGE_GENERIC_PC: {
+                switch (Field->Usage) {
+                    // Grid updates like x, y or z coordinates have
+                    // changed. All axis changes of a report are merged into one event
+                    case HID_REPORT_USAGE_X_AXIS:
+                    case HID_REPORT_USAGE_Y_AXIS:
+                    case HID_REPORT_USAGE_Z_AXIS: {
+                        int64_t Relative = (int64_t)Value;
+
+                        // If the value is absolute, we want to
+                        // make sure we calculate the relative
+                        if (Field->Flags == REPORT_INPUT_TYPE_ABSOLUTE) {
+                            Relative = (int64_t)Value - (int64_t)OldValue;
+                        }
+                        else if (Field->LogicalMin < 0
+                            && (Value & (1U << (Field->BitLength - 1)))) {
+                            // Handle sign-cases where we have to turn them negative
+                            Relative -= (int64_t)(1ULL << Field->BitLength);
+                        }
+                        if (Relative == 0) {
+                            break;
+                        }
+
+                        if (Motion == NULL) {
+                            Motion = HidReportNextEvent(&Batch, &Motion);
+                            Motion->Type = Field->InputType;
+                        }
+                        if (Field->Usage == HID_REPORT_USAGE_X_AXIS) {
+                            Motion->xRelative += (long)Relative;
+                        }
+                        else if (Field->Usage == HID_REPORT_USAGE_Y_AXIS) {
+                            Motion->yRelative += (long)Relative;
+                        }
+                        else {
+                            Motion->zRelative += (long)Relative;
+                        }
+                    } break;
+                }
+            } break;
+
+            // Generic Button events, and keyboard modifier bits
+            case HID_REPORT_USAGE_PAGE_KEYBOARD:
+            case HID_REPORT_USAGE_PAGE_BUTTON: {
+                if (Value == OldValue) {
+                    break;
+                }
+                TRACE("Button 0x%x: %u", Field->Usage, Value);
+                HidReportAddEvent(&Batch, &Motion, Field->InputType, Field->Usage,
+                    (Value != 0) ? INPUT_BUTTON_CLICKED : INPUT_BUTTON_RELEASED);
+            } break;
+
+            // We don't handle rest of usage-pages, but should be ok
+            default: {
+                TRACE("Usage Page 0x%x (Input Type 0x%x), Usage 0x%x, Value 0x%x",
+                    Field->UsagePage, Field->InputType, Field->Usage, Value);
+            } break;
+        }
+    }
+
+    // Deliver all changes of this report at once
+    if (Batch.Count != 0) {
+        CreateInputBatch(&Batch);
+    }
+    return OsSuccess;
+}
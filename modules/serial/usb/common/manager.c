@@ -36,6 +36,14 @@
 #include <stddef.h>
 #include <stdlib.h>
 
+/* UsbManagerScanContext
+ * Keeps track of the scan progress for a transfer chain, the element that
+ * is still in flight will be stored in <Pending>. */
+typedef struct _UsbManagerScanContext {
+    UsbManagerTransfer_t*   Transfer;
+    uint8_t*                Pending;
+} UsbManagerScanContext_t;
+
 /* Globals
  * Keeps track of the usb-manager state and its data */
 static Collection_t *__GlbControllers   = NULL;
@@ -65,6 +73,9 @@ UsbManagerInitialize(void) {
     __GlbControllers    = CollectionCreate(KeyInteger);
     __GlbTimerEvent     = UUID_INVALID;
     __GlbTimerCallback  = NULL;
+#ifdef __OSCONFIG_TEST_USB
+    UsbManagerRunTests();
+#endif
     return OsSuccess;
 }
 
@@ -167,6 +178,57 @@ UsbManagerIterateTransfers(
     }
 }
 
+/* UsbManagerQueueDoneTransfer
+ * Queues a transfer that needs completion processing on the done list of the
+ * controller. Transfers already on the done list are not queued again. */
+void
+UsbManagerQueueDoneTransfer(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer)
+{
+    // Variables
+    DataKey_t Key;
+
+    if (Transfer->Flags & TransferFlagDone) {
+        return;
+    }
+    Key.Value       = (int)Transfer->Id;
+    Transfer->Flags |= TransferFlagDone;
+    CollectionAppend(Controller->DoneList, CollectionCreateNode(Key, Transfer));
+}
+
+/* UsbManagerProcessDoneTransfers
+ * Empties the done list in the order transfers were queued and invokes the callback
+ * for each. ITERATOR_REMOVE removes the transfer from the transaction list. */
+void
+UsbManagerProcessDoneTransfers(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbTransferItemCallback    ItemCallback,
+    _In_ void*                      Context)
+{
+    // Variables
+    UsbManagerTransfer_t *Transfer;
+    CollectionItem_t *Node;
+    DataKey_t Key;
+    int Status;
+
+    while ((Node = CollectionPopFront(Controller->DoneList)) != NULL) {
+        Transfer        = (UsbManagerTransfer_t*)Node->Data;
+        Key             = Node->Key;
+        CollectionDestroyNode(Controller->DoneList, Node);
+        Transfer->Flags &= ~(TransferFlagDone);
+
+        // The transfer may be freed by the callback, only the key is used after
+        Status = ItemCallback(Controller, Transfer, Context);
+        if (Status & ITERATOR_REMOVE) {
+            CollectionRemoveByKey(Controller->TransactionList, Key);
+        }
+        if (Status & ITERATOR_STOP) {
+            break;
+        }
+    }
+}
+
 /* UsbManagerGetController 
  * Returns a controller by the given device-id */
 UsbManagerController_t*
@@ -310,6 +372,7 @@ UsbManagerFinalizeTransfer(
     // We don't allocate the queue head before the transfer
     // is done, we might not be done yet
     if (BytesLeft == 1) {
+        Transfer->ScanElement = NULL;
         HciQueueTransferGeneric(Transfer);
         return OsError;
     }
@@ -431,15 +494,100 @@ UsbManagerScheduleTransfers(
     UsbManagerIterateTransfers(Controller, UsbManagerScheduleTransfer, NULL);
 }
 
+/* UsbManagerScanElement
+ * Wraps the HciProcessElement scan, and stops the iteration at the first element
+ * that has not yet been retired by the controller. */
+int
+UsbManagerScanElement(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ uint8_t*                   Element,
+    _In_ int                        Reason,
+    _In_ void*                      Context)
+{
+    // Variables
+    UsbManagerScanContext_t *Scan   = (UsbManagerScanContext_t*)Context;
+    int TransactionsExecuted        = Scan->Transfer->TransactionsExecuted;
+    int Status;
+
+    Status = HciProcessElement(Controller, Element, Reason, Scan->Transfer);
+    if (Element != (uint8_t*)Scan->Transfer->EndpointDescriptor
+        && TransactionsExecuted == Scan->Transfer->TransactionsExecuted) {
+        Scan->Pending = Element;
+        return ITERATOR_STOP;
+    }
+    return Status;
+}
+
+/* UsbManagerScanTransfer
+ * Scans the transfer chain from the first element not yet retired. Elements are
+ * only ever validated once, and a transfer with elements still in flight costs a
+ * single element check. Returns OsSuccess if the transfer has completed. */
+OsStatus_t
+UsbManagerScanTransfer(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer)
+{
+    // Variables
+    UsbManagerScanContext_t Scan = { Transfer, NULL };
+    uint8_t *Root;
+
+    // Isochronous descriptors retire partially, keep scanning them fully
+    if (Transfer->Transfer.Type == IsochronousTransfer) {
+        UsbManagerIterateChain(Controller, Transfer->EndpointDescriptor, 
+            USB_CHAIN_DEPTH, USB_REASON_SCAN, HciProcessElement, Transfer);
+        return (Transfer->Status == TransferQueued) ? OsError : OsSuccess;
+    }
+
+    Root = (Transfer->ScanElement != NULL) ? Transfer->ScanElement : (uint8_t*)Transfer->EndpointDescriptor;
+    UsbManagerIterateChain(Controller, Root, USB_CHAIN_DEPTH, 
+        USB_REASON_SCAN, UsbManagerScanElement, &Scan);
+
+    // Elements still in flight and no short or error condition, then we
+    // remember where to resume and keep the transfer queued
+    if (Scan.Pending != NULL && !(Transfer->Flags & TransferFlagShort)
+        && (Transfer->Status == TransferQueued || Transfer->Status == TransferFinished)) {
+        Transfer->ScanElement   = Scan.Pending;
+        Transfer->Status        = TransferQueued;
+        Transfer->Flags         &= ~(TransferFlagSync);
+        return OsError;
+    }
+    Transfer->ScanElement = NULL;
+    return (Transfer->Status == TransferQueued) ? OsError : OsSuccess;
+}
+
+/* UsbManagerCollectTransfer
+ * Checks the given transfer for progress, and moves it to the done list if it
+ * has completed or is marked for cleanup. No completion work is done here. */
+int
+UsbManagerCollectTransfer(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer,
+    _In_ void*                      Context)
+{
+    _CRT_UNUSED(Context);
+    if (Transfer->Flags & TransferFlagCleanup) {
+        UsbManagerQueueDoneTransfer(Controller, Transfer);
+    }
+    else if (Transfer->Status == TransferQueued) {
+        TRACE("> Validation transfer(Id %u, Status %u)", Transfer->Id, Transfer->Status);
+        if (UsbManagerScanTransfer(Controller, Transfer) == OsSuccess) {
+            UsbManagerQueueDoneTransfer(Controller, Transfer);
+        }
+    }
+    return ITERATOR_CONTINUE;
+}
+
 /* UsbManagerProcessTransfer
- * Processes and validates the given transfer item. If any action needs to be taken
- * this function will handle completion. */
+ * Handles completion of a transfer taken from the done list, the transfer has
+ * either completed or is marked for cleanup. */
 int
 UsbManagerProcessTransfer(
     _In_ UsbManagerController_t*    Controller,
     _In_ UsbManagerTransfer_t*      Transfer,
     _In_ void*                      Context)
 {
+    _CRT_UNUSED(Context);
+
     // Has the transfer been marked for cleanup?
     if (Transfer->Flags & TransferFlagCleanup) {
         if (Transfer->EndpointDescriptor != NULL) {
@@ -447,25 +595,18 @@ UsbManagerProcessTransfer(
                 USB_CHAIN_DEPTH, USB_REASON_CLEANUP, HciProcessElement, Transfer);
             Transfer->EndpointDescriptor = NULL; // Reset
         }
+        Transfer->ScanElement = NULL;
         if (UsbManagerFinalizeTransfer(Controller, Transfer) == OsSuccess) {
             return ITERATOR_REMOVE;
         }
         return ITERATOR_CONTINUE;
     }
 
-    // No reason to check for any other processing if it's not queued
-    if (Transfer->Status != TransferQueued) {
-        return ITERATOR_CONTINUE;
-    }
-
-    // Debug
-    TRACE("> Validation transfer(Id %u, Status %u)", Transfer->Id, Transfer->Status);
-    UsbManagerIterateChain(Controller, Transfer->EndpointDescriptor, 
-        USB_CHAIN_DEPTH, USB_REASON_SCAN, HciProcessElement, Transfer);
-    TRACE("> Updated metrics (Id %u, Status %u, Flags 0x%x)", Transfer->Id, Transfer->Status, Transfer->Flags);
+    // Still in flight, nothing to complete
     if (Transfer->Status == TransferQueued) {
         return ITERATOR_CONTINUE;
     }
+    TRACE("> Updated metrics (Id %u, Status %u, Flags 0x%x)", Transfer->Id, Transfer->Status, Transfer->Flags);
     
     // Do we need to fixup toggles?
     if (Transfer->Flags & TransferFlagSync) {
@@ -500,13 +641,16 @@ UsbManagerProcessTransfer(
 
 /* UsbManagerProcessTransfers
  * Processes all the associated transfers with the given usb controller.
- * The iteration process will invoke <HciProcessElement> */
+ * The controllers have no hardware done-queue we can use, so the queued transfers
+ * are checked from their first unretired element (see UsbManagerScanTransfer) and
+ * completed ones are moved to the done list. Completion work, toggle fixups and
+ * removal then only run for the transfers on the done list. */
 void
 UsbManagerProcessTransfers(
     _In_ UsbManagerController_t*    Controller)
 {
-    // Simply invoke our iterator with a fixed shared implementation.
-    UsbManagerIterateTransfers(Controller, UsbManagerProcessTransfer, NULL);
+    UsbManagerIterateTransfers(Controller, UsbManagerCollectTransfer, NULL);
+    UsbManagerProcessDoneTransfers(Controller, UsbManagerProcessTransfer, NULL);
 }
 
 /* UsbManagerIterateChain
@@ -64,6 +64,7 @@ typedef struct _UsbManagerController {
 
     Collection_t*           Endpoints;
     Collection_t*           TransactionList;
+    Collection_t*           DoneList;
     Spinlock_t              Lock;
 } UsbManagerController_t;
 
@@ -138,6 +139,34 @@ void
 UsbManagerClearTransfers(
     _In_ UsbManagerController_t*    Controller);
 
+/* UsbManagerFinalizeTransfer
+ * Finalizes the transfer by sending an notification, requeuing if all bytes are not
+ * transferred or queing a transfer waiting. Returns OsSuccess if the transfer was freed. */
+__EXTERN
+OsStatus_t
+UsbManagerFinalizeTransfer(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer);
+
+/* UsbManagerQueueDoneTransfer
+ * Queues a transfer that needs completion processing on the done list of the
+ * controller. Transfers already on the done list are not queued again. */
+__EXTERN
+void
+UsbManagerQueueDoneTransfer(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer);
+
+/* UsbManagerProcessDoneTransfers
+ * Empties the done list in the order transfers were queued and invokes the callback
+ * for each. ITERATOR_REMOVE removes the transfer from the transaction list. */
+__EXTERN
+void
+UsbManagerProcessDoneTransfers(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbTransferItemCallback    ItemCallback,
+    _In_ void*                      Context);
+
 /* UsbManagerIterateTransfers
  * Iterate the transfers associated with the given controller. The iteration
  * flow can be controlled with the return codes. */
@@ -185,6 +214,14 @@ UsbManagerController_t*
 UsbManagerGetController(
     _In_ UUId_t                     Device);
 
+/* UsbManagerIsAddressesEqual
+ * Checks two different usb addreses if they are targetting the same endpoint. */
+__EXTERN
+OsStatus_t
+UsbManagerIsAddressesEqual(
+    _In_ UsbHcAddress_t*            Address1,
+    _In_ UsbHcAddress_t*            Address2);
+
 /* UsbManagerGetToggle 
  * Retrieves the toggle status for a given pipe */
 __EXTERN
@@ -204,7 +241,7 @@ UsbManagerSetToggle(
 
 /* UsbManagerProcessTransfers
  * Processes all the associated transfers with the given usb controller.
- * The iteration process will invoke <HciProcessElement> */
+ * Completed transfers are collected on the done list and completed from there. */
 __EXTERN
 void
 UsbManagerProcessTransfers(
@@ -218,4 +255,12 @@ void
 UsbManagerScheduleTransfers(
     _In_ UsbManagerController_t*    Controller);
 
+#ifdef __OSCONFIG_TEST_USB
+/* UsbManagerRunTests
+ * Verifies the transfer bookkeeping of the usb-manager without any hardware. */
+__EXTERN
+void
+UsbManagerRunTests(void);
+#endif
+
 #endif //!_USB_MANAGER_H_
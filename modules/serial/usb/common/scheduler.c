@@ -57,17 +57,25 @@ UsbSchedulerResetInternalData(
     // Start out by zeroing out memory
     if (ResetElements) {
         for (i = 0; i < Scheduler->Settings.PoolCount; i++) {
-            memset((void*)Scheduler->Settings.Pools[i].ElementPool, 0, (Scheduler->Settings.Pools[i].ElementCount * Scheduler->Settings.Pools[i].ElementAlignedSize));
+            UsbSchedulerPool_t *sPool = &Scheduler->Settings.Pools[i];
+            memset((void*)sPool->ElementPool, 0, (sPool->ElementCount * sPool->ElementAlignedSize));
             
             // Allocate and initialze all the reserved elements
-            for (j = 0; j < Scheduler->Settings.Pools[i].ElementCountReserved; j++) {
-                uint8_t *Element                = USB_ELEMENT_INDEX((&Scheduler->Settings.Pools[i]), j);
-                UsbSchedulerObject_t *sObject   = USB_ELEMENT_OBJECT((&Scheduler->Settings.Pools[i]), Element);
+            for (j = 0; j < sPool->ElementCountReserved; j++) {
+                uint8_t *Element                = USB_ELEMENT_INDEX(sPool, j);
+                UsbSchedulerObject_t *sObject   = USB_ELEMENT_OBJECT(sPool, Element);
                 sObject->Index                  = USB_ELEMENT_CREATE_INDEX(i, j);
                 sObject->BreathIndex            = USB_ELEMENT_NO_INDEX;
                 sObject->DepthIndex             = USB_ELEMENT_NO_INDEX;
                 sObject->Flags                  = USB_ELEMENT_ALLOCATED;
             }
+
+            // Rebuild the free stack, push in reverse order so the lowest
+            // indices are handed out first
+            sPool->ElementFreeCount = 0;
+            for (j = (int)sPool->ElementCount - 1; j >= (int)sPool->ElementCountReserved; j--) {
+                sPool->ElementFreeStack[sPool->ElementFreeCount++] = (uint16_t)j;
+            }
         }
     }
     if (ResetFramelist) {
@@ -85,7 +93,8 @@ UsbSchedulerResetInternalData(
 /* UsbSchedulerInitialize 
  * Initializes a new instance of a scheduler that can be used to
  * keep track of controller bandwidth and which frames are active.
- * MaxBandwidth is usually either 800 or 900. */
+ * MaxBandwidth is usually either 800 or 900. Returns OsOutOfMemory if the
+ * management resources could not be allocated. */
 OsStatus_t
 UsbSchedulerInitialize(
     _In_  UsbSchedulerSettings_t*   Settings,
@@ -133,7 +142,10 @@ UsbSchedulerInitialize(
 
     // Setup a new instance
     Scheduler = (UsbScheduler_t*)malloc(sizeof(UsbScheduler_t));
-    assert(Scheduler != NULL);
+    if (Scheduler == NULL) {
+        MemoryFree((void*)Pool, PoolSizeBytes);
+        return OsOutOfMemory;
+    }
     memset((void*)Scheduler, 0, sizeof(UsbScheduler_t));
 
     // Store initial information we were given
@@ -152,6 +164,7 @@ UsbSchedulerInitialize(
     for (i = 0; i < Settings->PoolCount; i++) {
         Scheduler->Settings.Pools[i].ElementPoolPhysical  = PoolPhysical;
         Scheduler->Settings.Pools[i].ElementPool          = Pool;
+        Scheduler->Settings.Pools[i].ElementFreeStack     = (uint16_t*)malloc(Settings->Pools[i].ElementCount * sizeof(uint16_t));
         Pool            += Settings->Pools[i].ElementCount * Settings->Pools[i].ElementAlignedSize;
         PoolPhysical    += Settings->Pools[i].ElementCount * Settings->Pools[i].ElementAlignedSize;
     }
@@ -159,9 +172,17 @@ UsbSchedulerInitialize(
     // Allocate the last resources
     TRACE(" > Allocating management resources");
     Scheduler->VirtualFrameList     = (uintptr_t*)malloc(Settings->FrameCount * sizeof(uintptr_t));
-    assert(Scheduler->VirtualFrameList != NULL);
     Scheduler->Bandwidth            = (size_t*)malloc((Settings->FrameCount * Settings->SubframeCount * sizeof(size_t)));
-    assert(Scheduler->Bandwidth != NULL);
+    for (i = 0; i < Settings->PoolCount; i++) {
+        if (Scheduler->Settings.Pools[i].ElementFreeStack == NULL) {
+            break;
+        }
+    }
+    if (i != Settings->PoolCount || Scheduler->VirtualFrameList == NULL || Scheduler->Bandwidth == NULL) {
+        ERROR("Failed to allocate management resources for the scheduler");
+        UsbSchedulerDestroy(Scheduler);
+        return OsOutOfMemory;
+    }
 
     *SchedulerOut                   = Scheduler;
     TRACE(" > Resetting internal data");
@@ -175,6 +196,9 @@ OsStatus_t
 UsbSchedulerDestroy(
     _In_ UsbScheduler_t*        Scheduler)
 {
+    // Variables
+    int i;
+
     // Clear out allocated resources
     // Root is pool 0 or framelist
     if (Scheduler->Settings.Flags & USB_SCHEDULER_FRAMELIST) {
@@ -188,6 +212,11 @@ UsbSchedulerDestroy(
         }
     }
 
+    for (i = 0; i < Scheduler->Settings.PoolCount; i++) {
+        if (Scheduler->Settings.Pools[i].ElementFreeStack != NULL) {
+            free(Scheduler->Settings.Pools[i].ElementFreeStack);
+        }
+    }
     if (Scheduler->VirtualFrameList != NULL) {
         free(Scheduler->VirtualFrameList);
     }
@@ -315,7 +344,8 @@ UsbSchedulerAllocateElement(
     // Variables
     UsbSchedulerObject_t *sObject   = NULL;
     UsbSchedulerPool_t *sPool       = NULL;
-    size_t i;
+    uint8_t *Element                = NULL;
+    uint16_t Index;
 
     // Get pool
     assert(ElementOut != NULL);
@@ -324,26 +354,26 @@ UsbSchedulerAllocateElement(
 
     // Now, we usually allocated new descriptors for interrupts
     // and isoc, but it doesn't make sense for us as we keep one
-    // large pool of TDs, just allocate from that in any case
+    // large pool of TDs, just pop the next free index from that
     SpinlockAcquire(&Scheduler->Lock);
-    for (i = sPool->ElementCountReserved; i < sPool->ElementCount; i++) {
-        uint8_t *Element        = USB_ELEMENT_INDEX(sPool, i);
-        sObject                 = USB_ELEMENT_OBJECT(sPool, Element);
-        if (sObject->Flags & USB_ELEMENT_ALLOCATED) {
-            continue;
-        }
-
-        // Found one, reset
-        memset((void*)Element, 0, sPool->ElementAlignedSize);
-        sObject->Index          = USB_ELEMENT_CREATE_INDEX(Pool, i);
-        sObject->BreathIndex    = USB_ELEMENT_NO_INDEX;
-        sObject->DepthIndex     = USB_ELEMENT_NO_INDEX;
-        sObject->Flags          = USB_ELEMENT_ALLOCATED;
-        *ElementOut             = Element;
-        break;
+    if (sPool->ElementFreeCount == 0) {
+        SpinlockRelease(&Scheduler->Lock);
+        *ElementOut = NULL;
+        return OsError;
     }
+    Index = sPool->ElementFreeStack[--sPool->ElementFreeCount];
     SpinlockRelease(&Scheduler->Lock);
-    return (*ElementOut == NULL) ? OsError : OsSuccess;
+
+    // Reset the element outside of the lock, it's ours now
+    Element                 = USB_ELEMENT_INDEX(sPool, Index);
+    sObject                 = USB_ELEMENT_OBJECT(sPool, Element);
+    memset((void*)Element, 0, sPool->ElementAlignedSize);
+    sObject->Index          = USB_ELEMENT_CREATE_INDEX(Pool, Index);
+    sObject->BreathIndex    = USB_ELEMENT_NO_INDEX;
+    sObject->DepthIndex     = USB_ELEMENT_NO_INDEX;
+    sObject->Flags          = USB_ELEMENT_ALLOCATED;
+    *ElementOut             = Element;
+    return OsSuccess;
 }
 
 /* UsbSchedulerAllocateBandwidthSubframe
@@ -595,17 +625,37 @@ UsbSchedulerFreeElement(
     UsbSchedulerObject_t *sObject   = NULL;
     UsbSchedulerPool_t *sPool       = NULL;
     OsStatus_t Result               = OsSuccess;
+    uint32_t Flags;
+    uint16_t Index;
     
     // Validate element and lookup pool
     Result                  = UsbSchedulerGetPoolFromElement(Scheduler, Element, &sPool);
     assert(Result == OsSuccess);
     sObject                 = USB_ELEMENT_OBJECT(sPool, Element);
 
+    // Claim the element under the lock, so concurrent frees of the
+    // same element only release it once. Already free elements are ignored
+    SpinlockAcquire(&Scheduler->Lock);
+    Flags                   = sObject->Flags;
+    sObject->Flags         &= ~(USB_ELEMENT_ALLOCATED);
+    SpinlockRelease(&Scheduler->Lock);
+    if (!(Flags & USB_ELEMENT_ALLOCATED)) {
+        return;
+    }
+
     // Should we free bandwidth?
-    if (sObject->Flags & USB_ELEMENT_BANDWIDTH) {
+    if (Flags & USB_ELEMENT_BANDWIDTH) {
         UsbSchedulerFreeBandwidth(Scheduler, Element);
     }
 
-    // Simply reset the data
+    // Simply reset the data, reserved elements are never put on the free stack
+    Index                   = (uint16_t)((Element - sPool->ElementPool) / sPool->ElementAlignedSize);
     memset((void*)Element, 0, sPool->ElementAlignedSize);
+    if (Index < sPool->ElementCountReserved) {
+        return;
+    }
+
+    SpinlockAcquire(&Scheduler->Lock);
+    sPool->ElementFreeStack[sPool->ElementFreeCount++] = Index;
+    SpinlockRelease(&Scheduler->Lock);
 }
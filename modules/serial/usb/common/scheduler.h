@@ -111,6 +111,9 @@ typedef struct _UsbSchedulerPool {
     size_t      ElementLinkBreathOffset;    // Offset to the physical breath link member
     size_t      ElementDepthBreathOffset;   // Offset to the physical breath link member
     size_t      ElementObjectOffset;        // Offset to the UsbSchedulerObject
+
+    uint16_t*   ElementFreeStack;           // Stack of free element indices
+    size_t      ElementFreeCount;           // Number of indices on the free stack
 } UsbSchedulerPool_t;
 
 /* UsbSchedulerSettings
@@ -200,7 +203,8 @@ UsbSchedulerSettingsAddPool(
 /* UsbSchedulerInitialize 
  * Initializes a new instance of a scheduler that can be used to
  * keep track of controller bandwidth and which frames are active.
- * MaxBandwidth is usually either 800 or 900. */
+ * MaxBandwidth is usually either 800 or 900. Returns OsOutOfMemory if the
+ * management resources could not be allocated. */
 __EXTERN
 OsStatus_t
 UsbSchedulerInitialize(
@@ -258,7 +262,7 @@ UsbSchedulerGetPoolFromElementPhysical(
 /* UsbSchedulerAllocateElement
  * Allocates a new element for usage with the scheduler. If this returns
  * OsError we are out of elements and we should wait till next transfer. ElementOut
- * will in this case be set to USB_OUT_OF_RESOURCES. */
+ * will in this case be set to USB_OUT_OF_RESOURCES. Allocation is constant time. */
 __EXTERN
 OsStatus_t
 UsbSchedulerAllocateElement(
@@ -268,7 +272,7 @@ UsbSchedulerAllocateElement(
 
 /* UsbSchedulerFreeElement
  * Releases the previously allocated element by resetting it. This call automatically
- * frees any bandwidth associated with the element. */
+ * frees any bandwidth associated with the element. Releasing is constant time. */
 __EXTERN
 void
 UsbSchedulerFreeElement(
@@ -82,6 +82,23 @@ OnUnregister(
     return HciControllerDestroy(Controller);
 }
 
+/* UsbManagerReleaseUntracked
+ * Frees a transfer that the controller did not keep in its transaction list,
+ * which happens when it was completed or rejected during queueing. */
+static void
+UsbManagerReleaseUntracked(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer)
+{
+    // Variables
+    DataKey_t Key;
+
+    Key.Value = (int)Transfer->Id;
+    if (CollectionGetDataByKey(Controller->TransactionList, Key, 0) == NULL) {
+        free(Transfer);
+    }
+}
+
 /* OnQuery
  * Occurs when an external process or server quries
  * this driver for data, this will correspond to the query
@@ -126,6 +143,8 @@ OnQuery(
             ResPackage.Id               = Transfer->Id;
             ResPackage.BytesTransferred = 0;
             if (ResPackage.Status != TransferQueued) {
+                // Transfers completed or rejected inline were never tracked
+                UsbManagerReleaseUntracked(Controller, Transfer);
                 return RPCRespond(Address, (void*)&ResPackage, sizeof(UsbTransferResult_t));
             }
             else {
@@ -151,6 +170,9 @@ OnQuery(
             }
             ResPackage.Id               = Transfer->Id;
             ResPackage.BytesTransferred = 0;
+            if (ResPackage.Status != TransferQueued) {
+                UsbManagerReleaseUntracked(Controller, Transfer);
+            }
             return RPCRespond(Address, (void*)&ResPackage, sizeof(UsbTransferResult_t));
         } break;
 
@@ -181,6 +203,44 @@ OnQuery(
             return RPCRespond(Address, (void*)&Status, sizeof(UsbTransferStatus_t));
         } break;
 
+        // Cancel a blocking transfer
+        case __USBHOST_DEQUEUETRANSFER: {
+            // Variables
+            UsbTransfer_t *Request          = (UsbTransfer_t*)Arg1->Data.Buffer;
+            UsbTransferStatus_t Status      = TransferInvalid;
+            DataKey_t Key;
+
+            // Callers don't know the id of a blocking transfer, so match it
+            // by its address, stream and buffer instead
+            foreach(tNode, Controller->TransactionList) {
+                UsbManagerTransfer_t *NodeTransfer = (UsbManagerTransfer_t*)tNode->Data;
+                if ((NodeTransfer->Transfer.Type == ControlTransfer || NodeTransfer->Transfer.Type == BulkTransfer)
+                    && !(NodeTransfer->Flags & (TransferFlagNotified | TransferFlagUnschedule | TransferFlagCleanup))
+                    && NodeTransfer->Transfer.StreamId == Request->StreamId
+                    && NodeTransfer->Transfer.Transactions[0].BufferAddress == Request->Transactions[0].BufferAddress
+                    && UsbManagerIsAddressesEqual(&NodeTransfer->Transfer.Address, &Request->Address) == OsSuccess) {
+                    Transfer = NodeTransfer;
+                    break;
+                }
+            }
+
+            // Transfers still waiting for their turn never reached the hardware
+            if (Transfer != NULL) {
+                Transfer->Status = TransferCancelled;
+                if (Transfer->EndpointDescriptor == NULL) {
+                    Key.Value = (int)Transfer->Id;
+                    CollectionRemoveByKey(Controller->TransactionList, Key);
+                    UsbManagerSendNotification(Transfer);
+                    free(Transfer);
+                    Status = TransferFinished;
+                }
+                else {
+                    Status = HciDequeueTransfer(Transfer);
+                }
+            }
+            return RPCRespond(Address, (void*)&Status, sizeof(UsbTransferStatus_t));
+        } break;
+
         // Reset port
         case __USBHOST_RESETPORT: {
             // Call reset procedure, then let it fall through to QueryPort
@@ -0,0 +1,127 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - USB Controller Manager Tests
+ * - Verifies the transfer bookkeeping of the usb-manager, these run when
+ *   the driver loads if __OSCONFIG_TEST_USB is defined
+ */
+#ifdef __OSCONFIG_TEST_USB
+#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/utils.h>
+#include "manager.h"
+
+/* Includes
+ * - Library */
+#include <assert.h>
+#include <string.h>
+
+#define TEST_TRANSFER_COUNT 8
+
+/* UsbManagerTestContext
+ * Records the order in which the done list handed out transfers. */
+typedef struct _UsbManagerTestContext {
+    UUId_t  Visited[TEST_TRANSFER_COUNT * 2];
+    int     VisitCount;
+} UsbManagerTestContext_t;
+
+/* UsbManagerTestComplete
+ * Completion callback for the done list tests, transfers with an id that is a
+ * multiple of four are removed, the rest are kept. */
+static int
+UsbManagerTestComplete(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer,
+    _In_ void*                      Context)
+{
+    // Variables
+    UsbManagerTestContext_t *Test = (UsbManagerTestContext_t*)Context;
+    _CRT_UNUSED(Controller);
+
+    assert(!(Transfer->Flags & TransferFlagDone));
+    Test->Visited[Test->VisitCount++] = Transfer->Id;
+    return (Transfer->Id % 4) == 0 ? ITERATOR_REMOVE : ITERATOR_CONTINUE;
+}
+
+/* UsbManagerRunTests
+ * Verifies the transfer bookkeeping of the usb-manager without any hardware. */
+void
+UsbManagerRunTests(void)
+{
+    // Variables
+    UsbManagerTransfer_t Transfers[TEST_TRANSFER_COUNT];
+    UsbManagerController_t Controller;
+    UsbManagerTestContext_t Test;
+    DataKey_t Key;
+    int i;
+
+    TRACE("UsbManagerRunTests()");
+    memset(&Controller, 0, sizeof(UsbManagerController_t));
+    memset(&Transfers[0], 0, sizeof(Transfers));
+    memset(&Test, 0, sizeof(UsbManagerTestContext_t));
+    Controller.TransactionList  = CollectionCreate(KeyInteger);
+    Controller.DoneList         = CollectionCreate(KeyInteger);
+    for (i = 0; i < TEST_TRANSFER_COUNT; i++) {
+        Transfers[i].Id     = (UUId_t)i;
+        Transfers[i].Status = TransferQueued;
+        Key.Value           = i;
+        CollectionAppend(Controller.TransactionList, CollectionCreateNode(Key, &Transfers[i]));
+    }
+
+    // Test 1. Only the queued transfers are completed, once each and in the
+    // order they were queued, even when queued twice
+    TRACE(" > Queueing transfers 6, 4, 2, 0 and 4 again");
+    UsbManagerQueueDoneTransfer(&Controller, &Transfers[6]);
+    UsbManagerQueueDoneTransfer(&Controller, &Transfers[4]);
+    UsbManagerQueueDoneTransfer(&Controller, &Transfers[2]);
+    UsbManagerQueueDoneTransfer(&Controller, &Transfers[0]);
+    UsbManagerQueueDoneTransfer(&Controller, &Transfers[4]);
+    assert(CollectionLength(Controller.DoneList) == 4);
+
+    UsbManagerProcessDoneTransfers(&Controller, UsbManagerTestComplete, &Test);
+    assert(Test.VisitCount == 4);
+    assert(Test.Visited[0] == 6 && Test.Visited[1] == 4
+        && Test.Visited[2] == 2 && Test.Visited[3] == 0);
+    assert(CollectionLength(Controller.DoneList) == 0);
+
+    // Test 2. Removed transfers left the transaction list, the rest stayed
+    TRACE(" > Verifying the transaction list");
+    assert(CollectionLength(Controller.TransactionList) == TEST_TRANSFER_COUNT - 2);
+    for (i = 0; i < TEST_TRANSFER_COUNT; i++) {
+        Key.Value = i;
+        if (i == 0 || i == 4) {
+            assert(CollectionGetDataByKey(Controller.TransactionList, Key, 0) == NULL);
+        }
+        else {
+            assert(CollectionGetDataByKey(Controller.TransactionList, Key, 0) == &Transfers[i]);
+        }
+    }
+
+    // Test 3. A transfer can be queued again once it has been completed
+    TRACE(" > Requeueing transfer 6");
+    UsbManagerQueueDoneTransfer(&Controller, &Transfers[6]);
+    UsbManagerProcessDoneTransfers(&Controller, UsbManagerTestComplete, &Test);
+    assert(Test.VisitCount == 5 && Test.Visited[4] == 6);
+
+    CollectionDestroy(Controller.DoneList);
+    CollectionDestroy(Controller.TransactionList);
+    TRACE(" > All usb-manager tests passed");
+}
+#endif
@@ -40,7 +40,8 @@ typedef enum _UsbManagerTransferFlags {
     TransferFlagSchedule    = 0x4,
     TransferFlagUnschedule  = 0x8,
     TransferFlagCleanup     = 0x10,
-    TransferFlagNotified    = 0x20
+    TransferFlagNotified    = 0x20,
+    TransferFlagDone        = 0x40
 } UsbManagerTransferFlags_t;
 
 /* UsbManagerTransfer
@@ -59,6 +60,7 @@ typedef struct _UsbManagerTransfer {
     // Control/Interrupt transfers are small, but carry data.
     // Information here is shared
     void*                       EndpointDescriptor;  // We only use one no matter what
+    uint8_t*                    ScanElement;         // First element not yet retired
     int                         TransactionsExecuted;
     int                         TransactionsTotal;
     size_t                      BytesTransferred[USB_TRANSACTIONCOUNT]; // In Total
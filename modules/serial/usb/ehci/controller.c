@@ -61,6 +61,7 @@ HciControllerCreate(
     Controller->Base.Contract.DeviceId  = Controller->Base.Device.Id;
     Controller->Base.Type               = UsbEHCI;
     Controller->Base.TransactionList    = CollectionCreate(KeyInteger);
+    Controller->Base.DoneList           = CollectionCreate(KeyInteger);
     Controller->Base.Endpoints          = CollectionCreate(KeyInteger);
     SpinlockReset(&Controller->Base.Lock);
 
@@ -168,6 +169,7 @@ HciControllerDestroy(
 
     // Free the list of endpoints
     CollectionDestroy(Controller->TransactionList);
+    CollectionDestroy(Controller->DoneList);
     CollectionDestroy(Controller->Endpoints);
     free(Controller);
     return OsSuccess;
@@ -535,7 +537,10 @@ EhciSetup(
 
     // We then stop the controller, reset it and 
     // initialize data-structures
-    EhciQueueInitialize(Controller);
+    if (EhciQueueInitialize(Controller) != OsSuccess) {
+        ERROR("Failed to initialize the queue system");
+        return OsError;
+    }
     EhciRestart(Controller);
     EhciWaitForCompanionControllers(Controller);    
     
@@ -153,7 +153,10 @@ EhciQueueInitialize(
     
     // Create the scheduler
     TRACE(" > Initializing scheduler");
-    UsbSchedulerInitialize(&Settings, &Controller->Base.Scheduler);
+    if (UsbSchedulerInitialize(&Settings, &Controller->Base.Scheduler) != OsSuccess) {
+        ERROR("Failed to initialize the usb scheduler");
+        return OsOutOfMemory;
+    }
     return EhciQueueResetInternalData(Controller);
 }
 
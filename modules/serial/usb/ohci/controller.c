@@ -61,6 +61,7 @@ HciControllerCreate(
     Controller->Base.Contract.DeviceId  = Controller->Base.Device.Id;
     Controller->Base.Type               = UsbOHCI;
     Controller->Base.TransactionList    = CollectionCreate(KeyInteger);
+    Controller->Base.DoneList           = CollectionCreate(KeyInteger);
     Controller->Base.Endpoints          = CollectionCreate(KeyInteger);
     SpinlockReset(&Controller->Base.Lock);
 
@@ -174,6 +175,7 @@ HciControllerDestroy(
     DestroyIoSpace(Controller->IoBase->Id);
 
     // Free the list of endpoints
+    CollectionDestroy(Controller->DoneList);
     CollectionDestroy(Controller->Endpoints);
     free(Controller);
     return OsSuccess;
@@ -385,7 +387,10 @@ OhciSetup(
     }
 
     // Initialize the queue system
-    OhciQueueInitialize(Controller);
+    if (OhciQueueInitialize(Controller) != OsSuccess) {
+        ERROR("Failed to initialize the queue system");
+        return OsError;
+    }
 
     // Last step is to take ownership, reset the controller and initialize
     // the registers, all resource must be allocated before this
@@ -102,6 +102,7 @@ HciControllerCreate(
 	Controller->Base.Contract.DeviceId  = Controller->Base.Device.Id;
 	Controller->Base.Type               = UsbUHCI;
     Controller->Base.TransactionList    = CollectionCreate(KeyInteger);
+    Controller->Base.DoneList           = CollectionCreate(KeyInteger);
 	Controller->Base.Endpoints          = CollectionCreate(KeyInteger);
 	SpinlockReset(&Controller->Base.Lock);
 
@@ -223,6 +224,7 @@ HciControllerDestroy(
 
     // Clean up allocated lists
 	CollectionDestroy(Controller->TransactionList);
+	CollectionDestroy(Controller->DoneList);
 	CollectionDestroy(Controller->Endpoints);
 	free(Controller);
 	return OsSuccess;
@@ -342,7 +344,10 @@ UhciSetup(
 
 	// Initialize queues and controller
     TRACE(" > Initializing queue system");
-	UhciQueueInitialize(Controller);
+	if (UhciQueueInitialize(Controller) != OsSuccess) {
+        ERROR("Failed to initialize the queue system");
+        return OsError;
+    }
     TRACE(" > Resetting controller");
 	if (UhciReset(Controller) != OsSuccess) {
         ERROR("UHCI::Failed to reset controller");
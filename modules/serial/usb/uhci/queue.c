@@ -236,7 +236,10 @@ UhciQueueInitialize(
     
     // Create the scheduler
     TRACE(" > Initializing scheduler");
-    UsbSchedulerInitialize(&Settings, &Controller->Base.Scheduler);
+    if (UsbSchedulerInitialize(&Settings, &Controller->Base.Scheduler) != OsSuccess) {
+        ERROR("Failed to initialize the usb scheduler");
+        return OsOutOfMemory;
+    }
 
     // Initialize internal data structures
     return UhciQueueResetInternalData(Controller);
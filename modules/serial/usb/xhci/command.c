@@ -0,0 +1,172 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * - Command ring
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/utils.h>
+#include "xhci.h"
+
+/* Includes
+ * - Library */
+#include <threads.h>
+
+/* XhciCommandSubmit
+ * Writes the command trb, tracks it and rings the host controller doorbell.
+ * Returns the index of the command trb, or -1 if the ring is full. */
+static int
+XhciCommandSubmit(
+    _In_     XhciController_t*  Controller,
+    _In_     uint64_t           Parameter,
+    _In_     reg32_t            Status,
+    _In_     reg32_t            Control,
+    _In_Opt_ XhciCommandCallback Callback,
+    _In_Opt_ void*              Context)
+{
+    // Variables
+    XhciRing_t *Ring = &Controller->CommandRing;
+    size_t Index;
+
+    SpinlockAcquire(&Ring->Lock);
+    if (XhciRingSpace(Ring) == 0) {
+        SpinlockRelease(&Ring->Lock);
+        return -1;
+    }
+
+    XhciRingBegin(Ring);
+    Index = Ring->Enqueue;
+    Controller->Commands[Index].Pending         = 1;
+    Controller->Commands[Index].CompletionCode  = 0;
+    Controller->Commands[Index].SlotId          = 0;
+    Controller->Commands[Index].Callback        = Callback;
+    Controller->Commands[Index].Context         = Context;
+    XhciRingEnqueue(Ring, Parameter, Status, Control);
+    XhciRingCommit(Ring);
+    SpinlockRelease(&Ring->Lock);
+
+    // Doorbell 0 targets the command ring
+    Controller->Doorbells[0] = 0;
+    return (int)Index;
+}
+
+/* XhciCommandQueue
+ * Queues a command on the command ring without waiting for it, the callback
+ * is invoked from the event handler upon completion. */
+OsStatus_t
+XhciCommandQueue(
+    _In_     XhciController_t*  Controller,
+    _In_     uint64_t           Parameter,
+    _In_     reg32_t            Status,
+    _In_     reg32_t            Control,
+    _In_Opt_ XhciCommandCallback Callback,
+    _In_Opt_ void*              Context)
+{
+    if (XhciCommandSubmit(Controller, Parameter, Status, Control, Callback, Context) < 0) {
+        return OsError;
+    }
+    return OsSuccess;
+}
+
+/* XhciCommandExecute
+ * Queues a command and waits for the completion event. Must not be called
+ * from the event handler. Returns the completion code, or 0 on timeout. */
+int
+XhciCommandExecute(
+    _In_      XhciController_t* Controller,
+    _In_      uint64_t          Parameter,
+    _In_      reg32_t           Status,
+    _In_      reg32_t           Control,
+    _Out_Opt_ int*              SlotId)
+{
+    // Variables
+    XhciCommand_t *Command  = NULL;
+    int Index, Timeout;
+
+    // Debug
+    TRACE("XhciCommandExecute(Type %u)", XHCI_TRB_GETTYPE(Control));
+
+    Index = XhciCommandSubmit(Controller, Parameter, Status, Control, NULL, NULL);
+    if (Index < 0) {
+        return 0;
+    }
+    Command = &Controller->Commands[Index];
+
+    // Poll the event ring ourself, the completion might otherwise be
+    // waiting for this very thread to handle the interrupt
+    for (Timeout = 0; Timeout < XHCI_COMMAND_TIMEOUT; Timeout++) {
+        XhciProcessEvents(Controller);
+        if (!Command->Pending) {
+            break;
+        }
+        thrd_sleepex(1);
+    }
+
+    if (Command->Pending) {
+        ERROR("XHCI: Command (type %u) timed out", XHCI_TRB_GETTYPE(Control));
+        Command->Pending = 0;
+        return 0;
+    }
+    if (SlotId != NULL) {
+        *SlotId = Command->SlotId;
+    }
+    return Command->CompletionCode;
+}
+
+/* XhciCommandComplete
+ * Handles a command completion event */
+void
+XhciCommandComplete(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciTrb_t*             Event)
+{
+    // Variables
+    XhciRing_t *Ring            = &Controller->CommandRing;
+    XhciCommand_t *Command      = NULL;
+    XhciCommandCallback Callback;
+    void *Context;
+    int Index;
+
+    Index = XhciRingGetIndex(Ring, Event->ParameterLow);
+    if (Index < 0 || Index >= XHCI_RING_SIZE - 1) {
+        WARNING("XHCI: Completion for unknown command 0x%x", Event->ParameterLow);
+        return;
+    }
+
+    // Commands complete in order, so everything up to here is consumed
+    SpinlockAcquire(&Ring->Lock);
+    XhciRingRetire(Ring, (size_t)Index);
+    SpinlockRelease(&Ring->Lock);
+
+    Command                 = &Controller->Commands[Index];
+    Callback                = Command->Callback;
+    Context                 = Command->Context;
+    Command->CompletionCode = XHCI_EVENT_CODE(Event->Status);
+    Command->SlotId         = XHCI_EVENT_GETSLOT(Event->Control);
+    Command->Callback       = NULL;
+    MemoryBarrier();
+    Command->Pending        = 0;
+
+    if (Callback != NULL) {
+        Callback(Controller, XHCI_EVENT_CODE(Event->Status),
+            XHCI_EVENT_GETSLOT(Event->Control), Context);
+    }
+}
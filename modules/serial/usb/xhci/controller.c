@@ -0,0 +1,529 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * TODO:
+ * - Power Management
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/mollenos.h>
+#include <os/device.h>
+#include <os/utils.h>
+#include "../common/hci.h"
+#include "xhci.h"
+
+/* Includes
+ * - Library */
+#include <threads.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define XHCI_PAGE_SIZE      0x1000
+
+/* Prototypes
+ * This is to keep the create/destroy at the top of the source file */
+OsStatus_t          XhciSetup(XhciController_t *Controller);
+void                XhciMemoryDestroy(XhciController_t *Controller);
+InterruptStatus_t   OnFastInterrupt(void *InterruptData);
+
+/* XhciUnregisterInterrupt
+ * Releases the interrupt of the controller, whether it's message signaled or not */
+static void
+XhciUnregisterInterrupt(
+    _In_ XhciController_t*      Controller)
+{
+    if (Controller->MsiEnabled) {
+        UnregisterMsiInterrupts(&Controller->Base.Device, &Controller->Base.Interrupt, 1);
+        Controller->MsiEnabled = 0;
+    }
+    else {
+        UnregisterInterruptSource(Controller->Base.Interrupt);
+    }
+}
+
+/* HciControllerCreate
+ * Initializes and creates a new Hci Controller instance
+ * from a given new system device on the bus. */
+UsbManagerController_t*
+HciControllerCreate(
+    _In_ MCoreDevice_t*             Device)
+{
+    // Variables
+    XhciController_t *Controller    = NULL;
+    DeviceIoSpace_t *IoBase         = NULL;
+    InterruptCoalescing_t Policy    = XHCI_COALESCING_POLICY;
+    int i;
+
+    // Allocate a new instance of the controller
+    Controller = (XhciController_t*)malloc(sizeof(XhciController_t));
+    memset(Controller, 0, sizeof(XhciController_t));
+    memcpy(&Controller->Base.Device, Device, Device->Length);
+    Controller->Coalescing              = Policy;
+
+    // Fill in some basic stuff needed for init
+    Controller->Base.Contract.DeviceId  = Controller->Base.Device.Id;
+    Controller->Base.Type               = UsbXHCI;
+    Controller->Base.TransactionList    = CollectionCreate(KeyInteger);
+    Controller->Base.DoneList           = CollectionCreate(KeyInteger);
+    Controller->Base.Endpoints          = CollectionCreate(KeyInteger);
+    SpinlockReset(&Controller->Base.Lock);
+    SpinlockReset(&Controller->EventLock);
+
+    // Get I/O Base, and for XHCI it'll be the first address we encounter
+    // of type MMIO
+    for (i = 0; i < __DEVICEMANAGER_MAX_IOSPACES; i++) {
+        if (Controller->Base.Device.IoSpaces[i].Size != 0
+            && Controller->Base.Device.IoSpaces[i].Type == IO_SPACE_MMIO) {
+            IoBase = &Controller->Base.Device.IoSpaces[i];
+            break;
+        }
+    }
+
+    // Sanitize that we found the io-space
+    if (IoBase == NULL) {
+        ERROR("No memory space found for xhci-controller");
+        free(Controller);
+        return NULL;
+    }
+
+    // Trace
+    TRACE("Found Io-Space (Type %u, Physical 0x%x, Size 0x%x)",
+        IoBase->Type, IoBase->PhysicalBase, IoBase->Size);
+
+    // Acquire the io-space
+    if (CreateIoSpace(IoBase) != OsSuccess || AcquireIoSpace(IoBase) != OsSuccess) {
+        ERROR("Failed to create and acquire the io-space for xhci-controller");
+        free(Controller);
+        return NULL;
+    }
+    else {
+        // Store information
+        Controller->Base.IoBase = IoBase;
+    }
+
+    // Start out by initializing the contract
+    InitializeContract(&Controller->Base.Contract, Controller->Base.Contract.DeviceId, 1,
+        ContractController, "XHCI Controller Interface");
+
+    // Trace
+    TRACE("Io-Space was assigned virtual address 0x%x", IoBase->VirtualBase);
+
+    // Instantiate the register-access
+    Controller->CapRegisters    = (XhciCapabilityRegisters_t*)IoBase->VirtualBase;
+    Controller->OpRegisters     = (XhciOperationalRegisters_t*)
+        (IoBase->VirtualBase + Controller->CapRegisters->Length);
+    Controller->RtRegisters     = (XhciRuntimeRegisters_t*)
+        (IoBase->VirtualBase + (Controller->CapRegisters->RuntimeOffset & ~0x1F));
+    Controller->Doorbells       = (reg32_t*)
+        (IoBase->VirtualBase + (Controller->CapRegisters->DoorbellOffset & ~0x3));
+
+    // Initialize the interrupt settings
+    Controller->Base.Device.Interrupt.FastHandler   = OnFastInterrupt;
+    Controller->Base.Device.Interrupt.Data          = Controller;
+    if (RegisterContract(&Controller->Base.Contract) != OsSuccess) {
+        ERROR("Failed to register contract for xhci-controller");
+        ReleaseIoSpace(Controller->Base.IoBase);
+        DestroyIoSpace(Controller->Base.IoBase->Id);
+        free(Controller);
+        return NULL;
+    }
+
+    // Register interrupt, prefer a message signaled interrupt
+    // and fall back to the legacy line
+    if (RegisterMsiInterrupts(&Controller->Base.Device, &Controller->Base.Device.Interrupt,
+        1, INTERRUPT_USERSPACE, &Controller->Base.Interrupt) == 1) {
+        Controller->MsiEnabled  = 1;
+    }
+    else {
+        Controller->Base.Interrupt  = RegisterInterruptSource(
+            &Controller->Base.Device.Interrupt, INTERRUPT_USERSPACE);
+    }
+
+    // Enable device
+    if (IoctlDevice(Controller->Base.Device.Id, __DEVICEMANAGER_IOCTL_BUS,
+        (__DEVICEMANAGER_IOCTL_ENABLE | __DEVICEMANAGER_IOCTL_MMIO_ENABLE
+            | __DEVICEMANAGER_IOCTL_BUSMASTER_ENABLE)) != OsSuccess) {
+        ERROR("Failed to enable the xhci-controller");
+        XhciUnregisterInterrupt(Controller);
+        ReleaseIoSpace(Controller->Base.IoBase);
+        DestroyIoSpace(Controller->Base.IoBase->Id);
+        free(Controller);
+        return NULL;
+    }
+
+    // Now that all formalities has been taken care
+    // off we can actually setup controller
+    if (XhciSetup(Controller) == OsSuccess) {
+        return &Controller->Base;
+    }
+    else {
+        HciControllerDestroy(&Controller->Base);
+        return NULL;
+    }
+}
+
+/* HciControllerDestroy
+ * Destroys an existing controller instance and cleans up
+ * any resources related to it */
+OsStatus_t
+HciControllerDestroy(
+    _In_ UsbManagerController_t*    Controller)
+{
+    // Variables
+    XhciController_t *Xhci = (XhciController_t*)Controller;
+
+    // Unregister, then destroy
+    UsbManagerDestroyController(Controller);
+
+    // Stop the controller before releasing memory it may access
+    Xhci->OpRegisters->UsbCommand &= ~(XHCI_COMMAND_RUN | XHCI_COMMAND_INTERRUPTS);
+    XhciMemoryDestroy(Xhci);
+
+    // Unregister the interrupt
+    XhciUnregisterInterrupt(Xhci);
+
+    // Release the io-space
+    ReleaseIoSpace(Controller->IoBase);
+    DestroyIoSpace(Controller->IoBase->Id);
+
+    // Free the list of endpoints
+    CollectionDestroy(Controller->TransactionList);
+    CollectionDestroy(Controller->DoneList);
+    CollectionDestroy(Controller->Endpoints);
+    free(Controller);
+    return OsSuccess;
+}
+
+/* XhciAllocateMemory
+ * Allocates zeroed, uncached and physically contiguous memory that can be
+ * handed to the controller. */
+OsStatus_t
+XhciAllocateMemory(
+    _In_  XhciController_t*     Controller,
+    _In_  size_t                Length,
+    _Out_ void**                Memory,
+    _Out_ uintptr_t*            PhysicalAddress)
+{
+    _CRT_UNUSED(Controller);
+    return MemoryAllocate(NULL, Length, MEMORY_CLEAN | MEMORY_COMMIT | MEMORY_LOWFIRST
+        | MEMORY_CONTIGIOUS | MEMORY_UNCHACHEABLE, Memory, PhysicalAddress);
+}
+
+/* XhciMemoryDestroy
+ * Releases the controller-wide memory structures */
+void
+XhciMemoryDestroy(
+    _In_ XhciController_t*          Controller)
+{
+    XhciRingDestroy(&Controller->CommandRing);
+    if (Controller->EventRing != NULL) {
+        MemoryFree((void*)Controller->EventRing, XHCI_EVENT_RING_SIZE * sizeof(XhciTrb_t));
+    }
+    if (Controller->EventTable != NULL) {
+        MemoryFree((void*)Controller->EventTable, sizeof(XhciEventTableEntry_t));
+    }
+    if (Controller->Scratchpads != NULL) {
+        MemoryFree(Controller->Scratchpads, Controller->ScratchpadCount * XHCI_PAGE_SIZE);
+    }
+    if (Controller->ScratchpadTable != NULL) {
+        MemoryFree((void*)Controller->ScratchpadTable, Controller->ScratchpadCount * sizeof(reg64_t));
+    }
+    if (Controller->ContextBase != NULL) {
+        MemoryFree((void*)Controller->ContextBase, (XHCI_MAX_SLOTS + 1) * sizeof(reg64_t));
+    }
+}
+
+/* XhciMemoryInitialize
+ * Allocates the device context array, scratchpads, the command ring
+ * and the event ring. */
+OsStatus_t
+XhciMemoryInitialize(
+    _In_ XhciController_t*          Controller)
+{
+    // Variables
+    size_t i;
+
+    // Debug
+    TRACE("XhciMemoryInitialize()");
+
+    if (XhciAllocateMemory(Controller, (XHCI_MAX_SLOTS + 1) * sizeof(reg64_t),
+            (void**)&Controller->ContextBase, &Controller->ContextBasePhysical) != OsSuccess) {
+        return OsError;
+    }
+
+    // The controller may request private memory, pointed to by slot 0
+    Controller->ScratchpadCount = XHCI_SPARAM2_SCRATCHPADS(Controller->SParameters2);
+    if (Controller->ScratchpadCount != 0) {
+        uintptr_t PagesPhysical = 0;
+        if (XhciAllocateMemory(Controller, Controller->ScratchpadCount * sizeof(reg64_t),
+                (void**)&Controller->ScratchpadTable, &Controller->ScratchpadTablePhysical) != OsSuccess
+            || XhciAllocateMemory(Controller, Controller->ScratchpadCount * XHCI_PAGE_SIZE,
+                &Controller->Scratchpads, &PagesPhysical) != OsSuccess) {
+            return OsError;
+        }
+        for (i = 0; i < Controller->ScratchpadCount; i++) {
+            Controller->ScratchpadTable[i] = PagesPhysical + (i * XHCI_PAGE_SIZE);
+        }
+    }
+
+    if (XhciRingInitialize(Controller, &Controller->CommandRing) != OsSuccess) {
+        return OsError;
+    }
+    if (XhciAllocateMemory(Controller, XHCI_EVENT_RING_SIZE * sizeof(XhciTrb_t),
+            (void**)&Controller->EventRing, &Controller->EventRingPhysical) != OsSuccess
+        || XhciAllocateMemory(Controller, sizeof(XhciEventTableEntry_t),
+            (void**)&Controller->EventTable, &Controller->EventTablePhysical) != OsSuccess) {
+        return OsError;
+    }
+    Controller->EventTable->AddressLow  = LODWORD(Controller->EventRingPhysical);
+    Controller->EventTable->AddressHigh = 0;
+    Controller->EventTable->Size        = XHCI_EVENT_RING_SIZE;
+    return OsSuccess;
+}
+
+/* XhciDisableLegacySupport
+ * Takes ownership of the controller from the BIOS and disables the SMIs
+ * it may have enabled for PS/2 emulation. */
+void
+XhciDisableLegacySupport(
+    _In_ XhciController_t*          Controller)
+{
+    // Variables
+    reg32_t Offset  = XHCI_CPARAM1_XECP(Controller->CParameters1);
+    int Fault       = 0;
+
+    // Debug
+    TRACE("XhciDisableLegacySupport()");
+
+    // The extended capabilities live in the mmio space for the xhci
+    while (Offset != 0) {
+        reg32_t *Capability = (reg32_t*)(Controller->Base.IoBase->VirtualBase + (Offset << 2));
+        reg32_t Value       = Capability[0];
+
+        if (XHCI_XCAP_ID(Value) == XHCI_XCAP_LEGACY) {
+            if (Value & XHCI_LEGACY_BIOS_OWNED) {
+                Capability[0] = Value | XHCI_LEGACY_OS_OWNED;
+                WaitForConditionWithFault(Fault, (Capability[0] & XHCI_LEGACY_BIOS_OWNED) == 0, 250, 10);
+                if (Fault) {
+                    WARNING("XHCI: Failed to release BIOS Semaphore");
+                }
+            }
+
+            // Disable the SMIs and clear any pending events
+            Capability[1] = (Capability[1] & ~(XHCI_LEGACY_SMI_MASK)) | 0xE0000000;
+        }
+        else if (XHCI_XCAP_ID(Value) == XHCI_XCAP_PROTOCOL) {
+            // Record which ports are usb2 and which are usb3
+            int Major   = XHCI_PROTOCOL_MAJOR(Value);
+            int First   = XHCI_PROTOCOL_PORTOFFSET(Capability[2]);
+            int Count   = XHCI_PROTOCOL_PORTCOUNT(Capability[2]);
+            int i;
+            for (i = First; i < (First + Count) && i <= XHCI_MAX_PORTS; i++) {
+                if (i > 0) {
+                    Controller->PortProtocols[i - 1] = (uint8_t)Major;
+                }
+            }
+        }
+
+        if (XHCI_XCAP_NEXT(Value) == 0) {
+            break;
+        }
+        Offset += XHCI_XCAP_NEXT(Value);
+    }
+}
+
+/* XhciHalt
+ * Stops the controller and waits for it to halt */
+OsStatus_t
+XhciHalt(
+    _In_ XhciController_t*          Controller)
+{
+    // Variables
+    int Fault = 0;
+
+    // Debug
+    TRACE("XhciHalt()");
+
+    Controller->OpRegisters->UsbCommand &= ~(XHCI_COMMAND_RUN | XHCI_COMMAND_INTERRUPTS);
+    WaitForConditionWithFault(Fault, (Controller->OpRegisters->UsbStatus & XHCI_STATUS_HALTED) != 0, 20, 1);
+    if (Fault) {
+        ERROR("XHCI-Failure: Failed to stop controller, Command Register: 0x%x - Status: 0x%x",
+            Controller->OpRegisters->UsbCommand, Controller->OpRegisters->UsbStatus);
+        return OsError;
+    }
+    return OsSuccess;
+}
+
+/* XhciReset
+ * Resets the controller from the halted state, leaves it post-reset state. */
+OsStatus_t
+XhciReset(
+    _In_ XhciController_t*          Controller)
+{
+    // Variables
+    int Fault = 0;
+
+    // Debug
+    TRACE("XhciReset()");
+
+    Controller->OpRegisters->UsbCommand |= XHCI_COMMAND_HCRESET;
+    WaitForConditionWithFault(Fault, (Controller->OpRegisters->UsbCommand & XHCI_COMMAND_HCRESET) == 0, 250, 10);
+    if (Fault) {
+        ERROR("XHCI-Failure: Reset signal won't deassert");
+        return OsError;
+    }
+
+    // Registers can't be written until the controller is ready
+    WaitForConditionWithFault(Fault, (Controller->OpRegisters->UsbStatus & XHCI_STATUS_NOTREADY) == 0, 250, 10);
+    if (Fault) {
+        ERROR("XHCI-Failure: Controller did not become ready");
+        return OsError;
+    }
+    return OsSuccess;
+}
+
+/* XhciRestart
+ * Halts and resets the controller, then reinitializes all the memory
+ * structures and starts the controller again. */
+OsStatus_t
+XhciRestart(
+    _In_ XhciController_t*          Controller)
+{
+    // Variables
+    XhciInterrupterRegisters_t *Interrupter = &Controller->RtRegisters->Interrupters[0];
+    int Fault = 0;
+    size_t i;
+
+    // Debug
+    TRACE("XhciRestart()");
+
+    if (XhciHalt(Controller) != OsSuccess || XhciReset(Controller) != OsSuccess) {
+        ERROR("Failed to halt or reset controller");
+        return OsError;
+    }
+
+    // Reset the software state of the rings, previous device slots
+    // are gone with the reset
+    memset((void*)Controller->ContextBase, 0, (XHCI_MAX_SLOTS + 1) * sizeof(reg64_t));
+    if (Controller->ScratchpadCount != 0) {
+        Controller->ContextBase[0] = Controller->ScratchpadTablePhysical;
+    }
+    memset(&Controller->Commands[0], 0, sizeof(Controller->Commands));
+    XhciRingReset(&Controller->CommandRing);
+    memset((void*)Controller->EventRing, 0, XHCI_EVENT_RING_SIZE * sizeof(XhciTrb_t));
+    Controller->EventDequeue    = 0;
+    Controller->EventCycle      = 1;
+
+    // Program the memory structures
+    Controller->OpRegisters->Configure          = (reg32_t)Controller->MaxSlots;
+    Controller->OpRegisters->ContextBaseLow     = LODWORD(Controller->ContextBasePhysical);
+    Controller->OpRegisters->ContextBaseHigh    = 0;
+    Controller->OpRegisters->CommandRingLow     = LODWORD(Controller->CommandRing.TrbsPhysical) | XHCI_CRCR_CYCLE;
+    Controller->OpRegisters->CommandRingHigh    = 0;
+    Controller->OpRegisters->DeviceNotification = 0;
+
+    // Setup the primary interrupter, moderate by the coalescing policy
+    Interrupter->TableSize          = 1;
+    XhciWriteRegister64(&Interrupter->Dequeue, Controller->EventRingPhysical);
+    Interrupter->TableAddressLow    = LODWORD(Controller->EventTablePhysical);
+    Interrupter->TableAddressHigh   = 0;
+    Interrupter->Moderation         = XHCI_IMOD_INTERVAL(Controller->Coalescing.TimeoutUs);
+    Interrupter->Management         = XHCI_IMAN_PENDING | XHCI_IMAN_ENABLE;
+
+    // Start the controller
+    Controller->OpRegisters->UsbStatus  = Controller->OpRegisters->UsbStatus;
+    Controller->OpRegisters->UsbCommand = XHCI_COMMAND_RUN | XHCI_COMMAND_INTERRUPTS | XHCI_COMMAND_HOSTERROR;
+    WaitForConditionWithFault(Fault, (Controller->OpRegisters->UsbStatus & XHCI_STATUS_HALTED) == 0, 20, 1);
+    if (Fault) {
+        ERROR("XHCI-Failure: Controller did not start, status 0x%x", Controller->OpRegisters->UsbStatus);
+        return OsError;
+    }
+
+    // Drop the devices of the previous run, the slots no longer exist
+    for (i = 1; i <= XHCI_MAX_SLOTS; i++) {
+        if (Controller->Slots[i] != NULL) {
+            XhciDeviceDestroy(Controller, Controller->Slots[i], 1);
+        }
+    }
+    return OsSuccess;
+}
+
+/* XhciSetup
+ * Initializes the xhci-controller and boots it up into runnable state. */
+OsStatus_t
+XhciSetup(
+    _In_ XhciController_t*          Controller)
+{
+    // Variables
+    size_t i;
+
+    // Debug
+    TRACE("XhciSetup()");
+
+    // Save some read-only but often accessed information
+    Controller->SParameters1    = Controller->CapRegisters->SParams1;
+    Controller->SParameters2    = Controller->CapRegisters->SParams2;
+    Controller->CParameters1    = Controller->CapRegisters->CParams1;
+    Controller->Base.PortCount  = XHCI_SPARAM1_MAXPORTS(Controller->SParameters1);
+    Controller->MaxSlots        = MIN(XHCI_SPARAM1_MAXSLOTS(Controller->SParameters1), XHCI_MAX_SLOTS);
+    Controller->ContextSize     = (Controller->CParameters1 & XHCI_CPARAM1_CONTEXTSIZE) ? 64 : 32;
+
+    // Disable legacy support in controller
+    XhciDisableLegacySupport(Controller);
+
+    // We then stop the controller, reset it and
+    // initialize data-structures
+    if (XhciMemoryInitialize(Controller) != OsSuccess) {
+        ERROR("Failed to allocate memory for xhci controller");
+        return OsError;
+    }
+    if (XhciRestart(Controller) != OsSuccess) {
+        return OsError;
+    }
+
+    // Register the controller before starting
+    if (UsbManagerRegisterController(&Controller->Base) != OsSuccess) {
+        ERROR("Failed to register xhci controller with the system.");
+    }
+
+    // Power the ports if the controller lets us control it
+    if (Controller->CParameters1 & XHCI_CPARAM1_PPC) {
+        TRACE(" > Powering up ports");
+        for (i = 0; i < Controller->Base.PortCount; i++) {
+            reg32_t Status = Controller->OpRegisters->Ports[i].Status;
+            if (!(Status & XHCI_PORT_POWER)) {
+                Controller->OpRegisters->Ports[i].Status = (Status & XHCI_PORT_PRESERVE) | XHCI_PORT_POWER;
+            }
+        }
+        thrd_sleepex(20);
+    }
+
+    // Enumerate the ports that already have devices
+    TRACE(" > Initializing ports");
+    for (i = 0; i < Controller->Base.PortCount; i++) {
+        reg32_t Status = Controller->OpRegisters->Ports[i].Status;
+        if (Status & XHCI_PORT_CONNECTED) {
+            Controller->OpRegisters->Ports[i].Status = (Status & XHCI_PORT_PRESERVE) | XHCI_PORT_CONNECT_EVENT;
+            UsbEventPort(Controller->Base.Device.Id, 0, (uint8_t)(i & 0xFF));
+        }
+    }
+    return OsSuccess;
+}
@@ -0,0 +1,544 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * - Device slots, contexts and endpoint configuration
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/mollenos.h>
+#include <os/utils.h>
+#include "xhci.h"
+
+/* Includes
+ * - Library */
+#include <stdlib.h>
+#include <string.h>
+
+#define XHCI_CONTEXT_MEMORY     0x1000
+
+/* XhciGetSpeedId
+ * Converts the usb speed to the protocol speed id of the slot context */
+static reg32_t
+XhciGetSpeedId(
+    _In_ UsbSpeed_t             Speed)
+{
+    switch (Speed) {
+        case LowSpeed:      return XHCI_SPEED_LOW;
+        case FullSpeed:     return XHCI_SPEED_FULL;
+        case HighSpeed:     return XHCI_SPEED_HIGH;
+        default:            return XHCI_SPEED_SUPER;
+    }
+}
+
+/* XhciDeviceResetInput
+ * Clears the input context and selects the contexts to add */
+static void
+XhciDeviceResetInput(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ reg32_t                AddFlags)
+{
+    XhciInputControlContext_t *Control = (XhciInputControlContext_t*)Device->InputContext;
+    memset(Device->InputContext, 0, (XHCI_MAX_ENDPOINTS + 1) * Controller->ContextSize);
+    Control->DropFlags  = 0;
+    Control->AddFlags   = AddFlags;
+}
+
+/* XhciDeviceFree
+ * Releases all memory of the device, the slot must be disabled */
+static void
+XhciDeviceFree(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device)
+{
+    // Variables
+    size_t i, j;
+
+    if (Controller->Slots[Device->SlotId] == Device) {
+        Controller->Slots[Device->SlotId]       = NULL;
+        Controller->ContextBase[Device->SlotId] = 0;
+    }
+
+    for (i = 0; i < XHCI_MAX_ENDPOINTS; i++) {
+        XhciEndpoint_t *Endpoint = &Device->Endpoints[i];
+        if (Endpoint->Rings != NULL) {
+            for (j = 0; j < Endpoint->StreamCount + 1; j++) {
+                XhciRingDestroy(&Endpoint->Rings[j]);
+            }
+            free(Endpoint->Rings);
+        }
+        if (Endpoint->Streams != NULL) {
+            MemoryFree((void*)Endpoint->Streams,
+                (Endpoint->StreamCount + 1) * sizeof(XhciStreamContext_t));
+        }
+    }
+
+    if (Device->InputContext != NULL) {
+        MemoryFree(Device->InputContext, XHCI_CONTEXT_MEMORY);
+    }
+    if (Device->OutputContext != NULL) {
+        MemoryFree(Device->OutputContext, XHCI_CONTEXT_MEMORY);
+    }
+    free(Device);
+}
+
+/* XhciDeviceDisabled
+ * Completion of an asynchronous Disable Slot command */
+static void
+XhciDeviceDisabled(
+    _In_ XhciController_t*      Controller,
+    _In_ int                    CompletionCode,
+    _In_ int                    SlotId,
+    _In_ void*                  Context)
+{
+    _CRT_UNUSED(CompletionCode);
+    _CRT_UNUSED(SlotId);
+    XhciDeviceFree(Controller, (XhciDevice_t*)Context);
+}
+
+/* XhciDeviceCreate
+ * Enables a new slot for the device on the given root port, and addresses it
+ * with the block set-address flag so the default address can still be used
+ * for the initial descriptor requests. */
+static XhciDevice_t*
+XhciDeviceCreate(
+    _In_ XhciController_t*      Controller,
+    _In_ int                    Port,
+    _In_ UsbSpeed_t             Speed,
+    _In_ size_t                 MaxPacketSize)
+{
+    // Variables
+    XhciEndpointContext_t *Control  = NULL;
+    XhciSlotContext_t *Slot         = NULL;
+    XhciDevice_t *Device            = NULL;
+    int SlotId                      = 0;
+    int Code;
+
+    // Debug
+    TRACE("XhciDeviceCreate(Port %i, Speed %u)", Port, Speed);
+
+    Code = XhciCommandExecute(Controller, 0, 0,
+        XHCI_TRB_TYPE(XHCI_TRB_ENABLE_SLOT), &SlotId);
+    if (Code != XHCI_CC_SUCCESS || SlotId == 0 || SlotId > (int)Controller->MaxSlots) {
+        ERROR("Failed to enable a device slot, code %i", Code);
+        return NULL;
+    }
+
+    Device = (XhciDevice_t*)malloc(sizeof(XhciDevice_t));
+    memset(Device, 0, sizeof(XhciDevice_t));
+    Device->SlotId              = SlotId;
+    Device->Port                = Port;
+    Device->Speed               = Speed;
+    Device->ControlPacketSize   = (Speed == SuperSpeed) ? 512 : MaxPacketSize;
+    if (Device->ControlPacketSize == 0) {
+        Device->ControlPacketSize = 8;
+    }
+
+    if (XhciAllocateMemory(Controller, XHCI_CONTEXT_MEMORY,
+            &Device->InputContext, &Device->InputPhysical) != OsSuccess
+        || XhciAllocateMemory(Controller, XHCI_CONTEXT_MEMORY,
+            &Device->OutputContext, &Device->OutputPhysical) != OsSuccess) {
+        goto Error;
+    }
+
+    // The control endpoint always exists
+    Device->Endpoints[1].Rings = (XhciRing_t*)malloc(sizeof(XhciRing_t));
+    if (XhciRingInitialize(Controller, &Device->Endpoints[1].Rings[0]) != OsSuccess) {
+        goto Error;
+    }
+    Device->Endpoints[1].Configured = 1;
+
+    // Fill the input context with the slot and control endpoint
+    XhciDeviceResetInput(Controller, Device, (1 << 0) | (1 << 1));
+    Slot                    = (XhciSlotContext_t*)XHCI_INPUT_CONTEXT(Controller, Device, 0);
+    Slot->Route             = XHCI_SLOT_SPEED(XhciGetSpeedId(Speed)) | XHCI_SLOT_ENTRIES(1);
+    Slot->Ports             = XHCI_SLOT_ROOTPORT(Port + 1);
+
+    Control                 = (XhciEndpointContext_t*)XHCI_INPUT_CONTEXT(Controller, Device, 1);
+    Control->Configuration  = XHCI_EP_ERRORCOUNT(3) | XHCI_EP_TYPE(XHCI_EPTYPE_CONTROL)
+        | XHCI_EP_MAXPACKET(Device->ControlPacketSize);
+    Control->DequeueLow     = LODWORD(XhciRingGetDequeue(&Device->Endpoints[1].Rings[0]));
+    Control->DequeueHigh    = 0;
+    Control->Lengths        = XHCI_EP_AVGLENGTH(8);
+
+    Controller->ContextBase[SlotId] = Device->OutputPhysical;
+    Controller->Slots[SlotId]       = Device;
+
+    // Address the device but don't send SET_ADDRESS yet
+    Code = XhciCommandExecute(Controller, Device->InputPhysical, 0,
+        XHCI_TRB_TYPE(XHCI_TRB_ADDRESS_DEVICE) | XHCI_TRB_BSR | XHCI_TRB_SLOT(SlotId), NULL);
+    if (Code != XHCI_CC_SUCCESS) {
+        ERROR("Failed to address slot %i, code %i", SlotId, Code);
+        goto Error;
+    }
+    Controller->PortDevices[Port] = Device;
+    return Device;
+
+Error:
+    XhciCommandExecute(Controller, 0, 0,
+        XHCI_TRB_TYPE(XHCI_TRB_DISABLE_SLOT) | XHCI_TRB_SLOT(SlotId), NULL);
+    if (Device != NULL) {
+        Controller->Slots[SlotId] = Device;
+        XhciDeviceFree(Controller, Device);
+    }
+    return NULL;
+}
+
+/* XhciDeviceGet
+ * Resolves the device slot for the given usb address. Transfers to address 0
+ * create a new slot for the root port the device is attached to. */
+XhciDevice_t*
+XhciDeviceGet(
+    _In_ XhciController_t*      Controller,
+    _In_ UsbTransfer_t*         Transfer)
+{
+    // Variables
+    int Port = (int)Transfer->Address.PortAddress;
+
+    // Only root-port devices are supported for now, devices behind hubs
+    // need route strings and translator information
+    if (Transfer->Address.HubAddress != 0) {
+        return NULL;
+    }
+
+    if (Transfer->Address.DeviceAddress != 0) {
+        if (Transfer->Address.DeviceAddress >= XHCI_MAX_DEVICE_ADDRESS) {
+            return NULL;
+        }
+        return Controller->Addresses[Transfer->Address.DeviceAddress];
+    }
+
+    if (Port >= (int)Controller->Base.PortCount) {
+        return NULL;
+    }
+    if (Controller->PortDevices[Port] != NULL) {
+        return Controller->PortDevices[Port];
+    }
+    return XhciDeviceCreate(Controller, Port, Transfer->Speed, Transfer->Endpoint.MaxPacketSize);
+}
+
+/* XhciDeviceSetAddress
+ * Completes the addressing of the slot, replacing the SET_ADDRESS request. */
+OsStatus_t
+XhciDeviceSetAddress(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Address)
+{
+    // Variables
+    XhciEndpointContext_t *Control  = NULL;
+    XhciSlotContext_t *Slot         = NULL;
+    int Code;
+
+    // Debug
+    TRACE("XhciDeviceSetAddress(Slot %i, Address %i)", Device->SlotId, Address);
+
+    if (Address <= 0 || Address >= XHCI_MAX_DEVICE_ADDRESS) {
+        return OsError;
+    }
+
+    // Rebuild the input context, the control ring has moved since
+    XhciDeviceResetInput(Controller, Device, (1 << 0) | (1 << 1));
+    Slot                    = (XhciSlotContext_t*)XHCI_INPUT_CONTEXT(Controller, Device, 0);
+    Slot->Route             = XHCI_SLOT_SPEED(XhciGetSpeedId(Device->Speed)) | XHCI_SLOT_ENTRIES(1);
+    Slot->Ports             = XHCI_SLOT_ROOTPORT(Device->Port + 1);
+
+    Control                 = (XhciEndpointContext_t*)XHCI_INPUT_CONTEXT(Controller, Device, 1);
+    Control->Configuration  = XHCI_EP_ERRORCOUNT(3) | XHCI_EP_TYPE(XHCI_EPTYPE_CONTROL)
+        | XHCI_EP_MAXPACKET(Device->ControlPacketSize);
+    Control->DequeueLow     = LODWORD(XhciRingGetDequeue(&Device->Endpoints[1].Rings[0]));
+    Control->DequeueHigh    = 0;
+    Control->Lengths        = XHCI_EP_AVGLENGTH(8);
+
+    Code = XhciCommandExecute(Controller, Device->InputPhysical, 0,
+        XHCI_TRB_TYPE(XHCI_TRB_ADDRESS_DEVICE) | XHCI_TRB_SLOT(Device->SlotId), NULL);
+    if (Code != XHCI_CC_SUCCESS) {
+        ERROR("Failed to set address of slot %i, code %i", Device->SlotId, Code);
+        return OsError;
+    }
+
+    // The controller picked the real address, we only keep the mapping
+    if (Controller->PortDevices[Device->Port] == Device) {
+        Controller->PortDevices[Device->Port] = NULL;
+    }
+    Device->Address                 = Address;
+    Controller->Addresses[Address]  = Device;
+    return OsSuccess;
+}
+
+/* XhciDeviceUpdateControl
+ * Updates the max packet size of the control endpoint if it changed */
+OsStatus_t
+XhciDeviceUpdateControl(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ size_t                 MaxPacketSize)
+{
+    // Variables
+    XhciEndpointContext_t *Control  = NULL;
+    int Code;
+
+    // SuperSpeed devices always use 512 bytes
+    if (Device->Speed == SuperSpeed || MaxPacketSize == 0
+        || MaxPacketSize == Device->ControlPacketSize) {
+        return OsSuccess;
+    }
+
+    XhciDeviceResetInput(Controller, Device, (1 << 1));
+    Control                 = (XhciEndpointContext_t*)XHCI_INPUT_CONTEXT(Controller, Device, 1);
+    Control->Configuration  = XHCI_EP_MAXPACKET(MaxPacketSize);
+    Code = XhciCommandExecute(Controller, Device->InputPhysical, 0,
+        XHCI_TRB_TYPE(XHCI_TRB_EVALUATE_CONTEXT) | XHCI_TRB_SLOT(Device->SlotId), NULL);
+    if (Code != XHCI_CC_SUCCESS) {
+        ERROR("Failed to update control endpoint of slot %i, code %i", Device->SlotId, Code);
+        return OsError;
+    }
+    Device->ControlPacketSize = MaxPacketSize;
+    return OsSuccess;
+}
+
+/* XhciEndpointGetInterval
+ * Converts the endpoint interval to the exponent used by the endpoint
+ * context, in 125us units. */
+static reg32_t
+XhciEndpointGetInterval(
+    _In_ UsbSpeed_t                 Speed,
+    _In_ UsbHcEndpointDescriptor_t* Endpoint)
+{
+    // Variables
+    size_t Interval = Endpoint->Interval;
+    reg32_t Exponent = 3;
+
+    if (Endpoint->Type != EndpointInterrupt && Endpoint->Type != EndpointIsochronous) {
+        return 0;
+    }
+
+    // High and SuperSpeed use 2^(bInterval-1) microframes
+    if (Speed == HighSpeed || Speed == SuperSpeed || Endpoint->Type == EndpointIsochronous) {
+        if (Interval == 0) {
+            return 0;
+        }
+        return (reg32_t)MIN(Interval - 1, 15);
+    }
+
+    // Full and LowSpeed interrupt endpoints use frames
+    Interval = MAX(Interval, 1) * 8;
+    while (Exponent < 10 && ((size_t)1 << (Exponent + 1)) <= Interval) {
+        Exponent++;
+    }
+    return Exponent;
+}
+
+/* XhciEndpointGetType
+ * Converts the endpoint type and direction to the context type */
+static reg32_t
+XhciEndpointGetType(
+    _In_ UsbHcEndpointDescriptor_t* Endpoint)
+{
+    int In = (Endpoint->Direction == USB_ENDPOINT_IN);
+    switch (Endpoint->Type) {
+        case EndpointIsochronous:   return In ? XHCI_EPTYPE_ISOC_IN : XHCI_EPTYPE_ISOC_OUT;
+        case EndpointBulk:          return In ? XHCI_EPTYPE_BULK_IN : XHCI_EPTYPE_BULK_OUT;
+        case EndpointInterrupt:     return In ? XHCI_EPTYPE_INTERRUPT_IN : XHCI_EPTYPE_INTERRUPT_OUT;
+        default:                    return XHCI_EPTYPE_CONTROL;
+    }
+}
+
+/* XhciEndpointCreateRings
+ * Allocates the ring of the endpoint, or the stream array and a ring per
+ * stream when the endpoint supports streams. Returns the dequeue pointer
+ * that goes in the endpoint context. */
+static OsStatus_t
+XhciEndpointCreateRings(
+    _In_  XhciController_t*     Controller,
+    _In_  XhciEndpoint_t*       Endpoint,
+    _In_  size_t                Streams,
+    _Out_ uint64_t*             Dequeue)
+{
+    // Variables
+    void *Memory = NULL;
+    size_t i;
+
+    Endpoint->StreamCount   = (Streams > 1) ? Streams - 1 : 0;
+    Endpoint->Rings         = (XhciRing_t*)malloc(sizeof(XhciRing_t) * (Endpoint->StreamCount + 1));
+    memset(Endpoint->Rings, 0, sizeof(XhciRing_t) * (Endpoint->StreamCount + 1));
+
+    if (Endpoint->StreamCount == 0) {
+        if (XhciRingInitialize(Controller, &Endpoint->Rings[0]) != OsSuccess) {
+            return OsError;
+        }
+        *Dequeue = XhciRingGetDequeue(&Endpoint->Rings[0]);
+        return OsSuccess;
+    }
+
+    // Stream 0 is reserved, the array is indexed by stream id
+    if (XhciAllocateMemory(Controller, Streams * sizeof(XhciStreamContext_t),
+            &Memory, &Endpoint->StreamsPhysical) != OsSuccess) {
+        return OsError;
+    }
+    Endpoint->Streams = (XhciStreamContext_t*)Memory;
+    for (i = 1; i < Streams; i++) {
+        uint64_t StreamDequeue;
+        if (XhciRingInitialize(Controller, &Endpoint->Rings[i]) != OsSuccess) {
+            return OsError;
+        }
+        StreamDequeue                   = XhciRingGetDequeue(&Endpoint->Rings[i]);
+        Endpoint->Streams[i].DequeueLow = LODWORD(StreamDequeue) | XHCI_STREAM_PRIMARY;
+        Endpoint->Streams[i].DequeueHigh = HIDWORD(StreamDequeue);
+    }
+    *Dequeue = Endpoint->StreamsPhysical;
+    return OsSuccess;
+}
+
+/* XhciDeviceConfigureEndpoint
+ * Adds the endpoint to the slot and allocates its ring(s) */
+OsStatus_t
+XhciDeviceConfigureEndpoint(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Dci,
+    _In_ UsbTransfer_t*         Transfer)
+{
+    // Variables
+    UsbHcEndpointDescriptor_t *Descriptor   = &Transfer->Endpoint;
+    XhciEndpoint_t *Endpoint                = &Device->Endpoints[Dci];
+    XhciEndpointContext_t *Context          = NULL;
+    XhciSlotContext_t *Output               = NULL;
+    XhciSlotContext_t *Slot                 = NULL;
+    uint64_t Dequeue                        = 0;
+    size_t MaxPacketSize                    = Descriptor->MaxPacketSize;
+    size_t MaxBurst                         = 0;
+    size_t Streams                          = 0;
+    reg32_t Entries;
+    int Code, i;
+
+    // Debug
+    TRACE("XhciDeviceConfigureEndpoint(Slot %i, Dci %i)", Device->SlotId, Dci);
+
+    // Streams are only available for SuperSpeed bulk endpoints, and the
+    // array size is limited by the controller
+    if (Descriptor->Type == EndpointBulk && Device->Speed == SuperSpeed
+        && Descriptor->MaxStreams > 1 && XHCI_CPARAM1_MAXPSA(Controller->CParameters1) != 0) {
+        Streams = MIN(Descriptor->MaxStreams, XHCI_MAX_STREAMS);
+        Streams = MIN(Streams, (size_t)1 << (XHCI_CPARAM1_MAXPSA(Controller->CParameters1) + 1));
+    }
+
+    if (Device->Speed == SuperSpeed) {
+        MaxBurst = Descriptor->MaxBurst;
+    }
+    else if (Device->Speed == HighSpeed && Descriptor->Type != EndpointBulk) {
+        MaxBurst = Descriptor->Bandwidth - 1;
+    }
+
+    if (XhciEndpointCreateRings(Controller, Endpoint, Streams, &Dequeue) != OsSuccess) {
+        ERROR("Failed to allocate rings for endpoint %i", Dci);
+        goto Error;
+    }
+
+    // Copy the current slot context, it must be valid for the command and
+    // the context entries must cover the new endpoint
+    XhciDeviceResetInput(Controller, Device, (1 << 0) | (1 << Dci));
+    Output              = (XhciSlotContext_t*)XHCI_CONTEXT(Controller, Device->OutputContext, 0);
+    Slot                = (XhciSlotContext_t*)XHCI_INPUT_CONTEXT(Controller, Device, 0);
+    Entries             = MAX(XHCI_SLOT_GETENTRIES(Output->Route), (reg32_t)Dci);
+    Slot->Route         = (Output->Route & ~(XHCI_SLOT_ENTRIES(0x1F))) | XHCI_SLOT_ENTRIES(Entries);
+    Slot->Ports         = Output->Ports;
+    Slot->Translator    = Output->Translator;
+
+    Context                 = (XhciEndpointContext_t*)XHCI_INPUT_CONTEXT(Controller, Device, Dci);
+    Context->State          = XHCI_EP_INTERVAL(XhciEndpointGetInterval(Device->Speed, Descriptor));
+    Context->Configuration  = XHCI_EP_TYPE(XhciEndpointGetType(Descriptor))
+        | XHCI_EP_MAXBURST(MaxBurst) | XHCI_EP_MAXPACKET(MaxPacketSize)
+        | ((Descriptor->Type != EndpointIsochronous) ? XHCI_EP_ERRORCOUNT(3) : 0);
+    Context->DequeueLow     = LODWORD(Dequeue);
+    Context->DequeueHigh    = HIDWORD(Dequeue);
+
+    if (Endpoint->StreamCount != 0) {
+        for (i = 0; ((size_t)2 << i) < Streams; i++);
+        Context->State     |= XHCI_EP_MAXPSTREAMS(i) | XHCI_EP_LSA;
+    }
+    else {
+        Context->DequeueLow |= XHCI_EP_DCS;
+    }
+
+    if (Descriptor->Type == EndpointInterrupt || Descriptor->Type == EndpointIsochronous) {
+        Context->Lengths    = XHCI_EP_AVGLENGTH(MaxPacketSize)
+            | XHCI_EP_MAXESIT(MaxPacketSize * (MaxBurst + 1));
+    }
+    else {
+        Context->Lengths    = XHCI_EP_AVGLENGTH(3072);
+    }
+
+    Code = XhciCommandExecute(Controller, Device->InputPhysical, 0,
+        XHCI_TRB_TYPE(XHCI_TRB_CONFIGURE_ENDPOINT) | XHCI_TRB_SLOT(Device->SlotId), NULL);
+    if (Code != XHCI_CC_SUCCESS) {
+        ERROR("Failed to configure endpoint %i of slot %i, code %i", Dci, Device->SlotId, Code);
+        goto Error;
+    }
+    Endpoint->Configured = 1;
+    return OsSuccess;
+
+Error:
+    if (Endpoint->Rings != NULL) {
+        for (i = 0; i < (int)Endpoint->StreamCount + 1; i++) {
+            XhciRingDestroy(&Endpoint->Rings[i]);
+        }
+        free(Endpoint->Rings);
+    }
+    if (Endpoint->Streams != NULL) {
+        MemoryFree((void*)Endpoint->Streams, Streams * sizeof(XhciStreamContext_t));
+    }
+    memset(Endpoint, 0, sizeof(XhciEndpoint_t));
+    return OsError;
+}
+
+/* XhciDeviceDestroy
+ * Disables the slot of a device and frees all memory of the device. */
+void
+XhciDeviceDestroy(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Synchronous)
+{
+    // Debug
+    TRACE("XhciDeviceDestroy(Slot %i)", Device->SlotId);
+
+    // Unlink the device so no new transfers can reach it
+    if (Device->Address != 0 && Controller->Addresses[Device->Address] == Device) {
+        Controller->Addresses[Device->Address] = NULL;
+    }
+    if (Controller->PortDevices[Device->Port] == Device) {
+        Controller->PortDevices[Device->Port] = NULL;
+    }
+    XhciTransferAbortDevice(Controller, Device);
+
+    // The memory can only be released once the controller let go of the slot
+    if (Synchronous) {
+        XhciCommandExecute(Controller, 0, 0,
+            XHCI_TRB_TYPE(XHCI_TRB_DISABLE_SLOT) | XHCI_TRB_SLOT(Device->SlotId), NULL);
+        XhciDeviceFree(Controller, Device);
+    }
+    else if (XhciCommandQueue(Controller, 0, 0,
+            XHCI_TRB_TYPE(XHCI_TRB_DISABLE_SLOT) | XHCI_TRB_SLOT(Device->SlotId),
+            XhciDeviceDisabled, Device) != OsSuccess) {
+        ERROR("Failed to disable slot %i, the slot is leaked", Device->SlotId);
+    }
+}
@@ -0,0 +1,199 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * TODO:
+ * - Power Management
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/mollenos.h>
+#include <os/utils.h>
+
+#include "../common/manager.h"
+#include "xhci.h"
+
+/* Includes
+ * - Library */
+#include <threads.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* OnFastInterrupt
+ * Is called for the sole purpose to determine if this source
+ * has invoked an irq. If it has, silence and return (Handled) */
+InterruptStatus_t
+OnFastInterrupt(
+    _In_Opt_ void *InterruptData)
+{
+    // Variables
+    XhciController_t *Controller    = NULL;
+    reg32_t InterruptStatus;
+
+    // Instantiate the pointer
+    Controller                      = (XhciController_t*)InterruptData;
+
+    // Calculate the kinds of interrupts this controller accepts
+    InterruptStatus = Controller->OpRegisters->UsbStatus
+        & (XHCI_STATUS_EVENT | XHCI_STATUS_PORTCHANGE | XHCI_STATUS_HOSTERROR);
+
+    // Trace
+    TRACE("XHCI-Interrupt - Status 0x%x", InterruptStatus);
+
+    // Was the interrupt even from this controller?
+    if (!InterruptStatus) {
+        return InterruptNotHandled;
+    }
+
+    // Acknowledge the interrupt by clearing, the interrupter
+    // pending bit must be cleared as well
+    Controller->RtRegisters->Interrupters[0].Management |= XHCI_IMAN_PENDING;
+    Controller->OpRegisters->UsbStatus  = InterruptStatus;
+    Controller->Base.InterruptStatus    |= InterruptStatus;
+    return InterruptHandled;
+}
+
+/* XhciProcessEvents
+ * Consumes all the pending events on the event ring and dispatches them.
+ * Returns the number of events consumed. */
+int
+XhciProcessEvents(
+    _In_ XhciController_t*          Controller)
+{
+    // Variables
+    XhciInterrupterRegisters_t *Interrupter = &Controller->RtRegisters->Interrupters[0];
+    uint32_t PortChanges[(XHCI_MAX_PORTS + 31) / 32] = { 0 };
+    int Processed = 0;
+    int Port;
+
+    SpinlockAcquire(&Controller->EventLock);
+    while (1) {
+        XhciTrb_t *Event    = &Controller->EventRing[Controller->EventDequeue];
+        XhciTrb_t Copy;
+        if ((Event->Control & XHCI_TRB_CYCLE) != (reg32_t)Controller->EventCycle) {
+            break;
+        }
+
+        // Take a copy and advance before dispatching, handlers may queue
+        // new work that generates more events
+        memcpy((void*)&Copy, (void*)Event, sizeof(XhciTrb_t));
+        Controller->EventDequeue++;
+        if (Controller->EventDequeue == XHCI_EVENT_RING_SIZE) {
+            Controller->EventDequeue    = 0;
+            Controller->EventCycle      ^= 1;
+        }
+        Processed++;
+
+        switch (XHCI_TRB_GETTYPE(Copy.Control)) {
+            case XHCI_TRB_TRANSFER_EVENT: {
+                XhciTransferEvent(Controller, &Copy);
+            } break;
+            case XHCI_TRB_COMMAND_EVENT: {
+                XhciCommandComplete(Controller, &Copy);
+            } break;
+            case XHCI_TRB_PORT_EVENT: {
+                // Port scans may tear down devices, run them after releasing the lock
+                Port = (int)((Copy.ParameterLow >> 24) & 0xFF) - 1;
+                if (Port >= 0 && Port < XHCI_MAX_PORTS) {
+                    PortChanges[Port / 32] |= (1U << (Port % 32));
+                }
+            } break;
+            case XHCI_TRB_HOST_EVENT: {
+                ERROR("XHCI: Host controller event, code %u", XHCI_EVENT_CODE(Copy.Status));
+            } break;
+            default: {
+                TRACE("XHCI: Unhandled event type %u", XHCI_TRB_GETTYPE(Copy.Control));
+            } break;
+        }
+    }
+
+    // Hand the consumed events back to the controller
+    if (Processed != 0) {
+        XhciWriteRegister64(&Interrupter->Dequeue, (Controller->EventRingPhysical
+            + (Controller->EventDequeue * sizeof(XhciTrb_t))) | XHCI_ERDP_BUSY);
+    }
+    SpinlockRelease(&Controller->EventLock);
+
+    for (Port = 0; Port < XHCI_MAX_PORTS; Port++) {
+        if (PortChanges[Port / 32] & (1U << (Port % 32))) {
+            XhciPortScan(Controller, Port);
+        }
+    }
+    return Processed;
+}
+
+/* OnInterrupt
+ * Is called by external services to indicate an external interrupt.
+ * This is to actually process the device interrupt */
+InterruptStatus_t
+OnInterrupt(
+    _In_Opt_ void*  InterruptData,
+    _In_Opt_ size_t Arg0,
+    _In_Opt_ size_t Arg1,
+    _In_Opt_ size_t Arg2)
+{
+    // Variables
+    XhciController_t *Controller        = NULL;
+    reg32_t InterruptStatus             = 0;
+    size_t Rounds;
+    int Processed;
+
+    // Unused
+    _CRT_UNUSED(Arg0);
+    _CRT_UNUSED(Arg1);
+    _CRT_UNUSED(Arg2);
+
+    // Instantiate the pointer
+    Controller                          = (XhciController_t*)InterruptData;
+
+ProcessInterrupt:
+    InterruptStatus                     = Controller->Base.InterruptStatus;
+    Controller->Base.InterruptStatus    = 0;
+
+    // HC Fatal Error
+    // Everything is lost, restart the controller
+    if (InterruptStatus & XHCI_STATUS_HOSTERROR) {
+        if (XhciRestart(Controller) != OsSuccess) {
+            ERROR("XHCI-Failure: Failed to reset controller after fatal error");
+        }
+        return InterruptHandled;
+    }
+
+    // Transfers, commands and port changes are all reported as events
+    if (InterruptStatus & (XHCI_STATUS_EVENT | XHCI_STATUS_PORTCHANGE)) {
+        Processed = XhciProcessEvents(Controller);
+
+        // Under heavy load keep consuming the event ring instead of waiting
+        // for the next moderated interrupt, but only for a bounded time
+        for (Rounds = 0; Controller->Coalescing.PollThreshold != 0 
+            && (size_t)Processed >= Controller->Coalescing.PollThreshold
+            && Rounds < Controller->Coalescing.PollRounds; Rounds++) {
+            thrd_yield();
+            Processed = XhciProcessEvents(Controller);
+        }
+    }
+
+    // In case an interrupt fired during processing
+    if (Controller->Base.InterruptStatus != 0) {
+        goto ProcessInterrupt;
+    }
+    return InterruptHandled;
+}
@@ -0,0 +1,169 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * TODO:
+ * - Power Management
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/utils.h>
+#include "xhci.h"
+
+/* Includes
+ * - Library */
+#include <threads.h>
+#include <string.h>
+
+/* XhciPortWrite
+ * Writes the port status register without clearing the R/WC bits or
+ * disabling the port by accident */
+static void
+XhciPortWrite(
+    _In_ XhciController_t*          Controller,
+    _In_ int                        Index,
+    _In_ reg32_t                    Bits)
+{
+    reg32_t Status = Controller->OpRegisters->Ports[Index].Status;
+    Controller->OpRegisters->Ports[Index].Status = (Status & XHCI_PORT_PRESERVE) | Bits;
+}
+
+/* HciPortReset
+ * Resets the given port and returns the result of the reset */
+OsStatus_t
+HciPortReset(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ int                        Index)
+{
+    // Variables
+    XhciController_t *XhciHci   = (XhciController_t*)Controller;
+    reg32_t Status              = XhciHci->OpRegisters->Ports[Index].Status;
+    int Fault                   = 0;
+
+    // Debug
+    TRACE("HciPortReset(Port %i)", Index);
+
+    // A reset invalidates the device that was on the port
+    if (XhciHci->PortDevices[Index] != NULL) {
+        XhciDeviceDestroy(XhciHci, XhciHci->PortDevices[Index], 1);
+    }
+
+    // If we are per-port handled, and power is not enabled
+    // then switch it on, and give it some time to recover
+    if (!(Status & XHCI_PORT_POWER)) {
+        XhciPortWrite(XhciHci, Index, XHCI_PORT_POWER);
+        thrd_sleepex(20);
+        Status = XhciHci->OpRegisters->Ports[Index].Status;
+    }
+
+    // Usb3 ports train the link themselves and are enabled when connected,
+    // a warm reset is only needed if the link failed to come up
+    if (XhciHci->PortProtocols[Index] >= 3) {
+        if (Status & XHCI_PORT_ENABLED) {
+            return OsSuccess;
+        }
+        XhciPortWrite(XhciHci, Index, XHCI_PORT_WARMRESET);
+        WaitForConditionWithFault(Fault,
+            (XhciHci->OpRegisters->Ports[Index].Status & XHCI_PORT_WARMRESET_EVENT) != 0, 250, 1);
+    }
+    else {
+        XhciPortWrite(XhciHci, Index, XHCI_PORT_RESET);
+        WaitForConditionWithFault(Fault,
+            (XhciHci->OpRegisters->Ports[Index].Status & XHCI_PORT_RESET) == 0, 250, 1);
+    }
+    if (Fault) {
+        ERROR("XHCI::Host controller failed to reset the port in time.");
+        return OsError;
+    }
+
+    // Acknowledge the reset changes, connect changes are handled by scan
+    XhciPortWrite(XhciHci, Index, XHCI_PORT_RESET_EVENT | XHCI_PORT_WARMRESET_EVENT
+        | XHCI_PORT_ENABLE_EVENT | XHCI_PORT_LINK_EVENT);
+
+    // Recovery time after reset
+    thrd_sleepex(10);
+    if (!(XhciHci->OpRegisters->Ports[Index].Status & XHCI_PORT_ENABLED)) {
+        return OsError;
+    }
+    return OsSuccess;
+}
+
+/* HciPortGetStatus
+ * Retrieve the current port status, with connected and enabled information */
+void
+HciPortGetStatus(
+    _In_  UsbManagerController_t*   Controller,
+    _In_  int                       Index,
+    _Out_ UsbHcPortDescriptor_t*    Port)
+{
+    // Variables
+    XhciController_t *XhciHci   = (XhciController_t*)Controller;
+    reg32_t Status              = XhciHci->OpRegisters->Ports[Index].Status;
+
+    // Is port connected?
+    Port->Connected = (Status & XHCI_PORT_CONNECTED) == 0 ? 0 : 1;
+    Port->Enabled   = (Status & XHCI_PORT_ENABLED) == 0 ? 0 : 1;
+    switch (XHCI_PORT_SPEED(Status)) {
+        case XHCI_SPEED_FULL:
+            Port->Speed = FullSpeed;
+            break;
+        case XHCI_SPEED_LOW:
+            Port->Speed = LowSpeed;
+            break;
+        case XHCI_SPEED_HIGH:
+            Port->Speed = HighSpeed;
+            break;
+        default:
+            Port->Speed = SuperSpeed;
+            break;
+    }
+}
+
+/* XhciPortScan
+ * Acknowledges port changes and notifies the usb-manager */
+void
+XhciPortScan(
+    _In_ XhciController_t*          Controller,
+    _In_ int                        Index)
+{
+    // Variables
+    reg32_t Status;
+
+    if (Index < 0 || Index >= (int)Controller->Base.PortCount) {
+        return;
+    }
+    Status = Controller->OpRegisters->Ports[Index].Status;
+
+    // Debug
+    TRACE("XhciPortScan(Port %i, Status 0x%x)", Index, Status);
+
+    // Acknowledge everything but the reset changes, those are owned by reset
+    XhciPortWrite(Controller, Index, Status & XHCI_PORT_RWC
+        & ~(XHCI_PORT_RESET_EVENT | XHCI_PORT_WARMRESET_EVENT));
+    if (!(Status & XHCI_PORT_CONNECT_EVENT)) {
+        return;
+    }
+
+    // Runs from the event handler, so the slot is disabled asynchronously
+    if (!(Status & XHCI_PORT_CONNECTED) && Controller->PortDevices[Index] != NULL) {
+        XhciDeviceDestroy(Controller, Controller->PortDevices[Index], 0);
+    }
+    UsbEventPort(Controller->Base.Device.Id, 0, (uint8_t)(Index & 0xFF));
+}
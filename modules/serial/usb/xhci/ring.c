@@ -0,0 +1,211 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * - Producer rings for commands and transfers
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/mollenos.h>
+#include <os/utils.h>
+#include "xhci.h"
+
+/* Includes
+ * - Library */
+#include <string.h>
+
+/* XhciRingInstallLink
+ * Installs the link trb in the last slot, pointing back to the start */
+static void
+XhciRingInstallLink(
+    _In_ XhciRing_t*            Ring)
+{
+    XhciTrb_t *Link     = &Ring->Trbs[XHCI_RING_SIZE - 1];
+    Link->ParameterLow  = LODWORD(Ring->TrbsPhysical);
+    Link->ParameterHigh = 0;
+    Link->Status        = 0;
+    Link->Control       = XHCI_TRB_TYPE(XHCI_TRB_LINK) | XHCI_TRB_TOGGLE;
+}
+
+/* XhciRingInitialize
+ * Allocates the trb memory for a ring and installs the link trb */
+OsStatus_t
+XhciRingInitialize(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciRing_t*            Ring)
+{
+    // Variables
+    void *Memory = NULL;
+
+    memset(Ring, 0, sizeof(XhciRing_t));
+    if (XhciAllocateMemory(Controller, XHCI_RING_SIZE * sizeof(XhciTrb_t),
+            &Memory, &Ring->TrbsPhysical) != OsSuccess) {
+        return OsError;
+    }
+    Ring->Trbs = (XhciTrb_t*)Memory;
+    SpinlockReset(&Ring->Lock);
+    XhciRingReset(Ring);
+    return OsSuccess;
+}
+
+/* XhciRingDestroy
+ * Releases the trb memory of a ring */
+void
+XhciRingDestroy(
+    _In_ XhciRing_t*            Ring)
+{
+    if (Ring->Trbs != NULL) {
+        MemoryFree((void*)Ring->Trbs, XHCI_RING_SIZE * sizeof(XhciTrb_t));
+        Ring->Trbs = NULL;
+    }
+}
+
+/* XhciRingReset
+ * Resets the software state of the ring and clears all trbs */
+void
+XhciRingReset(
+    _In_ XhciRing_t*            Ring)
+{
+    memset((void*)Ring->Trbs, 0, XHCI_RING_SIZE * sizeof(XhciTrb_t));
+    memset(&Ring->Owners[0], 0, sizeof(Ring->Owners));
+    Ring->Enqueue   = 0;
+    Ring->Dequeue   = 0;
+    Ring->Cycle     = 1;
+    Ring->Holding   = 0;
+    XhciRingInstallLink(Ring);
+}
+
+/* XhciRingSpace
+ * Returns the number of trbs that can be enqueued without overwriting
+ * trbs that are still owned by the controller. */
+size_t
+XhciRingSpace(
+    _In_ XhciRing_t*            Ring)
+{
+    // One slot is always kept free to tell a full ring from an empty one
+    size_t Usable = XHCI_RING_SIZE - 1;
+    return (Ring->Dequeue + Usable - Ring->Enqueue - 1) % Usable;
+}
+
+/* XhciRingBegin
+ * Starts a new td, the first trb is held back from the controller
+ * until the td is committed. */
+void
+XhciRingBegin(
+    _In_ XhciRing_t*            Ring)
+{
+    Ring->HoldIndex = Ring->Enqueue;
+    Ring->Holding   = 1;
+}
+
+/* XhciRingEnqueue
+ * Writes the next trb on the ring and handles wrapping through the link trb.
+ * Returns the index of the written trb. */
+size_t
+XhciRingEnqueue(
+    _In_ XhciRing_t*            Ring,
+    _In_ uint64_t               Parameter,
+    _In_ reg32_t                Status,
+    _In_ reg32_t                Control)
+{
+    // Variables
+    size_t Index    = Ring->Enqueue;
+    XhciTrb_t *Trb  = &Ring->Trbs[Index];
+    reg32_t Cycle   = Ring->Cycle ? XHCI_TRB_CYCLE : 0;
+
+    // The first trb of a td keeps the wrong cycle until it is committed
+    if (Ring->Holding && Index == Ring->HoldIndex) {
+        Cycle ^= XHCI_TRB_CYCLE;
+    }
+    Ring->Owners[Index] = NULL;
+    Trb->ParameterLow   = LODWORD(Parameter);
+    Trb->ParameterHigh  = HIDWORD(Parameter);
+    Trb->Status         = Status;
+    Trb->Control        = (Control & ~(XHCI_TRB_CYCLE)) | Cycle;
+
+    // Wrap through the link trb, it must carry the chain bit of the td
+    // so the controller does not split it.
+    Ring->Enqueue++;
+    if (Ring->Enqueue == XHCI_RING_SIZE - 1) {
+        XhciTrb_t *Link = &Ring->Trbs[XHCI_RING_SIZE - 1];
+        Link->Control   = XHCI_TRB_TYPE(XHCI_TRB_LINK) | XHCI_TRB_TOGGLE
+            | (Control & XHCI_TRB_CHAIN) | (Ring->Cycle ? XHCI_TRB_CYCLE : 0);
+        Ring->Cycle     ^= 1;
+        Ring->Enqueue   = 0;
+    }
+    return Index;
+}
+
+/* XhciRingCommit
+ * Hands the td to the controller by releasing the first trb */
+void
+XhciRingCommit(
+    _In_ XhciRing_t*            Ring)
+{
+    if (Ring->Holding) {
+        MemoryBarrier();
+        Ring->Trbs[Ring->HoldIndex].Control ^= XHCI_TRB_CYCLE;
+        Ring->Holding = 0;
+    }
+}
+
+/* XhciRingRetire
+ * Marks every trb up to and including <Index> as consumed */
+void
+XhciRingRetire(
+    _In_ XhciRing_t*            Ring,
+    _In_ size_t                 Index)
+{
+    Ring->Owners[Index] = NULL;
+    Ring->Dequeue       = (Index + 1) % (XHCI_RING_SIZE - 1);
+}
+
+/* XhciRingGetIndex
+ * Converts a trb physical address to an index in the ring, returns -1 if
+ * the address does not belong to the ring. */
+int
+XhciRingGetIndex(
+    _In_ XhciRing_t*            Ring,
+    _In_ uint64_t               Address)
+{
+    if (Ring->Trbs == NULL || Address < Ring->TrbsPhysical
+        || Address >= (Ring->TrbsPhysical + (XHCI_RING_SIZE * sizeof(XhciTrb_t)))) {
+        return -1;
+    }
+    return (int)((Address - Ring->TrbsPhysical) / sizeof(XhciTrb_t));
+}
+
+/* XhciRingGetDequeue
+ * Returns the physical address of the software dequeue pointer including
+ * the cycle state at that position, for Set TR Dequeue and contexts. */
+uint64_t
+XhciRingGetDequeue(
+    _In_ XhciRing_t*            Ring)
+{
+    // Variables
+    uint64_t Address = Ring->TrbsPhysical + (Ring->Dequeue * sizeof(XhciTrb_t));
+    int Cycle        = Ring->Cycle;
+
+    // If there is pending work the trb at dequeue carries its own cycle
+    if (Ring->Dequeue != Ring->Enqueue) {
+        Cycle = (Ring->Trbs[Ring->Dequeue].Control & XHCI_TRB_CYCLE) ? 1 : 0;
+    }
+    return Address | (uint64_t)Cycle;
+}
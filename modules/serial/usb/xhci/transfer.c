@@ -0,0 +1,855 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * - Transfer rings, td building and completion
+ *
+ * Every td ends with an Event Data trb that interrupts on completion. The
+ * event then carries the number of bytes transferred for the whole td (even
+ * on short packets) and our cookie that identifies the ring and trb index.
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/utils.h>
+#include "xhci.h"
+
+/* Includes
+ * - Library */
+#include <stdlib.h>
+#include <string.h>
+
+#define XHCI_TD_CANCELLED                   ((void*)1)
+#define XHCI_TD_COOKIE(Stream, Index)       ((((uint64_t)(Stream)) << 16) | (uint64_t)(Index))
+#define XHCI_TD_COOKIE_STREAM(Cookie)       (((Cookie) >> 16) & 0xFFFF)
+#define XHCI_TD_COOKIE_INDEX(Cookie)        ((Cookie) & 0xFFFF)
+#define XHCI_RING_NEXT(Index)               (((Index) + 1) % (XHCI_RING_SIZE - 1))
+
+// Asynchronous endpoint recovery carries the target encoded in the context
+#define XHCI_RECOVERY_CONTEXT(Slot, Dci, Stream) \
+    ((void*)(uintptr_t)((((Slot) & 0xFF) << 24) | (((Dci) & 0xFF) << 16) | ((Stream) & 0xFFFF)))
+#define XHCI_RECOVERY_SLOT(Context)         ((int)(((uintptr_t)(Context) >> 24) & 0xFF))
+#define XHCI_RECOVERY_DCI(Context)          ((int)(((uintptr_t)(Context) >> 16) & 0xFF))
+#define XHCI_RECOVERY_STREAM(Context)       ((int)((uintptr_t)(Context) & 0xFFFF))
+
+/* XhciGetStatusCode
+ * Retrieves a transfer status from a completion code */
+static UsbTransferStatus_t
+XhciGetStatusCode(
+    _In_ int                    CompletionCode)
+{
+    switch (CompletionCode) {
+        case XHCI_CC_SUCCESS:
+        case XHCI_CC_SHORT_PACKET:
+            return TransferFinished;
+        case XHCI_CC_STALL:
+            return TransferStalled;
+        case XHCI_CC_BABBLE:
+            return TransferBabble;
+        case XHCI_CC_TRANSACTION_ERROR:
+            return TransferNotResponding;
+        case XHCI_CC_BUFFER_ERROR:
+            return TransferBufferError;
+        default:
+            return TransferInvalid;
+    }
+}
+
+/* XhciGetEndpointIndex
+ * Retrieves the device context index of the transfer endpoint */
+int
+XhciGetEndpointIndex(
+    _In_ UsbTransfer_t*         Transfer)
+{
+    if (Transfer->Address.EndpointAddress == 0) {
+        return 1;
+    }
+    return (int)((Transfer->Address.EndpointAddress & 0xF) * 2)
+        + ((Transfer->Endpoint.Direction == USB_ENDPOINT_IN) ? 1 : 0);
+}
+
+/* XhciTransferGetRing
+ * Retrieves the ring of the endpoint that executes the given stream */
+static XhciRing_t*
+XhciTransferGetRing(
+    _In_ XhciEndpoint_t*        Endpoint,
+    _In_ int                    StreamId)
+{
+    if (Endpoint->Rings == NULL) {
+        return NULL;
+    }
+    if (Endpoint->StreamCount == 0) {
+        return (StreamId == 0) ? &Endpoint->Rings[0] : NULL;
+    }
+    if (StreamId == 0 || StreamId > (int)Endpoint->StreamCount) {
+        return NULL;
+    }
+    return &Endpoint->Rings[StreamId];
+}
+
+/* XhciTransferRingDoorbell
+ * Rings the doorbell of every stream of the endpoint that has work pending */
+static void
+XhciTransferRingDoorbell(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Dci)
+{
+    // Variables
+    XhciEndpoint_t *Endpoint = &Device->Endpoints[Dci];
+    size_t i;
+
+    for (i = 0; i < Endpoint->StreamCount + 1; i++) {
+        XhciRing_t *Ring = &Endpoint->Rings[i];
+        if (Ring->Trbs != NULL && Ring->Dequeue != Ring->Enqueue) {
+            Controller->Doorbells[Device->SlotId] = (reg32_t)Dci | ((reg32_t)i << 16);
+        }
+    }
+}
+
+/* XhciTransferCountTrbs
+ * Counts the number of trbs needed for a buffer, trbs can't cross 64kb */
+static size_t
+XhciTransferCountTrbs(
+    _In_ uintptr_t              Address,
+    _In_ size_t                 Length)
+{
+    // Variables
+    size_t Count = 0;
+
+    if (Length == 0) {
+        return 1;
+    }
+    while (Length != 0) {
+        size_t Chunk = MIN(Length, XHCI_TRB_MAX_LENGTH - (Address & (XHCI_TRB_MAX_LENGTH - 1)));
+        Address += Chunk;
+        Length  -= Chunk;
+        Count++;
+    }
+    return Count;
+}
+
+/* XhciTransferFillBuffer
+ * Writes the trbs for a buffer, the first trb gets the given type and flags
+ * and the rest are normal trbs. <Remaining> is the number of bytes left in
+ * the td and is used for the td size field. */
+static void
+XhciTransferFillBuffer(
+    _In_    XhciRing_t*         Ring,
+    _In_    uintptr_t           Address,
+    _In_    size_t              Length,
+    _In_    reg32_t             FirstType,
+    _In_    reg32_t             FirstFlags,
+    _In_    size_t              MaxPacketSize,
+    _InOut_ size_t*             Remaining)
+{
+    // Variables
+    reg32_t Type    = FirstType;
+    reg32_t Flags   = FirstFlags;
+
+    do {
+        size_t Chunk    = MIN(Length, XHCI_TRB_MAX_LENGTH - (Address & (XHCI_TRB_MAX_LENGTH - 1)));
+        size_t Packets;
+
+        *Remaining     -= Chunk;
+        Packets         = MIN((*Remaining + MaxPacketSize - 1) / MaxPacketSize, 31);
+        XhciRingEnqueue(Ring, Address, XHCI_TRB_LENGTH(Chunk) | XHCI_TRB_TDSIZE(Packets),
+            XHCI_TRB_TYPE(Type) | Flags | XHCI_TRB_CHAIN);
+
+        Address        += Chunk;
+        Length         -= Chunk;
+        Type            = XHCI_TRB_NORMAL;
+        Flags           = 0;
+    } while (Length != 0);
+}
+
+/* XhciTransferGetBuffer
+ * Retrieves the buffer of a transaction, periodic transfers move through
+ * their buffer with each completion */
+static uintptr_t
+XhciTransferGetBuffer(
+    _In_ UsbManagerTransfer_t*  Transfer,
+    _In_ int                    Index)
+{
+    uintptr_t Address = Transfer->Transfer.Transactions[Index].BufferAddress;
+    if (Transfer->Transfer.Type == InterruptTransfer && Transfer->Transfer.PeriodicBufferSize != 0) {
+        Address += Transfer->CurrentDataIndex;
+    }
+    return Address;
+}
+
+/* XhciTransferFill
+ * Builds the td for the transfer on the endpoint ring and rings the doorbell.
+ * Returns OsError if the ring has no room for the td right now. */
+static OsStatus_t
+XhciTransferFill(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ UsbManagerTransfer_t*  Transfer)
+{
+    // Variables
+    UsbTransfer_t *Usb          = &Transfer->Transfer;
+    int Dci                     = XhciGetEndpointIndex(Usb);
+    XhciEndpoint_t *Endpoint    = &Device->Endpoints[Dci];
+    int StreamId                = (Endpoint->StreamCount != 0) ? (int)Usb->StreamId : 0;
+    XhciRing_t *Ring            = XhciTransferGetRing(Endpoint, StreamId);
+    size_t MaxPacketSize        = MAX(Usb->Endpoint.MaxPacketSize, 1);
+    size_t Count                = 1;
+    size_t Total                = 0;
+    size_t Index;
+    int i;
+
+    if (Ring == NULL) {
+        return OsError;
+    }
+
+    // Count the trbs and bytes of the td
+    if (Usb->Type == ControlTransfer) {
+        MaxPacketSize = Device->ControlPacketSize;
+        Count += 2;
+        if (Usb->TransactionCount == 3) {
+            Count += XhciTransferCountTrbs(Usb->Transactions[1].BufferAddress, Usb->Transactions[1].Length);
+            Total  = Usb->Transactions[1].Length;
+        }
+    }
+    else {
+        for (i = 0; i < Usb->TransactionCount; i++) {
+            Count += XhciTransferCountTrbs(XhciTransferGetBuffer(Transfer, i), Usb->Transactions[i].Length);
+            Total += Usb->Transactions[i].Length;
+        }
+    }
+
+    SpinlockAcquire(&Ring->Lock);
+    if (XhciRingSpace(Ring) < Count) {
+        SpinlockRelease(&Ring->Lock);
+        return OsError;
+    }
+
+    XhciRingBegin(Ring);
+    if (Usb->Type == ControlTransfer) {
+        int HasData     = (Usb->TransactionCount == 3);
+        int DataIn      = HasData && (Usb->Transactions[1].Type == InTransaction);
+        uint64_t Setup  = 0;
+
+        // The setup packet goes inline in the trb
+        memcpy(&Setup, &Usb->SetupPacket[0], sizeof(Setup));
+        XhciRingEnqueue(Ring, Setup, XHCI_TRB_LENGTH(8),
+            XHCI_TRB_TYPE(XHCI_TRB_SETUP) | XHCI_TRB_IDT | XHCI_TRB_CHAIN
+            | XHCI_TRB_TRANSFERTYPE(HasData ? (DataIn ? XHCI_SETUP_INDATA : XHCI_SETUP_OUTDATA) : XHCI_SETUP_NODATA));
+        if (HasData) {
+            XhciTransferFillBuffer(Ring, Usb->Transactions[1].BufferAddress, Usb->Transactions[1].Length,
+                XHCI_TRB_DATA, DataIn ? XHCI_TRB_DIRECTION_IN : 0, MaxPacketSize, &Total);
+        }
+
+        // The status stage goes the opposite way of the data
+        XhciRingEnqueue(Ring, 0, 0, XHCI_TRB_TYPE(XHCI_TRB_STATUS) | XHCI_TRB_CHAIN
+            | (DataIn ? 0 : XHCI_TRB_DIRECTION_IN));
+    }
+    else {
+        for (i = 0; i < Usb->TransactionCount; i++) {
+            XhciTransferFillBuffer(Ring, XhciTransferGetBuffer(Transfer, i), Usb->Transactions[i].Length,
+                XHCI_TRB_NORMAL, 0, MaxPacketSize, &Total);
+        }
+    }
+
+    // Finish the td with the event data trb that identifies it
+    Index = XhciRingEnqueue(Ring, XHCI_TD_COOKIE(StreamId, Ring->Enqueue), 0,
+        XHCI_TRB_TYPE(XHCI_TRB_EVENTDATA) | XHCI_TRB_IOC);
+    Ring->Owners[Index] = Transfer;
+    XhciRingCommit(Ring);
+    SpinlockRelease(&Ring->Lock);
+
+    // Halted endpoints are restarted when recovery completes
+    if (!Endpoint->Recovering) {
+        Controller->Doorbells[Device->SlotId] = (reg32_t)Dci | ((reg32_t)StreamId << 16);
+    }
+    return OsSuccess;
+}
+
+/* XhciTransferFind
+ * Locates the td of the transfer in the endpoint rings */
+static XhciRing_t*
+XhciTransferFind(
+    _In_  XhciDevice_t*         Device,
+    _In_  UsbManagerTransfer_t* Transfer,
+    _Out_ size_t*               Index)
+{
+    // Variables
+    XhciEndpoint_t *Endpoint = &Device->Endpoints[XhciGetEndpointIndex(&Transfer->Transfer)];
+    size_t i, j;
+
+    if (Endpoint->Rings == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < Endpoint->StreamCount + 1; i++) {
+        XhciRing_t *Ring = &Endpoint->Rings[i];
+        if (Ring->Trbs == NULL) {
+            continue;
+        }
+        for (j = Ring->Dequeue; j != Ring->Enqueue; j = XHCI_RING_NEXT(j)) {
+            if (Ring->Owners[j] == Transfer) {
+                *Index = j;
+                return Ring;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* XhciTransferCancel
+ * Turns the td ending at <Last> into no-ops, the event data trb is kept so
+ * the ring still retires in order. Endpoint must be stopped. */
+static void
+XhciTransferCancel(
+    _In_ XhciRing_t*            Ring,
+    _In_ size_t                 Last)
+{
+    // Variables
+    size_t Start = Ring->Dequeue;
+    size_t i;
+
+    for (i = Ring->Dequeue; i != Last; i = XHCI_RING_NEXT(i)) {
+        if (Ring->Owners[i] != NULL) {
+            Start = XHCI_RING_NEXT(i);
+        }
+    }
+    for (i = Start; i != Last; i = XHCI_RING_NEXT(i)) {
+        Ring->Trbs[i].Control = (Ring->Trbs[i].Control & (XHCI_TRB_CYCLE | XHCI_TRB_CHAIN))
+            | XHCI_TRB_TYPE(XHCI_TRB_NOOP);
+    }
+    Ring->Owners[Last] = XHCI_TD_CANCELLED;
+}
+
+/* XhciTransferComplete
+ * Removes a control/bulk transfer from the controller and finalizes it,
+ * this notifies the requester and frees the transfer. */
+static void
+XhciTransferComplete(
+    _In_ XhciController_t*      Controller,
+    _In_ UsbManagerTransfer_t*  Transfer,
+    _In_ UsbTransferStatus_t    Status)
+{
+    // Variables
+    DataKey_t Key;
+
+    Key.Value = (int)Transfer->Id;
+    CollectionRemoveByKey(Controller->Base.TransactionList, Key);
+    Transfer->Status                = Status;
+    Transfer->TransactionsExecuted  = Transfer->TransactionsTotal;
+    UsbManagerFinalizeTransfer(&Controller->Base, Transfer);
+}
+
+/* XhciTransferFinish
+ * Updates the transfer with the result of its td. Periodic transfers are
+ * notified and queued again, all others are completed. */
+static void
+XhciTransferFinish(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ UsbManagerTransfer_t*  Transfer,
+    _In_ UsbTransferStatus_t    Status,
+    _In_ size_t                 Length)
+{
+    // Variables
+    size_t Requested = 0;
+    int i;
+
+    // Distribute the bytes across the transactions carrying data
+    if (Transfer->Transfer.Type == ControlTransfer) {
+        if (Transfer->Transfer.TransactionCount == 3) {
+            Requested                       = Transfer->Transfer.Transactions[1].Length;
+            Transfer->BytesTransferred[1]   = MIN(Length, Requested);
+        }
+    }
+    else {
+        for (i = 0; i < Transfer->Transfer.TransactionCount; i++) {
+            size_t Bytes = MIN(Length, Transfer->Transfer.Transactions[i].Length);
+            Transfer->BytesTransferred[i]   = Bytes;
+            Requested                      += Transfer->Transfer.Transactions[i].Length;
+            Length                         -= Bytes;
+        }
+        Length = Transfer->BytesTransferred[0] + Transfer->BytesTransferred[1] + Transfer->BytesTransferred[2];
+    }
+    if (Status == TransferFinished && Length < Requested) {
+        Transfer->Flags |= TransferFlagShort;
+    }
+
+    if (Transfer->Transfer.Type == InterruptTransfer) {
+        Transfer->Status = Status;
+        if (Transfer->Flags & TransferFlagUnschedule) {
+            return;
+        }
+        UsbManagerSendNotification(Transfer);
+
+        // Re-arm with the next part of the buffer
+        Transfer->Status    = TransferQueued;
+        Transfer->Flags     = TransferFlagNone;
+        if (XhciTransferFill(Controller, Device, Transfer) != OsSuccess) {
+            Transfer->Status = TransferNotProcessed;
+        }
+    }
+    else {
+        XhciTransferComplete(Controller, Transfer, Status);
+    }
+}
+
+/* XhciRecoveryDone
+ * Final step of endpoint recovery, restarts the endpoint */
+static void
+XhciRecoveryDone(
+    _In_ XhciController_t*      Controller,
+    _In_ int                    CompletionCode,
+    _In_ int                    SlotId,
+    _In_ void*                  Context)
+{
+    // Variables
+    XhciDevice_t *Device    = Controller->Slots[XHCI_RECOVERY_SLOT(Context)];
+    int Dci                 = XHCI_RECOVERY_DCI(Context);
+    _CRT_UNUSED(SlotId);
+
+    if (CompletionCode != XHCI_CC_SUCCESS) {
+        ERROR("XHCI: Failed to move dequeue of endpoint %i, code %i", Dci, CompletionCode);
+    }
+    if (Device != NULL && Device->Endpoints[Dci].Rings != NULL) {
+        Device->Endpoints[Dci].Recovering = 0;
+        XhciTransferRingDoorbell(Controller, Device, Dci);
+    }
+}
+
+/* XhciRecoveryReset
+ * Second step of endpoint recovery, the endpoint is reset and the ring
+ * dequeue must be moved past the failed td. */
+static void
+XhciRecoveryReset(
+    _In_ XhciController_t*      Controller,
+    _In_ int                    CompletionCode,
+    _In_ int                    SlotId,
+    _In_ void*                  Context)
+{
+    // Variables
+    XhciDevice_t *Device    = Controller->Slots[XHCI_RECOVERY_SLOT(Context)];
+    int Dci                 = XHCI_RECOVERY_DCI(Context);
+    int StreamId            = XHCI_RECOVERY_STREAM(Context);
+    XhciRing_t *Ring        = NULL;
+    uint64_t Dequeue;
+    _CRT_UNUSED(SlotId);
+
+    if (Device == NULL || (Ring = XhciTransferGetRing(&Device->Endpoints[Dci], StreamId)) == NULL) {
+        return;
+    }
+    if (CompletionCode != XHCI_CC_SUCCESS) {
+        WARNING("XHCI: Reset of endpoint %i returned code %i", Dci, CompletionCode);
+    }
+
+    SpinlockAcquire(&Ring->Lock);
+    Dequeue = XhciRingGetDequeue(Ring);
+    SpinlockRelease(&Ring->Lock);
+    if (StreamId != 0) {
+        Dequeue |= XHCI_STREAM_PRIMARY;
+    }
+    if (XhciCommandQueue(Controller, Dequeue, XHCI_TRB_STREAM(StreamId),
+            XHCI_TRB_TYPE(XHCI_TRB_SET_DEQUEUE) | XHCI_TRB_ENDPOINT(Dci) | XHCI_TRB_SLOT(Device->SlotId),
+            XhciRecoveryDone, Context) != OsSuccess) {
+        ERROR("XHCI: Failed to queue set dequeue for endpoint %i", Dci);
+    }
+}
+
+/* XhciTransferRecover
+ * Starts recovery of a halted endpoint. This runs asynchronously as it is
+ * initiated from the event handler. */
+static void
+XhciTransferRecover(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Dci,
+    _In_ int                    StreamId)
+{
+    // Debug
+    TRACE("XhciTransferRecover(Slot %i, Dci %i)", Device->SlotId, Dci);
+
+    Device->Endpoints[Dci].Recovering = 1;
+    if (XhciCommandQueue(Controller, 0, 0,
+            XHCI_TRB_TYPE(XHCI_TRB_RESET_ENDPOINT) | XHCI_TRB_ENDPOINT(Dci) | XHCI_TRB_SLOT(Device->SlotId),
+            XhciRecoveryReset, XHCI_RECOVERY_CONTEXT(Device->SlotId, Dci, StreamId)) != OsSuccess) {
+        ERROR("XHCI: Failed to queue reset for endpoint %i", Dci);
+    }
+}
+
+/* XhciTransferEvent
+ * Handles a transfer event, completing the td it belongs to */
+void
+XhciTransferEvent(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciTrb_t*             Event)
+{
+    // Variables
+    int CompletionCode          = XHCI_EVENT_CODE(Event->Status);
+    int SlotId                  = XHCI_EVENT_GETSLOT(Event->Control);
+    int Dci                     = XHCI_EVENT_GETENDPOINT(Event->Control);
+    XhciEndpoint_t *Endpoint    = NULL;
+    XhciDevice_t *Device        = NULL;
+    XhciRing_t *Ring            = NULL;
+    void *Owner                 = NULL;
+    size_t Length               = 0;
+    int StreamId                = 0;
+    size_t Last, i;
+
+    // Debug
+    TRACE("XhciTransferEvent(Slot %i, Dci %i, Code %i)", SlotId, Dci, CompletionCode);
+
+    if (SlotId == 0 || SlotId > (int)Controller->MaxSlots || Dci == 0) {
+        return;
+    }
+    Device = Controller->Slots[SlotId];
+    if (Device == NULL || Device->Endpoints[Dci].Rings == NULL) {
+        return;
+    }
+    Endpoint = &Device->Endpoints[Dci];
+
+    // Stopping an endpoint reports the td it was in the middle of,
+    // it is continued when the endpoint is restarted.
+    if (CompletionCode == XHCI_CC_STOPPED || CompletionCode == XHCI_CC_STOPPED_LENGTH) {
+        return;
+    }
+
+    if (Event->Control & XHCI_EVENT_DATA) {
+        StreamId    = (int)XHCI_TD_COOKIE_STREAM(Event->ParameterLow);
+        Last        = XHCI_TD_COOKIE_INDEX(Event->ParameterLow);
+        Ring        = XhciTransferGetRing(Endpoint, StreamId);
+        Length      = XHCI_EVENT_LENGTH(Event->Status);
+        if (Ring == NULL || Last >= XHCI_RING_SIZE - 1) {
+            return;
+        }
+    }
+    else {
+        // An error was reported on a trb inside the td, locate the ring
+        // and then the end of the td it belongs to
+        int Index = -1;
+        for (i = 0; i < Endpoint->StreamCount + 1 && Index < 0; i++) {
+            Index = XhciRingGetIndex(&Endpoint->Rings[i], Event->ParameterLow);
+            if (Index >= 0) {
+                Ring        = &Endpoint->Rings[i];
+                StreamId    = (int)i;
+            }
+        }
+        if (Ring == NULL || CompletionCode == XHCI_CC_SUCCESS
+            || CompletionCode == XHCI_CC_SHORT_PACKET) {
+            return;
+        }
+
+        Last = (size_t)Index;
+        while (Ring->Owners[Last] == NULL && Last != Ring->Enqueue) {
+            Last = XHCI_RING_NEXT(Last);
+        }
+        if (Last == Ring->Enqueue) {
+            return;
+        }
+    }
+
+    SpinlockAcquire(&Ring->Lock);
+    Owner = Ring->Owners[Last];
+    XhciRingRetire(Ring, Last);
+    SpinlockRelease(&Ring->Lock);
+
+    // Errors that halt the endpoint needs the endpoint reset
+    if (CompletionCode == XHCI_CC_STALL || CompletionCode == XHCI_CC_BABBLE
+        || CompletionCode == XHCI_CC_TRANSACTION_ERROR) {
+        XhciTransferRecover(Controller, Device, Dci, StreamId);
+    }
+
+    if (Owner == NULL || Owner == XHCI_TD_CANCELLED) {
+        return;
+    }
+    XhciTransferFinish(Controller, Device, (UsbManagerTransfer_t*)Owner,
+        XhciGetStatusCode(CompletionCode), Length);
+}
+
+/* XhciTransferStopped
+ * Completion of the Stop Endpoint command issued by dequeue. The td of the
+ * transfer is cancelled and the endpoint restarted. */
+static void
+XhciTransferStopped(
+    _In_ XhciController_t*      Controller,
+    _In_ int                    CompletionCode,
+    _In_ int                    SlotId,
+    _In_ void*                  Context)
+{
+    // Variables
+    UsbManagerTransfer_t *Transfer  = (UsbManagerTransfer_t*)Context;
+    XhciDevice_t *Device            = (XhciDevice_t*)Transfer->EndpointDescriptor;
+    XhciRing_t *Ring                = NULL;
+    DataKey_t Key;
+    size_t Last;
+    _CRT_UNUSED(CompletionCode);
+    _CRT_UNUSED(SlotId);
+
+    if (Device != NULL) {
+        Ring = XhciTransferFind(Device, Transfer, &Last);
+        if (Ring != NULL) {
+            SpinlockAcquire(&Ring->Lock);
+            XhciTransferCancel(Ring, Last);
+            SpinlockRelease(&Ring->Lock);
+        }
+        XhciTransferRingDoorbell(Controller, Device, XhciGetEndpointIndex(&Transfer->Transfer));
+    }
+
+    // Control and bulk requesters are blocked on the response
+    if (Transfer->Transfer.Type == ControlTransfer || Transfer->Transfer.Type == BulkTransfer) {
+        UsbManagerSendNotification(Transfer);
+    }
+    Key.Value = (int)Transfer->Id;
+    CollectionRemoveByKey(Controller->Base.TransactionList, Key);
+    free(Transfer);
+}
+
+/* XhciTransferAbortDevice
+ * Completes every transfer that targets the given device with an error */
+void
+XhciTransferAbortDevice(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device)
+{
+    // Variables
+    CollectionItem_t *tNode;
+    size_t i, j;
+
+    // Mark everything first, finalizing may re-drive other transfers
+    _foreach(tNode, Controller->Base.TransactionList) {
+        UsbManagerTransfer_t *Transfer = (UsbManagerTransfer_t*)tNode->Data;
+        if (Transfer->EndpointDescriptor == Device) {
+            Transfer->EndpointDescriptor    = NULL;
+            Transfer->Flags                |= TransferFlagCleanup;
+        }
+    }
+
+    // Late events for the device must not reach the transfers
+    for (i = 0; i < XHCI_MAX_ENDPOINTS; i++) {
+        XhciEndpoint_t *Endpoint = &Device->Endpoints[i];
+        if (Endpoint->Rings == NULL) {
+            continue;
+        }
+        for (j = 0; j < Endpoint->StreamCount + 1; j++) {
+            XhciRing_t *Ring = &Endpoint->Rings[j];
+            size_t k;
+            for (k = 0; k < XHCI_RING_SIZE; k++) {
+                if (Ring->Owners[k] != NULL) {
+                    Ring->Owners[k] = XHCI_TD_CANCELLED;
+                }
+            }
+        }
+    }
+
+Restart:
+    _foreach(tNode, Controller->Base.TransactionList) {
+        UsbManagerTransfer_t *Transfer = (UsbManagerTransfer_t*)tNode->Data;
+        if (!(Transfer->Flags & TransferFlagCleanup)) {
+            continue;
+        }
+        Transfer->Flags &= ~(TransferFlagCleanup);
+
+        // Periodic transfers stay until the owner dequeues them
+        if (Transfer->Transfer.Type == InterruptTransfer
+            || Transfer->Transfer.Type == IsochronousTransfer) {
+            Transfer->Status = TransferInvalid;
+            UsbManagerSendNotification(Transfer);
+            continue;
+        }
+        XhciTransferComplete(Controller, Transfer, TransferInvalid);
+        goto Restart;
+    }
+}
+
+/* HciQueueTransferGeneric
+ * Queues a new asynchronous/interrupt transfer for the given driver and pipe.
+ * The function does not block. */
+UsbTransferStatus_t
+HciQueueTransferGeneric(
+    _In_ UsbManagerTransfer_t*  Transfer)
+{
+    // Variables
+    XhciController_t *Controller    = NULL;
+    XhciDevice_t *Device            = NULL;
+    int Dci                         = XhciGetEndpointIndex(&Transfer->Transfer);
+    int Queued                      = 0;
+    DataKey_t Key;
+
+    // Get Controller
+    Controller  = (XhciController_t*)UsbManagerGetController(Transfer->DeviceId);
+    Key.Value   = (int)Transfer->Id;
+    Queued      = (CollectionGetDataByKey(Controller->Base.TransactionList, Key, 0) != NULL);
+
+    // Transfers waiting for ring space already know their device
+    if (Queued) {
+        Device = (XhciDevice_t*)Transfer->EndpointDescriptor;
+        if (Device == NULL) {
+            XhciTransferComplete(Controller, Transfer, TransferInvalid);
+            return TransferInvalid;
+        }
+    }
+    else {
+        Device = XhciDeviceGet(Controller, &Transfer->Transfer);
+        if (Device == NULL) {
+            return TransferInvalid;
+        }
+        Transfer->EndpointDescriptor = Device;
+
+        if (Transfer->Transfer.Type == ControlTransfer) {
+            // The controller owns device addressing, so SET_ADDRESS is
+            // replaced with the Address Device command
+            if (Transfer->Transfer.SetupPacket[0] == USBPACKET_DIRECTION_OUT
+                && Transfer->Transfer.SetupPacket[1] == USBPACKET_TYPE_SET_ADDRESS) {
+                if (XhciDeviceSetAddress(Controller, Device, Transfer->Transfer.SetupPacket[2]) != OsSuccess) {
+                    Transfer->Status = TransferInvalid;
+                }
+                else {
+                    Transfer->Status = TransferFinished;
+                }
+                return Transfer->Status;
+            }
+            XhciDeviceUpdateControl(Controller, Device, Transfer->Transfer.Endpoint.MaxPacketSize);
+        }
+        else if (Transfer->Transfer.Type == IsochronousTransfer) {
+            return TransferInvalid;
+        }
+        else if (!Device->Endpoints[Dci].Configured
+            && XhciDeviceConfigureEndpoint(Controller, Device, Dci, &Transfer->Transfer) != OsSuccess) {
+            return TransferInvalid;
+        }
+
+        if (Device->Endpoints[Dci].StreamCount != 0
+            && (Transfer->Transfer.StreamId == 0
+                || Transfer->Transfer.StreamId > Device->Endpoints[Dci].StreamCount)) {
+            return TransferInvalid;
+        }
+        Transfer->TransactionsTotal = Transfer->Transfer.TransactionCount;
+        CollectionAppend(Controller->Base.TransactionList, CollectionCreateNode(Key, Transfer));
+    }
+
+    // Wait for room on the ring if it's full, completions will re-drive us
+    if (XhciTransferFill(Controller, Device, Transfer) != OsSuccess) {
+        Transfer->Status = TransferNotProcessed;
+        return TransferQueued;
+    }
+    Transfer->Status = TransferQueued;
+    return TransferQueued;
+}
+
+/* HciQueueTransferIsochronous
+ * Queues a new isochronous transfer for the given driver and pipe.
+ * The function does not block. */
+UsbTransferStatus_t
+HciQueueTransferIsochronous(
+    _In_ UsbManagerTransfer_t*  Transfer)
+{
+    WARNING("XHCI: Isochronous transfers are not supported (Id %u)", Transfer->Id);
+    return TransferInvalid;
+}
+
+/* HciDequeueTransfer
+ * Removes a queued transfer from the controller's transfer list */
+UsbTransferStatus_t
+HciDequeueTransfer(
+    _In_ UsbManagerTransfer_t*      Transfer)
+{
+    // Variables
+    XhciController_t *Controller    = NULL;
+    XhciDevice_t *Device            = NULL;
+    size_t Last;
+    DataKey_t Key;
+
+    // Get Controller
+    Controller  = (XhciController_t*)UsbManagerGetController(Transfer->DeviceId);
+    Device      = (XhciDevice_t*)Transfer->EndpointDescriptor;
+    Transfer->Flags |= TransferFlagUnschedule;
+
+    // The td must be pulled from a stopped endpoint, so the cleanup is
+    // done when the stop completes
+    if (Device != NULL && XhciTransferFind(Device, Transfer, &Last) != NULL) {
+        if (XhciCommandQueue(Controller, 0, 0, XHCI_TRB_TYPE(XHCI_TRB_STOP_ENDPOINT)
+                | XHCI_TRB_ENDPOINT(XhciGetEndpointIndex(&Transfer->Transfer))
+                | XHCI_TRB_SLOT(Device->SlotId), XhciTransferStopped, Transfer) == OsSuccess) {
+            return TransferFinished;
+        }
+        ERROR("XHCI: Failed to stop endpoint for transfer %u", Transfer->Id);
+    }
+
+    if (Transfer->Transfer.Type == ControlTransfer || Transfer->Transfer.Type == BulkTransfer) {
+        UsbManagerSendNotification(Transfer);
+    }
+    Key.Value = (int)Transfer->Id;
+    CollectionRemoveByKey(Controller->Base.TransactionList, Key);
+    free(Transfer);
+    return TransferFinished;
+}
+
+/* HciTransactionFinalize
+ * Finalizes a transfer by cleaning up resources allocated. For xhci the td
+ * is only detached from its ring, the ring itself is reused. */
+OsStatus_t
+HciTransactionFinalize(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ UsbManagerTransfer_t*      Transfer,
+    _In_ int                        Reset)
+{
+    // Variables
+    XhciDevice_t *Device    = (XhciDevice_t*)Transfer->EndpointDescriptor;
+    XhciRing_t *Ring        = NULL;
+    size_t Last;
+    _CRT_UNUSED(Controller);
+    _CRT_UNUSED(Reset);
+
+    if (Device != NULL) {
+        Ring = XhciTransferFind(Device, Transfer, &Last);
+        if (Ring != NULL) {
+            Ring->Owners[Last] = XHCI_TD_CANCELLED;
+        }
+    }
+    return OsSuccess;
+}
+
+/* HciProcessElement
+ * The xhci completes transfers through the event ring, there are no
+ * scheduler elements to process. */
+int
+HciProcessElement(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ uint8_t*                   Element,
+    _In_ int                        Reason,
+    _In_ void*                      Context)
+{
+    _CRT_UNUSED(Controller);
+    _CRT_UNUSED(Element);
+    _CRT_UNUSED(Reason);
+    _CRT_UNUSED(Context);
+    return ITERATOR_CONTINUE;
+}
+
+/* HciProcessEvent
+ * Invoked on different very specific events that require assistance. Unused
+ * by the xhci as periodic transfers are re-armed on completion. */
+void
+HciProcessEvent(
+    _In_ UsbManagerController_t*    Controller,
+    _In_ int                        Event,
+    _In_ void*                      Context)
+{
+    _CRT_UNUSED(Controller);
+    _CRT_UNUSED(Event);
+    _CRT_UNUSED(Context);
+}
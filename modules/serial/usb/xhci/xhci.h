@@ -0,0 +1,733 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - eXtensible Host Controller Interface Driver
+ * TODO:
+ * - Power Management
+ * - Devices behind external hubs (route strings, TT information)
+ * - Isochronous transfers
+ * - Verify on hardware, the driver has not been run against a controller yet
+ *   and is left out of the default driver build until it has
+ */
+
+#ifndef __USB_XHCI__
+#define __USB_XHCI__
+
+/* Includes
+ * - Library */
+#include <os/osdefs.h>
+#include <os/contracts/usbhost.h>
+#include <os/spinlock.h>
+#include <ds/collection.h>
+
+#include "../common/manager.h"
+#include "../common/hci.h"
+
+/* XHCI Controller Definitions
+ * Contains generic magic constants and definitions */
+#define XHCI_MAX_PORTS              255
+#define XHCI_MAX_SLOTS              255
+#define XHCI_MAX_DEVICE_ADDRESS     128
+#define XHCI_MAX_ENDPOINTS          32      // Device context indices, 0 is the slot
+#define XHCI_MAX_STREAMS            16      // Streams allocated per bulk endpoint
+#define XHCI_RING_SIZE              256     // Trbs per ring, one page, last is a link
+#define XHCI_EVENT_RING_SIZE        256
+#define XHCI_TRB_MAX_LENGTH         0x10000 // Trb buffers may not cross 64kb
+#define XHCI_COMMAND_TIMEOUT        1000    // Milliseconds
+
+/* Coalescing Policy
+ * The controller moderates interrupts by interval only (250ns units, max 0xFFFF),
+ * events are polled again (up to 4 rounds) while 16 or more are consumed per round */
+#define XHCI_COALESCING_POLICY      INTERRUPT_COALESCING_INIT(0, 1000, 16, 4)
+#define XHCI_IMOD_INTERVAL(Us)      (((Us) * 4) > 0xFFFF ? 0xFFFF : ((Us) * 4))
+
+/* XhciCapabilityRegisters
+ * Describes capabilities and gives information about which features the
+ * XHCI controller supports. */
+PACKED_ATYPESTRUCT(volatile, XhciCapabilityRegisters, {
+    uint8_t                     Length;
+    uint8_t                     Reserved;
+    uint16_t                    Version;
+    reg32_t                     SParams1;
+    reg32_t                     SParams2;
+    reg32_t                     SParams3;
+    reg32_t                     CParams1;
+    reg32_t                     DoorbellOffset;
+    reg32_t                     RuntimeOffset;
+    reg32_t                     CParams2;
+});
+
+/* XhciCapabilityRegisters::SParams1
+ * Bits 0-7: Number of device slots
+ * Bits 8-18: Number of interrupters
+ * Bits 24-31: Number of root ports */
+#define XHCI_SPARAM1_MAXSLOTS(n)            ((n) & 0xFF)
+#define XHCI_SPARAM1_MAXINTRS(n)            (((n) >> 8) & 0x7FF)
+#define XHCI_SPARAM1_MAXPORTS(n)            (((n) >> 24) & 0xFF)
+
+/* XhciCapabilityRegisters::SParams2
+ * Bits 4-7: Event ring segment table max (log2)
+ * Bits 21-25: Max scratchpad buffers (hi)
+ * Bits 27-31: Max scratchpad buffers (lo) */
+#define XHCI_SPARAM2_ERSTMAX(n)             (((n) >> 4) & 0xF)
+#define XHCI_SPARAM2_SCRATCHPADS(n)         (((((n) >> 21) & 0x1F) << 5) | (((n) >> 27) & 0x1F))
+
+/* XhciCapabilityRegisters::CParams1
+ * Bits 0: 64 bit addressing capability
+ * Bits 2: Context size, if set contexts are 64 bytes instead of 32
+ * Bits 3: Port power control
+ * Bits 12-15: Maximum primary stream array size (log2 minus one)
+ * Bits 16-31: Extended capabilities pointer in dwords */
+#define XHCI_CPARAM1_64BIT                  (1 << 0)
+#define XHCI_CPARAM1_CONTEXTSIZE            (1 << 2)
+#define XHCI_CPARAM1_PPC                    (1 << 3)
+#define XHCI_CPARAM1_MAXPSA(n)              (((n) >> 12) & 0xF)
+#define XHCI_CPARAM1_XECP(n)                (((n) >> 16) & 0xFFFF)
+
+/* XhciPortRegisters
+ * Register-set for each of the root-hub ports */
+PACKED_ATYPESTRUCT(volatile, XhciPortRegisters, {
+    reg32_t                     Status;
+    reg32_t                     PowerManagement;
+    reg32_t                     LinkInfo;
+    reg32_t                     HardwareLpm;
+});
+
+/* XhciOperationalRegisters
+ * Registers that are used to control and command the XHCI controller
+ * and its ports. */
+PACKED_ATYPESTRUCT(volatile, XhciOperationalRegisters, {
+    reg32_t                     UsbCommand;
+    reg32_t                     UsbStatus;
+    reg32_t                     PageSize;
+    reg32_t                     Reserved0[2];
+    reg32_t                     DeviceNotification;
+    reg32_t                     CommandRingLow;
+    reg32_t                     CommandRingHigh;
+    reg32_t                     Reserved1[4];
+    reg32_t                     ContextBaseLow;
+    reg32_t                     ContextBaseHigh;
+    reg32_t                     Configure;
+    uint8_t                     Reserved2[0x400 - 0x3C];
+    XhciPortRegisters_t         Ports[XHCI_MAX_PORTS];
+});
+
+/* XhciOperationalRegisters::UsbCommand */
+#define XHCI_COMMAND_RUN                    (1 << 0)
+#define XHCI_COMMAND_HCRESET                (1 << 1)
+#define XHCI_COMMAND_INTERRUPTS             (1 << 2)
+#define XHCI_COMMAND_HOSTERROR              (1 << 3)
+
+/* XhciOperationalRegisters::UsbStatus */
+#define XHCI_STATUS_HALTED                  (1 << 0)
+#define XHCI_STATUS_HOSTERROR               (1 << 2)
+#define XHCI_STATUS_EVENT                   (1 << 3)
+#define XHCI_STATUS_PORTCHANGE              (1 << 4)
+#define XHCI_STATUS_NOTREADY                (1 << 11)
+#define XHCI_STATUS_CONTROLLERERROR         (1 << 12)
+
+/* XhciOperationalRegisters::CommandRingLow */
+#define XHCI_CRCR_CYCLE                     (1 << 0)
+
+/* XhciPortRegisters::Status
+ * The change bits are R/WC and the enabled bit is cleared by writing
+ * a one, so those must be masked whenever the register is modified. */
+#define XHCI_PORT_CONNECTED                 (1 << 0)
+#define XHCI_PORT_ENABLED                   (1 << 1)
+#define XHCI_PORT_OVERCURRENT               (1 << 3)
+#define XHCI_PORT_RESET                     (1 << 4)
+#define XHCI_PORT_LINKSTATE(n)              (((n) >> 5) & 0xF)
+#define XHCI_PORT_POWER                     (1 << 9)
+#define XHCI_PORT_SPEED(n)                  (((n) >> 10) & 0xF)
+#define XHCI_PORT_INDICATOR                 (0x3 << 14)
+#define XHCI_PORT_CONNECT_EVENT             (1 << 17)
+#define XHCI_PORT_ENABLE_EVENT              (1 << 18)
+#define XHCI_PORT_WARMRESET_EVENT           (1 << 19)
+#define XHCI_PORT_OC_EVENT                  (1 << 20)
+#define XHCI_PORT_RESET_EVENT               (1 << 21)
+#define XHCI_PORT_LINK_EVENT                (1 << 22)
+#define XHCI_PORT_CONFIG_EVENT              (1 << 23)
+#define XHCI_PORT_WAKE_MASK                 (0x7 << 25)
+#define XHCI_PORT_WARMRESET                 (1U << 31)
+#define XHCI_PORT_RWC                       (0x7F << 17)
+#define XHCI_PORT_PRESERVE                  (XHCI_PORT_POWER | XHCI_PORT_INDICATOR | XHCI_PORT_WAKE_MASK)
+
+/* Protocol speed ids (default mapping) reported in the port status
+ * and used in the slot context. */
+#define XHCI_SPEED_FULL                     1
+#define XHCI_SPEED_LOW                      2
+#define XHCI_SPEED_HIGH                     3
+#define XHCI_SPEED_SUPER                    4
+
+/* XhciInterrupterRegisters
+ * Each interrupter owns an event ring described by a segment table */
+PACKED_ATYPESTRUCT(volatile, XhciInterrupterRegisters, {
+    reg32_t                     Management;
+    reg32_t                     Moderation;
+    reg32_t                     TableSize;
+    reg32_t                     Reserved;
+    reg32_t                     TableAddressLow;
+    reg32_t                     TableAddressHigh;
+    reg64_t                     Dequeue;
+});
+
+/* XhciRuntimeRegisters */
+PACKED_ATYPESTRUCT(volatile, XhciRuntimeRegisters, {
+    reg32_t                     FrameIndex;
+    reg32_t                     Reserved[7];
+    XhciInterrupterRegisters_t  Interrupters[1];
+});
+
+#define XHCI_IMAN_PENDING                   (1 << 0)
+#define XHCI_IMAN_ENABLE                    (1 << 1)
+#define XHCI_ERDP_BUSY                      (1 << 3)
+
+/* XhciWriteRegister64
+ * 64 bit registers are written with a single qword access, a plain store
+ * would be split into two dword writes on 32 bit builds. */
+static inline void
+XhciWriteRegister64(
+    _In_ volatile reg64_t*  Register,
+    _In_ uint64_t           Value)
+{
+    __atomic_store_n(Register, Value, __ATOMIC_RELAXED);
+}
+
+/* Extended capabilities, located at CParams1::XECP */
+#define XHCI_XCAP_ID(n)                     ((n) & 0xFF)
+#define XHCI_XCAP_NEXT(n)                   (((n) >> 8) & 0xFF)
+#define XHCI_XCAP_LEGACY                    1
+#define XHCI_XCAP_PROTOCOL                  2
+
+#define XHCI_LEGACY_BIOS_OWNED              (1 << 16)
+#define XHCI_LEGACY_OS_OWNED                (1 << 24)
+#define XHCI_LEGACY_SMI_MASK                0xE0011F1F  // Enables and RW1C events in USBLEGCTLSTS
+
+#define XHCI_PROTOCOL_MAJOR(n)              (((n) >> 24) & 0xFF)
+#define XHCI_PROTOCOL_PORTOFFSET(n)         ((n) & 0xFF)
+#define XHCI_PROTOCOL_PORTCOUNT(n)          (((n) >> 8) & 0xFF)
+
+/* XhciTrb
+ * The transfer request block, the unit of every ring in the controller. */
+PACKED_ATYPESTRUCT(volatile, XhciTrb, {
+    reg32_t                     ParameterLow;
+    reg32_t                     ParameterHigh;
+    reg32_t                     Status;
+    reg32_t                     Control;
+});
+
+/* XhciTrb::Status */
+#define XHCI_TRB_LENGTH(n)                  ((n) & 0x1FFFF)
+#define XHCI_TRB_TDSIZE(n)                  (((n) & 0x1F) << 17)
+#define XHCI_TRB_INTERRUPTER(n)             (((n) & 0x3FF) << 22)
+#define XHCI_TRB_STREAM(n)                  (((n) & 0xFFFF) << 16)
+#define XHCI_EVENT_LENGTH(n)                ((n) & 0xFFFFFF)
+#define XHCI_EVENT_CODE(n)                  (((n) >> 24) & 0xFF)
+
+/* XhciTrb::Control */
+#define XHCI_TRB_CYCLE                      (1 << 0)
+#define XHCI_TRB_TOGGLE                     (1 << 1)    // Link trbs
+#define XHCI_TRB_ENT                        (1 << 1)
+#define XHCI_TRB_ISP                        (1 << 2)
+#define XHCI_TRB_CHAIN                      (1 << 4)
+#define XHCI_TRB_IOC                        (1 << 5)
+#define XHCI_TRB_IDT                        (1 << 6)
+#define XHCI_TRB_BSR                        (1 << 9)    // Address device
+#define XHCI_TRB_TYPE(n)                    (((n) & 0x3F) << 10)
+#define XHCI_TRB_GETTYPE(n)                 (((n) >> 10) & 0x3F)
+#define XHCI_TRB_DIRECTION_IN               (1 << 16)   // Data and status stages
+#define XHCI_TRB_TRANSFERTYPE(n)            (((n) & 0x3) << 16) // Setup stages
+#define XHCI_TRB_ENDPOINT(n)                (((n) & 0x1F) << 16)
+#define XHCI_TRB_SLOT(n)                    (((n) & 0xFF) << 24)
+#define XHCI_EVENT_DATA                     (1 << 2)
+#define XHCI_EVENT_GETENDPOINT(n)           (((n) >> 16) & 0x1F)
+#define XHCI_EVENT_GETSLOT(n)               (((n) >> 24) & 0xFF)
+
+#define XHCI_SETUP_NODATA                   0
+#define XHCI_SETUP_OUTDATA                  2
+#define XHCI_SETUP_INDATA                   3
+
+/* Trb types */
+#define XHCI_TRB_NORMAL                     1
+#define XHCI_TRB_SETUP                      2
+#define XHCI_TRB_DATA                       3
+#define XHCI_TRB_STATUS                     4
+#define XHCI_TRB_ISOCHRONOUS                5
+#define XHCI_TRB_LINK                       6
+#define XHCI_TRB_EVENTDATA                  7
+#define XHCI_TRB_NOOP                       8
+#define XHCI_TRB_ENABLE_SLOT                9
+#define XHCI_TRB_DISABLE_SLOT               10
+#define XHCI_TRB_ADDRESS_DEVICE             11
+#define XHCI_TRB_CONFIGURE_ENDPOINT         12
+#define XHCI_TRB_EVALUATE_CONTEXT           13
+#define XHCI_TRB_RESET_ENDPOINT             14
+#define XHCI_TRB_STOP_ENDPOINT              15
+#define XHCI_TRB_SET_DEQUEUE                16
+#define XHCI_TRB_RESET_DEVICE               17
+#define XHCI_TRB_TRANSFER_EVENT             32
+#define XHCI_TRB_COMMAND_EVENT              33
+#define XHCI_TRB_PORT_EVENT                 34
+#define XHCI_TRB_HOST_EVENT                 37
+
+/* Completion codes */
+#define XHCI_CC_SUCCESS                     1
+#define XHCI_CC_BUFFER_ERROR                2
+#define XHCI_CC_BABBLE                      3
+#define XHCI_CC_TRANSACTION_ERROR           4
+#define XHCI_CC_TRB_ERROR                   5
+#define XHCI_CC_STALL                       6
+#define XHCI_CC_SHORT_PACKET                13
+#define XHCI_CC_STOPPED                     26
+#define XHCI_CC_STOPPED_LENGTH              27
+
+/* XhciEventTableEntry
+ * An entry in the event ring segment table */
+PACKED_ATYPESTRUCT(volatile, XhciEventTableEntry, {
+    reg32_t                     AddressLow;
+    reg32_t                     AddressHigh;
+    reg32_t                     Size;
+    reg32_t                     Reserved;
+});
+
+/* XhciSlotContext
+ * Describes the device as a whole, the first context in a device context.
+ * Contexts are either 32 or 64 bytes, only the first 32 are used. */
+PACKED_ATYPESTRUCT(volatile, XhciSlotContext, {
+    reg32_t                     Route;
+    reg32_t                     Ports;
+    reg32_t                     Translator;
+    reg32_t                     State;
+    reg32_t                     Reserved[4];
+});
+
+#define XHCI_SLOT_SPEED(n)                  (((n) & 0xF) << 20)
+#define XHCI_SLOT_ENTRIES(n)                (((n) & 0x1F) << 27)
+#define XHCI_SLOT_GETENTRIES(n)             (((n) >> 27) & 0x1F)
+#define XHCI_SLOT_ROOTPORT(n)               (((n) & 0xFF) << 16)
+#define XHCI_SLOT_ADDRESS(n)                ((n) & 0xFF)
+
+/* XhciEndpointContext
+ * Describes a single endpoint and the ring (or stream array) it executes. */
+PACKED_ATYPESTRUCT(volatile, XhciEndpointContext, {
+    reg32_t                     State;
+    reg32_t                     Configuration;
+    reg32_t                     DequeueLow;
+    reg32_t                     DequeueHigh;
+    reg32_t                     Lengths;
+    reg32_t                     Reserved[3];
+});
+
+#define XHCI_EP_MAXPSTREAMS(n)              (((n) & 0x1F) << 10)
+#define XHCI_EP_LSA                         (1 << 15)
+#define XHCI_EP_INTERVAL(n)                 (((n) & 0xFF) << 16)
+#define XHCI_EP_ERRORCOUNT(n)               (((n) & 0x3) << 1)
+#define XHCI_EP_TYPE(n)                     (((n) & 0x7) << 3)
+#define XHCI_EP_MAXBURST(n)                 (((n) & 0xFF) << 8)
+#define XHCI_EP_MAXPACKET(n)                (((n) & 0xFFFF) << 16)
+#define XHCI_EP_GETMAXPACKET(n)             (((n) >> 16) & 0xFFFF)
+#define XHCI_EP_AVGLENGTH(n)                ((n) & 0xFFFF)
+#define XHCI_EP_MAXESIT(n)                  (((n) & 0xFFFF) << 16)
+#define XHCI_EP_DCS                         (1 << 0)
+
+#define XHCI_EPTYPE_ISOC_OUT                1
+#define XHCI_EPTYPE_BULK_OUT                2
+#define XHCI_EPTYPE_INTERRUPT_OUT           3
+#define XHCI_EPTYPE_CONTROL                 4
+#define XHCI_EPTYPE_ISOC_IN                 5
+#define XHCI_EPTYPE_BULK_IN                 6
+#define XHCI_EPTYPE_INTERRUPT_IN            7
+
+/* XhciInputControlContext
+ * The first context of an input context, selects the contexts to evaluate */
+PACKED_ATYPESTRUCT(volatile, XhciInputControlContext, {
+    reg32_t                     DropFlags;
+    reg32_t                     AddFlags;
+    reg32_t                     Reserved[6];
+});
+
+/* XhciStreamContext
+ * Entry in a linear primary stream context array */
+PACKED_ATYPESTRUCT(volatile, XhciStreamContext, {
+    reg32_t                     DequeueLow;
+    reg32_t                     DequeueHigh;
+    reg32_t                     StoppedLength;
+    reg32_t                     Reserved;
+});
+
+#define XHCI_STREAM_PRIMARY                 (1 << 1)    // SCT = 1
+
+/* XhciRing
+ * A producer ring of trbs, used both for commands and transfers. The owner
+ * table keeps the transfer that ends at a given trb so completions can
+ * be matched in order. */
+typedef struct _XhciRing {
+    XhciTrb_t*                  Trbs;
+    uintptr_t                   TrbsPhysical;
+    size_t                      Enqueue;
+    size_t                      Dequeue;
+    int                         Cycle;
+    size_t                      HoldIndex;      // First trb of the td being built
+    int                         Holding;
+    void*                       Owners[XHCI_RING_SIZE];
+    Spinlock_t                  Lock;
+} XhciRing_t;
+
+/* XhciEndpoint
+ * Software state of an endpoint on a device slot. Endpoints with streams
+ * have one ring per stream, stream 0 is reserved by the specification. */
+typedef struct _XhciEndpoint {
+    int                         Configured;
+    int                         Recovering;     // Reset/Set dequeue in flight
+    size_t                      StreamCount;
+    XhciRing_t*                 Rings;
+    XhciStreamContext_t*        Streams;
+    uintptr_t                   StreamsPhysical;
+} XhciEndpoint_t;
+
+/* XhciDevice
+ * Software state of a device slot */
+typedef struct _XhciDevice {
+    int                         SlotId;
+    int                         Port;           // Root port index (zero-based)
+    int                         Address;        // Address assigned by the usb-manager
+    UsbSpeed_t                  Speed;
+    size_t                      ControlPacketSize;
+
+    void*                       InputContext;
+    uintptr_t                   InputPhysical;
+    void*                       OutputContext;
+    uintptr_t                   OutputPhysical;
+    XhciEndpoint_t              Endpoints[XHCI_MAX_ENDPOINTS];
+} XhciDevice_t;
+
+/* XhciController
+ * Contains all per-controller information that is
+ * needed to control, queue and handle devices on an xhci-controller. */
+typedef struct _XhciController XhciController_t;
+typedef void(*XhciCommandCallback)(
+    _In_ XhciController_t*      Controller,
+    _In_ int                    CompletionCode,
+    _In_ int                    SlotId,
+    _In_ void*                  Context);
+
+/* XhciCommand
+ * Completion tracking for a trb on the command ring */
+typedef struct _XhciCommand {
+    int                         Pending;
+    int                         CompletionCode;
+    int                         SlotId;
+    XhciCommandCallback         Callback;
+    void*                       Context;
+} XhciCommand_t;
+
+struct _XhciController {
+    UsbManagerController_t      Base;
+
+    // Registers and resources
+    XhciCapabilityRegisters_t*  CapRegisters;
+    XhciOperationalRegisters_t* OpRegisters;
+    XhciRuntimeRegisters_t*     RtRegisters;
+    reg32_t*                    Doorbells;
+    int                         MsiEnabled;
+    InterruptCoalescing_t       Coalescing;
+
+    // Copy of vital registers
+    reg32_t                     SParameters1;
+    reg32_t                     SParameters2;
+    reg32_t                     CParameters1;
+    size_t                      MaxSlots;
+    size_t                      ContextSize;
+
+    // Memory shared with the controller
+    reg64_t*                    ContextBase;
+    uintptr_t                   ContextBasePhysical;
+    reg64_t*                    ScratchpadTable;
+    uintptr_t                   ScratchpadTablePhysical;
+    void*                       Scratchpads;
+    size_t                      ScratchpadCount;
+
+    XhciRing_t                  CommandRing;
+    XhciCommand_t               Commands[XHCI_RING_SIZE];
+
+    XhciTrb_t*                  EventRing;
+    uintptr_t                   EventRingPhysical;
+    XhciEventTableEntry_t*      EventTable;
+    uintptr_t                   EventTablePhysical;
+    size_t                      EventDequeue;
+    int                         EventCycle;
+    Spinlock_t                  EventLock;
+
+    // Device bookkeeping
+    uint8_t                     PortProtocols[XHCI_MAX_PORTS];
+    XhciDevice_t*               Slots[XHCI_MAX_SLOTS + 1];
+    XhciDevice_t*               Addresses[XHCI_MAX_DEVICE_ADDRESS];
+    XhciDevice_t*               PortDevices[XHCI_MAX_PORTS];
+};
+
+/* Context accessors, contexts are 32 or 64 bytes depending on CParams1.
+ * Input contexts have the input control context at index 0, so device
+ * context index n is at input index n + 1. */
+#define XHCI_CONTEXT(Controller, Base, Index)   \
+    ((void*)((uint8_t*)(Base) + ((Controller)->ContextSize * (Index))))
+#define XHCI_INPUT_CONTEXT(Controller, Device, Index) \
+    XHCI_CONTEXT(Controller, (Device)->InputContext, (Index) + 1)
+
+/*******************************************************************************
+ * Controller Methods
+ *******************************************************************************/
+
+/* XhciAllocateMemory
+ * Allocates zeroed, uncached and physically contiguous memory that can be
+ * handed to the controller. */
+__EXTERN
+OsStatus_t
+XhciAllocateMemory(
+    _In_  XhciController_t*     Controller,
+    _In_  size_t                Length,
+    _Out_ void**                Memory,
+    _Out_ uintptr_t*            PhysicalAddress);
+
+/* XhciRestart
+ * Halts and resets the controller, then reinitializes all the memory
+ * structures and starts the controller again. */
+__EXTERN
+OsStatus_t
+XhciRestart(
+    _In_ XhciController_t*      Controller);
+
+/* XhciProcessEvents
+ * Consumes all the pending events on the event ring and dispatches them.
+ * Returns the number of events consumed. */
+__EXTERN
+int
+XhciProcessEvents(
+    _In_ XhciController_t*      Controller);
+
+/*******************************************************************************
+ * Ring Methods
+ *******************************************************************************/
+
+/* XhciRingInitialize
+ * Allocates the trb memory for a ring and installs the link trb */
+__EXTERN
+OsStatus_t
+XhciRingInitialize(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciRing_t*            Ring);
+
+/* XhciRingDestroy
+ * Releases the trb memory of a ring */
+__EXTERN
+void
+XhciRingDestroy(
+    _In_ XhciRing_t*            Ring);
+
+/* XhciRingReset
+ * Resets the software state of the ring and clears all trbs */
+__EXTERN
+void
+XhciRingReset(
+    _In_ XhciRing_t*            Ring);
+
+/* XhciRingSpace
+ * Returns the number of trbs that can be enqueued without overwriting
+ * trbs that are still owned by the controller. */
+__EXTERN
+size_t
+XhciRingSpace(
+    _In_ XhciRing_t*            Ring);
+
+/* XhciRingBegin
+ * Starts a new td, the first trb is held back from the controller
+ * until the td is committed. */
+__EXTERN
+void
+XhciRingBegin(
+    _In_ XhciRing_t*            Ring);
+
+/* XhciRingEnqueue
+ * Writes the next trb on the ring and handles wrapping through the link trb.
+ * Returns the index of the written trb. */
+__EXTERN
+size_t
+XhciRingEnqueue(
+    _In_ XhciRing_t*            Ring,
+    _In_ uint64_t               Parameter,
+    _In_ reg32_t                Status,
+    _In_ reg32_t                Control);
+
+/* XhciRingCommit
+ * Hands the td to the controller by releasing the first trb */
+__EXTERN
+void
+XhciRingCommit(
+    _In_ XhciRing_t*            Ring);
+
+/* XhciRingRetire
+ * Marks every trb up to and including <Index> as consumed */
+__EXTERN
+void
+XhciRingRetire(
+    _In_ XhciRing_t*            Ring,
+    _In_ size_t                 Index);
+
+/* XhciRingGetIndex
+ * Converts a trb physical address to an index in the ring, returns -1 if
+ * the address does not belong to the ring. */
+__EXTERN
+int
+XhciRingGetIndex(
+    _In_ XhciRing_t*            Ring,
+    _In_ uint64_t               Address);
+
+/* XhciRingGetDequeue
+ * Returns the physical address of the software dequeue pointer including
+ * the cycle state at that position, for Set TR Dequeue and contexts. */
+__EXTERN
+uint64_t
+XhciRingGetDequeue(
+    _In_ XhciRing_t*            Ring);
+
+/*******************************************************************************
+ * Command Methods
+ *******************************************************************************/
+
+/* XhciCommandQueue
+ * Queues a command on the command ring without waiting for it, the callback
+ * is invoked from the event handler upon completion. */
+__EXTERN
+OsStatus_t
+XhciCommandQueue(
+    _In_     XhciController_t*  Controller,
+    _In_     uint64_t           Parameter,
+    _In_     reg32_t            Status,
+    _In_     reg32_t            Control,
+    _In_Opt_ XhciCommandCallback Callback,
+    _In_Opt_ void*              Context);
+
+/* XhciCommandExecute
+ * Queues a command and waits for the completion event. Must not be called
+ * from the event handler. Returns the completion code, or 0 on timeout. */
+__EXTERN
+int
+XhciCommandExecute(
+    _In_      XhciController_t* Controller,
+    _In_      uint64_t          Parameter,
+    _In_      reg32_t           Status,
+    _In_      reg32_t           Control,
+    _Out_Opt_ int*              SlotId);
+
+/* XhciCommandComplete
+ * Handles a command completion event */
+__EXTERN
+void
+XhciCommandComplete(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciTrb_t*             Event);
+
+/*******************************************************************************
+ * Device Methods
+ *******************************************************************************/
+
+/* XhciDeviceGet
+ * Resolves the device slot for the given usb address. Transfers to address 0
+ * create a new slot for the root port the device is attached to. */
+__EXTERN
+XhciDevice_t*
+XhciDeviceGet(
+    _In_ XhciController_t*      Controller,
+    _In_ UsbTransfer_t*         Transfer);
+
+/* XhciDeviceSetAddress
+ * Completes the addressing of the slot, replacing the SET_ADDRESS request. */
+__EXTERN
+OsStatus_t
+XhciDeviceSetAddress(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Address);
+
+/* XhciDeviceUpdateControl
+ * Updates the max packet size of the control endpoint if it changed */
+__EXTERN
+OsStatus_t
+XhciDeviceUpdateControl(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ size_t                 MaxPacketSize);
+
+/* XhciDeviceConfigureEndpoint
+ * Adds the endpoint to the slot and allocates its ring(s) */
+__EXTERN
+OsStatus_t
+XhciDeviceConfigureEndpoint(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Dci,
+    _In_ UsbTransfer_t*         Transfer);
+
+/* XhciDeviceDestroy
+ * Disables the slot of a device and frees all memory of the device. */
+__EXTERN
+void
+XhciDeviceDestroy(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device,
+    _In_ int                    Synchronous);
+
+/*******************************************************************************
+ * Port Methods
+ *******************************************************************************/
+
+/* XhciPortScan
+ * Acknowledges port changes and notifies the usb-manager */
+__EXTERN
+void
+XhciPortScan(
+    _In_ XhciController_t*      Controller,
+    _In_ int                    Index);
+
+/*******************************************************************************
+ * Transfer Methods
+ *******************************************************************************/
+
+/* XhciGetEndpointIndex
+ * Retrieves the device context index of the transfer endpoint */
+__EXTERN
+int
+XhciGetEndpointIndex(
+    _In_ UsbTransfer_t*         Transfer);
+
+/* XhciTransferEvent
+ * Handles a transfer event, completing the td it belongs to */
+__EXTERN
+void
+XhciTransferEvent(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciTrb_t*             Event);
+
+/* XhciTransferAbortDevice
+ * Completes every transfer that targets the given device with an error */
+__EXTERN
+void
+XhciTransferAbortDevice(
+    _In_ XhciController_t*      Controller,
+    _In_ XhciDevice_t*          Device);
+
+#endif //!__USB_XHCI__
@@ -33,6 +33,21 @@
 InterruptStatus_t OnFastInterrupt(void *InterruptData);
 OsStatus_t AhciSetup(AhciController_t *Controller);
 
+/* AhciUnregisterInterrupt
+ * Releases the interrupt of the controller, whether it's message signaled or not */
+static void
+AhciUnregisterInterrupt(
+	_In_ AhciController_t*	Controller)
+{
+	if (Controller->MsiEnabled) {
+		UnregisterMsiInterrupts(&Controller->Device, &Controller->Interrupt, 1);
+		Controller->MsiEnabled = 0;
+	}
+	else {
+		UnregisterInterruptSource(Controller->Interrupt);
+	}
+}
+
 /* AhciControllerCreate
  * Registers a new controller with the AHCI driver */
 AhciController_t*
@@ -42,6 +57,7 @@ AhciControllerCreate(
 	// Variables
 	AhciController_t *Controller 	= NULL;
 	DeviceIoSpace_t *IoBase 		= NULL;
+	InterruptCoalescing_t Policy	= AHCI_COALESCING_POLICY;
 	int i;
 
 	// Allocate a new instance of the controller
@@ -49,6 +65,7 @@ AhciControllerCreate(
 	memset(Controller, 0, sizeof(AhciController_t));
 	memcpy(&Controller->Device, Device, Device->Length);
 	Controller->Contract.DeviceId = Controller->Device.Id;
+	Controller->Coalescing = Policy;
 	SpinlockReset(&Controller->Lock);
 
 	// Get I/O Base, and for AHCI there might be between 1-5
@@ -106,16 +123,23 @@ AhciControllerCreate(
 		return NULL;
 	}
 
-	// Register interrupt
-	Controller->Interrupt = 
-		RegisterInterruptSource(&Controller->Device.Interrupt, INTERRUPT_USERSPACE);
+	// Register interrupt, prefer a message signaled interrupt
+	// and fall back to the legacy line
+	if (RegisterMsiInterrupts(&Controller->Device, &Controller->Device.Interrupt,
+		1, INTERRUPT_USERSPACE, &Controller->Interrupt) == 1) {
+		Controller->MsiEnabled = 1;
+	}
+	else {
+		Controller->Interrupt = 
+			RegisterInterruptSource(&Controller->Device.Interrupt, INTERRUPT_USERSPACE);
+	}
 
 	// Enable device
 	if (IoctlDevice(Controller->Device.Id, __DEVICEMANAGER_IOCTL_BUS,
 		(__DEVICEMANAGER_IOCTL_ENABLE | __DEVICEMANAGER_IOCTL_MMIO_ENABLE
 			| __DEVICEMANAGER_IOCTL_BUSMASTER_ENABLE)) != OsSuccess) {
 		ERROR("Failed to enable the ahci-controller");
-		UnregisterInterruptSource(Controller->Interrupt);
+		AhciUnregisterInterrupt(Controller);
 		ReleaseIoSpace(Controller->IoBase);
 		DestroyIoSpace(Controller->IoBase->Id);
 		free(Controller);
@@ -169,7 +193,7 @@ AhciControllerDestroy(
 	}
 
 	// Unregister the interrupt
-	UnregisterInterruptSource(Controller->Interrupt);
+	AhciUnregisterInterrupt(Controller);
 
 	// Release the io-space
 	ReleaseIoSpace(Controller->IoBase);
@@ -288,6 +312,45 @@ AhciTakeOwnership(
 	}
 }
 
+/* AhciSetupCoalescing
+ * Enables command completion coalescing on all implemented ports if the
+ * controller supports it, otherwise every completion generates an interrupt */
+static void
+AhciSetupCoalescing(
+	_In_ AhciController_t*	Controller)
+{
+	// Variables
+	size_t Milliseconds	= Controller->Coalescing.TimeoutUs / 1000;
+	size_t Count		= Controller->Coalescing.Count;
+
+	Controller->CoalescedPorts = 0;
+	if (!(Controller->Registers->Capabilities & AHCI_CAPABILITIES_CCCS) || Count == 0) {
+		return;
+	}
+
+	// Sanitize the policy against the register limits
+	if (Milliseconds == 0) {
+		Milliseconds = 1;
+	}
+	if (Milliseconds > 0xFFFF) {
+		Milliseconds = 0xFFFF;
+	}
+	if (Count > 0xFF) {
+		Count = 0xFF;
+	}
+
+	// The parameters may only be changed while coalescing is disabled
+	Controller->Registers->CcControl &= ~(AHCI_CCC_EN);
+	MemoryBarrier();
+	Controller->CoalescingInterrupt  = AHCI_CCC_INT(Controller->Registers->CcControl);
+	Controller->Registers->CcPorts   = Controller->ValidPorts;
+	Controller->Registers->CcControl = AHCI_CCC_TV(Milliseconds) 
+		| AHCI_CCC_CC(Count) | AHCI_CCC_EN;
+	Controller->CoalescedPorts       = Controller->ValidPorts;
+	TRACE("Command completion coalescing enabled (Ports 0x%x, Interrupt %i)",
+		Controller->CoalescedPorts, Controller->CoalescingInterrupt);
+}
+
 /* AHCISetup
  * Initializes memory structures, ports and
  * resets the controller so it's ready for use */
@@ -426,6 +489,9 @@ AhciSetup(
 		Controller->FisBase, Controller->FisBasePhysical,
 		(AHCI_COMMAND_TABLE_SIZE * 32) * PortItr);
 
+	// Coalescing must be decided before the port interrupts are enabled
+	AhciSetupCoalescing(Controller);
+
 	// For each implemented port, system software shall allocate memory
 	for (i = 0; i < AHCI_MAX_PORTS; i++) {
 		if (Controller->Ports[i] != NULL) {
@@ -207,6 +207,18 @@ PACKED_ATYPESTRUCT(volatile, AHCIFis, {
  * - Generic Registers */
 #define AHCI_INTERRUPT_PORT(Port)           (1 << Port)
 
+/* Command Completion Coalescing Control (CcControl)
+ * - Generic Registers */
+#define AHCI_CCC_EN                         0x1             /* Enable */
+#define AHCI_CCC_INT(Control)               ((Control >> 3) & 0x1F)
+#define AHCI_CCC_CC(Count)                  ((Count & 0xFF) << 8)
+#define AHCI_CCC_TV(Milliseconds)           ((Milliseconds & 0xFFFF) << 16)
+
+/* Coalescing Policy
+ * Completions are coalesced until 8 are pending or 1ms has passed, and the
+ * driver keeps polling (up to 8 rounds) as long as 4 or more completes per round */
+#define AHCI_COALESCING_POLICY              INTERRUPT_COALESCING_INIT(8, 1000, 4, 8)
+
 /* Ports Implemented (PortsImplemented)
  * - Generic Registers */
 #define AHCI_IMPLEMENTED_PORT(Port)         (1 << Port)
@@ -353,9 +365,14 @@ typedef struct _AhciController {
     MCoreDevice_t           Device;
     MContract_t             Contract;
     UUId_t                  Interrupt;
+    int                     MsiEnabled;
     Spinlock_t              Lock;
     reg32_t                 InterruptStatus;
 
+    InterruptCoalescing_t   Coalescing;
+    reg32_t                 CoalescedPorts;
+    int                     CoalescingInterrupt;
+
     DeviceIoSpace_t*        IoBase;
     AHCIGenericRegisters_t* Registers;
 
@@ -463,8 +480,8 @@ AhciPortStartCommandSlot(
     _In_ int                Slot);
 
 /* AhciPortInterruptHandler
- * Handles port-specific interrupts. */
-__EXTERN void
+ * Handles port-specific interrupts. Returns the number of commands completed. */
+__EXTERN int
 AhciPortInterruptHandler(
     _In_ AhciController_t*  Controller, 
     _In_ AhciPort_t*        Port);
@@ -27,6 +27,7 @@
 #include <os/mollenos.h>
 #include <os/utils.h>
 #include "manager.h"
+#include <threads.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -42,6 +43,7 @@ OnFastInterrupt(
 {
 	AhciController_t *Controller;
 	reg32_t InterruptStatus;
+    reg32_t PortStatus;
     int i;
 
 	// Instantiate the pointer
@@ -51,9 +53,16 @@ OnFastInterrupt(
         return InterruptNotHandled;
     }
 
+    // The coalescing interrupt covers completions on all coalesced ports
+    PortStatus = InterruptStatus;
+    if (Controller->CoalescedPorts != 0
+        && (InterruptStatus & AHCI_INTERRUPT_PORT(Controller->CoalescingInterrupt))) {
+        PortStatus |= Controller->CoalescedPorts;
+    }
+
     // Save the status to port that made it and clear
     for (i = 0; i < AHCI_MAX_PORTS; i++) {
-		if (Controller->Ports[i] != NULL && ((InterruptStatus & (1 << i)) != 0)) {
+		if (Controller->Ports[i] != NULL && ((PortStatus & (1 << i)) != 0)) {
 			Controller->Ports[i]->InterruptStatus              |= Controller->Ports[i]->Registers->InterruptStatus;
 	        Controller->Ports[i]->Registers->InterruptStatus    = Controller->Ports[i]->Registers->InterruptStatus;
 		}
@@ -61,7 +70,7 @@ OnFastInterrupt(
 
 	// Write clear interrupt register and return
     Controller->Registers->InterruptStatus   = InterruptStatus;
-    Controller->InterruptStatus             |= InterruptStatus;
+    Controller->InterruptStatus             |= PortStatus;
 	return InterruptHandled;
 }
 
@@ -77,6 +86,8 @@ OnInterrupt(
 {
 	AhciController_t *Controller = NULL;
 	reg32_t InterruptStatus;
+    size_t Rounds;
+    int Completed;
     int i;
 
     // Unused
@@ -88,14 +99,29 @@ OnInterrupt(
 HandleInterrupt:
     InterruptStatus             = Controller->InterruptStatus;
     Controller->InterruptStatus = 0;
+    Completed                   = 0;
     
     // Iterate the port-map and check if the interrupt
 	// came from that port
 	for (i = 0; i < AHCI_MAX_PORTS; i++) {
 		if (Controller->Ports[i] != NULL && ((InterruptStatus & (1 << i)) != 0)) {
-			AhciPortInterruptHandler(Controller, Controller->Ports[i]);
+			Completed += AhciPortInterruptHandler(Controller, Controller->Ports[i]);
 		}
     }
+
+    // Under heavy load keep polling the ports for completions instead 
+    // of taking an interrupt for each batch, but only for a bounded time
+    for (Rounds = 0; Controller->Coalescing.PollThreshold != 0 
+        && (size_t)Completed >= Controller->Coalescing.PollThreshold
+        && Rounds < Controller->Coalescing.PollRounds; Rounds++) {
+        thrd_yield();
+        Completed = 0;
+        for (i = 0; i < AHCI_MAX_PORTS; i++) {
+            if (Controller->Ports[i] != NULL && Controller->Ports[i]->Connected) {
+                Completed += AhciPortInterruptHandler(Controller, Controller->Ports[i]);
+            }
+        }
+    }
     
     // Re-handle?
     if (Controller->InterruptStatus != 0) {
@@ -149,8 +149,15 @@ AhciPortInitialize(
     
     // Determine which events should cause an interrupt, 
     // and set each implemented ports PxIE register with the appropriate enables.
-    Port->Registers->InterruptEnable    = (uint32_t)AHCI_PORT_IE_CPDE | AHCI_PORT_IE_TFEE
-        | AHCI_PORT_IE_PCE | AHCI_PORT_IE_DSE | AHCI_PORT_IE_PSE | AHCI_PORT_IE_DHRE;
+    // Completions on coalesced ports are reported by the coalescing interrupt
+    if (Controller->CoalescedPorts & AHCI_INTERRUPT_PORT(Port->Index)) {
+        Port->Registers->InterruptEnable = (uint32_t)AHCI_PORT_IE_CPDE | AHCI_PORT_IE_TFEE
+            | AHCI_PORT_IE_PCE;
+    }
+    else {
+        Port->Registers->InterruptEnable = (uint32_t)AHCI_PORT_IE_CPDE | AHCI_PORT_IE_TFEE
+            | AHCI_PORT_IE_PCE | AHCI_PORT_IE_DSE | AHCI_PORT_IE_PSE | AHCI_PORT_IE_DHRE;
+    }
 }
 
 /* AhciPortCleanup
@@ -309,7 +316,7 @@ AhciPortStartCommandSlot(
 /* AhciPortInterruptHandler
  * Port specific interrupt handler 
  * handles interrupt for a specific port */
-void
+int
 AhciPortInterruptHandler(
     _In_ AhciController_t*  Controller, 
     _In_ AhciPort_t*        Port)
@@ -320,6 +327,7 @@ AhciPortInterruptHandler(
     reg32_t DoneCommands;
     CollectionItem_t *tNode;
     DataKey_t Key;
+    int Completed = 0;
     int i;
     
     // Check interrupt services 
@@ -387,6 +395,7 @@ HandleInterrupt:
 
                 // Take care of transaction
                 AhciCommandFinish(Transaction);
+                Completed++;
             }
         }
     }
@@ -395,4 +404,5 @@ HandleInterrupt:
     if (Port->InterruptStatus != 0) {
         goto HandleInterrupt;
     }
+    return Completed;
 }
@@ -32,13 +32,19 @@
  * function tables. */
 __EXTERN MsdOperations_t BulkOperations;
 __EXTERN MsdOperations_t UfiOperations;
+__EXTERN MsdOperations_t UasOperations;
 static MsdOperations_t *ProtocolOperations[ProtocolCount] = {
     NULL,
     &UfiOperations,
     &UfiOperations,
-    &BulkOperations
+    &BulkOperations,
+    &UasOperations
 };
 
+/* The number of commands that are handed to the protocol at once when
+ * a request spans multiple commands */
+#define MSD_COMMAND_BATCH       8
+
 /* Sense Key Descriptions
  * Provides descriptive information about the sense codes */
 const char* SenseKeys[] = {
@@ -128,64 +134,115 @@ MsdGetMaximumLunCount(
     return OsSuccess;
 }
 
-/* MsdScsiCommand
- * Perform an SCSI command of the type in. */
-UsbTransferStatus_t 
-MsdScsiCommand(
+/* MsdScsiCommandStaged
+ * Perform an SCSI command by running each stage after the other, used by
+ * the protocols that don't execute entire commands themselves. */
+static void
+MsdScsiCommandStaged(
     _In_ MsdDevice_t    *Device,
-    _In_ int             Direction,
-    _In_ uint8_t         ScsiCommand,
-    _In_ uint64_t        SectorStart,
-    _In_ uintptr_t       DataAddress,
-    _In_ size_t          DataLength)
+    _In_ MsdCommand_t   *Command)
 {
     // Variables
-    UsbTransferStatus_t Status  = { 0 };
-    size_t DataToTransfer       = DataLength;
+    uintptr_t DataAddress       = Command->DataAddress;
+    size_t DataToTransfer       = Command->DataLength;
     int RetryCount              = 3;
 
-    // Debug
-    TRACE("MsdScsiCommand(Direction %i, Command %u, Start %u, Length %u)",
-        Direction, ScsiCommand, LODWORD(SectorStart), DataLength);
-
-    // It is invalid to send zero length packets for bulk
-    if (Direction == 1 && DataLength == 0) {
-        ERROR("Cannot write data of length 0 to MSD devices.");
-        return TransferInvalid;
-    }
-
     // Send the command
-    Status = Device->Operations->SendCommand(Device, ScsiCommand, 
-        SectorStart, DataAddress, DataLength);
+    Command->Status = Device->Operations->SendCommand(Device, Command->ScsiCommand, 
+        Command->SectorStart, Command->DataAddress, Command->DataLength);
 
     // Sanitize for any transport errors
-    if (Status != TransferFinished) {
-        ERROR("Failed to send the CBW command, transfer-code %u", Status);
-        return Status;
+    if (Command->Status != TransferFinished) {
+        ERROR("Failed to send the CBW command, transfer-code %u", Command->Status);
+        return;
     }
 
     // Do the data stage (shared for all protocol)
     while (DataToTransfer != 0) {
         size_t BytesTransferred = 0;
-        if (Direction == 0) Status = Device->Operations->ReadData(Device, DataAddress, DataToTransfer, &BytesTransferred);
-        else                Status = Device->Operations->WriteData(Device, DataAddress, DataToTransfer, &BytesTransferred);
-        if (Status != TransferFinished && Status != TransferStalled) {
+        if (Command->Direction == 0) Command->Status = Device->Operations->ReadData(Device, DataAddress, DataToTransfer, &BytesTransferred);
+        else                         Command->Status = Device->Operations->WriteData(Device, DataAddress, DataToTransfer, &BytesTransferred);
+        if (Command->Status != TransferFinished && Command->Status != TransferStalled) {
             ERROR("Fatal error transfering data, skipping status stage");
-            return Status;
+            return;
         }
-        if (Status == TransferStalled) {
+        if (Command->Status == TransferStalled) {
             RetryCount--;
             if (RetryCount == 0) {
                 ERROR("Fatal error transfering data, skipping status stage");
-                return Status;
+                return;
             }
         }
         DataToTransfer -= BytesTransferred;
         DataAddress += BytesTransferred;
+        Command->BytesTransferred += BytesTransferred;
     }
 
     // Perform the status stage
-    return Device->Operations->GetStatus(Device);
+    Command->Status = Device->Operations->GetStatus(Device);
+}
+
+/* MsdScsiCommandExecute
+ * Executes a number of commands. Protocols that support it receive all the
+ * commands at once, so they can merge stages or keep commands in flight. */
+static void
+MsdScsiCommandExecute(
+    _In_ MsdDevice_t    *Device,
+    _In_ MsdCommand_t   *Commands,
+    _In_ size_t          Count)
+{
+    // Variables
+    size_t i;
+
+    for (i = 0; i < Count; i++) {
+        Commands[i].BytesTransferred    = 0;
+        Commands[i].Status              = TransferNotProcessed;
+    }
+
+    if (Device->Operations->ExecuteCommands != NULL) {
+        Device->Operations->ExecuteCommands(Device, Commands, Count);
+        return;
+    }
+
+    for (i = 0; i < Count; i++) {
+        MsdScsiCommandStaged(Device, &Commands[i]);
+        if (Commands[i].Status != TransferFinished) {
+            break;
+        }
+    }
+}
+
+/* MsdScsiCommand
+ * Perform an SCSI command of the type in. */
+UsbTransferStatus_t 
+MsdScsiCommand(
+    _In_ MsdDevice_t    *Device,
+    _In_ int             Direction,
+    _In_ uint8_t         ScsiCommand,
+    _In_ uint64_t        SectorStart,
+    _In_ uintptr_t       DataAddress,
+    _In_ size_t          DataLength)
+{
+    // Variables
+    MsdCommand_t Command;
+
+    // Debug
+    TRACE("MsdScsiCommand(Direction %i, Command %u, Start %u, Length %u)",
+        Direction, ScsiCommand, LODWORD(SectorStart), DataLength);
+
+    // It is invalid to send zero length packets for bulk
+    if (Direction == 1 && DataLength == 0) {
+        ERROR("Cannot write data of length 0 to MSD devices.");
+        return TransferInvalid;
+    }
+
+    Command.Direction   = Direction;
+    Command.ScsiCommand = ScsiCommand;
+    Command.SectorStart = SectorStart;
+    Command.DataAddress = DataAddress;
+    Command.DataLength  = DataLength;
+    MsdScsiCommandExecute(Device, &Command, 1);
+    return Command.Status;
 }
 
 /* MsdDevicePrepare
@@ -362,6 +419,79 @@ MsdDeviceStart(
     return MsdReadCapabilities(Device);
 }
 
+/* MsdTransferSectors
+ * Splits a sector request into as few commands as the command set allows
+ * and hands them to the protocol in batches. */
+static OsStatus_t
+MsdTransferSectors(
+    _In_  MsdDevice_t   *Device,
+    _In_  int            Direction,
+    _In_  uint64_t       SectorStart, 
+    _In_  uintptr_t      BufferAddress,
+    _In_  size_t         BufferLength,
+    _Out_ size_t        *BytesTransferred)
+{
+    // Variables
+    MsdCommand_t Commands[MSD_COMMAND_BATCH];
+    size_t SectorSize       = Device->Descriptor.SectorSize;
+    size_t MaxLength        = 0;
+    size_t Transferred      = 0;
+    OsStatus_t Status       = OsSuccess;
+    uint8_t ScsiCommand;
+
+    // The 10 byte commands carry a 16 bit sector count, the 16 byte ones
+    // are limited by the transfer length in the command block wrapper
+    if (Device->IsExtended == 0) {
+        ScsiCommand = (Direction == 0) ? SCSI_READ : SCSI_WRITE;
+        MaxLength   = 0xFFFF * SectorSize;
+    }
+    else {
+        ScsiCommand = (Direction == 0) ? SCSI_READ_16 : SCSI_WRITE_16;
+        MaxLength   = (0xFFFFFFFF / SectorSize) * SectorSize;
+    }
+    if (Device->MaxCommandLength != 0 && Device->MaxCommandLength < MaxLength) {
+        MaxLength   = (Device->MaxCommandLength / SectorSize) * SectorSize;
+    }
+
+    while (Status == OsSuccess && BufferLength != 0) {
+        size_t Count = 0;
+        size_t i;
+
+        // Build the next batch of commands
+        while (Count < MSD_COMMAND_BATCH && BufferLength != 0) {
+            size_t Length = MIN(BufferLength, MaxLength);
+            Commands[Count].Direction   = Direction;
+            Commands[Count].ScsiCommand = ScsiCommand;
+            Commands[Count].SectorStart = SectorStart;
+            Commands[Count].DataAddress = BufferAddress;
+            Commands[Count].DataLength  = Length;
+            SectorStart                += Length / SectorSize;
+            BufferAddress              += Length;
+            BufferLength               -= Length;
+            Count++;
+        }
+
+        // Stop at the first command that failed or came back short
+        MsdScsiCommandExecute(Device, &Commands[0], Count);
+        for (i = 0; i < Count; i++) {
+            if (Commands[i].Status != TransferFinished) {
+                Status = OsError;
+                break;
+            }
+            Transferred += Commands[i].BytesTransferred;
+            if (Commands[i].BytesTransferred != Commands[i].DataLength) {
+                BufferLength = 0;
+                break;
+            }
+        }
+    }
+
+    if (BytesTransferred != NULL) {
+        *BytesTransferred = (Status == OsSuccess) ? Transferred : 0;
+    }
+    return Status;
+}
+
 /* MsdReadSectors
  * Read a given amount of sectors (bytes/sector-size) from the MSD. */
 OsStatus_t
@@ -372,33 +502,11 @@ MsdReadSectors(
     _In_ size_t BufferLength,
     _Out_ size_t *BytesRead)
 {
-    // Variables
-    UsbTransferStatus_t Result;
-
     // Debug
     TRACE("MsdReadSectors(Sector %u, Length %u, Address 0x%x)",
         LODWORD(SectorStart), BufferLength, BufferAddress);
-
-    // Perform the read command
-    // @todo handle if num sectors > uint16_t when using SCSI_READ
-    Result = MsdScsiCommand(Device, 0, 
-        Device->IsExtended == 0 ? SCSI_READ : SCSI_READ_16,
-        SectorStart, BufferAddress, BufferLength);
-
-    // Sanitize result
-    if (Result != TransferFinished) {
-        if (BytesRead != NULL) {
-            *BytesRead = 0;
-        }
-        return OsError;
-    }
-    else {
-        // Calculate the number of bytes (not)transferred
-        if (BytesRead != NULL) {
-            *BytesRead = (BufferLength - Device->StatusBlock->DataResidue);
-        }
-        return OsSuccess;
-    }
+    return MsdTransferSectors(Device, 0, SectorStart, 
+        BufferAddress, BufferLength, BytesRead);
 }
 
 /* MsdWriteSectors
@@ -411,27 +519,9 @@ MsdWriteSectors(
     _In_ size_t BufferLength,
     _Out_ size_t *BytesWritten)
 {
-    // Variables
-    UsbTransferStatus_t Result;
-
-    // Perform the write command
-    // @todo handle if num sectors > uint16_t when using SCSI_WRITE
-    Result = MsdScsiCommand(Device, 1, 
-        Device->IsExtended == 0 ? SCSI_WRITE : SCSI_WRITE_16,
-        SectorStart, BufferAddress, BufferLength);
-
-    // Sanitize result
-    if (Result != TransferFinished) {
-        if (BytesWritten != NULL) {
-            *BytesWritten = 0;
-        }
-        return OsError;
-    }
-    else {
-        // Calculate the number of bytes (not)transferred
-        if (BytesWritten != NULL) {
-            *BytesWritten = (BufferLength - Device->StatusBlock->DataResidue);
-        }
-        return OsSuccess;
-    }
+    // Debug
+    TRACE("MsdWriteSectors(Sector %u, Length %u, Address 0x%x)",
+        LODWORD(SectorStart), BufferLength, BufferAddress);
+    return MsdTransferSectors(Device, 1, SectorStart, 
+        BufferAddress, BufferLength, BytesWritten);
 }
@@ -41,9 +41,62 @@ static const char *DeviceProtocolStrings[ProtocolCount] = {
     "Unknown",
     "CB",
     "CBI",
-    "Bulk"
+    "Bulk",
+    "UAS"
 };
 
+/* MsdDeviceFindUas
+ * Looks for an uas alternate setting on the interface. Its endpoints follow
+ * the ones of the preceeding settings, and it is only used when the data
+ * and status pipes support streams, otherwise bulk-only is used. */
+static void
+MsdDeviceFindUas(
+    _In_ MsdDevice_t *Device)
+{
+    // Variables
+    UsbHcInterface_t *Interface = &Device->Base.Interface;
+    UsbHcEndpointDescriptor_t *Pipes[5] = { NULL };
+    int EndpointIndex = 1;
+    int i, j;
+
+    for (i = 0; i < USB_MAX_VERSIONS; i++) {
+        if (EndpointIndex + Interface->Versions[i].EndpointCount > USB_MAX_ENDPOINTS) {
+            break;
+        }
+        if (Interface->Versions[i].Protocol == MSD_PROTOCOL_UAS
+            && Interface->Versions[i].EndpointCount >= 4) {
+            for (j = EndpointIndex; j < EndpointIndex + Interface->Versions[i].EndpointCount; j++) {
+                UsbHcEndpointDescriptor_t *Endpoint = &Device->Base.Endpoints[j];
+                if (Endpoint->Type == EndpointBulk && Endpoint->Pipe >= MSD_UAS_PIPE_COMMAND
+                    && Endpoint->Pipe <= MSD_UAS_PIPE_DATA_OUT) {
+                    Pipes[Endpoint->Pipe] = Endpoint;
+                }
+            }
+            break;
+        }
+        EndpointIndex += Interface->Versions[i].EndpointCount;
+    }
+
+    // All four pipes must be present, and streams are required for queueing
+    if (i == USB_MAX_VERSIONS || Pipes[MSD_UAS_PIPE_COMMAND] == NULL
+        || Pipes[MSD_UAS_PIPE_STATUS] == NULL || Pipes[MSD_UAS_PIPE_DATA_IN] == NULL
+        || Pipes[MSD_UAS_PIPE_DATA_OUT] == NULL) {
+        return;
+    }
+    if (Pipes[MSD_UAS_PIPE_STATUS]->MaxStreams < 2 || Pipes[MSD_UAS_PIPE_DATA_IN]->MaxStreams < 2
+        || Pipes[MSD_UAS_PIPE_DATA_OUT]->MaxStreams < 2) {
+        TRACE("UAS setting present, but streams are unavailable, using bulk-only");
+        return;
+    }
+
+    Device->Protocol    = ProtocolUAS;
+    Device->UasSetting  = Interface->Versions[i].Id;
+    Device->CommandPipe = Pipes[MSD_UAS_PIPE_COMMAND];
+    Device->StatusPipe  = Pipes[MSD_UAS_PIPE_STATUS];
+    Device->In          = Pipes[MSD_UAS_PIPE_DATA_IN];
+    Device->Out         = Pipes[MSD_UAS_PIPE_DATA_OUT];
+}
+
 /* MsdDeviceCreate
  * Initializes a new msd-device from the given usb-device */
 MsdDevice_t*
@@ -69,19 +122,20 @@ MsdDeviceCreate(
     Device = (MsdDevice_t*)malloc(sizeof(MsdDevice_t));
     memset(Device, 0, sizeof(MsdDevice_t));
     memcpy(&Device->Base, UsbDevice, sizeof(MCoreUsbDevice_t));
-    Device->Control = &UsbDevice->Endpoints[0];
+    Device->Control = &Device->Base.Endpoints[0];
 
-    // Find neccessary endpoints
+    // Find neccessary endpoints, point into our own copy as the
+    // given device only lives for the duration of the registration
     for (i = 1; i < UsbDevice->Interface.Versions[0].EndpointCount + 1; i++) {
         if (UsbDevice->Endpoints[i].Type == EndpointInterrupt) {
-            Device->Interrupt = &UsbDevice->Endpoints[i];
+            Device->Interrupt = &Device->Base.Endpoints[i];
         }
         else if (UsbDevice->Endpoints[i].Type == EndpointBulk) {
             if (UsbDevice->Endpoints[i].Direction == USB_ENDPOINT_IN) {
-                Device->In = &UsbDevice->Endpoints[i];
+                Device->In = &Device->Base.Endpoints[i];
             }
             else if (UsbDevice->Endpoints[i].Direction == USB_ENDPOINT_OUT) {
-                Device->Out = &UsbDevice->Endpoints[i];
+                Device->Out = &Device->Base.Endpoints[i];
             }
         }
     }
@@ -105,7 +159,10 @@ MsdDeviceCreate(
         Device->Type = TypeHardDrive;
     }
 
-    // Determine type of protocol
+    // Determine type of protocol, prefer uas when it is usable
+    if (UsbDevice->Interface.Subclass == MSD_SUBCLASS_SCSI) {
+        MsdDeviceFindUas(Device);
+    }
     if (Device->Protocol == ProtocolUnknown) {
         if (UsbDevice->Interface.Protocol == MSD_PROTOCOL_CBI) {
             Device->Protocol = ProtocolCBI;
@@ -181,6 +238,9 @@ OsStatus_t
 MsdDeviceDestroy(
     _In_ MsdDevice_t *Device)
 {
+    // Variables
+    int i;
+
     // Notify diskmanager
     if (UnregisterDisk(Device->Base.Base.Id, __DISK_FORCED_REMOVE) != OsSuccess) {
         ERROR("Failed to unregister storage with storagemanager");
@@ -189,6 +249,19 @@ MsdDeviceDestroy(
     // Flush existing requests?
     // @todo
 
+    // Stop the workers before the buffers they use go away
+    if (Device->Pool != NULL) {
+        ThreadPoolDestroy(Device->Pool);
+    }
+    for (i = 0; i < MSD_UAS_QUEUE_DEPTH; i++) {
+        if (Device->Slots[i].CommandUnit != NULL) {
+            BufferPoolFree(UsbRetrievePool(), (uintptr_t*)Device->Slots[i].CommandUnit);
+        }
+        if (Device->Slots[i].StatusUnit != NULL) {
+            BufferPoolFree(UsbRetrievePool(), (uintptr_t*)Device->Slots[i].StatusUnit);
+        }
+    }
+
     // Free reusable buffers
     if (Device->CommandBlock != NULL) {
         BufferPoolFree(UsbRetrievePool(), (uintptr_t*)Device->CommandBlock);
@@ -33,6 +33,7 @@
 #include <os/contracts/usbhost.h>
 #include <os/contracts/usbdevice.h>
 #include <os/contracts/storage.h>
+#include <os/threadpool.h>
 #include <os/file.h>
 
 /* MSD Subclass Definitions 
@@ -116,6 +117,66 @@ PACKED_TYPESTRUCT(MsdCommandStatus, {
 #define MSD_CSW_FAIL			        0x1
 #define MSD_CSW_PHASE_ERROR		        0x2
 
+/* UAS Pipe Usage Definitions
+ * Identifies the role of each endpoint in the uas alternate setting */
+#define MSD_UAS_PIPE_COMMAND            0x01
+#define MSD_UAS_PIPE_STATUS             0x02
+#define MSD_UAS_PIPE_DATA_IN            0x03
+#define MSD_UAS_PIPE_DATA_OUT           0x04
+
+/* UAS Information Unit Definitions
+ * The first byte of every information unit is the identifier */
+#define MSD_UAS_IU_COMMAND              0x01
+#define MSD_UAS_IU_SENSE                0x03
+#define MSD_UAS_IU_RESPONSE             0x04
+#define MSD_UAS_IU_TASK_MANAGEMENT      0x05
+#define MSD_UAS_IU_READ_READY           0x06
+#define MSD_UAS_IU_WRITE_READY          0x07
+
+/* UAS Queue Definitions
+ * Tags double as stream ids, so the queue depth is bounded by the number
+ * of streams the device supports. Stream 0 is reserved. */
+#define MSD_UAS_QUEUE_DEPTH             4
+#define MSD_UAS_STATUS_LENGTH           64
+#define MSD_UAS_COMMAND_LENGTH          0x10000
+
+/* MsdUasCommandIU
+ * Command information unit, carries a single scsi command block and is
+ * sent on the command pipe. Multi-byte fields are big-endian. */
+PACKED_TYPESTRUCT(MsdUasCommandIU, {
+    uint8_t                         Id;
+    uint8_t                         Reserved0;
+    uint8_t                         Tag[2];
+    uint8_t                         Attributes;     // Bits 0-2, 0 = Simple
+    uint8_t                         Reserved1;
+    uint8_t                         CdbLength;      // Additional cdb length, bits 2-7
+    uint8_t                         Reserved2;
+    uint8_t                         Lun[8];
+    uint8_t                         CommandBytes[16];
+});
+
+/* MsdUasStatusIU
+ * Sense and response information units are both received on the status
+ * pipe, they share the header and are told apart by the identifier. */
+PACKED_TYPESTRUCT(MsdUasStatusIU, {
+    uint8_t                         Id;
+    uint8_t                         Reserved0;
+    uint8_t                         Tag[2];
+    union {
+        struct {
+            uint8_t                 Qualifier[2];
+            uint8_t                 Status;
+            uint8_t                 Reserved1[7];
+            uint8_t                 Length[2];
+            uint8_t                 Data[MSD_UAS_STATUS_LENGTH - 16];
+        } Sense;
+        struct {
+            uint8_t                 Information[3];
+            uint8_t                 Code;
+        } Response;
+    } Data;
+});
+
 /* MsdDeviceType
  * The different types of usb msd devices. The most common
  * one being hard-drives */
@@ -134,12 +195,27 @@ typedef enum _MsdProtocolType {
     ProtocolCB,
 	ProtocolCBI,
 	ProtocolBulk,
+    ProtocolUAS,
     ProtocolCount
 } MsdProtocolType_t;
 
+/* MsdCommand
+ * Describes a single scsi command. Protocols that can merge or queue the
+ * stages of commands are handed several of these at once. */
+typedef struct _MsdCommand {
+    int                     Direction;  // 0 = In, 1 = Out
+    uint8_t                 ScsiCommand;
+    uint64_t                SectorStart;
+    uintptr_t               DataAddress;
+    size_t                  DataLength;
+    size_t                  BytesTransferred;
+    UsbTransferStatus_t     Status;
+} MsdCommand_t;
+
 /* MsdOperations
  * The different kinds of protocols require different kind
- * of ways to perform transfers */
+ * of ways to perform transfers. Protocols either implement the
+ * separate stages, or execute entire commands themselves. */
 typedef struct _MsdDevice MsdDevice_t;
 typedef struct _MsdOperations {
     OsStatus_t              (*Initialize)(_In_ MsdDevice_t *Device);
@@ -147,8 +223,32 @@ typedef struct _MsdOperations {
     UsbTransferStatus_t     (*ReadData)(_In_ MsdDevice_t *Device, _In_ uintptr_t DataAddress, _In_ size_t DataLength, _Out_ size_t *BytesRead);
     UsbTransferStatus_t     (*WriteData)(_In_ MsdDevice_t *Device, _In_ uintptr_t DataAddress, _In_ size_t DataLength, _Out_ size_t *BytesWritten);
     UsbTransferStatus_t     (*GetStatus)(_In_ MsdDevice_t *Device);
+    UsbTransferStatus_t     (*ExecuteCommands)(_In_ MsdDevice_t *Device, _In_ MsdCommand_t *Commands, _In_ size_t Count);
 } MsdOperations_t;
 
+/* MsdUasStage
+ * A status or data stage of a queued uas command. Stages are run by the
+ * device thread-pool as they block until the device serves their stream. */
+typedef struct _MsdUasStage {
+    MsdDevice_t            *Device;
+    UsbTransfer_t           Transfer;
+    UsbTransferResult_t     Result;
+    ThreadPoolFuture_t      Future;
+    int                     Armed;
+} MsdUasStage_t;
+
+/* MsdUasSlot
+ * Per-tag resources for uas, the slot index + 1 is the tag and stream id.
+ * Devices without streams use a single slot, and stream 0. */
+typedef struct _MsdUasSlot {
+    MsdUasCommandIU_t      *CommandUnit;
+    uintptr_t               CommandUnitAddress;
+    MsdUasStatusIU_t       *StatusUnit;
+    uintptr_t               StatusUnitAddress;
+    MsdUasStage_t           Status;
+    MsdUasStage_t           Data;
+} MsdUasSlot_t;
+
 /* MsdDevice
  * Represents a mass storage device. */
 typedef struct _MsdDevice {
@@ -162,6 +262,7 @@ typedef struct _MsdDevice {
 	int                          IsReady;
 	int                          IsExtended;
     int                          AlignedAccess;
+    size_t                       MaxCommandLength;  // 0 if unlimited
 
     // Reusable buffers
     MsdCommandBlock_t           *CommandBlock;
@@ -174,6 +275,15 @@ typedef struct _MsdDevice {
     UsbHcEndpointDescriptor_t   *In;
 	UsbHcEndpointDescriptor_t   *Out;
 	UsbHcEndpointDescriptor_t   *Interrupt;
+
+    // UAS Information, In/Out are the data pipes
+    int                          UasSetting;
+    UsbHcEndpointDescriptor_t   *CommandPipe;
+    UsbHcEndpointDescriptor_t   *StatusPipe;
+    ThreadPool_t                *Pool;
+    MsdUasSlot_t                 Slots[MSD_UAS_QUEUE_DEPTH];
+    size_t                       QueueDepth;
+    int                          UasStreams;        // 0 if the pipes have no streams
 } MsdDevice_t;
 
 /* MsdDeviceCreate
@@ -207,6 +317,18 @@ OsStatus_t
 MsdDeviceStart(
     _In_ MsdDevice_t *Device);
 
+/* BulkScsiCommandConstruct
+ * Constructs a new SCSI command structure from the information given. The
+ * command bytes are shared by all the transports. */
+__EXTERN
+void
+BulkScsiCommandConstruct(
+    _InOut_ MsdCommandBlock_t *CmdBlock,
+    _In_ uint8_t ScsiCommand,
+    _In_ uint64_t SectorLBA,
+    _In_ uint32_t DataLen,
+    _In_ uint16_t SectorSize);
+
 /* MsdReadSectors
  * Read a given amount of sectors (bytes/sector-size) from the MSD. */
 __EXTERN
@@ -597,6 +597,139 @@ BulkGetStatus(
     return Result.Status;
 }
 
+/* BulkExecuteCommand
+ * Executes a single command with its stages merged into as few transfers as
+ * possible. Reads queue the data and the CSW as one transfer on the in-pipe,
+ * and writes queue the CBW and the data as one transfer on the out-pipe, so
+ * each command takes two round-trips instead of three. */
+static void
+BulkExecuteCommand(
+    _In_ MsdDevice_t *Device,
+    _In_ MsdCommand_t *Command)
+{
+    // Variables
+    UsbTransferResult_t Result  = { 0 };
+    UsbTransfer_t Transfer      = { 0 };
+
+    // Debug
+    TRACE("BulkExecuteCommand(Command %u, Start %u, Length %u)",
+        Command->ScsiCommand, LODWORD(Command->SectorStart), Command->DataLength);
+
+    // Nothing to merge for commands without data
+    if (Command->DataLength == 0) {
+        Command->Status = BulkSendCommand(Device, Command->ScsiCommand, 
+            Command->SectorStart, Command->DataAddress, Command->DataLength);
+        if (Command->Status == TransferFinished) {
+            Command->Status = BulkGetStatus(Device);
+        }
+        return;
+    }
+    BulkScsiCommandConstruct(Device->CommandBlock, Command->ScsiCommand, Command->SectorStart, 
+        Command->DataLength, (uint16_t)Device->Descriptor.SectorSize);
+
+    if (Command->Direction == 1) {
+        // CBW and data in one transfer on the out-pipe
+        UsbTransferInitialize(&Transfer, &Device->Base.Device, 
+            Device->Out, BulkTransfer, 0);
+        UsbTransferOut(&Transfer, Device->CommandBlockAddress, 
+            sizeof(MsdCommandBlock_t), 0);
+        UsbTransferOut(&Transfer, Command->DataAddress, Command->DataLength, 0);
+        UsbTransferQueue(Device->Base.DriverId, Device->Base.DeviceId, 
+            &Transfer, &Result);
+        
+        // A stall during the data-stage means the device wants to skip to
+        // the status stage, a stall on the CBW itself needs the full recovery
+        if (Result.Status != TransferFinished) {
+            ERROR("Failed to write command and data, transfer-code %u", Result.Status);
+            if (Result.Status != TransferStalled || Result.BytesTransferred < sizeof(MsdCommandBlock_t)) {
+                BulkResetRecovery(Device, BULK_RESET_ALL);
+                Command->Status = Result.Status;
+                return;
+            }
+            BulkResetRecovery(Device, BULK_RESET_OUT);
+        }
+        Command->BytesTransferred = Result.BytesTransferred - sizeof(MsdCommandBlock_t);
+        Command->Status = BulkGetStatus(Device);
+        return;
+    }
+
+    // Reads send the CBW on its own, then the data and CSW in one transfer
+    UsbTransferInitialize(&Transfer, &Device->Base.Device, 
+        Device->Out, BulkTransfer, 0);
+    UsbTransferOut(&Transfer, Device->CommandBlockAddress, 
+        sizeof(MsdCommandBlock_t), 0);
+    UsbTransferQueue(Device->Base.DriverId, Device->Base.DeviceId, 
+        &Transfer, &Result);
+    if (Result.Status != TransferFinished) {
+        ERROR("Failed to send the CBW command, transfer-code %u", Result.Status);
+        if (Result.Status == TransferStalled) {
+            BulkResetRecovery(Device, BULK_RESET_ALL);
+        }
+        Command->Status = Result.Status;
+        return;
+    }
+
+    UsbTransferInitialize(&Transfer, &Device->Base.Device, 
+        Device->In, BulkTransfer, 0);
+    UsbTransferIn(&Transfer, Command->DataAddress, Command->DataLength, 0);
+    UsbTransferIn(&Transfer, Device->StatusBlockAddress, 
+        sizeof(MsdCommandStatus_t), 0);
+    UsbTransferQueue(Device->Base.DriverId, Device->Base.DeviceId, 
+        &Transfer, &Result);
+    
+    // On a stall during the data-stage, clear the in-pipe and read the CSW
+    if (Result.Status != TransferFinished) {
+        ERROR("Data-stage failed with status %u, cleaning up bulk-in", Result.Status);
+        if (Result.Status != TransferStalled) {
+            BulkResetRecovery(Device, BULK_RESET_ALL);
+            Command->Status = Result.Status;
+            return;
+        }
+        BulkResetRecovery(Device, BULK_RESET_IN);
+        Command->BytesTransferred = MIN(Result.BytesTransferred, Command->DataLength);
+        Command->Status = BulkGetStatus(Device);
+        return;
+    }
+
+    // A short packet ends the transfer before the CSW was read, in that
+    // case read it separately. Anything in between is a phase error
+    if (Result.BytesTransferred == Command->DataLength + sizeof(MsdCommandStatus_t)) {
+        Command->BytesTransferred = Command->DataLength;
+        Command->Status = MsdSanitizeResponse(Device, Device->StatusBlock);
+    }
+    else if (Result.BytesTransferred <= Command->DataLength) {
+        Command->BytesTransferred = Result.BytesTransferred;
+        Command->Status = BulkGetStatus(Device);
+    }
+    else {
+        ERROR("Data-stage returned %u bytes, expected %u", 
+            Result.BytesTransferred, Command->DataLength);
+        BulkResetRecovery(Device, BULK_RESET_ALL);
+        Command->Status = TransferInvalid;
+    }
+}
+
+/* BulkExecuteCommands
+ * Bulk-only devices only accept one command at the time, so the commands are
+ * executed in order and execution stops at the first failure. */
+UsbTransferStatus_t
+BulkExecuteCommands(
+    _In_ MsdDevice_t *Device,
+    _In_ MsdCommand_t *Commands,
+    _In_ size_t Count)
+{
+    // Variables
+    size_t i;
+
+    for (i = 0; i < Count; i++) {
+        BulkExecuteCommand(Device, &Commands[i]);
+        if (Commands[i].Status != TransferFinished) {
+            return Commands[i].Status;
+        }
+    }
+    return TransferFinished;
+}
+
 /* Global 
  * - Static function table */
 MsdOperations_t BulkOperations = {
@@ -604,5 +737,6 @@ MsdOperations_t BulkOperations = {
     BulkSendCommand,
     BulkReadData,
     BulkWriteData,
-    BulkGetStatus
+    BulkGetStatus,
+    BulkExecuteCommands
 };
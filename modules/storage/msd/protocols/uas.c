@@ -0,0 +1,456 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS MCore - Mass Storage Device Driver (Generic)
+ *  - USB Attached SCSI Protocol Implementation
+ */
+//#define __TRACE
+
+/* Includes
+ * - System */
+#include <os/utils.h>
+#include <os/usb.h>
+#include "../msd.h"
+
+/* Includes
+ * - Library */
+#include <threads.h>
+#include <string.h>
+
+/* Number of times the dequeue of a stage is retried while its worker has yet
+ * to hand the transfer to the host controller, one millisecond apart */
+#define UAS_ABORT_ATTEMPTS  100
+
+/* Externs
+ * - Shared with the rest of the driver */
+__EXTERN const char* SenseKeys[];
+
+/* UasStageWorker
+ * Runs a single status or data stage on a thread-pool worker. The transfer
+ * is held by the host until the device selects the stream of the stage. */
+static int
+UasStageWorker(
+    _In_ void *Argument)
+{
+    // Variables
+    MsdUasStage_t *Stage = (MsdUasStage_t*)Argument;
+
+    UsbTransferQueue(Stage->Device->Base.DriverId, Stage->Device->Base.DeviceId,
+        &Stage->Transfer, &Stage->Result);
+    return (int)Stage->Result.Status;
+}
+
+/* UasStageAbort
+ * Pulls an armed stage of a command from the host controller, and waits for its
+ * worker to return. If the transfer can't be dequeued the stage stays armed, and
+ * its tag is kept reserved. */
+static OsStatus_t
+UasStageAbort(
+    _In_ MsdDevice_t *Device,
+    _In_ MsdUasStage_t *Stage)
+{
+    // Variables
+    int Attempts = 0;
+
+    if (!Stage->Armed) {
+        return OsSuccess;
+    }
+
+    // The future is only bound to the pool once the stage has been queued
+    if (Stage->Future.Pool == NULL) {
+        Stage->Armed = 0;
+        return OsSuccess;
+    }
+
+    while (!ThreadPoolFutureIsComplete(&Stage->Future)) {
+        if (UsbTransferDequeue(Device->Base.DriverId, Device->Base.DeviceId,
+            &Stage->Transfer) == TransferFinished) {
+            break;
+        }
+        if (++Attempts == UAS_ABORT_ATTEMPTS) {
+            ERROR("Failed to dequeue uas stage on stream %u", Stage->Transfer.StreamId);
+            return OsError;
+        }
+        thrd_sleepex(1);
+    }
+    ThreadPoolFutureWait(&Stage->Future, NULL);
+    Stage->Armed = 0;
+    return OsSuccess;
+}
+
+/* UasSlotAbort
+ * Aborts both stages of a slot whose command never reached the device. */
+static void
+UasSlotAbort(
+    _In_ MsdDevice_t *Device,
+    _In_ size_t Index)
+{
+    UasStageAbort(Device, &Device->Slots[Index].Status);
+    UasStageAbort(Device, &Device->Slots[Index].Data);
+}
+
+/* UasClearPipe
+ * Clears a STALL condition on one of the pipes and resets its data toggles. */
+static OsStatus_t
+UasClearPipe(
+    _In_ MsdDevice_t *Device,
+    _In_ UsbHcEndpointDescriptor_t *Endpoint)
+{
+    if (UsbClearFeature(Device->Base.DriverId, Device->Base.DeviceId,
+        &Device->Base.Device, Device->Control, USBPACKET_DIRECTION_ENDPOINT,
+        Endpoint->Address, USB_FEATURE_HALT) != TransferFinished) {
+        ERROR("Failed to clear STALL on endpoint %u", Endpoint->Address);
+        return OsError;
+    }
+    return UsbEndpointReset(Device->Base.DriverId, Device->Base.DeviceId,
+        &Device->Base.Device, Endpoint);
+}
+
+/* UasInitialize
+ * Selects the uas alternate setting and allocates the per-tag resources. */
+OsStatus_t
+UasInitialize(
+    _In_ MsdDevice_t *Device)
+{
+    // Variables
+    size_t Streams;
+    size_t i;
+
+    // Sanitize found endpoints
+    if (Device->CommandPipe == NULL || Device->StatusPipe == NULL
+        || Device->In == NULL || Device->Out == NULL) {
+        ERROR("Not all uas pipes are available on device");
+        return OsError;
+    }
+
+    // Switch the interface to the uas setting, no endpoints of the
+    // default setting have been used yet
+    if (UsbExecutePacket(Device->Base.DriverId, Device->Base.DeviceId,
+        &Device->Base.Device, Device->Control,
+        USBPACKET_DIRECTION_OUT | USBPACKET_DIRECTION_INTERFACE,
+        USBPACKET_TYPE_SET_INTERFACE, 0, (uint8_t)(Device->UasSetting & 0xFF),
+        (uint16_t)Device->Base.Interface.Id, 0, NULL) != TransferFinished) {
+        ERROR("Failed to select the uas interface setting %i", Device->UasSetting);
+        return OsError;
+    }
+
+    // Tags are used as stream ids, stream 0 is reserved. Without streams
+    // only a single command can be outstanding
+    Streams = MIN(Device->StatusPipe->MaxStreams, Device->In->MaxStreams);
+    Streams = MIN(Streams, Device->Out->MaxStreams);
+    if (Streams < 2) {
+        Device->UasStreams      = 0;
+        Device->QueueDepth      = 1;
+    }
+    else {
+        Device->UasStreams      = 1;
+        Device->QueueDepth      = MIN(Streams - 1, MSD_UAS_QUEUE_DEPTH);
+    }
+    Device->MaxCommandLength    = MSD_UAS_COMMAND_LENGTH;
+
+    for (i = 0; i < Device->QueueDepth; i++) {
+        MsdUasSlot_t *Slot = &Device->Slots[i];
+        if (BufferPoolAllocate(UsbRetrievePool(), sizeof(MsdUasCommandIU_t),
+            (uintptr_t**)&Slot->CommandUnit, &Slot->CommandUnitAddress) != OsSuccess
+            || BufferPoolAllocate(UsbRetrievePool(), sizeof(MsdUasStatusIU_t),
+            (uintptr_t**)&Slot->StatusUnit, &Slot->StatusUnitAddress) != OsSuccess) {
+            ERROR("Failed to allocate buffers for uas tag %u", i + 1);
+            return OsError;
+        }
+        Slot->Status.Device = Device;
+        Slot->Data.Device   = Device;
+    }
+
+    // Every queued command may block two workers, one per stage
+    if (ThreadPoolInitialize((int)(Device->QueueDepth * 2), &Device->Pool) != OsSuccess) {
+        ERROR("Failed to create the uas thread-pool");
+        return OsError;
+    }
+    TRACE("UAS setting %i, queue depth %u, streams %i",
+        Device->UasSetting, Device->QueueDepth, Device->UasStreams);
+    return OsSuccess;
+}
+
+/* UasSlotPrepare
+ * Builds the command unit for the slot and prepares the status and data
+ * stages on the streams of the tag. Slots with stages from a command that
+ * never reached the device can't be reused until those complete. */
+static OsStatus_t
+UasSlotPrepare(
+    _In_    MsdDevice_t *Device,
+    _In_    size_t Index,
+    _In_    MsdCommand_t *Command,
+    _InOut_ ThreadPoolWorkItem_t *Items,
+    _InOut_ size_t *ItemCount)
+{
+    // Variables
+    MsdUasSlot_t *Slot          = &Device->Slots[Index];
+    uint16_t Tag                = (uint16_t)(Index + 1);
+    MsdCommandBlock_t Block;
+
+    if ((Slot->Status.Armed && !ThreadPoolFutureIsComplete(&Slot->Status.Future))
+        || (Slot->Data.Armed && !ThreadPoolFutureIsComplete(&Slot->Data.Future))) {
+        ERROR("UAS tag %u is still outstanding", Tag);
+        return OsError;
+    }
+
+    // The cdb is shared with the bulk-only transport
+    BulkScsiCommandConstruct(&Block, Command->ScsiCommand, Command->SectorStart,
+        Command->DataLength, (uint16_t)Device->Descriptor.SectorSize);
+    memset((void*)Slot->CommandUnit, 0, sizeof(MsdUasCommandIU_t));
+    Slot->CommandUnit->Id       = MSD_UAS_IU_COMMAND;
+    Slot->CommandUnit->Tag[0]   = (uint8_t)((Tag >> 8) & 0xFF);
+    Slot->CommandUnit->Tag[1]   = (uint8_t)(Tag & 0xFF);
+    memcpy(&Slot->CommandUnit->CommandBytes[0], &Block.CommandBytes[0], 16);
+    memset((void*)Slot->StatusUnit, 0, sizeof(MsdUasStatusIU_t));
+
+    UsbTransferInitialize(&Slot->Status.Transfer, &Device->Base.Device,
+        Device->StatusPipe, BulkTransfer, 0);
+    UsbTransferIn(&Slot->Status.Transfer, Slot->StatusUnitAddress,
+        sizeof(MsdUasStatusIU_t), 0);
+    Slot->Status.Transfer.StreamId = Device->UasStreams ? Tag : 0;
+    Slot->Status.Armed = 1;
+    ThreadPoolFutureInitialize(&Slot->Status.Future);
+    Items[*ItemCount].Function  = UasStageWorker;
+    Items[*ItemCount].Argument  = &Slot->Status;
+    Items[*ItemCount].Future    = &Slot->Status.Future;
+    (*ItemCount)++;
+
+    if (Command->DataLength != 0) {
+        UsbTransferInitialize(&Slot->Data.Transfer, &Device->Base.Device,
+            (Command->Direction == 0) ? Device->In : Device->Out, BulkTransfer, 0);
+        if (Command->Direction == 0) {
+            UsbTransferIn(&Slot->Data.Transfer, Command->DataAddress, Command->DataLength, 0);
+        }
+        else {
+            UsbTransferOut(&Slot->Data.Transfer, Command->DataAddress, Command->DataLength, 0);
+        }
+        Slot->Data.Transfer.StreamId = Device->UasStreams ? Tag : 0;
+        Slot->Data.Armed = 1;
+        ThreadPoolFutureInitialize(&Slot->Data.Future);
+        Items[*ItemCount].Function  = UasStageWorker;
+        Items[*ItemCount].Argument  = &Slot->Data;
+        Items[*ItemCount].Future    = &Slot->Data.Future;
+        (*ItemCount)++;
+    }
+    return OsSuccess;
+}
+
+/* UasSendCommand
+ * Sends the command unit of a slot on the command pipe. */
+static UsbTransferStatus_t
+UasSendCommand(
+    _In_ MsdDevice_t *Device,
+    _In_ MsdUasSlot_t *Slot)
+{
+    // Variables
+    UsbTransferResult_t Result  = { 0 };
+    UsbTransfer_t CommandStage  = { 0 };
+
+    UsbTransferInitialize(&CommandStage, &Device->Base.Device,
+        Device->CommandPipe, BulkTransfer, 0);
+    UsbTransferOut(&CommandStage, Slot->CommandUnitAddress,
+        sizeof(MsdUasCommandIU_t), 0);
+    UsbTransferQueue(Device->Base.DriverId, Device->Base.DeviceId,
+        &CommandStage, &Result);
+    if (Result.Status == TransferStalled) {
+        UasClearPipe(Device, Device->CommandPipe);
+    }
+    return Result.Status;
+}
+
+/* UasSlotEvaluate
+ * Evaluates the result of the status stage and the status unit it received. */
+static UsbTransferStatus_t
+UasSlotEvaluate(
+    _In_ MsdDevice_t *Device,
+    _In_ MsdUasSlot_t *Slot,
+    _In_ uint16_t Tag)
+{
+    // Variables
+    MsdUasStatusIU_t *Unit = Slot->StatusUnit;
+
+    if (Slot->Status.Result.Status != TransferFinished) {
+        ERROR("UAS tag %u status-stage failed, transfer-code %u",
+            Tag, Slot->Status.Result.Status);
+        if (Slot->Status.Result.Status == TransferStalled) {
+            UasClearPipe(Device, Device->StatusPipe);
+        }
+        return Slot->Status.Result.Status;
+    }
+
+    if ((((uint16_t)Unit->Tag[0] << 8) | Unit->Tag[1]) != Tag) {
+        ERROR("UAS status unit has tag %u, expected %u",
+            ((uint16_t)Unit->Tag[0] << 8) | Unit->Tag[1], Tag);
+        return TransferInvalid;
+    }
+
+    if (Unit->Id == MSD_UAS_IU_SENSE) {
+        if (Unit->Data.Sense.Status != 0) {
+            if ((((uint16_t)Unit->Data.Sense.Length[0] << 8) | Unit->Data.Sense.Length[1]) > 2) {
+                ERROR("UAS command failed: %s",
+                    SenseKeys[Unit->Data.Sense.Data[2] & 0xF]);
+            }
+            else {
+                ERROR("UAS command failed with status 0x%x", Unit->Data.Sense.Status);
+            }
+            return TransferInvalid;
+        }
+        return TransferFinished;
+    }
+    ERROR("UAS command was rejected, unit 0x%x (code 0x%x)",
+        Unit->Id, Unit->Data.Response.Code);
+    return TransferInvalid;
+}
+
+/* UasSlotComplete
+ * Waits for the status unit of a sent command, which ends the command. A
+ * failed command can end before its data stage ever sees data, the data
+ * stage is then pulled from the host so the slot can be reused. */
+static void
+UasSlotComplete(
+    _In_ MsdDevice_t *Device,
+    _In_ size_t Index,
+    _In_ MsdCommand_t *Command)
+{
+    // Variables
+    MsdUasSlot_t *Slot          = &Device->Slots[Index];
+    MsdUasStatusIU_t *Unit      = Slot->StatusUnit;
+    uint16_t Tag                = (uint16_t)(Index + 1);
+    int Rearms;
+
+    ThreadPoolFutureWait(&Slot->Status.Future, NULL);
+
+    // Without streams the device announces the data phase on the status
+    // pipe first, the sense unit follows once the data has moved
+    for (Rearms = 0; !Device->UasStreams && Rearms < 2
+        && Slot->Status.Result.Status == TransferFinished
+        && (Unit->Id == MSD_UAS_IU_READ_READY || Unit->Id == MSD_UAS_IU_WRITE_READY); Rearms++) {
+        memset((void*)Unit, 0, sizeof(MsdUasStatusIU_t));
+        ThreadPoolFutureInitialize(&Slot->Status.Future);
+        if (ThreadPoolAddWorkEx(Device->Pool, UasStageWorker,
+            &Slot->Status, &Slot->Status.Future) != OsSuccess) {
+            ERROR("Failed to queue the uas status stage");
+            Slot->Status.Result.Status = TransferInvalid;
+            break;
+        }
+        ThreadPoolFutureWait(&Slot->Status.Future, NULL);
+    }
+    Slot->Status.Armed  = 0;
+    Command->Status     = UasSlotEvaluate(Device, Slot, Tag);
+
+    if (Slot->Data.Armed) {
+        if (Command->Status != TransferFinished 
+            && !ThreadPoolFutureIsComplete(&Slot->Data.Future)) {
+            if (UasStageAbort(Device, &Slot->Data) != OsSuccess) {
+                return;
+            }
+        }
+        else {
+            ThreadPoolFutureWait(&Slot->Data.Future, NULL);
+            Slot->Data.Armed = 0;
+        }
+        Command->BytesTransferred = Slot->Data.Result.BytesTransferred;
+        if (Slot->Data.Result.Status == TransferStalled) {
+            UasClearPipe(Device, (Command->Direction == 0) ? Device->In : Device->Out);
+        }
+        if (Command->Status == TransferFinished) {
+            Command->Status = Slot->Data.Result.Status;
+        }
+    }
+}
+
+/* UasExecuteCommands
+ * Queues up to the queue depth of commands at once. The status and data
+ * stages are armed on their streams first, then all the command units are
+ * sent, so the device is free to serve the commands in any order. */
+UsbTransferStatus_t
+UasExecuteCommands(
+    _In_ MsdDevice_t *Device,
+    _In_ MsdCommand_t *Commands,
+    _In_ size_t Count)
+{
+    // Variables
+    ThreadPoolWorkItem_t Items[MSD_UAS_QUEUE_DEPTH * 2];
+    size_t Index = 0;
+
+    while (Index < Count) {
+        size_t Batch        = MIN(Device->QueueDepth, Count - Index);
+        size_t ItemCount    = 0;
+        size_t Prepared     = 0;
+        size_t Sent         = 0;
+        size_t i;
+
+        for (; Prepared < Batch; Prepared++) {
+            if (UasSlotPrepare(Device, Prepared, &Commands[Index + Prepared],
+                    &Items[0], &ItemCount) != OsSuccess) {
+                Commands[Index + Prepared].Status = TransferInvalid;
+                break;
+            }
+        }
+        if (ItemCount != 0 && ThreadPoolAddWorkBatch(Device->Pool,
+                &Items[0], ItemCount) != OsSuccess) {
+            ERROR("Failed to queue the uas stages");
+            for (i = 0; i < Prepared; i++) {
+                UasSlotAbort(Device, i);
+                Commands[Index + i].Status = TransferInvalid;
+            }
+            return TransferInvalid;
+        }
+
+        for (; Sent < Prepared; Sent++) {
+            UsbTransferStatus_t Status = UasSendCommand(Device, &Device->Slots[Sent]);
+            if (Status != TransferFinished) {
+                ERROR("Failed to send uas command unit, transfer-code %u", Status);
+                Commands[Index + Sent].Status = Status;
+                break;
+            }
+        }
+
+        // Stages of commands that never reached the device would wait
+        // forever, pull them from the host to release their tags
+        for (i = Sent; i < Prepared; i++) {
+            UasSlotAbort(Device, i);
+            if (i != Sent) {
+                Commands[Index + i].Status = TransferNotProcessed;
+            }
+        }
+
+        for (i = 0; i < Sent; i++) {
+            UasSlotComplete(Device, i, &Commands[Index + i]);
+        }
+        for (i = 0; i < Batch; i++) {
+            if (Commands[Index + i].Status != TransferFinished) {
+                return Commands[Index + i].Status;
+            }
+        }
+        Index += Batch;
+    }
+    return TransferFinished;
+}
+
+/* Global
+ * - Static function table */
+MsdOperations_t UasOperations = {
+    UasInitialize,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    UasExecuteCommands
+};
@@ -251,5 +251,6 @@ MsdOperations_t UfiOperations = {
     UfiSendCommand,
     UfiReadData,
     UfiWriteData,
-    UfiGetStatus
+    UfiGetStatus,
+    NULL
 };
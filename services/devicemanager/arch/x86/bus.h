@@ -81,6 +81,12 @@
 #define PCI_COMMAND_FASTBTB             0x200
 #define PCI_COMMAND_INTDISABLE          0x400
 
+/* The status bit that indicates a capability list is present
+ * and the capability ids the device-manager looks for */
+#define PCI_STATUS_CAPABILITIES         0x10
+#define PCI_CAPABILITY_MSI              0x05
+#define PCI_CAPABILITY_MSIX             0x11
+
 /* The PCI base entry on the pci-databus
  * It describes a device on the pci-bus, the resources
  * its command register, status and its system bars */
@@ -115,6 +115,7 @@ PciReadBars(
         uint32_t Space32, Size32, Mask32;
         uint64_t Space64, Size64, Mask64;
         size_t Offset = 0x10 + (i << 2);
+        int Index;
 
         // Calculate the initial mask 
         Mask32 = (HeaderType & 0x1) == 0x1 ? ~0x7FF : 0xFFFFFFFF;
@@ -154,8 +155,9 @@ PciReadBars(
             Size64  = Size32 & 0xFFFFFFF0;
             Mask64  = 0xFFFFFFFFFFFFFFF0;
             
-            // Calculate a new 64 bit offset
-            i++;
+            // Calculate a new 64 bit offset, the io-space is
+            // registered at the index of the lower bar
+            Index = i++;
             Offset = 0x10 + (i << 2);
 
             // Read both space and size for 64 bit
@@ -175,7 +177,7 @@ PciReadBars(
             // Correct the size and validate
             Size64 = PciValidateBarSize(Space64, Size64, Mask64);
             if (Space64 != 0 && Size64 != 0) {
-                PciSetIoSpace(Device, i, IO_SPACE_MMIO, (uintptr_t)Space64, (size_t)Size64);
+                PciSetIoSpace(Device, Index, IO_SPACE_MMIO, (uintptr_t)Space64, (size_t)Size64);
             }
         }
         else {
@@ -192,6 +194,49 @@ PciReadBars(
     }
 }
 
+/* PciReadCapabilities
+ * Walks the capability list of the pci-device and records the message signaled
+ * interrupt support. MSI-X is preferred over MSI when both are present. */
+void
+PciReadCapabilities(
+    _In_ PciBus_t*      Bus,
+    _In_ MCoreDevice_t* Device)
+{
+    // Variables
+    uint16_t Status = PciRead16(Bus, Device->Bus, Device->Slot, Device->Function, 0x06);
+    uint8_t Pointer;
+    int Guard = 48;
+
+    Device->Msi.Type = __DEVICEMANAGER_MSI_NONE;
+    if (!(Status & PCI_STATUS_CAPABILITIES)) {
+        return;
+    }
+
+    Pointer = PciRead8(Bus, Device->Bus, Device->Slot, Device->Function, 0x34) & 0xFC;
+    while (Pointer >= 0x40 && Guard--) {
+        uint8_t Id          = PciRead8(Bus, Device->Bus, Device->Slot, Device->Function, Pointer);
+        uint16_t Control    = PciRead16(Bus, Device->Bus, Device->Slot, Device->Function, Pointer + 2);
+
+        if (Id == PCI_CAPABILITY_MSIX) {
+            uint32_t Table = PciRead32(Bus, Device->Bus, Device->Slot, Device->Function, Pointer + 4);
+            Device->Msi.Type        = __DEVICEMANAGER_MSIX;
+            Device->Msi.Capability  = Pointer;
+            Device->Msi.Vectors     = (Control & 0x7FF) + 1;
+            Device->Msi.Is64Bit     = 1;
+            Device->Msi.TableBar    = Table & 0x7;
+            Device->Msi.TableOffset = Table & ~(0x7);
+            break;
+        }
+        else if (Id == PCI_CAPABILITY_MSI && Device->Msi.Type == __DEVICEMANAGER_MSI_NONE) {
+            Device->Msi.Type        = __DEVICEMANAGER_MSI;
+            Device->Msi.Capability  = Pointer;
+            Device->Msi.Vectors     = 1 << ((Control >> 1) & 0x7);
+            Device->Msi.Is64Bit     = (Control & 0x80) ? 1 : 0;
+        }
+        Pointer = PciRead8(Bus, Device->Bus, Device->Slot, Device->Function, Pointer + 1) & 0xFC;
+    }
+}
+
 /* PciDerivePin
  * Pin conversion from behind a bridge */
 int PciDerivePin(int Device, int Pin) {
@@ -409,6 +454,7 @@ PciCreateDeviceFromPci(
 
     // Handle bars attached to device
     PciReadBars(PciDevice->BusIo, &Device, PciDevice->Header->HeaderType);
+    PciReadCapabilities(PciDevice->BusIo, &Device);
 
     // PCI - IDE Bar Fixup
     // From experience ide-bars don't always show up (ex: Oracle VM)
@@ -435,7 +481,7 @@ PciCreateDeviceFromPci(
     }
     return DmRegisterDevice(UUID_INVALID, &Device, PciToString(PciDevice->Header->Class,
         PciDevice->Header->Subclass, PciDevice->Header->Interface),
-        __DEVICEMANAGER_REGISTER_LOADDRIVER, &Device.Id);
+        __DEVICEMANAGER_REGISTER_LOADDRIVER | __DEVICEMANAGER_REGISTER_DEFERRED, &Device.Id);
 }
 
 /* PciInstallDriverCallback
@@ -460,6 +506,67 @@ PciInstallDriverCallback(
     }
 }
 
+/* PciEnumerateRoot
+ * Enumerates the buses behind the root complex, buses behind bridges are
+ * enumerated by following the bridges. */
+void
+PciEnumerateRoot(
+    _In_ PciBus_t*      Bus)
+{
+    // Variables
+    int Function;
+
+    // We can check whether or not it's a multi-function
+    // root-bridge, in that case there are multiple buses
+    if (!(PciReadHeaderType(Bus, Bus->BusStart, 0, 0) & 0x80)) {
+        PciCheckBus(__GlbRoot, Bus->BusStart);
+    }
+    else {
+        for (Function = 0; Function < 8; Function++) {
+            if (PciReadVendorId(Bus, Bus->BusStart, 0, Function) == 0xFFFF) {
+                break;
+            }
+            PciCheckBus(__GlbRoot, Bus->BusStart + Function);
+        }
+    }
+}
+
+/* PciCreateEcamBus
+ * Maps the configuration space of a pci-express segment, returns NULL if
+ * the segment could not be mapped and port io must be used instead. */
+PciBus_t*
+PciCreateEcamBus(
+    _In_ McfgEntry_t*   Entry)
+{
+    // Variables
+    PciBus_t *Bus = NULL;
+
+    // 32 bit can't map configuration space above 4gb
+    if (Entry->EndBus < Entry->StartBus
+        || (sizeof(uintptr_t) < 8 && Entry->BaseAddress > SIZE_MAX)) {
+        return NULL;
+    }
+
+    Bus = (PciBus_t*)malloc(sizeof(PciBus_t));
+    memset(Bus, 0, sizeof(PciBus_t));
+
+    // Each bus has 1mb of configuration space, only map the decoded range
+    Bus->IoSpace.Type           = IO_SPACE_MMIO;
+    Bus->IoSpace.PhysicalBase   = (uintptr_t)(Entry->BaseAddress + ((uint64_t)Entry->StartBus << 20));
+    Bus->IoSpace.Size           = (size_t)(Entry->EndBus - Entry->StartBus + 1) << 20;
+    Bus->IsExtended             = 1;
+    Bus->BusStart               = Entry->StartBus;
+    Bus->BusEnd                 = Entry->EndBus;
+    Bus->Segment                = Entry->SegmentGroup;
+    if (CreateIoSpace(&Bus->IoSpace) != OsSuccess
+        || AcquireIoSpace(&Bus->IoSpace) != OsSuccess) {
+        WARNING("Failed to map ecam for segment %u", Entry->SegmentGroup);
+        free(Bus);
+        return NULL;
+    }
+    return Bus;
+}
+
 /* BusInstallFixed
  * Loads a fixed driver for the vendorid/deviceid */
 OsStatus_t
@@ -484,7 +591,8 @@ BusInstallFixed(
     Device.Interrupt.Line           = INTERRUPT_NONE;
     Device.Interrupt.Vectors[0]     = INTERRUPT_NONE;
     Device.Interrupt.AcpiConform    = 0;
-    return DmRegisterDevice(UUID_INVALID, &Device, Name,  __DEVICEMANAGER_REGISTER_LOADDRIVER, &Device.Id);
+    return DmRegisterDevice(UUID_INVALID, &Device, Name,  
+        __DEVICEMANAGER_REGISTER_LOADDRIVER | __DEVICEMANAGER_REGISTER_DEFERRED, &Device.Id);
 }
 
 /* BusEnumerate
@@ -497,7 +605,7 @@ BusEnumerate(void)
     ACPI_TABLE_MCFG *McfgTable  = NULL;
     ACPI_TABLE_HEADER *Header   = NULL;
     AcpiDescriptor_t Acpi       = { 0 };
-    int Function;
+    int Enumerated              = 0;
 
     // Initialize the root bridge element
     __GlbRoot = (PciDevice_t*)malloc(sizeof(PciDevice_t));
@@ -519,9 +627,7 @@ BusEnumerate(void)
         // Uh, even better, do we have PCI-e controllers?
         if (AcpiQueryTable(ACPI_SIG_MCFG, &Header) == OsSuccess) {
             TRACE("PCI-Express Controller (mcfg length 0x%x)", Header->Length);
-            //McfgTable = (ACPI_TABLE_MCFG*)Header;
-            //remember to free(McfgTable)
-            free(Header);
+            McfgTable = (ACPI_TABLE_MCFG*)Header;
         }
 
         // Check for PS2 controller presence
@@ -535,36 +641,28 @@ BusEnumerate(void)
         BusInstallFixed(PCI_PS2_DEVICEID, "PS/2 Controller");
     }
 
-    // If the mcfg table is present we have pci-e controllers onboard.
+    // If the mcfg table is present we have pci-e controllers onboard, 
+    // use the memory mapped configuration space for all of them
     if (McfgTable != NULL) {
         McfgEntry_t *Entry  = (McfgEntry_t*)((uint8_t*)McfgTable + sizeof(ACPI_TABLE_MCFG));
-        int EntryCount      = (McfgTable->Header.Length - sizeof(ACPI_TABLE_MCFG) / sizeof(McfgEntry_t));
+        int EntryCount      = (int)((McfgTable->Header.Length - sizeof(ACPI_TABLE_MCFG)) / sizeof(McfgEntry_t));
         int i;
 
-        for (i = 0; i < EntryCount; i++) {
-            PciBus_t *Bus = (PciBus_t*)malloc(sizeof(PciBus_t));
-            memset(Bus, 0, sizeof(PciBus_t));
-
-            Bus->IoSpace.Type           = IO_SPACE_MMIO;
-            Bus->IoSpace.PhysicalBase   = (uintptr_t)Entry->BaseAddress;
-            Bus->IoSpace.Size           = (1024 * 1024 * 256);
-
-            // PCIe memory spaces spand up to 256 mb
-            Bus->IsExtended     = 1;
-            Bus->BusStart       = Entry->StartBus;
-            Bus->BusEnd         = Entry->EndBus;
-            Bus->Segment        = Entry->SegmentGroup;
-            __GlbRoot->BusIo    = Bus;
-
-            for (Function = Bus->BusStart; Function <= Bus->BusEnd; Function++) {
-                PciCheckBus(__GlbRoot, Function);
+        for (i = 0; i < EntryCount; i++, Entry++) {
+            PciBus_t *Bus = PciCreateEcamBus(Entry);
+            if (Bus != NULL) {
+                TRACE("Using ecam for segment %u, buses %u-%u", 
+                    Entry->SegmentGroup, Entry->StartBus, Entry->EndBus);
+                __GlbRoot->BusIo = Bus;
+                PciEnumerateRoot(Bus);
+                Enumerated = 1;
             }
-            Entry++;
         }
         free(McfgTable);
     }
-    else {
-        // Otherwise we have traditional PCI buses
+
+    // Otherwise we have traditional PCI buses
+    if (!Enumerated) {
         PciBus_t *Bus = (PciBus_t*)malloc(sizeof(PciBus_t));
         memset(Bus, 0, sizeof(PciBus_t));
 
@@ -581,25 +679,14 @@ BusEnumerate(void)
             ERROR("Failed to initialize bus io");
             for (;;);
         }
-        
-        // We can check whether or not it's a multi-function
-        // root-bridge, in that case there are multiple buses
-        if (!(PciReadHeaderType(Bus, 0, 0, 0) & 0x80)) {
-            PciCheckBus(__GlbRoot, 0);
-        }
-        else {
-            for (Function = 0; Function < 8; Function++) {
-                if (PciReadVendorId(Bus, 0, 0, Function) != 0xFFFF)
-                    break;
-                PciCheckBus(__GlbRoot, Function);
-            }
-        }
+        PciEnumerateRoot(Bus);
     }
 
-    // Now, that the bus is enumerated, we can
-    // iterate the found devices and load drivers
+    // Now, that the bus is enumerated, we can register the found 
+    // devices and queue their drivers, the queued drivers are then
+    // loaded together so independent controllers come up in parallel
     CollectionExecuteAll(__GlbRoot->Children, PciInstallDriverCallback, NULL);
-    return OsSuccess;
+    return DmStartDriverInstalls();
 }
 
 /* DmIoctlDevice
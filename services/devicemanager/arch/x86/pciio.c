@@ -35,7 +35,8 @@ PciCalculateOffset(
 	_In_ size_t 	Register)
 {
 	if (Io->IsExtended) {
-		return (size_t)((Bus << 20) | (Device << 15) | (Function << 12) | Register);
+		// The ecam window is mapped from the first bus of the segment
+		return (size_t)(((Bus - Io->BusStart) << 20) | (Device << 15) | (Function << 12) | Register);
 	}
 	else {
 		return (size_t)(0x80000000 | (Bus << 16) | (Device << 11) | (Function << 8) | (Register & 0xFC));
@@ -28,6 +28,16 @@
 #include <os/osdefs.h>
 #include <os/device.h>
 
+/* Device manager private registration flags
+ * DEFERRED - Driver loading is queued until DmStartDriverInstalls is called,
+ *            only used by the bus enumeration and never accepted from rpc. */
+#define __DEVICEMANAGER_REGISTER_DEFERRED   0x80000000
+
+/* Device manager driver loading
+ * Queued devices are grouped by class/subclass, and each group is loaded
+ * sequentially by one worker so a driver is never spawned twice. */
+#define DM_DRIVER_WORKERS                   4
+
 /* DmRegisterDevice
  * Allows registering of a new device in the
  * device-manager, and automatically queries for a driver for the new device */
@@ -40,6 +50,13 @@ DmRegisterDevice(
 	_In_  Flags_t               Flags,
 	_Out_ UUId_t*               Id);
 
+/* DmStartDriverInstalls
+ * Starts loading the drivers of all devices registered with the deferred flag,
+ * independent groups of devices are loaded in parallel. Does not wait. */
+__EXTERN
+OsStatus_t
+DmStartDriverInstalls(void);
+
 /* DmUnregisterDevice
  * Allows removal of a device in the device-manager, and automatically 
  * unloads drivers for the removed device */
@@ -23,6 +23,7 @@
 //#define __TRACE
 
 #include "devicemanager.h"
+#include <os/threadpool.h>
 #include <os/driver.h>
 #include <os/utils.h>
 #include <ds/collection.h>
@@ -30,7 +31,18 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 #include <ctype.h>
+#include <time.h>
+
+/* DmDriverGroup
+ * A group of devices that resolve to the same driver, the devices in a group
+ * are loaded in order by a single worker. */
+typedef struct _DmDriverGroup {
+    DevInfo_t               Class;
+    DevInfo_t               Subclass;
+    Collection_t            Devices;
+} DmDriverGroup_t;
 
 /* Globals 
  * Keep track of all devices and contracts */
@@ -38,6 +50,14 @@ static Collection_t Contracts       = COLLECTION_INIT(KeyInteger);
 static Collection_t Devices         = COLLECTION_INIT(KeyInteger);
 static UUId_t DeviceIdGenerator     = 0;
 static UUId_t ContractIdGenerator   = 0;
+static Collection_t DriverGroups    = COLLECTION_INIT(KeyInteger);
+static ThreadPool_t *DriverPool     = NULL;
+static _Atomic(int) DriverGroupsPending;
+static clock_t DriverLoadStart      = 0;
+
+/* Prototypes
+ * Driver loading is queued by the registration */
+static OsStatus_t DmQueueDriverInstall(MCoreDevice_t *Device);
 
 /* OnLoad
  * The entry-point of a server, this is called
@@ -87,7 +107,7 @@ OnEvent(
             // Extract variables
             ParentDeviceId  = (UUId_t)Message->Arguments[0].Data.Value;
             RPCCastArgumentToPointer(&Message->Arguments[1], (void**)&Device);
-            DeviceFlags     = (Flags_t)Message->Arguments[2].Data.Value;
+            DeviceFlags     = (Flags_t)Message->Arguments[2].Data.Value & ~(__DEVICEMANAGER_REGISTER_DEFERRED);
 
             // Sanitize buffer
             if (Device != NULL) {
@@ -243,6 +263,9 @@ DmRegisterDevice(
     // for the new device
 #ifndef __OSCONFIG_NODRIVERS
     if (Flags & __DEVICEMANAGER_REGISTER_LOADDRIVER) {
+        if (Flags & __DEVICEMANAGER_REGISTER_DEFERRED) {
+            return DmQueueDriverInstall(CopyDevice);
+        }
         TRACE("Loading driver by querying system.");
         return InstallDriver(CopyDevice, Device->Length);
     }
@@ -250,6 +273,114 @@ DmRegisterDevice(
     return OsSuccess;
 }
 
+/* DmQueueDriverInstall
+ * Adds the device to the group of devices with the same class and subclass, 
+ * the driver is loaded once DmStartDriverInstalls is called. */
+static OsStatus_t
+DmQueueDriverInstall(
+    _In_ MCoreDevice_t*         Device)
+{
+    // Variables
+    DmDriverGroup_t *Group = NULL;
+    DataKey_t Key;
+
+    foreach(gNode, &DriverGroups) {
+        DmDriverGroup_t *Entry = (DmDriverGroup_t*)gNode->Data;
+        if (Entry->Class == Device->Class && Entry->Subclass == Device->Subclass) {
+            Group = Entry;
+            break;
+        }
+    }
+
+    if (Group == NULL) {
+        Group = (DmDriverGroup_t*)malloc(sizeof(DmDriverGroup_t));
+        Group->Class    = Device->Class;
+        Group->Subclass = Device->Subclass;
+        CollectionConstruct(&Group->Devices, KeyInteger);
+        Key.Value = 0;
+        CollectionAppend(&DriverGroups, CollectionCreateNode(Key, Group));
+    }
+    Key.Value = (int)Device->Id;
+    return CollectionAppend(&Group->Devices, CollectionCreateNode(Key, Device));
+}
+
+/* DmDriverGroupWorker
+ * Loads the drivers for all the devices in a group, runs in the driver pool. */
+static int
+DmDriverGroupWorker(
+    _In_ void*                  Argument)
+{
+    // Variables
+    DmDriverGroup_t *Group      = (DmDriverGroup_t*)Argument;
+    CollectionItem_t *Node      = NULL;
+
+    while ((Node = CollectionPopFront(&Group->Devices)) != NULL) {
+        MCoreDevice_t *Device = (MCoreDevice_t*)Node->Data;
+        if (InstallDriver(Device, Device->Length) != OsSuccess) {
+            TRACE("No driver for device %s", &Device->Name[0]);
+        }
+        CollectionDestroyNode(&Group->Devices, Node);
+    }
+    free(Group);
+
+    // Report the time it took when the last group is done
+    if (atomic_fetch_sub(&DriverGroupsPending, 1) == 1) {
+        TRACE("Driver bring-up completed in %u ms", 
+            (unsigned)((clock() - DriverLoadStart) * 1000 / CLOCKS_PER_SEC));
+    }
+    return 0;
+}
+
+/* DmStartDriverInstalls
+ * Starts loading the drivers of all devices registered with the deferred flag,
+ * independent groups of devices are loaded in parallel. Does not wait. */
+OsStatus_t
+DmStartDriverInstalls(void)
+{
+    // Variables
+    ThreadPoolWorkItem_t *Items = NULL;
+    CollectionItem_t *Node      = NULL;
+    size_t Count                = 0;
+    OsStatus_t Status;
+
+    Count = CollectionLength(&DriverGroups);
+    if (Count == 0) {
+        return OsSuccess;
+    }
+
+    // The pool is kept for later bus rescans
+    if (DriverPool == NULL) {
+        if (ThreadPoolInitialize(DM_DRIVER_WORKERS, &DriverPool) != OsSuccess) {
+            WARNING("Failed to create driver pool, loading drivers sequentially");
+        }
+    }
+
+    Items = (ThreadPoolWorkItem_t*)malloc(sizeof(ThreadPoolWorkItem_t) * Count);
+    Count = 0;
+    while ((Node = CollectionPopFront(&DriverGroups)) != NULL) {
+        Items[Count].Function   = DmDriverGroupWorker;
+        Items[Count].Argument   = Node->Data;
+        Items[Count].Future     = NULL;
+        CollectionDestroyNode(&DriverGroups, Node);
+        Count++;
+    }
+
+    DriverLoadStart = clock();
+    atomic_store(&DriverGroupsPending, (int)Count);
+    if (DriverPool != NULL) {
+        Status = ThreadPoolAddWorkBatch(DriverPool, Items, Count);
+    }
+    else {
+        size_t i;
+        for (i = 0; i < Count; i++) {
+            DmDriverGroupWorker(Items[i].Argument);
+        }
+        Status = OsSuccess;
+    }
+    free(Items);
+    return Status;
+}
+
 /* DmRegisterContract
  * Registers the given contact with the device-manager to let
  * the manager know we are handling this device, and what kind
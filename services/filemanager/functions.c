@@ -125,7 +125,8 @@ VfsOpenHandleInternal(
 FileSystemCode_t 
 VfsOpenInternal(
     _Out_ FileSystemFileHandle_t*   Handle, 
-    _In_  MString_t*                Path)
+    _In_  MString_t*                Path,
+    _In_  Flags_t                   FileFlags)
 {
     // Variables
     CollectionItem_t *pNode = NULL;
@@ -187,7 +188,7 @@ VfsOpenInternal(
 
         // Handle the creation flag
         if (Code == FsPathNotFound && (Handle->Options & __FILE_CREATE)) {
-            Code        = Filesystem->Module->CreateFile(&Filesystem->Descriptor, File, SubPath, 0);
+            Code        = Filesystem->Module->CreateFile(&Filesystem->Descriptor, File, SubPath, FileFlags);
             Created     = 1;
         }
 
@@ -304,16 +305,16 @@ VfsResolvePath(
     return PathResult;
 }
 
-/* VfsOpenFile
- * Opens or creates the given file path based on
- * the given <Access> and <Options> flags. See the
- * top of this file */
+/* VfsOpenPath
+ * Shared implementation of opening files and directories, <FileFlags>
+ * determines the kind of entry that is created if it doesn't exist */
 FileSystemCode_t
-VfsOpenFile(
+VfsOpenPath(
     _In_  UUId_t        Requester,
     _In_  const char*   Path, 
     _In_  Flags_t       Options, 
     _In_  Flags_t       Access,
+    _In_  Flags_t       FileFlags,
     _Out_ UUId_t*       Handle)
 {
     // Variables
@@ -345,7 +346,7 @@ VfsOpenFile(
         Code    = FsPathNotFound;
     }
     else {
-        Code    = VfsOpenInternal(hFile, mPath);
+        Code    = VfsOpenInternal(hFile, mPath, FileFlags);
     }
     MStringDestroy(mPath);
 
@@ -363,6 +364,21 @@ VfsOpenFile(
     return Code;
 }
 
+/* VfsOpenFile
+ * Opens or creates the given file path based on
+ * the given <Access> and <Options> flags. See the
+ * top of this file */
+FileSystemCode_t
+VfsOpenFile(
+    _In_  UUId_t        Requester,
+    _In_  const char*   Path, 
+    _In_  Flags_t       Options, 
+    _In_  Flags_t       Access,
+    _Out_ UUId_t*       Handle)
+{
+    return VfsOpenPath(Requester, Path, Options, Access, 0, Handle);
+}
+
 /* VfsCloseFile
  * Closes the given file-handle, but does not necessarily
  * close the link to the file. Returns the result */
@@ -1001,3 +1017,211 @@ VfsGetFilePath(
     *Path = fHandle->File->Path;
     return OsSuccess;
 }
+
+/* VfsOpenDirectory
+ * Opens or creates the given directory path based on
+ * the given <Access> and <Options> flags. */
+FileSystemCode_t
+VfsOpenDirectory(
+    _In_  UUId_t        Requester,
+    _In_  const char*   Path, 
+    _In_  Flags_t       Options, 
+    _In_  Flags_t       Access,
+    _Out_ UUId_t*       Handle)
+{
+    // Variables
+    vFileDescriptor_t Information;
+    FileSystemCode_t Code   = FsOk;
+    Flags_t FileOptions     = __FILE_VOLATILE;
+
+    // Debug
+    TRACE("VfsOpenDirectory(Path %s, Options 0x%x, Access 0x%x)", 
+        Path, Options, Access);
+
+    // Convert the directory options, directory handles are never written
+    // through so they must not lock the directory for other handles
+    if (Options & __DIRECTORY_CREATE) {
+        FileOptions |= __FILE_CREATE;
+    }
+    if (Options & __DIRECTORY_FAILONEXIST) {
+        FileOptions |= __FILE_FAILONEXIST;
+    }
+    Access  = (Access & ~(__FILE_WRITE_ACCESS)) | __FILE_READ_ACCESS;
+
+    Code    = VfsOpenPath(Requester, Path, FileOptions, Access, FILE_FLAG_DIRECTORY, Handle);
+    if (Code != FsOk) {
+        return Code;
+    }
+
+    // The path might have been an existing file
+    Code = VfsGetFileStatsByHandle(Requester, *Handle, &Information);
+    if (Code == FsOk && !(Information.Flags & FILE_FLAG_DIRECTORY)) {
+        Code = FsPathIsNotDirectory;
+    }
+    if (Code != FsOk) {
+        VfsCloseFile(Requester, *Handle);
+        *Handle = UUID_INVALID;
+    }
+    return Code;
+}
+
+/* VfsReadDirectory
+ * Reads as many directory entries as fits into the given buffer from the
+ * current position in the directory-handle, entries are packed as DirectoryEntry_t */
+FileSystemCode_t
+VfsReadDirectory(
+    _In_  UUId_t                    Requester,
+    _In_  UUId_t                    Handle,
+    _In_  UUId_t                    BufferHandle,
+    _In_  size_t                    Length,
+    _Out_ size_t*                   BytesRead)
+{
+    // Variables
+    FileSystemFileHandle_t *fHandle = NULL;
+    FileSystemCode_t Code           = FsOk;
+    CollectionItem_t *hNode         = NULL;
+    FileSystem_t *Fs                = NULL;
+    DmaBuffer_t *Buffer;
+    DataKey_t Key;
+
+    // Debug
+    TRACE("VfsReadDirectory(Handle %u, Size %u)", Handle, Length);
+    *BytesRead  = 0;
+
+    // Sanitize request parameters first
+    // Is handle valid?
+    Key.Value   = (int)Handle;
+    hNode       = CollectionGetNodeByKey(VfsGetOpenHandles(), Key, 0);
+    if (hNode == NULL || BufferHandle == UUID_INVALID || Length == 0) {
+        ERROR("Either handle was not available or buffer/length is invalid.");
+        return FsInvalidParameters;
+    }
+
+    // Instantiate pointer for next check(s)
+    fHandle = (FileSystemFileHandle_t*)hNode->Data;
+    if (fHandle->Owner != Requester) {
+        ERROR("Owner of handle was not the requester. Access Denied. (%u != %u)",
+            fHandle->Owner, Requester);
+        return FsAccessDenied;
+    }
+
+    Fs = (FileSystem_t*)fHandle->File->System;
+    if (Fs->Module->ReadDirectory == NULL) {
+        ERROR("Filesystem does not support directory enumeration");
+        return FsInvalidParameters;
+    }
+
+    // Acquire the buffer for reading
+    Buffer = CreateBuffer(BufferHandle, 0);
+    if (Buffer == NULL) {
+        ERROR("User specified buffer was invalid");
+        return FsInvalidParameters;
+    }
+    Code = Fs->Module->ReadDirectory(&Fs->Descriptor, fHandle, Buffer, Length, BytesRead);
+    DestroyBuffer(Buffer);
+    return Code;
+}
+
+/* VfsSeekDirectory
+ * Sets the position of the directory-handle, the position must be
+ * 0 or a position returned in a directory entry */
+FileSystemCode_t
+VfsSeekDirectory(
+    _In_ UUId_t     Requester,
+    _In_ UUId_t     Handle, 
+    _In_ int        Position)
+{
+    // Variables
+    FileSystemFileHandle_t *fHandle = NULL;
+    CollectionItem_t *hNode         = NULL;
+    DataKey_t Key;
+
+    // Debug
+    TRACE("VfsSeekDirectory(Handle %u, Position %i)", Handle, Position);
+
+    // Sanitize request parameters first
+    // Is handle valid?
+    Key.Value   = (int)Handle;
+    hNode       = CollectionGetNodeByKey(VfsGetOpenHandles(), Key, 0);
+    if (hNode == NULL || Position < 0) {
+        ERROR("Invalid handle or position given for directory");
+        return FsInvalidParameters;
+    }
+
+    // Instantiate pointer for next check
+    fHandle     = (FileSystemFileHandle_t*)hNode->Data;
+    if (fHandle->Owner != Requester) {
+        ERROR("Owner of the handle did not match the requester, access denied.");
+        return FsAccessDenied;
+    }
+    fHandle->Position = (uint64_t)Position;
+    return FsOk;
+}
+
+/* VfsGetFileStatsByHandle 
+ * Queries the information of the file or directory that the given
+ * handle refers to. */
+FileSystemCode_t
+VfsGetFileStatsByHandle(
+    _In_  UUId_t                    Requester,
+    _In_  UUId_t                    Handle,
+    _Out_ vFileDescriptor_t*        Information)
+{
+    // Variables
+    FileSystemFileHandle_t *fHandle = NULL;
+    CollectionItem_t *hNode         = NULL;
+    FileSystem_t *Fs                = NULL;
+    DataKey_t Key;
+
+    // Debug
+    TRACE("GetFileStatsByHandle(Handle %u)", Handle);
+    memset((void*)Information, 0, sizeof(vFileDescriptor_t));
+
+    // Sanitize request parameters first
+    // Is handle valid?
+    Key.Value = (int)Handle;
+    hNode = CollectionGetNodeByKey(VfsGetOpenHandles(), Key, 0);
+    if (hNode == NULL) {
+        ERROR("Handle did not exist in list of avialable handles");
+        return FsInvalidParameters;
+    }
+
+    // Instantiate pointer for next check
+    fHandle = (FileSystemFileHandle_t*)hNode->Data;
+    if (fHandle->Owner != Requester) {
+        ERROR("Handle is not owned by the one requesting information. Access Denied.");
+        return FsAccessDenied;
+    }
+
+    Fs = (FileSystem_t*)fHandle->File->System;
+    return Fs->Module->QueryFile(&Fs->Descriptor, fHandle, 
+        __FILESYSTEM_QUERY_STATS, (void*)Information, sizeof(vFileDescriptor_t));
+}
+
+/* VfsGetFileStatsByPath 
+ * Queries the information of the file or directory at the given path. */
+FileSystemCode_t
+VfsGetFileStatsByPath(
+    _In_  UUId_t                    Requester,
+    _In_  const char*               Path,
+    _Out_ vFileDescriptor_t*        Information)
+{
+    // Variables
+    FileSystemCode_t Code   = FsOk;
+    UUId_t Handle           = UUID_INVALID;
+
+    // Debug
+    TRACE("GetFileStatsByPath(Path %s)", Path);
+    memset((void*)Information, 0, sizeof(vFileDescriptor_t));
+
+    // Use a temporary handle, opening a file that is already open
+    // is served from the open-file cache
+    Code = VfsOpenPath(Requester, Path, __FILE_VOLATILE, 
+        __FILE_READ_ACCESS | __FILE_READ_SHARE | __FILE_WRITE_SHARE, 0, &Handle);
+    if (Code != FsOk) {
+        return Code;
+    }
+    Code = VfsGetFileStatsByHandle(Requester, Handle, Information);
+    VfsCloseFile(Requester, Handle);
+    return Code;
+}
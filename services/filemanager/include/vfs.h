@@ -69,6 +69,7 @@ typedef struct _FileSystemModule {
     FsOpenHandle_t                    OpenHandle;
     FsCloseHandle_t                    CloseHandle;
     FsReadFile_t                    ReadFile;
+    FsReadDirectory_t               ReadDirectory;
     FsWriteFile_t                    WriteFile;
     FsSeekFile_t                    SeekFile;
     FsChangeFileSize_t                ChangeFileSize;
@@ -203,6 +204,26 @@ VfsOpenFile(
     _In_  Flags_t                   Access,
     _Out_ UUId_t*                   Handle);
 
+/* VfsOpenDirectory
+ * Opens or creates the given directory path based on
+ * the given <Access> and <Options> flags. */
+__EXTERN FileSystemCode_t SERVICEABI
+VfsOpenDirectory(
+    _In_  UUId_t                    Requester,
+    _In_  const char*               Path, 
+    _In_  Flags_t                   Options, 
+    _In_  Flags_t                   Access,
+    _Out_ UUId_t*                   Handle);
+
+/* VfsSeekDirectory
+ * Sets the position of the directory-handle, the position must be
+ * 0 or a position returned in a directory entry */
+__EXTERN FileSystemCode_t SERVICEABI
+VfsSeekDirectory(
+    _In_ UUId_t                     Requester,
+    _In_ UUId_t                     Handle, 
+    _In_ int                        Position);
+
 /* VfsCloseFile
  * Closes the given file-handle, but does not necessarily
  * close the link to the file. Returns the result */
@@ -233,6 +254,17 @@ VfsReadFile(
     _Out_ size_t*                   BytesIndex,
     _Out_ size_t*                   BytesRead);
 
+/* VfsReadDirectory
+ * Reads as many directory entries as fits into the given buffer from the
+ * current position in the directory-handle, entries are packed as DirectoryEntry_t */
+__EXTERN FileSystemCode_t SERVICEABI
+VfsReadDirectory(
+    _In_  UUId_t                    Requester,
+    _In_  UUId_t                    Handle,
+    _In_  UUId_t                    BufferHandle,
+    _In_  size_t                    Length,
+    _Out_ size_t*                   BytesRead);
+
 /* VfsWriteFile
  * Writes the requested number of bytes from the given buffer
  * into the current position in the file-handle */
@@ -322,6 +354,23 @@ VfsGetFilePath(
     _In_  UUId_t                    Handle,
     _Out_ MString_t**               Path);
 
+/* VfsGetFileStatsByHandle 
+ * Queries the information of the file or directory that the given
+ * handle refers to. */
+__EXTERN FileSystemCode_t SERVICEABI
+VfsGetFileStatsByHandle(
+    _In_  UUId_t                    Requester,
+    _In_  UUId_t                    Handle,
+    _Out_ vFileDescriptor_t*        Information);
+
+/* VfsGetFileStatsByPath 
+ * Queries the information of the file or directory at the given path. */
+__EXTERN FileSystemCode_t SERVICEABI
+VfsGetFileStatsByPath(
+    _In_  UUId_t                    Requester,
+    _In_  const char*               Path,
+    _Out_ vFileDescriptor_t*        Information);
+
 /* VfsPathResolveEnvironment
  * Resolves the given env-path identifier to a string
  * that can be used to locate files. */
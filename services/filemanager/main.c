@@ -363,10 +363,21 @@ OnEvent(
             }
         } break;
 
-        // @todo
+        // Queries the information of the file or directory at the given path.
         case __FILEMANAGER_GETSTATSBYPATH: {
+            QueryFileStatsPackage_t Package;
+            Package.Code = VfsGetFileStatsByPath(Message->From.Process,
+                RPCGetStringArgument(Message, 0), &Package.Information);
+            Result = RPCRespond(&Message->From, (const void*)&Package, sizeof(QueryFileStatsPackage_t));
         } break;
+
+        // Queries the information of the file or directory that the
+        // given handle refers to.
         case __FILEMANAGER_GETSTATSBYHANDLE: {
+            QueryFileStatsPackage_t Package;
+            Package.Code = VfsGetFileStatsByHandle(Message->From.Process,
+                (UUId_t)Message->Arguments[0].Data.Value, &Package.Information);
+            Result = RPCRespond(&Message->From, (const void*)&Package, sizeof(QueryFileStatsPackage_t));
         } break;
 
         // Deletes the given path, the path can both be file or directory.
@@ -376,14 +387,44 @@ OnEvent(
             Result = RPCRespond(&Message->From, (const void*)&Code, sizeof(FileSystemCode_t));
         } break;
 
-        // @todo
+        // Opens or creates the given directory path based on
+        // the given <Access> and <Options> flags.
         case __FILEMANAGER_OPENDIRECTORY: {
+            OpenFilePackage_t Package;
+            Package.Code    = VfsOpenDirectory(Message->From.Process,
+                RPCGetStringArgument(Message, 0),
+                (Flags_t)Message->Arguments[1].Data.Value,
+                (Flags_t)Message->Arguments[2].Data.Value,
+                &Package.Handle);
+            Result = RPCRespond(&Message->From, (const void*)&Package, sizeof(OpenFilePackage_t));
         } break;
+
+        // Directory handles are regular file handles
         case __FILEMANAGER_CLOSEDIRECTORY: {
+            FileSystemCode_t Code = VfsCloseFile(Message->From.Process, 
+                (UUId_t)Message->Arguments[0].Data.Value);
+            Result = RPCRespond(&Message->From, (const void*)&Code, sizeof(FileSystemCode_t));
         } break;
+
+        // Reads as many directory entries as fits into the given buffer
+        // from the current position in the directory-handle
         case __FILEMANAGER_READDIRECTORY: {
+            RWFilePackage_t Package;
+            Package.Index   = 0;
+            Package.Code    = VfsReadDirectory(Message->From.Process,
+                (UUId_t)Message->Arguments[0].Data.Value,
+                (UUId_t)Message->Arguments[1].Data.Value,
+                Message->Arguments[2].Data.Value,
+                &Package.ActualSize);
+            Result = RPCRespond(&Message->From, (const void*)&Package, sizeof(RWFilePackage_t));
         } break;
+
+        // Sets the position of the directory-handle
         case __FILEMANAGER_SEEKDIRECTORY: {
+            FileSystemCode_t Code = VfsSeekDirectory(Message->From.Process,
+                (UUId_t)Message->Arguments[0].Data.Value,
+                (int)Message->Arguments[1].Data.Value);
+            Result = RPCRespond(&Message->From, (const void*)&Code, sizeof(FileSystemCode_t));
         } break;
 
         // Resolves a special environment path for
@@ -102,6 +102,8 @@ VfsResolveFileSystem(
 	// - FsChangeFileSize
 	// - FsDeletePath
 	// - FsQueryFile 
+	// Optional functions
+	// - FsReadDirectory
 	Module->Initialize = (FsInitialize_t)
 		SharedObjectGetFunction(Module->Handle, "FsInitialize");
 	Module->Destroy = (FsDestroy_t)
@@ -128,6 +130,8 @@ VfsResolveFileSystem(
 		SharedObjectGetFunction(Module->Handle, "FsDeletePath");
 	Module->QueryFile = (FsQueryFile_t)
 		SharedObjectGetFunction(Module->Handle, "FsQueryFile");
+	Module->ReadDirectory = (FsReadDirectory_t)
+		SharedObjectGetFunction(Module->Handle, "FsReadDirectory");
 
 	// Sanitize functions
 	if (Module->Initialize == NULL
@@ -252,6 +252,8 @@ UsbQueryConfigurationDescriptors(
                 // Store number of endpoints and generate an id
                 UsbIfVersionMeta->Base.Id = Interface->AlternativeSetting;
                 UsbIfVersionMeta->Base.EndpointCount = Interface->NumEndpoints;
+                UsbIfVersionMeta->Base.Protocol = Interface->Protocol;
+                UsbIfVersionMeta->Exists = 1;
 
                 // Setup some state-machine variables
                 CurrentIfVersion = Interface->AlternativeSetting;
@@ -320,6 +322,40 @@ UsbQueryConfigurationDescriptors(
             // Increase the EP index
             EpIterator++;
         }
+        else if (Length >= 6 && Type == USB_DESCRIPTOR_SS_EP_CPN) {
+            // Variables
+            UsbHcEndpointDescriptor_t *HcEndpoint = NULL;
+
+            // The companion always trails the endpoint it describes
+            if (Device->Base.InterfaceCount == 0 || EpIterator == 0) {
+                goto NextEntry;
+            }
+            HcEndpoint = &Device->Interfaces[
+                Device->Base.InterfaceCount - 1].
+                    Versions[CurrentIfVersion].Endpoints[EpIterator - 1];
+
+            // Byte 2 is bMaxBurst, byte 3 is bmAttributes which for bulk
+            // endpoints holds the log2 of the number of streams supported
+            HcEndpoint->MaxBurst        = BufferPointer[2];
+            if (HcEndpoint->Type == EndpointBulk && (BufferPointer[3] & 0x1F) != 0) {
+                HcEndpoint->MaxStreams  = (size_t)1 << (BufferPointer[3] & 0x1F);
+            }
+            TRACE("Endpoint companion - MaxBurst %u, MaxStreams %u",
+                HcEndpoint->MaxBurst, HcEndpoint->MaxStreams);
+        }
+        else if (Length >= 4 && Type == USB_DESCRIPTOR_PIPE_USAGE) {
+            // Variables
+            UsbHcEndpointDescriptor_t *HcEndpoint = NULL;
+
+            // UAS pipe usage also trails the endpoint it describes
+            if (Device->Base.InterfaceCount == 0 || EpIterator == 0) {
+                goto NextEntry;
+            }
+            HcEndpoint = &Device->Interfaces[
+                Device->Base.InterfaceCount - 1].
+                    Versions[CurrentIfVersion].Endpoints[EpIterator - 1];
+            HcEndpoint->Pipe = BufferPointer[2];
+        }
 
         // Go to next descriptor entry
     NextEntry:
@@ -436,7 +472,8 @@ UsbDeviceLoadDrivers(
 {
     // Variables
     MCoreUsbDevice_t CoreDevice;
-    int i;
+    int EndpointIndex;
+    int i, j;
 
     // Debug
     TRACE("UsbDeviceLoadDrivers()");
@@ -469,8 +506,19 @@ UsbDeviceLoadDrivers(
             const char *Identification = UsbGetIdentificationString(Device->Interfaces[i].Base.Class);
             memcpy(&CoreDevice.Interface, &Device->Interfaces[i].Base, 
                 sizeof(UsbHcInterface_t));
-            memcpy(&CoreDevice.Endpoints[1], &Device->Interfaces[i].Versions[0].Endpoints[0],
-                sizeof(UsbHcEndpointDescriptor_t) * Device->Interfaces[i].Versions[0].Base.EndpointCount);
+
+            // Endpoints of the alternate settings follow the default setting
+            // back to back, for as long as they fit
+            EndpointIndex = 1;
+            for (j = 0; j < USB_MAX_VERSIONS; j++) {
+                UsbInterfaceVersion_t *Version = &Device->Interfaces[i].Versions[j];
+                if (EndpointIndex + Version->Base.EndpointCount > USB_MAX_ENDPOINTS) {
+                    break;
+                }
+                memcpy(&CoreDevice.Endpoints[EndpointIndex], &Version->Endpoints[0],
+                    sizeof(UsbHcEndpointDescriptor_t) * Version->Base.EndpointCount);
+                EndpointIndex += Version->Base.EndpointCount;
+            }
 
             // Let interface determine the class/subclass
             memcpy(&CoreDevice.Base.Name[0], Identification, strlen(Identification));
@@ -610,8 +658,12 @@ UsbDeviceSetup(
     Device->Base.ConfigurationCount         = DeviceDescriptor.ConfigurationCount;
     
     // Update MPS
+    // SuperSpeed devices report the control MPS as an exponent
     Device->Base.MaxPacketSize              = DeviceDescriptor.MaxPacketSize;
     Device->ControlEndpoint.MaxPacketSize   = DeviceDescriptor.MaxPacketSize;
+    if (Device->Base.Speed == SuperSpeed) {
+        Device->ControlEndpoint.MaxPacketSize = (size_t)1 << DeviceDescriptor.MaxPacketSize;
+    }
 
     // Query Config Descriptor
     if (UsbQueryConfigurationDescriptors(Controller, Device) != OsSuccess) {
@@ -6,6 +6,7 @@
 // Includes
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <dirent.h>
@@ -14,6 +15,18 @@
 #define PACKED_TYPESTRUCT(name, body) typedef struct __attribute__((packed)) _##name body name##_t
 #define POLYNOMIAL 0x04c11db7L      // Standard CRC-32 ppolynomial
 
+// Version 2 definitions, must match the kernel ramdisk.h
+#define RAMDISK_INDEX_EMPTY         0xFFFFFFFF
+#define RAMDISK_COMPRESSION_NONE    0x0
+#define RAMDISK_COMPRESSION_LZSS    0x1
+#define RAMDISK_LZSS_MIN_MATCH      3
+#define RAMDISK_LZSS_MAX_MATCH      18
+#define RAMDISK_LZSS_WINDOW         4096
+#define RAMDISK_HASH_INITIAL        0x811C9DC5
+#define RAMDISK_HASH_PRIME          0x01000193
+#define RAMDISK_FILE                0x1
+#define RAMDISK_MODULE              0x4
+
 /* MCoreRamDiskHeader
  * The ramdisk header, this is present in the 
  * first few bytes of the ramdisk image, members
@@ -49,11 +62,56 @@ PACKED_TYPESTRUCT(MCoreRamDiskModuleHeader, {
     uint32_t    DeviceSubType;
 });
 
+/* MCoreRamDiskIndexHeader
+ * Follows the ramdisk header in version 2 */
+PACKED_TYPESTRUCT(MCoreRamDiskIndexHeader, {
+    uint32_t    EntryTableOffset;
+    uint32_t    PathBuckets;
+    uint32_t    PathIndexOffset;
+    uint32_t    DeviceBuckets;
+    uint32_t    DeviceIndexOffset;
+    uint32_t    ClassBuckets;
+    uint32_t    ClassIndexOffset;
+});
+
+/* MCoreRamDiskIndexSlot
+ * A slot in one of the hash indices */
+PACKED_TYPESTRUCT(MCoreRamDiskIndexSlot, {
+    uint32_t    Hash;
+    uint32_t    Entry;
+});
+
+/* MCoreRamDiskEntryV2
+ * The version 2 entry, names live in the string table */
+PACKED_TYPESTRUCT(MCoreRamDiskEntryV2, {
+    uint32_t    NameOffset;
+    uint32_t    NameLength;
+    uint32_t    Type;
+    uint32_t    DataHeaderOffset;
+});
+
+/* MCoreRamDiskModuleHeaderV2
+ * The version 2 module header, followed by the stored data */
+PACKED_TYPESTRUCT(MCoreRamDiskModuleHeaderV2, {
+    MCoreRamDiskModuleHeader_t  Base;
+    uint32_t                    Compression;
+    uint32_t                    StoredLength;
+});
+
+/* RdEntry
+ * An entry collected from the initrd folder before the image is laid out */
+typedef struct _RdEntry {
+    char                        Name[256];
+    uint32_t                    Type;
+    MCoreRamDiskModuleHeaderV2_t Header;
+    uint8_t*                    Stored;
+} RdEntry_t;
+
 // Statics
 uint32_t CrcTable[256] = { 0 };
 MCoreRamDiskHeader_t RdHeaderStatic = {
 	0x3144524D,
-	0x00000001,
+	0x00000002,
 	0, 0
 };
 
@@ -61,7 +119,8 @@ MCoreRamDiskHeader_t RdHeaderStatic = {
 static void ShowSyntax(void)
 {
 	printf("  Syntax:\n\n"
-           "    Build    :  rd <arch> <output>\n\n");
+           "    Build    :  rd <arch> <output>\n"
+           "    Verify   :  rd verify <image>\n\n");
 }
 
 /* Crc32GenerateTable
@@ -109,6 +168,235 @@ Crc32Generate(
     return CrcAccumulator;
 }
 
+/* RdHashName
+ * FNV-1a of the lower-cased name, used for the path index */
+uint32_t
+RdHashName(
+    const char *Name)
+{
+    uint32_t Hash = RAMDISK_HASH_INITIAL;
+    while (*Name) {
+        uint8_t Character = (uint8_t)*Name++;
+        if (Character >= 'A' && Character <= 'Z') {
+            Character += ('a' - 'A');
+        }
+        Hash = (Hash ^ Character) * RAMDISK_HASH_PRIME;
+    }
+    return Hash;
+}
+
+/* RdHashKey
+ * FNV-1a of two little endian 32 bit values, used for the device indices */
+uint32_t
+RdHashKey(
+    uint32_t Key1, 
+    uint32_t Key2)
+{
+    uint32_t Hash = RAMDISK_HASH_INITIAL;
+    int i;
+    for (i = 0; i < 4; i++) {
+        Hash = (Hash ^ ((Key1 >> (i * 8)) & 0xFF)) * RAMDISK_HASH_PRIME;
+    }
+    for (i = 0; i < 4; i++) {
+        Hash = (Hash ^ ((Key2 >> (i * 8)) & 0xFF)) * RAMDISK_HASH_PRIME;
+    }
+    return Hash;
+}
+
+/* LzssCompress
+ * Compresses the source into the destination using hash chains to find
+ * matches in the window. Returns the compressed length, or 0 if the output 
+ * would not be smaller than the input. */
+size_t
+LzssCompress(
+    const uint8_t *Source, 
+    size_t Length, 
+    uint8_t *Destination)
+{
+    // Variables
+    int32_t Heads[0x10000];
+    int32_t *Chain = NULL;
+    size_t In = 0, Out = 0, FlagIndex = 0;
+    int Items = 8;
+
+    if (Length < RAMDISK_LZSS_MIN_MATCH) {
+        return 0;
+    }
+    Chain = (int32_t*)malloc(sizeof(int32_t) * Length);
+    memset(Heads, 0xFF, sizeof(Heads));
+
+#define LZSS_HASH(p) ((((uint32_t)Source[p] << 8) ^ ((uint32_t)Source[(p) + 1] << 4) ^ Source[(p) + 2]) & 0xFFFF)
+    while (In < Length) {
+        size_t BestLength = 0, BestDistance = 0;
+        size_t Step, i;
+
+        if (Items == 8) {
+            // Never allow output to grow beyond the input
+            if (Out + 1 + 16 >= Length) {
+                free(Chain);
+                return 0;
+            }
+            FlagIndex = Out++;
+            Destination[FlagIndex] = 0;
+            Items = 0;
+        }
+
+        // Search the chain for the longest match
+        if (In + RAMDISK_LZSS_MIN_MATCH <= Length) {
+            int32_t Candidate = Heads[LZSS_HASH(In)];
+            int Depth = 256;
+            while (Candidate >= 0 && (In - Candidate) <= RAMDISK_LZSS_WINDOW && Depth--) {
+                size_t Max = Length - In;
+                size_t MatchLength = 0;
+                if (Max > RAMDISK_LZSS_MAX_MATCH) {
+                    Max = RAMDISK_LZSS_MAX_MATCH;
+                }
+                while (MatchLength < Max && Source[Candidate + MatchLength] == Source[In + MatchLength]) {
+                    MatchLength++;
+                }
+                if (MatchLength > BestLength) {
+                    BestLength      = MatchLength;
+                    BestDistance    = In - Candidate;
+                    if (MatchLength == Max) {
+                        break;
+                    }
+                }
+                Candidate = Chain[Candidate];
+            }
+        }
+
+        if (BestLength >= RAMDISK_LZSS_MIN_MATCH) {
+            uint16_t Token = (uint16_t)(((BestDistance - 1) << 4) | (BestLength - RAMDISK_LZSS_MIN_MATCH));
+            Destination[Out++] = Token & 0xFF;
+            Destination[Out++] = (Token >> 8) & 0xFF;
+            Step = BestLength;
+        }
+        else {
+            Destination[FlagIndex] |= (uint8_t)(1 << Items);
+            Destination[Out++] = Source[In];
+            Step = 1;
+        }
+        Items++;
+
+        // Insert all consumed positions into the chains
+        for (i = 0; i < Step; i++, In++) {
+            if (In + RAMDISK_LZSS_MIN_MATCH <= Length) {
+                uint32_t Hash = LZSS_HASH(In);
+                Chain[In] = Heads[Hash];
+                Heads[Hash] = (int32_t)In;
+            }
+        }
+    }
+#undef LZSS_HASH
+    free(Chain);
+    return Out < Length ? Out : 0;
+}
+
+/* LzssDecompress
+ * Decompresses lzss data, returns the number of bytes produced 
+ * or 0 if the data is corrupt. Mirrors the kernel decompressor. */
+size_t
+LzssDecompress(
+    const uint8_t *Source, 
+    size_t SourceLength, 
+    uint8_t *Destination, 
+    size_t DestinationLength)
+{
+    size_t In = 0, Out = 0;
+    unsigned Flags = 0;
+    int Bits = 0;
+
+    while (Out < DestinationLength) {
+        if (Bits == 0) {
+            if (In >= SourceLength) {
+                return 0;
+            }
+            Flags = Source[In++];
+            Bits = 8;
+        }
+        if (Flags & 1) {
+            if (In >= SourceLength) {
+                return 0;
+            }
+            Destination[Out++] = Source[In++];
+        }
+        else {
+            size_t Distance, Length;
+            if (In + 2 > SourceLength) {
+                return 0;
+            }
+            Distance    = ((size_t)(Source[In] | (Source[In + 1] << 8)) >> 4) + 1;
+            Length      = (Source[In] & 0xF) + RAMDISK_LZSS_MIN_MATCH;
+            In          += 2;
+            if (Distance > Out || Length > (DestinationLength - Out)) {
+                return 0;
+            }
+            while (Length--) {
+                Destination[Out] = Destination[Out - Distance];
+                Out++;
+            }
+        }
+        Flags >>= 1;
+        Bits--;
+    }
+    return Out;
+}
+
+/* NextPowerOfTwo
+ * Returns the bucket count for an index of the given number of keys,
+ * keeping the load factor at or below 50% */
+uint32_t
+NextPowerOfTwo(
+    uint32_t Count)
+{
+    uint32_t Buckets = 1;
+    while (Buckets < (Count * 2)) {
+        Buckets <<= 1;
+    }
+    return Buckets;
+}
+
+/* IndexInsert
+ * Inserts an entry into a linear probed hash index */
+void
+IndexInsert(
+    MCoreRamDiskIndexSlot_t *Slots, 
+    uint32_t Buckets, 
+    uint32_t Hash, 
+    uint32_t Entry)
+{
+    uint32_t Slot = Hash & (Buckets - 1);
+    while (Slots[Slot].Entry != RAMDISK_INDEX_EMPTY) {
+        Slot = (Slot + 1) & (Buckets - 1);
+    }
+    Slots[Slot].Hash = Hash;
+    Slots[Slot].Entry = Entry;
+}
+
+/* IndexFind
+ * Probes an index for the hash and returns the first entry whose
+ * Match callback accepts it, or RAMDISK_INDEX_EMPTY. */
+uint32_t
+IndexFind(
+    MCoreRamDiskIndexSlot_t *Slots, 
+    uint32_t Buckets, 
+    uint32_t Hash, 
+    int (*Match)(uint32_t Entry, void *Context), 
+    void *Context)
+{
+    uint32_t Probe;
+    for (Probe = 0; Probe < Buckets; Probe++) {
+        MCoreRamDiskIndexSlot_t *Slot = &Slots[(Hash + Probe) & (Buckets - 1)];
+        if (Slot->Entry == RAMDISK_INDEX_EMPTY) {
+            break;
+        }
+        if (Slot->Hash == Hash && Match(Slot->Entry, Context)) {
+            return Slot->Entry;
+        }
+    }
+    return RAMDISK_INDEX_EMPTY;
+}
+
 // Determines if a file has a corresponding driver descriptor
 static FILE *GetDriver(const char *path)
 {
@@ -217,17 +505,160 @@ int GetNextLine(FILE *handle, char **tokens, int *count)
 	return result;
 }
 
+/* Verification state
+ * Used by the index match callbacks while verifying an image */
+static uint8_t *VerifyImage = NULL;
+static MCoreRamDiskEntryV2_t *VerifyEntries = NULL;
+
+static MCoreRamDiskModuleHeaderV2_t *VerifyHeader(uint32_t Entry) {
+    return (MCoreRamDiskModuleHeaderV2_t*)(VerifyImage + VerifyEntries[Entry].DataHeaderOffset);
+}
+
+static int MatchName(uint32_t Entry, void *Context) {
+    return !strcasecmp((const char*)(VerifyImage + VerifyEntries[Entry].NameOffset), (const char*)Context);
+}
+
+static int MatchDevice(uint32_t Entry, void *Context) {
+    MCoreRamDiskModuleHeader_t *Key = (MCoreRamDiskModuleHeader_t*)Context;
+    return VerifyHeader(Entry)->Base.VendorId == Key->VendorId 
+        && VerifyHeader(Entry)->Base.DeviceId == Key->DeviceId;
+}
+
+static int MatchClass(uint32_t Entry, void *Context) {
+    MCoreRamDiskModuleHeader_t *Key = (MCoreRamDiskModuleHeader_t*)Context;
+    return VerifyHeader(Entry)->Base.DeviceType == Key->DeviceType 
+        && VerifyHeader(Entry)->Base.DeviceSubType == Key->DeviceSubType;
+}
+
+/* VerifyRamdisk
+ * Reads back a version 2 image, resolves every entry through the indices,
+ * decompresses the data and validates it against the crc and the source file */
+int
+VerifyRamdisk(
+    const char *Path)
+{
+    // Variables
+    MCoreRamDiskHeader_t *Header = NULL;
+    MCoreRamDiskIndexHeader_t *Index = NULL;
+    FILE *image = fopen(Path, "rb");
+    long isize = 0;
+    int errors = 0;
+    int i;
+
+    if (image == NULL) {
+        printf("%s could not be opened\n", Path);
+        return 1;
+    }
+    fseek(image, 0, SEEK_END);
+    isize = ftell(image);
+    rewind(image);
+    VerifyImage = malloc(isize);
+    if (fread(VerifyImage, 1, isize, image) != (size_t)isize) {
+        printf("%s could not be read\n", Path);
+        return 1;
+    }
+    fclose(image);
+
+    Header = (MCoreRamDiskHeader_t*)VerifyImage;
+    if (Header->Magic != RdHeaderStatic.Magic || Header->Version != 0x2) {
+        printf("%s is not a version 2 ramdisk\n", Path);
+        return 1;
+    }
+    Index = (MCoreRamDiskIndexHeader_t*)(VerifyImage + sizeof(MCoreRamDiskHeader_t));
+    VerifyEntries = (MCoreRamDiskEntryV2_t*)(VerifyImage + Index->EntryTableOffset);
+
+    for (i = 0; i < Header->FileCount; i++) {
+        MCoreRamDiskEntryV2_t *Entry = &VerifyEntries[i];
+        MCoreRamDiskModuleHeaderV2_t *DataHeader = VerifyHeader(i);
+        const char *Name = (const char*)(VerifyImage + Entry->NameOffset);
+        uint8_t *Stored = (uint8_t*)(DataHeader + 1);
+        uint8_t *Data = malloc(DataHeader->Base.LengthOfData + 1);
+        char filename_qfd[300];
+        FILE *source = NULL;
+        uint32_t Found;
+
+        // Resolve it through the indices
+        Found = IndexFind((MCoreRamDiskIndexSlot_t*)(VerifyImage + Index->PathIndexOffset), 
+            Index->PathBuckets, RdHashName(Name), MatchName, (void*)Name);
+        if (Found != (uint32_t)i) {
+            printf("  %s: path index lookup failed\n", Name);
+            errors++;
+        }
+        if (Entry->Type == RAMDISK_MODULE) {
+            Found = IndexFind((MCoreRamDiskIndexSlot_t*)(VerifyImage + Index->ClassIndexOffset), 
+                Index->ClassBuckets, RdHashKey(DataHeader->Base.DeviceType, DataHeader->Base.DeviceSubType), 
+                MatchClass, &DataHeader->Base);
+            if (Found == RAMDISK_INDEX_EMPTY) {
+                printf("  %s: class index lookup failed\n", Name);
+                errors++;
+            }
+            if (DataHeader->Base.VendorId != 0) {
+                Found = IndexFind((MCoreRamDiskIndexSlot_t*)(VerifyImage + Index->DeviceIndexOffset), 
+                    Index->DeviceBuckets, RdHashKey(DataHeader->Base.VendorId, DataHeader->Base.DeviceId), 
+                    MatchDevice, &DataHeader->Base);
+                if (Found == RAMDISK_INDEX_EMPTY) {
+                    printf("  %s: device index lookup failed\n", Name);
+                    errors++;
+                }
+            }
+        }
+
+        // Restore the data
+        if (DataHeader->Compression == RAMDISK_COMPRESSION_LZSS) {
+            if (LzssDecompress(Stored, DataHeader->StoredLength, Data, 
+                    DataHeader->Base.LengthOfData) != DataHeader->Base.LengthOfData) {
+                printf("  %s: decompression failed\n", Name);
+                errors++;
+            }
+        }
+        else {
+            memcpy(Data, Stored, DataHeader->Base.LengthOfData);
+        }
+        if (Crc32Generate(-1, Data, DataHeader->Base.LengthOfData) != DataHeader->Base.Crc32OfData) {
+            printf("  %s: crc mismatch\n", Name);
+            errors++;
+        }
+
+        // Compare against the source if it's still around
+        sprintf(filename_qfd, "initrd/%s", Name);
+        source = fopen(filename_qfd, "rb");
+        if (source != NULL) {
+            uint8_t *Original = malloc(DataHeader->Base.LengthOfData + 1);
+            size_t Read = fread(Original, 1, DataHeader->Base.LengthOfData + 1, source);
+            if (Read != DataHeader->Base.LengthOfData 
+                || memcmp(Original, Data, Read)) {
+                printf("  %s: differs from source\n", Name);
+                errors++;
+            }
+            free(Original);
+            fclose(source);
+        }
+
+        printf("  %-32s %8u -> %8u (%s)\n", Name, DataHeader->Base.LengthOfData, 
+            DataHeader->StoredLength, DataHeader->Compression == RAMDISK_COMPRESSION_LZSS ? "lzss" : "none");
+        free(Data);
+    }
+
+    printf("%i entries, %i errors\n", Header->FileCount, errors);
+    free(VerifyImage);
+    return errors != 0;
+}
+
 // main
 int main(int argc, char *argv[])
 {
 	// Variables
+	MCoreRamDiskIndexHeader_t rdindex = { 0 };
+	MCoreRamDiskIndexSlot_t *pathslots, *deviceslots, *classslots;
+	MCoreRamDiskEntryV2_t *rdentries;
+	RdEntry_t *entries = NULL;
 	struct dirent *dp = NULL;
-	char filename_qfd[100];
-	char *dataptr = NULL;
+	char filename_qfd[300];
+	uint32_t offset = 0, stringoffset = 0;
+	uint32_t devicecount = 0, modulecount = 0;
+	int entrycount = 0, entrycapacity = 0;
 	FILE *out = NULL;
 	DIR *dfd = NULL;
-	long fentrypos = 0;
-	long fdatapos = 0;
 	char **tokens;
 	int tokencount;
 
@@ -242,17 +673,15 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	// Create the output file
-	out = fopen(argv[2], "wb+");
-	if (out == NULL) {
-		printf("%s was an invalid output file\n", argv[2]);
-		return 1;
-    }
-    
     // Initialize CRC
     printf("Generating crc-table\n");
     Crc32GenerateTable();
 
+	// Verify mode reads back an image
+	if (!strcmp(argv[1], "verify")) {
+		return VerifyRamdisk(argv[2]);
+	}
+
 	// Fill in architecture
 	// Arch - x86_32 = 0x08, x86_64 = 0x10
     if (!strcmp(argv[1], "i386") || !strcmp(argv[1], "__i386__")) {
@@ -262,51 +691,24 @@ int main(int argc, char *argv[])
 	    RdHeaderStatic.Architecture = 0x10;
     }
 
-	RdHeaderStatic.FileCount = 0;
-
     // Open directory
-    printf("Counting available files for rd\n");
 	if ((dfd = opendir("initrd")) == NULL) {
 		fprintf(stderr, "Can't open initrd folder\n");
 		return 1;
 	}
 
-	// Count files of type .dll
-	while ((dp = readdir(dfd)) != NULL) {
-		char *dot = strrchr(dp->d_name, '.');
-		if (dot && !strcmp(dot, ".dll")) {
-			RdHeaderStatic.FileCount++;
-		}
-	}
-
-	// Rewind
-	rewinddir(dfd);
-
-    // Write header
-    printf("Generating ramdisk header\n");
-	fwrite(&RdHeaderStatic, 1, sizeof(MCoreRamDiskHeader_t), out);
-	fflush(out);
-
-	// Store current position
-	fentrypos = ftell(out);
-
-	// Fill rest of entry space with 0
-	dataptr = malloc(0x1000 - sizeof(MCoreRamDiskHeader_t));
-	memset(dataptr, 0, 0x1000 - sizeof(MCoreRamDiskHeader_t));
-	fwrite(dataptr, 1, 0x1000 - sizeof(MCoreRamDiskHeader_t), out);
-	free(dataptr);
-	fflush(out);
-	fdatapos = ftell(out);
-
 	// Init token storage
 	tokens = (char**)malloc(sizeof(char*) * 24);
 	for (int i = 0; i < 24; i++)
 		tokens[i] = (char*)malloc(64);
 
-    // Iterate entries
+    // Collect and compress all entries, the layout depends on the sizes
     printf("Generating ramdisk entries\n");
 	while ((dp = readdir(dfd)) != NULL) {
 		struct stat stbuf;
+		RdEntry_t *rdentry = NULL;
+		uint8_t *dataptr = NULL;
+		size_t compressed = 0;
 
 		// Build path string
 		sprintf(filename_qfd, "initrd/%s", dp->d_name);
@@ -315,129 +717,173 @@ int main(int argc, char *argv[])
 			continue;
 		}
 
-		// Skip directories
-		if ((stbuf.st_mode & S_IFMT) == S_IFDIR) {
+		// Skip directories and everything that is not dll's
+		char *dot = strrchr(dp->d_name, '.');
+		if ((stbuf.st_mode & S_IFMT) == S_IFDIR || !dot || strcmp(dot, ".dll")) {
 			continue;
 		}
-		else {
-            // Variables
-            MCoreRamDiskEntry_t rdentry = { { 0 }, 0 };
-            MCoreRamDiskModuleHeader_t rddataheader = { 0 };
-            
-            // Skip everything that is not dll's
-            char *dot = strrchr(dp->d_name, '.');
-			if (!dot || strcmp(dot, ".dll")) {
-				continue;
-			}
-
-			// Is it a driver? check if file exists with .drvm extension
-			FILE *drvdata = GetDriver(&filename_qfd[0]);
-			FILE *entry = NULL;
-			char *name = NULL;
-			uint32_t type = drvdata == NULL ? 0x1 : 0x4;
-			uint32_t vendorid = 0;
-			uint32_t deviceid = 0;
-			uint32_t dclass = 0;
-			uint32_t dsubclass = 0;
-			uint32_t dflags = 0;
-			long fsize = 0;
-
-			// Debug print
-			if (drvdata != NULL) {
-				printf("writing %s to rd (driver)\n", dp->d_name);
-			}
-			else {
-				printf("writing %s to rd (file)\n", dp->d_name);
-			}
 
-			// Seek to entry pos
-            fseek(out, fentrypos, SEEK_SET);
-            
-            // fill entry
-            memcpy(&rdentry.Name[0], dp->d_name, strlen(dp->d_name));
-            rdentry.Type = type;
-            rdentry.DataHeaderOffset = fdatapos;
-
-			// Write header data
-			fwrite(&rdentry, sizeof(MCoreRamDiskEntry_t), 1, out);
-			fflush(out);
-
-			// Update entry
-			fentrypos = ftell(out);
-
-			// Seek to data
-            fseek(out, fdatapos, SEEK_SET);
-            
-			// Load driver data?
-			if (drvdata != NULL) {
-				while (1) {
-					int result = GetNextLine(drvdata, tokens, &tokencount);
-					if (tokencount >= 3) {
-						// Skip comments
-						if (strncmp(tokens[0], "#", 1)) {
-							if (!strcmp(tokens[0], "VendorId")) {
-								vendorid = (uint32_t)strtol(tokens[2], NULL, 16);
-							}
-							if (!strcmp(tokens[0], "DeviceId")) {
-								deviceid = (uint32_t)strtol(tokens[2], NULL, 16);
-							}
-							if (!strcmp(tokens[0], "Class")) {
-								dclass = (uint32_t)strtol(tokens[2], NULL, 16);
-							}
-							if (!strcmp(tokens[0], "SubClass")) {
-								dsubclass = (uint32_t)strtol(tokens[2], NULL, 16);
-							}
-							if (!strcmp(tokens[0], "Flags")) {
-								dflags = (uint32_t)strtol(tokens[2], NULL, 16);
-							}
+		if (entrycount == entrycapacity) {
+			entrycapacity = entrycapacity == 0 ? 32 : entrycapacity * 2;
+			entries = realloc(entries, sizeof(RdEntry_t) * entrycapacity);
+		}
+		rdentry = &entries[entrycount++];
+		memset(rdentry, 0, sizeof(RdEntry_t));
+		snprintf(rdentry->Name, sizeof(rdentry->Name), "%s", dp->d_name);
+
+		// Is it a driver? check if file exists with .mdrv extension
+		FILE *drvdata = GetDriver(&filename_qfd[0]);
+		FILE *entry = NULL;
+		long fsize = 0;
+		rdentry->Type = drvdata == NULL ? RAMDISK_FILE : RAMDISK_MODULE;
+
+		// Load driver data?
+		if (drvdata != NULL) {
+			while (1) {
+				int result = GetNextLine(drvdata, tokens, &tokencount);
+				if (tokencount >= 3) {
+					// Skip comments
+					if (strncmp(tokens[0], "#", 1)) {
+						if (!strcmp(tokens[0], "VendorId")) {
+							rdentry->Header.Base.VendorId = (uint32_t)strtol(tokens[2], NULL, 16);
+						}
+						if (!strcmp(tokens[0], "DeviceId")) {
+							rdentry->Header.Base.DeviceId = (uint32_t)strtol(tokens[2], NULL, 16);
+						}
+						if (!strcmp(tokens[0], "Class")) {
+							rdentry->Header.Base.DeviceType = (uint32_t)strtol(tokens[2], NULL, 16);
+						}
+						if (!strcmp(tokens[0], "SubClass")) {
+							rdentry->Header.Base.DeviceSubType = (uint32_t)strtol(tokens[2], NULL, 16);
+						}
+						if (!strcmp(tokens[0], "Flags")) {
+							rdentry->Header.Base.Flags = (uint32_t)strtol(tokens[2], NULL, 16);
 						}
 					}
+				}
 
-					// Break on end of file
-					if (result) {
-						break;
-					}
+				// Break on end of file
+				if (result) {
+					break;
 				}
-				
-				// Cleanup
-				fclose(drvdata);
-            }
-            
-            // Update rest of header
-            rddataheader.VendorId = vendorid;
-            rddataheader.DeviceId = deviceid;
-            rddataheader.DeviceType = dclass;
-            rddataheader.DeviceSubType = dsubclass;
-            rddataheader.Flags = dflags;
-
-			// Load file data
-			entry = fopen(&filename_qfd[0], "rb+");
-			fseek(entry, 0, SEEK_END);
-			fsize = ftell(entry);
-			dataptr = malloc(fsize);
-			rewind(entry);
-			fread(dataptr, 1, fsize, entry);
-            fclose(entry);
-            
-			// Write data header
-            rddataheader.LengthOfData = fsize;
-            rddataheader.Crc32OfData = Crc32Generate(-1, (uint8_t*)dataptr, fsize);
-			fwrite(&rddataheader, sizeof(MCoreRamDiskModuleHeader_t), 1, out);
-
-			// Write file data
-			fwrite(dataptr, 1, fsize, out);
-			fflush(out);
-			free(dataptr);
+			}
+			fclose(drvdata);
+			modulecount++;
+			if (rdentry->Header.Base.VendorId != 0) {
+				devicecount++;
+			}
+		}
 
-			// Update data
-			fdatapos = ftell(out);
+		// Load file data
+		entry = fopen(&filename_qfd[0], "rb");
+		fseek(entry, 0, SEEK_END);
+		fsize = ftell(entry);
+		dataptr = malloc(fsize + 1);
+		rewind(entry);
+		fread(dataptr, 1, fsize, entry);
+		fclose(entry);
+
+		// Compress the data, keep it raw if it does not shrink
+		rdentry->Header.Base.LengthOfData = fsize;
+		rdentry->Header.Base.Crc32OfData = Crc32Generate(-1, dataptr, fsize);
+		rdentry->Stored = malloc(fsize + 1);
+		compressed = LzssCompress(dataptr, fsize, rdentry->Stored);
+		if (compressed != 0) {
+			rdentry->Header.Compression = RAMDISK_COMPRESSION_LZSS;
+			rdentry->Header.StoredLength = compressed;
+			free(dataptr);
 		}
+		else {
+			free(rdentry->Stored);
+			rdentry->Stored = dataptr;
+			rdentry->Header.Compression = RAMDISK_COMPRESSION_NONE;
+			rdentry->Header.StoredLength = fsize;
+		}
+		printf("writing %s to rd (%s, %li -> %u bytes)\n", rdentry->Name, 
+			rdentry->Type == RAMDISK_MODULE ? "driver" : "file", fsize, rdentry->Header.StoredLength);
 	}
-
-	// Close directory
 	closedir(dfd);
+	RdHeaderStatic.FileCount = entrycount;
+
+	// Layout: header, index header, entry table, string table, 
+	// path, device and class indices, and then the data
+	rdindex.PathBuckets = NextPowerOfTwo(entrycount);
+	rdindex.DeviceBuckets = NextPowerOfTwo(devicecount);
+	rdindex.ClassBuckets = NextPowerOfTwo(modulecount);
+	rdindex.EntryTableOffset = sizeof(MCoreRamDiskHeader_t) + sizeof(MCoreRamDiskIndexHeader_t);
+	stringoffset = rdindex.EntryTableOffset + (entrycount * sizeof(MCoreRamDiskEntryV2_t));
+	offset = stringoffset;
+	for (int i = 0; i < entrycount; i++) {
+		offset += strlen(entries[i].Name) + 1;
+	}
+	offset = (offset + 3) & ~3U;
+	rdindex.PathIndexOffset = offset;
+	offset += rdindex.PathBuckets * sizeof(MCoreRamDiskIndexSlot_t);
+	rdindex.DeviceIndexOffset = offset;
+	offset += rdindex.DeviceBuckets * sizeof(MCoreRamDiskIndexSlot_t);
+	rdindex.ClassIndexOffset = offset;
+	offset += rdindex.ClassBuckets * sizeof(MCoreRamDiskIndexSlot_t);
+
+	// Build the tables
+	rdentries = calloc(entrycount + 1, sizeof(MCoreRamDiskEntryV2_t));
+	pathslots = malloc(rdindex.PathBuckets * sizeof(MCoreRamDiskIndexSlot_t));
+	deviceslots = malloc(rdindex.DeviceBuckets * sizeof(MCoreRamDiskIndexSlot_t));
+	classslots = malloc(rdindex.ClassBuckets * sizeof(MCoreRamDiskIndexSlot_t));
+	memset(pathslots, 0xFF, rdindex.PathBuckets * sizeof(MCoreRamDiskIndexSlot_t));
+	memset(deviceslots, 0xFF, rdindex.DeviceBuckets * sizeof(MCoreRamDiskIndexSlot_t));
+	memset(classslots, 0xFF, rdindex.ClassBuckets * sizeof(MCoreRamDiskIndexSlot_t));
+	for (int i = 0; i < entrycount; i++) {
+		MCoreRamDiskModuleHeader_t *base = &entries[i].Header.Base;
+		rdentries[i].NameOffset = stringoffset;
+		rdentries[i].NameLength = strlen(entries[i].Name);
+		rdentries[i].Type = entries[i].Type;
+		rdentries[i].DataHeaderOffset = offset;
+		stringoffset += rdentries[i].NameLength + 1;
+		offset += sizeof(MCoreRamDiskModuleHeaderV2_t) + entries[i].Header.StoredLength;
+
+		IndexInsert(pathslots, rdindex.PathBuckets, RdHashName(entries[i].Name), i);
+		if (entries[i].Type == RAMDISK_MODULE) {
+			IndexInsert(classslots, rdindex.ClassBuckets, 
+				RdHashKey(base->DeviceType, base->DeviceSubType), i);
+			if (base->VendorId != 0) {
+				IndexInsert(deviceslots, rdindex.DeviceBuckets, 
+					RdHashKey(base->VendorId, base->DeviceId), i);
+			}
+		}
+	}
+
+	// Create the output file
+	out = fopen(argv[2], "wb+");
+	if (out == NULL) {
+		printf("%s was an invalid output file\n", argv[2]);
+		return 1;
+    }
+
+    printf("Generating ramdisk header\n");
+	fwrite(&RdHeaderStatic, 1, sizeof(MCoreRamDiskHeader_t), out);
+	fwrite(&rdindex, 1, sizeof(MCoreRamDiskIndexHeader_t), out);
+	fwrite(rdentries, sizeof(MCoreRamDiskEntryV2_t), entrycount, out);
+	for (int i = 0; i < entrycount; i++) {
+		fwrite(entries[i].Name, 1, strlen(entries[i].Name) + 1, out);
+	}
+	while (ftell(out) & 3) {
+		fputc(0, out);
+	}
+	fwrite(pathslots, sizeof(MCoreRamDiskIndexSlot_t), rdindex.PathBuckets, out);
+	fwrite(deviceslots, sizeof(MCoreRamDiskIndexSlot_t), rdindex.DeviceBuckets, out);
+	fwrite(classslots, sizeof(MCoreRamDiskIndexSlot_t), rdindex.ClassBuckets, out);
+	for (int i = 0; i < entrycount; i++) {
+		fwrite(&entries[i].Header, sizeof(MCoreRamDiskModuleHeaderV2_t), 1, out);
+		fwrite(entries[i].Stored, 1, entries[i].Header.StoredLength, out);
+		free(entries[i].Stored);
+	}
 
-	// Close and cleanup
+	// Cleanup
+	free(rdentries);
+	free(pathslots);
+	free(deviceslots);
+	free(classslots);
+	free(entries);
 	fflush(out);
 	return fclose(out);
 }
@@ -62,6 +62,9 @@ public:
 	 * Can be useful for boundary checks */
 	Rect_t *GetDimensions() { return &m_sDimensions; }
 
+	/* Get the number of bytes per row in the backbuffer */
+	size_t GetPitch() { return m_iBufferPitch; }
+
 	/* Helper, it combines different color components
 	 * into a full color, using color blend */
 	uint32_t GetBlendedColor(uint8_t RA, uint8_t GA, uint8_t BA, uint8_t AA,
@@ -28,6 +28,9 @@
 #include <ds/mstring.h>
 #include <cmath>
 #include <cctype>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /* FIXME: Right now we assume the gray-scale renderer Freetype is using
 supports 256 shades of gray, but we should instead key off of num_grays
@@ -61,6 +64,91 @@ in the result FT_Bitmap after the FT_Render_Glyph() call. */
 #define UNICODE_BOM_NATIVE  0xFEFF
 #define UNICODE_BOM_SWAPPED 0xFFFE
 
+/* Atlas preloading range, printable ascii is rasterized 
+ * when the font is set, everything else on first use */
+#define ATLAS_PRELOAD_FIRST	0x20
+#define ATLAS_PRELOAD_LAST	0x7E
+#define ATLAS_INITIAL_SLOTS	128
+
+/* DecodeUtf8
+ * Decodes a single utf-8 sequence into a BMP codepoint and returns
+ * the number of bytes consumed. Invalid sequences decode as '?' */
+static int DecodeUtf8(const unsigned char *Text, uint16_t *Character)
+{
+	if (Text[0] < 0x80) {
+		*Character = Text[0];
+		return 1;
+	}
+	else if ((Text[0] & 0xE0) == 0xC0 && (Text[1] & 0xC0) == 0x80) {
+		*Character = ((Text[0] & 0x1F) << 6) | (Text[1] & 0x3F);
+		return 2;
+	}
+	else if ((Text[0] & 0xF0) == 0xE0 && (Text[1] & 0xC0) == 0x80 
+		&& (Text[2] & 0xC0) == 0x80) {
+		*Character = ((Text[0] & 0x0F) << 12) | ((Text[1] & 0x3F) << 6) | (Text[2] & 0x3F);
+		return 3;
+	}
+	*Character = '?';
+	return 1;
+}
+
+/* BlendSpan
+ * Blends a span of coverage values between the background and the
+ * foreground color. Uses dest = (fg * a + bg * (256 - a)) >> 8 with
+ * the alpha scaled to 0..256, four pixels at a time when sse2 is present */
+static void BlendSpan(uint32_t *Destination, const uint8_t *Coverage, 
+	int Count, uint32_t Foreground, uint32_t Background)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	__m128i Zero = _mm_setzero_si128();
+	__m128i Fg = _mm_unpacklo_epi8(_mm_set1_epi32((int)Foreground), Zero);
+	__m128i Bg = _mm_unpacklo_epi8(_mm_set1_epi32((int)Background), Zero);
+	__m128i Full = _mm_set1_epi16(256);
+	for (; i + 4 <= Count; i += 4) {
+		uint32_t Packed;
+		memcpy(&Packed, &Coverage[i], sizeof(uint32_t));
+		if (Packed == 0) {
+			_mm_storeu_si128((__m128i*)&Destination[i], _mm_set1_epi32((int)Background));
+			continue;
+		}
+
+		/* Broadcast each alpha into the four channels of its pixel */
+		__m128i Alpha = _mm_cvtsi32_si128((int)Packed);
+		Alpha = _mm_unpacklo_epi8(Alpha, Alpha);
+		Alpha = _mm_unpacklo_epi16(Alpha, Alpha);
+		__m128i AlphaLo = _mm_unpacklo_epi8(Alpha, Zero);
+		__m128i AlphaHi = _mm_unpackhi_epi8(Alpha, Zero);
+		AlphaLo = _mm_add_epi16(AlphaLo, _mm_srli_epi16(AlphaLo, 7));
+		AlphaHi = _mm_add_epi16(AlphaHi, _mm_srli_epi16(AlphaHi, 7));
+
+		__m128i Lo = _mm_add_epi16(_mm_mullo_epi16(Fg, AlphaLo),
+			_mm_mullo_epi16(Bg, _mm_sub_epi16(Full, AlphaLo)));
+		__m128i Hi = _mm_add_epi16(_mm_mullo_epi16(Fg, AlphaHi),
+			_mm_mullo_epi16(Bg, _mm_sub_epi16(Full, AlphaHi)));
+		_mm_storeu_si128((__m128i*)&Destination[i], 
+			_mm_packus_epi16(_mm_srli_epi16(Lo, 8), _mm_srli_epi16(Hi, 8)));
+	}
+#endif
+	for (; i < Count; i++) {
+		uint32_t Alpha = Coverage[i];
+		if (Alpha == 0) {
+			Destination[i] = Background;
+		}
+		else if (Alpha == 0xFF) {
+			Destination[i] = Foreground;
+		}
+		else {
+			Alpha += Alpha >> 7;
+			uint32_t RB = (((Foreground & 0xFF00FF) * Alpha) 
+				+ ((Background & 0xFF00FF) * (256 - Alpha))) >> 8;
+			uint32_t AG = (((Foreground >> 8) & 0xFF00FF) * Alpha) 
+				+ (((Background >> 8) & 0xFF00FF) * (256 - Alpha));
+			Destination[i] = (RB & 0xFF00FF) | (AG & 0xFF00FF00);
+		}
+	}
+}
+
 /* Constructor 
  * - We use this to instantiate a drawing surface */
 Terminal::Terminal()
@@ -68,6 +156,15 @@ Terminal::Terminal()
 	/* Store params and setup initial values */
 	m_bIsAlive = true;
 	m_pActiveFont = NULL;
+	memset(&m_sAtlas, 0, sizeof(m_sAtlas));
+	m_pCells = NULL;
+	m_pRendered = NULL;
+	m_pDirty = NULL;
+	m_iRowOrigin = 0;
+	m_iCursorPositionX = 0;
+	m_iCursorPositionY = 0;
+	m_iFontWidth = 0;
+	m_iFontHeight = 0;
 
 	/* Set default size of 80/25 */
 	m_iColumns = 80;
@@ -81,6 +178,15 @@ Terminal::Terminal()
 	/* Initialize render surface */
 	m_pSurface = new Surface();
 
+	/* Default colors, white on black */
+	m_cFgR = m_cFgG = m_cFgB = m_cFgA = 0xFF;
+	m_cBgR = m_cBgG = m_cBgB = 0; m_cBgA = 0xFF;
+	m_uForeground = m_pSurface->GetColor(m_cFgR, m_cFgG, m_cFgB, m_cFgA);
+	m_uBackground = m_pSurface->GetColor(m_cBgR, m_cBgG, m_cBgB, m_cBgA);
+	if (!AllocateGrid()) {
+		m_bIsAlive = false;
+	}
+
 	/* Initialize a new instance of freetype
 	 * so we can use the font engine */
 	if (FT_Init_FreeType(&m_pFreeType)) {
@@ -123,6 +229,8 @@ Terminal::~Terminal()
 	/* Cleanup Font */
 	if (m_pActiveFont != NULL)
 		CleanupFont(m_pActiveFont);
+	CleanupAtlas();
+	CleanupGrid();
 
 	/* Cleanup freetype */
 	if (m_pFreeType != NULL)
@@ -173,7 +281,7 @@ void Terminal::NewCommand()
 						int SavedX = m_iCursorPositionX, SavedY = m_iCursorPositionY;
 
 						for (int i = m_iLinePos; i<strlen(m_pCurrentLine); i++)
-							AddCharacter(m_pCurrentLine[i]); //AddChar
+							AddCharacter((unsigned char)m_pCurrentLine[i]); //AddChar
 						for (int i = 0; i < 4; i++)
 							AddCharacter(' '); //AddChar
 
@@ -205,7 +313,7 @@ void Terminal::NewCommand()
 
 					/* Add the characters */
 					for (int i = m_iLinePos; i<strlen(m_pCurrentLine); i++)
-						AddCharacter(m_pCurrentLine[i]);
+						AddCharacter((unsigned char)m_pCurrentLine[i]);
 					AddCharacter(' ');
 					
 					/* Restore position */
@@ -279,9 +387,20 @@ bool Terminal::SetSize(int Columns, int Rows)
 {
 	/* If we have no font, then we can't adjust accordingly
 	 * so lets avoid a resize */
+	int OldColumns = m_iColumns, OldRows = m_iRows;
 	m_iColumns = Columns;
 	m_iRows = Rows;
 
+	/* Rebuild the cell grid for the new dimensions */
+	if (m_pCells == NULL || Columns != OldColumns || Rows != OldRows) {
+		CleanupGrid();
+		if (!AllocateGrid()) {
+			return false;
+		}
+		m_iCursorPositionX = 0;
+		m_iCursorPositionY = 0;
+	}
+
 	/* Sanitize */
 	if (m_pActiveFont != NULL)
 		m_pSurface->Resize(Columns * (m_pActiveFont->Face->size->metrics.max_advance >> 6),
@@ -483,6 +602,13 @@ bool Terminal::SetFont(const char *FontPath, int SizePt)
 	FindGlyph(m_pActiveFont, 'A', CACHED_METRICS);
 	m_iFontWidth = Font->Current->Advance;
 
+	/* Pre-rasterize the glyphs for the new font and 
+	 * force a redraw of all cells */
+	if (!BuildAtlas()) {
+		return false;
+	}
+	InvalidateGrid();
+
 	/* Done! 
 	 * But the last thing to do here is to update the 
 	 * size of the terminal */
@@ -499,6 +625,7 @@ bool Terminal::SetTextColor(uint8_t r, uint8_t b, uint8_t g, uint8_t a)
 	m_cFgG = g;
 	m_cFgB = b;
 	m_cFgA = a;
+	m_uForeground = m_pSurface->GetColor(m_cFgR, m_cFgG, m_cFgB, m_cFgA);
 
 	/* Done! */
 	return true;
@@ -515,8 +642,18 @@ bool Terminal::SetBackgroundColor(uint8_t r, uint8_t b, uint8_t g, uint8_t a)
 	m_cBgB = b;
 	m_cBgA = a;
 
-	/* Clear out surface */
-	m_pSurface->Clear(m_pSurface->GetColor(r, g, b, a), NULL);
+	/* Recolor all cells that use the old background */
+	uint32_t Previous = m_uBackground;
+	m_uBackground = m_pSurface->GetColor(m_cBgR, m_cBgG, m_cBgB, m_cBgA);
+	for (int i = 0; m_pCells != NULL && i < (m_iColumns * m_iRows); i++) {
+		if (m_pCells[i].Background == Previous) {
+			m_pCells[i].Background = m_uBackground;
+		}
+	}
+
+	/* Clear out surface, everything must be redrawn */
+	m_pSurface->Clear(m_uBackground, NULL);
+	InvalidateGrid();
 
 	/* Done! */
 	return true;
@@ -575,10 +712,16 @@ void Terminal::AddText(char *Message, ...)
 	{
 		/* Extract character 
 		 * and keep a copy of the char */
-		int c = Line[i++];
-		int cc = c;
+		uint16_t c;
+		i += DecodeUtf8((const unsigned char*)&Line[i], &c);
+		uint16_t cc = c;
 		int dx = 1;
 
+		/* Skip byte order marks */
+		if (c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED) {
+			continue;
+		}
+
 		/* Newline? */
 		if (c == '\n') {
 			m_iCursorPositionX = 0;
@@ -607,23 +750,17 @@ void Terminal::AddText(char *Message, ...)
 		}
 	}
 
-	/* Invalidate surface */
-	m_pSurface->Invalidate(0, 0, -1, -1);
+	/* Render changed cells */
+	Flush();
 }
 
 /* Shorthand for the above function, instead of 
  * adding an entire message, just add a single character */
-void Terminal::AddCharacter(char Character)
+void Terminal::AddCharacter(uint16_t Character)
 {
-	/* Buffer */
-	char cBuffer[] = " ";
-
-	/* Update */
-	cBuffer[0] = Character;
-
-	/* Render the character */
-	RenderText(m_iCursorPositionX * m_iFontWidth,
-		m_iCursorPositionY * m_iFontHeight, cBuffer);
+	/* Store the character, it gets rendered on next flush */
+	SetCell(m_iCursorPositionX, m_iCursorPositionY, 
+		Character, m_uForeground, m_uBackground);
 	m_iCursorPositionX++;
 
 	/* Boundary check on width */
@@ -749,7 +886,6 @@ void Terminal::NewLine()
 void Terminal::HideCursor()
 {
 	/* Variables */
-	char cBuffer[] = " ";
 	char c = ' ';
 
 	/* Determine where to put the cursor in case
@@ -760,33 +896,17 @@ void Terminal::HideCursor()
 			c = ' ';
 	}
 
-	/* Update buffer */
-	cBuffer[0] = c;
-
 	/* 'Render' the cursor */
-	RenderText(m_iCursorPositionX * m_iFontWidth,
-		m_iCursorPositionY * m_iFontHeight, cBuffer);
+	SetCell(m_iCursorPositionX, m_iCursorPositionY, 
+		(unsigned char)c, m_uForeground, m_uBackground);
 }
 
 /* Render the cursor in reverse colors, this will give the
  * effect of a big fat block that acts as cursor */
 void Terminal::ShowCursor()
 {
-	/* Get foreground and bg colors */
-	char cBuffer[] = " ";
+	/* Variables */
 	char c = ' ';
-	int r = 0;
-
-	/* Store colors */
-	uint8_t BgR = m_cBgR; uint8_t BgG = m_cBgG;
-	uint8_t BgB = m_cBgB; uint8_t BgA = m_cBgA;
-
-	uint8_t FgR = m_cFgR; uint8_t FgG = m_cFgG;
-	uint8_t FgB = m_cFgB; uint8_t FgA = m_cFgA;
-
-	/* Setup cursor colors, by swapping fg/bg */
-	m_cFgR = BgR; m_cFgG = BgG; m_cFgB = BgB; m_cFgA = BgA;
-	m_cBgR = FgR; m_cBgG = FgG; m_cBgB = FgB; m_cBgA = FgA;
 
 	/* Where should we render it? */
 	if (m_iLinePos < strlen(m_pCurrentLine)) {
@@ -795,16 +915,11 @@ void Terminal::ShowCursor()
 			c = ' ';
 	}
 
-	/* Update buffer */
-	cBuffer[0] = c;
-
-	/* Render the cursor */
-	RenderText(m_iCursorPositionX * m_iFontWidth,
-		m_iCursorPositionY * m_iFontHeight, cBuffer);
-
-	/* Restore colors */
-	m_cFgR = FgR; m_cFgG = FgG; m_cFgB = FgB; m_cFgA = FgA;
-	m_cBgR = BgR; m_cBgG = BgG; m_cBgB = BgB; m_cBgA = BgA;
+	/* Render the cursor by swapping fg/bg, this is the last
+	 * step of every edit, so flush the changes out */
+	SetCell(m_iCursorPositionX, m_iCursorPositionY, 
+		(unsigned char)c, m_uBackground, m_uForeground);
+	Flush();
 }
 
 /* Add given character to current line */
@@ -843,38 +958,28 @@ int Terminal::RemoveChar(int Position)
 	return 0;
 }
 
-/* Clear out lines from the given col/row 
+/* Clear out lines from the given col/row
  * so it is ready for new data */
 void Terminal::ClearFrom(int Column, int Row)
 {
-	/* Make sure columns are valid */
-	if ((Column <= (m_iColumns - 1)) && (Row <= (m_iRows - 1))) 
-	{
-		/* Create dest area */
-		Rect_t Destination = {
-			Column * m_iFontWidth,
-			Row * m_iFontHeight,
-			(m_iRows - Row) * m_iFontHeight,
-			(m_iColumns - Column) * m_iFontWidth
-		};
-
-		/* Clear */
-		m_pSurface->Clear(m_pSurface->GetColor(m_cBgR, m_cBgG, m_cBgB, m_cBgA), &Destination);
+	/* Sanitize the position */
+	if (Row < 0 || Row >= m_iRows) {
+		return;
+	}
+	if (Column < 0) {
+		Column = 0;
 	}
 
-	/* Make sure row is valid */
-	if (Row < (m_iRows - 1)) 
-	{
-		/* Create dest area */
-		Rect_t Destination = { 
-			0, 
-			(Row + 1) * m_iFontHeight,
-			(m_iRows - Row - 1) * m_iFontHeight,
-			m_iColumns * m_iFontWidth
-		};
+	/* Clear the remainder of the given row */
+	for (int i = Column; i < m_iColumns; i++) {
+		SetCell(i, Row, ' ', m_uForeground, m_uBackground);
+	}
 
-		/* Clear */
-		m_pSurface->Clear(m_pSurface->GetColor(m_cBgR, m_cBgG, m_cBgB, m_cBgA), &Destination);
+	/* Clear all rows below */
+	for (int j = Row + 1; j < m_iRows; j++) {
+		for (int i = 0; i < m_iColumns; i++) {
+			SetCell(i, j, ' ', m_uForeground, m_uBackground);
+		}
 	}
 }
 
@@ -885,184 +990,340 @@ void Terminal::ScrollText(int Lines)
 	/* Sanitize limits */
 	if (Lines >= m_iRows)
 		Lines = m_iRows;
+	if (Lines <= 0)
+		return;
 
-	/* We do a memcpy */
-	if (Lines < m_iRows) 
-	{
-		/* Calculate source pointer and how much to copy */
-		uint8_t *SourcePtr = (uint8_t*)m_pSurface->DataPtr(0, Lines * m_iFontHeight);
-		size_t BytesToCopy = m_pSurface->GetDimensions()->w * 
-			(m_pSurface->GetDimensions()->h - Lines * m_iFontHeight) * 4;
+	/* Move the ring origin, the rows that wrap around
+	 * becomes the new bottom rows and must be cleared */
+	m_iRowOrigin = (m_iRowOrigin + Lines) % m_iRows;
+	for (int j = m_iRows - Lines; j < m_iRows; j++) {
+		TerminalCell_t *Cell = GetCell(0, j);
+		for (int i = 0; i < m_iColumns; i++, Cell++) {
+			Cell->Character = ' ';
+			Cell->Foreground = m_uForeground;
+			Cell->Background = m_uBackground;
+		}
+	}
 
-		/* Calculate destination pointer */
-		uint8_t *DestPtr = (uint8_t*)m_pSurface->DataPtr(0, 0);
+	/* Every screen position may have changed, the flush compares against
+	 * the shadow grid so unchanged cells are not redrawn */
+	memset(m_pDirty, 0xFF, (((m_iColumns * m_iRows) + 31) / 32) * sizeof(uint32_t));
+}
 
-		/* Copy */
-		memcpy(DestPtr, SourcePtr, BytesToCopy);
+/* Allocates the cell grid, the shadow grid and the dirty
+ * bitmap for the current dimensions, all cells start out blank */
+bool Terminal::AllocateGrid()
+{
+	/* Variables */
+	size_t Count = m_iColumns * m_iRows;
+
+	/* Allocate resources */
+	m_pCells = (TerminalCell_t*)malloc(Count * sizeof(TerminalCell_t));
+	m_pRendered = (TerminalCell_t*)malloc(Count * sizeof(TerminalCell_t));
+	m_pDirty = (uint32_t*)malloc(((Count + 31) / 32) * sizeof(uint32_t));
+	if (m_pCells == NULL || m_pRendered == NULL || m_pDirty == NULL) {
+		CleanupGrid();
+		return false;
 	}
 
-	/* Clear remaining lines */
-	ClearFrom(0, m_iRows - Lines);
+	/* Reset all cells */
+	for (size_t i = 0; i < Count; i++) {
+		m_pCells[i].Character = ' ';
+		m_pCells[i].Foreground = m_uForeground;
+		m_pCells[i].Background = m_uBackground;
+	}
+	m_iRowOrigin = 0;
+	InvalidateGrid();
+	return true;
 }
 
-/* Text Rendering 
- * This is our primary render function, 
- * it renders text at a specific position on the buffer 
- * TODO ERASE */
-void Terminal::RenderText(int AtX, int AtY, const char *Text)
+/* Releases the cell grid resources */
+void Terminal::CleanupGrid()
 {
-	/* Variables for state tracking, 
-	 * and formatting, and rendering */
-	int BitmapMode = CACHED_PIXMAP;
-	bool First;
-	int xStart;
-	int Width;
-	uint8_t *Source;
-	uint32_t *Destination;
-	uint32_t *DestCheck;
-	int Row, Col;
-	FontGlyph_t *Glyph;
+	if (m_pCells != NULL) {
+		free(m_pCells);
+	}
+	if (m_pRendered != NULL) {
+		free(m_pRendered);
+	}
+	if (m_pDirty != NULL) {
+		free(m_pDirty);
+	}
+	m_pCells = NULL;
+	m_pRendered = NULL;
+	m_pDirty = NULL;
+}
 
-	/* Iterating Text */
-	MString_t *mText;
-	size_t ItrLength = 0;
-	char *mItr = NULL;
+/* Forgets everything about the surface contents, so
+ * the next flush redraws every cell */
+void Terminal::InvalidateGrid()
+{
+	/* Variables */
+	size_t Count = m_iColumns * m_iRows;
 
-	/* FT Variables and stuff for text */
-	FT_Bitmap *Current;
-	FT_Error Error;
-	FT_Long UseKerning;
-	FT_UInt PreviousIndex = 0;
+	if (m_pRendered == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < Count; i++) {
+		m_pRendered[i].Character = TERMINAL_CELL_INVALID;
+	}
+	memset(m_pDirty, 0xFF, ((Count + 31) / 32) * sizeof(uint32_t));
+}
 
-	/* Sanity */
-	if (m_pActiveFont == NULL) {
+/* Retrieves the cell at the given screen position,
+ * translated through the ring origin */
+TerminalCell_t *Terminal::GetCell(int Column, int Row)
+{
+	return &m_pCells[(((m_iRowOrigin + Row) % m_iRows) * m_iColumns) + Column];
+}
+
+/* Updates a cell and marks its screen position dirty */
+void Terminal::SetCell(int Column, int Row, uint16_t Character,
+	uint32_t Foreground, uint32_t Background)
+{
+	/* Variables */
+	TerminalCell_t *Cell;
+	int Index;
+
+	/* Sanitize the position */
+	if (Column < 0 || Column >= m_iColumns
+		|| Row < 0 || Row >= m_iRows) {
 		return;
 	}
 
-	/* Adding bound checking to avoid all kinds of memory corruption errors
-	 * that may occur. */
-	DestCheck = (uint32_t*)m_pSurface->DataPtr() + 
-		((m_pSurface->GetDimensions()->w * 4) * m_pSurface->GetDimensions()->h);
+	/* Update the cell */
+	Cell = GetCell(Column, Row);
+	Cell->Character = Character;
+	Cell->Foreground = Foreground;
+	Cell->Background = Background;
 
-	/* check kerning */
-	UseKerning = FT_HAS_KERNING(m_pActiveFont->Face) && m_pActiveFont->Kerning;
+	/* Mark it dirty */
+	Index = (Row * m_iColumns) + Column;
+	m_pDirty[Index / 32] |= (1U << (Index % 32));
+}
 
-	/* Initialise for the loop */
-	mText = MStringCreate((void*)Text, StrUTF8);
-	First = true;
-	xStart = 0;
+/* Renders all cells that changed since the last flush, and
+ * invalidates the bounding rectangle of them on the surface */
+void Terminal::Flush()
+{
+	/* Variables */
+	int Count = m_iColumns * m_iRows;
+	int MinColumn = m_iColumns, MinRow = m_iRows;
+	int MaxColumn = -1, MaxRow = -1;
 
-	/* Load and render each character */
-	while (true) 
-	{
-		/* Get next character of text-string */
-		uint16_t Character = (uint16_t)MStringGetCharAt(mText, ItrLength++);
-		if (Character == UNICODE_BOM_NATIVE 
-			|| Character == UNICODE_BOM_SWAPPED) {
-			continue;
-		}
+	/* Sanity, we can't render without a font */
+	if (m_pActiveFont == NULL || m_pCells == NULL) {
+		return;
+	}
 
-		/* End of string? */
-		if (Character == MSTRING_EOS) {
-			break;
-		}
+	/* Iterate the dirty bitmap a word at the time */
+	for (int w = 0; w < (Count + 31) / 32; w++) {
+		uint32_t Bits = m_pDirty[w];
+		m_pDirty[w] = 0;
+		while (Bits) {
+			int Index = (w * 32) + __builtin_ctz(Bits);
+			Bits &= Bits - 1;
+			if (Index >= Count) {
+				break;
+			}
 
-		/* Lookup glyph for the character, if we have none, 
-		 * we bail! */
-		Error = FindGlyph(m_pActiveFont, Character, CACHED_METRICS | BitmapMode);
-		if (Error) {
-			break;
+			/* Skip the cell if the surface already contains it */
+			int Row = Index / m_iColumns;
+			int Column = Index % m_iColumns;
+			TerminalCell_t *Cell = GetCell(Column, Row);
+			TerminalCell_t *Shadow = &m_pRendered[Index];
+			if (Shadow->Character == Cell->Character
+				&& Shadow->Foreground == Cell->Foreground
+				&& Shadow->Background == Cell->Background) {
+				continue;
+			}
+
+			/* Draw it and grow the damaged area */
+			RenderCell(Column, Row, Cell);
+			*Shadow = *Cell;
+			if (Column < MinColumn) MinColumn = Column;
+			if (Column > MaxColumn) MaxColumn = Column;
+			if (Row < MinRow) MinRow = Row;
+			if (Row > MaxRow) MaxRow = Row;
 		}
+	}
 
-		/* Shorthand some stuff */
-		Glyph = m_pActiveFont->Current;
+	/* Invalidate the damaged area */
+	if (MaxRow >= 0) {
+		m_pSurface->Invalidate(MinColumn * m_iFontWidth, MinRow * m_iFontHeight,
+			(MaxColumn - MinColumn + 1) * m_iFontWidth,
+			(MaxRow - MinRow + 1) * m_iFontHeight);
+	}
+}
 
-		/* Get the appropriate bitmap */
-		if (BitmapMode & CACHED_BITMAP) {
-			Current = &Glyph->Bitmap;
-		}
-		else {
-			Current = &Glyph->Pixmap;
-		}
+/* Cell Rendering
+ * Blends the atlas coverage of a single cell onto the surface */
+void Terminal::RenderCell(int Column, int Row, const TerminalCell_t *Cell)
+{
+	/* Variables */
+	const uint8_t *Coverage = GetGlyphCoverage(Cell->Character);
+	Rect_t *Dimensions = m_pSurface->GetDimensions();
+	size_t Pitch = m_pSurface->GetPitch();
+	int x = Column * m_sAtlas.CellWidth;
+	int y = Row * m_sAtlas.CellHeight;
+	int Width = m_sAtlas.CellWidth;
+	int Height = m_sAtlas.CellHeight;
+	uint8_t *Destination;
+
+	/* Clip against the surface to avoid
+	 * corrupting memory outside the buffer */
+	if (x >= Dimensions->w || y >= Dimensions->h) {
+		return;
+	}
+	if (x + Width > Dimensions->w) {
+		Width = Dimensions->w - x;
+	}
+	if (y + Height > Dimensions->h) {
+		Height = Dimensions->h - y;
+	}
 
-		/* Ensure the width of the pixmap is correct. On some cases,
-		 * freetype may report a larger pixmap than possible.*/
-		Width = Current->width;
-		if (m_pActiveFont->Outline <= 0 && Width > Glyph->MaxX - Glyph->MinX) {
-			Width = Glyph->MaxX - Glyph->MinX;
-		}
+	/* Blend each row of the cell */
+	Destination = (uint8_t*)m_pSurface->DataPtr(x, y);
+	for (int i = 0; i < Height; i++) {
+		BlendSpan((uint32_t*)Destination, Coverage, Width,
+			Cell->Foreground, Cell->Background);
+		Destination += Pitch;
+		Coverage += m_sAtlas.Pitch;
+	}
+}
 
-		/* do kerning, if possible AC-Patch */
-		if (UseKerning && PreviousIndex && Glyph->Index) {
-			FT_Vector Delta;
-			FT_Get_Kerning(m_pActiveFont->Face, PreviousIndex, Glyph->Index, FT_KERNING_DEFAULT, &Delta);
-			xStart += Delta.x >> 6;
-		}
+/* Builds the glyph atlas for the active font, the printable
+ * ascii range is rasterized immediately. Slot 0 is always blank */
+bool Terminal::BuildAtlas()
+{
+	/* Cleanup the previous atlas */
+	CleanupAtlas();
+
+	/* Setup the cell geometry, pitch is kept 16 byte aligned */
+	m_sAtlas.CellWidth = m_iFontWidth;
+	m_sAtlas.CellHeight = m_iFontHeight;
+	m_sAtlas.Pitch = (m_iFontWidth + 15) & ~15;
+	m_sAtlas.SlotSize = m_sAtlas.Pitch * m_sAtlas.CellHeight;
+	m_sAtlas.SlotCapacity = ATLAS_INITIAL_SLOTS;
+	m_sAtlas.SlotCount = 1;
+	m_sAtlas.Coverage = (uint8_t*)malloc(m_sAtlas.SlotCapacity * m_sAtlas.SlotSize);
+	if (m_sAtlas.Coverage == NULL) {
+		return false;
+	}
+	memset(m_sAtlas.Coverage, 0, m_sAtlas.SlotSize);
 
-		/* Compensate for wrap around bug with negative minx's */
-		if (First && (Glyph->MinX < 0)) {
-			xStart -= Glyph->MinX;
-		}
+	/* Preload the printable range */
+	for (uint16_t c = ATLAS_PRELOAD_FIRST; c <= ATLAS_PRELOAD_LAST; c++) {
+		GetGlyphCoverage(c);
+	}
 
-		/* No longer the first! */
-		First = false;
+	/* The freetype renders are no longer needed */
+	FlushCache(m_pActiveFont);
+	return true;
+}
 
-		/* Iterate over rows and actually draw it */
-		for (Row = 0; Row < Current->rows; Row++) {
-			/* Make sure we don't go either over, or under the
-			 * limit */
-			if ((Row + Glyph->yOffset) < 0
-				|| Row + Glyph->yOffset >= m_pSurface->GetDimensions()->h) {
-				continue;
-			}
-			
-			/* Calculate destination */
-			Destination = (uint32_t*)m_pSurface->DataPtr(
-				AtX + xStart + Glyph->MinX, AtY + Row + Glyph->yOffset);
-			Source = Current->buffer + (Row * Current->pitch);
-
-			/* Loop ! */
-			for (Col = Width; Col > 0 && Destination < DestCheck; --Col) {
-				uint8_t Alpha = *Source++;
-				if (Alpha == 0) {
-					*Destination++ = m_pSurface->GetColor(m_cBgR, m_cBgG, m_cBgB, m_cBgA);
-				}
-				else {
-					if (BitmapMode & CACHED_BITMAP) {
-						*Destination++ = m_pSurface->GetColor(m_cFgR, m_cFgG, m_cFgB, m_cFgA);
-					}
-					else {
-						*Destination++ = m_pSurface->GetBlendedColor(m_cBgR, m_cBgG, m_cBgB, m_cBgA, 
-							m_cFgR, m_cFgG, m_cFgB, m_cFgA, Alpha);
-					}
-				}
-			}
+/* Releases all resources of the glyph atlas */
+void Terminal::CleanupAtlas()
+{
+	for (int i = 0; i < 256; i++) {
+		if (m_sAtlas.Pages[i] != NULL) {
+			free(m_sAtlas.Pages[i]);
 		}
+	}
+	if (m_sAtlas.Coverage != NULL) {
+		free(m_sAtlas.Coverage);
+	}
+	memset(&m_sAtlas, 0, sizeof(m_sAtlas));
+}
 
-		/* Advance, and handle bold style if neccassary */
-		xStart += Glyph->Advance;
-		if (TTF_HANDLE_STYLE_BOLD(m_pActiveFont)) {
-			xStart += m_pActiveFont->GlyphOverhang;
+/* Retrieves the coverage map of the given character
+ * from the atlas, and rasterizes it if not present */
+const uint8_t *Terminal::GetGlyphCoverage(uint16_t Character)
+{
+	/* Variables */
+	uint16_t **Page = &m_sAtlas.Pages[Character >> 8];
+	uint16_t *Slot;
+
+	/* Lookup the page, allocate if not present */
+	if (*Page == NULL) {
+		*Page = (uint16_t*)malloc(256 * sizeof(uint16_t));
+		if (*Page == NULL) {
+			return m_sAtlas.Coverage;
 		}
+		memset(*Page, 0xFF, 256 * sizeof(uint16_t));
+	}
 
-		/* Set new previous index */
-		PreviousIndex = Glyph->Index;
+	/* Rasterize on first use */
+	Slot = &(*Page)[Character & 0xFF];
+	if (*Slot == TERMINAL_ATLAS_NOSLOT) {
+		*Slot = (uint16_t)RasterizeGlyph(Character);
 	}
+	return m_sAtlas.Coverage + (*Slot * m_sAtlas.SlotSize);
+}
 
-	/* Handle the underline style 
-	if (TTF_HANDLE_STYLE_UNDERLINE(font)) {
-		row = TTF_underline_top_row(font);
-		TTF_drawLine_Solid(font, textbuf, row);
-	} */
+/* Renders a glyph through freetype and stores the cell-aligned
+ * coverage in a new atlas slot. Returns the slot, 0 on failure */
+int Terminal::RasterizeGlyph(uint16_t Character)
+{
+	/* Variables */
+	FontGlyph_t *Glyph;
+	FT_Bitmap *Pixmap;
+	uint8_t *Destination;
+	int OffsetX, Width;
+	int Slot;
+
+	/* Whitespace and unrenderable glyphs use the blank slot */
+	if (Character == ' ' || m_pActiveFont == NULL || m_sAtlas.Coverage == NULL
+		|| FindGlyph(m_pActiveFont, Character, CACHED_METRICS | CACHED_PIXMAP)) {
+		return 0;
+	}
+	if (m_sAtlas.SlotCount == TERMINAL_ATLAS_NOSLOT) {
+		return 0;
+	}
 
-	/* Handle the strikethrough style
-	if (TTF_HANDLE_STYLE_STRIKETHROUGH(font)) {
-		row = TTF_strikethrough_top_row(font);
-		TTF_drawLine_Solid(font, textbuf, row);
-	}  */
+	/* Grow the atlas if it's full */
+	if (m_sAtlas.SlotCount == m_sAtlas.SlotCapacity) {
+		int Capacity = m_sAtlas.SlotCapacity * 2;
+		if (Capacity > TERMINAL_ATLAS_NOSLOT) {
+			Capacity = TERMINAL_ATLAS_NOSLOT;
+		}
+		uint8_t *Coverage = (uint8_t*)realloc(m_sAtlas.Coverage, Capacity * m_sAtlas.SlotSize);
+		if (Coverage == NULL) {
+			return 0;
+		}
+		m_sAtlas.Coverage = Coverage;
+		m_sAtlas.SlotCapacity = Capacity;
+	}
 
-	/* Cleanup */
-	MStringDestroy(mText);
+	/* Allocate a slot */
+	Slot = m_sAtlas.SlotCount++;
+	Destination = m_sAtlas.Coverage + (Slot * m_sAtlas.SlotSize);
+	memset(Destination, 0, m_sAtlas.SlotSize);
+
+	/* Ensure the width of the pixmap is correct. On some cases,
+	 * freetype may report a larger pixmap than possible. Negative
+	 * minx's are compensated by placing the glyph at the cell start */
+	Glyph = m_pActiveFont->Current;
+	Pixmap = &Glyph->Pixmap;
+	Width = Pixmap->width;
+	if (m_pActiveFont->Outline <= 0 && Width > Glyph->MaxX - Glyph->MinX) {
+		Width = Glyph->MaxX - Glyph->MinX;
+	}
+	OffsetX = (Glyph->MinX < 0) ? 0 : Glyph->MinX;
+	if (OffsetX + Width > m_sAtlas.CellWidth) {
+		Width = m_sAtlas.CellWidth - OffsetX;
+	}
+
+	/* Copy the rows that fit into the cell */
+	for (int Row = 0; Row < (int)Pixmap->rows && Width > 0; Row++) {
+		int y = Row + Glyph->yOffset;
+		if (y < 0 || y >= m_sAtlas.CellHeight) {
+			continue;
+		}
+		memcpy(Destination + (y * m_sAtlas.Pitch) + OffsetX,
+			Pixmap->buffer + (Row * Pixmap->pitch), Width);
+	}
+	return Slot;
 }
 
 /* This cleans up a stored glyph and 
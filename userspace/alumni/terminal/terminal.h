@@ -103,6 +103,33 @@ struct TerminalFont
 	int Hinting;
 };
 
+/* Pre-rasterized glyph atlas for the active font and size
+ * Every glyph is stored as a cell-sized coverage map, so drawing
+ * a cell is a single blend pass without touching freetype. Codepoints
+ * are mapped to slots through lazily allocated pages of 256 entries */
+#define TERMINAL_ATLAS_NOSLOT	0xFFFF
+typedef struct TerminalGlyphAtlas
+{
+	int CellWidth;
+	int CellHeight;
+	int Pitch;
+	size_t SlotSize;
+	int SlotCount;
+	int SlotCapacity;
+	uint8_t *Coverage;
+	uint16_t *Pages[256];
+} TerminalGlyphAtlas_t;
+
+/* A single character cell of the terminal grid, colors
+ * are stored pre-packed in the surface pixel format */
+#define TERMINAL_CELL_INVALID	0xFFFF
+typedef struct TerminalCell
+{
+	uint16_t Character;
+	uint32_t Foreground;
+	uint32_t Background;
+} TerminalCell_t;
+
 /* Class */
 class Terminal
 {
@@ -140,6 +167,22 @@ private:
 		uint16_t Character, FontGlyph_t* Cached, int Want);
 	FT_Error FindGlyph(TerminalFont* Font, uint16_t Character, int Want);
 
+	/* Glyph atlas functions, the atlas is rebuilt on font changes
+	 * and glyphs outside the preloaded range are rasterized on first use */
+	bool BuildAtlas();
+	void CleanupAtlas();
+	int RasterizeGlyph(uint16_t Character);
+	const uint8_t *GetGlyphCoverage(uint16_t Character);
+
+	/* Cell grid functions, rows are stored in a ring so scrolling
+	 * only moves the origin. Changes are tracked by per-cell dirty bits */
+	bool AllocateGrid();
+	void CleanupGrid();
+	TerminalCell_t *GetCell(int Column, int Row);
+	void SetCell(int Column, int Row, uint16_t Character, 
+		uint32_t Foreground, uint32_t Background);
+	void InvalidateGrid();
+
 	/* Add text to the buffer, this ensures
 	 * we can transfer it to history afterwards */ 
 	void AddTextBuffer(char *Message, ...);
@@ -169,10 +212,13 @@ private:
 	 * in it's normal colors, this will effectively hide it */
 	void HideCursor();
 
-	/* Text Rendering 
-	 * This is our primary render function, 
-	 * it renders text at a specific position on the buffer */
-	void RenderText(int AtX, int AtY, const char *Text);
+	/* Cell Rendering 
+	 * Blends the atlas coverage of a single cell onto the surface */
+	void RenderCell(int Column, int Row, const TerminalCell_t *Cell);
+
+	/* Renders all cells that changed since the last flush, and
+	 * invalidates the bounding rectangle of them on the surface */
+	void Flush();
 
 	/* Scroll the terminal by a number of lines
 	 * and clear below the scrolled lines */
@@ -183,7 +229,7 @@ private:
 	void ClearFrom(int Column, int Row);
 
 	/* Text Functions */
-	void AddCharacter(char Character);
+	void AddCharacter(uint16_t Character);
 
 	/* Private - Data */
 	TerminalFont *m_pActiveFont;
@@ -222,6 +268,16 @@ private:
 	/* Colors */
 	uint8_t m_cBgR, m_cBgG, m_cBgB, m_cBgA;
 	uint8_t m_cFgR, m_cFgG, m_cFgB, m_cFgA;
+	uint32_t m_uForeground;
+	uint32_t m_uBackground;
+
+	/* Cell grid, the shadow grid contains what is 
+	 * currently present on the surface (by screen position) */
+	TerminalGlyphAtlas_t m_sAtlas;
+	TerminalCell_t *m_pCells;
+	TerminalCell_t *m_pRendered;
+	uint32_t *m_pDirty;
+	int m_iRowOrigin;
 };
 
 
@@ -26,7 +26,9 @@
 #include "test.hpp"
 #include "test_constreams.hpp"
 #include "test_filestreams.hpp"
+#include "test_malloc.hpp"
 #include "test_so.hpp"
+#include "test_threadpool.hpp"
 #include <thread>
 #include <png.h>
 
@@ -80,6 +82,8 @@ int main(int argc, char **argv) {
     RUN_TEST_SUITE(ErrorCounter, ConsoleStreamTests);
     RUN_TEST_SUITE(ErrorCounter, SharedObjectTests);
     RUN_TEST_SUITE(ErrorCounter, FileStreamTests);
+    RUN_TEST_SUITE(ErrorCounter, ThreadPoolTests);
+    RUN_TEST_SUITE(ErrorCounter, HeapTests);
 
     // Run libm test
     //libm_main(argc, argv);
@@ -0,0 +1,184 @@
+/* MollenOS
+ *
+ * Copyright 2011 - 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS - C/C++ Test Suite for Userspace
+ *  - Runs a variety of userspace tests against the libc/libc++ to verify
+ *    the stability and integrity of the operating system.
+ */
+#pragma once
+#include <malloc.h>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "test.hpp"
+
+#define HEAP_TEST_THREADS       4
+#define HEAP_TEST_BLOCKS        1024
+#define HEAP_TEST_ROUNDS        16
+#define HEAP_TEST_LARGE_BLOCK   (64 * 1024)
+
+// Fills the block with a pattern derived from the owner and index, so blocks
+// that overlap or are handed out twice are detected
+static void HeapFillBlock(unsigned char *Block, size_t Length, int Owner, int Index) {
+    for (size_t i = 0; i < Length; i++) {
+        Block[i] = (unsigned char)(Owner * 31 + Index * 7 + i);
+    }
+}
+
+static bool HeapVerifyBlock(const unsigned char *Block, size_t Length, int Owner, int Index) {
+    for (size_t i = 0; i < Length; i++) {
+        if (Block[i] != (unsigned char)(Owner * 31 + Index * 7 + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+class HeapTests : public OSTest {
+public:
+    HeapTests() : OSTest("HeapTests") { }
+    int RunTests() {
+        int Errors = 0;
+        Errors += TestThreadCache();
+        Errors += TestRemoteFree();
+        Errors += TestConcurrentGrowth();
+        return Errors;
+    }
+
+private:
+    // Small blocks are handed out again from the thread cache, while large
+    // blocks must go back to the arena and never serve small requests
+    int TestThreadCache() {
+        int Errors = 0;
+
+        void *Small = malloc(24);
+        free(Small);
+        void *Again = malloc(20);
+        if (Again != Small) {
+            TestLog(">> Small block was not reused from the thread cache");
+            Errors++;
+        }
+        free(Again);
+
+        void *Large = malloc(4096);
+        free(Large);
+        void *Class = malloc(256);
+        if (Class == NULL || malloc_usable_size(Class) >= 4096) {
+            TestLog(">> Large block was cached for a small request");
+            Errors++;
+        }
+        free(Class);
+        return Errors;
+    }
+
+    // Blocks allocated by one thread are freed by another, which goes through
+    // the remote list of the owning arena when it is busy
+    int TestRemoteFree() {
+        std::vector<unsigned char*> Blocks[HEAP_TEST_THREADS];
+        std::atomic<int> Corrupted(0);
+        std::vector<std::thread> Threads;
+        int Errors = 0;
+
+        for (int Round = 0; Round < HEAP_TEST_ROUNDS; Round++) {
+            for (int t = 0; t < HEAP_TEST_THREADS; t++) {
+                Threads.emplace_back([&Blocks, t]() {
+                    for (int i = 0; i < HEAP_TEST_BLOCKS; i++) {
+                        size_t Length = 8 + ((i * 13) % 512);
+                        unsigned char *Block = (unsigned char*)malloc(Length);
+                        if (Block != NULL) {
+                            HeapFillBlock(Block, Length, t, i);
+                        }
+                        Blocks[t].push_back(Block);
+                    }
+                });
+            }
+            for (auto &Thread : Threads) {
+                Thread.join();
+            }
+            Threads.clear();
+
+            // Every thread frees the blocks of its neighbour while the
+            // neighbour allocates again
+            for (int t = 0; t < HEAP_TEST_THREADS; t++) {
+                Threads.emplace_back([&Blocks, &Corrupted, t]() {
+                    int Owner = (t + 1) % HEAP_TEST_THREADS;
+                    for (int i = 0; i < HEAP_TEST_BLOCKS; i++) {
+                        size_t Length = 8 + ((i * 13) % 512);
+                        unsigned char *Block = Blocks[Owner][i];
+                        if (Block == NULL || !HeapVerifyBlock(Block, Length, Owner, i)) {
+                            Corrupted.fetch_add(1);
+                        }
+                        free(Block);
+                        free(malloc(Length));
+                    }
+                });
+            }
+            for (auto &Thread : Threads) {
+                Thread.join();
+            }
+            Threads.clear();
+            for (int t = 0; t < HEAP_TEST_THREADS; t++) {
+                Blocks[t].clear();
+            }
+        }
+
+        if (Corrupted.load() != 0) {
+            TestLog(">> " + std::to_string(Corrupted.load()) + " blocks were lost or corrupted");
+            Errors++;
+        }
+        malloc_trim(0);
+        return Errors;
+    }
+
+    // Threads grow their arenas at the same time, so heap segments are carved
+    // from the shared regions concurrently and must never overlap
+    int TestConcurrentGrowth() {
+        std::atomic<int> Corrupted(0);
+        std::vector<std::thread> Threads;
+        int Errors = 0;
+
+        for (int t = 0; t < HEAP_TEST_THREADS; t++) {
+            Threads.emplace_back([&Corrupted, t]() {
+                unsigned char *Blocks[HEAP_TEST_ROUNDS];
+                for (int i = 0; i < HEAP_TEST_ROUNDS; i++) {
+                    Blocks[i] = (unsigned char*)malloc(HEAP_TEST_LARGE_BLOCK);
+                    if (Blocks[i] != NULL) {
+                        HeapFillBlock(Blocks[i], HEAP_TEST_LARGE_BLOCK, t, i);
+                    }
+                }
+                for (int i = 0; i < HEAP_TEST_ROUNDS; i++) {
+                    if (Blocks[i] == NULL || !HeapVerifyBlock(Blocks[i], HEAP_TEST_LARGE_BLOCK, t, i)) {
+                        Corrupted.fetch_add(1);
+                    }
+                    free(Blocks[i]);
+                }
+            });
+        }
+        for (auto &Thread : Threads) {
+            Thread.join();
+        }
+
+        if (Corrupted.load() != 0) {
+            TestLog(">> " + std::to_string(Corrupted.load()) + " large blocks overlapped");
+            Errors++;
+        }
+        return Errors;
+    }
+};
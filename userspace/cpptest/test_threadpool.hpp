@@ -0,0 +1,105 @@
+/* MollenOS
+ *
+ * Copyright 2011 - 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS - C/C++ Test Suite for Userspace
+ *  - Runs a variety of userspace tests against the libc/libc++ to verify
+ *    the stability and integrity of the operating system.
+ */
+#pragma once
+#include <os/threadpool.h>
+#include <atomic>
+#include <ctime>
+#include "test.hpp"
+
+#define THREADPOOL_BENCH_JOBS  100000
+#define THREADPOOL_BENCH_BATCH 64
+
+static std::atomic<int> ThreadPoolCounter;
+static int ThreadPoolCountJob(void *Argument) {
+    ThreadPoolCounter.fetch_add(1, std::memory_order_relaxed);
+    return (int)(intptr_t)Argument;
+}
+
+class ThreadPoolTests : public OSTest {
+public:
+    ThreadPoolTests() : OSTest("ThreadPoolTests") { }
+    int RunTests() {
+        int Errors = 0;
+        for (int Workers = 1; Workers <= 16; Workers *= 2) {
+            Errors += RunBenchmark(Workers);
+        }
+        return Errors;
+    }
+
+private:
+    // Queues THREADPOOL_BENCH_JOBS empty jobs in batches, then verifies
+    // that every job ran and that futures carry the job's result
+    int RunBenchmark(int Workers) {
+        ThreadPoolWorkItem_t Items[THREADPOOL_BENCH_BATCH];
+        ThreadPoolFuture_t Futures[THREADPOOL_BENCH_BATCH];
+        ThreadPool_t *Pool = NULL;
+        int Errors = 0;
+
+        if (ThreadPoolInitialize(Workers, &Pool) != OsSuccess) {
+            TestLog(">> Failed to create threadpool");
+            return 1;
+        }
+
+        ThreadPoolCounter.store(0);
+        for (int i = 0; i < THREADPOOL_BENCH_BATCH; i++) {
+            Items[i].Function = ThreadPoolCountJob;
+            Items[i].Argument = (void*)(intptr_t)i;
+            Items[i].Future   = NULL;
+        }
+
+        clock_t Start = clock();
+        for (int i = 0; i < THREADPOOL_BENCH_JOBS; i += THREADPOOL_BENCH_BATCH) {
+            ThreadPoolAddWorkBatch(Pool, &Items[0], THREADPOOL_BENCH_BATCH);
+        }
+        ThreadPoolWait(Pool);
+        clock_t End = clock();
+
+        int Expected = ((THREADPOOL_BENCH_JOBS + THREADPOOL_BENCH_BATCH - 1) 
+            / THREADPOOL_BENCH_BATCH) * THREADPOOL_BENCH_BATCH;
+        if (ThreadPoolCounter.load() != Expected) {
+            TestLog(">> Not all jobs were executed");
+            Errors++;
+        }
+
+        // Futures must return the value of their own job
+        for (int i = 0; i < THREADPOOL_BENCH_BATCH; i++) {
+            ThreadPoolFutureInitialize(&Futures[i]);
+            Items[i].Future = &Futures[i];
+        }
+        ThreadPoolAddWorkBatch(Pool, &Items[0], THREADPOOL_BENCH_BATCH);
+        for (int i = 0; i < THREADPOOL_BENCH_BATCH; i++) {
+            int Result = -1;
+            if (ThreadPoolFutureWait(&Futures[i], &Result) != OsSuccess || Result != i) {
+                TestLog(">> Future returned the wrong result");
+                Errors++;
+                break;
+            }
+        }
+        ThreadPoolDestroy(Pool);
+
+        clock_t Ticks = (End - Start) > 0 ? (End - Start) : 1;
+        TestLog(">> " + std::to_string(Workers) + " workers: " 
+            + std::to_string(((long long)Expected * CLOCKS_PER_SEC) / Ticks) + " jobs/sec");
+        return Errors;
+    }
+};
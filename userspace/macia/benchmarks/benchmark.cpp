@@ -0,0 +1,176 @@
+/* The Macia Language (MACIA)
+*
+* Copyright 2016, Philip Meulengracht
+*
+* This program is free software : you can redistribute it and / or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation ? , either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.If not, see <http://www.gnu.org/licenses/>.
+*
+*
+* Macia - Virtual Machine Benchmarks
+* - Micro-benchmarks for the interpreter that build on
+* - the host, reports the instructions executed per second
+*/
+
+/* Includes */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+/* System Includes */
+#include "../interpreter/interpreter.h"
+
+/* Benchmark settings */
+#define BENCH_LOOP_ITERATIONS		10000000
+#define BENCH_CALL_ITERATIONS		5000000
+#define BENCH_ALLOC_ITERATIONS		500000
+#define BENCH_RUNS					5
+
+/* The benchmark program builder, emits code into a 
+ * code object and keeps track of the instructions in the loop */
+class Builder
+{
+public:
+	Builder(DataPool *pPool, int ScopeId) {
+		m_pPool = pPool;
+		m_iScopeId = ScopeId;
+		m_iCount = 0;
+	}
+
+	void Op(Opcode_t Opcode) { m_pPool->AddOpcode(m_iScopeId, Opcode); m_iCount++; }
+	void Reg(int Register) { m_pPool->AddCode8(m_iScopeId, (char)Register); }
+	void Id(int Value) { m_pPool->AddCode32(m_iScopeId, Value); }
+	void Label(int Id) { m_pPool->AddOpcode(m_iScopeId, OpLabel); m_pPool->AddCode32(m_iScopeId, Id); }
+	void Reset() { m_iCount = 0; }
+	int Count() { return m_iCount; }
+
+private:
+	DataPool *m_pPool;
+	int m_iScopeId;
+	int m_iCount;
+};
+
+/* Emits the loop header, register 0 counts down from the 
+ * iterations and register 1 holds the decrement */
+static void LoopBegin(Builder &Code, int Iterations) {
+	Code.Op(OpStoreRI); Code.Reg(0); Code.Id(Iterations);
+	Code.Op(OpStoreRI); Code.Reg(1); Code.Id(1);
+	Code.Label(1);
+	Code.Reset();
+}
+
+/* Emits the loop footer and returns the
+ * number of instructions executed per iteration */
+static int LoopEnd(Builder &Code) {
+	Code.Op(OpSub); Code.Reg(0); Code.Reg(1);
+	Code.Op(OpJumpNZ); Code.Reg(0); Code.Id(1);
+	return Code.Count();
+}
+
+/* Loop benchmark, arithmetic on registers and locals */
+static DataPool *BuildLoops(long long *Instructions) {
+	DataPool *Pool = new DataPool();
+	int Entry = Pool->CreateFunction("__maciaentry", -1);
+	int Sum = Pool->DefineVariable("sum", Entry);
+	Builder Code(Pool, Entry);
+
+	Code.Op(OpStoreI); Code.Id(Sum); Code.Id(0);
+	LoopBegin(Code, BENCH_LOOP_ITERATIONS);
+	Code.Op(OpLoadRA); Code.Reg(2); Code.Id(Sum);
+	Code.Op(OpAdd); Code.Reg(2); Code.Reg(0);
+	Code.Op(OpStoreAR); Code.Id(Sum); Code.Reg(2);
+	*Instructions = (long long)LoopEnd(Code) * BENCH_LOOP_ITERATIONS;
+	return Pool;
+}
+
+/* Call benchmark, invokes an empty method */
+static DataPool *BuildCalls(long long *Instructions) {
+	DataPool *Pool = new DataPool();
+	int Object = Pool->CreateObject("Bench");
+	int Method = Pool->CreateFunction("Nop", Object);
+	int Entry = Pool->CreateFunction("__maciaentry", -1);
+	Builder Code(Pool, Entry);
+
+	Code.Op(OpNew); Code.Reg(2); Code.Id(Object);
+	LoopBegin(Code, BENCH_CALL_ITERATIONS);
+	Code.Op(OpInvoke); Code.Reg(2); Code.Id(Method);
+	*Instructions = (long long)(LoopEnd(Code) + 1) * BENCH_CALL_ITERATIONS;
+	return Pool;
+}
+
+/* Allocation benchmark, creates objects with initialized fields */
+static DataPool *BuildAllocations(long long *Instructions) {
+	DataPool *Pool = new DataPool();
+	int Object = Pool->CreateObject("Point");
+	int X = Pool->DefineVariable("x", Object);
+	int Y = Pool->DefineVariable("y", Object);
+	int Entry = Pool->CreateFunction("__maciaentry", -1);
+	Builder Init(Pool, Object);
+	Builder Code(Pool, Entry);
+	int InitCount;
+
+	Init.Op(OpStoreI); Init.Id(X); Init.Id(1);
+	Init.Op(OpStoreI); Init.Id(Y); Init.Id(2);
+	InitCount = Init.Count() + 1;
+
+	LoopBegin(Code, BENCH_ALLOC_ITERATIONS);
+	Code.Op(OpNew); Code.Reg(2); Code.Id(Object);
+	*Instructions = (long long)(LoopEnd(Code) + InitCount) * BENCH_ALLOC_ITERATIONS;
+	return Pool;
+}
+
+/* Runs a benchmark a number of times and 
+ * reports the best run */
+static int RunBenchmark(const char *Name, DataPool *(*Build)(long long*)) {
+	long long Instructions = 0;
+	DataPool *Pool = Build(&Instructions);
+	Interpreter *Vm = new Interpreter(Pool);
+	double Best = 0.0;
+
+	if (Vm->Compile()) {
+		printf("%-12s failed to compile\n", Name);
+		return -1;
+	}
+
+	for (int i = 0; i < BENCH_RUNS; i++) {
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		if (Vm->Execute()) {
+			printf("%-12s failed to execute\n", Name);
+			return -1;
+		}
+		double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+		if (i == 0 || Seconds < Best) {
+			Best = Seconds;
+		}
+	}
+
+	printf("%-12s %12lld instructions %9.2f ms %9.2f Minstr/s\n", Name, Instructions,
+		Best * 1000.0, ((double)Instructions / Best) / 1000000.0);
+	delete Vm;
+	delete Pool;
+	return 0;
+}
+
+int main()
+{
+	int Result = 0;
+
+#ifdef MACIA_THREADED_DISPATCH
+	printf("Macia VM benchmarks (threaded dispatch)\n");
+#else
+	printf("Macia VM benchmarks (switch dispatch)\n");
+#endif
+	Result |= RunBenchmark("loops", BuildLoops);
+	Result |= RunBenchmark("calls", BuildCalls);
+	Result |= RunBenchmark("allocation", BuildAllocations);
+	return Result == 0 ? 0 : 1;
+}
@@ -104,9 +104,12 @@ void Generator::GenerateEntry() {
 	m_pPool->AddCode32(Id, VarId);
 	m_pPool->AddCode8(Id, TemporaryRegister);
 
-	m_pPool->AddOpcode(Id, OpInvoke);
-	m_pPool->AddCode8(Id, TemporaryRegister);
-	m_pPool->AddCode32(Id, ConstructorId);
+	/* The constructor is optional */
+	if (ConstructorId != -1) {
+		m_pPool->AddOpcode(Id, OpInvoke);
+		m_pPool->AddCode8(Id, TemporaryRegister);
+		m_pPool->AddCode32(Id, ConstructorId);
+	}
 
 	m_pPool->AddOpcode(Id, OpInvoke);
 	m_pPool->AddCode8(Id, TemporaryRegister);
@@ -50,9 +50,17 @@ typedef enum {
 	OpDivRA,					//(6) divra #id, $
 	OpSub,						//(3) sub $, $
 	OpSubRA,					//(6) subra #id, $
-	OpRem,						//(3) rem $
-	OpRemRA,					//(6) remra $
+	OpRem,						//(3) rem $, $
+	OpRemRA,					//(6) remra #id, $
 	OpMul,						//(3) mul $, $
-	OpMulRA						//(6) mulra #id, $
+	OpMulRA,					//(6) mulra #id, $
+
+	/* Control Flow 
+	 * Targets are labels in the same code object */
+	OpJump,						//(5) jmp #label
+	OpJumpNZ,					//(6) jnz $, #label
+
+	/* Must be last */
+	OpCount
 
 } Opcode_t;
\ No newline at end of file
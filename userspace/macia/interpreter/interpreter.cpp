@@ -21,8 +21,10 @@
 * - of executing the Macia bytecode language
 */
 
+/* Includes */
 /* Includes */
 #include "interpreter.h"
+#include <climits>
 #include <cstdio>
 
 /* Constructor 
@@ -30,89 +32,611 @@
  * and setup vm */
 Interpreter::Interpreter(DataPool *pPool) {
 	m_pPool = pPool;
+	m_iCompiled = 0;
+	m_iThreaded = 0;
+	m_pEntry = NULL;
 }
 
 /* Destructor 
  * Cleanup Vm */
 Interpreter::~Interpreter() {
 
+	/* Cleanup instances */
+	for (size_t i = 0; i < m_lInstances.size(); i++) {
+		delete m_lInstances[i];
+	}
+
+	/* Cleanup decoded code */
+	for (std::map<int, CompiledFunction_t*>::iterator Itr = m_sFunctions.begin();
+		Itr != m_sFunctions.end(); ++Itr) {
+		delete Itr->second;
+	}
+	for (std::map<int, CompiledType_t*>::iterator Itr = m_sTypes.begin();
+		Itr != m_sTypes.end(); ++Itr) {
+		delete Itr->second;
+	}
 }
 
-/* The execution, it returns 
- * when code runs out */
-int Interpreter::Execute() {
+/* Resolves a code object id to an operand, this
+ * decides where the value lives relative to the function */
+int Interpreter::ResolveOperand(CompiledFunction_t *Function, int Id, Operand_t *Operand) {
 
-	/* Lookup main method */
-	ObjectInstance *Instance = NULL;
-	CodeObject *EntryObj = m_pPool->LookupObject("__maciaentry");
+	/* Variables */
+	std::map<int, int>::iterator Itr;
+	CodeObject *Obj = m_pPool->GetObject(Id);
+	Value_t Value;
 
-	/* Sanity -> We need entry */
-	if (EntryObj == NULL) {
-		/* Error Message */
-		printf("Failed to locate program entry point\n");
-		
-		/* abort */
+	/* Sanity */
+	if (Obj == NULL) {
+		printf("Reference to unknown object #%i\n", Id);
 		return -1;
 	}
 
-	/* Allocate variables and objects */
-	//Instance = new ObjectInstance(m_pPool->CalculateObjectSize(0), NULL);
+	switch (Obj->GetType()) {
 
-	/* Execute code */
-	return ExecuteCode(Instance, EntryObj->GetCode());
+		/* Locals of the function live in the frame after the registers,
+		 * variables of the owner object are fields of the instance */
+		case CTVariable: {
+			if (Obj->GetScopeId() == Function->Id
+				&& Function->Source->GetType() == CTFunction) {
+				Operand->Storage = StorageFrame;
+				Operand->Index = MACIA_FRAME_REGISTERS + Obj->GetOffset();
+				return 0;
+			}
+			else if (Obj->GetScopeId() == Function->OwnerId) {
+				Operand->Storage = StorageField;
+				Operand->Index = Obj->GetOffset();
+				return 0;
+			}
+			else if (Obj->GetScopeId() != -1) {
+				printf("Variable %s is not accessible from %s\n", 
+					Obj->GetPath(), Function->Source->GetPath());
+				return -1;
+			}
+			Value.Type = ValueNone;
+			Value.Data.Integer = 0;
+		} break;
+
+		/* Strings are constants, the value is the 
+		 * pooled string without the pool prefix */
+		case CTString: {
+			Value.Type = ValueString;
+			Value.Data.String = Obj->GetPath() + strlen("StringPool.");
+		} break;
+
+		default: {
+			printf("Object %s can not be used as a value\n", Obj->GetPath());
+			return -1;
+		}
+	}
+
+	/* Globals and constants are statics, 
+	 * allocate them a slot on first reference */
+	Operand->Storage = StorageStatic;
+	Itr = m_sStaticIndex.find(Id);
+	if (Itr != m_sStaticIndex.end()) {
+		Operand->Index = Itr->second;
+	}
+	else {
+		Operand->Index = (int)m_lStatics.size();
+		m_sStaticIndex[Id] = Operand->Index;
+		m_lStatics.push_back(Value);
+	}
+	return 0;
 }
 
-/* Executes the given code 
- * this function may be called recursive */
-int Interpreter::ExecuteCode(ObjectInstance *Instance, std::vector<unsigned char> &Code) {
-	
-	/* Iterator */
+/* Decodes the bytecode of a function into instructions, 
+ * all ids are resolved and the operands are validated */
+int Interpreter::CompileFunction(CompiledFunction_t *Function) {
+
+	/* Variables */
+	std::vector<unsigned char> &Code = Function->Source->GetCode();
+	std::vector<std::pair<size_t, int> > Branches;
+	std::map<int, size_t> Labels;
 	size_t Iterator = 0;
+	Instruction_t Instr;
+	int Ids[2];
+
+	/* Helpers for reading operands, everything is little endian */
+#define READ8(Var)		if (Iterator + 1 > Code.size()) goto Truncated; \
+						Var = Code[Iterator++]
+#define READ32(Var)		if (Iterator + 4 > Code.size()) goto Truncated; \
+						Var = (int)(Code[Iterator] | (Code[Iterator + 1] << 8) \
+							| (Code[Iterator + 2] << 16) | ((unsigned)Code[Iterator + 3] << 24)); \
+						Iterator += 4
+#define READREG(Op)		READ8((Op).Index); (Op).Storage = StorageFrame; \
+						if ((Op).Index >= MACIA_FRAME_REGISTERS) goto BadRegister
+#define READREF(Op)		READ32(Ids[0]); \
+						if (ResolveOperand(Function, Ids[0], &(Op))) return -1
 
 	while (Iterator < Code.size()) {
 
 		/* Get opcode */
-		Opcode_t Opcode = (Opcode_t)Code[Iterator];
+		memset(&Instr, 0, sizeof(Instruction_t));
+		Instr.Opcode = Code[Iterator++];
 
-		/* Increament */
-		Iterator++;
+		/* Decode operands */
+		switch (Instr.Opcode) {
 
-		/* Handle opcode */
-		switch (Opcode) {
+			/* Noops and labels produce no instructions */
+			case OpNone: {
+				continue;
+			}
+			case OpLabel: {
+				READ32(Ids[0]);
+				Labels[Ids[0]] = Function->Code.size();
+				continue;
+			}
 
 			/* Specials */
-			case OpLabel:
-			case OpNew:
-			case OpInvoke:
+			case OpNew: {
+				std::map<int, CompiledType_t*>::iterator Type;
+				READREG(Instr.Target);
+				READ32(Ids[0]);
+				Type = m_sTypes.find(Ids[0]);
+				if (Type == m_sTypes.end()) {
+					printf("new: #%i is not an object\n", Ids[0]);
+					return -1;
+				}
+				Instr.Pointer = Type->second;
+			} break;
+			case OpInvoke: {
+				std::map<int, CompiledFunction_t*>::iterator Callee;
+				READREG(Instr.Target);
+				READ32(Ids[0]);
+				Callee = m_sFunctions.find(Ids[0]);
+				if (Callee == m_sFunctions.end() 
+					|| Callee->second->Source->GetType() != CTFunction) {
+					printf("invoke: #%i is not a function\n", Ids[0]);
+					return -1;
+				}
+				Instr.Pointer = Callee->second;
+			} break;
 			case OpReturn: {
-
 			} break;
 
 			/* Store Opcodes */
-			case OpStore:
-			case OpStoreAR:
-			case OpStoreRI:
+			case OpStore: {
+				READREG(Instr.Target);
+				READREG(Instr.Source);
+			} break;
+			case OpStoreAR: {
+				READREF(Instr.Target);
+				READREG(Instr.Source);
+			} break;
 			case OpStoreI: {
-
+				READREF(Instr.Target);
+				READ32(Ids[1]);
+				Instr.Immediate = Ids[1];
+			} break;
+			case OpStoreRI: {
+				READREG(Instr.Target);
+				READ32(Ids[1]);
+				Instr.Immediate = Ids[1];
 			} break;
 
 			/* Load Opcodes */
-			case OpLoadA:
+			case OpLoadA: {
+				READREF(Instr.Target);
+				READREF(Instr.Source);
+			} break;
 			case OpLoadRA: {
+				READREG(Instr.Target);
+				READREF(Instr.Source);
+			} break;
+
+			/* Arithmetics */
+			case OpAdd:
+			case OpDiv:
+			case OpSub:
+			case OpRem:
+			case OpMul: {
+				READREG(Instr.Target);
+				READREG(Instr.Source);
+			} break;
+			case OpAddRA:
+			case OpDivRA:
+			case OpSubRA:
+			case OpRemRA:
+			case OpMulRA: {
+				READREF(Instr.Target);
+				READREG(Instr.Source);
+			} break;
 
+			/* Control Flow, targets are resolved when
+			 * all labels are known */
+			case OpJump: {
+				READ32(Ids[0]);
+				Branches.push_back(std::make_pair(Function->Code.size(), Ids[0]));
+			} break;
+			case OpJumpNZ: {
+				READREG(Instr.Target);
+				READ32(Ids[0]);
+				Branches.push_back(std::make_pair(Function->Code.size(), Ids[0]));
 			} break;
 
 			/* Error on stupid opcodes */
 			default: {
-				/* Error Message */
-				printf("Unhandled opcode 0x%x\n", Opcode);
-
-				/* Bail */
+				printf("Unhandled opcode 0x%x in %s\n", Instr.Opcode, Function->Source->GetPath());
 				return -1;
 			}
 		}
+
+		/* Append */
+		Function->Code.push_back(Instr);
 	}
 
-	/* Done! */
+	/* Always end in a return, the generator 
+	 * only writes it when serializing */
+	memset(&Instr, 0, sizeof(Instruction_t));
+	Instr.Opcode = OpReturn;
+	Function->Code.push_back(Instr);
+
+	/* Resolve branches now the code is final */
+	for (size_t i = 0; i < Branches.size(); i++) {
+		std::map<int, size_t>::iterator Label = Labels.find(Branches[i].second);
+		if (Label == Labels.end()) {
+			printf("Branch to unknown label #%i in %s\n", Branches[i].second, Function->Source->GetPath());
+			return -1;
+		}
+		Function->Code[Branches[i].first].Pointer = &Function->Code[Label->second];
+	}
 	return 0;
-}
\ No newline at end of file
+
+#undef READ8
+#undef READ32
+#undef READREG
+#undef READREF
+
+Truncated:
+	printf("Truncated instruction in %s\n", Function->Source->GetPath());
+	return -1;
+
+BadRegister:
+	printf("Invalid register in %s\n", Function->Source->GetPath());
+	return -1;
+}
+
+/* Decodes all code objects in the pool, this is
+ * done automatically by Execute if not done before */
+int Interpreter::Compile() {
+
+	/* Variables */
+	CodeObject *EntryObj = NULL;
+
+	/* Only once */
+	if (m_iCompiled) {
+		return 0;
+	}
+
+	/* Create all types and functions first, so
+	 * references can be resolved regardless of order */
+	for (std::map<int, CodeObject*>::iterator Itr = m_pPool->GetTable().begin();
+		Itr != m_pPool->GetTable().end(); ++Itr) {
+		CodeObject *Obj = Itr->second;
+		CompiledFunction_t *Function = NULL;
+
+		if (Obj->GetType() != CTObject && Obj->GetType() != CTFunction) {
+			continue;
+		}
+
+		/* Objects compile their field initializers */
+		Function = new CompiledFunction_t();
+		Function->Source = Obj;
+		Function->Id = Itr->first;
+		Function->FrameSize = MACIA_FRAME_REGISTERS;
+		if (Obj->GetType() == CTObject) {
+			CompiledType_t *Type = new CompiledType_t();
+			Type->Source = Obj;
+			Type->Id = Itr->first;
+			Type->FieldCount = Obj->GetVariableCount();
+			Type->Initializer = Function;
+			Function->OwnerId = Itr->first;
+			m_sTypes[Itr->first] = Type;
+		}
+		else {
+			CodeObject *Owner = m_pPool->GetObject(Obj->GetScopeId());
+			Function->OwnerId = (Owner != NULL && Owner->GetType() == CTObject) ? Obj->GetScopeId() : -1;
+			Function->FrameSize += Obj->GetVariableCount();
+		}
+		m_sFunctions[Itr->first] = Function;
+	}
+
+	/* Decode */
+	for (std::map<int, CompiledFunction_t*>::iterator Itr = m_sFunctions.begin();
+		Itr != m_sFunctions.end(); ++Itr) {
+		if (CompileFunction(Itr->second)) {
+			return -1;
+		}
+	}
+
+	/* Lookup main method */
+	EntryObj = m_pPool->LookupObject("__maciaentry");
+	for (std::map<int, CompiledFunction_t*>::iterator Itr = m_sFunctions.begin();
+		Itr != m_sFunctions.end(); ++Itr) {
+		if (Itr->second->Source == EntryObj) {
+			m_pEntry = Itr->second;
+		}
+	}
+
+	/* Allocate runtime state */
+	m_lStack.resize(MACIA_STACK_SIZE);
+	m_lCalls.resize(MACIA_MAX_CALLDEPTH);
+	m_iCompiled = 1;
+	return 0;
+}
+
+/* Creates a new instance of the given type, 
+ * instances live until the interpreter is destroyed */
+ObjectInstance *Interpreter::CreateInstance(CompiledType_t *Type) {
+	ObjectInstance *Instance = new ObjectInstance(Type);
+	m_lInstances.push_back(Instance);
+	return Instance;
+}
+
+/* The execution, it returns 
+ * when code runs out */
+int Interpreter::Execute() {
+
+	/* Variables */
+	int Result = 0;
+
+	/* Decode everything first */
+	if (Compile()) {
+		printf("Failed to decode program\n");
+		return -1;
+	}
+
+	/* Sanity -> We need entry */
+	if (m_pEntry == NULL) {
+		/* Error Message */
+		printf("Failed to locate program entry point\n");
+		
+		/* abort */
+		return -1;
+	}
+
+	/* Execute code */
+	Result = ExecuteCode(m_pEntry, NULL);
+
+	/* The program is done, so are its instances */
+	for (size_t i = 0; i < m_lStatics.size(); i++) {
+		if (m_lStatics[i].Type == ValueObject) {
+			m_lStatics[i].Type = ValueNone;
+		}
+	}
+	for (size_t i = 0; i < m_lInstances.size(); i++) {
+		delete m_lInstances[i];
+	}
+	m_lInstances.clear();
+	return Result;
+}
+
+/* Dispatch helpers, with threaded dispatch every handler jumps
+ * directly to the next handler, otherwise a switch is used */
+#ifdef MACIA_THREADED_DISPATCH
+#define VM_CASE(Op)			Label##Op:
+#define VM_DISPATCH()		goto *Ip->Handler
+#else
+#define VM_CASE(Op)			case Op:
+#define VM_DISPATCH()		goto Dispatch
+#endif
+#define VM_NEXT()			Ip++; VM_DISPATCH()
+
+/* Resolves an operand to the value it references */
+#define VM_SLOT(Op)			((Op).Storage == StorageFrame ? &Frame[(Op).Index] : \
+							((Op).Storage == StorageField ? &Instance->GetFields()[(Op).Index] : &Statics[(Op).Index]))
+
+/* Arithmetic handlers, both sides must be integers. Dividing
+ * the smallest integer by -1 overflows, it is defined to give the
+ * smallest integer as quotient and 0 as remainder (same as by 1) */
+#define VM_ARITHMETIC(Target, Source, Expr, CheckZero) { \
+	Value_t *Left = (Target); \
+	Value_t *Right = (Source); \
+	if (Left->Type != ValueInteger || Right->Type != ValueInteger) { \
+		goto TypeError; \
+	} \
+	if (CheckZero && Right->Data.Integer == 0) { \
+		goto DivideByZero; \
+	} \
+	if (CheckZero && Right->Data.Integer == -1 && Left->Data.Integer == LLONG_MIN) { \
+		Left->Data.Integer = Left->Data.Integer Expr 1; \
+	} \
+	else { \
+		Left->Data.Integer = Left->Data.Integer Expr Right->Data.Integer; \
+	} \
+} VM_NEXT();
+
+/* Executes the given code until the 
+ * function it starts in returns */
+int Interpreter::ExecuteCode(CompiledFunction_t *Function, ObjectInstance *Instance) {
+	
+	/* Variables */
+	Value_t *Frame = &m_lStack[0];
+	Value_t *StackEnd = Frame + m_lStack.size();
+	Value_t *Statics = m_lStatics.empty() ? NULL : &m_lStatics[0];
+	CallFrame_t *Calls = &m_lCalls[0];
+	CompiledFunction_t *Callee = NULL;
+	ObjectInstance *CalleeInstance = NULL;
+	const Instruction_t *Ip = NULL;
+	int Depth = 0;
+
+#ifdef MACIA_THREADED_DISPATCH
+	/* Thread the decoded code on the first run, 
+	 * the handler of each instruction is its label */
+	const void *Handlers[OpCount];
+	for (int i = 0; i < (int)OpCount; i++) {
+		Handlers[i] = &&LabelInvalid;
+	}
+	Handlers[OpNew] = &&LabelOpNew;
+	Handlers[OpInvoke] = &&LabelOpInvoke;
+	Handlers[OpReturn] = &&LabelOpReturn;
+	Handlers[OpStore] = &&LabelOpStore;
+	Handlers[OpStoreAR] = &&LabelOpStoreAR;
+	Handlers[OpStoreI] = &&LabelOpStoreI;
+	Handlers[OpStoreRI] = &&LabelOpStoreRI;
+	Handlers[OpLoadA] = &&LabelOpLoadA;
+	Handlers[OpLoadRA] = &&LabelOpLoadRA;
+	Handlers[OpAdd] = &&LabelOpAdd;
+	Handlers[OpAddRA] = &&LabelOpAddRA;
+	Handlers[OpDiv] = &&LabelOpDiv;
+	Handlers[OpDivRA] = &&LabelOpDivRA;
+	Handlers[OpSub] = &&LabelOpSub;
+	Handlers[OpSubRA] = &&LabelOpSubRA;
+	Handlers[OpRem] = &&LabelOpRem;
+	Handlers[OpRemRA] = &&LabelOpRemRA;
+	Handlers[OpMul] = &&LabelOpMul;
+	Handlers[OpMulRA] = &&LabelOpMulRA;
+	Handlers[OpJump] = &&LabelOpJump;
+	Handlers[OpJumpNZ] = &&LabelOpJumpNZ;
+	if (!m_iThreaded) {
+		for (std::map<int, CompiledFunction_t*>::iterator Itr = m_sFunctions.begin();
+			Itr != m_sFunctions.end(); ++Itr) {
+			for (size_t i = 0; i < Itr->second->Code.size(); i++) {
+				Itr->second->Code[i].Handler = Handlers[Itr->second->Code[i].Opcode];
+			}
+		}
+		m_iThreaded = 1;
+	}
+#endif
+
+	/* Setup the initial frame */
+	memset(Frame, 0, Function->FrameSize * sizeof(Value_t));
+	Ip = &Function->Code[0];
+	VM_DISPATCH();
+
+#ifndef MACIA_THREADED_DISPATCH
+Dispatch:
+	switch (Ip->Opcode) {
+#endif
+
+	/* Specials */
+	VM_CASE(OpNew) {
+		CompiledType_t *Type = (CompiledType_t*)Ip->Pointer;
+		Frame[Ip->Target.Index].Type = ValueObject;
+		Frame[Ip->Target.Index].Data.Object = CreateInstance(Type);
+
+		/* Run the field initializers if there are any */
+		if (Type->Initializer->Code.size() > 1) {
+			Callee = Type->Initializer;
+			CalleeInstance = Frame[Ip->Target.Index].Data.Object;
+			goto PushFrame;
+		}
+	} VM_NEXT();
+
+	VM_CASE(OpInvoke) {
+		Value_t *Object = &Frame[Ip->Target.Index];
+		Callee = (CompiledFunction_t*)Ip->Pointer;
+		if (Object->Type != ValueObject 
+			|| Object->Data.Object->GetType()->Id != Callee->OwnerId) {
+			goto TypeError;
+		}
+		CalleeInstance = Object->Data.Object;
+	} goto PushFrame;
+
+	VM_CASE(OpReturn) {
+		if (Depth == 0) {
+			return 0;
+		}
+		Depth--;
+		Ip = Calls[Depth].ReturnAddress;
+		Function = Calls[Depth].Function;
+		Frame = Calls[Depth].Frame;
+		Instance = Calls[Depth].Instance;
+	} VM_DISPATCH();
+
+	/* Store Opcodes */
+	VM_CASE(OpStore) {
+		Frame[Ip->Target.Index] = Frame[Ip->Source.Index];
+	} VM_NEXT();
+
+	VM_CASE(OpStoreAR) {
+		*VM_SLOT(Ip->Target) = Frame[Ip->Source.Index];
+	} VM_NEXT();
+
+	VM_CASE(OpStoreI) {
+		Value_t *Target = VM_SLOT(Ip->Target);
+		Target->Type = ValueInteger;
+		Target->Data.Integer = Ip->Immediate;
+	} VM_NEXT();
+
+	VM_CASE(OpStoreRI) {
+		Frame[Ip->Target.Index].Type = ValueInteger;
+		Frame[Ip->Target.Index].Data.Integer = Ip->Immediate;
+	} VM_NEXT();
+
+	/* Load Opcodes */
+	VM_CASE(OpLoadA) {
+		*VM_SLOT(Ip->Target) = *VM_SLOT(Ip->Source);
+	} VM_NEXT();
+
+	VM_CASE(OpLoadRA) {
+		Frame[Ip->Target.Index] = *VM_SLOT(Ip->Source);
+	} VM_NEXT();
+
+	/* Arithmetics */
+	VM_CASE(OpAdd) VM_ARITHMETIC(&Frame[Ip->Target.Index], &Frame[Ip->Source.Index], +, 0)
+	VM_CASE(OpAddRA) VM_ARITHMETIC(VM_SLOT(Ip->Target), &Frame[Ip->Source.Index], +, 0)
+	VM_CASE(OpDiv) VM_ARITHMETIC(&Frame[Ip->Target.Index], &Frame[Ip->Source.Index], /, 1)
+	VM_CASE(OpDivRA) VM_ARITHMETIC(VM_SLOT(Ip->Target), &Frame[Ip->Source.Index], /, 1)
+	VM_CASE(OpSub) VM_ARITHMETIC(&Frame[Ip->Target.Index], &Frame[Ip->Source.Index], -, 0)
+	VM_CASE(OpSubRA) VM_ARITHMETIC(VM_SLOT(Ip->Target), &Frame[Ip->Source.Index], -, 0)
+	VM_CASE(OpRem) VM_ARITHMETIC(&Frame[Ip->Target.Index], &Frame[Ip->Source.Index], %, 1)
+	VM_CASE(OpRemRA) VM_ARITHMETIC(VM_SLOT(Ip->Target), &Frame[Ip->Source.Index], %, 1)
+	VM_CASE(OpMul) VM_ARITHMETIC(&Frame[Ip->Target.Index], &Frame[Ip->Source.Index], *, 0)
+	VM_CASE(OpMulRA) VM_ARITHMETIC(VM_SLOT(Ip->Target), &Frame[Ip->Source.Index], *, 0)
+
+	/* Control Flow */
+	VM_CASE(OpJump) {
+		Ip = (const Instruction_t*)Ip->Pointer;
+	} VM_DISPATCH();
+
+	VM_CASE(OpJumpNZ) {
+		Value_t *Condition = &Frame[Ip->Target.Index];
+		if (Condition->Type != ValueNone 
+			&& (Condition->Type != ValueInteger || Condition->Data.Integer != 0)) {
+			Ip = (const Instruction_t*)Ip->Pointer;
+			VM_DISPATCH();
+		}
+	} VM_NEXT();
+
+#ifndef MACIA_THREADED_DISPATCH
+	default:
+		goto LabelInvalid;
+	}
+#endif
+
+	/* Saves the caller and enters the callee with a 
+	 * cleared frame placed right after the callers frame */
+PushFrame:
+	if (Depth == MACIA_MAX_CALLDEPTH
+		|| (Frame + Function->FrameSize + Callee->FrameSize) > StackEnd) {
+		printf("Stack overflow in %s\n", Callee->Source->GetPath());
+		return -1;
+	}
+	Calls[Depth].ReturnAddress = Ip + 1;
+	Calls[Depth].Function = Function;
+	Calls[Depth].Frame = Frame;
+	Calls[Depth].Instance = Instance;
+	Depth++;
+
+	Frame += Function->FrameSize;
+	memset(Frame, 0, Callee->FrameSize * sizeof(Value_t));
+	Function = Callee;
+	Instance = CalleeInstance;
+	Ip = &Function->Code[0];
+	VM_DISPATCH();
+
+	/* Runtime errors */
+LabelInvalid:
+	printf("Invalid opcode 0x%x in %s\n", Ip->Opcode, Function->Source->GetPath());
+	return -1;
+
+TypeError:
+	printf("Type mismatch for opcode 0x%x in %s\n", Ip->Opcode, Function->Source->GetPath());
+	return -1;
+
+DivideByZero:
+	printf("Division by zero in %s\n", Function->Source->GetPath());
+	return -1;
+}
@@ -22,41 +22,48 @@
 */
 #pragma once
 
+
 /* Includes */
 #include <cstring>
 #include <cstdlib>
 #include <vector>
+#include <map>
 
 /* System Includes */
 #include "machinestate.h"
 #include "../shared/datapool.h"
 
+/* Use threaded dispatch (computed goto) when
+ * the compiler supports labels as values, define 
+ * MACIA_SWITCH_DISPATCH to force the switch loop */
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MACIA_SWITCH_DISPATCH)
+#define MACIA_THREADED_DISPATCH
+#endif
+
 /* The object instance 
  * this is used for objects when new instances
  * of something is created */
 class ObjectInstance
 {
 public:
-	ObjectInstance(size_t Size, CodeObject *Type) {
-		m_pBase = malloc(Size);
+	ObjectInstance(CompiledType_t *Type) {
+		m_pFields = (Value_t*)calloc(Type->FieldCount + 1, sizeof(Value_t));
 		m_pType = Type;
-		m_iSize = Size;
 	}
 
 	~ObjectInstance() {
-		free(m_pBase);
+		free(m_pFields);
 	}
 
 	/* Gets */
-	CodeObject *GetType() { return m_pType; }
-	size_t GetSize() { return m_iSize; }
-	void *GetBase() { return m_pBase; }
+	CompiledType_t *GetType() { return m_pType; }
+	int GetFieldCount() { return m_pType->FieldCount; }
+	Value_t *GetFields() { return m_pFields; }
 
 private:
 	/* Private - Data */
-	CodeObject *m_pType;
-	size_t m_iSize;
-	void *m_pBase;
+	CompiledType_t *m_pType;
+	Value_t *m_pFields;
 };
 
 /* The interpreter class 
@@ -68,14 +75,35 @@ public:
 	Interpreter(DataPool *pPool);
 	~Interpreter();
 
+	/* Decodes all code objects in the pool, this is 
+	 * done automatically by Execute if not done before */
+	int Compile();
+
 	/* Run the interpreter
 	 * this returns when the code is at end */
 	int Execute();
 
 private:
 	/* Private - Functions */
-	int ExecuteCode(ObjectInstance *Instance, std::vector<unsigned char> &Code);
+	int CompileFunction(CompiledFunction_t *Function);
+	int ResolveOperand(CompiledFunction_t *Function, int Id, Operand_t *Operand);
+	int ExecuteCode(CompiledFunction_t *Function, ObjectInstance *Instance);
+	ObjectInstance *CreateInstance(CompiledType_t *Type);
 
 	/* Private - Data */
 	DataPool *m_pPool;
-};
\ No newline at end of file
+	int m_iCompiled;
+	int m_iThreaded;
+	CompiledFunction_t *m_pEntry;
+
+	/* Private - Decoded code and types, by id */
+	std::map<int, CompiledFunction_t*> m_sFunctions;
+	std::map<int, CompiledType_t*> m_sTypes;
+
+	/* Private - Runtime state */
+	std::map<int, int> m_sStaticIndex;
+	std::vector<Value_t> m_lStatics;
+	std::vector<Value_t> m_lStack;
+	std::vector<CallFrame_t> m_lCalls;
+	std::vector<ObjectInstance*> m_lInstances;
+};
@@ -0,0 +1,118 @@
+/* The Macia Language (MACIA)
+*
+* Copyright 2016, Philip Meulengracht
+*
+* This program is free software : you can redistribute it and / or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation ? , either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.If not, see <http://www.gnu.org/licenses/>.
+*
+*
+* Macia - Virtual Machine State
+* - Describes the runtime values and the pre-decoded
+* - instruction format the virtual machine executes
+*/
+#pragma once
+
+/* Includes */
+#include <cstddef>
+#include <vector>
+
+/* Forward declarations */
+class CodeObject;
+class ObjectInstance;
+
+/* The register count of a frame, this must match
+ * the register count the generator allocates from */
+#define MACIA_FRAME_REGISTERS	4
+
+/* Limits of the virtual machine, the value stack
+ * holds the registers and locals of all active frames */
+#define MACIA_STACK_SIZE		0x10000
+#define MACIA_MAX_CALLDEPTH		256
+
+/* The value type
+ * Identifies what a value contains */
+typedef enum {
+	ValueNone,
+	ValueInteger,
+	ValueString,
+	ValueObject
+} ValueType_t;
+
+/* The value 
+ * Registers, locals, fields and statics all hold values */
+typedef struct {
+	ValueType_t Type;
+	union {
+		long long Integer;
+		const char *String;
+		ObjectInstance *Object;
+	} Data;
+} Value_t;
+
+/* The storage class of an operand, this is resolved
+ * when decoding so no symbol lookups happen at runtime 
+ * Frame  - Index into the registers and locals of the active frame
+ * Field  - Index into the fields of the active instance
+ * Static - Index into the global variables and constants */
+typedef enum {
+	StorageFrame,
+	StorageField,
+	StorageStatic
+} Storage_t;
+
+/* The operand
+ * A resolved reference to a value */
+typedef struct {
+	Storage_t Storage;
+	int Index;
+} Operand_t;
+
+/* The decoded instruction 
+ * Opcodes are decoded once into this fixed-size format, 
+ * with all their ids resolved to operands or pointers */
+typedef struct {
+	const void *Handler;		/* Dispatch target, resolved on first execution */
+	int Opcode;					/* Opcode_t */
+	Operand_t Target;
+	Operand_t Source;
+	long long Immediate;
+	void *Pointer;				/* Resolved function, type or branch target */
+} Instruction_t;
+
+/* The compiled function 
+ * The decoded instructions of a code object */
+typedef struct {
+	CodeObject *Source;
+	int Id;
+	int OwnerId;				/* Id of the object the fields belong to */
+	int FrameSize;				/* Registers + locals */
+	std::vector<Instruction_t> Code;
+} CompiledFunction_t;
+
+/* The compiled object type 
+ * The initializer runs the field initializations on new */
+typedef struct {
+	CodeObject *Source;
+	int Id;
+	int FieldCount;
+	CompiledFunction_t *Initializer;
+} CompiledType_t;
+
+/* The call frame 
+ * Saved state of the caller during an invoke */
+typedef struct {
+	const Instruction_t *ReturnAddress;
+	CompiledFunction_t *Function;
+	Value_t *Frame;
+	ObjectInstance *Instance;
+} CallFrame_t;
@@ -31,7 +31,7 @@ CodeObject::CodeObject(CodeType_t pType, const char *pIdentifier,
 
 	/* Store */
 	m_eType = pType;
-	m_pIdentifier = strdup(pIdentifier);
+	m_pIdentifier = (pIdentifier != NULL) ? strdup(pIdentifier) : NULL;
 	m_pPath = pPath;
 	m_iScopeId = pScopeId;
 
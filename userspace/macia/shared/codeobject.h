@@ -65,6 +65,8 @@ public:
 	char *GetIdentifier() { return m_pIdentifier; }
 	int GetScopeId() { return m_iScopeId; }
 	int GetOffset() { return m_iOffset; }
+	int GetFunctionCount() { return m_iFunctionsDefined; }
+	int GetVariableCount() { return m_iVariablesDefined; }
 
 private:
 	/* Private - ByteCode */
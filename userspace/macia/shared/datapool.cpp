@@ -23,7 +23,7 @@
 
 /* Includes */
 #include "datapool.h"
-#include <strings.h>
+#include <cctype>
 #include <cstdio>
 
 /* Constructor 
@@ -35,6 +35,8 @@ DataPool::DataPool() {
 
 	/* Clear out to be sure */
 	m_sTable.clear();
+	m_sSymbols.clear();
+	m_sStrings.clear();
 }
 
 /* Destructor 
@@ -43,25 +45,31 @@ DataPool::~DataPool() {
 
 }
 
+/* Creates the key a path is interned under, paths
+ * are case-insensitive so the key is lower-case */
+std::string DataPool::CreateKey(const char *pPath) {
+
+	/* Variables */
+	std::string Key(pPath);
+
+	/* Lower-case it */
+	for (size_t i = 0; i < Key.size(); i++) {
+		Key[i] = (char)tolower((unsigned char)Key[i]);
+	}
+	return Key;
+}
+
 /* Checks for dublicates path */
 int DataPool::CheckDublicate(const char *pIdentifier, const char *pPath) {
 	
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (!strcasecmp(Obj->GetPath(), pPath)) {
-
-			/* So, it exists */
-			printf("Dublicate objects with name %s\n", pIdentifier);
-
-			/* Err, bail out */
-			return -1;
-		}
+	/* Lookup the interned path */
+	if (m_sSymbols.find(CreateKey(pPath)) != m_sSymbols.end()) {
+
+		/* So, it exists */
+		printf("Dublicate objects with name %s\n", pIdentifier);
+
+		/* Err, bail out */
+		return -1;
 	}
 
 	/* Yay! */
@@ -75,41 +83,42 @@ char *DataPool::CreatePath(int ScopeId, const char *Identifier) {
 	/* Static storage */
 	char Buffer[256];
 
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-		int Id = Itr->first;
-		
-		/* Have we found the mothership? */
-		if (Id == ScopeId) {
-
-			/* Yes, calculate a new path 
-			 * Clear out temp storage */
-			memset(&Buffer[0], 0, sizeof(Buffer));
-
-			/* Now combine efforts here */
-			sprintf(&Buffer[0], "%s.%s", Obj->GetPath(), Identifier);
-
-			/* Done, why thank you very much */
-			return strdup(&Buffer[0]);
-		}
-	}
+	/* Lookup the mothership */
+	CodeObject *Obj = GetObject(ScopeId);
 
 	/* Uh, in the rare case there is none */
-	return strdup(Identifier);
+	if (Obj == NULL) {
+		return strdup(Identifier);
+	}
+
+	/* Yes, calculate a new path 
+	 * Clear out temp storage */
+	memset(&Buffer[0], 0, sizeof(Buffer));
+
+	/* Now combine efforts here */
+	snprintf(&Buffer[0], sizeof(Buffer), "%s.%s", Obj->GetPath(), Identifier);
+
+	/* Done, why thank you very much */
+	return strdup(&Buffer[0]);
+}
+
+/* Inserts a new code object into the table and 
+ * interns its path, returns the id allocated */
+int DataPool::InsertObject(CodeObject *pObject) {
+
+	/* Allocate id */
+	int Id = m_iIdGen++;
+
+	/* Insert */
+	m_sTable[Id] = pObject;
+	m_sSymbols[CreateKey(pObject->GetPath())] = Id;
+	return Id;
 }
 
 /* Create a new object and return
  * the id for the current scope */
 int DataPool::CreateObject(const char *pIdentifier) {
 
-	/* Variables */
-	CodeObject *dObj = NULL;
-	int Id = 0;
-
 	/* Should calculate path here but we don't 
 	 * need to support nested objects for now */
 
@@ -117,17 +126,8 @@ int DataPool::CreateObject(const char *pIdentifier) {
 	if (CheckDublicate(pIdentifier, pIdentifier))
 		return -1;
 
-	/* Allocate id */
-	Id = m_iIdGen++;
-
-	/* Create a new object */
-	dObj = new CodeObject(CTObject, pIdentifier, pIdentifier, -1);
-
-	/* Insert */
-	m_sTable[Id] = dObj;
-
-	/* Done! */
-	return Id;
+	/* Create and insert a new object */
+	return InsertObject(new CodeObject(CTObject, pIdentifier, pIdentifier, -1));
 }
 
 /* Create a new function for the given scope
@@ -138,21 +138,18 @@ int DataPool::CreateFunction(const char *pIdentifier, int ScopeId) {
 	CodeObject *OwnerObj = NULL;
 	CodeObject *dObj = NULL;
 	char *Path = NULL;
-	int Id = 0;
 
 	/* Calculate path first based on scope */
 	Path = CreatePath(ScopeId, pIdentifier);
 
 	/* Step 1. Does it exist? */
-	if (CheckDublicate(pIdentifier, Path))
+	if (CheckDublicate(pIdentifier, Path)) {
+		free(Path);
 		return -1;
+	}
 
 	/* Lookup Owner */
-	if (ScopeId != -1)
-		OwnerObj = m_sTable[ScopeId];
-
-	/* Allocate id */
-	Id = m_iIdGen++;
+	OwnerObj = GetObject(ScopeId);
 
 	/* Create a new object */
 	dObj = new CodeObject(CTFunction, pIdentifier, Path, ScopeId);
@@ -163,10 +160,7 @@ int DataPool::CreateFunction(const char *pIdentifier, int ScopeId) {
 		dObj->SetOffset(OwnerObj->AllocateFunctionOffset());
 
 	/* Insert */
-	m_sTable[Id] = dObj;
-
-	/* Done! */
-	return Id;
+	return InsertObject(dObj);
 }
 
 /* Create a new variable for the given scope
@@ -177,21 +171,18 @@ int DataPool::DefineVariable(const char *pIdentifier, int ScopeId) {
 	CodeObject *OwnerObj = NULL;
 	CodeObject *dObj = NULL;
 	char *Path = NULL;
-	int Id = 0;
 
 	/* Calculate path first based on scope */
 	Path = CreatePath(ScopeId, pIdentifier);
 
 	/* Step 1. Does it exist? */
-	if (CheckDublicate(pIdentifier, Path))
+	if (CheckDublicate(pIdentifier, Path)) {
+		free(Path);
 		return -1;
+	}
 
 	/* Lookup Owner */
-	if (ScopeId != -1)
-		OwnerObj = m_sTable[ScopeId];
-
-	/* Allocate id */
-	Id = m_iIdGen++;
+	OwnerObj = GetObject(ScopeId);
 
 	/* Create a new object */
 	dObj = new CodeObject(CTVariable, pIdentifier, Path, ScopeId);
@@ -202,10 +193,7 @@ int DataPool::DefineVariable(const char *pIdentifier, int ScopeId) {
 		dObj->SetOffset(OwnerObj->AllocateVariableOffset());
 
 	/* Insert */
-	m_sTable[Id] = dObj;
-
-	/* Done! */
-	return Id;
+	return InsertObject(dObj);
 }
 
 /* Creates a new string in the string pool
@@ -214,38 +202,30 @@ int DataPool::DefineString(const char *pString) {
 
 	/* Create Path */
 	char Buffer[1024];
-	CodeObject *dObj = NULL;
+	std::map<std::string, int>::iterator Itr;
 	int Id = 0;
 
 	/* Clear out buffer */
 	memset(&Buffer[0], 0, sizeof(Buffer));
 
 	/* Format the string */
-	sprintf(&Buffer[0], "StringPool.%s", pString);
-
-	/* Check dublicates */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (Obj->GetType() == CTString 
-			&& !strcmp(Obj->GetPath(), &Buffer[0])) {
-			/* Yay! String pool optimizations */
-			return Itr->first;
-		}
+	snprintf(&Buffer[0], sizeof(Buffer), "StringPool.%s", pString);
+
+	/* Check dublicates, strings are case-sensitive 
+	 * so they are interned on their own */
+	Itr = m_sStrings.find(&Buffer[0]);
+	if (Itr != m_sStrings.end()) {
+		/* Yay! String pool optimizations */
+		return Itr->second;
 	}
 
-	/* Allocate id */
+	/* Allocate id, strings are not
+	 * looked up by path so they are not interned as a symbol */
 	Id = m_iIdGen++;
 
 	/* Create a new object */
-	dObj = new CodeObject(CTString, NULL, strdup(&Buffer[0]), -1);
-
-	/* Insert */
-	m_sTable[Id] = dObj;
+	m_sTable[Id] = new CodeObject(CTString, NULL, strdup(&Buffer[0]), -1);
+	m_sStrings[&Buffer[0]] = Id;
 
 	/* Done! */
 	return Id;
@@ -255,21 +235,23 @@ int DataPool::DefineString(const char *pString) {
  * scope and identifier */
 int DataPool::LookupSymbol(const char *pIdentifier, int ScopeId) {
 
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (Obj->GetIdentifier() != NULL
-			&& !strcasecmp(Obj->GetIdentifier(), pIdentifier)
-			&& Obj->GetScopeId() == ScopeId) {
-			
-			/* Yay! Found! */
-			return Itr->first;
-		}
+	/* Variables */
+	std::map<std::string, int>::iterator Itr;
+	CodeObject *OwnerObj = GetObject(ScopeId);
+	std::string Key;
+
+	/* The path of a symbol is always its owners path
+	 * and the identifier */
+	if (OwnerObj != NULL) {
+		Key = CreateKey(OwnerObj->GetPath()) + ".";
+	}
+	Key += CreateKey(pIdentifier);
+
+	/* Lookup and make sure the scope matches */
+	Itr = m_sSymbols.find(Key);
+	if (Itr != m_sSymbols.end()
+		&& m_sTable[Itr->second]->GetScopeId() == ScopeId) {
+		return Itr->second;
 	}
 
 	/* Err - Not found - Bail */
@@ -280,161 +262,96 @@ int DataPool::LookupSymbol(const char *pIdentifier, int ScopeId) {
  * identifier path */
 CodeObject *DataPool::LookupObject(const char *pPath) {
 
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (!strcasecmp(Obj->GetPath(), pPath)) {
-
-			/* Yay! Found! */
-			return Obj;
-		}
+	/* Lookup the interned path */
+	std::map<std::string, int>::iterator Itr = m_sSymbols.find(CreateKey(pPath));
+	if (Itr != m_sSymbols.end()) {
+		return m_sTable[Itr->second];
 	}
 
 	/* Err - Not found - Bail */
 	return NULL;
 }
 
-/* Appends bytecode to a code-object
- * this redirects the bytecode to the id given */
-int DataPool::AddOpcode(int ScopeId, Opcode_t Opcode) {
-
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
+/* Retrieves a code object from the 
+ * given id, returns NULL if it does not exist */
+CodeObject *DataPool::GetObject(int Id) {
 
-		/* Compare path */
-		if (Itr->first == ScopeId) {
-
-			/* Yay! Found! Add code */
-			Obj->AddCode(Opcode & 0xFF);
-
-			/* Done! */
-			return 0;
-		}
+	/* Lookup id */
+	std::map<int, CodeObject*>::iterator Itr = m_sTable.find(Id);
+	if (Itr != m_sTable.end()) {
+		return Itr->second;
 	}
+	return NULL;
+}
 
-	/* Err - Not found - Bail */
-	return -1;
+/* Appends bytecode to a code-object
+ * this redirects the bytecode to the id given */
+int DataPool::AddOpcode(int ScopeId, Opcode_t Opcode) {
+	return AddCode8(ScopeId, (char)(Opcode & 0xFF));
 }
 
 /* Appends bytecode to a code-object
  * this redirects the bytecode to the id given */
 int DataPool::AddCode8(int ScopeId, char Value) {
 
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (Itr->first == ScopeId) {
-
-			/* Yay! Found! Add code */
-			Obj->AddCode(Value);
-
-			/* Done! */
-			return 0;
-		}
+	/* Lookup the code object */
+	CodeObject *Obj = GetObject(ScopeId);
+	if (Obj == NULL) {
+		return -1;
 	}
 
-	/* Err - Not found - Bail */
-	return -1;
+	/* Add code */
+	Obj->AddCode(Value);
+	return 0;
 }
 
 /* Appends bytecode to a code-object
  * this redirects the bytecode to the id given */
 int DataPool::AddCode16(int ScopeId, short Value) {
 
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (Itr->first == ScopeId) {
-
-			/* Yay! Found! Add code */
-			Obj->AddCode(Value & 0xFF);
-			Obj->AddCode((Value >> 8) & 0xFF);
-
-			/* Done! */
-			return 0;
-		}
+	/* Lookup the code object */
+	CodeObject *Obj = GetObject(ScopeId);
+	if (Obj == NULL) {
+		return -1;
 	}
 
-	/* Err - Not found - Bail */
-	return -1;
+	/* Add code */
+	Obj->AddCode(Value & 0xFF);
+	Obj->AddCode((Value >> 8) & 0xFF);
+	return 0;
 }
 
 /* Appends bytecode to a code-object
  * this redirects the bytecode to the id given */
 int DataPool::AddCode32(int ScopeId, int Value) {
 	
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (Itr->first == ScopeId) {
-
-			/* Yay! Found! Add code */
-			Obj->AddCode(Value & 0xFF);
-			Obj->AddCode((Value >> 8) & 0xFF);
-			Obj->AddCode((Value >> 16) & 0xFF);
-			Obj->AddCode((Value >> 24) & 0xFF);
-
-			/* Done! */
-			return 0;
-		}
+	/* Lookup the code object */
+	CodeObject *Obj = GetObject(ScopeId);
+	if (Obj == NULL) {
+		return -1;
 	}
 
-	/* Err - Not found - Bail */
-	return -1;
+	/* Add code */
+	Obj->AddCode(Value & 0xFF);
+	Obj->AddCode((Value >> 8) & 0xFF);
+	Obj->AddCode((Value >> 16) & 0xFF);
+	Obj->AddCode((Value >> 24) & 0xFF);
+	return 0;
 }
 
 /* Appends bytecode to a code-object
  * this redirects the bytecode to the id given */
 int DataPool::AddCode64(int ScopeId, long long Value) {
 
-	/* Iterate our code objects */
-	for (std::map<int, CodeObject*>::iterator Itr = m_sTable.begin();
-		Itr != m_sTable.end(); ++Itr)
-	{
-		/* Get dataobject */
-		CodeObject *Obj = Itr->second;
-
-		/* Compare path */
-		if (Itr->first == ScopeId) {
-
-			/* Yay! Found! Add code */
-			Obj->AddCode(Value & 0xFF);
-			Obj->AddCode((Value >> 8) & 0xFF);
-			Obj->AddCode((Value >> 16) & 0xFF);
-			Obj->AddCode((Value >> 24) & 0xFF);
-			Obj->AddCode((Value >> 32) & 0xFF);
-			Obj->AddCode((Value >> 40) & 0xFF);
-			Obj->AddCode((Value >> 48) & 0xFF);
-
-			/* Done! */
-			return 0;
-		}
+	/* Lookup the code object */
+	CodeObject *Obj = GetObject(ScopeId);
+	if (Obj == NULL) {
+		return -1;
 	}
 
-	/* Err - Not found - Bail */
-	return -1;
-}
\ No newline at end of file
+	/* Add code */
+	for (int i = 0; i < 8; i++) {
+		Obj->AddCode((Value >> (i * 8)) & 0xFF);
+	}
+	return 0;
+}
@@ -26,6 +26,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <map>
+#include <string>
 
 /* System Includes */
 #include "../generator/opcodes.h"
@@ -64,6 +65,10 @@ public:
 	 * identifier path */
 	CodeObject *LookupObject(const char *pPath);
 
+	/* Retrieves a code object from the 
+	 * given id, returns NULL if it does not exist */
+	CodeObject *GetObject(int Id);
+
 	/* Calculates the memory requirement of 
 	 * an object, returned as bytes */
 	int CalculateObjectSize(int ObjectId);
@@ -83,8 +88,15 @@ private:
 	/* Private - Functions */
 	int CheckDublicate(const char *pIdentifier, const char *pPath);
 	char *CreatePath(int ScopeId, const char *Identifier);
+	std::string CreateKey(const char *pPath);
+	int InsertObject(CodeObject *pObject);
 
 	/* Private - Data */
 	std::map<int, CodeObject*> m_sTable;
+
+	/* Private - Interned symbols, 
+	 * maps paths to the id of their code object */
+	std::map<std::string, int> m_sSymbols;
+	std::map<std::string, int> m_sStrings;
 	int m_iIdGen;
 };
\ No newline at end of file
@@ -0,0 +1,368 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS - Sampling Profiler Frontend
+ *  - Runs the system wide sampling profiler for a period of time and prints a
+ *    flat profile, the call-graph is written as folded stacks which can be fed
+ *    directly to flamegraph tools.
+ *    Usage: profiler [-t seconds] [-i ticks] [-n entries] [-o folded-file]
+ */
+
+#include <os/mollenos.h>
+#include <threads.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PROFILER_READ_SIZE      (64 * 1024)
+#define PROFILER_DRAIN_MS       250
+
+/* ProfileEntry
+ * Counters for a unique key, keys are either complete stacks or single frames */
+typedef struct _ProfileEntry {
+    char*   Key;
+    size_t  Self;
+    size_t  Total;
+    size_t  Generation;
+} ProfileEntry_t;
+
+/* ProfileTable
+ * Open addressing hash-table of profile entries, the capacity is a power of two */
+typedef struct _ProfileTable {
+    ProfileEntry_t* Entries;
+    size_t          Capacity;
+    size_t          Count;
+} ProfileTable_t;
+
+static ProfileTable_t Stacks    = { 0 };
+static ProfileTable_t Symbols   = { 0 };
+static size_t NumberOfSamples   = 0;
+
+/* ProfileHash
+ * FNV-1a hash of the first <Length> bytes of the key */
+static size_t
+ProfileHash(
+    _In_ const char*    Key,
+    _In_ size_t         Length)
+{
+    size_t Hash = 2166136261U;
+    size_t i;
+    for (i = 0; i < Length; i++) {
+        Hash = (Hash ^ (unsigned char)Key[i]) * 16777619U;
+    }
+    return Hash;
+}
+
+/* ProfileLookup
+ * Finds or creates the entry for the key, returns NULL on allocation failures */
+static ProfileEntry_t*
+ProfileLookup(
+    _In_ ProfileTable_t*    Table,
+    _In_ const char*        Key,
+    _In_ size_t             Length)
+{
+    size_t Index;
+
+    // Keep the load below 50%
+    if ((Table->Count + 1) * 2 > Table->Capacity) {
+        ProfileTable_t Grown;
+        size_t i;
+
+        Grown.Capacity  = (Table->Capacity == 0) ? 256 : Table->Capacity * 2;
+        Grown.Count     = Table->Count;
+        Grown.Entries   = (ProfileEntry_t*)calloc(Grown.Capacity, sizeof(ProfileEntry_t));
+        if (Grown.Entries == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < Table->Capacity; i++) {
+            if (Table->Entries[i].Key != NULL) {
+                Index = ProfileHash(Table->Entries[i].Key, strlen(Table->Entries[i].Key)) & (Grown.Capacity - 1);
+                while (Grown.Entries[Index].Key != NULL) {
+                    Index = (Index + 1) & (Grown.Capacity - 1);
+                }
+                Grown.Entries[Index] = Table->Entries[i];
+            }
+        }
+        free(Table->Entries);
+        *Table = Grown;
+    }
+
+    Index = ProfileHash(Key, Length) & (Table->Capacity - 1);
+    while (Table->Entries[Index].Key != NULL) {
+        if (!strncmp(Table->Entries[Index].Key, Key, Length) && Table->Entries[Index].Key[Length] == '\0') {
+            return &Table->Entries[Index];
+        }
+        Index = (Index + 1) & (Table->Capacity - 1);
+    }
+
+    Table->Entries[Index].Key = (char*)malloc(Length + 1);
+    if (Table->Entries[Index].Key == NULL) {
+        return NULL;
+    }
+    memcpy(Table->Entries[Index].Key, Key, Length);
+    Table->Entries[Index].Key[Length] = '\0';
+    Table->Count++;
+    return &Table->Entries[Index];
+}
+
+/* ProfileNormalize
+ * Strips the offsets from frames resolved to an export ('module!symbol+0x10') so
+ * samples are accounted per function. Returns the new length of the line. */
+static size_t
+ProfileNormalize(
+    _In_ char*          Line,
+    _In_ size_t         Length)
+{
+    size_t Read, Write  = 0;
+    int HasSymbol       = 0;
+    int Skipping        = 0;
+
+    for (Read = 0; Read < Length; Read++) {
+        char Character = Line[Read];
+        if (Character == ';' || Character == ' ') {
+            HasSymbol   = 0;
+            Skipping    = 0;
+        }
+        else if (Character == '!') {
+            HasSymbol   = 1;
+        }
+        else if (Character == '+' && HasSymbol) {
+            Skipping    = 1;
+        }
+        if (!Skipping) {
+            Line[Write++] = Character;
+        }
+    }
+    return Write;
+}
+
+/* ProfileAddSample
+ * Accounts a single folded stack line. The leaf frame gets the self time, every
+ * unique frame on the stack gets the inclusive time once. */
+static void
+ProfileAddSample(
+    _In_ const char*    Line,
+    _In_ size_t         Length)
+{
+    ProfileEntry_t *Entry   = NULL;
+    const char *Frame       = Line;
+    const char *End;
+    size_t Count;
+
+    // Lines end with ' <count>'
+    End = Line + Length;
+    while (End > Line && End[-1] != ' ') {
+        End--;
+    }
+    if (End == Line) {
+        return;
+    }
+    Count   = strtoul(End, NULL, 10);
+    End--;
+
+    Entry = ProfileLookup(&Stacks, Line, (size_t)(End - Line));
+    if (Entry != NULL) {
+        Entry->Total += Count;
+    }
+    NumberOfSamples += Count;
+
+    // Skip the process name, it is the root of the stack
+    Frame = memchr(Line, ';', (size_t)(End - Line));
+    while (Frame != NULL && Frame < End) {
+        const char *Next = memchr(Frame + 1, ';', (size_t)(End - (Frame + 1)));
+        const char *Stop = (Next != NULL) ? Next : End;
+
+        Entry = ProfileLookup(&Symbols, Frame + 1, (size_t)(Stop - (Frame + 1)));
+        if (Entry != NULL) {
+            // Recursion must not count the same frame twice
+            if (Entry->Generation != NumberOfSamples) {
+                Entry->Generation   = NumberOfSamples;
+                Entry->Total        += Count;
+            }
+            if (Next == NULL) {
+                Entry->Self += Count;
+            }
+        }
+        Frame = Next;
+    }
+}
+
+/* ProfileDrain
+ * Reads all samples currently available from the kernel */
+static void
+ProfileDrain(
+    _In_ char*          Buffer)
+{
+    size_t BytesRead = 0;
+
+    while (ProfilerRead(Buffer, PROFILER_READ_SIZE, &BytesRead) == OsSuccess && BytesRead != 0) {
+        char *Line = Buffer;
+        char *End  = Buffer + BytesRead;
+        while (Line < End) {
+            char *NewLine = memchr(Line, '\n', (size_t)(End - Line));
+            if (NewLine == NULL) {
+                break;
+            }
+            if (*Line == '#') {
+                *NewLine = '\0';
+                printf("%s\n", Line);
+            }
+            else {
+                ProfileAddSample(Line, ProfileNormalize(Line, (size_t)(NewLine - Line)));
+            }
+            Line = NewLine + 1;
+        }
+    }
+}
+
+/* ProfileCompareSelf
+ * Sorts entries by self time, then by inclusive time */
+static int
+ProfileCompareSelf(
+    _In_ const void*    Left,
+    _In_ const void*    Right)
+{
+    const ProfileEntry_t *A = *(const ProfileEntry_t**)Left;
+    const ProfileEntry_t *B = *(const ProfileEntry_t**)Right;
+    if (A->Self != B->Self) {
+        return (A->Self < B->Self) ? 1 : -1;
+    }
+    if (A->Total != B->Total) {
+        return (A->Total < B->Total) ? 1 : -1;
+    }
+    return 0;
+}
+
+/* ProfilePrintFlat
+ * Prints the <Entries> symbols with the highest self time */
+static void
+ProfilePrintFlat(
+    _In_ size_t         Entries)
+{
+    ProfileEntry_t **Sorted = NULL;
+    size_t Count            = 0;
+    size_t i;
+
+    if (NumberOfSamples == 0) {
+        printf("no samples captured\n");
+        return;
+    }
+
+    Sorted = (ProfileEntry_t**)malloc(Symbols.Count * sizeof(ProfileEntry_t*));
+    if (Sorted == NULL) {
+        return;
+    }
+    for (i = 0; i < Symbols.Capacity; i++) {
+        if (Symbols.Entries[i].Key != NULL) {
+            Sorted[Count++] = &Symbols.Entries[i];
+        }
+    }
+    qsort(Sorted, Count, sizeof(ProfileEntry_t*), ProfileCompareSelf);
+
+    printf("%u samples, %u unique stacks\n", NumberOfSamples, Stacks.Count);
+    printf("  self%%  total%%     self    total  symbol\n");
+    for (i = 0; i < Count && i < Entries; i++) {
+        printf("%6u %7u %8u %8u  %s\n",
+            (Sorted[i]->Self * 100) / NumberOfSamples, (Sorted[i]->Total * 100) / NumberOfSamples,
+            Sorted[i]->Self, Sorted[i]->Total, Sorted[i]->Key);
+    }
+    free(Sorted);
+}
+
+/* ProfileWriteFolded
+ * Writes the call-graph as folded stacks, one unique stack per line */
+static int
+ProfileWriteFolded(
+    _In_ const char*    Path)
+{
+    FILE *Output = fopen(Path, "w");
+    size_t i;
+
+    if (Output == NULL) {
+        printf("profiler: failed to open %s\n", Path);
+        return -1;
+    }
+    for (i = 0; i < Stacks.Capacity; i++) {
+        if (Stacks.Entries[i].Key != NULL) {
+            fprintf(Output, "%s %u\n", Stacks.Entries[i].Key, Stacks.Entries[i].Total);
+        }
+    }
+    fclose(Output);
+    return 0;
+}
+
+/* main
+ * Profiles the system for the requested time and reports the result */
+int
+main(int argc, char **argv)
+{
+    const char *FoldedPath  = NULL;
+    size_t Interval         = 1;
+    size_t Duration         = 5000;
+    size_t Entries          = 25;
+    size_t Elapsed          = 0;
+    char *Buffer            = NULL;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && (i + 1) < argc) {
+            Duration = strtoul(argv[++i], NULL, 10) * 1000;
+        }
+        else if (!strcmp(argv[i], "-i") && (i + 1) < argc) {
+            Interval = strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "-n") && (i + 1) < argc) {
+            Entries = strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "-o") && (i + 1) < argc) {
+            FoldedPath = argv[++i];
+        }
+        else {
+            printf("usage: profiler [-t seconds] [-i ticks] [-n entries] [-o folded-file]\n");
+            return -1;
+        }
+    }
+
+    Buffer = (char*)malloc(PROFILER_READ_SIZE);
+    if (Buffer == NULL) {
+        return -1;
+    }
+
+    if (ProfilerControl(PROFILER_RESET, 0) != OsSuccess
+        || ProfilerControl(PROFILER_START, Interval) != OsSuccess) {
+        printf("profiler: failed to start the sampling profiler\n");
+        free(Buffer);
+        return -1;
+    }
+
+    // Drain while running so the per-core buffers never overflow
+    while (Elapsed < Duration) {
+        thrd_sleepex(PROFILER_DRAIN_MS);
+        Elapsed += PROFILER_DRAIN_MS;
+        ProfileDrain(Buffer);
+    }
+    ProfilerControl(PROFILER_STOP, 0);
+    ProfileDrain(Buffer);
+    free(Buffer);
+
+    ProfilePrintFlat(Entries);
+    if (FoldedPath != NULL) {
+        return ProfileWriteFolded(FoldedPath);
+    }
+    return 0;
+}
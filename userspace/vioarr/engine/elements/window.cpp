@@ -21,6 +21,8 @@
  *    MollenOS.
  */
 #include "window.hpp"
+#include <threads.h>
+#include <cstring>
 
 CWindow::CWindow(CEntity* Parent, NVGcontext* VgContext, 
     const std::string &Title, int Width, int Height) : CEntity(Parent, VgContext) {
@@ -36,6 +38,13 @@ CWindow::CWindow(CEntity* Parent, NVGcontext* VgContext,
     m_StreamWidth       = 0;
     m_StreamHeight      = 0;
     m_StreamBuffer      = nullptr;
+    m_StreamCount       = 1;
+    m_StreamIndex       = 0;
+    m_DamageCount       = 0;
+    m_Sequence          = 0;
+    m_ChannelBuffer     = nullptr;
+    m_Channel           = nullptr;
+    m_ReleaseSignal     = 0;
     m_ResourceId        = 0;
 }
 
@@ -55,6 +64,9 @@ CWindow::~CWindow() {
     if (m_StreamBuffer != nullptr) {
         DestroyBuffer(m_StreamBuffer);
     }
+    if (m_ChannelBuffer != nullptr) {
+        DestroyBuffer(m_ChannelBuffer);
+    }
 }
 
 void CWindow::SetOwner(UUId_t Owner) {
@@ -78,12 +90,57 @@ void CWindow::SetActive(bool Active) {
 }
 
 void CWindow::SwapOnNextUpdate(bool Swap) {
-    m_Swap = Swap;
+    m_Swap          = Swap;
+    m_DamageCount   = 0;
+}
+
+// QueueSwap
+// Accumulates the damaged regions of a present until the next update, if the
+// regions no longer fit the entire surface is uploaded instead
+void CWindow::QueueSwap(const UISwapParameters_t &Parameters) {
+    if (Parameters.BufferIndex < 0 || Parameters.BufferIndex >= m_StreamCount) {
+        return;
+    }
+
+    if (Parameters.RectCount == 0 || Parameters.RectCount > UI_MAX_DAMAGE_RECTS
+        || (m_Swap && m_DamageCount == 0)
+        || (m_DamageCount + Parameters.RectCount) > UI_MAX_DAMAGE_RECTS) {
+        m_DamageCount = 0;
+    }
+    else {
+        memcpy(&m_Damage[m_DamageCount], &Parameters.Rects[0], Parameters.RectCount * sizeof(Rect_t));
+        m_DamageCount += Parameters.RectCount;
+    }
+    m_StreamIndex   = Parameters.BufferIndex;
+    m_Sequence      = Parameters.Sequence;
+    m_Swap          = true;
+}
+
+// QueueInput
+// Produces input events into the shared ring of the owner, events are dropped
+// and counted if the owner is not consuming them
+void CWindow::QueueInput(const MInput_t *Events, size_t Count) {
+    size_t Head;
+
+    if (m_Channel == nullptr) {
+        return;
+    }
+
+    Head = m_Channel->Head;
+    for (size_t i = 0; i < Count; i++) {
+        if ((Head - m_Channel->Tail) >= INPUT_RING_SIZE) {
+            m_Channel->Dropped++;
+            continue;
+        }
+        memcpy((void*)&m_Channel->Events[Head & (INPUT_RING_SIZE - 1)], &Events[i], sizeof(MInput_t));
+        MemoryBarrier();
+        m_Channel->Head = ++Head;
+    }
 }
 
 void CWindow::SetStreamingBufferFormat(GLenum Format, GLenum InternalFormat) {
-    m_Format            = m_Format;
-    m_InternalFormat    = m_InternalFormat;
+    m_Format            = Format;
+    m_InternalFormat    = InternalFormat;
 }
 
 void CWindow::SetStreamingBufferDimensions(int Width, int Height) {
@@ -95,6 +152,19 @@ void CWindow::SetStreamingBuffer(DmaBuffer_t* Buffer) {
     m_StreamBuffer = Buffer;
 }
 
+void CWindow::SetStreamingBufferCount(int Count) {
+    m_StreamCount = Count;
+}
+
+void CWindow::SetInputChannel(DmaBuffer_t* Channel) {
+    m_ChannelBuffer = Channel;
+    m_Channel       = (MWindowChannel_t*)GetBufferDataPointer(Channel);
+}
+
+void CWindow::SetReleaseSignal(cnd_t ReleaseSignal) {
+    m_ReleaseSignal = ReleaseSignal;
+}
+
 void CWindow::SetStreaming(bool Enable) {
     m_Streaming = Enable;
 
@@ -114,9 +184,35 @@ void CWindow::SetStreaming(bool Enable) {
 }
 
 void CWindow::Update(size_t MilliSeconds) {
+    const uint8_t *Surface;
+
     if (m_Streaming && m_Swap) {
-        nvgUpdateImage(m_VgContext, m_ResourceId, (const uint8_t*)GetBufferDataPointer(m_StreamBuffer));
-        m_Swap = false;
+        Surface = (const uint8_t*)GetBufferDataPointer(m_StreamBuffer) 
+            + ((size_t)m_StreamIndex * m_StreamWidth * m_StreamHeight * 4);
+
+        // Only upload what was damaged, the texture holds the previous present
+        if (m_DamageCount == 0) {
+            nvgUpdateImage(m_VgContext, m_ResourceId, Surface);
+        }
+        else {
+            for (size_t i = 0; i < m_DamageCount; i++) {
+                nvgUpdateImageRegion(m_VgContext, m_ResourceId, m_Damage[i].x, 
+                    m_Damage[i].y, m_Damage[i].w, m_Damage[i].h, Surface);
+            }
+        }
+        m_DamageCount   = 0;
+        m_Swap          = false;
+
+        // Hand the surface back to the owner, and wake it if it is waiting
+        if (m_Channel != nullptr) {
+            MemoryBarrier();
+            m_Channel->Released = m_Sequence;
+            MemoryBarrier();
+            if (m_Channel->Waiting && m_ReleaseSignal != 0) {
+                m_Channel->Waiting = 0;
+                cnd_signal(&m_ReleaseSignal);
+            }
+        }
     }
 }
 
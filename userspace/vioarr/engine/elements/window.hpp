@@ -23,6 +23,9 @@
 #pragma once
 #include "../entity.hpp"
 #include <os/buffer.h>
+#include <os/input.h>
+#include <os/ui.h>
+#include <threads.h>
 #include <string>
 
 // Window Settings
@@ -48,13 +51,19 @@ public:
     void SetTitle(const std::string &Title);
     void SetActive(bool Active);
     void SwapOnNextUpdate(bool Swap);
+    void QueueSwap(const UISwapParameters_t &Parameters);
+    void QueueInput(const MInput_t *Events, size_t Count);
 
     void SetStreamingBufferFormat(GLenum Format, GLenum InternalFormat);
     void SetStreamingBufferDimensions(int Width, int Height);
     void SetStreamingBuffer(DmaBuffer_t* Buffer);
+    void SetStreamingBufferCount(int Count);
+    void SetInputChannel(DmaBuffer_t* Channel);
+    void SetReleaseSignal(cnd_t ReleaseSignal);
     void SetStreaming(bool Enable);
 
     UUId_t GetOwner() const { return m_Owner; }
+    bool IsActive() const { return m_Active; }
 
 protected:
     // Override the inherited methods
@@ -78,4 +87,16 @@ private:
     int             m_StreamWidth;
     int             m_StreamHeight;
     DmaBuffer_t*    m_StreamBuffer;
+    int             m_StreamCount;
+    int             m_StreamIndex;
+
+    // Damage since last update, a count of 0 means the entire surface
+    Rect_t          m_Damage[UI_MAX_DAMAGE_RECTS];
+    size_t          m_DamageCount;
+    unsigned        m_Sequence;
+
+    // Shared channel with the owner
+    DmaBuffer_t*        m_ChannelBuffer;
+    MWindowChannel_t*   m_Channel;
+    cnd_t               m_ReleaseSignal;
 };
@@ -120,6 +120,22 @@ bool CVEightEngine::IsWindowHandleValid(Handle_t WindowHandle) {
     return false;
 }
 
+// GetActiveWindow
+// Iterates all root handles to find the window that currently has focus
+Handle_t CVEightEngine::GetActiveWindow() {
+    CWindow *WindowInstance = nullptr;
+    auto Elements           = m_RootEntity->GetChildren();
+
+    for (auto i = Elements.begin(); i != Elements.end(); i++) {
+        CEntity *Element    = *i;
+        WindowInstance      = dynamic_cast<CWindow*>(Element);
+        if (WindowInstance != nullptr && WindowInstance->IsActive()) {
+            return (Handle_t)WindowInstance;
+        }
+    }
+    return nullptr;
+}
+
 // ClampToScreenAxisX
 // Clamps the given value to screen coordinates on the X axis
 // to the range of -1:1
@@ -27,7 +27,8 @@ public:
     enum EVioarrEventType {
         EventWindowCreated,
         EventWindowDestroy,
-        EventWindowUpdate
+        EventWindowUpdate,
+        EventInput
     };
     CVioarrEvent(EVioarrEventType Type) {
         _Type = Type;
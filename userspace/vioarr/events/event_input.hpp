@@ -0,0 +1,40 @@
+/* MollenOS
+ *
+ * Copyright 2018, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * MollenOS - Vioarr Window Compositor System
+ *  - The window compositor system and general window manager for
+ *    MollenOS.
+ */
+#pragma once
+#include <os/input.h>
+#include <cstring>
+#include "event.hpp"
+
+class CInputEvent : public CVioarrEvent {
+public:
+    CInputEvent(const MInput_t *Events, size_t Count) : CVioarrEvent(EventInput) {
+        m_Count = (Count > INPUT_BATCH_MAX_EVENTS) ? INPUT_BATCH_MAX_EVENTS : Count;
+        memcpy(&m_Events[0], Events, m_Count * sizeof(MInput_t));
+    }
+    ~CInputEvent() { }
+    const MInput_t *GetEvents() const { return &m_Events[0]; }
+    size_t GetCount() const { return m_Count; }
+private:
+    MInput_t    m_Events[INPUT_BATCH_MAX_EVENTS];
+    size_t      m_Count;
+};
@@ -23,6 +23,8 @@
 #pragma once
 #include "../engine/elements/window.hpp"
 #include "event.hpp"
+#include <cstddef>
+#include <cstring>
 
 class CWindowCreatedEvent : public CVioarrEvent {
 public:
@@ -37,13 +39,19 @@ private:
 
 class CWindowUpdateEvent : public CVioarrEvent {
 public:
-    CWindowUpdateEvent(CWindow *Window) : CVioarrEvent(EventWindowUpdate) {
-        m_Window = Window;
+    CWindowUpdateEvent(CWindow *Window, const UISwapParameters_t *Parameters) : CVioarrEvent(EventWindowUpdate) {
+        // Only the used rects were transferred, so don't copy the whole structure
+        size_t Count    = (Parameters->RectCount > UI_MAX_DAMAGE_RECTS) ? 0 : Parameters->RectCount;
+        m_Window        = Window;
+        memcpy(&m_Parameters, Parameters, offsetof(UISwapParameters_t, Rects) + (Count * sizeof(Rect_t)));
+        m_Parameters.RectCount = Count;
     }
     ~CWindowUpdateEvent() { }
     CWindow *GetWindow() const { return m_Window; }
+    const UISwapParameters_t &GetParameters() const { return m_Parameters; }
 private:
-    CWindow *m_Window;
+    CWindow*            m_Window;
+    UISwapParameters_t  m_Parameters;
 };
 
 class CWindowDestroyEvent : public CVioarrEvent {
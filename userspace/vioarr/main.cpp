@@ -23,9 +23,12 @@
 
 #include <os/service.h>
 #include <os/window.h>
+#include <os/input.h>
+#include <os/mollenos.h>
 #include "vioarr.hpp"
 #include "engine/elements/window.hpp"
 #include "events/event_window.hpp"
+#include "events/event_input.hpp"
 
 bool ConvertSurfaceFormatToGLFormat(UISurfaceFormat_t Format, GLenum &FormatResult, 
     GLenum &InternalFormatResult, int &BytesPerPixel)
@@ -46,8 +49,10 @@ bool ConvertSurfaceFormatToGLFormat(UISurfaceFormat_t Format, GLenum &FormatResu
 }
 
 Handle_t HandleCreateWindowRequest(MRemoteCallAddress_t *Process,
-    UIWindowParameters_t *Parameters, UUId_t BufferHandle)
+    UIWindowParameters_t *Parameters, UUId_t BufferHandle, UUId_t ChannelHandle, cnd_t ReleaseSignal)
 {
+    UUId_t SignalOwner = UUID_INVALID;
+    DmaBuffer_t *Channel = nullptr;
     DmaBuffer_t *Buffer = nullptr;
     CWindow *Window = nullptr;
     Handle_t Result = nullptr;
@@ -65,21 +70,48 @@ Handle_t HandleCreateWindowRequest(MRemoteCallAddress_t *Process,
     // Now we must validate the parameters of the request, so validate
     // the sizes, surface-type and buffer-size
     if (Parameters->Surface.Dimensions.w < 0 || Parameters->Surface.Dimensions.h < 0
+        || Parameters->BufferCount < 1 || Parameters->BufferCount > UI_MAX_BUFFERS
         || !ConvertSurfaceFormatToGLFormat(Parameters->Surface.Format, Format, InternalFormat, BytesPerPixel)) {
         sLog.Warning("Invalid window parameters");
         return nullptr;
     }
 
-    // Inherit the buffer
-    if (BufferHandle == UUID_INVALID) {
+    // Validate the buffer handles
+    if (BufferHandle == UUID_INVALID || ChannelHandle == UUID_INVALID) {
         sLog.Warning("Invalid window buffer handle");
         return nullptr;
     }
-    Buffer = CreateBuffer(BufferHandle, 0);
 
-    // Validate the size of the buffer before acquiring it
-    if (GetBufferSize(Buffer) < (Parameters->Surface.Dimensions.w * Parameters->Surface.Dimensions.h * BytesPerPixel)) {
+    // The release signal is signalled by us on every present, so it must be
+    // a condition that belongs to the caller
+    if (GetConditionOwner(ReleaseSignal, &SignalOwner) != OsSuccess
+        || SignalOwner != Process->Process) {
+        sLog.Warning("Invalid window release signal");
+        return nullptr;
+    }
+
+    // Inherit the buffers
+    Buffer  = CreateBuffer(BufferHandle, 0);
+    Channel = CreateBuffer(ChannelHandle, 0);
+    if (Buffer == nullptr || Channel == nullptr) {
+        sLog.Warning("Failed to inherit window buffers");
+        if (Buffer != nullptr) {
+            DestroyBuffer(Buffer);
+        }
+        if (Channel != nullptr) {
+            DestroyBuffer(Channel);
+        }
+        return nullptr;
+    }
+
+    // Validate the size of the buffers before acquiring them, all surfaces
+    // are laid out back to back in the window buffer
+    if (GetBufferSize(Buffer) < (size_t)(Parameters->Surface.Dimensions.w * Parameters->Surface.Dimensions.h 
+            * BytesPerPixel * Parameters->BufferCount)
+        || GetBufferSize(Channel) < sizeof(MWindowChannel_t)) {
         sLog.Warning("Invalid window buffer size");
+        DestroyBuffer(Buffer);
+        DestroyBuffer(Channel);
         return nullptr;
     }
     ZeroBuffer(Buffer);
@@ -94,6 +126,9 @@ Handle_t HandleCreateWindowRequest(MRemoteCallAddress_t *Process,
     Window->SetStreamingBufferFormat(Format, InternalFormat);
     Window->SetStreamingBufferDimensions(Parameters->Surface.Dimensions.w, Parameters->Surface.Dimensions.h);
     Window->SetStreamingBuffer(Buffer);
+    Window->SetStreamingBufferCount(Parameters->BufferCount);
+    Window->SetInputChannel(Channel);
+    Window->SetReleaseSignal(ReleaseSignal);
 
     Window->SwapOnNextUpdate(true);
     Window->SetStreaming(true);
@@ -108,6 +143,10 @@ void MessageHandler()
     bool IsRunning          = true;
     MRemoteCall_t Message;
 
+    // Input and window requests arrive here, handle them
+    // right behind the input drivers
+    SetCurrentThreadRealtime(2);
+
     // Listen for messages
     ArgumentBuffer = (char*)::malloc(IPC_MAX_MESSAGELENGTH);
     while (IsRunning) {
@@ -115,12 +154,16 @@ void MessageHandler()
             if (Message.Function == __WINDOWMANAGER_CREATE) {
                 UIWindowParameters_t *Parameters    = nullptr;
                 Handle_t Result                     = nullptr;
-                UUId_t BufferHandle;
+                UUId_t BufferHandle, ChannelHandle;
+                cnd_t ReleaseSignal;
 
                 // Get arguments
                 RPCCastArgumentToPointer(&Message.Arguments[0], (void**)&Parameters);
                 BufferHandle    = (UUId_t)Message.Arguments[1].Data.Value;
-                Result          = HandleCreateWindowRequest(&Message.From, Parameters, BufferHandle);
+                ChannelHandle   = (UUId_t)Message.Arguments[2].Data.Value;
+                ReleaseSignal   = (cnd_t)Message.Arguments[3].Data.Value;
+                Result          = HandleCreateWindowRequest(&Message.From, Parameters, 
+                    BufferHandle, ChannelHandle, ReleaseSignal);
                 RPCRespond(&Message.From, &Result, sizeof(Result));
             }
             if (Message.Function == __WINDOWMANAGER_DESTROY) {
@@ -130,16 +173,29 @@ void MessageHandler()
                 }
             }
             if (Message.Function == __WINDOWMANAGER_SWAPBUFFER) {
-                Handle_t Pointer = (Handle_t)Message.Arguments[0].Data.Value;
-                if (sEngine.IsWindowHandleValid(Pointer)) {
-                    sVioarr.QueueEvent(new CWindowUpdateEvent((CWindow*)Pointer));
+                Handle_t Pointer                = (Handle_t)Message.Arguments[0].Data.Value;
+                UISwapParameters_t *Parameters  = nullptr;
+                RPCCastArgumentToPointer(&Message.Arguments[1], (void**)&Parameters);
+                if (Parameters != nullptr && sEngine.IsWindowHandleValid(Pointer)) {
+                    sVioarr.QueueEvent(new CWindowUpdateEvent((CWindow*)Pointer, Parameters));
                 }
             }
             if (Message.Function == __WINDOWMANAGER_QUERY) {
                 
             }
             if (Message.Function == __WINDOWMANAGER_NEWINPUT) {
-                
+                MInput_t *Input = nullptr;
+                RPCCastArgumentToPointer(&Message.Arguments[0], (void**)&Input);
+                if (Input != nullptr) {
+                    sVioarr.QueueEvent(new CInputEvent(Input, 1));
+                }
+            }
+            if (Message.Function == __WINDOWMANAGER_NEWINPUTBATCH) {
+                MInputBatch_t *Batch = nullptr;
+                RPCCastArgumentToPointer(&Message.Arguments[0], (void**)&Batch);
+                if (Batch != nullptr && Batch->Count != 0) {
+                    sVioarr.QueueEvent(new CInputEvent(&Batch->Events[0], Batch->Count));
+                }
             }
         }
     }
@@ -65,6 +65,10 @@ int VioarrCompositor::Run()
     // Spawn the test application
     ProcessSpawn("$bin/wintest.app", NULL, 1);
 
+    // Composition runs on this thread, keep frames going
+    // while normal applications are busy
+    SetCurrentThreadRealtime(3);
+
     // Enter event loop
     //LastUpdate = std::chrono::system_clock::now();
     while (_IsRunning) {
@@ -87,7 +91,19 @@ int VioarrCompositor::Run()
                 delete ((CWindowDestroyEvent*)Event)->GetWindow();
             } break;
             case CVioarrEvent::EventWindowUpdate: {
-                ((CWindowUpdateEvent*)Event)->GetWindow()->SwapOnNextUpdate(true);
+                CWindowUpdateEvent *Update = (CWindowUpdateEvent*)Event;
+                Update->GetWindow()->QueueSwap(Update->GetParameters());
+            } break;
+            case CVioarrEvent::EventInput: {
+                // Input goes straight into the ring of the active window, 
+                // nothing on screen changes so skip the update
+                CInputEvent *Input  = (CInputEvent*)Event;
+                CWindow *Window     = (CWindow*)sEngine.GetActiveWindow();
+                if (Window != nullptr) {
+                    Window->QueueInput(Input->GetEvents(), Input->GetCount());
+                }
+                delete Event;
+                continue;
             } break;
         }
         delete Event;
@@ -28,6 +28,7 @@
 #include "engine/veightengine.hpp"
 #include "utils/log_manager.hpp"
 #include "events/event_window.hpp"
+#include "events/event_input.hpp"
 
 class VioarrCompositor {
 public:
@@ -34,34 +34,45 @@ void BufferFill(const char *Buffer, uint32_t Color, size_t Size) {
     }
 }
 
+void SurfaceFillRect(void *Surface, int Stride, Rect_t *Region, uint32_t Color) {
+    for (int y = Region->y; y < (Region->y + Region->h); y++) {
+        BufferFill((const char*)Surface + (y * Stride) + (Region->x * 4), Color, Region->w * 4);
+    }
+}
+
 /*******************************************
  * Windowing Tests
  *******************************************/
 void BasicWindowingTests() {
     UIWindowParameters_t WindowParameters   = { { { 0 } } };
     DmaBuffer_t *WindowBuffer               = NULL;
+    uint32_t Colors[3]                      = { 0xFFFF0000, 0xFF00FF00, 0xFF0000FF };
+    Rect_t Region                           = { 16, 16, 64, 64 };
+    void *Surface                           = NULL;
+    size_t SurfaceSize;
+    int Stride;
     UiParametersSetDefault(&WindowParameters);
 
     // Register the window as initial step
     UiRegisterWindow(&WindowParameters, &WindowBuffer);
+    Stride      = WindowParameters.Surface.Dimensions.w * 4;
+    SurfaceSize = Stride * WindowParameters.Surface.Dimensions.h;
     std::this_thread::sleep_for(std::chrono::seconds(5));
 
-    // Perform a window fill of color R
-    BufferFill((const char*)GetBufferDataPointer(WindowBuffer), 
-        0xFFFF0000, GetBufferSize(WindowBuffer));
-    UiSwapBackbuffer();
-    std::this_thread::sleep_for(std::chrono::seconds(5));
-
-    // Perform a window fill of color G
-    BufferFill((const char*)GetBufferDataPointer(WindowBuffer), 
-        0xFF00FF00, GetBufferSize(WindowBuffer));
-    UiSwapBackbuffer();
-    std::this_thread::sleep_for(std::chrono::seconds(5));
+    // Perform a window fill of color R, G and B
+    for (int i = 0; i < 3; i++) {
+        UiGetBackbuffer(&Surface, NULL);
+        BufferFill((const char*)Surface, Colors[i], SurfaceSize);
+        UiSwapBackbuffer();
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+    }
 
-    // Perform a window fill of color B
-    BufferFill((const char*)GetBufferDataPointer(WindowBuffer), 
-        0xFF0000FF, GetBufferSize(WindowBuffer));
-    UiSwapBackbuffer();
+    // Present a damaged region only, the surface we get is not the one
+    // presented last, so bring it up to date before drawing the region
+    UiGetBackbuffer(&Surface, NULL);
+    BufferFill((const char*)Surface, Colors[2], SurfaceSize);
+    SurfaceFillRect(Surface, Stride, &Region, 0xFFFFFFFF);
+    UiSwapBackbufferRegions(&Region, 1);
     std::this_thread::sleep_for(std::chrono::seconds(5));
 
     // Destroy window and cleanup